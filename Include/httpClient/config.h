@@ -125,3 +125,28 @@
 #define HC_WINHTTP_WEBSOCKETS \
 (HC_PLATFORM == HC_PLATFORM_GDK)
 #endif
+
+// HC_CURL_HTTP builds the generic platform with the libcurl HTTP provider, rather than requiring a custom perform function
+#if !defined(HC_CURL_HTTP)
+#define HC_CURL_HTTP 0
+#endif
+
+// HC_EPOLL_HTTP builds the generic platform with the built-in epoll HTTP/1.1 provider, which supports http:// URLs only
+#if !defined(HC_EPOLL_HTTP)
+#define HC_EPOLL_HTTP 0
+#endif
+
+// HC_CALL_ARENA allocates each call's strings and headers from an arena that starts in the call's own allocation.
+// It saves most of a call's small heap allocations, but makes every call 1KB larger and takes a lock for each
+// allocation, so it's worth it for titles that make many calls with a memory allocator that is slow.
+#if !defined(HC_CALL_ARENA)
+#define HC_CALL_ARENA 0
+#endif
+
+// HC_TLS_SESSION_CACHE builds the TLS session cache shared by the transports that run on OpenSSL: websocketpp
+// websockets and the libcurl HTTP provider. Unit test builds replace websocketpp with a fake, so don't need it for that.
+#if !defined(HC_TLS_SESSION_CACHE)
+#define HC_TLS_SESSION_CACHE \
+(HC_CURL_HTTP || (!HC_NOWEBSOCKETS && !HC_WINHTTP_WEBSOCKETS && !HC_UNITTEST_API && \
+    (HC_PLATFORM == HC_PLATFORM_WIN32 || HC_PLATFORM == HC_PLATFORM_ANDROID || HC_PLATFORM_IS_APPLE)))
+#endif
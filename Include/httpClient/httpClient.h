@@ -35,8 +35,8 @@ extern "C"
 /// <returns>A pointer to an allocated block of memory of the specified size, or a null 
 /// pointer if allocation failed.</returns>
 /// <param name="size">The size of the allocation to be made. This value will never be zero.</param>
-/// <param name="memoryType">An opaque identifier representing the internal category of 
-/// memory being allocated.</param>
+/// <param name="memoryType">The part of the library the memory is allocated for, one of the 
+/// HC_MEMORY_TYPE values.</param>
 typedef _Ret_maybenull_ _Post_writable_byte_size_(size) void*
 (STDAPIVCALLTYPE* HCMemAllocFunction)(
     _In_ size_t size,
@@ -53,8 +53,7 @@ typedef _Ret_maybenull_ _Post_writable_byte_size_(size) void*
 /// </summary>
 /// <param name="pointer">The pointer to the memory buffer previously allocated. This value will
 /// never be a null pointer.</param>
-/// <param name="memoryType">An opaque identifier representing the internal category of 
-/// memory being allocated.</param>
+/// <param name="memoryType">The HC_MEMORY_TYPE the memory was allocated as.</param>
 typedef void
 (STDAPIVCALLTYPE* HCMemFreeFunction)(
     _In_ _Post_invalid_ void* pointer,
@@ -104,6 +103,89 @@ STDAPI HCMemGetFunctions(
     _Out_ HCMemFreeFunction* memFreeFunc
     ) noexcept;
 
+/// <summary>
+/// Optionally enables a small-object cache between the library and the memory hook functions.
+/// </summary>
+/// <param name="enabled">True to serve small allocations from per-thread caches, false to restore the default of
+/// passing every allocation to the memory hooks.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_HC_ALREADY_INITIALIZED, or
+/// E_HC_INTERNAL_STILLINUSE.</returns>
+/// <remarks>
+/// This must be called before HCInitialize(), and can not be called again until HCCleanup(). Memory is freed the way
+/// it was allocated, so the setting can only be changed while none of the memory the library allocated is still in
+/// use: before the first HCInitialize(), or after HCCleanup() once every handle from before it has been closed. Only
+/// memory allocated while thread caching or accounting is enabled is tracked, so this returns
+/// E_HC_INTERNAL_STILLINUSE if some of that is still in use, but can't detect memory allocated in the default mode.
+///
+/// When enabled, allocations of up to 4KB are rounded up to one of a few sizes and served from blocks of that size,
+/// which are carved out of slabs of 16KB or more allocated with the HCMemAllocFunction. Freed blocks are cached by the
+/// thread that freed them and reused by its next allocations, so the memory hooks are called once per slab rather
+/// than once per allocation. Larger allocations are still passed to the memory hooks directly.
+///
+/// HCCleanup() returns the slabs whose blocks are all free to the HCMemFreeFunction. Blocks cached by other threads
+/// are returned when those threads exit, along with their slabs if thread caching has been disabled since.
+/// </remarks>
+STDAPI HCMemSetThreadCachingEnabled(
+    _In_ bool enabled
+    ) noexcept;
+
+/// <summary>
+/// The memory used by the library for one HCMemoryType, as reported by HCMemGetUsage().
+/// </summary>
+typedef struct HCMemoryUsage
+{
+    /// <summary>The bytes currently allocated.</summary>
+    uint64_t currentBytes;
+
+    /// <summary>The most bytes that were allocated at once.</summary>
+    uint64_t peakBytes;
+
+    /// <summary>The bytes allocated in all, including those since freed.</summary>
+    uint64_t totalBytes;
+
+    /// <summary>The number of allocations made in all.</summary>
+    uint64_t totalAllocations;
+} HCMemoryUsage;
+
+/// <summary>
+/// Optionally enables accounting of the memory used by the library for each HCMemoryType.
+/// </summary>
+/// <param name="enabled">True to keep count of the memory allocated for each type, false to stop.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_HC_ALREADY_INITIALIZED, or
+/// E_HC_INTERNAL_STILLINUSE.</returns>
+/// <remarks>
+/// This must be called before HCInitialize(), and can not be called again until HCCleanup(). As with
+/// HCMemSetThreadCachingEnabled(), the setting can only be changed while none of the memory the library allocated is
+/// still in use: before the first HCInitialize(), or after HCCleanup() once every handle from before it has been
+/// closed. Memory allocated with accounting or thread caching enabled is tracked, and this returns
+/// E_HC_INTERNAL_STILLINUSE while some of it is still in use. Memory allocated with both disabled isn't tracked, so
+/// enabling accounting while some of it is still in use can't be detected and must be avoided.
+///
+/// While enabled, every allocation is made 16 bytes larger to record its size, and the usage of its type is updated
+/// with atomic operations when it is allocated and freed. Enabling accounting resets the usage of every type.
+///
+/// The usage counts the memory the library asked for. With thread caching enabled, the slabs that memory is made from
+/// are counted as HC_MEMORY_TYPE_THREAD_CACHE in addition.
+/// </remarks>
+STDAPI HCMemSetAccountingEnabled(
+    _In_ bool enabled
+    ) noexcept;
+
+/// <summary>
+/// Gets the memory used by the library for an HCMemoryType since accounting was enabled.
+/// </summary>
+/// <param name="memoryType">One of the HC_MEMORY_TYPE values.</param>
+/// <param name="usage">Set to the memory used for the type.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, or E_NOT_SUPPORTED if
+/// accounting isn't enabled.</returns>
+/// <remarks>
+/// This can be called at any time, e.g. to check the library's memory against a budget for each type while under load.
+/// </remarks>
+STDAPI HCMemGetUsage(
+    _In_ HCMemoryType memoryType,
+    _Out_ HCMemoryUsage* usage
+    ) noexcept;
+
 
 /////////////////////////////////////////////////////////////////////////////////////////
 // Global APIs
@@ -167,7 +249,7 @@ STDAPI HCCleanupAsync(XAsyncBlock* async) noexcept;
 STDAPI HCGetLibVersion(_Outptr_ const char** version) noexcept;
 
 /// <summary>
-/// A callback that will be synchronously invoked each time an HTTP call is performed
+/// A callback that will be invoked each time an HTTP call is performed, synchronously unless HCSetRoutedHandlerQueue has set a queue
 /// </summary>
 /// <param name="call">Handle to the HTTP call.</param>
 /// <param name="context">Client context pass when the handler was added.</param>
@@ -197,6 +279,21 @@ STDAPI_(void) HCRemoveCallRoutedHandler(
     _In_ int32_t handlerId
     ) noexcept;
 
+/// <summary>
+/// Sets the task queue that call and websocket routed handlers are invoked on.
+/// </summary>
+/// <param name="queue">The queue to deliver notifications on, or nullptr to invoke handlers synchronously again.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_HC_NOT_INITIALISED, or E_FAIL.</returns>
+/// <remarks>
+/// By default routed handlers are invoked synchronously on the thread that completed the HTTP call or sent or received
+/// the websocket message. Once a queue is set, notifications are batched and delivered on the queue's work port so
+/// handlers never delay calls or messages. A handler invoked on the queue sees the call as it is when the handler
+/// runs, so if the call has been retried since, the response reflects a later attempt.
+/// </remarks>
+STDAPI HCSetRoutedHandlerQueue(
+    _In_opt_ XTaskQueueHandle queue
+    ) noexcept;
+
 /// <summary>
 /// Manually sets an explicit proxy address.
 /// </summary>
@@ -205,6 +302,178 @@ STDAPI_(void) HCRemoveCallRoutedHandler(
 /// <remarks> If it is passed a null proxy, it will reset to default. Does not include proxying web socket traffic.</remarks>
 STDAPI HCSetGlobalProxy(_In_ const char* proxyUri) noexcept;
 
+/// <summary>
+/// Counters for the DNS cache of platforms that resolve host names themselves.
+/// </summary>
+typedef struct HCDnsCacheStats
+{
+    /// <summary>Resolutions answered from the cache, including cached failures.</summary>
+    uint64_t hits;
+
+    /// <summary>Resolutions that started a lookup.</summary>
+    uint64_t misses;
+
+    /// <summary>Resolutions that waited on a lookup of the same host already in progress.</summary>
+    uint64_t coalesced;
+
+    /// <summary>Lookups started ahead of need, to refresh frequently used hosts or by HCPrewarmDnsCache.</summary>
+    uint64_t prefetches;
+
+    /// <summary>hits / (hits + misses + coalesced), or 0 before the first resolution.</summary>
+    double hitRate;
+} HCDnsCacheStats;
+
+/// <summary>
+/// Looks up host names in the background so the first connections to them don't wait on DNS.
+/// </summary>
+/// <param name="hostNames">The host names to look up.</param>
+/// <param name="hostNameCount">The number of host names.</param>
+/// <returns>Result code for this API operation. Possible values are S_OK, E_INVALIDARG, E_HC_NOT_INITIALISED, E_NOTIMPL, or E_FAIL.</returns>
+/// <remarks>
+/// Returns without waiting for the lookups. Hosts that are already cached and IP literals are skipped.
+/// Returns E_NOTIMPL on platforms whose HTTP stack resolves host names itself.
+/// </remarks>
+STDAPI HCPrewarmDnsCache(
+    _In_reads_(hostNameCount) const char* const* hostNames,
+    _In_ uint32_t hostNameCount
+    ) noexcept;
+
+/// <summary>
+/// Gets the counters of the DNS cache.
+/// </summary>
+/// <param name="stats">The counters since HCInitialize.</param>
+/// <returns>Result code for this API operation. Possible values are S_OK, E_INVALIDARG, E_HC_NOT_INITIALISED, or E_NOTIMPL.</returns>
+/// <remarks>Returns E_NOTIMPL on platforms whose HTTP stack resolves host names itself.</remarks>
+STDAPI HCGetDnsCacheStats(
+    _Out_ HCDnsCacheStats* stats
+    ) noexcept;
+
+/// <summary>
+/// Counters for the TLS session cache shared by the OpenSSL based transports.
+/// </summary>
+typedef struct HCTlsSessionStats
+{
+    /// <summary>Handshakes that resumed a cached session.</summary>
+    uint64_t resumedHandshakes;
+
+    /// <summary>Handshakes that negotiated a new session.</summary>
+    uint64_t fullHandshakes;
+} HCTlsSessionStats;
+
+/// <summary>
+/// Gets the counters of the TLS session cache.
+/// </summary>
+/// <param name="stats">The counters since HCInitialize.</param>
+/// <returns>Result code for this API operation. Possible values are S_OK, E_INVALIDARG, E_HC_NOT_INITIALISED, or E_NOTIMPL.</returns>
+/// <remarks>
+/// Sessions are cached by host and port and resumed by later connections to the same server, whether they are
+/// websockets or HTTP calls. Returns E_NOTIMPL on platforms whose TLS stack isn't OpenSSL.
+/// </remarks>
+STDAPI HCGetTlsSessionStats(
+    _Out_ HCTlsSessionStats* stats
+    ) noexcept;
+
+/// <summary>
+/// Counters for the connections of the HTTP provider.
+/// </summary>
+typedef struct HCHttpConnectionStats
+{
+    /// <summary>Connections currently open or being opened.</summary>
+    uint64_t openConnections;
+
+    /// <summary>Open connections currently waiting in the pool for a call.</summary>
+    uint64_t idleConnections;
+
+    /// <summary>Connections opened by HCHttpPreconnectAsync.</summary>
+    uint64_t preconnectedConnections;
+
+    /// <summary>Preconnected connections that went on to carry a call.</summary>
+    uint64_t preconnectedConnectionsUsed;
+
+    /// <summary>Preconnected connections closed before carrying a call, e.g. at the idle timeout.</summary>
+    uint64_t preconnectedConnectionsExpired;
+} HCHttpConnectionStats;
+
+/// <summary>
+/// Opens connections to a server ahead of the calls that will need them.
+/// </summary>
+/// <param name="url">A URL on the server. Only its scheme, host and port are used.</param>
+/// <param name="connectionCount">The number of connections the server should have open, counting those it already has.</param>
+/// <param name="asyncBlock">The XAsyncBlock that defines the async operation.</param>
+/// <returns>Result code for this API operation. Possible values are S_OK, E_INVALIDARG, E_HC_NOT_INITIALISED, E_NOTIMPL, or E_FAIL.</returns>
+/// <remarks>
+/// The host name is resolved and the connections are opened into the connection pool, where the next calls to the
+/// server pick them up. They are closed like any other idle connection once they have been unused for the idle
+/// timeout. The operation completes once they are open, with the error of the first connection that failed if any
+/// did, and never needs to be waited on before making calls.
+///
+/// The libcurl provider can't add connections to its pool, so it completes one TLS handshake with the server instead.
+/// The first call then only needs an abbreviated handshake, and the host name is already resolved.
+/// Returns E_NOTIMPL on platforms whose HTTP stack manages its own connections.
+/// </remarks>
+STDAPI HCHttpPreconnectAsync(
+    _In_z_ const char* url,
+    _In_ uint32_t connectionCount,
+    _Inout_ XAsyncBlock* asyncBlock
+    ) noexcept;
+
+/// <summary>
+/// Gets the counters of the HTTP provider's connections.
+/// </summary>
+/// <param name="stats">The counters since HCInitialize.</param>
+/// <returns>Result code for this API operation. Possible values are S_OK, E_INVALIDARG, E_HC_NOT_INITIALISED, or E_NOTIMPL.</returns>
+/// <remarks>Returns E_NOTIMPL on platforms whose HTTP stack manages its own connections.</remarks>
+STDAPI HCGetHttpConnectionStats(
+    _Out_ HCHttpConnectionStats* stats
+    ) noexcept;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// Url encoding APIs
+//
+
+/// <summary>
+/// Percent-encodes a URL component.
+/// </summary>
+/// <param name="input">The UTF-8 encoded bytes to encode.</param>
+/// <param name="inputSize">The number of bytes to encode.</param>
+/// <param name="bufferSize">The size of buffer in bytes.</param>
+/// <param name="buffer">The buffer the encoded bytes are written to, or nullptr to only get their size.</param>
+/// <param name="bufferUsed">The size in bytes of the encoded input, whether or not it was written.</param>
+/// <returns>Result code for this API operation. Possible values are S_OK, E_INVALIDARG, or E_NOT_SUFFICIENT_BUFFER.</returns>
+/// <remarks>
+/// The unreserved characters A-Z, a-z, 0-9, '-', '.', '_' and '~' are kept as they are and every other byte is
+/// written as %XX, so the result can be used as any component of a URL, including a query string key or value.
+/// The encoded bytes are not null terminated.
+/// </remarks>
+STDAPI HCUrlEncode(
+    _In_reads_bytes_(inputSize) const char* input,
+    _In_ size_t inputSize,
+    _In_ size_t bufferSize,
+    _Out_writes_bytes_to_opt_(bufferSize, *bufferUsed) char* buffer,
+    _Out_ size_t* bufferUsed
+    ) noexcept;
+
+/// <summary>
+/// Decodes a percent-encoded URL component.
+/// </summary>
+/// <param name="input">The bytes to decode.</param>
+/// <param name="inputSize">The number of bytes to decode.</param>
+/// <param name="bufferSize">The size of buffer in bytes.</param>
+/// <param name="buffer">The buffer the decoded bytes are written to, or nullptr to only get their size.</param>
+/// <param name="bufferUsed">The size in bytes of the decoded input, whether or not it was written.</param>
+/// <returns>Result code for this API operation. Possible values are S_OK, E_INVALIDARG, or E_NOT_SUFFICIENT_BUFFER.</returns>
+/// <remarks>
+/// Each %XX is replaced by the byte it encodes, and every other byte, '+' included, is kept as it is. Returns
+/// E_INVALIDARG if input has a '%' that isn't followed by two hex digits. The decoded bytes are not null terminated.
+/// </remarks>
+STDAPI HCUrlDecode(
+    _In_reads_bytes_(inputSize) const char* input,
+    _In_ size_t inputSize,
+    _In_ size_t bufferSize,
+    _Out_writes_bytes_to_opt_(bufferSize, *bufferUsed) char* buffer,
+    _Out_ size_t* bufferUsed
+    ) noexcept;
+
 /////////////////////////////////////////////////////////////////////////////////////////
 // Http APIs
 //
@@ -234,6 +503,27 @@ STDAPI HCHttpCallCreate(
     _Out_ HCCallHandle* call
     ) noexcept;
 
+/// <summary>
+/// Creates an HTTP call handle set up like another one, its prototype.
+/// </summary>
+/// <param name="prototype">The handle of the HTTP call to copy the request from.</param>
+/// <param name="call">The handle of the new HTTP call.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, E_OUTOFMEMORY, or E_HC_NOT_INITIALISED.</returns>
+/// <remarks>
+/// The new call gets the prototype's method, URL, request headers, timeouts, retry settings, priority, HTTP version,
+/// compression settings and tracing, so only what differs needs to be set on it. It doesn't get the prototype's
+/// request body, body functions, context or response, and the prototype doesn't need to have been performed.
+///
+/// The first call created from a prototype freezes its request headers, and every call created after that shares them
+/// instead of copying them. Setting a header on either call then copies them for that call only.
+/// Calls can be created from the same prototype on several threads at once, as long as the prototype itself isn't
+/// changed at the same time.
+/// </remarks>
+STDAPI HCHttpCallCreateFromPrototype(
+    _In_ HCCallHandle prototype,
+    _Out_ HCCallHandle* call
+    ) noexcept;
+
 /// <summary>
 /// Perform HTTP call using the HCCallHandle.
 /// </summary>
@@ -263,6 +553,23 @@ STDAPI HCHttpCallPerformAsync(
     _Inout_ XAsyncBlock* asyncBlock
     ) noexcept;
 
+/// <summary>
+/// Resumes the body transfer of an HTTP call after its request body read function or response body write function
+/// returned E_PENDING.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.</param>
+/// <returns>Result code for this API operation. Possible values are S_OK or E_INVALIDARG.</returns>
+/// <remarks>
+/// This may be called from any thread, including from within the callback before it returns E_PENDING. Calling it
+/// when the transfer isn't paused has no effect. The call's timeout keeps running while it is paused.
+///
+/// The WinHTTP, libcurl and epoll HTTP providers stop sending or receiving while paused. Other HTTP providers block
+/// the thread that invoked the callback until this is called.
+/// </remarks>
+STDAPI HCHttpCallResumeBodyTransfer(
+    _In_ HCCallHandle call
+    ) noexcept;
+
 /// <summary>
 /// Duplicates the HCCallHandle object.
 /// </summary>
@@ -335,6 +642,24 @@ STDAPI HCHttpCallRequestSetUrl(
     _In_z_ const char* url
     ) noexcept;
 
+/// <summary>
+/// Appends a query string parameter to the url of the HTTP call.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.</param>
+/// <param name="name">UTF-8 encoded name of the parameter.</param>
+/// <param name="value">UTF-8 encoded value of the parameter.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, E_OUTOFMEMORY, or E_FAIL.</returns>
+/// <remarks>
+/// The name and value are percent-encoded as HCUrlEncode does, and added as name=value after '?' or '&amp;' as the
+/// url needs, ahead of any fragment. They are encoded straight into the call's url, so appending many parameters
+/// makes no copies of them. This must be called after HCHttpCallRequestSetUrl and prior to calling HCHttpCallPerformAsync.
+/// </remarks>
+STDAPI HCHttpCallRequestAppendQueryParameter(
+    _In_ HCCallHandle call,
+    _In_z_ const char* name,
+    _In_z_ const char* value
+    ) noexcept;
+
 /// <summary>
 /// Set the request body bytes of the HTTP call. This API operation is mutually exclusive with
 /// HCHttpCallRequestSetRequestBodyReadFunction and will result in any custom read callbacks that were
@@ -375,7 +700,11 @@ STDAPI HCHttpCallRequestSetRequestBodyString(
 /// <param name="context">The context associated with this read function.</param>
 /// <param name="destination">The destination where data may be written to.</param>
 /// <param name="bytesWritten">The number of bytes that were actually written to destination.</param>
-/// <returns>Result code for this callback. Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <returns>Result code for this callback. Possible values are S_OK, E_PENDING, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>
+/// Return E_PENDING, without writing any bytes, when the next part of the body isn't available yet. The call stops
+/// sending until HCHttpCallResumeBodyTransfer is called, and then invokes this callback again with the same offset.
+/// </remarks>
 typedef HRESULT
 (CALLBACK* HCHttpCallRequestBodyReadFunction)(
     _In_ HCCallHandle call,
@@ -405,6 +734,105 @@ STDAPI HCHttpCallRequestSetRequestBodyReadFunction(
     _In_opt_ void* context
     ) noexcept;
 
+/// <summary>
+/// Adds a part copied from memory to the multipart/form-data request body of the HTTP call.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.</param>
+/// <param name="name">UTF-8 encoded name of the form field.</param>
+/// <param name="fileName">UTF-8 encoded file name to send with the part, or nullptr to send none.</param>
+/// <param name="contentType">Content type of the part, or nullptr to send none.</param>
+/// <param name="bytes">The content of the part.</param>
+/// <param name="size">The length of the content in bytes.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, E_OUTOFMEMORY, or E_FAIL.</returns>
+/// <remarks>
+/// The first part added makes the request body multipart/form-data, setting the Content-Type header with a
+/// generated boundary, and each part is sent in the order it was added. The body is never put together in memory;
+/// the boundaries and each part are read as the platform's HTTP stack sends them. It is sent with a Content-Length
+/// when the size of every part is known, and with chunked transfer encoding otherwise.
+/// Setting the body any other way replaces the multipart body, and adding a part after that starts a new one.
+/// This must be called prior to calling HCHttpCallPerformAsync.
+/// </remarks>
+STDAPI HCHttpCallRequestAddMultipartBytes(
+    _In_ HCCallHandle call,
+    _In_z_ const char* name,
+    _In_opt_z_ const char* fileName,
+    _In_opt_z_ const char* contentType,
+    _In_reads_bytes_(size) const uint8_t* bytes,
+    _In_ size_t size
+    ) noexcept;
+
+/// <summary>
+/// Adds a part read straight from memory owned by the caller to the multipart/form-data request body of the HTTP call.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.</param>
+/// <param name="name">UTF-8 encoded name of the form field.</param>
+/// <param name="fileName">UTF-8 encoded file name to send with the part, or nullptr to send none.</param>
+/// <param name="contentType">Content type of the part, or nullptr to send none.</param>
+/// <param name="bytes">The content of the part, which must stay valid and unchanged until the call completes.</param>
+/// <param name="size">The length of the content in bytes.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, E_OUTOFMEMORY, or E_FAIL.</returns>
+/// <remarks>
+/// Unlike HCHttpCallRequestAddMultipartBytes the content isn't copied. See HCHttpCallRequestAddMultipartBytes for how
+/// the body is sent.
+/// This must be called prior to calling HCHttpCallPerformAsync.
+/// </remarks>
+STDAPI HCHttpCallRequestAddMultipartBorrowedBytes(
+    _In_ HCCallHandle call,
+    _In_z_ const char* name,
+    _In_opt_z_ const char* fileName,
+    _In_opt_z_ const char* contentType,
+    _In_reads_bytes_(size) const uint8_t* bytes,
+    _In_ size_t size
+    ) noexcept;
+
+/// <summary>
+/// Adds a part read from a file to the multipart/form-data request body of the HTTP call.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.</param>
+/// <param name="name">UTF-8 encoded name of the form field.</param>
+/// <param name="fileName">UTF-8 encoded file name to send with the part, or nullptr to send the name of the file read.</param>
+/// <param name="contentType">Content type of the part, or nullptr to send none.</param>
+/// <param name="filePath">UTF-8 encoded path of the file.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, E_OUTOFMEMORY, or E_FAIL.</returns>
+/// <remarks>
+/// The file's size is taken when the part is added, and the file is opened again when the part is sent. The call
+/// fails if it has changed size by then. See HCHttpCallRequestAddMultipartBytes for how the body is sent.
+/// This must be called prior to calling HCHttpCallPerformAsync.
+/// </remarks>
+STDAPI HCHttpCallRequestAddMultipartFile(
+    _In_ HCCallHandle call,
+    _In_z_ const char* name,
+    _In_opt_z_ const char* fileName,
+    _In_opt_z_ const char* contentType,
+    _In_z_ const char* filePath
+    ) noexcept;
+
+/// <summary>
+/// Adds a part read with a callback to the multipart/form-data request body of the HTTP call.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.</param>
+/// <param name="name">UTF-8 encoded name of the form field.</param>
+/// <param name="fileName">UTF-8 encoded file name to send with the part, or nullptr to send none.</param>
+/// <param name="contentType">Content type of the part, or nullptr to send none.</param>
+/// <param name="readFunction">The callback that reads the part, with offsets relative to the start of the part.</param>
+/// <param name="size">The length of the part in bytes, or HC_UNKNOWN_REQUEST_BODY_SIZE to read until the callback returns 0 bytes.</param>
+/// <param name="context">The context to pass to the callback.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, E_OUTOFMEMORY, or E_FAIL.</returns>
+/// <remarks>
+/// A part of unknown size makes the body sent with chunked transfer encoding. The callback may return E_PENDING as
+/// described for HCHttpCallRequestBodyReadFunction. See HCHttpCallRequestAddMultipartBytes for how the body is sent.
+/// This must be called prior to calling HCHttpCallPerformAsync.
+/// </remarks>
+STDAPI HCHttpCallRequestAddMultipartReadFunction(
+    _In_ HCCallHandle call,
+    _In_z_ const char* name,
+    _In_opt_z_ const char* fileName,
+    _In_opt_z_ const char* contentType,
+    _In_ HCHttpCallRequestBodyReadFunction readFunction,
+    _In_ size_t size,
+    _In_opt_ void* context
+    ) noexcept;
+
 /// <summary>
 /// Set a request header for the HTTP call.
 /// </summary>
@@ -436,6 +864,236 @@ STDAPI HCHttpCallRequestSetRetryAllowed(
     _In_ bool retryAllowed
     ) noexcept;
 
+/// <summary>
+/// Sets if a compressed response body is decompressed for this HTTP call.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.  Pass nullptr to set the default for future calls.</param>
+/// <param name="decompress">If a gzip or deflate encoded response body should be decompressed.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, or E_FAIL.</returns>
+/// <remarks>
+/// Defaults to false.
+/// When enabled, an "Accept-Encoding: gzip, deflate" request header is sent unless the request already has an
+/// Accept-Encoding header. A gzip or deflate encoded response body is decoded as it arrives and the decoded bytes are
+/// passed to the response body write function. The Content-Encoding and Content-Length headers are removed from a
+/// decoded response. A corrupt or truncated body fails the call with E_HC_COMPRESSED_DATA_INVALID.
+/// This must be called prior to calling HCHttpCallPerformAsync.
+/// </remarks>
+STDAPI HCHttpCallRequestSetResponseDecompression(
+    _In_opt_ HCCallHandle call,
+    _In_ bool decompress
+    ) noexcept;
+
+/// <summary>
+/// Compression levels for HCHttpCallRequestSetCompression. Any value from 0 to 9 can be used, with the same
+/// meaning as zlib's compression levels.
+/// </summary>
+enum class HCCompressionLevel : uint32_t
+{
+    None = 0,
+    Low = 1,
+    Medium = 6,
+    High = 9
+};
+
+/// <summary>
+/// Sets the level the request body of this HTTP call is gzip compressed with.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.  Pass nullptr to set the default for future calls.</param>
+/// <param name="level">The compression level, or HCCompressionLevel::None to send the body as is.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>
+/// Defaults to HCCompressionLevel::None.
+/// The body is compressed as the platform's HTTP stack reads it rather than ahead of time, so its compressed
+/// size isn't known when the request is sent and it is sent with chunked transfer encoding. A "Content-Encoding: gzip"
+/// request header is added. A request that already has a Content-Encoding header, or has no body, is sent unchanged.
+/// Higher levels trade CPU time for smaller bodies; Low is usually the best choice for large uploads.
+/// This must be called prior to calling HCHttpCallPerformAsync.
+/// </remarks>
+STDAPI HCHttpCallRequestSetCompression(
+    _In_opt_ HCCallHandle call,
+    _In_ HCCompressionLevel level
+    ) noexcept;
+
+/// <summary>
+/// HTTP protocol versions for HCHttpCallRequestSetHttpVersion.
+/// </summary>
+enum class HCHttpVersion : uint32_t
+{
+    /// <summary>HTTP/2 where the server negotiates it over TLS, and HTTP/1.1 otherwise.</summary>
+    Default = 0,
+
+    /// <summary>HTTP/1.1 only.</summary>
+    Http1_1 = 1,
+
+    /// <summary>HTTP/2 over TLS, or by upgrading an http:// connection.</summary>
+    Http2 = 2,
+
+    /// <summary>HTTP/2 without negotiation, for http:// servers known to speak it (h2c).</summary>
+    Http2PriorKnowledge = 3
+};
+
+/// <summary>
+/// Sets the HTTP protocol version used for this HTTP call.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.  Pass nullptr to set the default for future calls.</param>
+/// <param name="version">The HTTP protocol version.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>
+/// Defaults to HCHttpVersion::Default.
+/// Calls to the same host using HTTP/2 are multiplexed as streams over one connection where the platform's HTTP
+/// stack supports it. Stacks that choose the protocol themselves ignore this setting.
+/// This must be called prior to calling HCHttpCallPerformAsync.
+/// </remarks>
+STDAPI HCHttpCallRequestSetHttpVersion(
+    _In_opt_ HCCallHandle call,
+    _In_ HCHttpVersion version
+    ) noexcept;
+
+/// <summary>
+/// Relative priorities for HCHttpCallRequestSetPriority.
+/// </summary>
+enum class HCHttpCallPriority : uint32_t
+{
+    Low = 0,
+    Normal = 1,
+    High = 2
+};
+
+/// <summary>
+/// Sets the priority of this HTTP call relative to other calls sharing its connection.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.  Pass nullptr to set the default for future calls.</param>
+/// <param name="priority">The priority of the call.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>
+/// Defaults to HCHttpCallPriority::Normal.
+/// On HTTP/2 connections the priority becomes the weight of the call's stream, so the server gives
+/// higher priority calls a larger share of the connection. It has no effect on HTTP/1.1.
+/// This must be called prior to calling HCHttpCallPerformAsync.
+/// </remarks>
+STDAPI HCHttpCallRequestSetPriority(
+    _In_opt_ HCCallHandle call,
+    _In_ HCHttpCallPriority priority
+    ) noexcept;
+
+/// <summary>
+/// Sets this HTTP call to download a large response body as byte ranges fetched in parallel.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.</param>
+/// <param name="segmentCount">The most ranges fetched at once, or 0 or 1 to download the body in one response.</param>
+/// <param name="minSegmentSize">The smallest range in bytes worth fetching on its own.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>
+/// Defaults to 0, so bodies are downloaded in one response.
+/// Only GET calls without a Range header use parallel ranges. A HEAD request is sent first, and if the server
+/// responds with "Accept-Ranges: bytes" and a Content-Length of at least two segments, the body is split into up to
+/// segmentCount ranges of at least minSegmentSize bytes that are requested concurrently. Each range is written
+/// straight to its offset in the response body buffer, which is allocated up front, or passed to the function set with
+/// HCHttpCallResponseSetResponseBodyWriteAtFunction. A range whose connection fails or ends early is requested again
+/// from its first missing byte, if retry is allowed for the call. Once every range has arrived the call completes with
+/// the status code and headers of the HEAD response. If a range fails for good, the call completes with that range's
+/// status code, network error and headers instead. A response for a different range than the one asked for, e.g.
+/// because the resource changed during the download, fails the call with E_HC_RANGE_MISMATCH.
+/// Otherwise the call is performed as usual, which is also the case when response decompression is enabled or a
+/// HCHttpCallResponseBodyWriteFunction is set, since those need the body in order.
+/// This must be called prior to calling HCHttpCallPerformAsync.
+/// </remarks>
+STDAPI HCHttpCallRequestSetParallelRanges(
+    _In_ HCCallHandle call,
+    _In_ uint32_t segmentCount,
+    _In_ uint64_t minSegmentSize
+    ) noexcept;
+
+/// <summary>
+/// How far a resumable download has got, which can be saved to resume it after the process restarts.
+/// </summary>
+typedef struct HCResumeCheckpoint
+{
+    /// <summary>The number of body bytes the response write function has accepted.</summary>
+    uint64_t offset;
+
+    /// <summary>The length of the whole body, or 0 if the server didn't say.</summary>
+    uint64_t totalLength;
+
+    /// <summary>The strong ETag, or else the Last-Modified date, of the resource the bytes came from.</summary>
+    _Field_z_ const char* validator;
+} HCResumeCheckpoint;
+
+/// <summary>
+/// The callback definition used by a resumable HTTP call to report its progress.
+/// This callback will be invoked on an unspecified background thread which is platform dependent.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.</param>
+/// <param name="checkpoint">The progress so far. It is only valid for the duration of the callback.</param>
+/// <param name="context">The context associated with this callback.</param>
+typedef void
+(CALLBACK* HCHttpCallResumeCheckpointFunction)(
+    _In_ HCCallHandle call,
+    _In_ const HCResumeCheckpoint* checkpoint,
+    _In_opt_ void* context
+    );
+
+/// <summary>
+/// Sets whether a retry of this HTTP call continues the download where the failed attempt stopped.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.</param>
+/// <param name="resumable">Whether the call is resumable.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>
+/// Defaults to false, so every attempt downloads the whole body again.
+/// Only GET calls without a Range header and without response decompression are resumable. Once a response carries a
+/// strong ETag or a Last-Modified date, the body bytes the response write function accepted are kept when the call is
+/// retried, and the retry asks for the rest with "Range: bytes=N-" guarded by If-Range. When the server answers with
+/// the remaining range the call completes with status 200, the Content-Length of the whole body and no Content-Range,
+/// as if it had arrived in one response. When it answers with the whole body instead, because the resource changed or
+/// ranges aren't supported, the body is delivered again from offset 0. A HCHttpCallResponseBodyWriteFunction can't
+/// take back what it was given, so in that case the call fails with E_HC_RANGE_MISMATCH. The body of an error
+/// response to a resumed attempt is dropped, so that the bytes already delivered stay intact.
+/// This must be called prior to calling HCHttpCallPerformAsync.
+/// </remarks>
+STDAPI HCHttpCallRequestSetResumable(
+    _In_ HCCallHandle call,
+    _In_ bool resumable
+    ) noexcept;
+
+/// <summary>
+/// Makes this HTTP call resumable and continues a download saved from an earlier call.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.</param>
+/// <param name="checkpoint">A checkpoint reported to the HCHttpCallResumeCheckpointFunction of the earlier call.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>
+/// The first attempt asks for the body from checkpoint->offset on. The response write function receives only those
+/// bytes, and a HCHttpCallResponseBodyWriteAtFunction receives them at their offset in the whole body, so either can
+/// append to what was saved. If the resource changed since, the body is delivered again from offset 0 as described
+/// for HCHttpCallRequestSetResumable.
+/// This must be called prior to calling HCHttpCallPerformAsync.
+/// </remarks>
+STDAPI HCHttpCallRequestSetResumeCheckpoint(
+    _In_ HCCallHandle call,
+    _In_ const HCResumeCheckpoint* checkpoint
+    ) noexcept;
+
+/// <summary>
+/// Makes this HTTP call resumable and sets a callback that reports its progress, so it can be saved.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.</param>
+/// <param name="checkpointFunction">The callback, or nullptr to stop reporting progress.</param>
+/// <param name="intervalBytes">How many bytes to download between checkpoints, or 0 to report one only when an attempt ends.</param>
+/// <param name="context">The context to pass to the callback.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>
+/// A checkpoint is reported whenever the resumable progress changes, including back to offset 0, and only covers
+/// bytes the response write function has already accepted. Save the checkpoint only after those bytes are stored.
+/// This must be called prior to calling HCHttpCallPerformAsync.
+/// </remarks>
+STDAPI HCHttpCallRequestSetResumeCheckpointFunction(
+    _In_ HCCallHandle call,
+    _In_opt_ HCHttpCallResumeCheckpointFunction checkpointFunction,
+    _In_ uint64_t intervalBytes,
+    _In_opt_ void* context
+    ) noexcept;
+
 /// <summary>
 /// ID number of this REST endpoint used to cache the Retry-After header for fast fail.
 /// </summary>
@@ -582,7 +1240,14 @@ STDAPI HCHttpDisableAssertsForSSLValidationInDevSandboxes(
 /// <param name="source">The source from which bytes may be read.</param>
 /// <param name="bytesAvailable">The number of bytes that can be read from the source.</param>
 /// <param name="context">The context associated with this write function.</param>
-/// <returns>Result code for this callback. Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <returns>Result code for this callback. Possible values are S_OK, E_PENDING, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>
+/// Return E_PENDING to take the bytes but hold off the rest of the body until HCHttpCallResumeBodyTransfer is
+/// called, e.g. while they are still being written to disk. The call stops reading from the network in the meantime,
+/// so a body that arrives faster than it is consumed is held back by the server rather than buffered. Body bytes the
+/// call has already received, such as the rest of a decompressed block, may still be passed to this callback before
+/// it stops.
+/// </remarks>
 typedef HRESULT
 (CALLBACK* HCHttpCallResponseBodyWriteFunction)(
     _In_ HCCallHandle call,
@@ -608,6 +1273,129 @@ STDAPI HCHttpCallResponseSetResponseBodyWriteFunction(
     _In_opt_ void* context
     ) noexcept;
 
+/// <summary>
+/// The callback definition used by an HTTP call to write the response body at a given offset, e.g. into a file.
+/// This callback will be invoked on an unspecified background thread which is platform dependent.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.</param>
+/// <param name="offset">The offset in the response body of the first byte in source.</param>
+/// <param name="source">The source from which bytes may be read.</param>
+/// <param name="bytesAvailable">The number of bytes that can be read from the source.</param>
+/// <param name="context">The context associated with this write function.</param>
+/// <returns>Result code for this callback. Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>
+/// When the call downloads parallel ranges (see HCHttpCallRequestSetParallelRanges), this callback is invoked
+/// concurrently for ranges that don't overlap, and the body arrives out of order. Otherwise it arrives in order.
+/// </remarks>
+typedef HRESULT
+(CALLBACK* HCHttpCallResponseBodyWriteAtFunction)(
+    _In_ HCCallHandle call,
+    _In_ uint64_t offset,
+    _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context
+    );
+
+/// <summary>
+/// Sets a custom callback function that will be used to write the response body at the offset each part of it belongs
+/// at. Like HCHttpCallResponseSetResponseBodyWriteFunction, it causes subsequent calls to
+/// HCHttpCallResponseGetResponseBodyBytesSize, HCHttpCallResponseGetResponseBodyBytes,
+/// and HCHttpCallGetResponseBodyString to fail, and replaces any write function set with it.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.</param>
+/// <param name="writeFunction">The response body write function this call should use.</param>
+/// <param name="context">The context to associate with this write function.</param>
+/// <returns>Result code of this API operation. Possible values are S_OK or E_INVALIDARG.</returns>
+/// <remarks>
+/// A call that is retried writes its body again from offset 0, unless it is resumable (see HCHttpCallRequestSetResumable).
+/// This must be called prior to calling HCHttpCallPerformAsync.
+/// </remarks>
+STDAPI HCHttpCallResponseSetResponseBodyWriteAtFunction(
+    _In_ HCCallHandle call,
+    _In_ HCHttpCallResponseBodyWriteAtFunction writeFunction,
+    _In_opt_ void* context
+    ) noexcept;
+
+/// <summary>
+/// How a streamed response body is divided into events for HCHttpCallResponseSetStreamEventFunction.
+/// </summary>
+enum class HCResponseStreamFormat : uint32_t
+{
+    /// <summary>Server-Sent Events (text/event-stream). The data lines of an event are joined with "\n".</summary>
+    ServerSentEvents = 0,
+
+    /// <summary>One record per line, such as newline-delimited JSON. A trailing "\r" is dropped and empty lines are skipped.</summary>
+    NewlineDelimited = 1,
+
+    /// <summary>Binary records, each preceded by its length in bytes as a 32-bit big-endian unsigned integer.</summary>
+    LengthPrefixed = 2
+};
+
+/// <summary>
+/// A complete event or record of a streamed response body.
+/// </summary>
+typedef struct HCResponseStreamEvent
+{
+    /// <summary>The Server-Sent Events event type, "message" unless the event named another. nullptr for other formats.</summary>
+    _Field_z_ const char* eventType;
+
+    /// <summary>The Server-Sent Events last event ID, which may be empty. nullptr for other formats.</summary>
+    _Field_z_ const char* id;
+
+    /// <summary>The event's data, or the whole record. It isn't null-terminated.</summary>
+    _Field_size_bytes_(dataSize) const uint8_t* data;
+
+    /// <summary>The size of data in bytes.</summary>
+    size_t dataSize;
+} HCResponseStreamEvent;
+
+/// <summary>
+/// The callback definition used by a streamed HTTP call to deliver each event of its response body.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.</param>
+/// <param name="event">The event. It is only valid for the duration of the callback.</param>
+/// <param name="context">The context associated with this callback.</param>
+typedef void
+(CALLBACK* HCHttpCallResponseStreamEventFunction)(
+    _In_ HCCallHandle call,
+    _In_ const HCResponseStreamEvent* event,
+    _In_opt_ void* context
+    );
+
+/// <summary>
+/// Sets this HTTP call to divide its response body into events as it arrives and pass each one to a callback, rather
+/// than keeping the body. This suits long-lived streaming endpoints.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.</param>
+/// <param name="format">How the body is divided into events.</param>
+/// <param name="queue">The queue the callback is invoked on, or nullptr to invoke it on the thread the body arrives on.</param>
+/// <param name="eventFunction">The callback.</param>
+/// <param name="context">The context to pass to the callback.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>
+/// Like HCHttpCallResponseSetResponseBodyWriteFunction, this causes HCHttpCallResponseGetResponseBodyBytesSize,
+/// HCHttpCallResponseGetResponseBodyBytes and HCHttpCallGetResponseBodyString to fail, and replaces any write function
+/// set before. Events are delivered in order. Without a queue each event points straight into the body as it arrived
+/// when it can; with one it is copied, and events may still be delivered after the call completes.
+/// Only 2xx responses are divided into events, and for Server-Sent Events only those with a text/event-stream
+/// Content-Type. The body of any other response is dropped. A record that isn't complete when the response ends is
+/// dropped too, and one larger than 16MB fails the call with E_HC_STREAM_RECORD_TOO_LARGE.
+/// A Server-Sent Events call that is allowed to retry (see HCHttpCallRequestSetRetryAllowed) reconnects whenever its
+/// 200 response ends or its connection fails, until it is canceled, the server responds with another status, or there
+/// is no network. The call's timeout window doesn't apply. It waits the time last sent in a "retry" field, 3 seconds
+/// by default and never less than 100ms, before reconnecting, and sends the last event ID it received in a
+/// Last-Event-ID header. Each attempt in a row that ends without an event doubles the wait, up to a minute. The call's
+/// timeout still applies to each connection, so a stream that should stay connected needs a timeout to match.
+/// This must be called prior to calling HCHttpCallPerformAsync.
+/// </remarks>
+STDAPI HCHttpCallResponseSetStreamEventFunction(
+    _In_ HCCallHandle call,
+    _In_ HCResponseStreamFormat format,
+    _In_opt_ XTaskQueueHandle queue,
+    _In_ HCHttpCallResponseStreamEventFunction eventFunction,
+    _In_opt_ void* context
+    ) noexcept;
+
 /////////////////////////////////////////////////////////////////////////////////////////
 // HttpCallResponse Get APIs
 // 
@@ -696,6 +1484,24 @@ STDAPI HCHttpCallResponseGetPlatformNetworkErrorMessage(
     _Out_ const char** platformNetworkErrorMessage
     ) noexcept;
 
+/// <summary>
+/// Get the number of response body bytes received and the number passed to the response body write function.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.</param>
+/// <param name="compressedBytes">The number of response body bytes received.</param>
+/// <param name="decompressedBytes">The number of response body bytes after decompression.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>
+/// Both counts are 0 unless HCHttpCallRequestSetResponseDecompression was enabled for the call, and they are equal
+/// if the response wasn't compressed.
+/// This can only be called after calling HCHttpCallPerformAsync when the HTTP task is completed.
+/// </remarks>
+STDAPI HCHttpCallResponseGetDecompressionStats(
+    _In_ HCCallHandle call,
+    _Out_ uint64_t* compressedBytes,
+    _Out_ uint64_t* decompressedBytes
+    ) noexcept;
+
 /// <summary>
 /// Get a response header for the HTTP call for a given header name.
 /// </summary>
@@ -920,6 +1726,24 @@ STDAPI HCWebSocketConnectAsync(
     _Inout_ XAsyncBlock* asyncBlock
     ) noexcept;
 
+/// <summary>
+/// Prepares for connecting a WebSocket to a server ahead of time.
+/// </summary>
+/// <param name="uri">The UTF-8 encoded URI that will be connected to.</param>
+/// <param name="asyncBlock">The XAsyncBlock that defines the async operation.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, E_HC_NOT_INITIALISED, E_NOTIMPL, or E_FAIL.</returns>
+/// <remarks>
+/// For a wss:// URI the server's host name is resolved and a TLS session is negotiated with it, which later
+/// WebSocket connections to the server resume with an abbreviated handshake. A ws:// URI completes right away, as
+/// there is no handshake to prepare. The work is done on the queue in the provided XAsyncBlock, and the handshake is
+/// counted by HCGetTlsSessionStats.
+/// Returns E_NOTIMPL on platforms whose WebSocket stack isn't OpenSSL.
+/// </remarks>
+STDAPI HCWebSocketPreconnectAsync(
+    _In_z_ const char* uri,
+    _Inout_ XAsyncBlock* asyncBlock
+    ) noexcept;
+
 /// <summary>
 /// Gets the result for HCGetWebSocketConnectResult.
 /// </summary>
@@ -1007,7 +1831,7 @@ STDAPI HCWebSocketCloseHandle(
     ) noexcept;
 
 /// <summary>
-/// A callback that will be synchronously invoked when websocket traffic is sent or received
+/// A callback that will be invoked when websocket traffic is sent or received, synchronously unless HCSetRoutedHandlerQueue has set a queue
 /// </summary>
 /// <param name="call">Handle to the HTTP call.</param>
 /// <param name="receiving">True if receiving the data, false if sending the data.</param>
@@ -135,6 +135,12 @@ STDAPI HCHttpCallRequestGetRequestBodyString(
     _Outptr_ const char** requestBody
     ) noexcept;
 
+/// <summary>
+/// The request body size reported by HCHttpCallRequestGetRequestBodyReadFunction when the size isn't known
+/// until the whole body has been read, e.g. when the body is compressed as it is sent.
+/// </summary>
+#define HC_UNKNOWN_REQUEST_BODY_SIZE SIZE_MAX
+
 /// <summary>
 /// Get the function used by the HTTP call to read the request body
 /// </summary>
@@ -143,6 +149,10 @@ STDAPI HCHttpCallRequestGetRequestBodyString(
 /// <param name="bodySize">The size of the body.</param>
 /// <param name="context">The context associated with this read function.</param>
 /// <returns>Result code for this API operation. Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>
+/// If bodySize is HC_UNKNOWN_REQUEST_BODY_SIZE, read until the read function returns 0 bytes and send the body
+/// with chunked transfer encoding.
+/// </remarks>
 STDAPI HCHttpCallRequestGetRequestBodyReadFunction(
     _In_ HCCallHandle call,
     _Out_ HCHttpCallRequestBodyReadFunction* readFunction,
@@ -202,6 +212,54 @@ STDAPI HCHttpCallRequestGetRetryAllowed(
     _Out_ bool* retryAllowed
     ) noexcept;
 
+/// <summary>
+/// Gets if a compressed response body is decompressed for this HTTP call.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.  Pass nullptr to get the default for future calls.</param>
+/// <param name="decompress">If a gzip or deflate encoded response body is decompressed.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>Defaults to false.</remarks>
+STDAPI HCHttpCallRequestGetResponseDecompression(
+    _In_opt_ HCCallHandle call,
+    _Out_ bool* decompress
+    ) noexcept;
+
+/// <summary>
+/// Gets the level the request body of this HTTP call is compressed with.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.  Pass nullptr to get the default for future calls.</param>
+/// <param name="level">The compression level of the request body.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>Defaults to HCCompressionLevel::None.</remarks>
+STDAPI HCHttpCallRequestGetCompression(
+    _In_opt_ HCCallHandle call,
+    _Out_ HCCompressionLevel* level
+    ) noexcept;
+
+/// <summary>
+/// Gets the HTTP protocol version used for this HTTP call.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.  Pass nullptr to get the default for future calls.</param>
+/// <param name="version">The HTTP protocol version.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>Defaults to HCHttpVersion::Default.</remarks>
+STDAPI HCHttpCallRequestGetHttpVersion(
+    _In_opt_ HCCallHandle call,
+    _Out_ HCHttpVersion* version
+    ) noexcept;
+
+/// <summary>
+/// Gets the priority of this HTTP call relative to other calls sharing its connection.
+/// </summary>
+/// <param name="call">The handle of the HTTP call.  Pass nullptr to get the default for future calls.</param>
+/// <param name="priority">The priority of the call.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, or E_FAIL.</returns>
+/// <remarks>Defaults to HCHttpCallPriority::Normal.</remarks>
+STDAPI HCHttpCallRequestGetPriority(
+    _In_opt_ HCCallHandle call,
+    _Out_ HCHttpCallPriority* priority
+    ) noexcept;
+
 /// <summary>
 /// Gets the ID number of this REST endpoint used to cache the Retry-After header for fast fail.
 /// </summary>
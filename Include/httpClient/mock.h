@@ -118,12 +118,138 @@ STDAPI HCMockRemoveMock(
     );
 
 /// <summary>
-/// Removes and cleans up all mock calls added by HCMockAddMock.
+/// Removes and cleans up all mock calls added by HCMockAddMock and all responses loaded by HCMockLoadCapture.
 /// </summary>
 /// <returns>Result code for this API operation.  Possible values are S_OK, or E_FAIL.</returns>
 STDAPI HCMockClearMocks() noexcept;
 
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// Capture & replay APIs
+// 
+
+/// <summary>
+/// Starts recording every HTTP call attempt to a compact binary capture file.
+/// </summary>
+/// <param name="filePath">UTF-8 encoded path of the capture file. An existing file is overwritten.</param>
+/// <param name="captureResponseBodies">If false, only the size and hash of each response body are recorded.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, E_HC_NOT_INITIALISED, E_HC_ALREADY_INITIALISED, or E_FAIL.</returns>
+/// <remarks>
+/// For each attempt the capture records the method, URL, request & response headers, a hash of the request body,
+/// the response status, network error codes, response body and timing. Records are written by a background thread,
+/// so capturing adds little overhead to the calls themselves. Only one capture can be active at a time.
+/// </remarks>
+STDAPI HCMockStartCapture(
+    _In_z_ const char* filePath,
+    _In_ bool captureResponseBodies
+    ) noexcept;
+
+/// <summary>
+/// Stops the active capture, flushing all records to the capture file before returning.
+/// </summary>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_HC_NOT_INITIALISED, or E_FAIL.</returns>
+STDAPI HCMockStopCapture() noexcept;
+
+/// <summary>
+/// Loads a capture file written by HCMockStartCapture() and replays its responses as mocks.
+/// </summary>
+/// <param name="filePath">UTF-8 encoded path of the capture file.</param>
+/// <param name="replayLatency">If true, each replayed call completes after the latency recorded for it.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, E_HC_NOT_INITIALISED, or E_FAIL.</returns>
+/// <remarks>
+/// Replayed responses are looked up by method, URL and request body, falling back to method and URL only.
+/// Responses recorded for the same request are returned in the order they were captured, and the last one 
+/// is repeated once they are exhausted. Mocks added with HCMockAddMock() take precedence over replayed 
+/// responses. Call HCMockClearMocks() to remove replayed responses.
+/// </remarks>
+STDAPI HCMockLoadCapture(
+    _In_z_ const char* filePath,
+    _In_ bool replayLatency
+    ) noexcept;
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// Network emulation APIs
+// 
+
+/// <summary>
+/// Defines how emulated response latency is distributed.
+/// </summary>
+enum class HCMockLatencyDistribution : uint32_t
+{
+    /// <summary>Every response takes latencyMs.</summary>
+    Constant = 0,
+
+    /// <summary>Latency is uniformly distributed between latencyMs and latencyMs + latencyDeviationMs.</summary>
+    Uniform = 1,
+
+    /// <summary>Latency is normally distributed with mean latencyMs and standard deviation latencyDeviationMs.</summary>
+    Normal = 2,
+
+    /// <summary>Latency is latencyMs plus an exponentially distributed tail with mean latencyDeviationMs.</summary>
+    Exponential = 3
+};
+
+/// <summary>
+/// Describes the network conditions emulated for calls to a host.
+/// </summary>
+typedef struct HCMockNetworkProfile
+{
+    /// <summary>How the latency before the response headers arrive is distributed.</summary>
+    HCMockLatencyDistribution latencyDistribution;
+
+    /// <summary>The base latency in milliseconds. See HCMockLatencyDistribution.</summary>
+    uint32_t latencyMs;
+
+    /// <summary>The latency spread in milliseconds. See HCMockLatencyDistribution.</summary>
+    uint32_t latencyDeviationMs;
+
+    /// <summary>The rate at which the response body is delivered, or 0 for no limit.</summary>
+    uint64_t bandwidthBytesPerSecond;
+
+    /// <summary>The size of each write to the response body write function, or 0 to deliver the body in a single write.</summary>
+    uint32_t chunkSizeBytes;
+
+    /// <summary>The probability from 0 to 1 that the response is lost and the call times out.</summary>
+    double lossProbability;
+
+    /// <summary>The probability from 0 to 1 that the connection is reset while the response body is delivered.</summary>
+    double resetProbability;
+} HCMockNetworkProfile;
+
+/// <summary>
+/// Registers the network emulator as the HTTP perform function.
+/// </summary>
+/// <returns>Result code for this API operation.  Possible values are S_OK, or E_HC_ALREADY_INITIALISED.</returns>
+/// <remarks>
+/// Must be called before HCInitialize. The emulator is registered using HCSetHttpCallPerformFunction().
+///
+/// Calls are matched against mocks added with HCMockAddMock() and responses loaded with HCMockLoadCapture(),
+/// and the matched response is delivered with the network conditions configured by HCMockSetNetworkProfile(). 
+/// Calls that don't match are passed, after the emulated latency, to the perform function that was set when this
+/// was called, which is the platform HTTP implementation unless HCSetHttpCallPerformFunction() replaced it.
+/// Canceling a call completes it with E_ABORT right away, even while an emulated delay is pending.
+/// All emulated delays are scheduled on the call's task queue, so no threads are blocked while waiting.
+/// </remarks>
+STDAPI HCMockEnableNetworkEmulation() noexcept;
+
+/// <summary>
+/// Sets the network conditions emulated for calls to a host.
+/// </summary>
+/// <param name="host">The UTF-8 encoded host name the profile applies to, or nullptr to set the default profile 
+/// used for hosts without their own profile.</param>
+/// <param name="profile">The profile to use, or nullptr to remove the host's profile.</param>
+/// <returns>Result code for this API operation.  Possible values are S_OK, E_INVALIDARG, E_HC_NOT_INITIALISED, or E_FAIL.</returns>
+/// <remarks>
+/// Profiles take effect for calls performed after this returns. The default profile emulates no latency, bandwidth
+/// limit or failures.
+/// </remarks>
+STDAPI HCMockSetNetworkProfile(
+    _In_opt_z_ const char* host,
+    _In_opt_ const HCMockNetworkProfile* profile
+    ) noexcept;
+
+
 /////////////////////////////////////////////////////////////////////////////////////////
 // HCMockResponse Set APIs
 // 
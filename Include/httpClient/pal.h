@@ -447,8 +447,19 @@ typedef struct _LIST_ENTRY {
 #define E_HC_NO_NETWORK                 MAKE_E_HC(0x5006) // 0x89235006
 #define E_HC_NETWORK_NOT_INITIALIZED    MAKE_E_HC(0x5007) // 0x89235007
 #define E_HC_INTERNAL_STILLINUSE        MAKE_E_HC(0x5008) // 0x89235008
+#define E_HC_COMPRESSED_DATA_INVALID    MAKE_E_HC(0x5009) // 0x89235009
+#define E_HC_RANGE_MISMATCH             MAKE_E_HC(0x500A) // 0x8923500A
+#define E_HC_STREAM_RECORD_TOO_LARGE    MAKE_E_HC(0x500B) // 0x8923500B
 
 typedef uint32_t HCMemoryType;
+
+// The memory types passed to the memory hooks, telling which part of the library memory is for
+#define HC_MEMORY_TYPE_GENERAL          0 // everything without a type of its own
+#define HC_MEMORY_TYPE_HTTP_CALL        1 // calls, with their url, headers and other metadata
+#define HC_MEMORY_TYPE_HTTP_BODY        2 // request and response bodies
+#define HC_MEMORY_TYPE_WEBSOCKET        3 // websockets and their messages
+#define HC_MEMORY_TYPE_THREAD_CACHE     4 // the slabs small allocations are made from, see HCMemSetThreadCachingEnabled
+#define HC_MEMORY_TYPE_COUNT            5
 typedef struct HC_WEBSOCKET* HCWebsocketHandle;
 typedef struct HC_CALL* HCCallHandle;
 typedef struct HC_MOCK_CALL* HCMockCallHandle;
@@ -0,0 +1,420 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#include "pch.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include "dns_resolver.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+namespace
+{
+
+// A lookup function leaves the TTL unset to get the configured default
+constexpr std::chrono::milliseconds TTL_UNSET{ -1 };
+
+}
+
+dns_resolver::~dns_resolver()
+{
+    {
+        std::lock_guard<std::mutex> lock{ m_lock };
+        m_stopping = true;
+    }
+    m_lookupQueued.notify_all();
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+
+    // Hosts still queued are never looked up
+    std::lock_guard<std::mutex> callbackLock{ m_callbackLock };
+    dns_result_ptr aborted;
+    try
+    {
+        auto result = http_allocate_shared<dns_result>();
+        result->hr = E_ABORT;
+        aborted = std::move(result);
+    }
+    catch (...)
+    {
+    }
+
+    for (auto& lookup : m_lookups)
+    {
+        for (auto const& waiter : lookup.second)
+        {
+            waiter.callback(waiter.context, waiter.cookie, aborted);
+        }
+    }
+}
+
+HRESULT dns_resolver::Initialize(_In_ dns_resolver_settings const& settings) noexcept
+try
+{
+    RETURN_HR_IF(E_INVALIDARG, settings.threadCount == 0 || settings.maxEntries == 0);
+    m_settings = settings;
+    if (m_settings.lookup == nullptr)
+    {
+        m_settings.lookup = SystemLookup;
+        m_settings.lookupContext = nullptr;
+    }
+
+    m_threads.reserve(m_settings.threadCount);
+    for (uint32_t i = 0; i < m_settings.threadCount; i++)
+    {
+        m_threads.emplace_back([this] { Run(); });
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+HRESULT dns_resolver::Resolve(
+    _In_ http_internal_string const& hostName,
+    _In_ dns_resolve_callback callback,
+    _In_opt_ void* context,
+    _In_ uint64_t cookie,
+    _Out_ dns_result_ptr* result
+) noexcept
+try
+{
+    *result = nullptr;
+
+    dns_address literal;
+    if (ParseLiteral(hostName, &literal))
+    {
+        auto literalResult = http_allocate_shared<dns_result>();
+        literalResult->addresses.push_back(literal);
+        *result = std::move(literalResult);
+        return S_OK;
+    }
+
+    http_internal_string key = NormalizeHostName(hostName);
+    auto now = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock{ m_lock };
+    RETURN_HR_IF(E_ABORT, m_stopping);
+
+    auto cached = m_cache.find(key);
+    if (cached != m_cache.end() && cached->second.expiry > now)
+    {
+        cache_entry& entry = cached->second;
+        ++m_hits;
+        ++entry.hits;
+        if (SUCCEEDED(entry.result->hr) &&
+            entry.hits >= m_settings.prefetchMinHits &&
+            entry.expiry - now <= m_settings.prefetchWindow &&
+            m_lookups.find(key) == m_lookups.end())
+        {
+            try
+            {
+                StartLookup(key);
+                ++m_prefetches;
+            }
+            catch (...)
+            {
+                // The entry is simply looked up again once it expires
+            }
+        }
+        *result = entry.result;
+        return S_OK;
+    }
+
+    auto lookup = m_lookups.find(key);
+    if (lookup != m_lookups.end())
+    {
+        lookup->second.push_back(waiter{ callback, context, cookie });
+        ++m_coalesced;
+        return E_PENDING;
+    }
+
+    StartLookup(key);
+    ++m_misses;
+    m_lookups[key].push_back(waiter{ callback, context, cookie });
+    return E_PENDING;
+}
+CATCH_RETURN()
+
+void dns_resolver::CancelCallbacks(_In_opt_ void* context) noexcept
+{
+    std::lock_guard<std::mutex> callbackLock{ m_callbackLock };
+    std::lock_guard<std::mutex> lock{ m_lock };
+    for (auto& lookup : m_lookups)
+    {
+        auto& waiters = lookup.second;
+        waiters.erase(std::remove_if(waiters.begin(), waiters.end(), [context](waiter const& w) { return w.context == context; }), waiters.end());
+    }
+}
+
+HRESULT dns_resolver::Prewarm(_In_reads_(hostNameCount) const char* const* hostNames, _In_ uint32_t hostNameCount) noexcept
+try
+{
+    RETURN_HR_IF(E_INVALIDARG, hostNames == nullptr && hostNameCount > 0);
+
+    auto now = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < hostNameCount; i++)
+    {
+        RETURN_HR_IF(E_INVALIDARG, hostNames[i] == nullptr || hostNames[i][0] == '\0');
+
+        dns_address literal;
+        http_internal_string hostName{ hostNames[i] };
+        if (ParseLiteral(hostName, &literal))
+        {
+            continue;
+        }
+
+        http_internal_string key = NormalizeHostName(hostName);
+        std::lock_guard<std::mutex> lock{ m_lock };
+        RETURN_HR_IF(E_ABORT, m_stopping);
+
+        auto cached = m_cache.find(key);
+        if ((cached != m_cache.end() && cached->second.expiry > now) || m_lookups.find(key) != m_lookups.end())
+        {
+            continue;
+        }
+        StartLookup(key);
+        ++m_prefetches;
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+HCDnsCacheStats dns_resolver::GetStats() const noexcept
+{
+    std::lock_guard<std::mutex> lock{ m_lock };
+    HCDnsCacheStats stats{};
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.coalesced = m_coalesced;
+    stats.prefetches = m_prefetches;
+
+    uint64_t resolutions = m_hits + m_misses + m_coalesced;
+    stats.hitRate = resolutions > 0 ? static_cast<double>(m_hits) / static_cast<double>(resolutions) : 0.0;
+    return stats;
+}
+
+dns_address dns_resolver::WithPort(_In_ dns_address const& address, _In_ uint16_t port) noexcept
+{
+    dns_address result = address;
+    if (result.address.ss_family == AF_INET)
+    {
+        reinterpret_cast<sockaddr_in*>(&result.address)->sin_port = htons(port);
+    }
+    else if (result.address.ss_family == AF_INET6)
+    {
+        reinterpret_cast<sockaddr_in6*>(&result.address)->sin6_port = htons(port);
+    }
+    return result;
+}
+
+http_internal_string dns_resolver::NormalizeHostName(_In_ http_internal_string const& hostName)
+{
+    http_internal_string key{ hostName };
+    std::transform(key.begin(), key.end(), key.begin(), [](char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; });
+    return key;
+}
+
+bool dns_resolver::ParseLiteral(_In_ http_internal_string const& hostName, _Out_ dns_address* address) noexcept
+{
+    *address = dns_address{};
+
+    // IPv6 literals keep their brackets in URLs
+    char buffer[INET6_ADDRSTRLEN];
+    const char* begin = hostName.c_str();
+    size_t size = hostName.size();
+    if (size >= 2 && begin[0] == '[' && begin[size - 1] == ']')
+    {
+        begin++;
+        size -= 2;
+    }
+    if (size >= sizeof(buffer))
+    {
+        return false;
+    }
+    std::memcpy(buffer, begin, size);
+    buffer[size] = '\0';
+
+    auto ipv4 = reinterpret_cast<sockaddr_in*>(&address->address);
+    if (inet_pton(AF_INET, buffer, &ipv4->sin_addr) == 1)
+    {
+        ipv4->sin_family = AF_INET;
+        address->size = sizeof(sockaddr_in);
+        return true;
+    }
+
+    auto ipv6 = reinterpret_cast<sockaddr_in6*>(&address->address);
+    if (inet_pton(AF_INET6, buffer, &ipv6->sin6_addr) == 1)
+    {
+        ipv6->sin6_family = AF_INET6;
+        address->size = sizeof(sockaddr_in6);
+        return true;
+    }
+    return false;
+}
+
+void dns_resolver::SystemLookup(_In_z_ const char* hostName, _In_opt_ void* /*context*/, _Inout_ dns_result& result, _Inout_ std::chrono::milliseconds& /*ttl*/)
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    int error = getaddrinfo(hostName, nullptr, &hints, &addresses);
+    if (error != 0 || addresses == nullptr)
+    {
+        result.hr = E_FAIL;
+        result.platformError = error;
+        return;
+    }
+
+    try
+    {
+        // Kept in the order getaddrinfo sorted them in
+        for (addrinfo* info = addresses; info != nullptr; info = info->ai_next)
+        {
+            if ((info->ai_family == AF_INET || info->ai_family == AF_INET6) && info->ai_addrlen <= sizeof(sockaddr_storage))
+            {
+                dns_address address;
+                std::memcpy(&address.address, info->ai_addr, info->ai_addrlen);
+                address.size = info->ai_addrlen;
+                result.addresses.push_back(address);
+            }
+        }
+    }
+    catch (...)
+    {
+        freeaddrinfo(addresses);
+        throw;
+    }
+    freeaddrinfo(addresses);
+
+    if (result.addresses.empty())
+    {
+        result.hr = E_FAIL;
+        result.platformError = EAI_NONAME;
+    }
+}
+
+void dns_resolver::StartLookup(_In_ http_internal_string const& hostName)
+{
+    // Queued first, so a host never shows as being looked up without a lookup to wait for
+    m_lookupQueue.push_back(hostName);
+    m_lookups[hostName];
+    m_lookupQueued.notify_one();
+}
+
+void dns_resolver::Store(_In_ http_internal_string const& hostName, _In_ dns_result_ptr const& result, _In_ std::chrono::milliseconds ttl)
+{
+    auto now = std::chrono::steady_clock::now();
+    auto existing = m_cache.find(hostName);
+    if (FAILED(result->hr) && existing != m_cache.end() && existing->second.expiry > now && SUCCEEDED(existing->second.result->hr))
+    {
+        // A failed refresh doesn't replace addresses that are still valid
+        return;
+    }
+    if (ttl.count() <= 0)
+    {
+        if (existing != m_cache.end())
+        {
+            m_cache.erase(existing);
+        }
+        return;
+    }
+
+    if (existing == m_cache.end() && m_cache.size() >= m_settings.maxEntries)
+    {
+        // Make room by dropping expired entries, or else the one closest to expiring
+        auto soonest = m_cache.end();
+        for (auto iter = m_cache.begin(); iter != m_cache.end();)
+        {
+            if (iter->second.expiry <= now)
+            {
+                iter = m_cache.erase(iter);
+                continue;
+            }
+            if (soonest == m_cache.end() || iter->second.expiry < soonest->second.expiry)
+            {
+                soonest = iter;
+            }
+            ++iter;
+        }
+        if (m_cache.size() >= m_settings.maxEntries && soonest != m_cache.end())
+        {
+            m_cache.erase(soonest);
+        }
+    }
+
+    cache_entry& entry = m_cache[hostName];
+    entry.result = result;
+    entry.expiry = now + ttl;
+    entry.hits = 0;
+}
+
+void dns_resolver::Run() noexcept
+{
+    while (true)
+    {
+        http_internal_string hostName;
+        {
+            std::unique_lock<std::mutex> lock{ m_lock };
+            m_lookupQueued.wait(lock, [this] { return m_stopping || !m_lookupQueue.empty(); });
+            if (m_stopping)
+            {
+                return;
+            }
+            hostName = std::move(m_lookupQueue.front());
+            m_lookupQueue.pop_front();
+        }
+        Lookup(hostName);
+    }
+}
+
+void dns_resolver::Lookup(_In_ http_internal_string const& hostName) noexcept
+{
+    dns_result_ptr result;
+    std::chrono::milliseconds ttl{ TTL_UNSET };
+    try
+    {
+        auto lookupResult = http_allocate_shared<dns_result>();
+        m_settings.lookup(hostName.c_str(), m_settings.lookupContext, *lookupResult, ttl);
+        if (ttl == TTL_UNSET)
+        {
+            ttl = SUCCEEDED(lookupResult->hr) ? m_settings.defaultTtl : m_settings.negativeTtl;
+        }
+        result = std::move(lookupResult);
+    }
+    catch (...)
+    {
+        // Waiters get a null result, and nothing is cached
+    }
+
+    std::lock_guard<std::mutex> callbackLock{ m_callbackLock };
+    http_internal_vector<waiter> waiters;
+    {
+        std::lock_guard<std::mutex> lock{ m_lock };
+        if (result != nullptr)
+        {
+            try
+            {
+                Store(hostName, result, ttl);
+            }
+            catch (...)
+            {
+            }
+        }
+
+        auto lookup = m_lookups.find(hostName);
+        if (lookup != m_lookups.end())
+        {
+            waiters.swap(lookup->second);
+            m_lookups.erase(lookup);
+        }
+    }
+
+    for (auto const& waiter : waiters)
+    {
+        waiter.callback(waiter.context, waiter.cookie, result);
+    }
+}
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
@@ -0,0 +1,147 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+#include "pch.h"
+#include <condition_variable>
+#include <sys/socket.h>
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+struct dns_address
+{
+    sockaddr_storage address{};
+    socklen_t size{ 0 };
+};
+
+// The outcome of resolving one host name. Failures are cached like any other result.
+struct dns_result
+{
+    HRESULT hr{ S_OK };
+    int platformError{ 0 }; // EAI_* code from getaddrinfo
+    http_internal_vector<dns_address> addresses;
+};
+
+using dns_result_ptr = std::shared_ptr<dns_result const>;
+
+// Looks up a host name, blocking the resolver thread, and reports how long the result may be cached for
+typedef void (*dns_lookup_function)(
+    _In_z_ const char* hostName,
+    _In_opt_ void* context,
+    _Inout_ dns_result& result,
+    _Inout_ std::chrono::milliseconds& ttl
+    );
+
+// Receives the result of a lookup that Resolve couldn't answer from the cache. The result is null if the resolver
+// ran out of memory.
+typedef void (*dns_resolve_callback)(
+    _In_opt_ void* context,
+    _In_ uint64_t cookie,
+    _In_ dns_result_ptr const& result
+    );
+
+// Tuning for dns_resolver
+struct dns_resolver_settings
+{
+    // Threads blocking in lookups. Lookups of different hosts run concurrently up to this limit.
+    uint32_t threadCount{ 2 };
+
+    // getaddrinfo doesn't report record TTLs, so its answers are cached for defaultTtl. A custom lookup function
+    // supplies its own TTLs.
+    std::chrono::milliseconds defaultTtl{ std::chrono::seconds(60) };
+    std::chrono::milliseconds negativeTtl{ std::chrono::seconds(5) };
+
+    // A host resolved at least prefetchMinHits times since it was last looked up is refreshed in the background once
+    // it is within prefetchWindow of expiring, so connections to it never wait on DNS
+    std::chrono::milliseconds prefetchWindow{ std::chrono::seconds(10) };
+    uint32_t prefetchMinHits{ 2 };
+
+    size_t maxEntries{ 512 };
+
+    // getaddrinfo when not set
+    dns_lookup_function lookup{ nullptr };
+    void* lookupContext{ nullptr };
+};
+
+// Caching host name resolver shared by the connections of a process. Lookups run on the resolver's own threads, so
+// resolving never blocks a caller, and concurrent resolutions of one host share a single lookup.
+class dns_resolver
+{
+public:
+    dns_resolver() noexcept = default;
+    dns_resolver(const dns_resolver&) = delete;
+    dns_resolver& operator=(const dns_resolver&) = delete;
+
+    // Completes every resolution still waiting with E_ABORT
+    ~dns_resolver();
+
+    HRESULT Initialize(_In_ dns_resolver_settings const& settings) noexcept;
+
+    // Returns S_OK with the cached result, or E_PENDING once a lookup has been started or joined, in which case
+    // callback is called with the cookie on a resolver thread when it finishes. IP literals are never looked up.
+    HRESULT Resolve(
+        _In_ http_internal_string const& hostName,
+        _In_ dns_resolve_callback callback,
+        _In_opt_ void* context,
+        _In_ uint64_t cookie,
+        _Out_ dns_result_ptr* result
+    ) noexcept;
+
+    // Drops pending callbacks to context, waiting for one that is already running to return
+    void CancelCallbacks(_In_opt_ void* context) noexcept;
+
+    // Starts lookups of the hosts that aren't cached
+    HRESULT Prewarm(_In_reads_(hostNameCount) const char* const* hostNames, _In_ uint32_t hostNameCount) noexcept;
+
+    HCDnsCacheStats GetStats() const noexcept;
+
+    // A resolved address with its port set
+    static dns_address WithPort(_In_ dns_address const& address, _In_ uint16_t port) noexcept;
+
+private:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    struct cache_entry
+    {
+        dns_result_ptr result;
+        time_point expiry;
+        uint32_t hits{ 0 };
+    };
+
+    struct waiter
+    {
+        dns_resolve_callback callback;
+        void* context;
+        uint64_t cookie;
+    };
+
+    static http_internal_string NormalizeHostName(_In_ http_internal_string const& hostName);
+    static bool ParseLiteral(_In_ http_internal_string const& hostName, _Out_ dns_address* address) noexcept;
+    static void SystemLookup(_In_z_ const char* hostName, _In_opt_ void* context, _Inout_ dns_result& result, _Inout_ std::chrono::milliseconds& ttl);
+
+    // Must hold m_lock
+    void StartLookup(_In_ http_internal_string const& hostName);
+    void Store(_In_ http_internal_string const& hostName, _In_ dns_result_ptr const& result, _In_ std::chrono::milliseconds ttl);
+
+    void Run() noexcept;
+    void Lookup(_In_ http_internal_string const& hostName) noexcept;
+
+    dns_resolver_settings m_settings;
+    http_internal_vector<std::thread> m_threads;
+
+    mutable std::mutex m_lock;
+    std::condition_variable m_lookupQueued;
+    bool m_stopping{ false };
+    http_internal_dequeue<http_internal_string> m_lookupQueue;
+    http_internal_map<http_internal_string, cache_entry> m_cache;
+    // Every host being looked up, with the resolutions waiting on it. Prefetches have none.
+    http_internal_map<http_internal_string, http_internal_vector<waiter>> m_lookups;
+    uint64_t m_hits{ 0 };
+    uint64_t m_misses{ 0 };
+    uint64_t m_coalesced{ 0 };
+    uint64_t m_prefetches{ 0 };
+
+    // Held while callbacks run so CancelCallbacks can wait them out
+    std::mutex m_callbackLock;
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
@@ -36,11 +36,14 @@
 #endif
 
 // STL includes
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <chrono>
 #include <condition_variable>
+#include <cstdarg>
 #include <cstdint>
+#include <cstring>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -0,0 +1,337 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#include "pch.h"
+#include "tls_session_cache.h"
+
+#if HC_TLS_SESSION_CACHE
+#include <openssl/bio.h>
+#include <openssl/crypto.h>
+#include <openssl/ssl.h>
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+namespace
+{
+
+// What a connection prepared by the cache needs once its handshake is under way
+struct tls_connection_state
+{
+    http_internal_string key;
+};
+
+void FreeConnectionState(void* /*parent*/, void* state, CRYPTO_EX_DATA* /*data*/, int /*index*/, long /*argl*/, void* /*argp*/)
+{
+    if (state != nullptr)
+    {
+        http_alloc_deleter<tls_connection_state>{}(static_cast<tls_connection_state*>(state));
+    }
+}
+
+int ContextIndex() noexcept
+{
+    static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+int ConnectionIndex() noexcept
+{
+    static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, FreeConnectionState);
+    return index;
+}
+
+std::mutex s_instanceLock;
+tls_session_cache* s_instance{ nullptr };
+uint32_t s_instanceReferences{ 0 };
+
+}
+
+HRESULT tls_session_cache::Acquire(_Out_ std::shared_ptr<tls_session_cache>* cache) noexcept
+try
+{
+    *cache = nullptr;
+
+    std::lock_guard<std::mutex> lock{ s_instanceLock };
+    if (s_instance == nullptr)
+    {
+        s_instance = http_allocate_unique<tls_session_cache>().release();
+    }
+
+    // Counted first: a shared_ptr that fails to allocate its control block releases the pointer it was given
+    ++s_instanceReferences;
+    *cache = std::shared_ptr<tls_session_cache>(s_instance, Release, http_stl_allocator<tls_session_cache>{});
+    return S_OK;
+}
+CATCH_RETURN()
+
+void tls_session_cache::Release(_In_ tls_session_cache* /*cache*/) noexcept
+{
+    std::lock_guard<std::mutex> lock{ s_instanceLock };
+    if (--s_instanceReferences == 0)
+    {
+        http_alloc_deleter<tls_session_cache>{}(s_instance);
+        s_instance = nullptr;
+    }
+}
+
+// Adding a duration takes it by reference, so C++14 needs this defined
+constexpr std::chrono::milliseconds tls_session_cache::TICKET_WAIT;
+
+tls_session_cache::~tls_session_cache()
+{
+    // Connections may keep a context alive past the cache, so it stops reporting to it
+    for (ssl_ctx_st* context : m_contexts)
+    {
+        if (context != nullptr)
+        {
+            SSL_CTX_set_ex_data(context, ContextIndex(), nullptr);
+            SSL_CTX_free(context);
+        }
+    }
+
+    for (auto& cached : m_sessions)
+    {
+        SSL_SESSION_free(cached.second.session);
+    }
+}
+
+HRESULT tls_session_cache::GetClientContext(_In_ tls_verification verification, _Out_ ssl_ctx_st** context) noexcept
+{
+    *context = nullptr;
+    RETURN_HR_IF(E_INVALIDARG, verification != tls_verification::peer && verification != tls_verification::none);
+
+    std::lock_guard<std::mutex> lock{ m_lock };
+    SSL_CTX*& shared = m_contexts[static_cast<size_t>(verification)];
+    if (shared == nullptr)
+    {
+        SSL_CTX* created = SSL_CTX_new(TLS_client_method());
+        RETURN_HR_IF(E_OUTOFMEMORY, created == nullptr);
+
+        SSL_CTX_set_options(created, SSL_OP_ALL);
+        SSL_CTX_set_verify(created, verification == tls_verification::peer ? SSL_VERIFY_PEER : SSL_VERIFY_NONE, nullptr);
+
+        // OpenSSL never looks up a client's sessions itself, it only hands them to OnNewSession
+        SSL_CTX_set_session_cache_mode(created, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(created, OnNewSession);
+
+        HRESULT hr = SSL_CTX_set_default_verify_paths(created) == 1 ? AttachToContext(created) : E_FAIL;
+        if (FAILED(hr))
+        {
+            SSL_CTX_free(created);
+            return hr;
+        }
+        shared = created;
+    }
+
+    SSL_CTX_up_ref(shared);
+    *context = shared;
+    return S_OK;
+}
+
+HRESULT tls_session_cache::PrepareConnection(_In_ ssl_st* connection, _In_z_ const char* hostName, _In_ uint16_t port) noexcept
+try
+{
+    RETURN_HR_IF(E_INVALIDARG, connection == nullptr || hostName == nullptr);
+    int index = ConnectionIndex();
+    RETURN_HR_IF(E_FAIL, index < 0);
+
+    auto state = http_allocate_unique<tls_connection_state>();
+    state->key = hostName;
+    std::transform(state->key.begin(), state->key.end(), state->key.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+    state->key += ":" + http_internal_string{ std::to_string(port).c_str() };
+
+    {
+        std::lock_guard<std::mutex> lock{ m_lock };
+        auto cached = m_sessions.find(state->key);
+        if (cached != m_sessions.end())
+        {
+            SSL_SESSION* session = cached->second.session;
+            bool usable = SSL_SESSION_is_resumable(session) && SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session) > static_cast<long>(time(nullptr));
+            if (usable)
+            {
+                (void)SSL_set_session(connection, session);
+                cached->second.lastUsed = ++m_lastUse;
+            }
+
+            // TLS 1.3 tickets are used once (RFC 8446 appendix C.4) so connections can't be linked by them. The
+            // connection will be sent fresh ones.
+            if (!usable || SSL_SESSION_get_protocol_version(session) >= TLS1_3_VERSION)
+            {
+                SSL_SESSION_free(session);
+                m_sessions.erase(cached);
+            }
+        }
+    }
+
+    FreeConnectionState(nullptr, SSL_get_ex_data(connection, index), nullptr, index, 0, nullptr);
+    RETURN_HR_IF(E_FAIL, SSL_set_ex_data(connection, index, state.get()) != 1);
+    (void)state.release();
+    return S_OK;
+}
+CATCH_RETURN()
+
+HRESULT tls_session_cache::Warm(_In_z_ const char* hostName, _In_ uint16_t port, _In_ tls_verification verification) noexcept
+try
+{
+    RETURN_HR_IF(E_INVALIDARG, hostName == nullptr || hostName[0] == '\0');
+
+    // IPv6 literals are bracketed so the port can be told apart
+    bool ipv6Literal = std::strchr(hostName, ':') != nullptr;
+    http_internal_string address = ipv6Literal ? "[" : "";
+    address += hostName;
+    address += ipv6Literal ? "]:" : ":";
+    address += std::to_string(port).c_str();
+
+    ssl_ctx_st* context = nullptr;
+    RETURN_IF_FAILED(GetClientContext(verification, &context));
+    BIO* connection = BIO_new_ssl_connect(context);
+    SSL_CTX_free(context); // the connection holds a reference of its own
+    RETURN_HR_IF(E_OUTOFMEMORY, connection == nullptr);
+
+    SSL* ssl = nullptr;
+    BIO_get_ssl(connection, &ssl);
+    HRESULT hr = ssl != nullptr && BIO_set_conn_hostname(connection, address.c_str()) == 1 ? S_OK : E_FAIL;
+    if (SUCCEEDED(hr))
+    {
+        (void)SSL_set_tlsext_host_name(ssl, hostName);
+        if (verification == tls_verification::peer && SSL_set1_host(ssl, hostName) != 1)
+        {
+            hr = E_FAIL;
+        }
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = PrepareConnection(ssl, hostName, port);
+    }
+    if (SUCCEEDED(hr) && BIO_do_handshake(connection) != 1)
+    {
+        HC_TRACE_ERROR(HTTPCLIENT, "tls_session_cache failed to negotiate a session with %s", address.c_str());
+        hr = E_FAIL;
+    }
+
+    if (SUCCEEDED(hr) && SSL_version(ssl) >= TLS1_3_VERSION)
+    {
+        // TLS 1.3 servers send their tickets after the handshake. They're picked up by reading, without blocking as
+        // nothing else is coming.
+        int fd = -1;
+        if (BIO_get_fd(connection, &fd) > 0 && BIO_socket_nbio(fd, 1) == 1)
+        {
+            auto deadline = std::chrono::steady_clock::now() + TICKET_WAIT;
+            while (!SSL_SESSION_is_resumable(SSL_get0_session(ssl)) && std::chrono::steady_clock::now() < deadline)
+            {
+                char data = 0;
+                int read = SSL_read(ssl, &data, sizeof(data));
+                if (read <= 0 && SSL_get_error(ssl, read) != SSL_ERROR_WANT_READ)
+                {
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+    }
+
+    BIO_free_all(connection);
+    return hr;
+}
+CATCH_RETURN()
+
+HRESULT tls_session_cache::CountHandshakes(_In_ ssl_ctx_st* context) noexcept
+{
+    RETURN_HR_IF(E_INVALIDARG, context == nullptr);
+    return AttachToContext(context);
+}
+
+bool tls_session_cache::IsLinkedOpenSsl(_In_opt_z_ const char* version) noexcept
+{
+    // "OpenSSL/3.0.2" against "OpenSSL 3.0.2 15 Mar 2022"
+    static const char name[] = "OpenSSL";
+    const size_t nameLength = sizeof(name) - 1;
+    const char* linked = OpenSSL_version(OPENSSL_VERSION);
+    if (version == nullptr || linked == nullptr || std::strncmp(version, name, nameLength) != 0 || std::strncmp(linked, name, nameLength) != 0)
+    {
+        return false;
+    }
+
+    version += nameLength + 1;
+    linked += nameLength + 1;
+    size_t versionLength = std::strcspn(version, " ");
+    return versionLength > 0 && versionLength == std::strcspn(linked, " ") && std::strncmp(version, linked, versionLength) == 0;
+}
+
+HCTlsSessionStats tls_session_cache::GetStats() const noexcept
+{
+    HCTlsSessionStats stats{};
+    stats.resumedHandshakes = m_resumedHandshakes;
+    stats.fullHandshakes = m_fullHandshakes;
+    return stats;
+}
+
+HRESULT tls_session_cache::AttachToContext(_In_ ssl_ctx_st* context) noexcept
+{
+    int index = ContextIndex();
+    RETURN_HR_IF(E_FAIL, index < 0 || SSL_CTX_set_ex_data(context, index, this) != 1);
+    SSL_CTX_set_info_callback(context, OnInfo);
+    return S_OK;
+}
+
+int tls_session_cache::OnNewSession(_In_ ssl_st* connection, _In_ ssl_session_st* session)
+{
+    auto cache = static_cast<tls_session_cache*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(connection), ContextIndex()));
+    auto state = static_cast<tls_connection_state*>(SSL_get_ex_data(connection, ConnectionIndex()));
+    if (cache == nullptr || state == nullptr)
+    {
+        // Not kept, OpenSSL frees it
+        return 0;
+    }
+
+    cache->Store(state->key, session);
+    return 1;
+}
+
+void tls_session_cache::OnInfo(_In_ const ssl_st* connection, _In_ int where, _In_ int /*result*/)
+{
+    if ((where & SSL_CB_HANDSHAKE_DONE) == 0)
+    {
+        return;
+    }
+
+    auto cache = static_cast<tls_session_cache*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(connection), ContextIndex()));
+    if (cache != nullptr)
+    {
+        ++(SSL_session_reused(connection) ? cache->m_resumedHandshakes : cache->m_fullHandshakes);
+    }
+}
+
+void tls_session_cache::Store(_In_ http_internal_string const& key, _In_ ssl_session_st* session) noexcept
+{
+    std::lock_guard<std::mutex> lock{ m_lock };
+    try
+    {
+        auto cached = m_sessions.find(key);
+        if (cached == m_sessions.end())
+        {
+            if (m_sessions.size() >= MAX_SESSIONS)
+            {
+                auto leastRecent = std::min_element(m_sessions.begin(), m_sessions.end(), [](auto const& l, auto const& r) { return l.second.lastUsed < r.second.lastUsed; });
+                SSL_SESSION_free(leastRecent->second.session);
+                m_sessions.erase(leastRecent);
+            }
+            cached = m_sessions.emplace(key, cached_session{ nullptr, 0 }).first;
+        }
+        else
+        {
+            SSL_SESSION_free(cached->second.session);
+        }
+
+        // Replaced by every session the server hands out, so the newest ticket is used next
+        cached->second.session = session;
+        cached->second.lastUsed = ++m_lastUse;
+    }
+    catch (...)
+    {
+        SSL_SESSION_free(session);
+    }
+}
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
+
+#endif
@@ -0,0 +1,86 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+#include "pch.h"
+
+#if HC_TLS_SESSION_CACHE
+
+struct ssl_ctx_st;
+struct ssl_st;
+struct ssl_session_st;
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+// How the peer's certificate is checked on connections made with a shared client context. A transport that checks it
+// itself, e.g. with a verify callback of its own, still uses the context of the mode it would otherwise have set.
+enum class tls_verification : uint32_t
+{
+    peer,
+    none
+};
+
+// Client TLS sessions of the process, keyed by host:port, so a reconnect resumes its session with an abbreviated
+// handshake instead of negotiating a new one. Session tickets and session IDs are both cached. There is one instance
+// while any transport holds it, shared by every OpenSSL based transport along with one client context per
+// verification mode.
+class tls_session_cache
+{
+public:
+    static HRESULT Acquire(_Out_ std::shared_ptr<tls_session_cache>* cache) noexcept;
+
+    tls_session_cache() noexcept = default;
+    tls_session_cache(const tls_session_cache&) = delete;
+    tls_session_cache& operator=(const tls_session_cache&) = delete;
+    ~tls_session_cache();
+
+    // Returns a new reference to the client context for the verification mode, created on first use. Connections made
+    // with it resume through this cache once PrepareConnection has been called on them.
+    HRESULT GetClientContext(_In_ tls_verification verification, _Out_ ssl_ctx_st** context) noexcept;
+
+    // Offers the session cached for host:port to a connection about to handshake, and files the sessions it is given
+    // under host:port
+    HRESULT PrepareConnection(_In_ ssl_st* connection, _In_z_ const char* hostName, _In_ uint16_t port) noexcept;
+
+    // Negotiates a session with host:port on a connection of its own and closes it once the session is cached, so the
+    // next connection to the server resumes it. Blocks until then, resolving the host name on the way.
+    HRESULT Warm(_In_z_ const char* hostName, _In_ uint16_t port, _In_ tls_verification verification) noexcept;
+
+    // Counts the handshakes of a context this cache didn't create, e.g. one of libcurl's, which caches its own sessions
+    HRESULT CountHandshakes(_In_ ssl_ctx_st* context) noexcept;
+
+    // Whether a TLS library reporting the version string, e.g. libcurl's "OpenSSL/3.0.2", is the OpenSSL this library
+    // is linked with, so contexts it hands out can be configured here
+    static bool IsLinkedOpenSsl(_In_opt_z_ const char* version) noexcept;
+
+    HCTlsSessionStats GetStats() const noexcept;
+
+    static constexpr size_t MAX_SESSIONS = 256;
+
+    // How long Warm waits for the tickets a TLS 1.3 server sends after its handshake
+    static constexpr std::chrono::milliseconds TICKET_WAIT{ 1000 };
+
+private:
+    struct cached_session
+    {
+        ssl_session_st* session;
+        uint64_t lastUsed;
+    };
+
+    static void Release(_In_ tls_session_cache* cache) noexcept;
+    static int OnNewSession(_In_ ssl_st* connection, _In_ ssl_session_st* session);
+    static void OnInfo(_In_ const ssl_st* connection, _In_ int where, _In_ int result);
+    HRESULT AttachToContext(_In_ ssl_ctx_st* context) noexcept;
+    void Store(_In_ http_internal_string const& key, _In_ ssl_session_st* session) noexcept;
+
+    std::mutex m_lock;
+    ssl_ctx_st* m_contexts[2]{};
+    http_internal_map<http_internal_string, cached_session> m_sessions;
+    uint64_t m_lastUse{ 0 };
+
+    std::atomic<uint64_t> m_resumedHandshakes{ 0 };
+    std::atomic<uint64_t> m_fullHandshakes{ 0 };
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
+
+#endif
@@ -8,134 +8,165 @@ NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
 
 void AppendPortToString(String& string, uint16_t port);
 
-/// <summary>
-/// Legal characters in the scheme portion include:
-/// - Any alphanumeric character
-/// - '+' (plus)
-/// - '-' (hyphen)
-/// - '.' (period)
-///
-/// Note that the scheme must BEGIN with an alpha character.
-/// </summary>
-bool IsSchemeCharacter(char c);
-
-/// <summary>
-/// Unreserved characters are those that are allowed in a URI but do not have a reserved purpose. They include:
-/// - A-Z
-/// - a-z
-/// - 0-9
-/// - '-' (hyphen)
-/// - '.' (period)
-/// - '_' (underscore)
-/// - '~' (tilde)
-/// </summary>
-bool IsUnreserved(char c);
-
-/// <summary>
-/// Subdelimiters are those characters that may have a defined meaning within component
-/// of a uri for a particular scheme. They do not serve as delimiters in any case between
-/// uri segments. sub_delimiters include:
-/// - All of these !$&amp;'()*+,;=
-/// </summary>
-bool IsSubDelim(char c);
-
-/// <summary>
-/// Legal characters in the registered name host portion include:
-/// - Any unreserved character
-/// - The percent character ('%'), and thus any percent-endcoded octet
-/// - The sub-delimiters
-/// </summary>
-bool IsRegNameCharacter(char c);
-
-/// <summary>
-/// Legal characters in the user information portion include:
-/// - Any unreserved character
-/// - The percent character ('%'), and thus any percent-endcoded octet
-/// - The sub-delimiters
-/// - ':' (colon)
-/// </summary>
-bool IsUserInfoCharacter(char c);
-
-/// <summary>
-/// Legal characters in the path portion include:
-/// - Any unreserved character
-/// - The percent character ('%'), and thus any percent-endcoded octet
-/// - The sub-delimiters
-/// - ':' (colon)
-/// - '@' (ampersand)
-/// </summary>
-bool IsPathCharacter(char c);
-
-/// <summary>
-/// Legal characters in the query portion include:
-/// - Any path character
-/// - '?' (question mark)
-/// </summary>
-bool IsQueryCharacter(char c);
-
-/// <summary>
-/// Legal characters in a key or value of an encoded query string form include:
-/// - Any path character (Excluding '&' and '=')
-/// - '?' (question mark)
-/// </summary>
-bool IsQueryKeyOrValueCharacter(char c);
-
-/// <summary>
-/// Legal characters in the fragment portion include:
-/// - Any path character
-/// - '?' (question mark)
-/// </summary>
-bool IsFragmentCharacter(char c);
+namespace
+{
+
+// The classes of characters the components of a URI are made of, see CHARACTER_CLASSES
+enum character_class : uint8_t
+{
+    /// Legal characters in the scheme portion include:
+    /// - Any alphanumeric character
+    /// - '+' (plus)
+    /// - '-' (hyphen)
+    /// - '.' (period)
+    ///
+    /// Note that the scheme must BEGIN with an alpha character.
+    SCHEME_CHARACTER = 0x01,
+
+    /// Legal characters in the registered name host portion include:
+    /// - Any unreserved character: A-Z, a-z, 0-9, '-' (hyphen), '.' (period), '_' (underscore) or '~' (tilde)
+    /// - The percent character ('%'), and thus any percent-endcoded octet
+    /// - The sub-delimiters: !$&amp;'()*+,;=
+    REG_NAME_CHARACTER = 0x02,
+
+    /// Legal characters in the user information portion include:
+    /// - Any registered name character
+    /// - ':' (colon)
+    USER_INFO_CHARACTER = 0x04,
+
+    /// Legal characters in the path portion include:
+    /// - Any registered name character
+    /// - '/' (slash)
+    /// - ':' (colon)
+    /// - '@' (ampersand)
+    PATH_CHARACTER = 0x08,
+
+    /// Legal characters in the query and fragment portions include:
+    /// - Any path character
+    /// - '?' (question mark)
+    QUERY_CHARACTER = 0x10,
+
+    /// Legal characters in a key or value of an encoded query string form include:
+    /// - Any query character, excluding '&' and '='
+    QUERY_KEY_OR_VALUE_CHARACTER = 0x20,
+
+    HEX_CHARACTER = 0x40,
+    DIGIT_CHARACTER = 0x80
+};
+
+// The character classes of each character, so the parser can find the end of a component with one lookup per character
+const uint8_t CHARACTER_CLASSES[256]
+{
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x3e, 0x00, 0x00, 0x3e, 0x3e, 0x1e, 0x3e, 0x3e, 0x3e, 0x3e, 0x3f, 0x3e, 0x3f, 0x3f, 0x38, //  !"#$%&'()*+,-./
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3c, 0x3e, 0x00, 0x1e, 0x00, 0x30, // 0123456789:;<=>?
+    0x38, 0x7f, 0x7f, 0x7f, 0x7f, 0x7f, 0x7f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, // @ABCDEFGHIJKLMNO
+    0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x00, 0x00, 0x00, 0x00, 0x3e, // PQRSTUVWXYZ[\]^_
+    0x00, 0x7f, 0x7f, 0x7f, 0x7f, 0x7f, 0x7f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, // `abcdefghijklmno
+    0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x00, 0x00, 0x00, 0x3e, 0x00, // pqrstuvwxyz{|}~
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+inline bool IsCharacterClass(char c, uint8_t characterClass) noexcept
+{
+    return (CHARACTER_CLASSES[static_cast<uint8_t>(c)] & characterClass) != 0;
+}
+
+// Returns the first character from it on that isn't of the given class
+inline char const* SkipCharacterClass(char const* it, char const* end, uint8_t characterClass) noexcept
+{
+    while (it != end && IsCharacterClass(*it, characterClass))
+    {
+        ++it;
+    }
+    return it;
+}
+
+bool IsQueryKeyOrValueCharacter(char c)
+{
+    return IsCharacterClass(c, QUERY_KEY_OR_VALUE_CHARACTER);
+}
+
+void AppendLowercase(String& string, char const* begin, char const* end)
+{
+    for (; begin != end; ++begin)
+    {
+        char c = *begin;
+        string.push_back(c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c);
+    }
+}
+
+}
 
 Uri::Uri() : m_valid(false)
 {
 }
 
-Uri::Uri(String const& uri)
+Uri::Uri(_In_z_ char const* uri) : Uri(uri, strlen(uri))
+{
+}
+
+Uri::Uri(String const& uri) : Uri(uri.data(), uri.size())
+{
+}
+
+Uri::Uri(_In_reads_(length) char const* uri, size_t length)
+{
+    Parse(uri, length);
+    BuildBuffer(uri, length);
+}
+
+void Uri::Parse(_In_reads_(length) char const* uri, size_t length)
 {
-    m_uri = uri;
-    String::const_iterator it = uri.begin();
+    char const* begin = uri;
+    char const* end = uri + length;
+    char const* it = begin;
 
-    if (!ParseScheme(uri, it))
+    if (!ParseScheme(begin, end, it))
     {
         return;
     }
 
-    if (!ParseAuthority(uri, it))
+    if (!ParseAuthority(begin, end, it))
     {
         return;
     }
 
-    if (it != uri.end() && *it == '/')
+    if (it != end && *it == '/')
     {
-        if (!ParsePath(uri, it))
+        if (!ParsePath(begin, end, it))
         {
             return;
         }
     }
-    else
-    {
-        // Canonicalize path by making an empty path a '/'
-        m_path = "/";
-    }
 
-    if (it != uri.end() && *it == '?')
+    if (it != end && *it == '?')
     {
-        if (!ParseQuery(uri, it, true))
+        ++it; // Skip the '?'
+        if (!ParseQuery(begin, end, it))
         {
             return;
         }
     }
 
-    if (it != uri.end() && *it == '#')
+    if (it != end && *it == '#')
     {
-        if (!ParseFragment(uri, it, true))
+        ++it; // Skip the '#'
+        if (!ParseFragment(begin, end, it))
         {
             return;
         }
     }
 
-    if (it != uri.end())
+    if (it != end)
     {
         HC_TRACE_WARNING(HTTPCLIENT, "Unexpected delimiter in URI."); // no tracing uris they could contain PII
         return;
@@ -144,29 +175,73 @@ Uri::Uri(String const& uri)
     m_valid = true;
 }
 
+void Uri::BuildBuffer(_In_reads_(length) char const* uri, size_t length)
+{
+    // Canonicalize path by making an empty path a '/'
+    static char const DEFAULT_PATH[] = "/";
+    char const* pathSource = uri;
+    if (m_valid && m_path.length == 0)
+    {
+        pathSource = DEFAULT_PATH;
+        m_path = Component{ 0, 1 };
+    }
+
+    m_buffer.reserve(length + m_scheme.length + m_userInfo.length + m_host.length + m_path.length + m_query.length + m_fragment.length + 7);
+
+    auto append = [this](Component& component, char const* source, bool lowercase)
+    {
+        size_t offset = m_buffer.size();
+        if (lowercase)
+        {
+            // Canonicalize the scheme and host by lowercasing them
+            AppendLowercase(m_buffer, source + component.offset, source + component.offset + component.length);
+        }
+        else
+        {
+            m_buffer.append(source + component.offset, component.length);
+        }
+        m_buffer.push_back('\0');
+        component.offset = offset;
+    };
+
+    m_uri = Component{ 0, length };
+    append(m_uri, uri, false);
+    append(m_scheme, uri, true);
+    append(m_userInfo, uri, false);
+    append(m_host, uri, true);
+    append(m_path, pathSource, false);
+    append(m_query, uri, false);
+    append(m_fragment, uri, false);
+}
+
+UriComponent Uri::Get(Component const& component) const noexcept
+{
+    return UriComponent{ m_buffer.c_str() + component.offset, component.length };
+}
+
 bool Uri::IsValid() const
 {
     return m_valid;
 }
 
-String const& Uri::FullPath() const
+UriComponent Uri::FullPath() const
 {
-    return m_uri;
+    return Get(m_uri);
 }
 
-String const& Uri::Scheme() const
+UriComponent Uri::Scheme() const
 {
-    return m_scheme;
+    return Get(m_scheme);
 }
 
-String const& Uri::UserInfo() const
+UriComponent Uri::UserInfo() const
 {
-    return m_userInfo;
+    return Get(m_userInfo);
 }
 
-String const& Uri::Host() const
+UriComponent Uri::Host() const
 {
-    return m_host;
+    return Get(m_host);
 }
 
 uint16_t Uri::Port() const
@@ -174,49 +249,85 @@ uint16_t Uri::Port() const
     return m_port;
 }
 
-String const& Uri::Path() const
+UriComponent Uri::Path() const
 {
-    return m_path;
+    return Get(m_path);
 }
 
-String const& Uri::Query() const
+UriComponent Uri::Query() const
 {
-    return m_query;
+    return Get(m_query);
 }
 
 void Uri::SetQuery(String&& query)
 {
-    auto it = query.cbegin();
-    if (!ParseQuery(query, it, false) || it != query.end())
+    if (!m_valid || SkipCharacterClass(query.data(), query.data() + query.size(), QUERY_CHARACTER) != query.data() + query.size())
     {
         //THROW(E_FAIL, "Attempting to set invalid query on URI.");
+        return;
     }
+
+    Rebuild(UriComponent{ query.data(), query.size() }, Fragment());
 }
 
-String const& Uri::Fragment() const
+UriComponent Uri::Fragment() const
 {
-    return m_fragment;
+    return Get(m_fragment);
 }
 
 void Uri::SetFragment(String&& fragment)
 {
-    auto it = fragment.cbegin();
-    if (!ParseFragment(fragment, it, false) || it != fragment.end())
+    if (!m_valid || SkipCharacterClass(fragment.data(), fragment.data() + fragment.size(), QUERY_CHARACTER) != fragment.data() + fragment.size())
     {
         //THROW(E_FAIL, "Attempting to set invalid fragment on URI.");
+        return;
     }
+
+    Rebuild(Query(), UriComponent{ fragment.data(), fragment.size() });
+}
+
+void Uri::Rebuild(UriComponent query, UriComponent fragment)
+{
+    String uri{ Scheme().data(), Scheme().size() };
+    uri += "://";
+    uri += Authority();
+    uri.append(Path().data(), Path().size());
+
+    if (!query.empty())
+    {
+        uri += '?';
+        uri.append(query.data(), query.size());
+    }
+
+    if (!fragment.empty())
+    {
+        uri += '#';
+        uri.append(fragment.data(), fragment.size());
+    }
+
+    *this = Uri{ uri };
 }
 
 String Uri::Authority() const
 {
-    String s{ m_userInfo };
+    String s{ UserInfo().data(), UserInfo().size() };
     
     if (!s.empty())
     {
         s += '@';
     }
 
-    s += m_host;
+    // Only an IPv6 literal can contain ':', and it has to be bracketed again to tell it from the port
+    bool const ipv6 = std::find(Host().begin(), Host().end(), ':') != Host().end();
+    if (ipv6)
+    {
+        s += '[';
+    }
+    s.append(Host().data(), Host().size());
+    if (ipv6)
+    {
+        s += ']';
+    }
 
     AppendPortToString(s, m_port);
 
@@ -225,18 +336,18 @@ String Uri::Authority() const
 
 String Uri::Resource() const
 {
-    String s{ m_path };
+    String s{ Path().data(), Path().size() };
 
-    if (!m_query.empty())
+    if (!Query().empty())
     {
         s += "?";
-        s += m_query;
+        s.append(Query().data(), Query().size());
     }
 
-    if (!m_fragment.empty())
+    if (!Fragment().empty())
     {
         s += "#";
-        s += m_fragment;
+        s.append(Fragment().data(), Fragment().size());
     }
 
     return s;
@@ -244,7 +355,7 @@ String Uri::Resource() const
 
 String Uri::ToString() const
 {
-    String s{ m_scheme };
+    String s{ Scheme().data(), Scheme().size() };
     s += "://";
     s += Authority();
     s += Resource();
@@ -433,94 +544,79 @@ String Uri::ToString() const
     return encodedString;
 }
 
-bool Uri::ParseScheme(String const& uri, String::const_iterator& it)
+bool Uri::ParseScheme(char const* begin, char const* end, char const*& it)
 {
-    if (it == uri.end())
+    if (it == end)
     {
         HC_TRACE_WARNING(HTTPCLIENT, "Missing scheme in URI."); // no tracing uris they could contain PII
         return false;
     }
 
-    auto schemeEnd = it;
-
-    if (!IsAlpha(*schemeEnd)) // We've already checked we have at least 1 character
+    if (!IsAlpha(*it)) // We've already checked we have at least 1 character
     {
         HC_TRACE_WARNING(HTTPCLIENT, "Scheme must start with a letter."); // no tracing uris they could contain PII
         return false;
     }
 
-    ++schemeEnd;
-    for (; schemeEnd != uri.end() && *schemeEnd != ':'; ++schemeEnd)
+    char const* schemeEnd = SkipCharacterClass(it + 1, end, SCHEME_CHARACTER);
+    if (schemeEnd == end)
     {
-        if (!IsSchemeCharacter(*schemeEnd))
-        {
-            HC_TRACE_WARNING(HTTPCLIENT, "Invalid character found in scheme."); // no tracing uris they could contain PII
-            return false;
-        }
+        HC_TRACE_WARNING(HTTPCLIENT, "Cannot detect scheme in URI."); // no tracing uris they could contain PII
+        return false;
     }
-
-    if (schemeEnd == uri.end())
+    else if (*schemeEnd != ':')
     {
-        HC_TRACE_WARNING(HTTPCLIENT, "Cannot detect scheme in URI."); // no tracing uris they could contain PII
+        HC_TRACE_WARNING(HTTPCLIENT, "Invalid character found in scheme."); // no tracing uris they could contain PII
         return false;
     }
 
-    m_scheme.assign(it, schemeEnd);
+    m_scheme = Component{ static_cast<size_t>(it - begin), static_cast<size_t>(schemeEnd - it) };
     it = schemeEnd + 1; // consume the ':'
-
-    // Canonicalize the scheme by lowercasing it
-    BasicAsciiLowercase(m_scheme);
-
     return true;
 }
 
-bool Uri::ParseAuthority(String const& uri, String::const_iterator& it)
+bool Uri::ParseAuthority(char const* begin, char const* end, char const*& it)
 {
     // Authority must begin with "//"
     for (size_t i = 0; i < 2; ++i, ++it)
     {
-        if (it == uri.end() || *it != '/')
+        if (it == end || *it != '/')
         {
             HC_TRACE_WARNING(HTTPCLIENT, "Authority is required in URI."); // no tracing uris they could contain PII
             return false;
         }
     }
 
-    if (!ParseUserInfo(uri, it) ||
-        !ParseHost(uri, it))
+    if (!ParseUserInfo(begin, end, it) ||
+        !ParseHost(begin, end, it))
     {
         return false;
     }
 
-    if (it != uri.end() && *it == ':')
+    if (it != end && *it == ':')
     {
-        return ParsePort(uri, it);
+        return ParsePort(begin, end, it);
     }
 
     return true;
 }
 
-bool Uri::ParseUserInfo(String const& uri, String::const_iterator& it)
+bool Uri::ParseUserInfo(char const* begin, char const* end, char const*& it)
 {
-    auto userEnd = it;
-    while (userEnd != uri.end() && IsUserInfoCharacter(*userEnd))
-    {
-        ++userEnd;
-    }
-
-    if (userEnd != uri.end() && *userEnd == '@')
+    char const* userEnd = SkipCharacterClass(it, end, USER_INFO_CHARACTER);
+    if (userEnd != end && *userEnd == '@')
     {
         // This means we have a user info
-        m_userInfo.assign(it, userEnd);
+        m_userInfo = Component{ static_cast<size_t>(it - begin), static_cast<size_t>(userEnd - it) };
         it = userEnd + 1; // consume the '@'
     }
 
     return true; // User info is optional. We never fail here.
 }
 
-bool Uri::ParseHost(String const& uri, String::const_iterator& it)
+bool Uri::ParseHost(char const* begin, char const* end, char const*& it)
 {
-    if (it == uri.end())
+    if (it == end)
     {
         HC_TRACE_WARNING(HTTPCLIENT, "Missing host in URI."); // no tracing uris they could contain PII
         return false;
@@ -536,9 +632,9 @@ bool Uri::ParseHost(String const& uri, String::const_iterator& it)
         ++it; // consume the '['
               // IPv6 literal
               // extract IPv6 digits until ']'
-        auto hostEnd = std::find(it, uri.end(), ']');
+        char const* hostEnd = std::find(it, end, ']');
 
-        if (hostEnd == uri.end())
+        if (hostEnd == end)
         {
             HC_TRACE_WARNING(HTTPCLIENT, "Cannot parse IPv6 literal."); // no tracing uris they could contain PII
             return false;
@@ -551,16 +647,16 @@ bool Uri::ParseHost(String const& uri, String::const_iterator& it)
         else
         {
             // Validate the IPv6 address
-            for (auto tempIt = it; tempIt != hostEnd; ++tempIt)
+            for (char const* tempIt = it; tempIt != hostEnd; ++tempIt)
             {
-                if (*tempIt != ':' && !IsHexChar(*tempIt))
+                if (*tempIt != ':' && !IsCharacterClass(*tempIt, HEX_CHARACTER))
                 {
                     HC_TRACE_WARNING(HTTPCLIENT, "Invalid character found in IPv6 literal."); // no tracing uris they could contain PII
                     return false;
                 }
             }
 
-            m_host.assign(it, hostEnd);
+            m_host = Component{ static_cast<size_t>(it - begin), static_cast<size_t>(hostEnd - it) };
         }
 
         it = hostEnd + 1; // consume the ']'
@@ -569,123 +665,95 @@ bool Uri::ParseHost(String const& uri, String::const_iterator& it)
     {
         // IPv4 or registered name
         // extract until : or / or ? or #
-        String::const_iterator hostEnd = it;
-        for (; hostEnd != uri.end() && *hostEnd != ':' && *hostEnd != '/' && *hostEnd != '?' && *hostEnd != '#'; ++hostEnd)
+        char const* hostEnd = SkipCharacterClass(it, end, REG_NAME_CHARACTER);
+        if (hostEnd != end && *hostEnd != ':' && *hostEnd != '/' && *hostEnd != '?' && *hostEnd != '#')
         {
-            if (!IsRegNameCharacter(*hostEnd))
-            {
-                HC_TRACE_WARNING(HTTPCLIENT, "Invalid character found in host."); // no tracing uris they could contain PII
-                return false;
-            }
+            HC_TRACE_WARNING(HTTPCLIENT, "Invalid character found in host."); // no tracing uris they could contain PII
+            return false;
         }
 
-        m_host.assign(it, hostEnd);
+        m_host = Component{ static_cast<size_t>(it - begin), static_cast<size_t>(hostEnd - it) };
         it = hostEnd;
-        if (m_host.empty())
+        if (m_host.length == 0)
         {
             HC_TRACE_WARNING(HTTPCLIENT, "Empty host name in URI."); // no tracing uris they could contain PII
             return false;
         }
     }
 
-    // Canonicalize the host by lowercasing it
-    BasicAsciiLowercase(m_host);
-
     return true;
 }
 
-bool Uri::ParsePort(String const& uri, String::const_iterator& it)
+bool Uri::ParsePort(char const* /*begin*/, char const* end, char const*& it)
 {
     ASSERT(*it == ':');
     ++it; // Skip the ':'
 
-    auto portEnd = it;
-    size_t portLen = 0;
-    for (; portEnd != uri.end() && IsNum(*portEnd); ++portEnd)
-    {
-        ++portLen;
-    }
-
-    if (portLen == 0)
+    char const* portEnd = SkipCharacterClass(it, end, DIGIT_CHARACTER);
+    if (portEnd == it)
     {
         return true; // Port characters are optional
     }
 
-    char const* port = &*it;
-    uint64_t portV = 0;
-    if (!StringToUint4(port, port + portLen, portV, 0))
+    // Parsed here rather than with strtoull, which would read past the end of a URI that isn't null terminated
+    uint32_t port = 0;
+    for (char const* digit = it; digit != portEnd; ++digit)
     {
-        HC_TRACE_WARNING(HTTPCLIENT, "Cannot parse port in URI."); // no tracing uris they could contain PII
-        return false;
+        port = port * 10 + static_cast<uint32_t>(*digit - '0');
+        if (port > UINT16_MAX)
+        {
+            HC_TRACE_WARNING(HTTPCLIENT, "Cannot parse port in URI."); // no tracing uris they could contain PII
+            return false;
+        }
     }
 
-    m_port = static_cast<uint16_t>(portV);
+    m_port = static_cast<uint16_t>(port);
     it = portEnd;
 
     return true;
 }
 
-bool Uri::ParsePath(String const& uri, String::const_iterator& it)
+bool Uri::ParsePath(char const* begin, char const* end, char const*& it)
 {
     ASSERT(*it == '/');
 
-    auto pathEnd = it;
-    for (; pathEnd != uri.end() && *pathEnd != '?' && *pathEnd != '#'; ++pathEnd)
+    char const* pathEnd = SkipCharacterClass(it, end, PATH_CHARACTER);
+    if (pathEnd != end && *pathEnd != '?' && *pathEnd != '#')
     {
-        if (!IsPathCharacter(*pathEnd))
-        {
-            HC_TRACE_WARNING(HTTPCLIENT, "Invalid character found in path."); // no tracing uris they could contain PII
-            return false;
-        }
+        HC_TRACE_WARNING(HTTPCLIENT, "Invalid character found in path."); // no tracing uris they could contain PII
+        return false;
     }
 
-    m_path.assign(it, pathEnd);
+    m_path = Component{ static_cast<size_t>(it - begin), static_cast<size_t>(pathEnd - it) };
     it = pathEnd;
     return true;
 }
 
-bool Uri::ParseQuery(String const& uri, String::const_iterator& it, bool expectQuestion)
+bool Uri::ParseQuery(char const* begin, char const* end, char const*& it)
 {
-    if (expectQuestion)
+    char const* queryEnd = SkipCharacterClass(it, end, QUERY_CHARACTER);
+    if (queryEnd != end && *queryEnd != '#')
     {
-        ASSERT(*it == '?');
-        ++it; // Skip the '?'
-    }
-
-    auto queryEnd = it;
-    for (; queryEnd != uri.end() && *queryEnd != '#'; ++queryEnd)
-    {
-        if (!IsQueryCharacter(*queryEnd))
-        {
-            HC_TRACE_WARNING(HTTPCLIENT, "Invalid character found in query."); // no tracing uris they could contain PII
-            return false;
-        }
+        HC_TRACE_WARNING(HTTPCLIENT, "Invalid character found in query."); // no tracing uris they could contain PII
+        return false;
     }
 
-    m_query.assign(it, queryEnd);
+    m_query = Component{ static_cast<size_t>(it - begin), static_cast<size_t>(queryEnd - it) };
     it = queryEnd;
     return true;
 }
 
-bool Uri::ParseFragment(String const& uri, String::const_iterator& it, bool expectOctothorpe)
+bool Uri::ParseFragment(char const* begin, char const* end, char const*& it)
 {
-    if (expectOctothorpe)
+    // this is intentional, fragments have the same set of legal characters as queries
+    char const* fragmentEnd = SkipCharacterClass(it, end, QUERY_CHARACTER);
+    if (fragmentEnd != end)
     {
-        ASSERT(*it == '#');
-        ++it; // Skip the '#'
-    }
-
-    auto fragmentEnd = it;
-    for (; fragmentEnd != uri.end(); ++fragmentEnd)
-    {
-        if (!IsFragmentCharacter(*fragmentEnd))
-        {
-            HC_TRACE_WARNING(HTTPCLIENT, "Invalid character found in fragment."); // no tracing uris they could contain PII
-            return false;
-        }
+        HC_TRACE_WARNING(HTTPCLIENT, "Invalid character found in fragment."); // no tracing uris they could contain PII
+        return false;
     }
 
-    m_fragment.assign(it, fragmentEnd);
+    m_fragment = Component{ static_cast<size_t>(it - begin), static_cast<size_t>(fragmentEnd - it) };
     it = fragmentEnd;
     return true;
 }
@@ -700,66 +768,4 @@ void AppendPortToString(String& string, uint16_t port)
     AppendFormat(string, ":%u", port);
 }
 
-bool IsSchemeCharacter(char c)
-{
-    return IsAlnum(c) || c == '+' || c == '-' || c == '.';
-}
-
-bool IsUnreserved(char c)
-{
-    return IsAlnum(c) || c == '-' || c == '.' || c == '_' || c == '~';
-}
-
-bool IsSubDelim(char c)
-{
-    switch (c)
-    {
-    case '!':
-    case '$':
-    case '&':
-    case '\'':
-    case '(':
-    case ')':
-    case '*':
-    case '+':
-    case ',':
-    case ';':
-    case '=':
-        return true;
-    default:
-        return false;
-    }
-}
-
-bool IsRegNameCharacter(char c)
-{
-    return IsUnreserved(c) || IsSubDelim(c) || c == '%';
-}
-
-bool IsUserInfoCharacter(char c)
-{
-    return IsUnreserved(c) || IsSubDelim(c) || c == '%' || c == ':';
-}
-
-bool IsPathCharacter(char c)
-{
-    return IsUnreserved(c) || IsSubDelim(c) || c == '%' || c == '/' || c == ':' || c == '@';
-}
-
-bool IsQueryCharacter(char c)
-{
-    return IsPathCharacter(c) || c == '?';
-}
-
-bool IsQueryKeyOrValueCharacter(char c)
-{
-    return IsQueryCharacter(c) && c != '=' && c != '&';
-}
-
-bool IsFragmentCharacter(char c)
-{
-    // this is intentional, they have the same set of legal characters
-    return IsQueryCharacter(c);
-}
-
-NAMESPACE_XBOX_HTTP_CLIENT_END
\ No newline at end of file
+NAMESPACE_XBOX_HTTP_CLIENT_END
@@ -5,11 +5,51 @@
 
 NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
 
+// A null terminated component of a parsed Uri. It points into the Uri's buffer, so it is only valid for as long
+// as the Uri it came from isn't changed or destroyed.
+class UriComponent
+{
+public:
+    UriComponent(_In_reads_(size) char const* data, size_t size) noexcept : m_data{ data }, m_size{ size }
+    {
+    }
+
+    char const* data() const noexcept { return m_data; }
+    char const* c_str() const noexcept { return m_data; }
+    size_t size() const noexcept { return m_size; }
+    bool empty() const noexcept { return m_size == 0; }
+    char const* begin() const noexcept { return m_data; }
+    char const* end() const noexcept { return m_data + m_size; }
+
+    String str() const
+    {
+        return String{ m_data, m_size };
+    }
+
+    bool operator==(_In_z_ char const* other) const noexcept
+    {
+        return strncmp(m_data, other, m_size) == 0 && other[m_size] == '\0';
+    }
+
+    bool operator!=(_In_z_ char const* other) const noexcept
+    {
+        return !(*this == other);
+    }
+
+private:
+    char const* m_data;
+    size_t m_size;
+};
+
+// Parses a URI into its components. The parsed URI is kept in a single buffer, holding the URI as it was given
+// followed by each of its canonicalized components, so parsing makes at most one allocation and copying a Uri one more.
 class Uri
 {
 public:
     Uri();
+    explicit Uri(_In_z_ char const* uri);
     explicit Uri(String const& uri);
+    Uri(_In_reads_(length) char const* uri, size_t length);
 
     bool IsValid() const;
 
@@ -28,15 +68,15 @@ public:
         return Host().empty();
     }
 
-    String const& FullPath() const;
-    String const& Scheme() const;
-    String const& UserInfo() const;
-    String const& Host() const;
+    UriComponent FullPath() const;
+    UriComponent Scheme() const;
+    UriComponent UserInfo() const;
+    UriComponent Host() const;
     uint16_t Port() const;
-    String const& Path() const;
-    String const& Query() const;
+    UriComponent Path() const;
+    UriComponent Query() const;
     void SetQuery(String&& query);
-    String const& Fragment() const;
+    UriComponent Fragment() const;
     void SetFragment(String&& query);
 
     String Authority() const;
@@ -48,28 +88,41 @@ public:
     static String FormQuery(Map<String, String> const& queryMap);
 
 private:
-    String m_uri;
-    String m_scheme;
-    String m_userInfo;
-    String m_host;
-    String m_path;
-    String m_query;
-    String m_fragment;
+    // Where a component is, in the input while parsing and in m_buffer once it is built
+    struct Component
+    {
+        size_t offset;
+        size_t length;
+    };
+
+    String m_buffer;
+    Component m_uri{};
+    Component m_scheme{};
+    Component m_userInfo{};
+    Component m_host{};
+    Component m_path{};
+    Component m_query{};
+    Component m_fragment{};
     uint16_t m_port = 0;
     bool m_valid = false;
 
-    bool ParseScheme(String const& uri, String::const_iterator& it);
-    bool ParseAuthority(String const& uri, String::const_iterator& it);
-    bool ParseUserInfo(String const& uri, String::const_iterator& it);
-    bool ParseHost(String const& uri, String::const_iterator& it);
-    bool ParsePort(String const& uri, String::const_iterator& it);
-    bool ParsePath(String const& uri, String::const_iterator& it);
-    bool ParseQuery(String const& uri, String::const_iterator& it, bool expectQuestion);
-    bool ParseFragment(String const& uri, String::const_iterator& it, bool expectOctothorpe);
+    void Parse(_In_reads_(length) char const* uri, size_t length);
+    void BuildBuffer(_In_reads_(length) char const* uri, size_t length);
+    UriComponent Get(Component const& component) const noexcept;
+    void Rebuild(UriComponent query, UriComponent fragment);
+
+    bool ParseScheme(char const* begin, char const* end, char const*& it);
+    bool ParseAuthority(char const* begin, char const* end, char const*& it);
+    bool ParseUserInfo(char const* begin, char const* end, char const*& it);
+    bool ParseHost(char const* begin, char const* end, char const*& it);
+    bool ParsePort(char const* begin, char const* end, char const*& it);
+    bool ParsePath(char const* begin, char const* end, char const*& it);
+    bool ParseQuery(char const* begin, char const* end, char const*& it);
+    bool ParseFragment(char const* begin, char const* end, char const*& it);
 
     static String Decode(String const& urlPart);
     static String EncodeQueryStringPart(String const& part);
     static String EncodeString(String const& originalString, bool(*characterAllowed)(char));
 };
 
-NAMESPACE_XBOX_HTTP_CLIENT_END
\ No newline at end of file
+NAMESPACE_XBOX_HTTP_CLIENT_END
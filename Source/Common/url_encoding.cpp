@@ -0,0 +1,414 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "url_encoding.h"
+
+// The vector width is picked when compiling: AVX2 where the compiler targets it, otherwise SSE2, which every x64
+// target has. Other targets use the scalar functions.
+#if defined(__AVX2__)
+#define HC_URL_ENCODING_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HC_URL_ENCODING_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && (HC_URL_ENCODING_AVX2 || HC_URL_ENCODING_SSE2)
+#include <intrin.h>
+#endif
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+namespace
+{
+
+const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+// 1 for each character percent-encoding keeps as it is: A-Z, a-z, 0-9, '-' (hyphen), '.' (period), '_' (underscore)
+// and '~' (tilde)
+const uint8_t UNRESERVED_CHARACTERS[256]
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, //  !"#$%&'()*+,-./
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, // 0123456789:;<=>?
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // @ABCDEFGHIJKLMNO
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1, // PQRSTUVWXYZ[\]^_
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // `abcdefghijklmno
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0, // pqrstuvwxyz{|}~
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+inline bool IsUnreserved(char c) noexcept
+{
+    return UNRESERVED_CHARACTERS[static_cast<uint8_t>(c)] != 0;
+}
+
+inline char* EncodeByte(char c, char* out) noexcept
+{
+    uint8_t v = static_cast<uint8_t>(c);
+    out[0] = '%';
+    out[1] = HEX_DIGITS[v >> 4];
+    out[2] = HEX_DIGITS[v & 0xF];
+    return out + 3;
+}
+
+// Whether the '%' at it, with remaining bytes left in the input, starts a valid escape
+inline bool IsEscape(char const* it, size_t remaining) noexcept
+{
+    uint8_t v = 0;
+    return remaining >= 3 && HexDecodePair(it[1], it[2], v);
+}
+
+inline char DecodeEscape(char const* it) noexcept
+{
+    uint8_t v = 0;
+    HexDecodePair(it[1], it[2], v);
+    return static_cast<char>(v);
+}
+
+#if HC_URL_ENCODING_AVX2 || HC_URL_ENCODING_SSE2
+#define HC_URL_ENCODING_SIMD 1
+
+inline uint32_t CountTrailingZeros(uint32_t v) noexcept
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward(&index, v);
+    return index;
+#else
+    return static_cast<uint32_t>(__builtin_ctz(v));
+#endif
+}
+
+inline uint32_t CountBits(uint32_t v) noexcept
+{
+    // Not __popcnt, which needs a CPU newer than SSE2 alone promises
+    v = v - ((v >> 1) & 0x55555555);
+    v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+    return (((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+// The mask a block of BLOCK_SIZE bytes all needing no escaping gives
+#if HC_URL_ENCODING_AVX2
+const size_t BLOCK_SIZE = 32;
+const uint32_t BLOCK_MASK = 0xFFFFFFFF;
+#else
+const size_t BLOCK_SIZE = 16;
+const uint32_t BLOCK_MASK = 0xFFFF;
+#endif
+
+// The vectors hold signed bytes, so lo <= x < lo + n is tested as x - lo - 128 < n - 128: the subtraction moves the
+// range to the bottom of the signed range, where a single signed comparison bounds it on both sides.
+inline char RangeBias(char lo) noexcept
+{
+    return static_cast<char>(static_cast<uint8_t>(lo) + 128);
+}
+
+inline char RangeLimit(uint8_t n) noexcept
+{
+    return static_cast<char>(n - 128);
+}
+
+#if HC_URL_ENCODING_AVX2
+
+// A bit set for each of the 32 bytes at input that needs no escaping
+inline uint32_t UnreservedMask(_In_reads_(32) char const* input) noexcept
+{
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(input));
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i alpha = _mm256_cmpgt_epi8(_mm256_set1_epi8(RangeLimit(26)), _mm256_sub_epi8(lower, _mm256_set1_epi8(RangeBias('a'))));
+    __m256i digit = _mm256_cmpgt_epi8(_mm256_set1_epi8(RangeLimit(10)), _mm256_sub_epi8(v, _mm256_set1_epi8(RangeBias('0'))));
+    __m256i mark = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('-')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('.'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('~'))));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(alpha, digit), mark)));
+}
+
+// A bit set for each of the 32 bytes at input that is a '%'
+inline uint32_t PercentMask(_In_reads_(32) char const* input) noexcept
+{
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(input));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('%'))));
+}
+
+#else
+
+// A bit set for each of the 16 bytes at input that needs no escaping
+inline uint32_t UnreservedMask(_In_reads_(16) char const* input) noexcept
+{
+    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(input));
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i alpha = _mm_cmplt_epi8(_mm_sub_epi8(lower, _mm_set1_epi8(RangeBias('a'))), _mm_set1_epi8(RangeLimit(26)));
+    __m128i digit = _mm_cmplt_epi8(_mm_sub_epi8(v, _mm_set1_epi8(RangeBias('0'))), _mm_set1_epi8(RangeLimit(10)));
+    __m128i mark = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('-')), _mm_cmpeq_epi8(v, _mm_set1_epi8('.'))),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('_')), _mm_cmpeq_epi8(v, _mm_set1_epi8('~'))));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), mark)));
+}
+
+// A bit set for each of the 16 bytes at input that is a '%'
+inline uint32_t PercentMask(_In_reads_(16) char const* input) noexcept
+{
+    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(input));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('%'))));
+}
+
+#endif
+#endif
+
+}
+
+size_t UrlEncodedLengthScalar(_In_reads_(length) char const* input, size_t length) noexcept
+{
+    size_t encodedLength = length;
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (!IsUnreserved(input[i]))
+        {
+            encodedLength += 2;
+        }
+    }
+    return encodedLength;
+}
+
+size_t UrlEncodedLength(_In_reads_(length) char const* input, size_t length) noexcept
+{
+#if HC_URL_ENCODING_SIMD
+    size_t escapes = 0;
+    size_t i = 0;
+    for (; i + BLOCK_SIZE <= length; i += BLOCK_SIZE)
+    {
+        escapes += CountBits(~UnreservedMask(input + i) & BLOCK_MASK);
+    }
+    return i + escapes * 2 + UrlEncodedLengthScalar(input + i, length - i);
+#else
+    return UrlEncodedLengthScalar(input, length);
+#endif
+}
+
+size_t UrlEncodeScalar(_In_reads_(length) char const* input, size_t length, _Out_ char* output) noexcept
+{
+    char* out = output;
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (IsUnreserved(input[i]))
+        {
+            *out++ = input[i];
+        }
+        else
+        {
+            out = EncodeByte(input[i], out);
+        }
+    }
+    return static_cast<size_t>(out - output);
+}
+
+size_t UrlEncode(_In_reads_(length) char const* input, size_t length, _Out_ char* output) noexcept
+{
+#if HC_URL_ENCODING_SIMD
+    char* out = output;
+    size_t i = 0;
+    for (; i + BLOCK_SIZE <= length; i += BLOCK_SIZE)
+    {
+        // The runs between the bytes to escape are copied as they are. Encoding never makes the input shorter, so
+        // while a whole block of input is left there is a block of output left too, and each run is copied as a
+        // whole block, its excess overwritten by what follows.
+        uint32_t escapes = ~UnreservedMask(input + i) & BLOCK_MASK;
+        size_t copied = 0;
+        while (escapes != 0)
+        {
+            size_t next = CountTrailingZeros(escapes);
+            memcpy(out, input + i + copied, i + copied + BLOCK_SIZE <= length ? BLOCK_SIZE : next - copied);
+            out = EncodeByte(input[i + next], out + (next - copied));
+            copied = next + 1;
+            escapes &= escapes - 1;
+        }
+        memcpy(out, input + i + copied, BLOCK_SIZE - copied);
+        out += BLOCK_SIZE - copied;
+    }
+    return static_cast<size_t>(out - output) + UrlEncodeScalar(input + i, length - i, out);
+#else
+    return UrlEncodeScalar(input, length, output);
+#endif
+}
+
+bool UrlDecodedLengthScalar(_In_reads_(length) char const* input, size_t length, _Out_ size_t& decodedLength) noexcept
+{
+    decodedLength = 0;
+    size_t i = 0;
+    while (i < length)
+    {
+        if (input[i] == '%')
+        {
+            if (!IsEscape(input + i, length - i))
+            {
+                return false;
+            }
+            i += 3;
+        }
+        else
+        {
+            ++i;
+        }
+        ++decodedLength;
+    }
+    return true;
+}
+
+bool UrlDecodedLength(_In_reads_(length) char const* input, size_t length, _Out_ size_t& decodedLength) noexcept
+{
+#if HC_URL_ENCODING_SIMD
+    decodedLength = 0;
+    size_t escapes = 0;
+    size_t i = 0;
+    while (i + BLOCK_SIZE <= length)
+    {
+        uint32_t percents = PercentMask(input + i);
+        if (percents == 0)
+        {
+            i += BLOCK_SIZE;
+            continue;
+        }
+
+        i += CountTrailingZeros(percents);
+        if (!IsEscape(input + i, length - i))
+        {
+            return false;
+        }
+        i += 3;
+        ++escapes;
+    }
+
+    size_t tailLength = 0;
+    if (!UrlDecodedLengthScalar(input + i, length - i, tailLength))
+    {
+        return false;
+    }
+    decodedLength = i - escapes * 2 + tailLength;
+    return true;
+#else
+    return UrlDecodedLengthScalar(input, length, decodedLength);
+#endif
+}
+
+size_t UrlDecodeScalar(_In_reads_(length) char const* input, size_t length, _Out_ char* output) noexcept
+{
+    char* out = output;
+    size_t i = 0;
+    while (i < length)
+    {
+        if (input[i] == '%')
+        {
+            *out++ = DecodeEscape(input + i);
+            i += 3;
+        }
+        else
+        {
+            *out++ = input[i++];
+        }
+    }
+    return static_cast<size_t>(out - output);
+}
+
+size_t UrlDecode(_In_reads_(length) char const* input, size_t length, _Out_ char* output) noexcept
+{
+#if HC_URL_ENCODING_SIMD
+    char* out = output;
+    size_t i = 0;
+    while (i + BLOCK_SIZE <= length)
+    {
+        // Everything up to the next '%' is copied as it is
+        uint32_t percents = PercentMask(input + i);
+        size_t run = percents == 0 ? BLOCK_SIZE : CountTrailingZeros(percents);
+        memcpy(out, input + i, run);
+        out += run;
+        i += run;
+        if (percents != 0)
+        {
+            *out++ = DecodeEscape(input + i);
+            i += 3;
+        }
+    }
+    return static_cast<size_t>(out - output) + UrlDecodeScalar(input + i, length - i, out);
+#else
+    return UrlDecodeScalar(input, length, output);
+#endif
+}
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
+
+using namespace xbox::httpclient;
+
+STDAPI HCUrlEncode(
+    _In_reads_bytes_(inputSize) const char* input,
+    _In_ size_t inputSize,
+    _In_ size_t bufferSize,
+    _Out_writes_bytes_to_opt_(bufferSize, *bufferUsed) char* buffer,
+    _Out_ size_t* bufferUsed
+    ) noexcept
+try
+{
+    if ((input == nullptr && inputSize > 0) || bufferUsed == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    *bufferUsed = UrlEncodedLength(input, inputSize);
+    if (buffer == nullptr)
+    {
+        return S_OK;
+    }
+    if (bufferSize < *bufferUsed)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    UrlEncode(input, inputSize, buffer);
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI HCUrlDecode(
+    _In_reads_bytes_(inputSize) const char* input,
+    _In_ size_t inputSize,
+    _In_ size_t bufferSize,
+    _Out_writes_bytes_to_opt_(bufferSize, *bufferUsed) char* buffer,
+    _Out_ size_t* bufferUsed
+    ) noexcept
+try
+{
+    if ((input == nullptr && inputSize > 0) || bufferUsed == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    *bufferUsed = 0;
+    size_t decodedLength = 0;
+    if (!UrlDecodedLength(input, inputSize, decodedLength))
+    {
+        return E_INVALIDARG;
+    }
+
+    *bufferUsed = decodedLength;
+    if (buffer == nullptr)
+    {
+        return S_OK;
+    }
+    if (bufferSize < decodedLength)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    UrlDecode(input, inputSize, buffer);
+    return S_OK;
+}
+CATCH_RETURN()
@@ -0,0 +1,34 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+// Percent-encoding of URL components (RFC 3986 section 2.1). Encoding keeps the unreserved characters A-Z, a-z, 0-9,
+// '-', '.', '_' and '~' as they are and escapes every other byte as %XX, so the result can be used in any component,
+// a query string key or value included. Decoding turns each %XX back into its byte and leaves everything else, '+'
+// included, as it is.
+//
+// The functions write into a buffer the caller has sized with the matching length function, so building a URL takes
+// no intermediate strings. Where the compiler targets SSE2 or AVX2 they classify 16 or 32 bytes at a time, and copy
+// runs that need no escaping as they are; the *Scalar variants do the same one byte at a time, and are what other
+// targets use.
+
+// The length of input once encoded
+size_t UrlEncodedLength(_In_reads_(length) char const* input, size_t length) noexcept;
+size_t UrlEncodedLengthScalar(_In_reads_(length) char const* input, size_t length) noexcept;
+
+// Encodes input into output, which must hold UrlEncodedLength(input, length) bytes. Returns the bytes written.
+size_t UrlEncode(_In_reads_(length) char const* input, size_t length, _Out_ char* output) noexcept;
+size_t UrlEncodeScalar(_In_reads_(length) char const* input, size_t length, _Out_ char* output) noexcept;
+
+// The length of input once decoded, or false if it has a '%' not followed by two hex digits
+bool UrlDecodedLength(_In_reads_(length) char const* input, size_t length, _Out_ size_t& decodedLength) noexcept;
+bool UrlDecodedLengthScalar(_In_reads_(length) char const* input, size_t length, _Out_ size_t& decodedLength) noexcept;
+
+// Decodes input, which UrlDecodedLength must have accepted, into output, which must hold the length it returned.
+// Returns the bytes written.
+size_t UrlDecode(_In_reads_(length) char const* input, size_t length, _Out_ char* output) noexcept;
+size_t UrlDecodeScalar(_In_reads_(length) char const* input, size_t length, _Out_ char* output) noexcept;
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
@@ -176,15 +176,20 @@ public:
     virtual ~hc_task() {}
 };
 
-static inline int str_icmp(const http_internal_string& left, const http_internal_string& right)
+static inline int str_icmp(_In_z_ const char* left, _In_z_ const char* right)
 {
 #if HC_PLATFORM_IS_MICROSOFT
-    return _stricmp(left.c_str(), right.c_str());
+    return _stricmp(left, right);
 #else
-    return strcasecmp(left.c_str(), right.c_str());
+    return strcasecmp(left, right);
 #endif
 }
 
+static inline int str_icmp(const http_internal_string& left, const http_internal_string& right)
+{
+    return str_icmp(left.c_str(), right.c_str());
+}
+
 typedef std::function<void()> AsyncWork;
 
 HRESULT RunAsync(
@@ -36,6 +36,12 @@ HRESULT http_singleton::singleton_access(
         {
             HCTraceImplInit();
 
+#if HC_TLS_SESSION_CACHE
+            // Acquired ahead of the platform so its transports join this instance
+            std::shared_ptr<tls_session_cache> tlsSessionCache;
+            RETURN_IF_FAILED(tls_session_cache::Acquire(&tlsSessionCache));
+#endif
+
             PerformEnv performEnv;
             RETURN_IF_FAILED(Internal_InitializeHttpPlatform(createArgs, performEnv));
 
@@ -47,6 +53,9 @@ HRESULT http_singleton::singleton_access(
                 std::move(performEnv)
                 );
             s_singleton->m_self = s_singleton;
+#if HC_TLS_SESSION_CACHE
+            s_singleton->m_tlsSessionCache = std::move(tlsSessionCache);
+#endif
         }
 
         ++s_useCount;
@@ -182,6 +191,9 @@ HRESULT http_singleton::cleanup_async(
             // cleanup tracing now that we are done
             HCTraceImplCleanup();
 
+            // return the slabs that are no longer in use to the memory hooks
+            http_memory::trim();
+
             XAsyncComplete(data->async, S_OK, 0);
             return S_OK;
         }
@@ -214,6 +226,11 @@ http_singleton::~http_singleton()
         HCHttpCallCloseHandle(mockCall);
     }
     m_mocks.clear();
+
+    if (m_capture)
+    {
+        m_capture->Stop();
+    }
 }
 
 std::shared_ptr<http_singleton> get_http_singleton()
@@ -221,6 +238,13 @@ std::shared_ptr<http_singleton> get_http_singleton()
     return http_singleton::get();
 }
 
+handle_table& shared_ptr_cache::table() noexcept
+{
+    // Process wide so store, fetch & remove don't need to take the singleton lock
+    static handle_table s_table;
+    return s_table;
+}
+
 void http_singleton::set_retry_state(
     _In_ uint32_t retryAfterCacheId,
     _In_ const http_retry_after_api_state& state)
@@ -256,7 +280,7 @@ void http_singleton::clear_retry_state(_In_ uint32_t retryAfterCacheId)
 
 HRESULT http_singleton::set_global_proxy(_In_ const char* proxyUri)
 {
-#if HC_PLATFORM == HC_PLATFORM_WIN32
+#if HC_PLATFORM == HC_PLATFORM_WIN32 || (HC_PLATFORM == HC_PLATFORM_GENERIC && HC_CURL_HTTP)
     return Internal_SetGlobalProxy(m_performEnv.get(), proxyUri);
 #else
     UNREFERENCED_PARAMETER(proxyUri);
@@ -264,6 +288,73 @@ HRESULT http_singleton::set_global_proxy(_In_ const char* proxyUri)
 #endif
 }
 
+HRESULT http_singleton::prewarm_dns_cache(_In_reads_(hostNameCount) const char* const* hostNames, _In_ uint32_t hostNameCount)
+{
+#if HC_PLATFORM == HC_PLATFORM_GENERIC && HC_EPOLL_HTTP
+    return Internal_PrewarmDnsCache(m_performEnv.get(), hostNames, hostNameCount);
+#else
+    UNREFERENCED_PARAMETER(hostNames);
+    UNREFERENCED_PARAMETER(hostNameCount);
+    return E_NOTIMPL;
+#endif
+}
+
+HRESULT http_singleton::get_dns_cache_stats(_Out_ HCDnsCacheStats* stats)
+{
+#if HC_PLATFORM == HC_PLATFORM_GENERIC && HC_EPOLL_HTTP
+    return Internal_GetDnsCacheStats(m_performEnv.get(), stats);
+#else
+    UNREFERENCED_PARAMETER(stats);
+    return E_NOTIMPL;
+#endif
+}
+
+HRESULT http_singleton::get_tls_session_stats(_Out_ HCTlsSessionStats* stats)
+{
+#if HC_TLS_SESSION_CACHE
+    *stats = m_tlsSessionCache->GetStats();
+    return S_OK;
+#else
+    UNREFERENCED_PARAMETER(stats);
+    return E_NOTIMPL;
+#endif
+}
+
+HRESULT http_singleton::preconnect(_In_z_ const char* url, _In_ uint32_t connectionCount, _Inout_ XAsyncBlock* asyncBlock)
+{
+#if HC_PLATFORM == HC_PLATFORM_GENERIC && (HC_EPOLL_HTTP || HC_CURL_HTTP)
+    // Completed by the provider, there is no work to schedule
+    RETURN_IF_FAILED(XAsyncBegin(asyncBlock, nullptr, (void*)HCHttpPreconnectAsync, __FUNCTION__,
+        [](XAsyncOp op, const XAsyncProviderData* /*data*/)
+        {
+            return op == XAsyncOp::DoWork ? E_PENDING : S_OK;
+        }
+    ));
+
+    HRESULT hr = Internal_HttpPreconnect(m_performEnv.get(), url, connectionCount, asyncBlock);
+    if (FAILED(hr))
+    {
+        XAsyncComplete(asyncBlock, hr, 0);
+    }
+    return S_OK;
+#else
+    UNREFERENCED_PARAMETER(url);
+    UNREFERENCED_PARAMETER(connectionCount);
+    UNREFERENCED_PARAMETER(asyncBlock);
+    return E_NOTIMPL;
+#endif
+}
+
+HRESULT http_singleton::get_http_connection_stats(_Out_ HCHttpConnectionStats* stats)
+{
+#if HC_PLATFORM == HC_PLATFORM_GENERIC && HC_EPOLL_HTTP
+    return Internal_GetHttpConnectionStats(m_performEnv.get(), stats);
+#else
+    UNREFERENCED_PARAMETER(stats);
+    return E_NOTIMPL;
+#endif
+}
+
 HttpPerformInfo& GetUserHttpPerformHandler() noexcept
 {
     static HttpPerformInfo handler(&Internal_HCHttpCallPerformAsync, nullptr);
@@ -3,6 +3,11 @@
 #pragma once
 #include <httpClient/httpProvider.h>
 #include "../HTTP/httpcall.h"
+#include "../Mock/lhc_capture.h"
+#include "../Mock/lhc_network_emulator.h"
+#include "handle_table.h"
+#include "tls_session_cache.h"
+#include "routed_handlers.h"
 #if !HC_NOWEBSOCKETS
 #include "../WebSocket/hcwebsocket.h"
 #endif
@@ -57,21 +62,34 @@ public:
     http_retry_after_api_state get_retry_state(_In_ uint32_t retryAfterCacheId);
     void clear_retry_state(_In_ uint32_t retryAfterCacheId);
 
-    std::recursive_mutex m_callRoutedHandlersLock;
     std::atomic<int32_t> m_callRoutedHandlersContext{ 0 };
-    http_internal_unordered_map<int32_t, std::pair<HCCallRoutedHandler, void*>> m_callRoutedHandlers;
+    routed_handler_list<HCCallRoutedHandler> m_callRoutedHandlers;
 #if !HC_NOWEBSOCKETS
-    http_internal_unordered_map<int32_t, std::pair<HCWebSocketRoutedHandler, void*>> m_webSocketRoutedHandlers;
+    routed_handler_list<HCWebSocketRoutedHandler> m_webSocketRoutedHandlers;
 #endif
+    routed_handler_dispatcher m_routedHandlerDispatcher;
 
     // HTTP state
     HttpPerformInfo const m_httpPerform;
     PerformEnv const m_performEnv;
 
     HRESULT set_global_proxy(_In_ const char* proxyUri);
+    HRESULT prewarm_dns_cache(_In_reads_(hostNameCount) const char* const* hostNames, _In_ uint32_t hostNameCount);
+    HRESULT get_dns_cache_stats(_Out_ HCDnsCacheStats* stats);
+    HRESULT get_tls_session_stats(_Out_ HCTlsSessionStats* stats);
+    HRESULT preconnect(_In_z_ const char* url, _In_ uint32_t connectionCount, _Inout_ XAsyncBlock* asyncBlock);
+    HRESULT get_http_connection_stats(_Out_ HCHttpConnectionStats* stats);
+
+#if HC_TLS_SESSION_CACHE
+    std::shared_ptr<tls_session_cache> m_tlsSessionCache;
+#endif
 
     std::atomic<std::uint64_t> m_lastId{ 0 };
     bool m_retryAllowed = true;
+    bool m_decompressResponse = false;
+    HCCompressionLevel m_compressionLevel = HCCompressionLevel::None;
+    HCHttpVersion m_httpVersion = HCHttpVersion::Default;
+    HCHttpCallPriority m_priority = HCHttpCallPriority::Normal;
     uint32_t m_timeoutInSeconds = DEFAULT_HTTP_TIMEOUT_IN_SECONDS;
     uint32_t m_timeoutWindowInSeconds = DEFAULT_TIMEOUT_WINDOW_IN_SECONDS;
     uint32_t m_retryDelayInSeconds = DEFAULT_RETRY_DELAY_IN_SECONDS;
@@ -89,9 +107,13 @@ public:
     // Mock state
     std::recursive_mutex m_mocksLock;
     http_internal_vector<HC_MOCK_CALL*> m_mocks;
+    http_replay_store m_replay;
+
+    // Traffic capture state. Accessed with std::atomic_load/atomic_store so completing calls never take a lock.
+    std::shared_ptr<http_capture> m_capture;
 
-    std::recursive_mutex m_sharedPtrsLock;
-    http_internal_unordered_map<void*, std::shared_ptr<void>> m_sharedPtrs;
+    // Network emulation profiles used when HCMockEnableNetworkEmulation has registered the emulator
+    network_emulator m_networkEmulator;
 
     http_singleton(
         HttpPerformInfo const& httpPerformInfo,
@@ -122,64 +144,40 @@ private:
 
 std::shared_ptr<http_singleton> get_http_singleton();
 
+// Keeps objects alive while they are referenced by raw context pointers handed to platform callbacks and
+// XAsync providers. store returns an opaque handle rather than the object's address; fetch returns nullptr
+// once the handle has been removed.
 class shared_ptr_cache
 {
 public:
     template<typename T>
     static void* store(std::shared_ptr<T> contextSharedPtr)
     {
-        auto httpSingleton = get_http_singleton();
-        if (nullptr == httpSingleton)
-            return nullptr;
-        std::lock_guard<std::recursive_mutex> lock(httpSingleton->m_sharedPtrsLock);
-
-        void *rawVoidPtr = contextSharedPtr.get();
-        std::shared_ptr<void> voidSharedPtr(contextSharedPtr, rawVoidPtr);
-        httpSingleton->m_sharedPtrs.insert(std::make_pair(rawVoidPtr, voidSharedPtr));
-        return rawVoidPtr;
+        return table().store(std::shared_ptr<void>{ std::move(contextSharedPtr) });
     }
 
     template<typename T>
-    static std::shared_ptr<T> fetch(void *rawContextPtr)
+    static std::shared_ptr<T> fetch(void *handle)
     {
-        auto httpSingleton = get_http_singleton();
-        if (nullptr == httpSingleton)
-            return nullptr;
-
-        std::lock_guard<std::recursive_mutex> lock(httpSingleton->m_sharedPtrsLock);
-
-        auto iter = httpSingleton->m_sharedPtrs.find(rawContextPtr);
-        if (iter != httpSingleton->m_sharedPtrs.end())
-        {
-            auto returnPtr = std::shared_ptr<T>(iter->second, reinterpret_cast<T*>(iter->second.get()));
-            return returnPtr;
-        }
-
-        return nullptr;
+        auto value = table().fetch(handle);
+        return std::shared_ptr<T>(value, reinterpret_cast<T*>(value.get()));
     }
 
-    static void remove(void *rawContextPtr)
+    static void remove(void *handle)
     {
-        auto httpSingleton = get_http_singleton();
-        if (nullptr == httpSingleton)
-            return;
-
-        std::lock_guard<std::recursive_mutex> lock(httpSingleton->m_sharedPtrsLock);
-
-        auto iter = httpSingleton->m_sharedPtrs.find(rawContextPtr);
-        if (iter != httpSingleton->m_sharedPtrs.end())
-        {
-            httpSingleton->m_sharedPtrs.erase(iter);
-        }
+        table().remove(handle);
     }
 
     static void cleanup(_In_ std::shared_ptr<http_singleton> httpSingleton)
     {
-        std::lock_guard<std::recursive_mutex> lock(httpSingleton->m_sharedPtrsLock);
-        httpSingleton->m_sharedPtrs.clear();
+        UNREFERENCED_PARAMETER(httpSingleton);
+        // The table's memory comes from the client's memory hooks, which may be changed once HCCleanup completes
+        table().release();
     }
 
 private:
+    static handle_table& table() noexcept;
+
     shared_ptr_cache();
     shared_ptr_cache(const shared_ptr_cache&);
     shared_ptr_cache& operator=(const shared_ptr_cache&);
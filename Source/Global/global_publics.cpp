@@ -63,6 +63,99 @@ try
 }
 CATCH_RETURN()
 
+STDAPI
+HCPrewarmDnsCache(
+    _In_reads_(hostNameCount) const char* const* hostNames,
+    _In_ uint32_t hostNameCount
+    ) noexcept
+try
+{
+    RETURN_HR_IF(E_INVALIDARG, hostNames == nullptr && hostNameCount > 0);
+
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+    {
+        return E_HC_NOT_INITIALISED;
+    }
+
+    return httpSingleton->prewarm_dns_cache(hostNames, hostNameCount);
+}
+CATCH_RETURN()
+
+STDAPI
+HCGetDnsCacheStats(
+    _Out_ HCDnsCacheStats* stats
+    ) noexcept
+try
+{
+    RETURN_HR_IF(E_INVALIDARG, stats == nullptr);
+
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+    {
+        return E_HC_NOT_INITIALISED;
+    }
+
+    return httpSingleton->get_dns_cache_stats(stats);
+}
+CATCH_RETURN()
+
+STDAPI
+HCGetTlsSessionStats(
+    _Out_ HCTlsSessionStats* stats
+    ) noexcept
+try
+{
+    RETURN_HR_IF(E_INVALIDARG, stats == nullptr);
+
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+    {
+        return E_HC_NOT_INITIALISED;
+    }
+
+    return httpSingleton->get_tls_session_stats(stats);
+}
+CATCH_RETURN()
+
+STDAPI
+HCHttpPreconnectAsync(
+    _In_z_ const char* url,
+    _In_ uint32_t connectionCount,
+    _Inout_ XAsyncBlock* asyncBlock
+    ) noexcept
+try
+{
+    RETURN_HR_IF(E_INVALIDARG, url == nullptr || connectionCount == 0 || asyncBlock == nullptr);
+
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+    {
+        return E_HC_NOT_INITIALISED;
+    }
+
+    return httpSingleton->preconnect(url, connectionCount, asyncBlock);
+}
+CATCH_RETURN()
+
+STDAPI
+HCGetHttpConnectionStats(
+    _Out_ HCHttpConnectionStats* stats
+    ) noexcept
+try
+{
+    RETURN_HR_IF(E_INVALIDARG, stats == nullptr);
+
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+    {
+        return E_HC_NOT_INITIALISED;
+    }
+
+    return httpSingleton->get_http_connection_stats(stats);
+}
+CATCH_RETURN()
+
 STDAPI
 HCSetHttpCallPerformFunction(
     _In_ HCCallPerformFunction performFunc,
@@ -119,9 +212,11 @@ STDAPI_(int32_t) HCAddCallRoutedHandler(
     if (nullptr == httpSingleton)
         return E_HC_NOT_INITIALISED;
 
-    std::lock_guard<std::recursive_mutex> lock(httpSingleton->m_callRoutedHandlersLock);
     auto functionContext = httpSingleton->m_callRoutedHandlersContext++;
-    httpSingleton->m_callRoutedHandlers[functionContext] = std::make_pair(handler, context);
+    if (!httpSingleton->m_callRoutedHandlers.add(functionContext, handler, context))
+    {
+        return -1;
+    }
     return functionContext;
 }
 
@@ -132,11 +227,23 @@ STDAPI_(void) HCRemoveCallRoutedHandler(
     auto httpSingleton = get_http_singleton();
     if (nullptr != httpSingleton)
     {
-        std::lock_guard<std::recursive_mutex> lock(httpSingleton->m_callRoutedHandlersLock);
-        httpSingleton->m_callRoutedHandlers.erase(handlerContext);
+        httpSingleton->m_callRoutedHandlers.remove(handlerContext);
     }
 }
 
+STDAPI HCSetRoutedHandlerQueue(
+    _In_opt_ XTaskQueueHandle queue
+    ) noexcept
+try
+{
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+        return E_HC_NOT_INITIALISED;
+
+    return httpSingleton->m_routedHandlerDispatcher.SetQueue(queue);
+}
+CATCH_RETURN()
+
 #if !HC_NOWEBSOCKETS
 STDAPI_(int32_t) HCAddWebSocketRoutedHandler(
     _In_ HCWebSocketRoutedHandler handler,
@@ -152,9 +259,11 @@ STDAPI_(int32_t) HCAddWebSocketRoutedHandler(
     if (nullptr == httpSingleton)
         return E_HC_NOT_INITIALISED;
 
-    std::lock_guard<std::recursive_mutex> lock(httpSingleton->m_callRoutedHandlersLock);
     auto functionContext = httpSingleton->m_callRoutedHandlersContext++;
-    httpSingleton->m_webSocketRoutedHandlers[functionContext] = std::make_pair(handler, context);
+    if (!httpSingleton->m_webSocketRoutedHandlers.add(functionContext, handler, context))
+    {
+        return -1;
+    }
     return functionContext;
 }
 
@@ -165,8 +274,7 @@ STDAPI_(void) HCRemoveWebSocketRoutedHandler(
     auto httpSingleton = get_http_singleton();
     if (nullptr != httpSingleton)
     {
-        std::lock_guard<std::recursive_mutex> lock(httpSingleton->m_callRoutedHandlersLock);
-        httpSingleton->m_webSocketRoutedHandlers.erase(handlerContext);
+        httpSingleton->m_webSocketRoutedHandlers.remove(handlerContext);
     }
 }
 #endif
@@ -0,0 +1,345 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "handle_table.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+// std::min and the conditional operator take these by reference, so C++14 needs them defined
+constexpr uint32_t handle_table::SLOTS_PER_SHARD;
+constexpr uint32_t handle_table::MAX_GENERATION;
+
+handle_table::handle_table(uint32_t generationLimit) noexcept :
+    m_generationLimit{ generationLimit == 0 || generationLimit > MAX_GENERATION ? MAX_GENERATION : generationLimit }
+{
+    for (auto& s : m_shards)
+    {
+        s.freeHead = NO_SLOT;
+        for (auto& segment : s.segments)
+        {
+            segment = nullptr;
+        }
+    }
+}
+
+handle_table::~handle_table()
+{
+    FreeSegments();
+}
+
+void* handle_table::store(std::shared_ptr<void> value) noexcept
+{
+    // Threads are spread across shards round robin the first time they store
+    static std::atomic<uint32_t> s_nextShard{ 0 };
+    static thread_local uint32_t s_homeShard{ s_nextShard++ % SHARD_COUNT };
+
+    for (uint32_t attempt = 0; attempt < SHARD_COUNT; ++attempt)
+    {
+        uint32_t shardIndex = (s_homeShard + attempt) % SHARD_COUNT;
+        shard_access access{ m_shards[shardIndex] };
+        uint32_t slotIndex;
+        if (!AllocateSlot(shardIndex, slotIndex))
+        {
+            continue;
+        }
+
+        slot* s = GetSlot(shardIndex, slotIndex);
+        s->value = std::move(value);
+
+        // Publishing the slot as live makes the value visible to fetch
+        uint64_t state = s->state.fetch_or(LIVE, std::memory_order_release);
+        return MakeHandle(shardIndex, slotIndex, Generation(state));
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<void> handle_table::fetch(_In_opt_ void* handle) noexcept
+{
+    uint32_t shardIndex, slotIndex, generation;
+    if (!DecodeHandle(handle, shardIndex, slotIndex, generation))
+    {
+        return nullptr;
+    }
+
+    shard_access access{ m_shards[shardIndex] };
+    slot* s = GetSlot(shardIndex, slotIndex);
+    if (s == nullptr)
+    {
+        return nullptr;
+    }
+
+    // Pin the slot so its value can't be released while it is copied
+    uint64_t state = s->state.fetch_add(ONE_READER, std::memory_order_acquire);
+
+    std::shared_ptr<void> value;
+    if (Generation(state) == generation && (state & LIVE))
+    {
+        value = s->value;
+    }
+
+    state = s->state.fetch_sub(ONE_READER, std::memory_order_acq_rel) - ONE_READER;
+    if ((state & REMOVED) && (state & READERS_MASK) == 0)
+    {
+        // The slot was removed while pinned, and this was the last reader
+        Reclaim(shardIndex, slotIndex, s, state);
+    }
+
+    return value;
+}
+
+bool handle_table::remove(_In_opt_ void* handle) noexcept
+{
+    uint32_t shardIndex, slotIndex, generation;
+    if (!DecodeHandle(handle, shardIndex, slotIndex, generation))
+    {
+        return false;
+    }
+
+    shard_access access{ m_shards[shardIndex] };
+    slot* s = GetSlot(shardIndex, slotIndex);
+    if (s == nullptr)
+    {
+        return false;
+    }
+
+    uint64_t state = s->state.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        if (Generation(state) != generation || !(state & LIVE))
+        {
+            return false;
+        }
+
+        if (s->state.compare_exchange_weak(state, (state & ~LIVE) | REMOVED, std::memory_order_acq_rel))
+        {
+            break;
+        }
+    }
+
+    state = (state & ~LIVE) | REMOVED;
+    if ((state & READERS_MASK) == 0)
+    {
+        Reclaim(shardIndex, slotIndex, s, state);
+    }
+    // Otherwise the last reader to unpin the slot reclaims it
+
+    return true;
+}
+
+void handle_table::clear() noexcept
+{
+    for (uint32_t shardIndex = 0; shardIndex < SHARD_COUNT; ++shardIndex)
+    {
+        shard_access access{ m_shards[shardIndex] };
+        uint32_t slotsUsed = std::min(m_shards[shardIndex].slotsUsed.load(std::memory_order_acquire), SLOTS_PER_SHARD);
+        for (uint32_t slotIndex = 0; slotIndex < slotsUsed; ++slotIndex)
+        {
+            slot* s = GetSlot(shardIndex, slotIndex);
+            if (s == nullptr)
+            {
+                continue;
+            }
+
+            uint64_t state = s->state.load(std::memory_order_acquire);
+            if (state & LIVE)
+            {
+                remove(MakeHandle(shardIndex, slotIndex, Generation(state)));
+            }
+        }
+    }
+}
+
+void handle_table::release() noexcept
+{
+    clear();
+
+    uint64_t firstGeneration = m_firstGeneration.load(std::memory_order_relaxed);
+    for (auto& sh : m_shards)
+    {
+        // Unpublish the segments first. A thread that got hold of one before that is counted as an accessor,
+        // and one that comes after finds no segment, so once the accessors drain nothing can reach them.
+        slot* released[SEGMENTS_PER_SHARD];
+        for (uint32_t segmentIndex = 0; segmentIndex < SEGMENTS_PER_SHARD; ++segmentIndex)
+        {
+            released[segmentIndex] = sh.segments[segmentIndex].exchange(nullptr);
+        }
+        while (sh.accessors.load() != 0)
+        {
+            std::this_thread::yield();
+        }
+
+        for (slot* slots : released)
+        {
+            if (slots == nullptr)
+            {
+                continue;
+            }
+
+            // Slots allocated from now on start past every generation handed out so far, so handles from
+            // before the release don't resolve to the objects stored in them
+            for (uint32_t i = 0; i < SEGMENT_SIZE; ++i)
+            {
+                firstGeneration = std::max(firstGeneration, uint64_t{ Generation(slots[i].state.load(std::memory_order_relaxed)) } + 1);
+            }
+            FreeSegment(slots);
+        }
+
+        sh.freeHead = NO_SLOT;
+        sh.slotsUsed = 0;
+    }
+
+    // Past the limit there is nothing left to count up to, so the generations start over
+    m_firstGeneration.store(firstGeneration > m_generationLimit ? 1 : static_cast<uint32_t>(firstGeneration), std::memory_order_relaxed);
+}
+
+void* handle_table::MakeHandle(uint32_t shardIndex, uint32_t slotIndex, uint32_t generation) noexcept
+{
+    uintptr_t const index = shardIndex * SLOTS_PER_SHARD + slotIndex;
+    // Generations run from 1 to the limit, so they fit the handle and a handle is never nullptr
+    return reinterpret_cast<void*>((uintptr_t{ generation } << INDEX_BITS) | index);
+}
+
+bool handle_table::DecodeHandle(
+    _In_opt_ void* handle,
+    _Out_ uint32_t& shardIndex,
+    _Out_ uint32_t& slotIndex,
+    _Out_ uint32_t& generation
+) noexcept
+{
+    uintptr_t const value = reinterpret_cast<uintptr_t>(handle);
+    uintptr_t const index = value & ((uintptr_t{ 1 } << INDEX_BITS) - 1);
+
+    shardIndex = static_cast<uint32_t>(index / SLOTS_PER_SHARD);
+    slotIndex = static_cast<uint32_t>(index % SLOTS_PER_SHARD);
+    generation = static_cast<uint32_t>(value >> INDEX_BITS);
+
+    return generation != 0;
+}
+
+handle_table::slot* handle_table::GetSlot(uint32_t shardIndex, uint32_t slotIndex) const noexcept
+{
+    // Sequentially consistent with the accessor count taken before it, which release relies on
+    slot* segment = m_shards[shardIndex].segments[slotIndex / SEGMENT_SIZE].load();
+    return segment ? &segment[slotIndex % SEGMENT_SIZE] : nullptr;
+}
+
+bool handle_table::AllocateSlot(uint32_t shardIndex, _Out_ uint32_t& slotIndex) noexcept
+{
+    shard& s = m_shards[shardIndex];
+
+    // Reuse a free slot. The head is tagged with a counter to avoid ABA between concurrent pops.
+    uint64_t head = s.freeHead.load(std::memory_order_acquire);
+    while (static_cast<uint32_t>(head) != NO_SLOT)
+    {
+        uint32_t index = static_cast<uint32_t>(head);
+        uint32_t next = GetSlot(shardIndex, index)->nextFree.load(std::memory_order_relaxed);
+        uint64_t newHead = ((head >> 32) + 1) << 32 | next;
+        if (s.freeHead.compare_exchange_weak(head, newHead, std::memory_order_acq_rel))
+        {
+            slotIndex = index;
+            return true;
+        }
+    }
+
+    // Otherwise take the next unused slot, allocating its segment if needed
+    uint32_t used = s.slotsUsed.load(std::memory_order_relaxed);
+    do
+    {
+        if (used >= SLOTS_PER_SHARD)
+        {
+            return false;
+        }
+    } while (!s.slotsUsed.compare_exchange_weak(used, used + 1, std::memory_order_relaxed));
+
+    auto& segment = s.segments[used / SEGMENT_SIZE];
+    if (segment.load(std::memory_order_acquire) == nullptr)
+    {
+        http_stl_allocator<slot> alloc;
+        slot* slots = nullptr;
+        try
+        {
+            slots = alloc.allocate(SEGMENT_SIZE);
+        }
+        catch (...)
+        {
+            // The reserved slot is lost; the shard just has one less slot to use
+            return false;
+        }
+
+        uint64_t const initialState = uint64_t{ m_firstGeneration.load(std::memory_order_relaxed) } << 32;
+        for (uint32_t i = 0; i < SEGMENT_SIZE; ++i)
+        {
+            new (&slots[i]) slot{};
+            slots[i].state.store(initialState, std::memory_order_relaxed);
+        }
+
+        slot* expected = nullptr;
+        if (!segment.compare_exchange_strong(expected, slots, std::memory_order_acq_rel))
+        {
+            // Another thread installed the segment first
+            FreeSegment(slots);
+        }
+    }
+
+    slotIndex = used;
+    return true;
+}
+
+void handle_table::Reclaim(uint32_t shardIndex, uint32_t slotIndex, _In_ slot* s, uint64_t state) noexcept
+{
+    // Exactly one of the remover and the last reader wins the right to reclaim the slot. Advancing the
+    // generation invalidates every outstanding handle to it. A slot at the limit can't advance without
+    // wrapping back to generations its old handles carry, so it is retired: left neither live nor free.
+    uint32_t const generation = Generation(state);
+    bool const retire = generation >= m_generationLimit;
+    uint64_t expected = (state & ~READERS_MASK) | REMOVED;
+    uint64_t desired = uint64_t{ retire ? generation : generation + 1 } << 32;
+    if (!s->state.compare_exchange_strong(expected, desired, std::memory_order_acq_rel))
+    {
+        return;
+    }
+
+    s->value.reset();
+    if (retire)
+    {
+        return;
+    }
+
+    shard& sh = m_shards[shardIndex];
+    uint64_t head = sh.freeHead.load(std::memory_order_relaxed);
+    uint64_t newHead;
+    do
+    {
+        s->nextFree.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        newHead = ((head >> 32) + 1) << 32 | slotIndex;
+    } while (!sh.freeHead.compare_exchange_weak(head, newHead, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void handle_table::FreeSegment(_In_ slot* slots) noexcept
+{
+    for (uint32_t i = 0; i < SEGMENT_SIZE; ++i)
+    {
+        slots[i].~slot();
+    }
+    http_stl_allocator<slot> alloc;
+    alloc.deallocate(slots, SEGMENT_SIZE);
+}
+
+void handle_table::FreeSegments() noexcept
+{
+    for (auto& s : m_shards)
+    {
+        for (auto& segment : s.segments)
+        {
+            slot* slots = segment.exchange(nullptr);
+            if (slots != nullptr)
+            {
+                FreeSegment(slots);
+            }
+        }
+    }
+}
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
@@ -0,0 +1,110 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+// Maps opaque handles to shared objects. A handle encodes a slot index and the slot's generation, so a
+// handle to a removed object never resolves to an object later stored in the same slot. Generations keep
+// counting up across release, so that holds for handles from before it too.
+//
+// A handle only has room for GENERATION_BITS of generation: 32 on 64-bit targets but 12 on 32-bit ones. A
+// slot whose generation reaches the limit is retired instead of being reused, so each slot serves at most
+// that many objects and store fails once every slot is retired. On 32-bit targets that is about four
+// billion stores. If a release finds the generations used up it starts them over, and handles from before
+// that release must not be used again.
+//
+// Slots are spread across shards, each with its own lock-free free list, to keep threads storing
+// concurrently off each other's cache lines. fetch is wait-free; store and remove are lock-free.
+class handle_table
+{
+public:
+    // A nonzero generationLimit lowers the largest generation a slot reaches before it is retired
+    explicit handle_table(uint32_t generationLimit = 0) noexcept;
+    ~handle_table();
+
+    handle_table(const handle_table&) = delete;
+    handle_table& operator=(const handle_table&) = delete;
+
+    // Returns nullptr if the table is full or out of memory
+    void* store(std::shared_ptr<void> value) noexcept;
+
+    // Returns nullptr if the handle has been removed
+    std::shared_ptr<void> fetch(_In_opt_ void* handle) noexcept;
+
+    // Returns false if the handle had already been removed
+    bool remove(_In_opt_ void* handle) noexcept;
+
+    // Removes every stored object
+    void clear() noexcept;
+
+    // Removes every stored object and frees the table's memory. Other threads may still fetch and remove
+    // handles meanwhile, but not store.
+    void release() noexcept;
+
+private:
+    static constexpr uint32_t SHARD_COUNT = 16;
+    static constexpr uint32_t SEGMENT_SIZE = 1024;
+    static constexpr uint32_t SEGMENTS_PER_SHARD = 64;
+    static constexpr uint32_t SLOTS_PER_SHARD = SEGMENT_SIZE * SEGMENTS_PER_SHARD;
+    static constexpr uint32_t INDEX_BITS = 20; // log2(SHARD_COUNT * SLOTS_PER_SHARD)
+    static constexpr uint32_t GENERATION_BITS = sizeof(void*) * 8 - INDEX_BITS < 32 ? sizeof(void*) * 8 - INDEX_BITS : 32;
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+    static constexpr uint32_t MAX_GENERATION = static_cast<uint32_t>((1ull << GENERATION_BITS) - 1);
+
+    // Slot state is packed into one word so readers can pin the slot with a single fetch_add:
+    // [generation:32][readers:30][removed:1][live:1]
+    static constexpr uint64_t LIVE = 1;
+    static constexpr uint64_t REMOVED = 2;
+    static constexpr uint64_t ONE_READER = 4;
+    static constexpr uint64_t READERS_MASK = 0xFFFFFFFC;
+
+    struct slot
+    {
+        std::atomic<uint64_t> state;
+        std::atomic<uint32_t> nextFree{ NO_SLOT };
+        std::shared_ptr<void> value;
+    };
+
+    struct alignas(64) shard
+    {
+        std::atomic<uint64_t> freeHead; // [tag:32][slot index:32]
+        std::atomic<uint32_t> slotsUsed{ 0 };
+        std::atomic<uint32_t> accessors{ 0 }; // threads that may be using the segments, which release waits out
+        std::atomic<slot*> segments[SEGMENTS_PER_SHARD];
+    };
+
+    // Counts the calling thread as an accessor of a shard's segments for its lifetime
+    class shard_access
+    {
+    public:
+        explicit shard_access(shard& s) noexcept : m_shard{ s } { m_shard.accessors.fetch_add(1); }
+        ~shard_access() { m_shard.accessors.fetch_sub(1, std::memory_order_release); }
+
+        shard_access(const shard_access&) = delete;
+        shard_access& operator=(const shard_access&) = delete;
+
+    private:
+        shard& m_shard;
+    };
+
+    static uint32_t Generation(uint64_t state) noexcept { return static_cast<uint32_t>(state >> 32); }
+    static void* MakeHandle(uint32_t shardIndex, uint32_t slotIndex, uint32_t generation) noexcept;
+    static bool DecodeHandle(_In_opt_ void* handle, _Out_ uint32_t& shardIndex, _Out_ uint32_t& slotIndex, _Out_ uint32_t& generation) noexcept;
+
+    slot* GetSlot(uint32_t shardIndex, uint32_t slotIndex) const noexcept;
+    bool AllocateSlot(uint32_t shardIndex, _Out_ uint32_t& slotIndex) noexcept;
+    void Reclaim(uint32_t shardIndex, uint32_t slotIndex, _In_ slot* s, uint64_t state) noexcept;
+    static void FreeSegment(_In_ slot* slots) noexcept;
+    void FreeSegments() noexcept;
+
+    shard m_shards[SHARD_COUNT];
+
+    // The generation slots in newly allocated segments start at, past every generation handed out before
+    std::atomic<uint32_t> m_firstGeneration{ 1 };
+
+    uint32_t const m_generationLimit;
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
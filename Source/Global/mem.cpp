@@ -26,6 +26,62 @@ DefaultMemFreeFunction(
 
 HCMemAllocFunction g_memAllocFunc = DefaultMemAllocFunction;
 HCMemFreeFunction g_memFreeFunc = DefaultMemFreeFunction;
+std::atomic<bool> g_memThreadCachingEnabled{ false };
+std::atomic<bool> g_memAccountingEnabled{ false };
+
+// Allocations made with a header, while thread caching or accounting was enabled, that haven't been freed yet. Memory
+// has to be freed by the mode it was allocated with, so those modes can only be switched while this is zero.
+// Allocations without a header aren't counted, so that the default mode pays nothing for this; turning a mode on
+// relies on the caller doing it before HCInitialize, while the library holds no memory.
+// Counted in shards so that threads allocating concurrently don't contend for one cache line.
+constexpr uint32_t LIVE_ALLOCATION_SHARDS = 16;
+
+struct alignas(64) live_allocation_shard
+{
+    std::atomic<int64_t> count{ 0 };
+};
+
+static live_allocation_shard g_memLiveAllocations[LIVE_ALLOCATION_SHARDS];
+static std::atomic<uint32_t> g_memNextLiveAllocationShard{ 0 };
+static thread_local uint32_t t_memLiveAllocationShard{ LIVE_ALLOCATION_SHARDS };
+
+static void CountLiveAllocations(int64_t delta) noexcept
+{
+    uint32_t& shard = t_memLiveAllocationShard;
+    if (shard == LIVE_ALLOCATION_SHARDS)
+    {
+        shard = g_memNextLiveAllocationShard.fetch_add(1, std::memory_order_relaxed) % LIVE_ALLOCATION_SHARDS;
+    }
+    g_memLiveAllocations[shard].count.fetch_add(delta, std::memory_order_relaxed);
+}
+
+static bool HasAllocationHeaders() noexcept
+{
+    return g_memThreadCachingEnabled.load(std::memory_order_relaxed) || g_memAccountingEnabled.load(std::memory_order_relaxed);
+}
+
+static bool HasLiveAllocations() noexcept
+{
+    int64_t live = 0;
+    for (auto const& shard : g_memLiveAllocations)
+    {
+        live += shard.count.load(std::memory_order_acquire);
+    }
+    return live != 0;
+}
+
+struct mem_usage_counters
+{
+    std::atomic<uint64_t> currentBytes{ 0 };
+    std::atomic<uint64_t> peakBytes{ 0 };
+    std::atomic<uint64_t> totalBytes{ 0 };
+    std::atomic<uint64_t> totalAllocations{ 0 };
+};
+
+mem_usage_counters g_memUsage[HC_MEMORY_TYPE_COUNT];
+
+// Advanced each time accounting is enabled and the usage reset, so that memory counted before is not uncounted after
+std::atomic<uint32_t> g_memAccountingEpoch{ 0 };
 
 STDAPI 
 HCMemSetFunctions(
@@ -59,18 +115,478 @@ HCMemGetFunctions(
     return S_OK;
 }
 
+STDAPI
+HCMemSetThreadCachingEnabled(
+    _In_ bool enabled
+    ) noexcept
+{
+    if (xbox::httpclient::get_http_singleton() != nullptr)
+    {
+        return E_HC_ALREADY_INITIALISED;
+    }
+
+    if (enabled != g_memThreadCachingEnabled && HasLiveAllocations())
+    {
+        // Cached blocks are freed through the header that precedes them, which other allocations don't have. Only
+        // allocations with a header are counted, so enabling it relies on nothing being allocated before HCInitialize.
+        return E_HC_INTERNAL_STILLINUSE;
+    }
+
+    g_memThreadCachingEnabled = enabled;
+    xbox::httpclient::http_memory::trim();
+    return S_OK;
+}
+
+STDAPI
+HCMemSetAccountingEnabled(
+    _In_ bool enabled
+    ) noexcept
+{
+    if (xbox::httpclient::get_http_singleton() != nullptr)
+    {
+        return E_HC_ALREADY_INITIALISED;
+    }
+
+    if (enabled != g_memAccountingEnabled && HasLiveAllocations())
+    {
+        // Accounted allocations are freed through the header that records their size, which others don't have. As
+        // with thread caching, allocations made without a header aren't counted, so enabling it can't check for them.
+        return E_HC_INTERNAL_STILLINUSE;
+    }
+
+    if (enabled && !g_memAccountingEnabled)
+    {
+        ++g_memAccountingEpoch;
+        for (auto& counters : g_memUsage)
+        {
+            counters.currentBytes = 0;
+            counters.peakBytes = 0;
+            counters.totalBytes = 0;
+            counters.totalAllocations = 0;
+        }
+    }
+    g_memAccountingEnabled = enabled;
+    return S_OK;
+}
+
+STDAPI
+HCMemGetUsage(
+    _In_ HCMemoryType memoryType,
+    _Out_ HCMemoryUsage* usage
+    ) noexcept
+{
+    if (memoryType >= HC_MEMORY_TYPE_COUNT || usage == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    if (!g_memAccountingEnabled)
+    {
+        return E_NOT_SUPPORTED;
+    }
+
+    auto const& counters = g_memUsage[memoryType];
+    usage->currentBytes = counters.currentBytes.load(std::memory_order_relaxed);
+    usage->peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+    usage->totalBytes = counters.totalBytes.load(std::memory_order_relaxed);
+    usage->totalAllocations = counters.totalAllocations.load(std::memory_order_relaxed);
+    return S_OK;
+}
+
 
 NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
 
+namespace
+{
+
+void AddUsage(HCMemoryType memoryType, size_t size) noexcept
+{
+    if (!g_memAccountingEnabled)
+    {
+        return;
+    }
+
+    assert(memoryType < HC_MEMORY_TYPE_COUNT);
+    auto& counters = g_memUsage[memoryType];
+    uint64_t current = counters.currentBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    uint64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+    while (current > peak && !counters.peakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed))
+    {
+    }
+    counters.totalBytes.fetch_add(size, std::memory_order_relaxed);
+    counters.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RemoveUsage(HCMemoryType memoryType, size_t size) noexcept
+{
+    if (!g_memAccountingEnabled)
+    {
+        return;
+    }
+
+    g_memUsage[memoryType].currentBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+// While thread caching is enabled, allocations of up to MAX_CACHED_SIZE are rounded up to one of these sizes and
+// served from blocks of that size. The blocks are carved out of slabs of at least SLAB_SIZE allocated with the memory
+// hooks, and freed blocks are kept in a cache on the thread that freed them, so that most allocations take neither
+// the central lock nor the hooks' own. Threads exchange half a cache's worth of blocks with the central free lists at
+// a time.
+constexpr size_t SIZE_CLASSES[]{
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256,
+    320, 384, 448, 512,
+    640, 768, 896, 1024,
+    1280, 1536, 1792, 2048,
+    2560, 3072, 3584, 4096
+};
+constexpr uint32_t SIZE_CLASS_COUNT = sizeof(SIZE_CLASSES) / sizeof(SIZE_CLASSES[0]);
+constexpr size_t MAX_CACHED_SIZE = 4096;
+constexpr size_t SLAB_SIZE = 16 * 1024;
+constexpr size_t MIN_BLOCKS_PER_SLAB = 16;
+constexpr size_t THREAD_CACHE_BYTES = 16 * 1024; // per size class
+constexpr uint32_t THREAD_CACHE_LIMIT = 32;
+
+uint32_t GetSizeClass(size_t size) noexcept
+{
+    if (size <= 128)
+    {
+        return static_cast<uint32_t>((std::max<size_t>(size, 1) + 15) / 16 - 1);
+    }
+
+    // Above 128, each doubling of the size is split in 4 classes
+    uint32_t sizeClass = 8;
+    size_t base = 128;
+    while (size > base * 2)
+    {
+        base *= 2;
+        sizeClass += 4;
+    }
+    size_t step = base / 4;
+    return static_cast<uint32_t>(sizeClass + (size - base + step - 1) / step - 1);
+}
+
+// The number of blocks of a size class a thread keeps cached
+uint32_t GetThreadCacheLimit(uint32_t sizeClass) noexcept
+{
+    return static_cast<uint32_t>(std::max<size_t>(4, std::min<size_t>(THREAD_CACHE_LIMIT, THREAD_CACHE_BYTES / SIZE_CLASSES[sizeClass])));
+}
+
+struct slab
+{
+    slab* next;
+    HCMemFreeFunction freeFunc; // the hook the slab was allocated with
+    size_t size;
+    uint32_t accountingEpoch; // the epoch the slab was counted in, if any
+    uint32_t blockCount;
+    uint32_t freeCount; // blocks on the central free lists
+};
+
+// Precedes every block handed out while thread caching is enabled, so that it can be freed without knowing its size.
+// Large allocations are made with the hooks directly and have no slab.
+struct block_header
+{
+    slab* owner;
+    uint32_t sizeClass;
+};
+
+constexpr size_t HEADER_SIZE = 16;
+constexpr size_t SLAB_HEADER_SIZE = (sizeof(slab) + 15) & ~size_t{ 15 };
+static_assert(sizeof(block_header) <= HEADER_SIZE, "block_header must fit in HEADER_SIZE");
+
+struct free_block
+{
+    free_block* next;
+};
+
+struct free_list
+{
+    free_block* head{ nullptr };
+    uint32_t count{ 0 };
+
+    void push(free_block* block) noexcept
+    {
+        block->next = head;
+        head = block;
+        ++count;
+    }
+
+    free_block* pop() noexcept
+    {
+        free_block* block = head;
+        head = block->next;
+        --count;
+        return block;
+    }
+};
+
+block_header* GetHeader(void* p) noexcept
+{
+    return reinterpret_cast<block_header*>(static_cast<uint8_t*>(p) - HEADER_SIZE);
+}
+
+struct central_cache
+{
+    std::mutex lock;
+    free_list lists[SIZE_CLASS_COUNT];
+    slab* slabs{ nullptr };
+};
+
+central_cache& GetCentralCache() noexcept
+{
+    // Never destroyed, as threads return their caches to it when they exit, which can be after static destructors run
+    alignas(central_cache) static uint8_t s_storage[sizeof(central_cache)];
+    static central_cache* s_cache = new (s_storage) central_cache{};
+    return *s_cache;
+}
+
+// Moves up to count blocks of a size class from the central free lists to list, allocating a slab if there are none.
+// Must be called with the central lock held.
+bool RefillLocked(central_cache& central, uint32_t sizeClass, free_list& list, uint32_t count)
+{
+    free_list& centralList = central.lists[sizeClass];
+    if (centralList.head == nullptr)
+    {
+        size_t blockSize = HEADER_SIZE + SIZE_CLASSES[sizeClass];
+        size_t slabSize = std::max(SLAB_SIZE, SLAB_HEADER_SIZE + MIN_BLOCKS_PER_SLAB * blockSize);
+        auto newSlab = static_cast<slab*>(g_memAllocFunc(slabSize, HC_MEMORY_TYPE_THREAD_CACHE));
+        if (newSlab == nullptr)
+        {
+            return false;
+        }
+
+        AddUsage(HC_MEMORY_TYPE_THREAD_CACHE, slabSize);
+        newSlab->next = central.slabs;
+        newSlab->freeFunc = g_memFreeFunc;
+        newSlab->size = slabSize;
+        newSlab->accountingEpoch = g_memAccountingEnabled ? g_memAccountingEpoch.load() : 0;
+        newSlab->blockCount = static_cast<uint32_t>((slabSize - SLAB_HEADER_SIZE) / blockSize);
+        newSlab->freeCount = newSlab->blockCount;
+        central.slabs = newSlab;
+
+        uint8_t* blocks = reinterpret_cast<uint8_t*>(newSlab) + SLAB_HEADER_SIZE;
+        for (uint32_t i = newSlab->blockCount; i > 0; --i)
+        {
+            auto header = reinterpret_cast<block_header*>(blocks + (i - 1) * blockSize);
+            header->owner = newSlab;
+            header->sizeClass = sizeClass;
+            centralList.push(reinterpret_cast<free_block*>(reinterpret_cast<uint8_t*>(header) + HEADER_SIZE));
+        }
+    }
+
+    while (count > 0 && centralList.head != nullptr)
+    {
+        free_block* block = centralList.pop();
+        --GetHeader(block)->owner->freeCount;
+        list.push(block);
+        --count;
+    }
+    return true;
+}
+
+// Moves up to count blocks from list to the central free lists. Must be called with the central lock held.
+void ReleaseLocked(central_cache& central, uint32_t sizeClass, free_list& list, uint32_t count) noexcept
+{
+    free_list& centralList = central.lists[sizeClass];
+    while (count > 0 && list.head != nullptr)
+    {
+        free_block* block = list.pop();
+        ++GetHeader(block)->owner->freeCount;
+        centralList.push(block);
+        --count;
+    }
+}
+
+enum class thread_cache_state : uint8_t
+{
+    Unused,
+    Active,
+    Exited
+};
+
+// Trivially destructible so that it remains usable after thread_cache_owner has flushed it, as blocks can still be
+// allocated and freed by the destructors of other thread_local objects
+struct thread_cache
+{
+    free_list lists[SIZE_CLASS_COUNT];
+    thread_cache_state state{ thread_cache_state::Unused };
+};
+
+thread_local thread_cache t_cache;
+
+void FlushThreadCache(thread_cache& cache) noexcept
+{
+    central_cache& central = GetCentralCache();
+    std::lock_guard<std::mutex> lock{ central.lock };
+    for (uint32_t sizeClass = 0; sizeClass < SIZE_CLASS_COUNT; ++sizeClass)
+    {
+        ReleaseLocked(central, sizeClass, cache.lists[sizeClass], UINT32_MAX);
+    }
+}
+
+struct thread_cache_owner
+{
+    bool registered{ false };
+
+    ~thread_cache_owner()
+    {
+        FlushThreadCache(t_cache);
+        t_cache.state = thread_cache_state::Exited;
+
+        if (!g_memThreadCachingEnabled)
+        {
+            // Caching was disabled while this thread held blocks, so nothing else would free the slabs they're from
+            http_memory::trim();
+        }
+    }
+};
+
+thread_local thread_cache_owner t_cacheOwner;
+
+void* ThreadCachedAlloc(size_t size, HCMemoryType memoryType)
+{
+    if (size > MAX_CACHED_SIZE)
+    {
+        auto header = static_cast<block_header*>(g_memAllocFunc(HEADER_SIZE + size, memoryType));
+        if (header == nullptr)
+        {
+            return nullptr;
+        }
+        header->owner = nullptr;
+        header->sizeClass = SIZE_CLASS_COUNT;
+        return reinterpret_cast<uint8_t*>(header) + HEADER_SIZE;
+    }
+
+    uint32_t sizeClass = GetSizeClass(size);
+    thread_cache& cache = t_cache;
+    if (cache.state == thread_cache_state::Unused)
+    {
+        // Constructs the owner, which flushes the cache when the thread exits
+        t_cacheOwner.registered = true;
+        cache.state = thread_cache_state::Active;
+    }
+
+    if (cache.state == thread_cache_state::Exited)
+    {
+        central_cache& central = GetCentralCache();
+        std::lock_guard<std::mutex> lock{ central.lock };
+        free_list single;
+        if (!RefillLocked(central, sizeClass, single, 1))
+        {
+            return nullptr;
+        }
+        return single.pop();
+    }
+
+    free_list& list = cache.lists[sizeClass];
+    if (list.head == nullptr)
+    {
+        central_cache& central = GetCentralCache();
+        std::lock_guard<std::mutex> lock{ central.lock };
+        if (!RefillLocked(central, sizeClass, list, GetThreadCacheLimit(sizeClass) / 2))
+        {
+            return nullptr;
+        }
+    }
+    return list.pop();
+}
+
+void ThreadCachedFree(void* p, HCMemoryType memoryType)
+{
+    block_header* header = GetHeader(p);
+    if (header->owner == nullptr)
+    {
+        g_memFreeFunc(header, memoryType);
+        return;
+    }
+
+    uint32_t sizeClass = header->sizeClass;
+    auto block = static_cast<free_block*>(p);
+    thread_cache& cache = t_cache;
+    if (cache.state != thread_cache_state::Active)
+    {
+        central_cache& central = GetCentralCache();
+        std::lock_guard<std::mutex> lock{ central.lock };
+        free_list single;
+        single.push(block);
+        ReleaseLocked(central, sizeClass, single, 1);
+        return;
+    }
+
+    free_list& list = cache.lists[sizeClass];
+    list.push(block);
+    uint32_t limit = GetThreadCacheLimit(sizeClass);
+    if (list.count > limit)
+    {
+        central_cache& central = GetCentralCache();
+        std::lock_guard<std::mutex> lock{ central.lock };
+        ReleaseLocked(central, sizeClass, list, limit / 2);
+    }
+}
+
+void* AllocFromHooks(size_t size, HCMemoryType memoryType)
+{
+    if (g_memThreadCachingEnabled)
+    {
+        return ThreadCachedAlloc(size, memoryType);
+    }
+    return g_memAllocFunc(size, memoryType);
+}
+
+void FreeToHooks(void* p, HCMemoryType memoryType)
+{
+    if (g_memThreadCachingEnabled)
+    {
+        return ThreadCachedFree(p, memoryType);
+    }
+    g_memFreeFunc(p, memoryType);
+}
+
+// While accounting is enabled, every allocation is preceded by its size and type
+struct accounting_header
+{
+    size_t size;
+    HCMemoryType memoryType;
+};
+
+static_assert(sizeof(accounting_header) <= HEADER_SIZE, "accounting_header must fit in HEADER_SIZE");
+
+void* AccountedAlloc(size_t size, HCMemoryType memoryType)
+{
+    auto header = static_cast<accounting_header*>(AllocFromHooks(HEADER_SIZE + size, memoryType));
+    if (header == nullptr)
+    {
+        return nullptr;
+    }
+    header->size = size;
+    header->memoryType = memoryType;
+    AddUsage(memoryType, size);
+    return reinterpret_cast<uint8_t*>(header) + HEADER_SIZE;
+}
+
+void AccountedFree(void* p, HCMemoryType memoryType)
+{
+    auto header = reinterpret_cast<accounting_header*>(static_cast<uint8_t*>(p) - HEADER_SIZE);
+    assert(header->memoryType == memoryType);
+    RemoveUsage(header->memoryType, header->size);
+    FreeToHooks(header, memoryType);
+}
+
+}
+
 _Ret_maybenull_ _Post_writable_byte_size_(size)
 void* http_memory::mem_alloc(
-    _In_ size_t size
+    _In_ size_t size,
+    _In_ HCMemoryType memoryType
     )
 {
-    HCMemAllocFunction pMemAlloc = g_memAllocFunc;
     try
     {
-        return pMemAlloc(size, 0);
+        void* p = g_memAccountingEnabled ? AccountedAlloc(size, memoryType) : AllocFromHooks(size, memoryType);
+        if (p != nullptr && HasAllocationHeaders())
+        {
+            CountLiveAllocations(1);
+        }
+        return p;
     }
     catch (...)
     {
@@ -80,15 +596,23 @@ void* http_memory::mem_alloc(
 }
 
 void http_memory::mem_free(
-    _In_opt_ void* pAddress
+    _In_opt_ void* pAddress,
+    _In_ HCMemoryType memoryType
     )
 {
-    HCMemFreeFunction pMemFree = g_memFreeFunc;
     try
     {
         if (pAddress)
         {
-            return pMemFree(pAddress, 0);
+            if (HasAllocationHeaders())
+            {
+                CountLiveAllocations(-1);
+            }
+            if (g_memAccountingEnabled)
+            {
+                return AccountedFree(pAddress, memoryType);
+            }
+            return FreeToHooks(pAddress, memoryType);
         }
     }
     catch (...)
@@ -97,5 +621,142 @@ void http_memory::mem_free(
     }
 }
 
-NAMESPACE_XBOX_HTTP_CLIENT_END
+void http_memory::trim() noexcept
+{
+    try
+    {
+        if (t_cache.state == thread_cache_state::Active)
+        {
+            FlushThreadCache(t_cache);
+        }
+
+        central_cache& central = GetCentralCache();
+        std::lock_guard<std::mutex> lock{ central.lock };
+
+        // Blocks cached by other threads aren't free, so their slabs are kept until those threads return them
+        for (free_list& list : central.lists)
+        {
+            free_list kept;
+            while (list.head != nullptr)
+            {
+                free_block* block = list.pop();
+                slab* owner = GetHeader(block)->owner;
+                if (owner->freeCount != owner->blockCount)
+                {
+                    kept.push(block);
+                }
+            }
+            list = kept;
+        }
+
+        slab** next = &central.slabs;
+        while (*next != nullptr)
+        {
+            slab* current = *next;
+            if (current->freeCount == current->blockCount)
+            {
+                *next = current->next;
+                if (current->accountingEpoch == g_memAccountingEpoch)
+                {
+                    RemoveUsage(HC_MEMORY_TYPE_THREAD_CACHE, current->size);
+                }
+                current->freeFunc(current, HC_MEMORY_TYPE_THREAD_CACHE);
+            }
+            else
+            {
+                next = &current->next;
+            }
+        }
+    }
+    catch (...)
+    {
+        HC_TRACE_ERROR(HTTPCLIENT, "mem_free callback failed");
+    }
+}
+
+http_arena::http_arena(_In_reads_bytes_opt_(initialBlockSize) void* initialBlock, _In_ size_t initialBlockSize) noexcept :
+    m_current{ static_cast<uint8_t*>(initialBlock) },
+    m_end{ static_cast<uint8_t*>(initialBlock) + initialBlockSize }
+{
+    // Chunks are aligned to ALIGNMENT, which the initial block may not be
+    size_t misalignment = reinterpret_cast<uintptr_t>(initialBlock) % ALIGNMENT;
+    if (misalignment != 0)
+    {
+        m_current = std::min(m_current + ALIGNMENT - misalignment, m_end);
+    }
+}
 
+http_arena::~http_arena()
+{
+    while (m_blocks != nullptr)
+    {
+        block* next = m_blocks->next;
+        http_memory::mem_free(m_blocks, HC_MEMORY_TYPE_HTTP_CALL);
+        m_blocks = next;
+    }
+}
+
+_Ret_maybenull_ void* http_arena::allocate(_In_ size_t size) noexcept
+{
+    if (size >= LARGE_ALLOCATION_SIZE)
+    {
+        return http_memory::mem_alloc(size, HC_MEMORY_TYPE_HTTP_CALL);
+    }
+
+    size_t chunkSize = (std::max<size_t>(size, 1) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    std::lock_guard<std::mutex> lock{ m_lock };
+
+    free_chunk*& freeChunks = m_freeChunks[chunkSize / ALIGNMENT - 1];
+    if (freeChunks != nullptr)
+    {
+        free_chunk* chunk = freeChunks;
+        freeChunks = chunk->next;
+        return chunk;
+    }
+
+    if (static_cast<size_t>(m_end - m_current) < chunkSize)
+    {
+        // What is left of the current block is lost, which is at most a chunk smaller than LARGE_ALLOCATION_SIZE
+        constexpr size_t headerSize = (sizeof(block) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        auto newBlock = static_cast<block*>(http_memory::mem_alloc(headerSize + BLOCK_SIZE, HC_MEMORY_TYPE_HTTP_CALL));
+        if (newBlock == nullptr)
+        {
+            return nullptr;
+        }
+        newBlock->next = m_blocks;
+        m_blocks = newBlock;
+        ++m_blockCount;
+        m_current = reinterpret_cast<uint8_t*>(newBlock) + headerSize;
+        m_end = m_current + BLOCK_SIZE;
+    }
+
+    void* p = m_current;
+    m_current += chunkSize;
+    return p;
+}
+
+void http_arena::deallocate(_In_opt_ void* p, _In_ size_t size) noexcept
+{
+    if (p == nullptr)
+    {
+        return;
+    }
+    if (size >= LARGE_ALLOCATION_SIZE)
+    {
+        http_memory::mem_free(p, HC_MEMORY_TYPE_HTTP_CALL);
+        return;
+    }
+
+    size_t chunkSize = (std::max<size_t>(size, 1) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    std::lock_guard<std::mutex> lock{ m_lock };
+    auto chunk = static_cast<free_chunk*>(p);
+    chunk->next = m_freeChunks[chunkSize / ALIGNMENT - 1];
+    m_freeChunks[chunkSize / ALIGNMENT - 1] = chunk;
+}
+
+size_t http_arena::BlockCount() const noexcept
+{
+    return m_blockCount;
+}
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
@@ -5,6 +5,15 @@
 #include <new>
 #include <stddef.h>
 #include <sstream>
+#include <scoped_allocator>
+
+// The HC_MEMORY_TYPE objects of a type are allocated as by Make, http_allocate_shared and http_allocate_unique.
+// Specialized next to the types that have their own.
+template<typename T>
+struct http_memory_type
+{
+    static constexpr HCMemoryType value = HC_MEMORY_TYPE_GENERAL;
+};
 
 NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
 
@@ -12,13 +21,20 @@ class http_memory
 {
 public:
     static _Ret_maybenull_ _Post_writable_byte_size_(size) void* mem_alloc(
-        _In_ size_t size
+        _In_ size_t size,
+        _In_ HCMemoryType memoryType
         );
 
+    // memoryType must be the type the memory was allocated as
     static void mem_free(
-        _In_opt_ void* pAddress
+        _In_opt_ void* pAddress,
+        _In_ HCMemoryType memoryType
         );
 
+    // Returns the blocks cached by the calling thread, and then the slabs none of whose blocks are in use, to the
+    // memory hooks. Slabs left from while thread caching was enabled are freed even once it has been disabled.
+    static void trim() noexcept;
+
     http_memory() = delete;
     http_memory(const http_memory&) = delete;
     http_memory& operator=(const http_memory&) = delete;
@@ -28,7 +44,7 @@ public:
 template<typename T, class... TArgs>
 inline T* Make(TArgs&&... args)
 {
-    auto mem = http_memory::mem_alloc(sizeof(T));
+    auto mem = http_memory::mem_alloc(sizeof(T), http_memory_type<T>::value);
     return new (mem) T(std::forward<TArgs>(args)...);
 }
 
@@ -38,21 +54,22 @@ inline void Delete(T* ptr)
     if (ptr != nullptr)
     {
         ptr->~T();
-        http_memory::mem_free((void*)ptr);
+        http_memory::mem_free((void*)ptr, http_memory_type<T>::value);
     }
 }
 
 class http_memory_buffer
 {
 public:
-    http_memory_buffer(_In_ size_t dwSize)
+    http_memory_buffer(_In_ size_t dwSize, _In_ HCMemoryType memoryType) :
+        m_memoryType{ memoryType }
     {
-        m_pBuffer = http_memory::mem_alloc(dwSize);
+        m_pBuffer = http_memory::mem_alloc(dwSize, m_memoryType);
     }
 
     ~http_memory_buffer()
     {
-        http_memory::mem_free(m_pBuffer);
+        http_memory::mem_free(m_pBuffer, m_memoryType);
         m_pBuffer = nullptr;
     }
 
@@ -63,22 +80,71 @@ public:
 
 private:
     void* m_pBuffer;
+    HCMemoryType m_memoryType;
+};
+
+// A monotonic arena for the many small allocations that share an owner's lifetime, e.g. the strings and headers of
+// an HC_CALL. It hands out memory from its initial block and then from blocks it allocates as it needs them, all of
+// which are freed together when it is destroyed. Freed allocations are kept on free lists by size and reused, so an
+// owner that keeps replacing a value doesn't grow the arena. Allocations of LARGE_ALLOCATION_SIZE or more are made
+// and freed on the heap directly. Everything it allocates is HC_MEMORY_TYPE_HTTP_CALL memory.
+class http_arena
+{
+public:
+    static constexpr size_t ALIGNMENT = 16;
+    static constexpr size_t BLOCK_SIZE = 2048;
+    static constexpr size_t LARGE_ALLOCATION_SIZE = 512;
+
+    http_arena(_In_reads_bytes_opt_(initialBlockSize) void* initialBlock, _In_ size_t initialBlockSize) noexcept;
+    http_arena(const http_arena&) = delete;
+    http_arena& operator=(const http_arena&) = delete;
+    ~http_arena();
+
+    _Ret_maybenull_ void* allocate(_In_ size_t size) noexcept;
+    void deallocate(_In_opt_ void* p, _In_ size_t size) noexcept;
+
+    // The number of blocks allocated after the initial one
+    size_t BlockCount() const noexcept;
+
+private:
+    struct free_chunk
+    {
+        free_chunk* next;
+    };
+
+    struct block
+    {
+        block* next;
+    };
+
+    std::mutex m_lock;
+    uint8_t* m_current;
+    uint8_t* m_end;
+    block* m_blocks{ nullptr };
+    size_t m_blockCount{ 0 };
+    free_chunk* m_freeChunks[LARGE_ALLOCATION_SIZE / ALIGNMENT]{};
 };
 
 NAMESPACE_XBOX_HTTP_CLIENT_END
 
-template<typename T>
+template<typename T, HCMemoryType Type = HC_MEMORY_TYPE_GENERAL>
 class http_stl_allocator
 {
 public:
     typedef T value_type;
 
+    template<class U>
+    struct rebind
+    {
+        typedef http_stl_allocator<U, Type> other;
+    };
+
     http_stl_allocator() = default;
-    template<class U> http_stl_allocator(http_stl_allocator<U> const&) {}
+    template<class U> http_stl_allocator(http_stl_allocator<U, Type> const&) {}
 
     T* allocate(size_t n)
     {
-        T* p = static_cast<T*>(xbox::httpclient::http_memory::mem_alloc(n * sizeof(T)));
+        T* p = static_cast<T*>(xbox::httpclient::http_memory::mem_alloc(n * sizeof(T), Type));
         if (p == nullptr)
         {
             throw std::bad_alloc();
@@ -88,38 +154,42 @@ public:
 
     void deallocate(_In_opt_ void* p, size_t)
     {
-        xbox::httpclient::http_memory::mem_free(p);
+        xbox::httpclient::http_memory::mem_free(p, Type);
     }
 };
 
+// The allocator Make, http_allocate_shared and http_allocate_unique allocate objects of type T with
+template<typename T>
+using http_object_allocator = http_stl_allocator<T, http_memory_type<T>::value>;
+
 template<typename T>
 struct http_alloc_deleter
 {
     http_alloc_deleter() {}
-    http_alloc_deleter(const http_stl_allocator<T>& alloc) : m_alloc(alloc) { }
+    http_alloc_deleter(const http_object_allocator<T>& alloc) : m_alloc(alloc) { }
 
-    void operator()(typename std::allocator_traits<http_stl_allocator<T>>::pointer p) const
+    void operator()(typename std::allocator_traits<http_object_allocator<T>>::pointer p) const
     {
-        http_stl_allocator<T> alloc(m_alloc);
-        std::allocator_traits<http_stl_allocator<T>>::destroy(alloc, std::addressof(*p));
-        std::allocator_traits<http_stl_allocator<T>>::deallocate(alloc, p, 1);
+        http_object_allocator<T> alloc(m_alloc);
+        std::allocator_traits<http_object_allocator<T>>::destroy(alloc, std::addressof(*p));
+        std::allocator_traits<http_object_allocator<T>>::deallocate(alloc, p, 1);
     }
 
 private:
-    http_stl_allocator<T> m_alloc;
+    http_object_allocator<T> m_alloc;
 };
 
 template<typename T, typename... Args>
 std::shared_ptr<T> http_allocate_shared(Args&&... args)
 {
-    return std::allocate_shared<T, http_stl_allocator<T>>(http_stl_allocator<T>(), std::forward<Args>(args)...);
+    return std::allocate_shared<T, http_object_allocator<T>>(http_object_allocator<T>(), std::forward<Args>(args)...);
 }
 
 template<typename T, typename... Args>
 std::unique_ptr<T, http_alloc_deleter<T>> http_allocate_unique(Args&&... args)
 {
-    http_stl_allocator<T> alloc;
-    auto p = std::allocator_traits<http_stl_allocator<T>>::allocate(alloc, 1); // malloc memory
+    http_object_allocator<T> alloc;
+    auto p = std::allocator_traits<http_object_allocator<T>>::allocate(alloc, 1); // malloc memory
     auto o = new(p) T(std::forward<Args>(args)...); // call class ctor using placement new
     return std::unique_ptr<T, http_alloc_deleter<T>>(o, http_alloc_deleter<T>(alloc));
 }
@@ -127,18 +197,85 @@ std::unique_ptr<T, http_alloc_deleter<T>> http_allocate_unique(Args&&... args)
 template<typename T>
 using HC_UNIQUE_PTR = std::unique_ptr<T, http_alloc_deleter<T>>;
 
-template<typename T1, typename T2>
-inline bool operator==(const http_stl_allocator<T1>&, const http_stl_allocator<T2>&)
+template<typename T1, typename T2, HCMemoryType Type>
+inline bool operator==(const http_stl_allocator<T1, Type>&, const http_stl_allocator<T2, Type>&)
 {
     return true;
 }
 
-template<typename T1, typename T2>
-bool operator!=(const http_stl_allocator<T1>&, const http_stl_allocator<T2>&)
+template<typename T1, typename T2, HCMemoryType Type>
+bool operator!=(const http_stl_allocator<T1, Type>&, const http_stl_allocator<T2, Type>&)
 {
     return false;
 }
 
+// A variant of http_stl_allocator that allocates from an http_arena, or from the heap like http_stl_allocator when
+// it has none. Containers keep the allocator they were constructed with, so values assigned to a container that
+// lives in an arena are copied into it, while copies constructed from one go to the heap and can outlive it. Arenas
+// hold call metadata, so heap allocations are made as HC_MEMORY_TYPE_HTTP_CALL.
+template<typename T>
+class http_arena_allocator
+{
+public:
+    typedef T value_type;
+    typedef std::false_type propagate_on_container_copy_assignment;
+    typedef std::false_type propagate_on_container_move_assignment;
+    typedef std::false_type propagate_on_container_swap;
+
+    http_arena_allocator() = default;
+    explicit http_arena_allocator(_In_opt_ xbox::httpclient::http_arena* arena) noexcept : m_arena{ arena } {}
+    template<class U> http_arena_allocator(http_arena_allocator<U> const& other) noexcept : m_arena{ other.arena() } {}
+
+    T* allocate(size_t n)
+    {
+        void* p = m_arena != nullptr ?
+            m_arena->allocate(n * sizeof(T)) :
+            xbox::httpclient::http_memory::mem_alloc(n * sizeof(T), HC_MEMORY_TYPE_HTTP_CALL);
+        if (p == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(_In_opt_ T* p, size_t n)
+    {
+        if (m_arena != nullptr)
+        {
+            m_arena->deallocate(p, n * sizeof(T));
+        }
+        else
+        {
+            xbox::httpclient::http_memory::mem_free(p, HC_MEMORY_TYPE_HTTP_CALL);
+        }
+    }
+
+    http_arena_allocator select_on_container_copy_construction() const noexcept
+    {
+        return http_arena_allocator{};
+    }
+
+    xbox::httpclient::http_arena* arena() const noexcept
+    {
+        return m_arena;
+    }
+
+private:
+    xbox::httpclient::http_arena* m_arena{ nullptr };
+};
+
+template<typename T1, typename T2>
+inline bool operator==(const http_arena_allocator<T1>& l, const http_arena_allocator<T2>& r)
+{
+    return l.arena() == r.arena();
+}
+
+template<typename T1, typename T2>
+bool operator!=(const http_arena_allocator<T1>& l, const http_arena_allocator<T2>& r)
+{
+    return l.arena() != r.arena();
+}
+
 template<class T>
 using http_internal_vector = std::vector<T, http_stl_allocator<T>>;
 
@@ -159,6 +296,15 @@ using http_internal_basic_stringstream = std::basic_stringstream<C, TRAITS, http
 
 using http_internal_stringstream = http_internal_basic_stringstream<char>;
 
+template<class C, class TRAITS = std::char_traits<C>>
+using http_arena_basic_string = std::basic_string<C, TRAITS, http_arena_allocator<C>>;
+
+using http_arena_string = http_arena_basic_string<char>;
+
+// The allocator is passed on to the keys and values, so a map in an arena keeps its strings there too
+template<class K, class V, class LESS = std::less<K>>
+using http_arena_map = std::map<K, V, LESS, std::scoped_allocator_adaptor<http_arena_allocator<std::pair<K const, V>>>>;
+
 template<class T>
 using http_internal_dequeue = std::deque<T, http_stl_allocator<T>>;
 
@@ -0,0 +1,221 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "global.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+thread_local uint32_t routed_handler_list_base::s_notifyDepth{ 0 };
+
+routed_handler_dispatcher::~routed_handler_dispatcher()
+{
+    if (m_queue)
+    {
+        XTaskQueueCloseHandle(m_queue);
+    }
+}
+
+HRESULT routed_handler_dispatcher::SetQueue(_In_opt_ XTaskQueueHandle queue) noexcept
+{
+    XTaskQueueHandle duplicatedQueue = nullptr;
+    if (queue)
+    {
+        RETURN_IF_FAILED(XTaskQueueDuplicateHandle(queue, &duplicatedQueue));
+    }
+
+    XTaskQueueHandle previousQueue = nullptr;
+    {
+        std::lock_guard<std::mutex> lock{ m_lock };
+        previousQueue = m_queue;
+        m_queue = duplicatedQueue;
+
+        // Notifications already queued are delivered on the new queue, or right away if there isn't one
+        m_flushScheduled = false;
+        if (m_queue && (!m_pendingCalls.empty()
+#if !HC_NOWEBSOCKETS
+            || !m_pendingWebSocketMessages.empty()
+#endif
+            ))
+        {
+            ScheduleFlush();
+        }
+    }
+
+    if (previousQueue)
+    {
+        XTaskQueueCloseHandle(previousQueue);
+        if (!duplicatedQueue)
+        {
+            Flush();
+        }
+    }
+    return S_OK;
+}
+
+bool routed_handler_dispatcher::QueueCallNotification(_In_ HCCallHandle call) noexcept
+{
+    std::lock_guard<std::mutex> lock{ m_lock };
+    if (!m_queue)
+    {
+        return false;
+    }
+
+    try
+    {
+        m_pendingCalls.emplace_back(HCHttpCallDuplicateHandle(call));
+    }
+    catch (...)
+    {
+        return false;
+    }
+
+    if (!ScheduleFlush())
+    {
+        m_pendingCalls.pop_back();
+        return false;
+    }
+    return true;
+}
+
+#if !HC_NOWEBSOCKETS
+bool routed_handler_dispatcher::QueueWebSocketNotification(
+    _In_ HCWebsocketHandle websocket,
+    _In_ bool receiving,
+    _In_opt_z_ const char* message,
+    _In_opt_ const uint8_t* payloadBytes,
+    _In_ size_t payloadSize
+) noexcept
+{
+    std::lock_guard<std::mutex> lock{ m_lock };
+    if (!m_queue)
+    {
+        return false;
+    }
+
+    try
+    {
+        // The message is only valid for the duration of the notification, so the batch keeps a copy
+        websocket_notification notification{ HCWebSocketDuplicateHandle(websocket), receiving };
+        if (message)
+        {
+            notification.message = message;
+        }
+        else
+        {
+            notification.isBinary = true;
+            notification.payload.assign(payloadBytes, payloadBytes + payloadSize);
+        }
+        m_pendingWebSocketMessages.push_back(std::move(notification));
+    }
+    catch (...)
+    {
+        return false;
+    }
+
+    if (!ScheduleFlush())
+    {
+        m_pendingWebSocketMessages.pop_back();
+        return false;
+    }
+    return true;
+}
+#endif
+
+bool routed_handler_dispatcher::ScheduleFlush() noexcept
+{
+    if (m_flushScheduled)
+    {
+        return true;
+    }
+
+    HRESULT hr = S_OK;
+    try
+    {
+        hr = RunAsync([] { Flush(); }, m_queue);
+    }
+    catch (...)
+    {
+        hr = E_OUTOFMEMORY;
+    }
+
+    if (FAILED(hr))
+    {
+        HC_TRACE_ERROR_HR(HTTPCLIENT, hr, "Failed to schedule routed handler notifications");
+        return false;
+    }
+
+    m_flushScheduled = true;
+    return true;
+}
+
+void routed_handler_dispatcher::Flush() noexcept
+{
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+    {
+        // Pending notifications were dropped when the singleton was cleaned up
+        return;
+    }
+
+    auto& dispatcher = httpSingleton->m_routedHandlerDispatcher;
+    http_internal_vector<call_notification> calls;
+#if !HC_NOWEBSOCKETS
+    http_internal_vector<websocket_notification> webSocketMessages;
+#endif
+    {
+        std::lock_guard<std::mutex> lock{ dispatcher.m_lock };
+        calls.swap(dispatcher.m_pendingCalls);
+#if !HC_NOWEBSOCKETS
+        webSocketMessages.swap(dispatcher.m_pendingWebSocketMessages);
+#endif
+        dispatcher.m_flushScheduled = false;
+    }
+
+    for (auto const& notification : calls)
+    {
+        httpSingleton->m_callRoutedHandlers.notify(notification.call);
+    }
+
+#if !HC_NOWEBSOCKETS
+    for (auto const& notification : webSocketMessages)
+    {
+        httpSingleton->m_webSocketRoutedHandlers.notify(
+            notification.websocket,
+            notification.receiving,
+            notification.isBinary ? nullptr : notification.message.c_str(),
+            notification.isBinary ? notification.payload.data() : nullptr,
+            notification.isBinary ? notification.payload.size() : 0);
+    }
+#endif
+}
+
+routed_handler_dispatcher::call_notification::~call_notification()
+{
+    if (call)
+    {
+        HCHttpCallCloseHandle(call);
+    }
+}
+
+#if !HC_NOWEBSOCKETS
+routed_handler_dispatcher::websocket_notification::websocket_notification(websocket_notification&& other) noexcept :
+    websocket{ other.websocket },
+    receiving{ other.receiving },
+    isBinary{ other.isBinary },
+    message{ std::move(other.message) },
+    payload{ std::move(other.payload) }
+{
+    other.websocket = nullptr;
+}
+
+routed_handler_dispatcher::websocket_notification::~websocket_notification()
+{
+    if (websocket)
+    {
+        HCWebSocketCloseHandle(websocket);
+    }
+}
+#endif
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
@@ -0,0 +1,205 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+class routed_handler_list_base
+{
+protected:
+    // Number of routed handler notifications in progress on this thread, across every handler list
+    static thread_local uint32_t s_notifyDepth;
+};
+
+// Handlers registered with HCAddCallRoutedHandler & HCAddWebSocketRoutedHandler. Notifying takes an immutable
+// snapshot of the handlers and invokes them without holding a lock, so a slow handler only delays the thread it
+// runs on. add & remove copy the snapshot and atomically swap the new one in, and remove then waits out the
+// notifications that were already running.
+template<typename THandler>
+class routed_handler_list : private routed_handler_list_base
+{
+public:
+    bool add(int32_t id, THandler handler, _In_opt_ void* context) noexcept
+    {
+        try
+        {
+            std::lock_guard<std::mutex> lock{ m_lock };
+            auto current = load();
+            auto updated = http_allocate_shared<snapshot>();
+            if (current)
+            {
+                *updated = *current;
+            }
+            updated->push_back(entry{ id, handler, context });
+            std::atomic_store(&m_snapshot, std::shared_ptr<const snapshot>{ std::move(updated) });
+            return true;
+        }
+        catch (...)
+        {
+            return false;
+        }
+    }
+
+    // Once remove returns the handler is no longer being invoked on any thread. When called from within a
+    // routed handler, the removal only applies to notifications that start afterwards.
+    void remove(int32_t id) noexcept
+    {
+        try
+        {
+            std::lock_guard<std::mutex> lock{ m_lock };
+            auto previous = load();
+            if (!previous)
+            {
+                return;
+            }
+
+            auto updated = http_allocate_shared<snapshot>();
+            std::copy_if(previous->begin(), previous->end(), std::back_inserter(*updated), [id](entry const& e) { return e.id != id; });
+            if (updated->size() == previous->size())
+            {
+                return;
+            }
+            std::atomic_store(&m_snapshot, std::shared_ptr<const snapshot>{ std::move(updated) });
+        }
+        catch (...)
+        {
+            return;
+        }
+
+        // Waiting from inside a handler could deadlock on itself
+        if (s_notifyDepth > 0)
+        {
+            return;
+        }
+
+        // Any notification that could have loaded a snapshot with the handler in it, however old, counted itself
+        // in the current epoch first. New ones count in the other epoch and can only load the updated snapshot,
+        // so they can't keep this one waiting.
+        std::lock_guard<std::mutex> removeLock{ m_removeLock };
+        uint32_t epoch = m_epoch.load();
+        m_epoch.store(epoch ^ 1);
+        while (m_activeNotifications[epoch].load() > 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    bool empty() const noexcept
+    {
+        auto current = load();
+        return !current || current->empty();
+    }
+
+    template<typename... TArgs>
+    void notify(TArgs... args) const noexcept
+    {
+        uint32_t epoch = m_epoch.load();
+        ++m_activeNotifications[epoch];
+
+        auto current = load();
+        if (current)
+        {
+            ++s_notifyDepth;
+            for (auto const& e : *current)
+            {
+                e.handler(args..., e.context);
+            }
+            --s_notifyDepth;
+        }
+
+        --m_activeNotifications[epoch];
+    }
+
+private:
+    struct entry
+    {
+        int32_t id;
+        THandler handler;
+        void* context;
+    };
+
+    using snapshot = http_internal_vector<entry>;
+
+    std::shared_ptr<const snapshot> load() const noexcept
+    {
+        return std::atomic_load(&m_snapshot);
+    }
+
+    std::mutex m_lock;
+    std::shared_ptr<const snapshot> m_snapshot;
+
+    // Notifications in progress, counted in the epoch they started in. remove flips the epoch and waits for
+    // the one it left to drain.
+    std::mutex m_removeLock;
+    std::atomic<uint32_t> m_epoch{ 0 };
+    mutable std::atomic<uint32_t> m_activeNotifications[2]{};
+};
+
+// Delivers routed handler notifications in batches on the task queue set with HCSetRoutedHandlerQueue. Handlers
+// are looked up when a batch is delivered, so a handler removed in the meantime isn't invoked.
+class routed_handler_dispatcher
+{
+public:
+    routed_handler_dispatcher() = default;
+    routed_handler_dispatcher(const routed_handler_dispatcher&) = delete;
+    routed_handler_dispatcher& operator=(const routed_handler_dispatcher&) = delete;
+    ~routed_handler_dispatcher();
+
+    // A nullptr queue makes notifications synchronous again
+    HRESULT SetQueue(_In_opt_ XTaskQueueHandle queue) noexcept;
+
+    // Returns false if notifications are synchronous and the caller should invoke the handlers itself
+    bool QueueCallNotification(_In_ HCCallHandle call) noexcept;
+
+#if !HC_NOWEBSOCKETS
+    bool QueueWebSocketNotification(
+        _In_ HCWebsocketHandle websocket,
+        _In_ bool receiving,
+        _In_opt_z_ const char* message,
+        _In_opt_ const uint8_t* payloadBytes,
+        _In_ size_t payloadSize
+    ) noexcept;
+#endif
+
+private:
+    struct call_notification
+    {
+        call_notification(HCCallHandle c) noexcept : call{ c } {}
+        call_notification(call_notification&& other) noexcept : call{ other.call } { other.call = nullptr; }
+        call_notification& operator=(const call_notification&) = delete;
+        ~call_notification();
+
+        HCCallHandle call;
+    };
+
+#if !HC_NOWEBSOCKETS
+    struct websocket_notification
+    {
+        websocket_notification(HCWebsocketHandle w, bool r) noexcept : websocket{ w }, receiving{ r } {}
+        websocket_notification(websocket_notification&& other) noexcept;
+        websocket_notification& operator=(const websocket_notification&) = delete;
+        ~websocket_notification();
+
+        HCWebsocketHandle websocket;
+        bool receiving;
+        bool isBinary{ false };
+        http_internal_string message;
+        http_internal_vector<uint8_t> payload;
+    };
+#endif
+
+    // Must be called with m_lock held
+    bool ScheduleFlush() noexcept;
+    static void Flush() noexcept;
+
+    std::mutex m_lock;
+    XTaskQueueHandle m_queue{ nullptr };
+    bool m_flushScheduled{ false };
+    http_internal_vector<call_notification> m_pendingCalls;
+#if !HC_NOWEBSOCKETS
+    http_internal_vector<websocket_notification> m_pendingWebSocketMessages;
+#endif
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
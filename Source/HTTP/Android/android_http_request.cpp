@@ -119,7 +119,7 @@ HRESULT HttpRequest::AddHeader(const char* headerName, const char* headerValue)
     return S_OK;
 }
 
-HRESULT HttpRequest::SetMethodAndBody(HCCallHandle call, const char* method, const char* contentType, uint32_t bodySize)
+HRESULT HttpRequest::SetMethodAndBody(HCCallHandle call, const char* method, const char* contentType, int64_t bodySize)
 {
     JNIEnv* jniEnv = nullptr;
     HRESULT result = GetJniEnv(&jniEnv);
@@ -227,7 +227,9 @@ void Internal_HCHttpCallPerformAsync(
         HCHttpCallRequestGetHeader(call, "Content-Type", &contentType);
     }
 
-    httpRequest->SetMethodAndBody(call, requestMethod, contentType, requestBodySize);
+    // OkHttp sends a body with a content length of -1 using chunked transfer encoding
+    int64_t contentLength = requestBodySize == HC_UNKNOWN_REQUEST_BODY_SIZE ? -1 : static_cast<int64_t>(requestBodySize);
+    httpRequest->SetMethodAndBody(call, requestMethod, contentType, contentLength);
 
     HCHttpCallSetContext(call, httpRequest.get());
     result = httpRequest->ExecuteAsync(call);
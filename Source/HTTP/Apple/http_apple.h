@@ -13,6 +13,7 @@ public:
     bool initiate_request();
 
 private:
+    void response_handler(NSURLResponse* response);
     void completion_handler(NSURLResponse* response, NSError* error);
     
     HCCallHandle m_call; // non owning
@@ -20,6 +21,7 @@ private:
     
     NSURLSession* m_session;
     NSURLSessionTask* m_sessionTask;
+    bool m_receivedResponse;
 };
 
 NAMESPACE_XBOX_HTTP_CLIENT_END
@@ -11,7 +11,8 @@ NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
 http_task_apple::http_task_apple(_Inout_ XAsyncBlock* asyncBlock, _In_ HCCallHandle call) :
     m_call(call),
     m_asyncBlock(asyncBlock),
-    m_sessionTask(nullptr)
+    m_sessionTask(nullptr),
+    m_receivedResponse(false)
 {
     NSURLSessionConfiguration* configuration = NSURLSessionConfiguration.ephemeralSessionConfiguration;
 
@@ -25,13 +26,36 @@ http_task_apple::http_task_apple(_Inout_ XAsyncBlock* asyncBlock, _In_ HCCallHan
     [configuration setTimeoutIntervalForRequest:(NSTimeInterval)timeoutInSeconds];
     [configuration setTimeoutIntervalForResource:(NSTimeInterval)timeoutInSeconds];
 
-    SessionDelegate* delegate = [SessionDelegate sessionDelegateWithHCCallHandle:m_call andCompletionHandler:^(NSURLResponse *response, NSError *error) {
+    SessionDelegate* delegate = [SessionDelegate sessionDelegateWithHCCallHandle:m_call andResponseHandler:^(NSURLResponse *response) {
+        this->response_handler(response);
+    } andCompletionHandler:^(NSURLResponse *response, NSError *error) {
         std::unique_ptr<http_task_apple> me{this};
         me->completion_handler(response, error);
     }];
     m_session = [NSURLSession sessionWithConfiguration:configuration delegate:delegate delegateQueue:nil];
 }
 
+void http_task_apple::response_handler(NSURLResponse* response)
+{
+    assert([response isKindOfClass:[NSHTTPURLResponse class]]);
+    NSHTTPURLResponse* httpResponse = (NSHTTPURLResponse*)response;
+    m_receivedResponse = true;
+
+    NSDictionary* headers = [httpResponse allHeaderFields];
+    for (NSString* key in headers)
+    {
+        NSString* value = headers[key];
+
+        char const* keyCString = [key cStringUsingEncoding:NSUTF8StringEncoding];
+        char const* valueCString = [value cStringUsingEncoding:NSUTF8StringEncoding];
+        HCHttpCallResponseSetHeader(m_call, keyCString, valueCString);
+    }
+
+    // Set last, so a status tells the body's write function the headers are all there
+    uint32_t statusCode = static_cast<uint32_t>([httpResponse statusCode]);
+    HCHttpCallResponseSetStatusCode(m_call, statusCode);
+}
+
 void http_task_apple::completion_handler(NSURLResponse* response, NSError* error)
 {
     if (error)
@@ -49,21 +73,9 @@ void http_task_apple::completion_handler(NSURLResponse* response, NSError* error
         return;
     }
 
-    assert([response isKindOfClass:[NSHTTPURLResponse class]]);
-    NSHTTPURLResponse* httpResponse = (NSHTTPURLResponse*)response;
-
-    uint32_t statusCode = static_cast<uint32_t>([httpResponse statusCode]);
-
-    HCHttpCallResponseSetStatusCode(m_call, statusCode);
-
-    NSDictionary* headers = [httpResponse allHeaderFields];
-    for (NSString* key in headers)
+    if (!m_receivedResponse)
     {
-        NSString* value = headers[key];
-
-        char const* keyCString = [key cStringUsingEncoding:NSUTF8StringEncoding];
-        char const* valueCString = [value cStringUsingEncoding:NSUTF8StringEncoding];
-        HCHttpCallResponseSetHeader(m_call, keyCString, valueCString);
+        response_handler(response);
     }
 
     XAsyncComplete(m_asyncBlock, S_OK, 0);
@@ -123,7 +135,12 @@ bool http_task_apple::initiate_request()
     if (requestBodySize > 0)
     {
         [request setHTTPBodyStream:[RequestBodyStream requestBodyStreamWithHCCallHandle:m_call]];
-        [request addValue:[NSString stringWithFormat:@"%zu", requestBodySize] forHTTPHeaderField:@"Content-Length"];
+
+        // Without a Content-Length NSURLSession streams the body using chunked transfer encoding
+        if (requestBodySize != HC_UNKNOWN_REQUEST_BODY_SIZE)
+        {
+            [request addValue:[NSString stringWithFormat:@"%zu", requestBodySize] forHTTPHeaderField:@"Content-Length"];
+        }
     }
 
     m_sessionTask = [m_session dataTaskWithRequest:request];
@@ -5,5 +5,5 @@
 #import <Foundation/Foundation.h>
 
 @interface SessionDelegate : NSObject<NSURLSessionTaskDelegate, NSURLSessionDataDelegate>
-+ (SessionDelegate*) sessionDelegateWithHCCallHandle:(HCCallHandle) call andCompletionHandler:(void(^)(NSURLResponse* response, NSError* error)) completion;
++ (SessionDelegate*) sessionDelegateWithHCCallHandle:(HCCallHandle) call andResponseHandler:(void(^)(NSURLResponse* response)) responseHandler andCompletionHandler:(void(^)(NSURLResponse* response, NSError* error)) completion;
 @end
@@ -7,19 +7,21 @@
 @implementation SessionDelegate
 {
     HCCallHandle _call;
+    void(^_responseHandler)(NSURLResponse* response);
     void(^_completionHandler)(NSURLResponse* response, NSError* error);
 }
 
-+ (SessionDelegate*) sessionDelegateWithHCCallHandle:(HCCallHandle) call andCompletionHandler:(void(^)(NSURLResponse* response, NSError* error)) completionHandler
++ (SessionDelegate*) sessionDelegateWithHCCallHandle:(HCCallHandle) call andResponseHandler:(void(^)(NSURLResponse* response)) responseHandler andCompletionHandler:(void(^)(NSURLResponse* response, NSError* error)) completionHandler
 {
-    return [[SessionDelegate alloc] initWithHCCallHandle: call andCompletionHandler:completionHandler];
+    return [[SessionDelegate alloc] initWithHCCallHandle: call andResponseHandler:responseHandler andCompletionHandler:completionHandler];
 }
 
-- (instancetype) initWithHCCallHandle:(HCCallHandle)call andCompletionHandler:(void(^)(NSURLResponse*, NSError*)) completionHandler
+- (instancetype) initWithHCCallHandle:(HCCallHandle)call andResponseHandler:(void(^)(NSURLResponse*)) responseHandler andCompletionHandler:(void(^)(NSURLResponse*, NSError*)) completionHandler
 {
     if (self = [super init])
     {
         _call = call;
+        _responseHandler = responseHandler;
         _completionHandler = completionHandler;
         return self;
     }
@@ -31,6 +33,13 @@
     _completionHandler([task response], error);
 }
 
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)task didReceiveResponse:(NSURLResponse *)response completionHandler:(void (^)(NSURLSessionResponseDisposition disposition))completionHandler
+{
+    // The status and headers are needed by the time the body arrives, e.g. to tell how it's encoded
+    _responseHandler(response);
+    completionHandler(NSURLSessionResponseAllow);
+}
+
 - (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)task didReceiveData:(NSData *)data
 {
     HCHttpCallResponseBodyWriteFunction writeFunction = nullptr;
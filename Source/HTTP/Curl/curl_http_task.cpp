@@ -0,0 +1,861 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#include "pch.h"
+#include "curl_http_task.h"
+#include "../httpcall.h"
+#include "tls_session_cache.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+namespace
+{
+
+// curl_multi_poll returns early whenever a transfer needs attention or curl_multi_wakeup is called, so this only
+// bounds how long an idle loop sleeps
+constexpr int IDLE_POLL_TIMEOUT_MS = 1000;
+constexpr long MAX_REDIRECTS = 10;
+
+HRESULT HResultFromCurl(CURLcode result) noexcept
+{
+    switch (result)
+    {
+        case CURLE_OK: return S_OK;
+        case CURLE_OUT_OF_MEMORY: return E_OUTOFMEMORY;
+        default: return E_FAIL;
+    }
+}
+
+bool IsWhitespace(char c) noexcept
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// HTTP/2 stream weight (1-256, 16 by default) for a call priority
+long StreamWeight(HCHttpCallPriority priority) noexcept
+{
+    switch (priority)
+    {
+        case HCHttpCallPriority::Low: return 8;
+        case HCHttpCallPriority::High: return 128;
+        default: return 16;
+    }
+}
+
+}
+
+curl_http_task::curl_http_task(
+    _In_opt_ HCCallHandle call,
+    _Inout_ XAsyncBlock* asyncBlock,
+    _In_ curl_event_loop* eventLoop,
+    _In_ uint64_t token
+) noexcept :
+    m_call{ call != nullptr ? HCHttpCallDuplicateHandle(call) : nullptr },
+    m_asyncBlock{ asyncBlock },
+    m_eventLoop{ eventLoop },
+    m_token{ token }
+{
+}
+
+curl_http_task::~curl_http_task()
+{
+    if (m_curl != nullptr)
+    {
+        curl_easy_cleanup(m_curl);
+    }
+    if (m_requestHeaders != nullptr)
+    {
+        curl_slist_free_all(m_requestHeaders);
+    }
+    if (m_call != nullptr)
+    {
+        HCHttpCallCloseHandle(m_call);
+    }
+}
+
+template<typename T>
+HRESULT curl_http_task::SetOption(CURLoption option, T value) noexcept
+{
+    return HResultFromCurl(curl_easy_setopt(m_curl, option, value));
+}
+
+HRESULT curl_http_task::Initialize(_In_opt_z_ const char* proxy, _In_opt_ CURLSH* share, _In_opt_ tls_session_cache* tlsSessionCache) noexcept
+{
+    m_curl = curl_easy_init();
+    if (m_curl == nullptr)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    const char* method = nullptr;
+    const char* url = nullptr;
+    uint32_t timeoutInSeconds = 0;
+    RETURN_IF_FAILED(HCHttpCallRequestGetUrl(m_call, &method, &url));
+    RETURN_IF_FAILED(HCHttpCallRequestGetTimeout(m_call, &timeoutInSeconds));
+    RETURN_IF_FAILED(HCHttpCallRequestGetRequestBodyReadFunction(m_call, &m_readFunction, &m_requestBodySize, &m_readContext));
+    RETURN_IF_FAILED(HCHttpCallResponseGetResponseBodyWriteFunction(m_call, &m_writeFunction, &m_writeContext));
+
+    RETURN_IF_FAILED(SetConnectionOptions(url, proxy, share, tlsSessionCache));
+    RETURN_IF_FAILED(SetOption(CURLOPT_TIMEOUT, static_cast<long>(timeoutInSeconds)));
+    RETURN_IF_FAILED(SetOption(CURLOPT_FOLLOWLOCATION, 1L));
+    RETURN_IF_FAILED(SetOption(CURLOPT_MAXREDIRS, MAX_REDIRECTS));
+    RETURN_IF_FAILED(SetOption(CURLOPT_WRITEFUNCTION, WriteCallback));
+    RETURN_IF_FAILED(SetOption(CURLOPT_WRITEDATA, this));
+    RETURN_IF_FAILED(SetOption(CURLOPT_HEADERFUNCTION, HeaderCallback));
+    RETURN_IF_FAILED(SetOption(CURLOPT_HEADERDATA, this));
+
+    // Multiplex onto an existing HTTP/2 connection rather than opening another one while it is being negotiated.
+    // HPACK state and flow control windows live with the connection inside curl's HTTP/2 layer. curl builds without
+    // HTTP/2 reject the default version and simply use HTTP/1.1, but an explicitly requested HTTP/2 fails the call.
+    HCHttpVersion httpVersion = HCHttpVersion::Default;
+    HCHttpCallPriority priority = HCHttpCallPriority::Normal;
+    RETURN_IF_FAILED(HCHttpCallRequestGetHttpVersion(m_call, &httpVersion));
+    RETURN_IF_FAILED(HCHttpCallRequestGetPriority(m_call, &priority));
+    switch (httpVersion)
+    {
+        case HCHttpVersion::Http1_1:
+            RETURN_IF_FAILED(SetOption(CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_1_1)));
+            break;
+        case HCHttpVersion::Http2:
+            RETURN_IF_FAILED(SetOption(CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2_0)));
+            break;
+        case HCHttpVersion::Http2PriorKnowledge:
+            RETURN_IF_FAILED(SetOption(CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE)));
+            break;
+        default:
+            (void)SetOption(CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2TLS));
+            break;
+    }
+    RETURN_IF_FAILED(SetOption(CURLOPT_PIPEWAIT, 1L));
+    (void)SetOption(CURLOPT_STREAM_WEIGHT, StreamWeight(priority));
+
+    bool hasBody = m_requestBodySize > 0 && m_readFunction != nullptr;
+    if (hasBody)
+    {
+        // A body of unknown size goes out with chunked transfer encoding
+        curl_off_t bodySize = m_requestBodySize == HC_UNKNOWN_REQUEST_BODY_SIZE ? -1 : static_cast<curl_off_t>(m_requestBodySize);
+        RETURN_IF_FAILED(SetOption(CURLOPT_UPLOAD, 1L));
+        RETURN_IF_FAILED(SetOption(CURLOPT_INFILESIZE_LARGE, bodySize));
+        RETURN_IF_FAILED(SetOption(CURLOPT_READFUNCTION, ReadCallback));
+        RETURN_IF_FAILED(SetOption(CURLOPT_READDATA, this));
+        RETURN_IF_FAILED(SetOption(CURLOPT_SEEKFUNCTION, SeekCallback));
+        RETURN_IF_FAILED(SetOption(CURLOPT_SEEKDATA, this));
+    }
+
+    if (str_icmp(method, "HEAD") == 0)
+    {
+        RETURN_IF_FAILED(SetOption(CURLOPT_NOBODY, 1L));
+    }
+    else if (hasBody || str_icmp(method, "GET") != 0)
+    {
+        // Uploads default to PUT
+        RETURN_IF_FAILED(SetOption(CURLOPT_CUSTOMREQUEST, method));
+    }
+
+    return SetRequestHeaders();
+}
+
+HRESULT curl_http_task::InitializePreconnect(_In_z_ const char* url, _In_opt_z_ const char* proxy, _In_opt_ CURLSH* share, _In_opt_ tls_session_cache* tlsSessionCache) noexcept
+{
+    m_curl = curl_easy_init();
+    if (m_curl == nullptr)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    RETURN_IF_FAILED(SetConnectionOptions(url, proxy, share, tlsSessionCache));
+    return SetOption(CURLOPT_CONNECT_ONLY, 1L);
+}
+
+HRESULT curl_http_task::SetConnectionOptions(_In_z_ const char* url, _In_opt_z_ const char* proxy, _In_opt_ CURLSH* share, _In_opt_ tls_session_cache* tlsSessionCache) noexcept
+{
+    RETURN_IF_FAILED(SetOption(CURLOPT_PRIVATE, this));
+    RETURN_IF_FAILED(SetOption(CURLOPT_URL, url));
+    RETURN_IF_FAILED(SetOption(CURLOPT_NOSIGNAL, 1L));
+    RETURN_IF_FAILED(SetOption(CURLOPT_ERRORBUFFER, m_errorBuffer));
+
+    if (proxy != nullptr)
+    {
+        RETURN_IF_FAILED(SetOption(CURLOPT_PROXY, proxy));
+    }
+
+    // curl keeps TLS sessions with the easy handle, which lives for one call, unless they are shared
+    if (share != nullptr)
+    {
+        RETURN_IF_FAILED(SetOption(CURLOPT_SHARE, share));
+    }
+    if (tlsSessionCache != nullptr)
+    {
+        RETURN_IF_FAILED(SetOption(CURLOPT_SSL_CTX_FUNCTION, SslContextCallback));
+        RETURN_IF_FAILED(SetOption(CURLOPT_SSL_CTX_DATA, tlsSessionCache));
+    }
+    return S_OK;
+}
+
+HRESULT curl_http_task::SetRequestHeaders() noexcept
+try
+{
+    bool expectSet = false;
+    http_internal_string line;
+    for (auto const& header : m_call->requestHeaders.get())
+    {
+        expectSet |= str_icmp(header.first.c_str(), "Expect") == 0;
+
+        // "Name;" is how curl sends a header with an empty value
+        line.assign(header.first.data(), header.first.size());
+        if (header.second.empty())
+        {
+            line += ";";
+        }
+        else
+        {
+            line += ": ";
+            line.append(header.second.data(), header.second.size());
+        }
+
+        curl_slist* headers = curl_slist_append(m_requestHeaders, line.c_str());
+        RETURN_HR_IF(E_OUTOFMEMORY, headers == nullptr);
+        m_requestHeaders = headers;
+    }
+
+    // curl waits for a 100 Continue before sending larger bodies, which costs a round trip most servers never need
+    if (!expectSet)
+    {
+        curl_slist* headers = curl_slist_append(m_requestHeaders, "Expect:");
+        RETURN_HR_IF(E_OUTOFMEMORY, headers == nullptr);
+        m_requestHeaders = headers;
+    }
+
+    return SetOption(CURLOPT_HTTPHEADER, m_requestHeaders);
+}
+CATCH_RETURN()
+
+size_t curl_http_task::ReadCallback(char* buffer, size_t size, size_t count, void* context) noexcept
+{
+    auto task = static_cast<curl_http_task*>(context);
+    size_t bytesWritten = 0;
+    try
+    {
+        HRESULT hr = task->m_readFunction(task->m_call, task->m_requestBodyOffset, size * count, task->m_readContext, reinterpret_cast<uint8_t*>(buffer), &bytesWritten);
+        if (hr == E_PENDING)
+        {
+            // curl asks again once the transfer is unpaused
+            return CURL_READFUNC_PAUSE;
+        }
+        if (FAILED(hr))
+        {
+            task->m_callbackResult = hr;
+            return CURL_READFUNC_ABORT;
+        }
+    }
+    catch (...)
+    {
+        task->m_callbackResult = E_FAIL;
+        return CURL_READFUNC_ABORT;
+    }
+
+    task->m_requestBodyOffset += bytesWritten;
+    return bytesWritten;
+}
+
+int curl_http_task::SeekCallback(void* context, curl_off_t offset, int origin) noexcept
+{
+    // curl rewinds the body when it has to send it again, e.g. after a redirect
+    auto task = static_cast<curl_http_task*>(context);
+    if (origin != SEEK_SET || offset < 0)
+    {
+        return CURL_SEEKFUNC_CANTSEEK;
+    }
+
+    task->m_requestBodyOffset = static_cast<size_t>(offset);
+    return CURL_SEEKFUNC_OK;
+}
+
+size_t curl_http_task::WriteCallback(char* buffer, size_t size, size_t count, void* context) noexcept
+{
+    auto task = static_cast<curl_http_task*>(context);
+    size_t bytesAvailable = size * count;
+    if (task->m_writePaused)
+    {
+        // curl holds on to these bytes and passes them again once the transfer is unpaused, and reads nothing more
+        // from the connection in the meantime
+        return CURL_WRITEFUNC_PAUSE;
+    }
+
+    try
+    {
+        HRESULT hr = task->m_writeFunction(task->m_call, reinterpret_cast<const uint8_t*>(buffer), bytesAvailable, task->m_writeContext);
+        if (FAILED(hr))
+        {
+            task->m_callbackResult = hr;
+            return 0;
+        }
+    }
+    catch (...)
+    {
+        task->m_callbackResult = E_FAIL;
+        return 0;
+    }
+
+    task->m_writePaused = http_call_take_write_pause(task->m_call);
+    return bytesAvailable;
+}
+
+size_t curl_http_task::HeaderCallback(char* buffer, size_t size, size_t count, void* context) noexcept
+{
+    auto task = static_cast<curl_http_task*>(context);
+    size_t length = size * count;
+    const char* begin = buffer;
+    const char* end = buffer + length;
+
+    // Every response, including interim 1xx responses and redirects, starts with a status line. Only the
+    // headers of the final response are kept.
+    if (length >= 5 && std::memcmp(begin, "HTTP/", 5) == 0)
+    {
+        task->m_call->responseHeaders.clear();
+        return length;
+    }
+
+    const char* colon = static_cast<const char*>(std::memchr(begin, ':', length));
+    if (colon == nullptr || colon == begin)
+    {
+        return length;
+    }
+
+    const char* valueBegin = colon + 1;
+    while (valueBegin < end && IsWhitespace(*valueBegin))
+    {
+        ++valueBegin;
+    }
+    const char* valueEnd = end;
+    while (valueEnd > valueBegin && IsWhitespace(*(valueEnd - 1)))
+    {
+        --valueEnd;
+    }
+
+    HRESULT hr = HCHttpCallResponseSetHeaderWithLength(task->m_call, begin, static_cast<size_t>(colon - begin), valueBegin, static_cast<size_t>(valueEnd - valueBegin));
+    if (FAILED(hr))
+    {
+        task->m_callbackResult = hr;
+        return 0;
+    }
+    return length;
+}
+
+CURLcode curl_http_task::SslContextCallback(CURL* /*curl*/, void* sslContext, void* context) noexcept
+{
+#if HC_TLS_SESSION_CACHE
+    // Called with each new connection's context. A connection that can't be counted still goes ahead.
+    (void)static_cast<tls_session_cache*>(context)->CountHandshakes(static_cast<ssl_ctx_st*>(sslContext));
+#else
+    UNREFERENCED_PARAMETER(sslContext);
+    UNREFERENCED_PARAMETER(context);
+#endif
+    return CURLE_OK;
+}
+
+void curl_http_task::Complete(_In_ CURLcode result) noexcept
+{
+    if (m_canceled)
+    {
+        Abort();
+        return;
+    }
+
+    if (m_call == nullptr)
+    {
+        if (result != CURLE_OK)
+        {
+            HC_TRACE_ERROR(HTTPCLIENT, "curl_http_task preconnect failed with CURLcode %d: %s", static_cast<int>(result), m_errorBuffer[0] != '\0' ? m_errorBuffer : curl_easy_strerror(result));
+        }
+        Finish(HResultFromCurl(result));
+        return;
+    }
+
+    if (result == CURLE_OK)
+    {
+        long statusCode = 0;
+        curl_easy_getinfo(m_curl, CURLINFO_RESPONSE_CODE, &statusCode);
+        HCHttpCallResponseSetStatusCode(m_call, static_cast<uint32_t>(statusCode));
+    }
+    else
+    {
+        // Errors from the call's own read & write functions are reported as is
+        HRESULT hr = FAILED(m_callbackResult) ? m_callbackResult : HResultFromCurl(result);
+        const char* message = m_errorBuffer[0] != '\0' ? m_errorBuffer : curl_easy_strerror(result);
+        if (m_call->traceCall) { HC_TRACE_ERROR(HTTPCLIENT, "curl_http_task [ID %llu] transfer failed with CURLcode %d: %s", TO_ULL(m_call->id), static_cast<int>(result), message); }
+
+        HCHttpCallResponseSetNetworkErrorCode(m_call, hr, static_cast<uint32_t>(result));
+        HCHttpCallResponseSetPlatformNetworkErrorMessage(m_call, message);
+    }
+
+    Finish(S_OK);
+}
+
+void curl_http_task::Abort() noexcept
+{
+    Finish(E_ABORT);
+}
+
+void curl_http_task::Resume() noexcept
+{
+    m_writePaused = false;
+    curl_easy_pause(m_curl, CURLPAUSE_CONT);
+}
+
+void curl_http_task::Finish(_In_ HRESULT result) noexcept
+{
+    // The cancel & resume handlers may be running on another thread, so they're cleared before this task goes away
+    if (m_call != nullptr)
+    {
+        http_call_clear_cancel_handler(m_call);
+        http_call_clear_resume_handler(m_call);
+    }
+    XAsyncComplete(m_asyncBlock, result, 0);
+}
+
+void curl_http_task::CancelHandler(_In_ HCCallHandle /*call*/, _In_opt_ void* context)
+{
+    auto task = static_cast<curl_http_task*>(context);
+    task->m_canceled = true;
+    task->m_eventLoop->Cancel(task->m_token);
+}
+
+void curl_http_task::ResumeHandler(_In_ HCCallHandle /*call*/, _In_opt_ void* context)
+{
+    auto task = static_cast<curl_http_task*>(context);
+    task->m_eventLoop->Resume(task->m_token);
+}
+
+curl_event_loop::~curl_event_loop()
+{
+    if (m_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock{ m_lock };
+            m_stopping = true;
+        }
+        curl_multi_wakeup(m_multi);
+        m_thread.join();
+    }
+
+    if (m_multi != nullptr)
+    {
+        curl_multi_cleanup(m_multi);
+    }
+}
+
+HRESULT curl_event_loop::Initialize() noexcept
+try
+{
+    m_multi = curl_multi_init();
+    RETURN_HR_IF(E_OUTOFMEMORY, m_multi == nullptr);
+    RETURN_IF_FAILED(curl_multi_setopt(m_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX) == CURLM_OK ? S_OK : E_FAIL);
+
+    m_thread = std::thread([this] { Run(); });
+    return S_OK;
+}
+CATCH_RETURN()
+
+HRESULT curl_event_loop::Perform(HC_UNIQUE_PTR<curl_http_task> task) noexcept
+{
+    try
+    {
+        std::lock_guard<std::mutex> lock{ m_lock };
+        m_addedTasks.push_back(std::move(task));
+    }
+    catch (...)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    curl_multi_wakeup(m_multi);
+    return S_OK;
+}
+
+void curl_event_loop::Cancel(_In_ uint64_t token) noexcept
+{
+    try
+    {
+        std::lock_guard<std::mutex> lock{ m_lock };
+        m_canceledTokens.push_back(token);
+    }
+    catch (...)
+    {
+        // The task sees its canceled flag when its transfer completes
+        return;
+    }
+
+    curl_multi_wakeup(m_multi);
+}
+
+void curl_event_loop::Resume(_In_ uint64_t token) noexcept
+{
+    try
+    {
+        std::lock_guard<std::mutex> lock{ m_lock };
+        m_resumedTokens.push_back(token);
+    }
+    catch (...)
+    {
+        // The transfer stays paused until its timeout
+        return;
+    }
+
+    curl_multi_wakeup(m_multi);
+}
+
+void curl_event_loop::Run() noexcept
+{
+    http_internal_vector<HC_UNIQUE_PTR<curl_http_task>> addedTasks;
+    http_internal_vector<uint64_t> canceledTokens;
+    http_internal_vector<uint64_t> resumedTokens;
+
+    while (true)
+    {
+        bool stopping = false;
+        {
+            std::lock_guard<std::mutex> lock{ m_lock };
+            addedTasks.swap(m_addedTasks);
+            canceledTokens.swap(m_canceledTokens);
+            resumedTokens.swap(m_resumedTokens);
+            stopping = m_stopping;
+        }
+
+        for (auto& task : addedTasks)
+        {
+            if (stopping || task->IsCanceled())
+            {
+                task->Abort();
+                continue;
+            }
+
+            CURLMcode result = curl_multi_add_handle(m_multi, task->Handle());
+            if (result == CURLM_OK)
+            {
+                try
+                {
+                    uint64_t token = task->Token();
+                    m_activeTasks.emplace(token, std::move(task));
+                    continue;
+                }
+                catch (...)
+                {
+                    curl_multi_remove_handle(m_multi, task->Handle());
+                }
+            }
+            task->Complete(result == CURLM_OUT_OF_MEMORY ? CURLE_OUT_OF_MEMORY : CURLE_FAILED_INIT);
+        }
+        addedTasks.clear();
+
+        for (uint64_t token : canceledTokens)
+        {
+            auto iter = m_activeTasks.find(token);
+            if (iter != m_activeTasks.end())
+            {
+                // On an HTTP/2 connection this resets just the call's stream, the connection stays up for the others
+                curl_multi_remove_handle(m_multi, iter->second->Handle());
+                iter->second->Abort();
+                m_activeTasks.erase(iter);
+            }
+        }
+        canceledTokens.clear();
+
+        // Transfers that finished or were canceled since are already gone
+        for (uint64_t token : resumedTokens)
+        {
+            auto iter = m_activeTasks.find(token);
+            if (iter != m_activeTasks.end())
+            {
+                iter->second->Resume();
+            }
+        }
+        resumedTokens.clear();
+
+        if (stopping)
+        {
+            break;
+        }
+
+        int runningTransfers = 0;
+        curl_multi_perform(m_multi, &runningTransfers);
+        CompleteFinishedTransfers();
+
+        curl_multi_poll(m_multi, nullptr, 0, IDLE_POLL_TIMEOUT_MS, nullptr);
+    }
+
+    for (auto& entry : m_activeTasks)
+    {
+        curl_multi_remove_handle(m_multi, entry.second->Handle());
+        entry.second->Abort();
+    }
+    m_activeTasks.clear();
+}
+
+void curl_event_loop::CompleteFinishedTransfers() noexcept
+{
+    int messagesLeft = 0;
+    while (CURLMsg* message = curl_multi_info_read(m_multi, &messagesLeft))
+    {
+        if (message->msg != CURLMSG_DONE)
+        {
+            continue;
+        }
+
+        curl_http_task* task = nullptr;
+        curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &task);
+        CURLcode result = message->data.result;
+
+        // The message is only valid until its handle is removed
+        curl_multi_remove_handle(m_multi, message->easy_handle);
+
+        auto iter = m_activeTasks.find(task->Token());
+        if (iter != m_activeTasks.end())
+        {
+            HC_UNIQUE_PTR<curl_http_task> finished{ std::move(iter->second) };
+            m_activeTasks.erase(iter);
+            finished->Complete(result);
+        }
+    }
+}
+
+curl_http_engine::~curl_http_engine()
+{
+    m_eventLoops.clear();
+    if (m_share != nullptr)
+    {
+        curl_share_cleanup(m_share);
+    }
+    if (m_globalInitialized)
+    {
+        curl_global_cleanup();
+    }
+}
+
+HRESULT curl_http_engine::Initialize(_In_ uint32_t eventLoopCount) noexcept
+try
+{
+    RETURN_IF_FAILED(HResultFromCurl(curl_global_init(CURL_GLOBAL_DEFAULT)));
+    m_globalInitialized = true;
+
+    m_share = curl_share_init();
+    RETURN_HR_IF(E_OUTOFMEMORY, m_share == nullptr);
+    RETURN_HR_IF(E_FAIL, curl_share_setopt(m_share, CURLSHOPT_LOCKFUNC, LockShare) != CURLSHE_OK);
+    RETURN_HR_IF(E_FAIL, curl_share_setopt(m_share, CURLSHOPT_UNLOCKFUNC, UnlockShare) != CURLSHE_OK);
+    RETURN_HR_IF(E_FAIL, curl_share_setopt(m_share, CURLSHOPT_USERDATA, this) != CURLSHE_OK);
+    if (curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION) != CURLSHE_OK)
+    {
+        // curl built without TLS, calls simply don't share sessions
+        curl_share_cleanup(m_share);
+        m_share = nullptr;
+    }
+
+#if HC_TLS_SESSION_CACHE
+    // curl's handshakes are only counted when its contexts can be configured with the OpenSSL linked here
+    curl_version_info_data const* version = curl_version_info(CURLVERSION_NOW);
+    if (version != nullptr && tls_session_cache::IsLinkedOpenSsl(version->ssl_version))
+    {
+        RETURN_IF_FAILED(tls_session_cache::Acquire(&m_tlsSessionCache));
+    }
+#endif
+
+    if (eventLoopCount == 0)
+    {
+        eventLoopCount = std::max(1u, std::thread::hardware_concurrency() / CORES_PER_EVENT_LOOP);
+    }
+
+    for (uint32_t i = 0; i < eventLoopCount; i++)
+    {
+        auto eventLoop = http_allocate_unique<curl_event_loop>();
+        RETURN_IF_FAILED(eventLoop->Initialize());
+        m_eventLoops.push_back(std::move(eventLoop));
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+HRESULT curl_http_engine::SetProxy(_In_opt_z_ const char* proxyUri) noexcept
+try
+{
+    std::lock_guard<std::mutex> lock{ m_lock };
+    m_proxy = proxyUri != nullptr ? proxyUri : "";
+    return S_OK;
+}
+CATCH_RETURN()
+
+void curl_http_engine::LockShare(CURL* /*curl*/, curl_lock_data data, curl_lock_access /*access*/, void* context) noexcept
+{
+    static_cast<curl_http_engine*>(context)->m_shareLocks[data].lock();
+}
+
+void curl_http_engine::UnlockShare(CURL* /*curl*/, curl_lock_data data, void* context) noexcept
+{
+    static_cast<curl_http_engine*>(context)->m_shareLocks[data].unlock();
+}
+
+curl_event_loop* curl_http_engine::SelectEventLoop(_In_z_ const char* url) const noexcept
+{
+    if (m_eventLoops.size() == 1)
+    {
+        return m_eventLoops[0].get();
+    }
+
+    // Hash the scheme & authority so calls to the same origin land on the loop holding its connections
+    const char* origin = std::strstr(url, "://");
+    origin = origin != nullptr ? origin + 3 : url;
+    size_t originLength = std::strcspn(origin, "/?#");
+
+    uint32_t hash = 2166136261u;
+    for (const char* c = url; c < origin + originLength; ++c)
+    {
+        hash = (hash ^ static_cast<uint8_t>(std::tolower(static_cast<unsigned char>(*c)))) * 16777619u;
+    }
+    return m_eventLoops[hash % m_eventLoops.size()].get();
+}
+
+void curl_http_engine::Perform(_In_ HCCallHandle call, _Inout_ XAsyncBlock* asyncBlock) noexcept
+{
+    const char* method = nullptr;
+    const char* url = nullptr;
+    HRESULT hr = HCHttpCallRequestGetUrl(call, &method, &url);
+    if (FAILED(hr) || url == nullptr || m_eventLoops.empty())
+    {
+        HCHttpCallResponseSetNetworkErrorCode(call, E_FAIL, static_cast<uint32_t>(FAILED(hr) ? hr : E_FAIL));
+        XAsyncComplete(asyncBlock, S_OK, 0);
+        return;
+    }
+
+    try
+    {
+        curl_event_loop* eventLoop = SelectEventLoop(url);
+        auto task = http_allocate_unique<curl_http_task>(call, asyncBlock, eventLoop, eventLoop->NextToken());
+
+        http_internal_string proxy;
+        {
+            std::lock_guard<std::mutex> lock{ m_lock };
+            proxy = m_proxy;
+        }
+
+        hr = task->Initialize(proxy.empty() ? nullptr : proxy.c_str(), m_share, m_tlsSessionCache.get());
+        if (FAILED(hr))
+        {
+            if (call->traceCall) { HC_TRACE_ERROR(HTTPCLIENT, "curl_http_task [ID %llu] failed to set up the transfer: %08X", TO_ULL(call->id), hr); }
+            task.reset();
+            HCHttpCallResponseSetNetworkErrorCode(call, E_FAIL, static_cast<uint32_t>(hr));
+            XAsyncComplete(asyncBlock, S_OK, 0);
+            return;
+        }
+
+        if (!http_call_set_cancel_handler(call, curl_http_task::CancelHandler, task.get()))
+        {
+            task->Abort();
+            return;
+        }
+        http_call_set_resume_handler(call, curl_http_task::ResumeHandler, task.get());
+
+        curl_http_task* pendingTask = task.get();
+        hr = eventLoop->Perform(std::move(task));
+        if (FAILED(hr))
+        {
+            // The loop didn't take ownership, so the task is still alive here
+            HCHttpCallResponseSetNetworkErrorCode(call, E_FAIL, static_cast<uint32_t>(hr));
+            pendingTask->Complete(CURLE_OK);
+        }
+    }
+    catch (...)
+    {
+        HCHttpCallResponseSetNetworkErrorCode(call, E_OUTOFMEMORY, static_cast<uint32_t>(E_OUTOFMEMORY));
+        XAsyncComplete(asyncBlock, S_OK, 0);
+    }
+}
+
+HRESULT curl_http_engine::Preconnect(_In_z_ const char* url, _Inout_ XAsyncBlock* asyncBlock) noexcept
+try
+{
+    RETURN_HR_IF(E_INVALIDARG, url == nullptr || asyncBlock == nullptr);
+    RETURN_HR_IF(E_FAIL, m_eventLoops.empty());
+
+    // On the loop calls to the same origin use, which caches the host name
+    curl_event_loop* eventLoop = SelectEventLoop(url);
+    auto task = http_allocate_unique<curl_http_task>(nullptr, asyncBlock, eventLoop, eventLoop->NextToken());
+
+    http_internal_string proxy;
+    {
+        std::lock_guard<std::mutex> lock{ m_lock };
+        proxy = m_proxy;
+    }
+
+    RETURN_IF_FAILED(task->InitializePreconnect(url, proxy.empty() ? nullptr : proxy.c_str(), m_share, m_tlsSessionCache.get()));
+    return eventLoop->Perform(std::move(task));
+}
+CATCH_RETURN()
+
+void CALLBACK curl_http_engine::PerformAsync(
+    _In_ HCCallHandle call,
+    _Inout_ XAsyncBlock* asyncBlock,
+    _In_opt_ void* context,
+    _In_ HCPerformEnv /*env*/
+) noexcept
+{
+    assert(context != nullptr);
+    static_cast<curl_http_engine*>(context)->Perform(call, asyncBlock);
+}
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
+
+#if HC_CURL_HTTP && !HC_UNITTEST_API
+using namespace xbox::httpclient;
+
+HRESULT Internal_InitializeHttpPlatform(HCInitArgs* args, PerformEnv& performEnv) noexcept
+{
+    UNREFERENCED_PARAMETER(args);
+
+    // Mem hooked unique ptr with non-standard dtor handler in PerformEnvDeleter
+    http_stl_allocator<HC_PERFORM_ENV> alloc;
+    auto p = std::allocator_traits<http_stl_allocator<HC_PERFORM_ENV>>::allocate(alloc, 1);
+    if (p == nullptr)
+    {
+        return E_OUTOFMEMORY;
+    }
+    performEnv.reset(new(p) HC_PERFORM_ENV());
+
+    return performEnv->engine.Initialize(0);
+}
+
+void Internal_CleanupHttpPlatform(HC_PERFORM_ENV* performEnv) noexcept
+{
+    http_stl_allocator<HC_PERFORM_ENV> alloc;
+    std::allocator_traits<http_stl_allocator<HC_PERFORM_ENV>>::destroy(alloc, std::addressof(*performEnv));
+    std::allocator_traits<http_stl_allocator<HC_PERFORM_ENV>>::deallocate(alloc, performEnv, 1);
+}
+
+HRESULT Internal_SetGlobalProxy(
+    _In_ HC_PERFORM_ENV* performEnv,
+    _In_ const char* proxyUri
+) noexcept
+{
+    assert(performEnv != nullptr);
+    return performEnv->engine.SetProxy(proxyUri);
+}
+
+void CALLBACK Internal_HCHttpCallPerformAsync(
+    _In_ HCCallHandle call,
+    _Inout_ XAsyncBlock* asyncBlock,
+    _In_opt_ void* /*context*/,
+    _In_ HCPerformEnv env
+) noexcept
+{
+    assert(env != nullptr);
+    env->engine.Perform(call, asyncBlock);
+}
+
+HRESULT Internal_HttpPreconnect(
+    _In_ HC_PERFORM_ENV* performEnv,
+    _In_z_ const char* url,
+    _In_ uint32_t /*connectionCount*/,
+    _Inout_ XAsyncBlock* asyncBlock
+) noexcept
+{
+    assert(performEnv != nullptr);
+    return performEnv->engine.Preconnect(url, asyncBlock);
+}
+#endif
@@ -0,0 +1,174 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+#include "pch.h"
+#include <curl/curl.h>
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+class curl_event_loop;
+class tls_session_cache;
+
+// One attempt of an HTTP call, performed on a curl easy handle. The request body is streamed through the call's
+// read function and the response through its write function, so neither is buffered here. A task without a call
+// preconnects, making the connection and TLS handshake only.
+class curl_http_task
+{
+public:
+    curl_http_task(_In_opt_ HCCallHandle call, _Inout_ XAsyncBlock* asyncBlock, _In_ curl_event_loop* eventLoop, _In_ uint64_t token) noexcept;
+    curl_http_task(const curl_http_task&) = delete;
+    curl_http_task& operator=(const curl_http_task&) = delete;
+    ~curl_http_task();
+
+    // Transfers with the same share resume each other's TLS sessions. A TLS session cache, when given, counts the
+    // handshakes.
+    HRESULT Initialize(_In_opt_z_ const char* proxy, _In_opt_ CURLSH* share, _In_opt_ tls_session_cache* tlsSessionCache) noexcept;
+
+    // For a task without a call. curl doesn't pool the connection afterwards, but the host name stays resolved in the
+    // event loop and later transfers with the same share resume the TLS session.
+    HRESULT InitializePreconnect(_In_z_ const char* url, _In_opt_z_ const char* proxy, _In_opt_ CURLSH* share, _In_opt_ tls_session_cache* tlsSessionCache) noexcept;
+
+    CURL* Handle() const noexcept { return m_curl; }
+    uint64_t Token() const noexcept { return m_token; }
+    bool IsCanceled() const noexcept { return m_canceled; }
+
+    // Completes the attempt with the transfer's result, or with E_ABORT if it was canceled
+    void Complete(_In_ CURLcode result) noexcept;
+    void Abort() noexcept;
+
+    // Continues a transfer paused by the call's body callbacks. Only called on the loop thread.
+    void Resume() noexcept;
+
+    static void CancelHandler(_In_ HCCallHandle call, _In_opt_ void* context);
+    static void ResumeHandler(_In_ HCCallHandle call, _In_opt_ void* context);
+
+private:
+    static size_t ReadCallback(char* buffer, size_t size, size_t count, void* context) noexcept;
+    static int SeekCallback(void* context, curl_off_t offset, int origin) noexcept;
+    static size_t WriteCallback(char* buffer, size_t size, size_t count, void* context) noexcept;
+    static size_t HeaderCallback(char* buffer, size_t size, size_t count, void* context) noexcept;
+    static CURLcode SslContextCallback(CURL* curl, void* sslContext, void* context) noexcept;
+
+    template<typename T>
+    HRESULT SetOption(CURLoption option, T value) noexcept;
+
+    HRESULT SetConnectionOptions(_In_z_ const char* url, _In_opt_z_ const char* proxy, _In_opt_ CURLSH* share, _In_opt_ tls_session_cache* tlsSessionCache) noexcept;
+    HRESULT SetRequestHeaders() noexcept;
+    void Finish(_In_ HRESULT result) noexcept;
+
+    HCCallHandle m_call;
+    XAsyncBlock* m_asyncBlock;
+    curl_event_loop* m_eventLoop;
+    uint64_t m_token;
+    std::atomic<bool> m_canceled{ false };
+
+    CURL* m_curl{ nullptr };
+    curl_slist* m_requestHeaders{ nullptr };
+    HCHttpCallRequestBodyReadFunction m_readFunction{ nullptr };
+    void* m_readContext{ nullptr };
+    size_t m_requestBodySize{ 0 };
+    size_t m_requestBodyOffset{ 0 };
+    HCHttpCallResponseBodyWriteFunction m_writeFunction{ nullptr };
+    void* m_writeContext{ nullptr };
+    bool m_writePaused{ false }; // the write function took its last bytes but wants no more until resumed
+    HRESULT m_callbackResult{ S_OK };
+    char m_errorBuffer[CURL_ERROR_SIZE]{};
+};
+
+// Drives any number of transfers from one thread with curl's multi interface. Connections, and HTTP/2 sessions
+// where the server supports them, are shared by every transfer on the loop.
+class curl_event_loop
+{
+public:
+    curl_event_loop() = default;
+    curl_event_loop(const curl_event_loop&) = delete;
+    curl_event_loop& operator=(const curl_event_loop&) = delete;
+
+    // Completes every transfer still in flight with E_ABORT
+    ~curl_event_loop();
+
+    HRESULT Initialize() noexcept;
+
+    // Takes ownership of the task, which is completed on the loop thread
+    HRESULT Perform(HC_UNIQUE_PTR<curl_http_task> task) noexcept;
+    void Cancel(_In_ uint64_t token) noexcept;
+    void Resume(_In_ uint64_t token) noexcept;
+
+    uint64_t NextToken() noexcept { return ++m_lastToken; }
+
+private:
+    void Run() noexcept;
+    void CompleteFinishedTransfers() noexcept;
+
+    CURLM* m_multi{ nullptr };
+    std::thread m_thread;
+    std::atomic<uint64_t> m_lastToken{ 0 };
+
+    std::mutex m_lock;
+    bool m_stopping{ false };
+    http_internal_vector<HC_UNIQUE_PTR<curl_http_task>> m_addedTasks;
+    http_internal_vector<uint64_t> m_canceledTokens;
+    http_internal_vector<uint64_t> m_resumedTokens;
+
+    // Only used on the loop thread
+    http_internal_unordered_map<uint64_t, HC_UNIQUE_PTR<curl_http_task>> m_activeTasks;
+};
+
+// HTTP provider built on libcurl. Calls are spread across event loops by origin, so calls to the same server
+// share a loop and its connections.
+class curl_http_engine
+{
+public:
+    curl_http_engine() = default;
+    curl_http_engine(const curl_http_engine&) = delete;
+    curl_http_engine& operator=(const curl_http_engine&) = delete;
+    ~curl_http_engine();
+
+    // An eventLoopCount of 0 starts one event loop per CORES_PER_EVENT_LOOP hardware threads
+    HRESULT Initialize(_In_ uint32_t eventLoopCount) noexcept;
+
+    HRESULT SetProxy(_In_opt_z_ const char* proxyUri) noexcept;
+
+    void Perform(_In_ HCCallHandle call, _Inout_ XAsyncBlock* asyncBlock) noexcept;
+
+    // Completes the begun asyncBlock once a connection to the URL's host has finished its TLS handshake, unless it
+    // returns a failure. One connection warms the host's DNS entry and TLS session however many are asked for.
+    HRESULT Preconnect(_In_z_ const char* url, _Inout_ XAsyncBlock* asyncBlock) noexcept;
+
+    // Perform function for HCSetHttpCallPerformFunction, with the engine as its context
+    static void CALLBACK PerformAsync(
+        _In_ HCCallHandle call,
+        _Inout_ XAsyncBlock* asyncBlock,
+        _In_opt_ void* context,
+        _In_ HCPerformEnv env
+    ) noexcept;
+
+    static constexpr uint32_t CORES_PER_EVENT_LOOP = 8;
+
+private:
+    curl_event_loop* SelectEventLoop(_In_z_ const char* url) const noexcept;
+    static void LockShare(CURL* curl, curl_lock_data data, curl_lock_access access, void* context) noexcept;
+    static void UnlockShare(CURL* curl, curl_lock_data data, void* context) noexcept;
+
+    bool m_globalInitialized{ false };
+
+    // Every transfer shares TLS sessions through this, whichever loop it runs on
+    CURLSH* m_share{ nullptr };
+    std::mutex m_shareLocks[CURL_LOCK_DATA_LAST];
+    // Only set when curl runs on the OpenSSL this library is linked with
+    std::shared_ptr<tls_session_cache> m_tlsSessionCache;
+
+    http_internal_vector<HC_UNIQUE_PTR<curl_event_loop>> m_eventLoops;
+
+    std::mutex m_lock;
+    http_internal_string m_proxy;
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
+
+#if HC_CURL_HTTP && !HC_UNITTEST_API
+struct HC_PERFORM_ENV
+{
+    xbox::httpclient::curl_http_engine engine;
+};
+#endif
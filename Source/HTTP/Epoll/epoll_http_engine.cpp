@@ -0,0 +1,1745 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#include "pch.h"
+#include <utility>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "epoll_http_engine.h"
+#include "../httpcall.h"
+#include "uri.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+namespace
+{
+
+constexpr size_t MAX_EVENTS = 256;
+constexpr size_t MIN_DEADLINES_BEFORE_PRUNE = 1024;
+constexpr size_t RECEIVE_BUFFER_SIZE = 16 * 1024;
+constexpr size_t BODY_BUFFER_SIZE = 16 * 1024;
+
+// Room for a chunk size line in front of the body buffer, and its CRLF behind it
+constexpr size_t CHUNK_PREFIX_SIZE = 18;
+constexpr size_t CHUNK_SUFFIX_SIZE = 2;
+
+// Connection races won by one address family before both tallies are halved, so a family that stops working for a
+// host loses its lead after a few connections
+constexpr uint32_t MAX_FAMILY_WINS = 8;
+
+}
+
+// A socket racing to connect to one of the host's addresses
+struct epoll_connect_attempt
+{
+    int fd;
+    int family;
+};
+
+// A socket to one host, carrying one request at a time
+struct epoll_connection : public http_response_parser_callbacks
+{
+    explicit epoll_connection(epoll_host& owner) noexcept : host{ owner } {}
+
+    HRESULT OnResponseHeader(_In_reads_(nameSize) const char* name, _In_ size_t nameSize, _In_reads_(valueSize) const char* value, _In_ size_t valueSize) noexcept override
+    {
+        return HCHttpCallResponseSetHeaderWithLength(request->call, name, nameSize, value, valueSize);
+    }
+
+    HRESULT OnResponseBody(_In_reads_bytes_(size) const uint8_t* data, _In_ size_t size) noexcept override
+    {
+        try
+        {
+            HRESULT hr = request->writeFunction(request->call, data, size, request->writeContext);
+            if (SUCCEEDED(hr) && http_call_take_write_pause(request->call))
+            {
+                // Stops the parser after these bytes
+                return E_PENDING;
+            }
+            return hr;
+        }
+        catch (...)
+        {
+            return E_FAIL;
+        }
+    }
+
+    epoll_host& host;
+    int fd{ -1 }; // the socket that won the connection race
+    bool connected{ false };
+    bool closed{ false };
+    bool reused{ false };
+    bool preconnected{ false }; // opened by a preconnect and hasn't carried a request yet
+    uint64_t preconnectToken{ 0 }; // the preconnect waiting for this connection to connect
+    std::chrono::steady_clock::time_point idleSince;
+
+    // Until connected: the host's addresses in the order they are tried, the attempts in flight, which all report
+    // their events to this connection, and when the next address joins the race
+    http_internal_vector<dns_address> connectAddresses;
+    size_t nextConnectAddress{ 0 };
+    http_internal_vector<epoll_connect_attempt> connectAttempts;
+    std::chrono::steady_clock::time_point nextConnectAttempt;
+    int lastConnectError{ 0 };
+
+    epoll_http_request* request{ nullptr };
+    http_response_parser parser;
+
+    // Request being written: the unsent tail of the head, then the body a buffer at a time
+    bool writing{ false };
+    size_t headOffset{ 0 };
+    size_t bodyOffset{ 0 };
+    bool bodyExhausted{ false };
+    bool sendPaused{ false }; // the read function has no more body until the call resumes
+    size_t pendingBegin{ 0 };
+    size_t pendingEnd{ 0 };
+    uint8_t bodyBuffer[CHUNK_PREFIX_SIZE + BODY_BUFFER_SIZE + CHUNK_SUFFIX_SIZE];
+
+    // Response bytes the parser hasn't consumed yet. The socket isn't read while the write function has paused the
+    // call, so the server is held back by the receive window.
+    http_body_bytes receiveBuffer;
+    size_t receiveSize{ 0 };
+    bool receivePaused{ false };
+};
+
+// The connection pool and queue of requests waiting for a connection for one host:port
+struct epoll_host
+{
+    uint32_t connectionCount{ 0 };
+    uint32_t connectingCount{ 0 };
+
+    // Connection races won by each address family, deciding which one the next race leads with
+    uint32_t ipv6Wins{ 0 };
+    uint32_t ipv4Wins{ 0 };
+    http_internal_vector<HC_UNIQUE_PTR<epoll_connection>> connections;
+
+    // Most recently used at the back, so the back is reused first and the front expires first
+    http_internal_dequeue<epoll_connection*> idleConnections;
+    http_internal_dequeue<uint64_t> waitingRequests;
+};
+
+epoll_http_request::~epoll_http_request()
+{
+    if (call != nullptr)
+    {
+        HCHttpCallCloseHandle(call);
+    }
+}
+
+epoll_http_engine::epoll_http_engine() noexcept = default;
+
+epoll_http_engine::~epoll_http_engine()
+{
+    if (m_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock{ m_lock };
+            m_stopping = true;
+        }
+        Wake();
+        m_thread.join();
+    }
+
+    // Only the reactor thread starts resolutions, so none can be added after this
+    if (m_resolver != nullptr)
+    {
+        m_resolver->CancelCallbacks(this);
+    }
+
+    if (m_wakeEvent != -1)
+    {
+        close(m_wakeEvent);
+    }
+    if (m_epoll != -1)
+    {
+        close(m_epoll);
+    }
+}
+
+HRESULT epoll_http_engine::Initialize(_In_ epoll_http_engine_settings const& settings) noexcept
+try
+{
+    RETURN_HR_IF(E_INVALIDARG, settings.maxConnectionsPerHost == 0);
+    m_settings = settings;
+
+    m_resolver = settings.resolver;
+    if (m_resolver == nullptr)
+    {
+        m_ownedResolver = http_allocate_unique<dns_resolver>();
+        RETURN_IF_FAILED(m_ownedResolver->Initialize(dns_resolver_settings{}));
+        m_resolver = m_ownedResolver.get();
+    }
+
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    RETURN_HR_IF(E_FAIL, m_epoll == -1);
+    m_wakeEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    RETURN_HR_IF(E_FAIL, m_wakeEvent == -1);
+
+    // The wake event is the only registration without a connection
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    RETURN_HR_IF(E_FAIL, epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeEvent, &event) == -1);
+
+    m_thread = std::thread([this] { Run(); });
+    return S_OK;
+}
+CATCH_RETURN()
+
+void epoll_http_engine::Perform(_In_ HCCallHandle call, _Inout_ XAsyncBlock* asyncBlock) noexcept
+{
+    request_ptr request;
+    try
+    {
+        request = http_allocate_unique<epoll_http_request>();
+    }
+    catch (...)
+    {
+        HCHttpCallResponseSetNetworkErrorCode(call, E_OUTOFMEMORY, static_cast<uint32_t>(E_OUTOFMEMORY));
+        XAsyncComplete(asyncBlock, S_OK, 0);
+        return;
+    }
+
+    request->call = HCHttpCallDuplicateHandle(call);
+    request->asyncBlock = asyncBlock;
+    request->engine = this;
+    request->token = ++m_lastToken;
+
+    HRESULT hr = PrepareRequest(*request);
+    if (FAILED(hr))
+    {
+        if (call->traceCall) { HC_TRACE_ERROR(HTTPCLIENT, "epoll_http_engine [ID %llu] can't perform %s: %08X", TO_ULL(call->id), call->url.c_str(), hr); }
+        HCHttpCallResponseSetNetworkErrorCode(call, hr, 0);
+        Complete(std::move(request), S_OK);
+        return;
+    }
+
+    if (!http_call_set_cancel_handler(call, CancelHandler, request.get()))
+    {
+        Complete(std::move(request), E_ABORT);
+        return;
+    }
+    http_call_set_resume_handler(call, ResumeHandler, request.get());
+
+    try
+    {
+        std::lock_guard<std::mutex> lock{ m_lock };
+        if (!m_stopping)
+        {
+            m_addedRequests.push_back(std::move(request));
+        }
+    }
+    catch (...)
+    {
+        hr = E_OUTOFMEMORY;
+    }
+
+    if (request != nullptr)
+    {
+        // Either the engine is shutting down or the request couldn't be queued
+        CompleteWithNetworkError(std::move(request), FAILED(hr) ? hr : E_ABORT, 0);
+        return;
+    }
+    Wake();
+}
+
+void CALLBACK epoll_http_engine::PerformAsync(
+    _In_ HCCallHandle call,
+    _Inout_ XAsyncBlock* asyncBlock,
+    _In_opt_ void* context,
+    _In_ HCPerformEnv /*env*/
+) noexcept
+{
+    assert(context != nullptr);
+    static_cast<epoll_http_engine*>(context)->Perform(call, asyncBlock);
+}
+
+HRESULT epoll_http_engine::Preconnect(_In_z_ const char* url, _In_ uint32_t connectionCount, _Inout_ XAsyncBlock* asyncBlock) noexcept
+try
+{
+    RETURN_HR_IF(E_INVALIDARG, url == nullptr || connectionCount == 0 || asyncBlock == nullptr);
+
+    Uri uri{ url };
+    RETURN_HR_IF(E_INVALIDARG, !uri.IsValid() || uri.IsEmpty());
+    RETURN_HR_IF(E_NOTIMPL, uri.Scheme() != "http");
+
+    auto preconnect = http_allocate_unique<epoll_preconnect>();
+    preconnect->asyncBlock = asyncBlock;
+    preconnect->token = ++m_lastToken;
+    preconnect->hostName = uri.Host().str();
+    preconnect->port = uri.IsPortDefault() ? 80 : uri.Port();
+    preconnect->hostKey = preconnect->hostName;
+    preconnect->hostKey += ":";
+    preconnect->hostKey += std::to_string(preconnect->port).c_str();
+    preconnect->connectionCount = connectionCount;
+
+    {
+        std::lock_guard<std::mutex> lock{ m_lock };
+        RETURN_HR_IF(E_ABORT, m_stopping);
+        m_addedPreconnects.push_back(std::move(preconnect));
+    }
+    Wake();
+    return S_OK;
+}
+CATCH_RETURN()
+
+HCHttpConnectionStats epoll_http_engine::GetConnectionStats() const noexcept
+{
+    HCHttpConnectionStats stats{};
+    stats.openConnections = m_openConnections;
+    stats.idleConnections = m_idleConnections;
+    stats.preconnectedConnections = m_preconnectedConnections;
+    stats.preconnectedConnectionsUsed = m_preconnectedConnectionsUsed;
+    stats.preconnectedConnectionsExpired = m_preconnectedConnectionsExpired;
+    return stats;
+}
+
+HRESULT epoll_http_engine::PrepareRequest(_Inout_ epoll_http_request& request) noexcept
+try
+{
+    const char* method = nullptr;
+    const char* url = nullptr;
+    uint32_t timeoutInSeconds = 0;
+    HCCallHandle call = request.call;
+    RETURN_IF_FAILED(HCHttpCallRequestGetUrl(call, &method, &url));
+    RETURN_IF_FAILED(HCHttpCallRequestGetTimeout(call, &timeoutInSeconds));
+    RETURN_IF_FAILED(HCHttpCallRequestGetRequestBodyReadFunction(call, &request.readFunction, &request.bodySize, &request.readContext));
+    RETURN_IF_FAILED(HCHttpCallResponseGetResponseBodyWriteFunction(call, &request.writeFunction, &request.writeContext));
+
+    Uri const& uri = http_call_get_parsed_url(call);
+    RETURN_HR_IF(E_INVALIDARG, !uri.IsValid() || uri.IsEmpty());
+    RETURN_HR_IF(E_NOTIMPL, uri.Scheme() != "http");
+
+    uint16_t port = uri.IsPortDefault() ? 80 : uri.Port();
+    char portString[8];
+    snprintf(portString, sizeof(portString), "%u", port);
+
+    request.hostName = uri.Host().str();
+    request.port = port;
+    request.hostKey = request.hostName;
+    request.hostKey += ":";
+    request.hostKey += portString;
+
+    if (timeoutInSeconds > 0)
+    {
+        request.deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeoutInSeconds);
+    }
+    request.headRequest = str_icmp(method, "HEAD") == 0;
+    if (request.readFunction == nullptr)
+    {
+        request.bodySize = 0;
+    }
+
+    // Request line
+    http_internal_string& head = request.head;
+    head.reserve(256);
+    head += method;
+    head += " ";
+    head.append(uri.Path().data(), uri.Path().size());
+    if (!uri.Query().empty())
+    {
+        head += "?";
+        head.append(uri.Query().data(), uri.Query().size());
+    }
+    head += " HTTP/1.1\r\n";
+
+    // Headers. Framing headers describe the body as it is sent, so they're always generated here.
+    bool hostSet = false;
+    for (auto const& header : call->requestHeaders.get())
+    {
+        if (str_icmp(header.first.c_str(), "Content-Length") == 0 || str_icmp(header.first.c_str(), "Transfer-Encoding") == 0)
+        {
+            continue;
+        }
+        hostSet |= str_icmp(header.first.c_str(), "Host") == 0;
+        head.append(header.first.data(), header.first.size());
+        head += ": ";
+        head.append(header.second.data(), header.second.size());
+        head += "\r\n";
+    }
+
+    if (!hostSet)
+    {
+        head += "Host: ";
+        head.append(uri.Host().data(), uri.Host().size());
+        if (!uri.IsPortDefault())
+        {
+            head += ":";
+            head += portString;
+        }
+        head += "\r\n";
+    }
+
+    if (request.bodySize == HC_UNKNOWN_REQUEST_BODY_SIZE)
+    {
+        head += "Transfer-Encoding: chunked\r\n";
+    }
+    else if (request.bodySize > 0 || (str_icmp(method, "GET") != 0 && !request.headRequest))
+    {
+        char contentLength[48];
+        snprintf(contentLength, sizeof(contentLength), "Content-Length: %zu\r\n", request.bodySize);
+        head += contentLength;
+    }
+    head += "\r\n";
+
+    return S_OK;
+}
+CATCH_RETURN()
+
+void epoll_http_engine::CancelHandler(_In_ HCCallHandle /*call*/, _In_opt_ void* context)
+{
+    auto request = static_cast<epoll_http_request*>(context);
+    epoll_http_engine* engine = request->engine;
+    try
+    {
+        std::lock_guard<std::mutex> lock{ engine->m_lock };
+        engine->m_canceledTokens.push_back(request->token);
+    }
+    catch (...)
+    {
+        // The request runs to completion or its timeout instead
+        return;
+    }
+    engine->Wake();
+}
+
+void epoll_http_engine::ResumeHandler(_In_ HCCallHandle /*call*/, _In_opt_ void* context)
+{
+    auto request = static_cast<epoll_http_request*>(context);
+    epoll_http_engine* engine = request->engine;
+    try
+    {
+        std::lock_guard<std::mutex> lock{ engine->m_lock };
+        engine->m_resumedTokens.push_back(request->token);
+    }
+    catch (...)
+    {
+        // The request stays paused until its timeout
+        return;
+    }
+    engine->Wake();
+}
+
+void epoll_http_engine::ResolveCallback(_In_opt_ void* context, _In_ uint64_t token, _In_ dns_result_ptr const& result)
+{
+    auto engine = static_cast<epoll_http_engine*>(context);
+    try
+    {
+        std::lock_guard<std::mutex> lock{ engine->m_lock };
+        engine->m_resolvedRequests.emplace_back(token, result);
+    }
+    catch (...)
+    {
+        // The request times out instead
+        return;
+    }
+    engine->Wake();
+}
+
+void epoll_http_engine::Complete(request_ptr request, _In_ HRESULT result) noexcept
+{
+    // A cancel or resume handler running on another thread holds the call's cancel lock, so it is finished with the
+    // request once this returns
+    http_call_clear_cancel_handler(request->call);
+    http_call_clear_resume_handler(request->call);
+
+    XAsyncBlock* asyncBlock = request->asyncBlock;
+    request.reset();
+    XAsyncComplete(asyncBlock, result, 0);
+}
+
+void epoll_http_engine::CompleteWithNetworkError(request_ptr request, _In_ HRESULT hr, _In_ int platformError) noexcept
+{
+    HCHttpCallResponseSetNetworkErrorCode(request->call, hr, static_cast<uint32_t>(platformError));
+    if (platformError != 0)
+    {
+        HCHttpCallResponseSetPlatformNetworkErrorMessage(request->call, strerror(platformError));
+    }
+    Complete(std::move(request), S_OK);
+}
+
+void epoll_http_engine::Wake() noexcept
+{
+    uint64_t value = 1;
+    (void)write(m_wakeEvent, &value, sizeof(value));
+}
+
+void epoll_http_engine::Run() noexcept
+{
+    http_internal_vector<request_ptr> addedRequests;
+    http_internal_vector<preconnect_ptr> addedPreconnects;
+    http_internal_vector<uint64_t> canceledTokens;
+    http_internal_vector<uint64_t> resumedTokens;
+    http_internal_vector<std::pair<uint64_t, dns_result_ptr>> resolvedRequests;
+    epoll_event events[MAX_EVENTS];
+
+    while (true)
+    {
+        bool stopping = false;
+        {
+            std::lock_guard<std::mutex> lock{ m_lock };
+            addedRequests.swap(m_addedRequests);
+            addedPreconnects.swap(m_addedPreconnects);
+            canceledTokens.swap(m_canceledTokens);
+            resumedTokens.swap(m_resumedTokens);
+            resolvedRequests.swap(m_resolvedRequests);
+            stopping = m_stopping;
+        }
+
+        if (stopping)
+        {
+            for (auto& request : addedRequests)
+            {
+                Complete(std::move(request), E_ABORT);
+            }
+            for (auto& preconnect : addedPreconnects)
+            {
+                XAsyncComplete(preconnect->asyncBlock, E_ABORT, 0);
+            }
+            break;
+        }
+
+        for (auto& request : addedRequests)
+        {
+            StartRequest(std::move(request));
+        }
+        addedRequests.clear();
+
+        for (auto& preconnect : addedPreconnects)
+        {
+            StartPreconnect(std::move(preconnect));
+        }
+        addedPreconnects.clear();
+
+        // Requests canceled or timed out while their host was being resolved are already gone
+        for (auto& resolved : resolvedRequests)
+        {
+            auto iter = m_requests.find(resolved.first);
+            if (iter != m_requests.end())
+            {
+                ConnectRequest(*iter->second, resolved.second);
+                continue;
+            }
+
+            auto preconnect = m_preconnects.find(resolved.first);
+            if (preconnect != m_preconnects.end())
+            {
+                ConnectPreconnect(*preconnect->second, resolved.second);
+            }
+        }
+        resolvedRequests.clear();
+
+        for (uint64_t token : canceledTokens)
+        {
+            CancelRequest(token, E_ABORT, 0);
+        }
+        canceledTokens.clear();
+
+        for (uint64_t token : resumedTokens)
+        {
+            ResumeRequest(token);
+        }
+        resumedTokens.clear();
+
+        auto now = std::chrono::steady_clock::now();
+        ExpireTimers(now);
+        m_closedConnections.clear();
+
+        int eventCount = epoll_wait(m_epoll, events, static_cast<int>(MAX_EVENTS), NextTimeout(now));
+        for (int i = 0; i < eventCount; i++)
+        {
+            if (events[i].data.ptr == nullptr)
+            {
+                uint64_t value = 0;
+                (void)read(m_wakeEvent, &value, sizeof(value));
+                continue;
+            }
+
+            auto connection = static_cast<epoll_connection*>(events[i].data.ptr);
+            if (!connection->closed)
+            {
+                OnConnectionEvent(*connection, events[i].events);
+            }
+        }
+
+        // Closed connections are kept until the whole batch of events is handled, since later events may refer to them
+        m_closedConnections.clear();
+    }
+
+    for (auto& host : m_hosts)
+    {
+        for (auto& connection : host.second->connections)
+        {
+            connection->request = nullptr;
+            CloseSockets(*connection);
+        }
+    }
+    m_hosts.clear();
+
+    for (auto& entry : m_requests)
+    {
+        entry.second->connection = nullptr;
+        Complete(std::move(entry.second), E_ABORT);
+    }
+    m_requests.clear();
+
+    for (auto& entry : m_preconnects)
+    {
+        XAsyncComplete(entry.second->asyncBlock, E_ABORT, 0);
+    }
+    m_preconnects.clear();
+}
+
+void epoll_http_engine::StartRequest(request_ptr request) noexcept
+{
+    epoll_http_request* pending = request.get();
+    dns_result_ptr result;
+    HRESULT hr = S_OK;
+    try
+    {
+        m_requests.emplace(request->token, std::move(request));
+        if (pending->deadline != time_point::max())
+        {
+            m_deadlines.emplace(pending->deadline, pending->token);
+            if (m_deadlines.size() > 2 * m_requests.size() + MIN_DEADLINES_BEFORE_PRUNE)
+            {
+                PruneDeadlines();
+            }
+        }
+
+        // A host that isn't cached is resolved on the resolver's threads, and the request connects once the result
+        // comes back to ResolveCallback
+        hr = m_resolver->Resolve(pending->hostName, ResolveCallback, this, pending->token, &result);
+    }
+    catch (...)
+    {
+        hr = E_OUTOFMEMORY;
+    }
+
+    if (hr == S_OK)
+    {
+        ConnectRequest(*pending, result);
+    }
+    else if (hr != E_PENDING)
+    {
+        request_ptr owned = request != nullptr ? std::move(request) : TakeRequest(pending->token);
+        if (owned != nullptr)
+        {
+            CompleteWithNetworkError(std::move(owned), hr, 0);
+        }
+    }
+}
+
+void epoll_http_engine::ConnectRequest(_In_ epoll_http_request& request, _In_ dns_result_ptr const& result) noexcept
+{
+    if (result == nullptr || FAILED(result->hr) || result->addresses.empty())
+    {
+        request_ptr owned = TakeRequest(request.token);
+        if (result == nullptr)
+        {
+            CompleteWithNetworkError(std::move(owned), E_OUTOFMEMORY, 0);
+            return;
+        }
+
+        if (owned->call->traceCall) { HC_TRACE_ERROR(HTTPCLIENT, "epoll_http_engine [ID %llu] failed to resolve %s: %d", TO_ULL(owned->call->id), owned->hostName.c_str(), result->platformError); }
+        HCHttpCallResponseSetNetworkErrorCode(owned->call, FAILED(result->hr) ? result->hr : E_FAIL, static_cast<uint32_t>(result->platformError));
+        HCHttpCallResponseSetPlatformNetworkErrorMessage(owned->call, gai_strerror(result->platformError));
+        Complete(std::move(owned), S_OK);
+        return;
+    }
+    request.resolved = result;
+
+    epoll_host* host = FindHost(request.hostKey);
+    if (host == nullptr)
+    {
+        CompleteWithNetworkError(TakeRequest(request.token), E_OUTOFMEMORY, 0);
+        return;
+    }
+    AssignConnection(*host, request, true);
+}
+
+void epoll_http_engine::StartPreconnect(preconnect_ptr preconnect) noexcept
+{
+    epoll_preconnect* pending = preconnect.get();
+    dns_result_ptr result;
+    HRESULT hr = S_OK;
+    try
+    {
+        m_preconnects.emplace(preconnect->token, std::move(preconnect));
+        hr = m_resolver->Resolve(pending->hostName, ResolveCallback, this, pending->token, &result);
+    }
+    catch (...)
+    {
+        hr = E_OUTOFMEMORY;
+    }
+
+    if (hr == S_OK)
+    {
+        ConnectPreconnect(*pending, result);
+    }
+    else if (hr != E_PENDING)
+    {
+        if (preconnect != nullptr)
+        {
+            XAsyncComplete(preconnect->asyncBlock, hr, 0);
+            return;
+        }
+        pending->result = hr;
+        FinishPreconnect(pending->token);
+    }
+}
+
+void epoll_http_engine::ConnectPreconnect(_In_ epoll_preconnect& preconnect, _In_ dns_result_ptr const& result) noexcept
+{
+    epoll_host* host = nullptr;
+    if (result == nullptr || FAILED(result->hr) || result->addresses.empty())
+    {
+        preconnect.result = result == nullptr ? E_OUTOFMEMORY : (FAILED(result->hr) ? result->hr : E_FAIL);
+    }
+    else
+    {
+        host = FindHost(preconnect.hostKey);
+        if (host == nullptr)
+        {
+            preconnect.result = E_OUTOFMEMORY;
+        }
+    }
+
+    // Connections the host already has, busy or not, count towards the ones asked for
+    uint32_t connectionCount = std::min(preconnect.connectionCount, m_settings.maxConnectionsPerHost);
+    while (host != nullptr && host->connectionCount < connectionCount)
+    {
+        epoll_connection* connection = nullptr;
+        int platformError = 0;
+        HRESULT hr = OpenConnection(*host, result, preconnect.port, &connection, &platformError);
+        if (FAILED(hr))
+        {
+            HC_TRACE_ERROR(HTTPCLIENT, "epoll_http_engine failed to preconnect to %s: %d", preconnect.hostKey.c_str(), platformError);
+            preconnect.result = hr;
+            break;
+        }
+
+        connection->preconnected = true;
+        ++m_preconnectedConnections;
+        if (connection->connected)
+        {
+            OnConnected(*connection);
+        }
+        else
+        {
+            connection->preconnectToken = preconnect.token;
+            ++preconnect.pendingConnections;
+        }
+    }
+
+    if (preconnect.pendingConnections == 0)
+    {
+        FinishPreconnect(preconnect.token);
+    }
+}
+
+void epoll_http_engine::ReportPreconnect(_In_ uint64_t token, _In_ HRESULT result) noexcept
+{
+    auto iter = m_preconnects.find(token);
+    if (iter == m_preconnects.end())
+    {
+        return;
+    }
+
+    epoll_preconnect& preconnect = *iter->second;
+    if (FAILED(result) && SUCCEEDED(preconnect.result))
+    {
+        preconnect.result = result;
+    }
+    if (--preconnect.pendingConnections == 0)
+    {
+        FinishPreconnect(token);
+    }
+}
+
+void epoll_http_engine::FinishPreconnect(_In_ uint64_t token) noexcept
+{
+    auto iter = m_preconnects.find(token);
+    if (iter != m_preconnects.end())
+    {
+        preconnect_ptr finished{ std::move(iter->second) };
+        m_preconnects.erase(iter);
+        XAsyncComplete(finished->asyncBlock, finished->result, 0);
+    }
+}
+
+epoll_host* epoll_http_engine::FindHost(_In_ http_internal_string const& hostKey) noexcept
+try
+{
+    auto& entry = m_hosts[hostKey];
+    if (entry == nullptr)
+    {
+        entry = http_allocate_unique<epoll_host>();
+    }
+    return entry.get();
+}
+catch (...)
+{
+    return nullptr;
+}
+
+void epoll_http_engine::AssignConnection(_In_ epoll_host& host, _In_ epoll_http_request& request, _In_ bool reuseIdle) noexcept
+{
+    if (reuseIdle && !host.idleConnections.empty())
+    {
+        epoll_connection* connection = host.idleConnections.back();
+        host.idleConnections.pop_back();
+        --m_idleConnections;
+        connection->reused = true;
+        BeginRequest(*connection, request);
+        return;
+    }
+
+    // A connection a preconnect is still opening gets there sooner than a new one
+    for (auto const& connection : host.connections)
+    {
+        if (!connection->connected && connection->request == nullptr)
+        {
+            BeginRequest(*connection, request);
+            return;
+        }
+    }
+
+    if (host.connectionCount >= m_settings.maxConnectionsPerHost)
+    {
+        if (!host.idleConnections.empty())
+        {
+            // Only reached when retrying after a stale connection, which makes room by closing the oldest idle one
+            CloseConnection(*host.idleConnections.front());
+        }
+        else
+        {
+            try
+            {
+                host.waitingRequests.push_back(request.token);
+            }
+            catch (...)
+            {
+                CompleteWithNetworkError(TakeRequest(request.token), E_OUTOFMEMORY, 0);
+            }
+            return;
+        }
+    }
+
+    epoll_connection* connection = nullptr;
+    int platformError = 0;
+    HRESULT hr = OpenConnection(host, request.resolved, request.port, &connection, &platformError);
+    if (FAILED(hr))
+    {
+        if (request.call->traceCall) { HC_TRACE_ERROR(HTTPCLIENT, "epoll_http_engine [ID %llu] failed to connect to %s: %d", TO_ULL(request.call->id), request.hostKey.c_str(), platformError); }
+        CompleteWithNetworkError(TakeRequest(request.token), hr, platformError);
+        return;
+    }
+    BeginRequest(*connection, request);
+}
+
+HRESULT epoll_http_engine::OpenConnection(_In_ epoll_host& host, _In_ dns_result_ptr const& resolved, _In_ uint16_t port, _Out_ epoll_connection** connection, _Out_ int* platformError) noexcept
+try
+{
+    *connection = nullptr;
+    *platformError = 0;
+
+    auto newConnection = http_allocate_unique<epoll_connection>(host);
+    newConnection->receiveBuffer.resize(RECEIVE_BUFFER_SIZE);
+
+    // Addresses are tried alternating between the families (RFC 8305 section 4), leading with the family that has been
+    // winning races to this host or, until one has, with the resolver's first choice
+    auto const& addresses = resolved->addresses;
+    int leadingFamily = addresses.front().address.ss_family;
+    if (host.ipv6Wins != host.ipv4Wins)
+    {
+        leadingFamily = host.ipv6Wins > host.ipv4Wins ? AF_INET6 : AF_INET;
+    }
+
+    auto& ordered = newConnection->connectAddresses;
+    ordered.reserve(addresses.size());
+    size_t leadingIndex = 0;
+    size_t trailingIndex = 0;
+    bool takeLeading = true;
+    while (ordered.size() < addresses.size())
+    {
+        size_t& index = takeLeading ? leadingIndex : trailingIndex;
+        while (index < addresses.size() && (addresses[index].address.ss_family == leadingFamily) != takeLeading)
+        {
+            ++index;
+        }
+        if (index < addresses.size())
+        {
+            ordered.push_back(dns_resolver::WithPort(addresses[index++], port));
+        }
+        takeLeading = !takeLeading;
+    }
+
+    // Reserved up front so nothing can fail once sockets are open
+    newConnection->connectAttempts.reserve(ordered.size());
+    host.connections.reserve(host.connections.size() + 1);
+
+    ++host.connectingCount;
+    HRESULT hr = StartConnectAttempt(*newConnection, platformError);
+    if (FAILED(hr))
+    {
+        --host.connectingCount;
+        return hr;
+    }
+
+    *connection = newConnection.get();
+    host.connections.push_back(std::move(newConnection));
+    ++host.connectionCount;
+    ++m_openConnections;
+    return S_OK;
+}
+CATCH_RETURN()
+
+HRESULT epoll_http_engine::StartConnectAttempt(_In_ epoll_connection& connection, _Out_ int* platformError) noexcept
+{
+    *platformError = 0;
+
+    // Addresses that fail straight away are skipped without waiting out the attempt delay
+    while (connection.nextConnectAddress < connection.connectAddresses.size())
+    {
+        dns_address& address = connection.connectAddresses[connection.nextConnectAddress++];
+        int fd = socket(address.address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd == -1)
+        {
+            connection.lastConnectError = errno;
+            continue;
+        }
+
+        int noDelay = 1;
+        (void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        int result = connect(fd, reinterpret_cast<sockaddr*>(&address.address), address.size);
+        if (result == -1 && errno != EINPROGRESS)
+        {
+            connection.lastConnectError = errno;
+            close(fd);
+            continue;
+        }
+
+        // Registered once for the life of the socket. Being edge triggered, every readiness change is reported once
+        // and each handler works until the socket would block.
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.ptr = &connection;
+        if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) == -1)
+        {
+            connection.lastConnectError = errno;
+            close(fd);
+            continue;
+        }
+
+        connection.connectAttempts.push_back(epoll_connect_attempt{ fd, address.address.ss_family });
+        if (result == 0)
+        {
+            WinConnectRace(connection, connection.connectAttempts.size() - 1);
+        }
+        else
+        {
+            connection.nextConnectAttempt = std::chrono::steady_clock::now() + m_settings.connectionAttemptDelay;
+        }
+        return S_OK;
+    }
+
+    if (connection.connectAttempts.empty())
+    {
+        *platformError = connection.lastConnectError;
+        return E_FAIL;
+    }
+    return S_OK;
+}
+
+bool epoll_http_engine::CheckConnectAttempts(_In_ epoll_connection& connection) noexcept
+{
+    // Every attempt reports to the connection, so each is polled to find the ones that finished
+    auto& attempts = connection.connectAttempts;
+    for (size_t i = 0; i < attempts.size();)
+    {
+        pollfd attemptPoll{ attempts[i].fd, POLLOUT, 0 };
+        if (poll(&attemptPoll, 1, 0) <= 0 || (attemptPoll.revents & (POLLOUT | POLLERR | POLLHUP)) == 0)
+        {
+            ++i;
+            continue;
+        }
+
+        int platformError = 0;
+        socklen_t size = sizeof(platformError);
+        if (getsockopt(attempts[i].fd, SOL_SOCKET, SO_ERROR, &platformError, &size) == -1)
+        {
+            platformError = errno;
+        }
+        if (platformError == 0)
+        {
+            WinConnectRace(connection, i);
+            return true;
+        }
+
+        connection.lastConnectError = platformError;
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, attempts[i].fd, nullptr);
+        close(attempts[i].fd);
+        attempts.erase(attempts.begin() + static_cast<ptrdiff_t>(i));
+    }
+
+    if (attempts.empty())
+    {
+        // With nothing left in flight the next address is tried right away rather than after the delay
+        int platformError = 0;
+        HRESULT hr = StartConnectAttempt(connection, &platformError);
+        if (FAILED(hr))
+        {
+            FailConnection(connection, hr, platformError);
+            return false;
+        }
+    }
+    return connection.connected;
+}
+
+void epoll_http_engine::WinConnectRace(_In_ epoll_connection& connection, _In_ size_t attempt) noexcept
+{
+    epoll_connect_attempt winner = connection.connectAttempts[attempt];
+    for (size_t i = 0; i < connection.connectAttempts.size(); i++)
+    {
+        if (i != attempt)
+        {
+            epoll_ctl(m_epoll, EPOLL_CTL_DEL, connection.connectAttempts[i].fd, nullptr);
+            close(connection.connectAttempts[i].fd);
+        }
+    }
+    connection.connectAttempts.clear();
+    http_internal_vector<dns_address>{}.swap(connection.connectAddresses);
+    connection.fd = winner.fd;
+    connection.connected = true;
+
+    epoll_host& host = connection.host;
+    --host.connectingCount;
+    uint32_t& wins = winner.family == AF_INET6 ? host.ipv6Wins : host.ipv4Wins;
+    if (++wins >= MAX_FAMILY_WINS)
+    {
+        host.ipv6Wins /= 2;
+        host.ipv4Wins /= 2;
+    }
+}
+
+void epoll_http_engine::ContinueConnecting(_In_ epoll_connection& connection) noexcept
+{
+    int platformError = 0;
+    HRESULT hr = StartConnectAttempt(connection, &platformError);
+    if (FAILED(hr))
+    {
+        FailConnection(connection, hr, platformError);
+    }
+    else if (connection.connected)
+    {
+        OnConnected(connection);
+        if (connection.request != nullptr)
+        {
+            hr = WriteRequest(connection, &platformError);
+            if (FAILED(hr))
+            {
+                FailConnection(connection, hr, platformError);
+            }
+        }
+    }
+}
+
+void epoll_http_engine::OnConnected(_In_ epoll_connection& connection) noexcept
+{
+    // Reported once the connection is pooled, so the preconnect's caller finds it there
+    uint64_t preconnectToken = std::exchange(connection.preconnectToken, 0);
+    if (connection.request == nullptr)
+    {
+        // Opened by a preconnect and not claimed by a request yet, so it joins the pool
+        ReleaseConnection(connection, true);
+    }
+
+    if (preconnectToken != 0)
+    {
+        ReportPreconnect(preconnectToken, S_OK);
+    }
+}
+
+void epoll_http_engine::CloseSockets(_In_ epoll_connection& connection) noexcept
+{
+    if (connection.fd != -1)
+    {
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, connection.fd, nullptr);
+        close(connection.fd);
+        connection.fd = -1;
+    }
+    for (auto const& attempt : connection.connectAttempts)
+    {
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, attempt.fd, nullptr);
+        close(attempt.fd);
+    }
+    connection.connectAttempts.clear();
+}
+
+void epoll_http_engine::BeginRequest(_In_ epoll_connection& connection, _In_ epoll_http_request& request) noexcept
+{
+    connection.request = &request;
+    request.connection = &connection;
+    if (connection.preconnected)
+    {
+        connection.preconnected = false;
+        ++m_preconnectedConnectionsUsed;
+    }
+
+    connection.parser.Reset(request.headRequest);
+    connection.writing = true;
+    connection.headOffset = 0;
+    connection.bodyOffset = 0;
+    connection.bodyExhausted = request.bodySize == 0;
+    connection.sendPaused = false;
+    connection.pendingBegin = 0;
+    connection.pendingEnd = 0;
+    connection.receiveSize = 0;
+    connection.receivePaused = false;
+
+    if (connection.connected)
+    {
+        int platformError = 0;
+        HRESULT hr = WriteRequest(connection, &platformError);
+        if (FAILED(hr))
+        {
+            FailConnection(connection, hr, platformError);
+        }
+    }
+}
+
+void epoll_http_engine::OnConnectionEvent(_In_ epoll_connection& connection, _In_ uint32_t events) noexcept
+{
+    int platformError = 0;
+    if (!connection.connected)
+    {
+        if ((events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) == 0 || !CheckConnectAttempts(connection))
+        {
+            return;
+        }
+
+        OnConnected(connection);
+
+        // The winning socket may not be the one that raised this event
+        events |= EPOLLOUT;
+    }
+
+    if (connection.writing && !connection.sendPaused && connection.request != nullptr && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) != 0)
+    {
+        HRESULT hr = WriteRequest(connection, &platformError);
+        if (FAILED(hr))
+        {
+            FailConnection(connection, hr, platformError);
+            return;
+        }
+    }
+
+    if (!connection.receivePaused && (events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) != 0)
+    {
+        HRESULT hr = ReadResponse(connection, &platformError);
+        if (FAILED(hr))
+        {
+            FailConnection(connection, hr, platformError);
+        }
+    }
+}
+
+HRESULT epoll_http_engine::WriteRequest(_In_ epoll_connection& connection, _Out_ int* platformError) noexcept
+{
+    *platformError = 0;
+    epoll_http_request& request = *connection.request;
+    bool chunked = request.bodySize == HC_UNKNOWN_REQUEST_BODY_SIZE;
+
+    while (connection.writing)
+    {
+        // Refill the body buffer once it has been sent, framing each read as a chunk when the size is unknown
+        if (connection.pendingBegin == connection.pendingEnd && !connection.bodyExhausted)
+        {
+            size_t bytesToRead = chunked ? BODY_BUFFER_SIZE : std::min(BODY_BUFFER_SIZE, request.bodySize - connection.bodyOffset);
+            size_t bytesRead = 0;
+            HRESULT hr = S_OK;
+            try
+            {
+                hr = request.readFunction(request.call, connection.bodyOffset, bytesToRead, request.readContext, connection.bodyBuffer + CHUNK_PREFIX_SIZE, &bytesRead);
+            }
+            catch (...)
+            {
+                hr = E_FAIL;
+            }
+            if (hr == E_PENDING)
+            {
+                // Read again from the same offset once the call resumes
+                connection.sendPaused = true;
+                break;
+            }
+            RETURN_IF_FAILED(hr);
+            RETURN_HR_IF(E_FAIL, bytesRead > bytesToRead || (!chunked && bytesRead == 0));
+            connection.bodyOffset += bytesRead;
+
+            if (!chunked)
+            {
+                connection.pendingBegin = CHUNK_PREFIX_SIZE;
+                connection.pendingEnd = CHUNK_PREFIX_SIZE + bytesRead;
+                connection.bodyExhausted = connection.bodyOffset == request.bodySize;
+            }
+            else if (bytesRead > 0)
+            {
+                char prefix[CHUNK_PREFIX_SIZE + 1];
+                int prefixSize = snprintf(prefix, sizeof(prefix), "%zx\r\n", bytesRead);
+                connection.pendingBegin = CHUNK_PREFIX_SIZE - static_cast<size_t>(prefixSize);
+                std::memcpy(connection.bodyBuffer + connection.pendingBegin, prefix, static_cast<size_t>(prefixSize));
+                std::memcpy(connection.bodyBuffer + CHUNK_PREFIX_SIZE + bytesRead, "\r\n", CHUNK_SUFFIX_SIZE);
+                connection.pendingEnd = CHUNK_PREFIX_SIZE + bytesRead + CHUNK_SUFFIX_SIZE;
+            }
+            else
+            {
+                static const char lastChunk[] = "0\r\n\r\n";
+                std::memcpy(connection.bodyBuffer, lastChunk, sizeof(lastChunk) - 1);
+                connection.pendingBegin = 0;
+                connection.pendingEnd = sizeof(lastChunk) - 1;
+                connection.bodyExhausted = true;
+            }
+        }
+
+        iovec buffers[2];
+        int bufferCount = 0;
+        if (connection.headOffset < request.head.size())
+        {
+            buffers[bufferCount].iov_base = const_cast<char*>(request.head.data() + connection.headOffset);
+            buffers[bufferCount].iov_len = request.head.size() - connection.headOffset;
+            ++bufferCount;
+        }
+        if (connection.pendingBegin < connection.pendingEnd)
+        {
+            buffers[bufferCount].iov_base = connection.bodyBuffer + connection.pendingBegin;
+            buffers[bufferCount].iov_len = connection.pendingEnd - connection.pendingBegin;
+            ++bufferCount;
+        }
+
+        if (bufferCount == 0)
+        {
+            connection.writing = false;
+            break;
+        }
+
+        ssize_t written = writev(connection.fd, buffers, bufferCount);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            *platformError = errno;
+            return E_FAIL;
+        }
+
+        size_t remaining = static_cast<size_t>(written);
+        size_t headWritten = std::min(remaining, request.head.size() - connection.headOffset);
+        connection.headOffset += headWritten;
+        connection.pendingBegin += remaining - headWritten;
+    }
+
+    return S_OK;
+}
+
+HRESULT epoll_http_engine::ReadResponse(_In_ epoll_connection& connection, _Out_ int* platformError) noexcept
+try
+{
+    *platformError = 0;
+    while (!connection.closed && !connection.receivePaused)
+    {
+        auto& buffer = connection.receiveBuffer;
+        if (connection.receiveSize == buffer.size())
+        {
+            // Only a header line longer than the buffer gets here, and the parser bounds those
+            buffer.resize(buffer.size() * 2);
+        }
+
+        ssize_t received = recv(connection.fd, buffer.data() + connection.receiveSize, buffer.size() - connection.receiveSize, 0);
+        if (received < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return S_OK;
+            }
+            *platformError = errno;
+            return E_FAIL;
+        }
+
+        if (received == 0)
+        {
+            // The server closed the connection. That's only the end of the response if it isn't delimited.
+            if (connection.request == nullptr)
+            {
+                epoll_host& host = connection.host;
+                CloseConnection(connection);
+                ServeWaitingRequests(host);
+                return S_OK;
+            }
+            if (SUCCEEDED(connection.parser.OnEndOfStream()) && connection.receiveSize == 0)
+            {
+                FinishResponse(connection);
+                return S_OK;
+            }
+            *platformError = ECONNRESET;
+            return E_FAIL;
+        }
+
+        // Nothing is expected on an idle connection
+        RETURN_HR_IF(E_FAIL, connection.request == nullptr);
+
+        connection.receiveSize += static_cast<size_t>(received);
+        RETURN_IF_FAILED(ParseResponse(connection));
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+HRESULT epoll_http_engine::ParseResponse(_In_ epoll_connection& connection) noexcept
+{
+    auto& buffer = connection.receiveBuffer;
+    size_t consumed = 0;
+    HRESULT hr = connection.parser.Parse(buffer.data(), connection.receiveSize, connection, &consumed);
+    if (FAILED(hr) && hr != E_PENDING)
+    {
+        return hr;
+    }
+
+    connection.receiveSize -= consumed;
+    if (connection.receiveSize > 0 && consumed > 0)
+    {
+        std::memmove(buffer.data(), buffer.data() + consumed, connection.receiveSize);
+    }
+
+    if (connection.parser.IsComplete())
+    {
+        FinishResponse(connection);
+    }
+    else if (hr == E_PENDING)
+    {
+        // The rest of what was received is parsed once the call resumes
+        connection.receivePaused = true;
+    }
+    return S_OK;
+}
+
+void epoll_http_engine::FinishResponse(_In_ epoll_connection& connection) noexcept
+{
+    epoll_http_request& request = *connection.request;
+    HCHttpCallResponseSetStatusCode(request.call, connection.parser.StatusCode());
+
+    // Bytes past the end of the response, or a response that arrived before its request was fully sent, leave the
+    // connection in a state it can't be reused from
+    bool reusable = connection.parser.KeepAlive() && connection.receiveSize == 0 && !connection.writing;
+
+    connection.request = nullptr;
+    request.connection = nullptr;
+    request_ptr finished = TakeRequest(request.token);
+
+    ReleaseConnection(connection, reusable);
+    if (finished != nullptr)
+    {
+        Complete(std::move(finished), S_OK);
+    }
+}
+
+void epoll_http_engine::FailConnection(_In_ epoll_connection& connection, _In_ HRESULT hr, _In_ int platformError) noexcept
+{
+    epoll_http_request* request = connection.request;
+    bool staleConnection = connection.reused && !connection.parser.HasStarted();
+    epoll_host& host = connection.host;
+    // Reported once the connection no longer counts as open
+    uint64_t preconnectToken = std::exchange(connection.preconnectToken, 0);
+    CloseConnection(connection);
+    if (preconnectToken != 0)
+    {
+        ReportPreconnect(preconnectToken, hr);
+    }
+
+    if (request != nullptr)
+    {
+        if (staleConnection && !request->retried)
+        {
+            // The server closed a kept-alive connection before it saw the request. Nothing has reached the call yet,
+            // so the request is sent again on a new connection.
+            request->retried = true;
+            AssignConnection(host, *request, false);
+        }
+        else
+        {
+            if (request->call->traceCall) { HC_TRACE_ERROR(HTTPCLIENT, "epoll_http_engine [ID %llu] connection to %s failed: %08X, %d", TO_ULL(request->call->id), request->hostKey.c_str(), hr, platformError); }
+            CompleteWithNetworkError(TakeRequest(request->token), hr, platformError);
+        }
+    }
+
+    ServeWaitingRequests(host);
+}
+
+void epoll_http_engine::ReleaseConnection(_In_ epoll_connection& connection, _In_ bool reusable) noexcept
+{
+    epoll_host& host = connection.host;
+    if (!reusable)
+    {
+        CloseConnection(connection);
+        ServeWaitingRequests(host);
+        return;
+    }
+
+    connection.reused = true;
+    while (!host.waitingRequests.empty())
+    {
+        uint64_t token = host.waitingRequests.front();
+        host.waitingRequests.pop_front();
+
+        auto iter = m_requests.find(token);
+        if (iter != m_requests.end())
+        {
+            BeginRequest(connection, *iter->second);
+            return;
+        }
+    }
+
+    try
+    {
+        connection.idleSince = std::chrono::steady_clock::now();
+        host.idleConnections.push_back(&connection);
+        ++m_idleConnections;
+    }
+    catch (...)
+    {
+        CloseConnection(connection);
+    }
+}
+
+void epoll_http_engine::CloseConnection(_In_ epoll_connection& connection) noexcept
+{
+    if (connection.closed)
+    {
+        return;
+    }
+
+    connection.closed = true;
+    CloseSockets(connection);
+    if (connection.request != nullptr)
+    {
+        connection.request->connection = nullptr;
+        connection.request = nullptr;
+    }
+
+    epoll_host& host = connection.host;
+    --host.connectionCount;
+    --m_openConnections;
+    if (!connection.connected)
+    {
+        --host.connectingCount;
+    }
+    auto idle = std::find(host.idleConnections.begin(), host.idleConnections.end(), &connection);
+    if (idle != host.idleConnections.end())
+    {
+        host.idleConnections.erase(idle);
+        --m_idleConnections;
+    }
+    if (connection.preconnected)
+    {
+        ++m_preconnectedConnectionsExpired;
+    }
+    if (connection.preconnectToken != 0)
+    {
+        ReportPreconnect(std::exchange(connection.preconnectToken, 0), E_ABORT);
+    }
+
+    auto owned = std::find_if(host.connections.begin(), host.connections.end(), [&connection](HC_UNIQUE_PTR<epoll_connection> const& c) { return c.get() == &connection; });
+    if (owned != host.connections.end())
+    {
+        try
+        {
+            m_closedConnections.push_back(std::move(*owned));
+        }
+        catch (...)
+        {
+            // Leaked rather than freed while an event may still refer to it
+            (void)owned->release();
+        }
+        host.connections.erase(owned);
+    }
+}
+
+void epoll_http_engine::ServeWaitingRequests(_In_ epoll_host& host) noexcept
+{
+    while (!host.waitingRequests.empty() && (!host.idleConnections.empty() || host.connectionCount < m_settings.maxConnectionsPerHost))
+    {
+        uint64_t token = host.waitingRequests.front();
+        host.waitingRequests.pop_front();
+
+        auto iter = m_requests.find(token);
+        if (iter != m_requests.end())
+        {
+            AssignConnection(host, *iter->second, true);
+        }
+    }
+}
+
+epoll_http_engine::request_ptr epoll_http_engine::TakeRequest(_In_ uint64_t token) noexcept
+{
+    request_ptr request;
+    auto iter = m_requests.find(token);
+    if (iter != m_requests.end())
+    {
+        request = std::move(iter->second);
+        m_requests.erase(iter);
+    }
+    return request;
+}
+
+void epoll_http_engine::CancelRequest(_In_ uint64_t token, _In_ HRESULT networkError, _In_ int platformError) noexcept
+{
+    request_ptr request = TakeRequest(token);
+    if (request == nullptr)
+    {
+        return;
+    }
+
+    // A request waiting for a connection leaves its token in the host's queue, where it is skipped
+    if (request->connection != nullptr)
+    {
+        epoll_host& host = request->connection->host;
+        CloseConnection(*request->connection);
+        ServeWaitingRequests(host);
+    }
+
+    if (networkError == E_ABORT)
+    {
+        Complete(std::move(request), E_ABORT);
+    }
+    else
+    {
+        CompleteWithNetworkError(std::move(request), networkError, platformError);
+    }
+}
+
+void epoll_http_engine::ResumeRequest(_In_ uint64_t token) noexcept
+{
+    // Requests that completed since, and those still waiting for a connection, have nothing paused
+    auto iter = m_requests.find(token);
+    if (iter == m_requests.end() || iter->second->connection == nullptr)
+    {
+        return;
+    }
+
+    // Edge triggered events that came in while paused were ignored, so both directions carry on until the socket
+    // would block
+    epoll_connection& connection = *iter->second->connection;
+    int platformError = 0;
+    HRESULT hr = S_OK;
+    if (connection.sendPaused)
+    {
+        connection.sendPaused = false;
+        hr = WriteRequest(connection, &platformError);
+    }
+    if (SUCCEEDED(hr) && connection.receivePaused)
+    {
+        connection.receivePaused = false;
+        hr = ParseResponse(connection);
+        if (SUCCEEDED(hr))
+        {
+            hr = ReadResponse(connection, &platformError);
+        }
+    }
+
+    if (FAILED(hr))
+    {
+        FailConnection(connection, hr, platformError);
+    }
+}
+
+void epoll_http_engine::ExpireTimers(_In_ time_point now) noexcept
+{
+    while (!m_deadlines.empty() && m_deadlines.top().first <= now)
+    {
+        uint64_t token = m_deadlines.top().second;
+        m_deadlines.pop();
+        CancelRequest(token, E_FAIL, ETIMEDOUT);
+    }
+
+    for (auto& host : m_hosts)
+    {
+        auto& idleConnections = host.second->idleConnections;
+        while (!idleConnections.empty() && idleConnections.front()->idleSince + m_settings.idleTimeout <= now)
+        {
+            CloseConnection(*idleConnections.front());
+        }
+
+        // Connections still racing bring in their next address once the attempts in flight have had their delay
+        auto& connections = host.second->connections;
+        for (size_t i = 0; host.second->connectingCount > 0 && i < connections.size();)
+        {
+            epoll_connection* connection = connections[i].get();
+            if (!connection->connected && connection->nextConnectAddress < connection->connectAddresses.size() && connection->nextConnectAttempt <= now)
+            {
+                ContinueConnecting(*connection);
+            }
+
+            // A connection that failed is no longer in the list
+            if (i < connections.size() && connections[i].get() == connection)
+            {
+                ++i;
+            }
+        }
+    }
+}
+
+void epoll_http_engine::PruneDeadlines()
+{
+    // Deadlines of finished requests stay queued until they pass, so they're dropped in bulk once they outnumber
+    // the live ones
+    http_internal_vector<std::pair<time_point, uint64_t>> deadlines;
+    deadlines.reserve(m_requests.size());
+    for (auto const& entry : m_requests)
+    {
+        if (entry.second->deadline != time_point::max())
+        {
+            deadlines.emplace_back(entry.second->deadline, entry.first);
+        }
+    }
+    m_deadlines = deadline_queue{ deadline_queue::value_compare{}, std::move(deadlines) };
+}
+
+int epoll_http_engine::NextTimeout(_In_ time_point now) const noexcept
+{
+    time_point next = time_point::max();
+    if (!m_deadlines.empty())
+    {
+        next = m_deadlines.top().first;
+    }
+    for (auto const& host : m_hosts)
+    {
+        auto const& idleConnections = host.second->idleConnections;
+        if (!idleConnections.empty())
+        {
+            next = std::min(next, idleConnections.front()->idleSince + m_settings.idleTimeout);
+        }
+
+        if (host.second->connectingCount > 0)
+        {
+            for (auto const& connection : host.second->connections)
+            {
+                if (!connection->connected && connection->nextConnectAddress < connection->connectAddresses.size())
+                {
+                    next = std::min(next, connection->nextConnectAttempt);
+                }
+            }
+        }
+    }
+
+    if (next == time_point::max())
+    {
+        return -1;
+    }
+    if (next <= now)
+    {
+        return 0;
+    }
+
+    // Round up so the timer has passed when the wait ends
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(next - now) + std::chrono::milliseconds(1);
+    return static_cast<int>(std::min<int64_t>(remaining.count(), INT32_MAX));
+}
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
+
+#if HC_EPOLL_HTTP && !HC_UNITTEST_API
+using namespace xbox::httpclient;
+
+HRESULT Internal_InitializeHttpPlatform(HCInitArgs* args, PerformEnv& performEnv) noexcept
+{
+    UNREFERENCED_PARAMETER(args);
+
+    // Mem hooked unique ptr with non-standard dtor handler in PerformEnvDeleter
+    http_stl_allocator<HC_PERFORM_ENV> alloc;
+    auto p = std::allocator_traits<http_stl_allocator<HC_PERFORM_ENV>>::allocate(alloc, 1);
+    if (p == nullptr)
+    {
+        return E_OUTOFMEMORY;
+    }
+    performEnv.reset(new(p) HC_PERFORM_ENV());
+
+    RETURN_IF_FAILED(performEnv->resolver.Initialize(dns_resolver_settings{}));
+
+    epoll_http_engine_settings settings;
+    settings.resolver = &performEnv->resolver;
+    return performEnv->engine.Initialize(settings);
+}
+
+void Internal_CleanupHttpPlatform(HC_PERFORM_ENV* performEnv) noexcept
+{
+    http_stl_allocator<HC_PERFORM_ENV> alloc;
+    std::allocator_traits<http_stl_allocator<HC_PERFORM_ENV>>::destroy(alloc, std::addressof(*performEnv));
+    std::allocator_traits<http_stl_allocator<HC_PERFORM_ENV>>::deallocate(alloc, performEnv, 1);
+}
+
+void CALLBACK Internal_HCHttpCallPerformAsync(
+    _In_ HCCallHandle call,
+    _Inout_ XAsyncBlock* asyncBlock,
+    _In_opt_ void* /*context*/,
+    _In_ HCPerformEnv env
+) noexcept
+{
+    assert(env != nullptr);
+    env->engine.Perform(call, asyncBlock);
+}
+
+HRESULT Internal_PrewarmDnsCache(
+    _In_ HC_PERFORM_ENV* performEnv,
+    _In_reads_(hostNameCount) const char* const* hostNames,
+    _In_ uint32_t hostNameCount
+) noexcept
+{
+    assert(performEnv != nullptr);
+    return performEnv->resolver.Prewarm(hostNames, hostNameCount);
+}
+
+HRESULT Internal_GetDnsCacheStats(
+    _In_ HC_PERFORM_ENV* performEnv,
+    _Out_ HCDnsCacheStats* stats
+) noexcept
+{
+    assert(performEnv != nullptr);
+    *stats = performEnv->resolver.GetStats();
+    return S_OK;
+}
+
+HRESULT Internal_HttpPreconnect(
+    _In_ HC_PERFORM_ENV* performEnv,
+    _In_z_ const char* url,
+    _In_ uint32_t connectionCount,
+    _Inout_ XAsyncBlock* asyncBlock
+) noexcept
+{
+    assert(performEnv != nullptr);
+    return performEnv->engine.Preconnect(url, connectionCount, asyncBlock);
+}
+
+HRESULT Internal_GetHttpConnectionStats(
+    _In_ HC_PERFORM_ENV* performEnv,
+    _Out_ HCHttpConnectionStats* stats
+) noexcept
+{
+    assert(performEnv != nullptr);
+    *stats = performEnv->engine.GetConnectionStats();
+    return S_OK;
+}
+#endif
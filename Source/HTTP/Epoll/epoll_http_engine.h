@@ -0,0 +1,205 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+#include "pch.h"
+#include <queue>
+#include <sys/socket.h>
+#include "http_response_parser.h"
+#include "Linux/dns_resolver.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+class epoll_http_engine;
+struct epoll_connection;
+struct epoll_host;
+
+// One attempt of an HTTP call. Owned by the engine's reactor thread from the moment it is queued.
+struct epoll_http_request
+{
+    epoll_http_request() = default;
+    epoll_http_request(const epoll_http_request&) = delete;
+    epoll_http_request& operator=(const epoll_http_request&) = delete;
+    ~epoll_http_request();
+
+    HCCallHandle call{ nullptr };
+    XAsyncBlock* asyncBlock{ nullptr };
+    epoll_http_engine* engine{ nullptr };
+    uint64_t token{ 0 };
+
+    http_internal_string hostName;
+    uint16_t port{ 0 };
+    http_internal_string hostKey;
+    dns_result_ptr resolved;
+    bool headRequest{ false };
+
+    // Request line & headers, serialized up front so they go out in the same writev as the first body bytes
+    http_internal_string head;
+
+    HCHttpCallRequestBodyReadFunction readFunction{ nullptr };
+    void* readContext{ nullptr };
+    size_t bodySize{ 0 };
+    HCHttpCallResponseBodyWriteFunction writeFunction{ nullptr };
+    void* writeContext{ nullptr };
+
+    std::chrono::steady_clock::time_point deadline{ std::chrono::steady_clock::time_point::max() };
+    epoll_connection* connection{ nullptr };
+    bool retried{ false };
+};
+
+// A preconnect in progress. Owned by the engine's reactor thread from the moment it is queued.
+struct epoll_preconnect
+{
+    XAsyncBlock* asyncBlock{ nullptr };
+    uint64_t token{ 0 };
+
+    http_internal_string hostName;
+    uint16_t port{ 0 };
+    http_internal_string hostKey;
+
+    uint32_t connectionCount{ 0 };
+    uint32_t pendingConnections{ 0 };
+    HRESULT result{ S_OK };
+};
+
+// Tuning for epoll_http_engine
+struct epoll_http_engine_settings
+{
+    // Connections opened to one host:port. Further requests wait for one to come free.
+    uint32_t maxConnectionsPerHost{ 64 };
+
+    // How long an unused kept-alive connection stays pooled before it is closed
+    std::chrono::milliseconds idleTimeout{ std::chrono::seconds(30) };
+
+    // How long a connection attempt gets before the next address is tried alongside it (RFC 8305's Connection
+    // Attempt Delay). An attempt that fails outright moves on to the next address immediately.
+    std::chrono::milliseconds connectionAttemptDelay{ 250 };
+
+    // Resolver to share with other connections of the process. The engine creates its own when not set.
+    dns_resolver* resolver{ nullptr };
+};
+
+// Dependency free HTTP/1.1 provider for the generic platform. A single reactor thread drives non-blocking sockets
+// with edge triggered epoll and keeps connections alive in per host pools. New connections race their host's IPv6
+// and IPv4 addresses Happy Eyeballs style, leading with the family that has been winning for that host. Connections
+// can be opened ahead of the first request to a host with Preconnect. Only http:// URLs are supported.
+class epoll_http_engine
+{
+public:
+    epoll_http_engine() noexcept;
+    epoll_http_engine(const epoll_http_engine&) = delete;
+    epoll_http_engine& operator=(const epoll_http_engine&) = delete;
+
+    // Completes every request still pending with E_ABORT
+    ~epoll_http_engine();
+
+    HRESULT Initialize(_In_ epoll_http_engine_settings const& settings) noexcept;
+
+    dns_resolver& Resolver() const noexcept { return *m_resolver; }
+
+    void Perform(_In_ HCCallHandle call, _Inout_ XAsyncBlock* asyncBlock) noexcept;
+
+    // Opens connections to the URL's host until it has connectionCount, or as many as maxConnectionsPerHost allows.
+    // They wait in the host's pool like any other idle connection. Completes the begun asyncBlock once they are
+    // connected, with the error of the first that failed if any did. Returns a failure without completing it if
+    // the preconnect couldn't be started.
+    HRESULT Preconnect(_In_z_ const char* url, _In_ uint32_t connectionCount, _Inout_ XAsyncBlock* asyncBlock) noexcept;
+
+    HCHttpConnectionStats GetConnectionStats() const noexcept;
+
+    // Perform function for HCSetHttpCallPerformFunction, with the engine as its context
+    static void CALLBACK PerformAsync(
+        _In_ HCCallHandle call,
+        _Inout_ XAsyncBlock* asyncBlock,
+        _In_opt_ void* context,
+        _In_ HCPerformEnv env
+    ) noexcept;
+
+private:
+    using request_ptr = HC_UNIQUE_PTR<epoll_http_request>;
+    using preconnect_ptr = HC_UNIQUE_PTR<epoll_preconnect>;
+    using time_point = std::chrono::steady_clock::time_point;
+    using deadline_queue = std::priority_queue<std::pair<time_point, uint64_t>, http_internal_vector<std::pair<time_point, uint64_t>>, std::greater<std::pair<time_point, uint64_t>>>;
+
+    static HRESULT PrepareRequest(_Inout_ epoll_http_request& request) noexcept;
+    static void CancelHandler(_In_ HCCallHandle call, _In_opt_ void* context);
+    static void ResumeHandler(_In_ HCCallHandle call, _In_opt_ void* context);
+    static void ResolveCallback(_In_opt_ void* context, _In_ uint64_t token, _In_ dns_result_ptr const& result);
+    static void Complete(request_ptr request, _In_ HRESULT result) noexcept;
+    static void CompleteWithNetworkError(request_ptr request, _In_ HRESULT hr, _In_ int platformError) noexcept;
+    void Wake() noexcept;
+
+    // Everything below runs on the reactor thread
+    void Run() noexcept;
+    void StartRequest(request_ptr request) noexcept;
+    void ConnectRequest(_In_ epoll_http_request& request, _In_ dns_result_ptr const& result) noexcept;
+    void StartPreconnect(preconnect_ptr preconnect) noexcept;
+    void ConnectPreconnect(_In_ epoll_preconnect& preconnect, _In_ dns_result_ptr const& result) noexcept;
+    void ReportPreconnect(_In_ uint64_t token, _In_ HRESULT result) noexcept;
+    void FinishPreconnect(_In_ uint64_t token) noexcept;
+    epoll_host* FindHost(_In_ http_internal_string const& hostKey) noexcept;
+    void AssignConnection(_In_ epoll_host& host, _In_ epoll_http_request& request, _In_ bool reuseIdle) noexcept;
+    HRESULT OpenConnection(_In_ epoll_host& host, _In_ dns_result_ptr const& resolved, _In_ uint16_t port, _Out_ epoll_connection** connection, _Out_ int* platformError) noexcept;
+    HRESULT StartConnectAttempt(_In_ epoll_connection& connection, _Out_ int* platformError) noexcept;
+    bool CheckConnectAttempts(_In_ epoll_connection& connection) noexcept;
+    void WinConnectRace(_In_ epoll_connection& connection, _In_ size_t attempt) noexcept;
+    void ContinueConnecting(_In_ epoll_connection& connection) noexcept;
+    void OnConnected(_In_ epoll_connection& connection) noexcept;
+    void CloseSockets(_In_ epoll_connection& connection) noexcept;
+    void BeginRequest(_In_ epoll_connection& connection, _In_ epoll_http_request& request) noexcept;
+    void OnConnectionEvent(_In_ epoll_connection& connection, _In_ uint32_t events) noexcept;
+    HRESULT WriteRequest(_In_ epoll_connection& connection, _Out_ int* platformError) noexcept;
+    HRESULT ReadResponse(_In_ epoll_connection& connection, _Out_ int* platformError) noexcept;
+    HRESULT ParseResponse(_In_ epoll_connection& connection) noexcept;
+    void FinishResponse(_In_ epoll_connection& connection) noexcept;
+    void FailConnection(_In_ epoll_connection& connection, _In_ HRESULT hr, _In_ int platformError) noexcept;
+    void ReleaseConnection(_In_ epoll_connection& connection, _In_ bool reusable) noexcept;
+    void CloseConnection(_In_ epoll_connection& connection) noexcept;
+    void ServeWaitingRequests(_In_ epoll_host& host) noexcept;
+    request_ptr TakeRequest(_In_ uint64_t token) noexcept;
+    void CancelRequest(_In_ uint64_t token, _In_ HRESULT networkError, _In_ int platformError) noexcept;
+    void ResumeRequest(_In_ uint64_t token) noexcept;
+    void ExpireTimers(_In_ time_point now) noexcept;
+    void PruneDeadlines();
+    int NextTimeout(_In_ time_point now) const noexcept;
+
+    epoll_http_engine_settings m_settings;
+    HC_UNIQUE_PTR<dns_resolver> m_ownedResolver;
+    dns_resolver* m_resolver{ nullptr };
+    int m_epoll{ -1 };
+    int m_wakeEvent{ -1 };
+    std::thread m_thread;
+    std::atomic<uint64_t> m_lastToken{ 0 };
+
+    std::mutex m_lock;
+    bool m_stopping{ false };
+    http_internal_vector<request_ptr> m_addedRequests;
+    http_internal_vector<preconnect_ptr> m_addedPreconnects;
+    http_internal_vector<uint64_t> m_canceledTokens;
+    http_internal_vector<uint64_t> m_resumedTokens;
+    http_internal_vector<std::pair<uint64_t, dns_result_ptr>> m_resolvedRequests;
+
+    // Only used on the reactor thread
+    http_internal_unordered_map<uint64_t, request_ptr> m_requests;
+    http_internal_unordered_map<uint64_t, preconnect_ptr> m_preconnects;
+    http_internal_map<http_internal_string, HC_UNIQUE_PTR<epoll_host>> m_hosts;
+    http_internal_vector<HC_UNIQUE_PTR<epoll_connection>> m_closedConnections;
+    deadline_queue m_deadlines;
+
+    // Written on the reactor thread, read by GetConnectionStats
+    std::atomic<uint64_t> m_openConnections{ 0 };
+    std::atomic<uint64_t> m_idleConnections{ 0 };
+    std::atomic<uint64_t> m_preconnectedConnections{ 0 };
+    std::atomic<uint64_t> m_preconnectedConnectionsUsed{ 0 };
+    std::atomic<uint64_t> m_preconnectedConnectionsExpired{ 0 };
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
+
+#if HC_EPOLL_HTTP && !HC_UNITTEST_API
+struct HC_PERFORM_ENV
+{
+    // Declared first so it outlives the engine resolving through it
+    xbox::httpclient::dns_resolver resolver;
+    xbox::httpclient::epoll_http_engine engine;
+};
+#endif
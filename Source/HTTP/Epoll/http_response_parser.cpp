@@ -0,0 +1,317 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#include "pch.h"
+#include "http_response_parser.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+namespace
+{
+
+bool IsWhitespace(char c) noexcept
+{
+    return c == ' ' || c == '\t';
+}
+
+char ToLower(char c) noexcept
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool EqualsIgnoreCase(_In_reads_(size) const char* value, _In_ size_t size, _In_z_ const char* expected) noexcept
+{
+    size_t i = 0;
+    for (; i < size && expected[i] != '\0'; i++)
+    {
+        if (ToLower(value[i]) != expected[i])
+        {
+            return false;
+        }
+    }
+    return i == size && expected[i] == '\0';
+}
+
+// Whether a comma separated header value such as "keep-alive, Upgrade" contains the given token
+bool ContainsToken(_In_reads_(size) const char* value, _In_ size_t size, _In_z_ const char* token) noexcept
+{
+    const char* end = value + size;
+    while (value < end)
+    {
+        const char* tokenEnd = static_cast<const char*>(std::memchr(value, ',', static_cast<size_t>(end - value)));
+        tokenEnd = tokenEnd != nullptr ? tokenEnd : end;
+
+        const char* begin = value;
+        const char* last = tokenEnd;
+        while (begin < last && IsWhitespace(*begin)) { ++begin; }
+        while (last > begin && IsWhitespace(*(last - 1))) { --last; }
+        if (EqualsIgnoreCase(begin, static_cast<size_t>(last - begin), token))
+        {
+            return true;
+        }
+        value = tokenEnd + 1;
+    }
+    return false;
+}
+
+}
+
+void http_response_parser::Reset(_In_ bool headRequest) noexcept
+{
+    *this = http_response_parser{};
+    m_headRequest = headRequest;
+}
+
+HRESULT http_response_parser::Parse(
+    _In_reads_bytes_(size) const uint8_t* data,
+    _In_ size_t size,
+    _In_ http_response_parser_callbacks& callbacks,
+    _Out_ size_t* consumed
+) noexcept
+{
+    *consumed = 0;
+    if (size > 0)
+    {
+        m_started = true;
+    }
+
+    const char* begin = reinterpret_cast<const char*>(data);
+    const char* position = begin;
+    const char* end = begin + size;
+
+    while (position < end && m_state != state::complete)
+    {
+        if (m_state == state::body_length || m_state == state::chunk_data || m_state == state::body_until_close)
+        {
+            size_t available = static_cast<size_t>(end - position);
+            size_t bodySize = m_state == state::body_until_close ? available : static_cast<size_t>(std::min<uint64_t>(m_remaining, available));
+            HRESULT hr = callbacks.OnResponseBody(reinterpret_cast<const uint8_t*>(position), bodySize);
+            if (FAILED(hr) && hr != E_PENDING)
+            {
+                return hr;
+            }
+            position += bodySize;
+
+            if (m_state != state::body_until_close)
+            {
+                m_remaining -= bodySize;
+                if (m_remaining == 0)
+                {
+                    m_state = m_state == state::body_length ? state::complete : state::chunk_data_end;
+                }
+            }
+
+            if (hr == E_PENDING)
+            {
+                *consumed = static_cast<size_t>(position - begin);
+                return E_PENDING;
+            }
+            continue;
+        }
+
+        // Everything else is line based
+        const char* lineEnd = static_cast<const char*>(std::memchr(position, '\n', static_cast<size_t>(end - position)));
+        if (lineEnd == nullptr)
+        {
+            RETURN_HR_IF(E_FAIL, static_cast<size_t>(end - position) > MAX_LINE_SIZE);
+            break;
+        }
+
+        const char* next = lineEnd + 1;
+        if (lineEnd > position && *(lineEnd - 1) == '\r')
+        {
+            --lineEnd;
+        }
+        size_t lineSize = static_cast<size_t>(lineEnd - position);
+        RETURN_HR_IF(E_FAIL, lineSize > MAX_LINE_SIZE);
+
+        switch (m_state)
+        {
+            case state::status_line:
+                RETURN_IF_FAILED(ParseStatusLine(position, lineSize));
+                m_state = state::headers;
+                break;
+
+            case state::headers:
+                if (lineSize == 0)
+                {
+                    if (m_interim)
+                    {
+                        m_interim = false;
+                        m_state = state::status_line;
+                    }
+                    else
+                    {
+                        StartBody();
+                    }
+                }
+                else
+                {
+                    RETURN_IF_FAILED(ParseHeader(position, lineSize, callbacks));
+                }
+                break;
+
+            case state::chunk_size:
+                RETURN_IF_FAILED(ParseChunkSize(position, lineSize));
+                m_state = m_remaining > 0 ? state::chunk_data : state::trailers;
+                break;
+
+            case state::chunk_data_end:
+                RETURN_HR_IF(E_FAIL, lineSize != 0);
+                m_state = state::chunk_size;
+                break;
+
+            case state::trailers:
+                // Trailer fields aren't surfaced
+                if (lineSize == 0)
+                {
+                    m_state = state::complete;
+                }
+                break;
+
+            default:
+                ASSERT(false);
+                return E_FAIL;
+        }
+        position = next;
+    }
+
+    *consumed = static_cast<size_t>(position - begin);
+    return S_OK;
+}
+
+HRESULT http_response_parser::OnEndOfStream() noexcept
+{
+    if (m_state == state::body_until_close)
+    {
+        m_state = state::complete;
+    }
+    return m_state == state::complete ? S_OK : E_FAIL;
+}
+
+HRESULT http_response_parser::ParseStatusLine(_In_reads_(size) const char* line, _In_ size_t size) noexcept
+{
+    // HTTP/1.x SP 3DIGIT [SP reason-phrase]
+    RETURN_HR_IF(E_FAIL, size < 12 || std::memcmp(line, "HTTP/1.", 7) != 0 || line[8] != ' ');
+    RETURN_HR_IF(E_FAIL, line[7] != '0' && line[7] != '1');
+
+    uint32_t statusCode = 0;
+    for (size_t i = 9; i < 12; i++)
+    {
+        RETURN_HR_IF(E_FAIL, line[i] < '0' || line[i] > '9');
+        statusCode = statusCode * 10 + static_cast<uint32_t>(line[i] - '0');
+    }
+    RETURN_HR_IF(E_FAIL, statusCode < 100 || (size > 12 && line[12] != ' '));
+
+    // Upgrades are never requested, so a 101 is as malformed as any other unexpected response
+    RETURN_HR_IF(E_FAIL, statusCode == 101);
+
+    m_statusCode = statusCode;
+    m_interim = statusCode < 200;
+    m_keepAlive = line[7] == '1';
+    m_chunked = false;
+    m_hasContentLength = false;
+    return S_OK;
+}
+
+HRESULT http_response_parser::ParseHeader(_In_reads_(size) const char* line, _In_ size_t size, _In_ http_response_parser_callbacks& callbacks) noexcept
+{
+    const char* colon = static_cast<const char*>(std::memchr(line, ':', size));
+    RETURN_HR_IF(E_FAIL, colon == nullptr || colon == line || IsWhitespace(*(colon - 1)));
+
+    const char* end = line + size;
+    const char* value = colon + 1;
+    while (value < end && IsWhitespace(*value)) { ++value; }
+    while (end > value && IsWhitespace(*(end - 1))) { --end; }
+
+    size_t nameSize = static_cast<size_t>(colon - line);
+    size_t valueSize = static_cast<size_t>(end - value);
+    if (m_interim)
+    {
+        return S_OK;
+    }
+
+    if (EqualsIgnoreCase(line, nameSize, "content-length"))
+    {
+        uint64_t length = 0;
+        RETURN_HR_IF(E_FAIL, valueSize == 0 || valueSize > 19);
+        for (size_t i = 0; i < valueSize; i++)
+        {
+            RETURN_HR_IF(E_FAIL, value[i] < '0' || value[i] > '9');
+            length = length * 10 + static_cast<uint64_t>(value[i] - '0');
+        }
+        RETURN_HR_IF(E_FAIL, m_hasContentLength && length != m_remaining);
+        m_hasContentLength = true;
+        m_remaining = length;
+    }
+    else if (EqualsIgnoreCase(line, nameSize, "transfer-encoding"))
+    {
+        m_chunked = ContainsToken(value, valueSize, "chunked");
+    }
+    else if (EqualsIgnoreCase(line, nameSize, "connection"))
+    {
+        if (ContainsToken(value, valueSize, "close"))
+        {
+            m_keepAlive = false;
+        }
+        else if (ContainsToken(value, valueSize, "keep-alive"))
+        {
+            m_keepAlive = true;
+        }
+    }
+
+    return callbacks.OnResponseHeader(line, nameSize, value, valueSize);
+}
+
+HRESULT http_response_parser::ParseChunkSize(_In_reads_(size) const char* line, _In_ size_t size) noexcept
+{
+    uint64_t chunkSize = 0;
+    size_t i = 0;
+    for (; i < size; i++)
+    {
+        char c = ToLower(line[i]);
+        uint32_t digit = 0;
+        if (c >= '0' && c <= '9')
+        {
+            digit = static_cast<uint32_t>(c - '0');
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            digit = static_cast<uint32_t>(c - 'a' + 10);
+        }
+        else
+        {
+            break;
+        }
+        RETURN_HR_IF(E_FAIL, i >= 15);
+        chunkSize = (chunkSize << 4) | digit;
+    }
+
+    // Chunk extensions after the size are ignored
+    RETURN_HR_IF(E_FAIL, i == 0 || (i < size && line[i] != ';' && !IsWhitespace(line[i])));
+    m_remaining = chunkSize;
+    return S_OK;
+}
+
+void http_response_parser::StartBody() noexcept
+{
+    if (m_headRequest || m_statusCode == 204 || m_statusCode == 304)
+    {
+        m_state = state::complete;
+    }
+    else if (m_chunked)
+    {
+        // Transfer-Encoding overrides any Content-Length
+        m_state = state::chunk_size;
+    }
+    else if (m_hasContentLength)
+    {
+        m_state = m_remaining > 0 ? state::body_length : state::complete;
+    }
+    else
+    {
+        m_state = state::body_until_close;
+        m_keepAlive = false;
+    }
+}
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
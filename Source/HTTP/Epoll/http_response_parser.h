@@ -0,0 +1,83 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+#include "pch.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+// Receives the parts of a response as the parser finds them. Header names & values and body bytes point into the
+// caller's receive buffer and are only valid for the duration of the call.
+class http_response_parser_callbacks
+{
+public:
+    virtual HRESULT OnResponseHeader(_In_reads_(nameSize) const char* name, _In_ size_t nameSize, _In_reads_(valueSize) const char* value, _In_ size_t valueSize) noexcept = 0;
+    virtual HRESULT OnResponseBody(_In_reads_bytes_(size) const uint8_t* data, _In_ size_t size) noexcept = 0;
+
+protected:
+    ~http_response_parser_callbacks() = default;
+};
+
+// Incremental HTTP/1.1 response parser. Input is consumed in place: only complete lines of the status line, headers
+// and chunk framing are consumed, so a caller keeps any unconsumed tail and appends to it before parsing again. Body
+// bytes are passed straight through to the callbacks. Interim 1xx responses are skipped.
+class http_response_parser
+{
+public:
+    enum class state
+    {
+        status_line,
+        headers,
+        body_length,
+        chunk_size,
+        chunk_data,
+        chunk_data_end,
+        trailers,
+        body_until_close,
+        complete
+    };
+
+    // Longest status, header or chunk size line accepted
+    static constexpr size_t MAX_LINE_SIZE = 64 * 1024;
+
+    // A response to a HEAD request never has a body, whatever its headers say
+    void Reset(_In_ bool headRequest) noexcept;
+
+    // Parses as much of the input as possible. Returns E_FAIL if the response is malformed or a line is too long,
+    // or the first error returned by a callback. A body callback returning E_PENDING has taken its bytes but stops
+    // the parser there: Parse returns E_PENDING with them consumed, and the next call carries on after them.
+    HRESULT Parse(
+        _In_reads_bytes_(size) const uint8_t* data,
+        _In_ size_t size,
+        _In_ http_response_parser_callbacks& callbacks,
+        _Out_ size_t* consumed
+    ) noexcept;
+
+    // Called when the server closes the connection. Completes a response delimited by the close, and fails if the
+    // response was cut short.
+    HRESULT OnEndOfStream() noexcept;
+
+    bool IsComplete() const noexcept { return m_state == state::complete; }
+    bool HasStarted() const noexcept { return m_started; }
+    uint32_t StatusCode() const noexcept { return m_statusCode; }
+
+    // Whether the connection can carry another request once this response is complete
+    bool KeepAlive() const noexcept { return m_keepAlive; }
+
+private:
+    HRESULT ParseStatusLine(_In_reads_(size) const char* line, _In_ size_t size) noexcept;
+    HRESULT ParseHeader(_In_reads_(size) const char* line, _In_ size_t size, _In_ http_response_parser_callbacks& callbacks) noexcept;
+    HRESULT ParseChunkSize(_In_reads_(size) const char* line, _In_ size_t size) noexcept;
+    void StartBody() noexcept;
+
+    state m_state{ state::status_line };
+    bool m_headRequest{ false };
+    bool m_started{ false };
+    bool m_interim{ false };
+    bool m_keepAlive{ true };
+    bool m_chunked{ false };
+    bool m_hasContentLength{ false };
+    uint32_t m_statusCode{ 0 };
+    uint64_t m_remaining{ 0 };
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
@@ -1,5 +1,6 @@
 #include "pch.h"
 
+#if !HC_CURL_HTTP && !HC_EPOLL_HTTP
 #include <cassert>
 
 #include "../httpcall.h"
@@ -27,3 +28,5 @@ void Internal_HCHttpCallPerformAsync(
     // Register a custom Http handler
     assert(false);
 }
+
+#endif
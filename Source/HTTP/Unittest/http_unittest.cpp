@@ -3,7 +3,7 @@
 #include "pch.h"
 #if HC_UNITTEST_API
 #include "httpClient/httpClient.h"
-#include "../global/global.h"
+#include "../Global/global.h"
 
 HRESULT Internal_InitializeHttpPlatform(HCInitArgs* args, PerformEnv& performEnv) noexcept
 {
@@ -42,4 +42,50 @@ Internal_SetGlobalProxy(
     return E_NOTIMPL;
 }
 
+HRESULT
+Internal_PrewarmDnsCache(
+    _In_ HC_PERFORM_ENV* performEnv,
+    _In_reads_(hostNameCount) const char* const* hostNames,
+    _In_ uint32_t hostNameCount) noexcept
+{
+    UNREFERENCED_PARAMETER(performEnv);
+    UNREFERENCED_PARAMETER(hostNames);
+    UNREFERENCED_PARAMETER(hostNameCount);
+    return E_NOTIMPL;
+}
+
+HRESULT
+Internal_GetDnsCacheStats(
+    _In_ HC_PERFORM_ENV* performEnv,
+    _Out_ HCDnsCacheStats* stats) noexcept
+{
+    UNREFERENCED_PARAMETER(performEnv);
+    UNREFERENCED_PARAMETER(stats);
+    return E_NOTIMPL;
+}
+
+HRESULT
+Internal_HttpPreconnect(
+    _In_ HC_PERFORM_ENV* performEnv,
+    _In_z_ const char* url,
+    _In_ uint32_t connectionCount,
+    _Inout_ XAsyncBlock* asyncBlock) noexcept
+{
+    UNREFERENCED_PARAMETER(performEnv);
+    UNREFERENCED_PARAMETER(url);
+    UNREFERENCED_PARAMETER(connectionCount);
+    UNREFERENCED_PARAMETER(asyncBlock);
+    return E_NOTIMPL;
+}
+
+HRESULT
+Internal_GetHttpConnectionStats(
+    _In_ HC_PERFORM_ENV* performEnv,
+    _Out_ HCHttpConnectionStats* stats) noexcept
+{
+    UNREFERENCED_PARAMETER(performEnv);
+    UNREFERENCED_PARAMETER(stats);
+    return E_NOTIMPL;
+}
+
 #endif
@@ -210,7 +210,7 @@ void get_proxy_name(
         {
             *pAccessType = WINHTTP_ACCESS_TYPE_NAMED_PROXY;
 
-            http_internal_wstring wProxyHost = utf16_from_utf8(proxyUri.Host());
+            http_internal_wstring wProxyHost = utf16_from_utf8(proxyUri.Host().data(), proxyUri.Host().size());
 
             // WinHttpOpen cannot handle trailing slash in the name, so here is some string gymnastics to keep WinHttpOpen happy
             if (proxyUri.IsPortDefault())
@@ -289,6 +289,10 @@ winhttp_http_task::~winhttp_http_task()
     {
         WinHttpCloseHandle(m_hConnection);
     }
+    if (m_resumeQueue != nullptr)
+    {
+        XTaskQueueCloseHandle(m_resumeQueue);
+    }
 }
 
 void winhttp_http_task::complete_task(_In_ HRESULT translatedHR)
@@ -302,7 +306,7 @@ void winhttp_http_task::complete_task(_In_ HRESULT translatedHR, uint32_t platfo
         win32_cs_autolock autoCriticalSection(&m_lock);
 
         // Exit early if error happened and it was removed from cache to avoid calling XAsyncComplete() multiple times
-        if (shared_ptr_cache::fetch<winhttp_http_task>(this) == nullptr)
+        if (shared_ptr_cache::fetch<winhttp_http_task>(m_cacheHandle) == nullptr)
         {
             return;
         }
@@ -310,10 +314,16 @@ void winhttp_http_task::complete_task(_In_ HRESULT translatedHR, uint32_t platfo
         if (m_hRequest != nullptr && !m_isWebSocket)
         {
             WinHttpSetStatusCallback(m_hRequest, nullptr, WINHTTP_CALLBACK_FLAG_ALL_NOTIFICATIONS | WINHTTP_CALLBACK_FLAG_SECURE_FAILURE, NULL);
-            shared_ptr_cache::remove(this);
+            shared_ptr_cache::remove(m_cacheHandle);
         }
     }
 
+    // The resume handler may be running on another thread, so it's cleared before this task can go away
+    if (!m_isWebSocket)
+    {
+        http_call_clear_resume_handler(m_call);
+    }
+
     if (m_asyncBlock != nullptr)
     {
 #if HC_WINHTTP_WEBSOCKETS
@@ -344,10 +354,33 @@ void winhttp_http_task::read_next_response_chunk(_In_ winhttp_http_task* pReques
     }
 }
 
+HRESULT winhttp_http_task::read_response_data(_In_ winhttp_http_task* pRequestContext, DWORD bytesAvailable)
+{
+    pRequestContext->m_responseBuffer.resize(bytesAvailable);
+
+    // Read in body all at once.
+    if (!WinHttpReadData(
+        pRequestContext->m_hRequest,
+        pRequestContext->m_responseBuffer.data(),
+        bytesAvailable,
+        nullptr))
+    {
+        DWORD dwError = GetLastError();
+        HC_TRACE_ERROR(HTTPCLIENT, "winhttp_http_task [ID %llu] [TID %ul] WinHttpReadData errorcode %d", TO_ULL(HCHttpCallGetId(pRequestContext->m_call)), GetCurrentThreadId(), dwError);
+        return HRESULT_FROM_WIN32(dwError);
+    }
+    return S_OK;
+}
+
 void winhttp_http_task::_multiple_segment_write_data(_In_ winhttp_http_task* pRequestContext)
 {
     const size_t defaultChunkSize = 64 * 1024;
-    size_t safeSize = std::min(pRequestContext->m_requestBodyRemainingToWrite, defaultChunkSize);
+    const bool transferEncodingChunked = pRequestContext->m_requestBodyType == msg_body_type::transfer_encoding_chunked;
+    size_t safeSize = transferEncodingChunked ? defaultChunkSize : std::min(pRequestContext->m_requestBodyRemainingToWrite, defaultChunkSize);
+
+    // Room for a chunk's hex size line before the data and its CRLF after it
+    const size_t chunkPrefixSize = transferEncodingChunked ? 2 * sizeof(size_t) + 2 : 0;
+    const size_t chunkSuffixSize = transferEncodingChunked ? 2 : 0;
 
     HCHttpCallRequestBodyReadFunction readFunction = nullptr;
     size_t bodySize = 0;
@@ -367,9 +400,15 @@ void winhttp_http_task::_multiple_segment_write_data(_In_ winhttp_http_task* pRe
     size_t bytesWritten = 0;
     try
     {
-        pRequestContext->m_requestBuffer.resize(safeSize);
+        pRequestContext->m_requestBuffer.resize(chunkPrefixSize + safeSize + chunkSuffixSize);
 
-        hr = readFunction(pRequestContext->m_call, pRequestContext->m_requestBodyOffset, safeSize, context, pRequestContext->m_requestBuffer.data(), &bytesWritten);
+        hr = readFunction(pRequestContext->m_call, pRequestContext->m_requestBodyOffset, safeSize, context, pRequestContext->m_requestBuffer.data() + chunkPrefixSize, &bytesWritten);
+        if (hr == E_PENDING)
+        {
+            // Nothing more is written until the call resumes, which reads again from the same offset
+            pRequestContext->m_sendPaused = true;
+            return;
+        }
         if (FAILED(hr))
         {
             pRequestContext->complete_task(hr);
@@ -382,10 +421,23 @@ void winhttp_http_task::_multiple_segment_write_data(_In_ winhttp_http_task* pRe
         return;
     }
 
+    uint8_t* segment = pRequestContext->m_requestBuffer.data() + chunkPrefixSize;
+    size_t segmentSize = bytesWritten;
+    if (transferEncodingChunked)
+    {
+        // A read of 0 bytes ends the body, and the resulting "0\r\n\r\n" is the terminating chunk
+        char sizeLine[2 * sizeof(size_t) + 3];
+        int sizeLineLength = sprintf_s(sizeLine, "%zx\r\n", bytesWritten);
+        segment -= sizeLineLength;
+        std::memcpy(segment, sizeLine, sizeLineLength);
+        std::memcpy(segment + sizeLineLength + bytesWritten, "\r\n", 2);
+        segmentSize += sizeLineLength + 2;
+    }
+
     if( !WinHttpWriteData(
         pRequestContext->m_hRequest,
-        pRequestContext->m_requestBuffer.data(),
-        static_cast<DWORD>(bytesWritten),
+        segment,
+        static_cast<DWORD>(segmentSize),
         nullptr))
     {
         DWORD dwError = GetLastError();
@@ -395,10 +447,20 @@ void winhttp_http_task::_multiple_segment_write_data(_In_ winhttp_http_task* pRe
     }
 
     // Stop writing chunks after this one if no more data.
-    pRequestContext->m_requestBodyRemainingToWrite -= bytesWritten;
-    if (pRequestContext->m_requestBodyRemainingToWrite == 0)
+    if (transferEncodingChunked)
     {
-        pRequestContext->m_requestBodyType = msg_body_type::no_body;
+        if (bytesWritten == 0)
+        {
+            pRequestContext->m_requestBodyType = msg_body_type::no_body;
+        }
+    }
+    else
+    {
+        pRequestContext->m_requestBodyRemainingToWrite -= bytesWritten;
+        if (pRequestContext->m_requestBodyRemainingToWrite == 0)
+        {
+            pRequestContext->m_requestBodyType = msg_body_type::no_body;
+        }
     }
     pRequestContext->m_requestBodyOffset += bytesWritten;
 }
@@ -414,7 +476,8 @@ void winhttp_http_task::callback_status_write_complete(
         DWORD bytesWritten = *((DWORD *)statusInfo);
         HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallPerform [ID %llu] [TID %ul] WINHTTP_CALLBACK_STATUS_WRITE_COMPLETE bytesWritten=%d", TO_ULL(HCHttpCallGetId(pRequestContext->m_call)), GetCurrentThreadId(), bytesWritten);
 
-        if (pRequestContext->m_requestBodyType == content_length_chunked)
+        if (pRequestContext->m_requestBodyType == content_length_chunked ||
+            pRequestContext->m_requestBodyType == transfer_encoding_chunked)
         {
             _multiple_segment_write_data(pRequestContext);
             return;
@@ -511,7 +574,7 @@ void winhttp_http_task::callback_status_request_error(
             {
                 win32_cs_autolock autoCriticalSection(&pRequestContext->m_lock);
 
-                hr = pRequestContext->send(xbox::httpclient::Uri{ url }, method);
+                hr = pRequestContext->send(http_call_get_parsed_url(pRequestContext->m_call), method);
             }
             if (FAILED(hr))
             {
@@ -576,7 +639,8 @@ void winhttp_http_task::callback_status_sendrequest_complete(
 
         HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallPerform [ID %llu] [TID %ul] WINHTTP_CALLBACK_STATUS_SENDREQUEST_COMPLETE", TO_ULL(HCHttpCallGetId(pRequestContext->m_call)), GetCurrentThreadId());
 
-        if (pRequestContext->m_requestBodyType == content_length_chunked)
+        if (pRequestContext->m_requestBodyType == content_length_chunked ||
+            pRequestContext->m_requestBodyType == transfer_encoding_chunked)
         {
             _multiple_segment_write_data(pRequestContext);
             return;
@@ -722,7 +786,7 @@ void winhttp_http_task::callback_status_headers_available(
 }
 
 void winhttp_http_task::callback_status_data_available(
-    _In_ HINTERNET hRequestHandle,
+    _In_ HINTERNET /*hRequestHandle*/,
     _In_ winhttp_http_task* pRequestContext,
     _In_ void* statusInfo)
 {
@@ -747,22 +811,21 @@ void winhttp_http_task::callback_status_data_available(
     // Read new data into buffer
     if (newBytesAvailable > 0)
     {
-        pRequestContext->m_responseBuffer.resize(newBytesAvailable);
-
-        // Read in body all at once.
-        if (!WinHttpReadData(
-            hRequestHandle,
-            pRequestContext->m_responseBuffer.data(),
-            newBytesAvailable,
-            nullptr))
+        if (http_call_take_write_pause(pRequestContext->m_call))
         {
-            DWORD dwError = GetLastError();
-            HC_TRACE_ERROR(HTTPCLIENT, "winhttp_http_task [ID %llu] [TID %ul] WinHttpReadData errorcode %d", TO_ULL(HCHttpCallGetId(pRequestContext->m_call)), GetCurrentThreadId(), GetLastError());
+            // The data stays with WinHttp, and nothing more is received, until the call resumes
+            pRequestContext->m_receivePausedBytes = newBytesAvailable;
             pRequestContext->m_lock.unlock();
-            pRequestContext->complete_task(E_FAIL, HRESULT_FROM_WIN32(dwError));
             return;
         }
+
+        HRESULT hr = read_response_data(pRequestContext, newBytesAvailable);
         pRequestContext->m_lock.unlock();
+        if (FAILED(hr))
+        {
+            pRequestContext->complete_task(E_FAIL, hr);
+            return;
+        }
     }
     else
     {
@@ -1001,7 +1064,7 @@ void winhttp_http_task::set_autodiscover_proxy(
     HINTERNET session = m_env->GetSessionForHttpSecurityProtocolFlags(enabledHttpSecurityProtocolFlags);
     auto result = WinHttpGetProxyForUrl(
         session,
-        utf16_from_utf8(cUri.FullPath()).c_str(),
+        utf16_from_utf8(cUri.FullPath().data(), cUri.FullPath().size()).c_str(),
         &autoproxy_options,
         &info);
     if (result)
@@ -1031,7 +1094,7 @@ http_internal_wstring flatten_http_headers(_In_ const http_header_map& headers)
     bool foundUserAgent = false;
     for (const auto& header : headers)
     {
-        auto wHeaderName = utf16_from_utf8(header.first);
+        auto wHeaderName = utf16_from_utf8(header.first.c_str());
         if (wHeaderName == L"User-Agent")
         {
             foundUserAgent = true;
@@ -1039,7 +1102,7 @@ http_internal_wstring flatten_http_headers(_In_ const http_header_map& headers)
 
         flattened_headers.append(wHeaderName);
         flattened_headers.push_back(L':');
-        flattened_headers.append(utf16_from_utf8(header.second));
+        flattened_headers.append(utf16_from_utf8(header.second.c_str()));
         flattened_headers.append(CRLF);
     }
 
@@ -1111,7 +1174,7 @@ HRESULT winhttp_http_task::connect(
     unsigned int port = cUri.IsPortDefault() ?
         (m_isSecure ? INTERNET_DEFAULT_HTTPS_PORT : INTERNET_DEFAULT_HTTP_PORT) :
         cUri.Port();
-    http_internal_wstring wUri = utf16_from_utf8(cUri.FullPath());
+    http_internal_wstring wUri = utf16_from_utf8(cUri.FullPath().data(), cUri.FullPath().size());
 
 #if HC_PLATFORM != HC_PLATFORM_GDK
     uint32_t enabledHttpSecurityProtocolFlags = HC_PERFORM_ENV::GetDefaultHttpSecurityProtocolFlagsForWin7();
@@ -1152,7 +1215,7 @@ HRESULT winhttp_http_task::connect(
         }
     }
 
-    http_internal_wstring wUrlHost = utf16_from_utf8(cUri.Host());
+    http_internal_wstring wUrlHost = utf16_from_utf8(cUri.Host().data(), cUri.Host().size());
     m_hConnection = WinHttpConnect(
         hSession,
         wUrlHost.c_str(),
@@ -1222,7 +1285,19 @@ HRESULT winhttp_http_task::send(
         return hr;
     }
 
-    if (requestBodyBytes > 0)
+    if (requestBodyBytes == HC_UNKNOWN_REQUEST_BODY_SIZE)
+    {
+        // WinHttp leaves the chunk framing to us, see _multiple_segment_write_data
+        m_requestBodyType = msg_body_type::transfer_encoding_chunked;
+        m_requestBodyRemainingToWrite = 0;
+        if (!WinHttpAddRequestHeaders(m_hRequest, L"Transfer-Encoding: chunked", static_cast<DWORD>(-1), WINHTTP_ADDREQ_FLAG_ADD))
+        {
+            DWORD dwError = GetLastError();
+            HC_TRACE_ERROR(HTTPCLIENT, "winhttp_http_task [ID %llu] [TID %ul] WinHttpAddRequestHeaders errorcode %d", TO_ULL(HCHttpCallGetId(m_call)), GetCurrentThreadId(), dwError);
+            return HRESULT_FROM_WIN32(dwError);
+        }
+    }
+    else if (requestBodyBytes > 0)
     {
         // While we won't be transfer-encoding the data, we will write it in portions.
         m_requestBodyType = msg_body_type::content_length_chunked;
@@ -1243,7 +1318,7 @@ HRESULT winhttp_http_task::send(
 
     if (numHeaders > 0)
     {
-        http_internal_wstring flattenedHeaders = flatten_http_headers(m_call->requestHeaders);
+        http_internal_wstring flattenedHeaders = flatten_http_headers(m_call->requestHeaders.get());
         if (!WinHttpAddRequestHeaders(
                 m_hRequest,
                 flattenedHeaders.c_str(),
@@ -1332,7 +1407,7 @@ HRESULT winhttp_http_task::send(
         nullptr,
         0,
         dwTotalLength,
-        (DWORD_PTR)this))
+        callback_context()))
     {
         DWORD dwError = GetLastError();
         HC_TRACE_ERROR(HTTPCLIENT, "winhttp_http_task [ID %llu] [TID %ul] WinHttpSendRequest errorcode %d", TO_ULL(HCHttpCallGetId(m_call)), GetCurrentThreadId(), dwError);
@@ -1352,7 +1427,7 @@ HRESULT winhttp_http_task::connect_and_send_async()
         HRESULT hr = HCHttpCallRequestGetUrl(m_call, &method, &url);
         if (SUCCEEDED(hr))
         {
-            xbox::httpclient::Uri cUri(url);
+            xbox::httpclient::Uri const& cUri = http_call_get_parsed_url(m_call);
 
             hr = connect(cUri);
             if (SUCCEEDED(hr))
@@ -1387,6 +1462,67 @@ HRESULT winhttp_http_task::connect_and_send_async()
     return S_OK;
 }
 
+HRESULT winhttp_http_task::set_resume_handler()
+{
+    if (m_asyncBlock->queue == nullptr)
+    {
+        RETURN_HR_IF(E_NO_TASK_QUEUE, !XTaskQueueGetCurrentProcessTaskQueue(&m_resumeQueue));
+    }
+    else
+    {
+        RETURN_IF_FAILED(XTaskQueueDuplicateHandle(m_asyncBlock->queue, &m_resumeQueue));
+    }
+
+    http_call_set_resume_handler(m_call, resume_handler, this);
+    return S_OK;
+}
+
+void winhttp_http_task::resume_handler(_In_ HCCallHandle /*call*/, _In_opt_ void* context)
+{
+    // This runs holding the call's cancel lock, which the WinHttp callbacks take while holding m_lock, so the
+    // transfer continues on the call's queue instead
+    auto pRequestContext = static_cast<winhttp_http_task*>(context);
+    HRESULT hr = XTaskQueueSubmitCallback(pRequestContext->m_resumeQueue, XTaskQueuePort::Work, pRequestContext->m_cacheHandle, resume_transfer);
+    if (FAILED(hr))
+    {
+        // The transfer stays paused until its timeout
+        HC_TRACE_ERROR(HTTPCLIENT, "winhttp_http_task [ID %llu] failed to resume body transfer 0x%0.8x", TO_ULL(HCHttpCallGetId(pRequestContext->m_call)), hr);
+    }
+}
+
+void CALLBACK winhttp_http_task::resume_transfer(_In_opt_ void* context, _In_ bool canceled)
+{
+    // The task may have completed since the resume was queued
+    auto requestContext = shared_ptr_cache::fetch<winhttp_http_task>(context);
+    if (canceled || requestContext == nullptr)
+    {
+        return;
+    }
+
+    winhttp_http_task* pRequestContext = requestContext.get();
+    HRESULT hr = S_OK;
+    {
+        win32_cs_autolock autoCriticalSection(&pRequestContext->m_lock);
+
+        if (pRequestContext->m_sendPaused)
+        {
+            pRequestContext->m_sendPaused = false;
+            _multiple_segment_write_data(pRequestContext);
+        }
+        else if (pRequestContext->m_receivePausedBytes > 0)
+        {
+            DWORD bytesAvailable = pRequestContext->m_receivePausedBytes;
+            pRequestContext->m_receivePausedBytes = 0;
+            hr = read_response_data(pRequestContext, bytesAvailable);
+        }
+    }
+
+    if (FAILED(hr))
+    {
+        pRequestContext->complete_task(E_FAIL, hr);
+    }
+}
+
 NAMESPACE_XBOX_HTTP_CLIENT_END
 
 #if HC_PLATFORM == HC_PLATFORM_GDK
@@ -1522,14 +1658,17 @@ void CALLBACK Internal_HCHttpCallPerformAsync(
     bool isWebsocket = false;
     std::shared_ptr<xbox::httpclient::winhttp_http_task> httpTask = http_allocate_shared<winhttp_http_task>(
         asyncBlock, call, env, env->m_proxyType, isWebsocket);
-    auto raw = shared_ptr_cache::store<winhttp_http_task>(httpTask);
-    if (raw == nullptr)
+    httpTask->m_cacheHandle = shared_ptr_cache::store<winhttp_http_task>(httpTask);
+    if (httpTask->m_cacheHandle == nullptr)
     {
         XAsyncComplete(asyncBlock, E_HC_NOT_INITIALISED, 0);
         return;
     }
 
     HCHttpCallSetContext(call, httpTask.get());
+
+    // Without a resume handler, a body callback returning E_PENDING blocks its WinHttp thread until the call resumes
+    (void)httpTask->set_resume_handler();
     httpTask->connect_and_send_async();
 }
 
@@ -1770,8 +1909,10 @@ void winhttp_http_task::callback_websocket_status_headers_available(
         return;
     }
 
-    void* pThis = pRequestContext;
-    if (!WinHttpSetOption(pRequestContext->m_hRequest, WINHTTP_OPTION_CONTEXT_VALUE, &pThis, sizeof(pThis)))
+    // The upgraded handle must carry the same cache handle WinHttpSendRequest was given, or completion_callback drops its notifications
+    DWORD_PTR context = pRequestContext->callback_context();
+    static_assert(sizeof(context) == sizeof(pRequestContext->m_cacheHandle), "WinHttp context values must round-trip a cache handle");
+    if (!WinHttpSetOption(pRequestContext->m_hRequest, WINHTTP_OPTION_CONTEXT_VALUE, &context, sizeof(context)))
     {
         DWORD dwError = GetLastError();
         HC_TRACE_ERROR(HTTPCLIENT, "HCHttpCallPerform [ID %llu] [TID %ul] WinHttpSetOption errorcode %d", TO_ULL(HCHttpCallGetId(pRequestContext->m_call)), GetCurrentThreadId(), dwError);
@@ -4,6 +4,7 @@
 #include "pch.h"
 #include <winhttp.h>
 #include "utils.h"
+#include "../httpcall.h"
 #include "uri.h"
 
 #if HC_PLATFORM == HC_PLATFORM_GDK
@@ -88,7 +89,7 @@ public:
         HRESULT hr = S_OK;
         if (dataByteCount > 0)
         {
-            m_buffer = static_cast<uint8_t*>(http_memory::mem_alloc(dataByteCount));
+            m_buffer = static_cast<uint8_t*>(http_memory::mem_alloc(dataByteCount, HC_MEMORY_TYPE_WEBSOCKET));
             if (m_buffer != nullptr)
             {
                 m_bufferByteCapacity = dataByteCount;
@@ -133,12 +134,12 @@ public:
 
         if (dataByteCount > m_bufferByteCapacity)
         {
-            newBuffer = static_cast<uint8_t*>(http_memory::mem_alloc(dataByteCount));
+            newBuffer = static_cast<uint8_t*>(http_memory::mem_alloc(dataByteCount, HC_MEMORY_TYPE_WEBSOCKET));
             if (newBuffer != nullptr)
             {
                 // Copy the contents of the old buffer
                 CopyMemory(newBuffer, m_buffer, m_bufferByteCount);
-                http_memory::mem_free(m_buffer);
+                http_memory::mem_free(m_buffer, HC_MEMORY_TYPE_WEBSOCKET);
                 m_buffer = newBuffer;
                 m_bufferByteCapacity = dataByteCount;
             }
@@ -155,7 +156,7 @@ public:
     {
         if (m_buffer != nullptr)
         {
-            http_memory::mem_free(m_buffer);
+            http_memory::mem_free(m_buffer, HC_MEMORY_TYPE_WEBSOCKET);
         }
     }
 
@@ -189,6 +190,15 @@ public:
 
     HRESULT connect_and_send_async();
 
+    // Lets the call's body callbacks pause the transfer by returning E_PENDING, see http_call_set_resume_handler
+    HRESULT set_resume_handler();
+
+    // This task's shared_ptr_cache handle, passed to WinHttp as the request context
+    void* m_cacheHandle = nullptr;
+
+    // The context value every WinHttp handle owned by this task must carry; completion_callback decodes it with shared_ptr_cache::fetch
+    DWORD_PTR callback_context() const noexcept { return reinterpret_cast<DWORD_PTR>(m_cacheHandle); }
+
 #if HC_WINHTTP_WEBSOCKETS
     void send_websocket_message(WINHTTP_WEB_SOCKET_BUFFER_TYPE eBufferType, _In_ const void* payloadPtr, _In_ size_t payloadLength);
     HRESULT disconnect_websocket(_In_ HCWebSocketCloseStatus closeStatus);
@@ -208,8 +218,12 @@ private:
         _In_ winhttp_http_task* pRequestContext);
 
     static void read_next_response_chunk(_In_ winhttp_http_task* pRequestContext, DWORD bytesRead);
+    static HRESULT read_response_data(_In_ winhttp_http_task* pRequestContext, DWORD bytesAvailable);
     static void _multiple_segment_write_data(_In_ winhttp_http_task* pRequestContext);
 
+    static void resume_handler(_In_ HCCallHandle call, _In_opt_ void* context);
+    static void CALLBACK resume_transfer(_In_opt_ void* context, _In_ bool canceled);
+
     static void parse_headers_string(_In_ HCCallHandle call, _In_ wchar_t* headersStr);
 
     static void callback_status_request_error(
@@ -309,8 +323,11 @@ private:
     msg_body_type m_requestBodyType = msg_body_type::no_body;
     size_t m_requestBodyRemainingToWrite = 0;
     size_t m_requestBodyOffset = 0;
-    http_internal_vector<uint8_t> m_requestBuffer;
-    http_internal_vector<uint8_t> m_responseBuffer;
+    http_body_bytes m_requestBuffer;
+    http_body_bytes m_responseBuffer;
+    bool m_sendPaused = false; // the read function has no more body until the call resumes
+    DWORD m_receivePausedBytes = 0; // left unread with WinHttp until the call resumes
+    XTaskQueueHandle m_resumeQueue = nullptr;
     proxy_type m_proxyType = proxy_type::default_proxy;
     win32_cs m_lock;
     bool m_isWebSocket = false;
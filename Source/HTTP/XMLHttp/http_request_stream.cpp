@@ -7,7 +7,9 @@
 
 http_request_stream::http_request_stream() :
     m_call(nullptr),
-    m_startIndex(0)
+    m_startIndex(0),
+    m_bodySize(0),
+    m_isBuffered(false)
 {
 }
 
@@ -28,11 +30,60 @@ HRESULT http_request_stream::init(
         return E_INVALIDARG;
     }
 
+    HCHttpCallRequestBodyReadFunction readFunction = nullptr;
+    void* context = nullptr;
+    HRESULT hr = HCHttpCallRequestGetRequestBodyReadFunction(call, &readFunction, &m_bodySize, &context);
+    if (FAILED(hr) || readFunction == nullptr)
+    {
+        return FAILED(hr) ? hr : E_INVALIDARG;
+    }
+
     m_call = HCHttpCallDuplicateHandle(call);
     m_startIndex = 0;
+
+    if (m_bodySize == HC_UNKNOWN_REQUEST_BODY_SIZE)
+    {
+        return buffer_body(readFunction, context);
+    }
     return S_OK;
 }
 
+HRESULT http_request_stream::buffer_body(
+    _In_ HCHttpCallRequestBodyReadFunction readFunction,
+    _In_opt_ void* context
+    )
+{
+    const size_t readSize = 64 * 1024;
+    size_t bytesWritten = 0;
+    do
+    {
+        try
+        {
+            size_t offset = m_bufferedBody.size();
+            m_bufferedBody.resize(offset + readSize);
+            HRESULT hr = readFunction(m_call, offset, readSize, context, m_bufferedBody.data() + offset, &bytesWritten);
+            m_bufferedBody.resize(offset + (SUCCEEDED(hr) ? bytesWritten : 0));
+            if (FAILED(hr))
+            {
+                return hr;
+            }
+        }
+        catch (...)
+        {
+            return E_FAIL;
+        }
+    } while (bytesWritten > 0);
+
+    m_bodySize = m_bufferedBody.size();
+    m_isBuffered = true;
+    return S_OK;
+}
+
+size_t http_request_stream::get_body_size() const
+{
+    return m_bodySize;
+}
+
 HRESULT STDMETHODCALLTYPE http_request_stream::Write(
     _In_reads_bytes_(cb) const void *pv,
     _In_ ULONG cb,
@@ -51,6 +102,18 @@ HRESULT STDMETHODCALLTYPE http_request_stream::Read(
     _Out_ ULONG *pcbRead
     )
 {
+    if (m_isBuffered)
+    {
+        size_t bytesCopied = std::min(static_cast<size_t>(cb), m_bufferedBody.size() - m_startIndex);
+        std::memcpy(pv, m_bufferedBody.data() + m_startIndex, bytesCopied);
+        m_startIndex += bytesCopied;
+        if (pcbRead != nullptr)
+        {
+            *pcbRead = static_cast<DWORD>(bytesCopied);
+        }
+        return S_OK;
+    }
+
     HCHttpCallRequestBodyReadFunction readFunction = nullptr;
     size_t bodySize = 0;
     void* context = nullptr;
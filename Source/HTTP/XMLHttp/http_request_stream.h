@@ -27,8 +27,19 @@ public:
         _Out_ ULONG *pcbRead
         );
 
+    // Send needs the length up front, so a body of HC_UNKNOWN_REQUEST_BODY_SIZE is read into memory by init
+    size_t get_body_size() const;
+
 private:
+    HRESULT buffer_body(
+        _In_ HCHttpCallRequestBodyReadFunction readFunction,
+        _In_opt_ void* context
+        );
+
     HCCallHandle m_call;
     size_t m_startIndex;
+    size_t m_bodySize;
+    bool m_isBuffered;
+    http_body_bytes m_bufferedBody;
 };
 
@@ -151,7 +151,7 @@ void xmlhttp_http_task::perform_async(
                 return;
             }
 
-            hr = m_hRequest->Send(requestStream.Get(), requestBodySize);
+            hr = m_hRequest->Send(requestStream.Get(), requestStream->get_body_size());
         }
         else
         {
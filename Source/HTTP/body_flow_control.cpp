@@ -0,0 +1,169 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "body_flow_control.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+HRESULT http_body_flow_control::Attach(_In_ HCCallHandle call) noexcept
+try
+{
+    // The library's own functions never pause
+    bool wrapRead = call->requestBodyReadFunction != DefaultRequestBodyReadFunction;
+    bool wrapWrite = call->responseBodyWriteFunction != DefaultResponseBodyWriteFunction && call->responseBodyWriteFunction != ResponseBodyWriteAtFunctionAdapter;
+    if (!wrapRead && !wrapWrite)
+    {
+        return S_OK;
+    }
+
+    auto flowControl = http_allocate_shared<http_body_flow_control>(
+        call,
+        wrapRead ? call->requestBodyReadFunction : nullptr,
+        call->requestBodyReadFunctionContext,
+        wrapWrite ? call->responseBodyWriteFunction : nullptr,
+        call->responseBodyWriteFunctionContext
+    );
+
+    if (wrapRead)
+    {
+        call->requestBodyReadFunction = ReadFunction;
+        call->requestBodyReadFunctionContext = flowControl.get();
+    }
+    if (wrapWrite)
+    {
+        call->responseBodyWriteFunction = WriteFunction;
+        call->responseBodyWriteFunctionContext = flowControl.get();
+    }
+
+    // HCHttpCallResumeBodyTransfer may be called on any thread
+    std::lock_guard<std::recursive_mutex> lock{ call->cancelLock };
+    call->bodyFlowControl = std::move(flowControl);
+    return S_OK;
+}
+CATCH_RETURN()
+
+void http_body_flow_control::Detach(_In_ HCCallHandle call) noexcept
+{
+    std::shared_ptr<http_body_flow_control> flowControl;
+    {
+        std::lock_guard<std::recursive_mutex> lock{ call->cancelLock };
+        flowControl = std::move(call->bodyFlowControl);
+    }
+    if (!flowControl)
+    {
+        return;
+    }
+
+    if (flowControl->m_readFunction != nullptr)
+    {
+        call->requestBodyReadFunction = flowControl->m_readFunction;
+        call->requestBodyReadFunctionContext = flowControl->m_readContext;
+    }
+    if (flowControl->m_writeFunction != nullptr)
+    {
+        call->responseBodyWriteFunction = flowControl->m_writeFunction;
+        call->responseBodyWriteFunctionContext = flowControl->m_writeContext;
+    }
+}
+
+http_body_flow_control::http_body_flow_control(
+    HCCallHandle call,
+    HCHttpCallRequestBodyReadFunction readFunction,
+    _In_opt_ void* readContext,
+    HCHttpCallResponseBodyWriteFunction writeFunction,
+    _In_opt_ void* writeContext
+) noexcept :
+    m_call{ call },
+    m_readFunction{ readFunction },
+    m_readContext{ readContext },
+    m_writeFunction{ writeFunction },
+    m_writeContext{ writeContext }
+{
+}
+
+void http_body_flow_control::Resume() noexcept
+{
+    std::lock_guard<std::mutex> lock{ m_lock };
+    m_resumeSignaled = true;
+    m_resumed.notify_all();
+}
+
+void http_body_flow_control::Abort() noexcept
+{
+    std::lock_guard<std::mutex> lock{ m_lock };
+    m_aborted = true;
+    m_resumed.notify_all();
+}
+
+bool http_body_flow_control::TakeWritePause() noexcept
+{
+    return m_writePaused.exchange(false);
+}
+
+HRESULT CALLBACK http_body_flow_control::ReadFunction(
+    _In_ HCCallHandle call,
+    _In_ size_t offset,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context,
+    _Out_writes_bytes_to_(bytesAvailable, *bytesWritten) uint8_t* destination,
+    _Out_ size_t* bytesWritten
+) noexcept
+{
+    auto flowControl = static_cast<http_body_flow_control*>(context);
+    while (true)
+    {
+        HRESULT hr = flowControl->m_readFunction(call, offset, bytesAvailable, flowControl->m_readContext, destination, bytesWritten);
+        if (hr != E_PENDING)
+        {
+            return hr;
+        }
+
+        *bytesWritten = 0;
+        if (flowControl->ProviderPauses())
+        {
+            return E_PENDING;
+        }
+        RETURN_IF_FAILED(flowControl->WaitForResume());
+    }
+}
+
+HRESULT CALLBACK http_body_flow_control::WriteFunction(
+    _In_ HCCallHandle call,
+    _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context
+) noexcept
+{
+    auto flowControl = static_cast<http_body_flow_control*>(context);
+    HRESULT hr = flowControl->m_writeFunction(call, source, bytesAvailable, flowControl->m_writeContext);
+    if (hr != E_PENDING)
+    {
+        return hr;
+    }
+
+    // The bytes were taken, so the wrappers between here and the provider (e.g. the response decompressor) carry on
+    // as usual and the provider picks up the pause once they return
+    if (flowControl->ProviderPauses())
+    {
+        flowControl->m_writePaused = true;
+        return S_OK;
+    }
+    return flowControl->WaitForResume();
+}
+
+bool http_body_flow_control::ProviderPauses() const noexcept
+{
+    std::lock_guard<std::recursive_mutex> lock{ m_call->cancelLock };
+    return m_call->resumeHandler != nullptr;
+}
+
+HRESULT http_body_flow_control::WaitForResume() noexcept
+{
+    std::unique_lock<std::mutex> lock{ m_lock };
+    m_resumed.wait(lock, [this] { return m_resumeSignaled || m_aborted; });
+    m_resumeSignaled = false;
+    return m_aborted ? E_ABORT : S_OK;
+}
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
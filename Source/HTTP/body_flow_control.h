@@ -0,0 +1,72 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+#include "pch.h"
+#include "httpcall.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+// Installed around a call's own request body read function and response body write function for each attempt, so
+// they can pause the transfer by returning E_PENDING. A provider that set a resume handler pauses the transfer
+// itself (see http_call_set_resume_handler). With any other provider the thread that invoked the callback waits
+// here until HCHttpCallResumeBodyTransfer is called.
+class http_body_flow_control
+{
+public:
+    // Must be attached before the other wrappers, so they see the provider's side of the pause
+    static HRESULT Attach(_In_ HCCallHandle call) noexcept;
+    static void Detach(_In_ HCCallHandle call) noexcept;
+
+    http_body_flow_control(
+        HCCallHandle call,
+        HCHttpCallRequestBodyReadFunction readFunction,
+        _In_opt_ void* readContext,
+        HCHttpCallResponseBodyWriteFunction writeFunction,
+        _In_opt_ void* writeContext
+    ) noexcept;
+    http_body_flow_control(const http_body_flow_control&) = delete;
+    http_body_flow_control& operator=(const http_body_flow_control&) = delete;
+
+    // Wakes a callback waiting for HCHttpCallResumeBodyTransfer, which fails with E_ABORT after Abort
+    void Resume() noexcept;
+    void Abort() noexcept;
+
+    // Whether the write function returned E_PENDING since this was last called
+    bool TakeWritePause() noexcept;
+
+private:
+    static HRESULT CALLBACK ReadFunction(
+        _In_ HCCallHandle call,
+        _In_ size_t offset,
+        _In_ size_t bytesAvailable,
+        _In_opt_ void* context,
+        _Out_writes_bytes_to_(bytesAvailable, *bytesWritten) uint8_t* destination,
+        _Out_ size_t* bytesWritten
+    ) noexcept;
+
+    static HRESULT CALLBACK WriteFunction(
+        _In_ HCCallHandle call,
+        _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+        _In_ size_t bytesAvailable,
+        _In_opt_ void* context
+    ) noexcept;
+
+    bool ProviderPauses() const noexcept;
+    HRESULT WaitForResume() noexcept;
+
+    HCCallHandle const m_call;
+    HCHttpCallRequestBodyReadFunction const m_readFunction;
+    void* const m_readContext;
+    HCHttpCallResponseBodyWriteFunction const m_writeFunction;
+    void* const m_writeContext;
+
+    std::atomic<bool> m_writePaused{ false };
+
+    std::mutex m_lock;
+    std::condition_variable m_resumed;
+    bool m_resumeSignaled{ false };
+    bool m_aborted{ false };
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
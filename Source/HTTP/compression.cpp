@@ -0,0 +1,2014 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "compression.h"
+#include "httpcall.h"
+
+#define ACCEPT_ENCODING_HEADER ("Accept-Encoding")
+#define CONTENT_ENCODING_HEADER ("Content-Encoding")
+#define CONTENT_LENGTH_HEADER ("Content-Length")
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+namespace
+{
+
+constexpr uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+constexpr uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+constexpr uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+constexpr uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+constexpr uint8_t CODE_LENGTH_ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+constexpr uint32_t NO_SYMBOL = UINT32_MAX;
+
+constexpr uint32_t GZIP_FHCRC = 0x02;
+constexpr uint32_t GZIP_FEXTRA = 0x04;
+constexpr uint32_t GZIP_FNAME = 0x08;
+constexpr uint32_t GZIP_FCOMMENT = 0x10;
+constexpr uint32_t GZIP_RESERVED = 0xE0;
+
+bool IsZlibHeader(uint32_t cmf, uint32_t flg) noexcept
+{
+    return (cmf & 0x0F) == 8 && (cmf >> 4) <= 7 && ((cmf << 8) | flg) % 31 == 0;
+}
+
+// Once a change made to a copy of shared request headers is undone, shares them again rather than keeping the copy
+void ReshareRequestHeaders(_In_ HCCallHandle call, std::shared_ptr<http_header_map const> const& sharedHeaders)
+{
+    if (sharedHeaders != nullptr && !call->requestHeaders.is_shared() && call->requestHeaders.get() == *sharedHeaders)
+    {
+        call->requestHeaders.share(sharedHeaders);
+    }
+}
+
+}
+
+http_inflater::http_inflater(
+    http_compression_format format,
+    http_compression_sink sink,
+    _In_opt_ void* sinkContext
+) noexcept :
+    m_format{ format },
+    m_sink{ sink },
+    m_sinkContext{ sinkContext },
+    m_state{ format == http_compression_format::gzip ? state::gzip_header :
+             format == http_compression_format::zlib ? state::zlib_header : state::detect_deflate },
+    m_symbol{ NO_SYMBOL }
+{
+}
+
+HRESULT http_inflater::Write(_In_reads_bytes_(size) const uint8_t* data, _In_ size_t size) noexcept
+{
+    if (m_state == state::failed)
+    {
+        return m_error;
+    }
+
+    m_in = data;
+    m_inEnd = data + size;
+    m_compressedBytes += size;
+
+    HRESULT hr = Run();
+    if (SUCCEEDED(hr))
+    {
+        hr = FlushWindow();
+    }
+    m_in = m_inEnd = nullptr;
+
+    if (FAILED(hr))
+    {
+        m_state = state::failed;
+        m_error = hr;
+    }
+    return hr;
+}
+
+HRESULT http_inflater::Finish() noexcept
+{
+    if (m_state == state::failed)
+    {
+        return m_error;
+    }
+    return m_state == state::done ? S_OK : E_HC_COMPRESSED_DATA_INVALID;
+}
+
+HRESULT http_inflater::Run() noexcept
+{
+    for (;;)
+    {
+        switch (m_state)
+        {
+        case state::detect_deflate:
+        {
+            // Content-Encoding: deflate should be zlib framed, but some servers send raw deflate data
+            if (!NeedBits(16))
+            {
+                return S_OK;
+            }
+            m_state = IsZlibHeader(m_bits & 0xFF, (m_bits >> 8) & 0xFF) ? state::zlib_header : state::block_header;
+            break;
+        }
+
+        case state::gzip_header:
+        {
+            if (!NeedBits(32))
+            {
+                return S_OK;
+            }
+            uint32_t id1 = GetBits(8);
+            uint32_t id2 = GetBits(8);
+            uint32_t method = GetBits(8);
+            m_gzipFlags = GetBits(8);
+            if (id1 != 0x1F || id2 != 0x8B || method != 8 || (m_gzipFlags & GZIP_RESERVED))
+            {
+                return E_HC_COMPRESSED_DATA_INVALID;
+            }
+            m_state = state::gzip_header_tail;
+            break;
+        }
+
+        case state::gzip_header_tail:
+        {
+            // Modification time, extra flags and OS
+            if (!NeedBits(48))
+            {
+                return S_OK;
+            }
+            GetBits(32);
+            GetBits(16);
+            m_state = state::gzip_extra_length;
+            break;
+        }
+
+        case state::gzip_extra_length:
+        {
+            if (m_gzipFlags & GZIP_FEXTRA)
+            {
+                if (!NeedBits(16))
+                {
+                    return S_OK;
+                }
+                m_remaining = GetBits(16);
+            }
+            else
+            {
+                m_remaining = 0;
+            }
+            m_state = state::gzip_extra;
+            break;
+        }
+
+        case state::gzip_extra:
+        {
+            for (; m_remaining > 0; --m_remaining)
+            {
+                if (!NeedBits(8))
+                {
+                    return S_OK;
+                }
+                GetBits(8);
+            }
+            m_state = state::gzip_name;
+            break;
+        }
+
+        case state::gzip_name:
+        case state::gzip_comment:
+        {
+            // Zero terminated strings
+            uint32_t const flag = m_state == state::gzip_name ? GZIP_FNAME : GZIP_FCOMMENT;
+            if (m_gzipFlags & flag)
+            {
+                for (;;)
+                {
+                    if (!NeedBits(8))
+                    {
+                        return S_OK;
+                    }
+                    if (GetBits(8) == 0)
+                    {
+                        break;
+                    }
+                }
+            }
+            m_state = m_state == state::gzip_name ? state::gzip_comment : state::gzip_header_crc;
+            break;
+        }
+
+        case state::gzip_header_crc:
+        {
+            if (m_gzipFlags & GZIP_FHCRC)
+            {
+                if (!NeedBits(16))
+                {
+                    return S_OK;
+                }
+                GetBits(16);
+            }
+            m_state = state::block_header;
+            break;
+        }
+
+        case state::zlib_header:
+        {
+            if (!NeedBits(16))
+            {
+                return S_OK;
+            }
+            uint32_t cmf = GetBits(8);
+            uint32_t flg = GetBits(8);
+            if (!IsZlibHeader(cmf, flg) || (flg & 0x20))
+            {
+                // Preset dictionaries aren't used by HTTP
+                return E_HC_COMPRESSED_DATA_INVALID;
+            }
+            m_zlib = true;
+            m_state = state::block_header;
+            break;
+        }
+
+        case state::block_header:
+        {
+            if (!NeedBits(3))
+            {
+                return S_OK;
+            }
+            m_finalBlock = GetBits(1) != 0;
+            switch (GetBits(2))
+            {
+            case 0:
+                m_state = state::stored_header;
+                break;
+
+            case 1:
+            {
+                uint8_t lengths[288 + 30];
+                std::fill(lengths, lengths + 144, uint8_t{ 8 });
+                std::fill(lengths + 144, lengths + 256, uint8_t{ 9 });
+                std::fill(lengths + 256, lengths + 280, uint8_t{ 7 });
+                std::fill(lengths + 280, lengths + 288, uint8_t{ 8 });
+                std::fill(lengths + 288, lengths + 288 + 30, uint8_t{ 5 });
+                m_literalTable.Build(lengths, 288);
+                m_distanceTable.Build(lengths + 288, 30);
+                m_state = state::literal_length;
+                break;
+            }
+
+            case 2:
+                m_state = state::dynamic_counts;
+                break;
+
+            default:
+                return E_HC_COMPRESSED_DATA_INVALID;
+            }
+            break;
+        }
+
+        case state::stored_header:
+        {
+            GetBits(m_bitCount % 8);
+            if (!NeedBits(32))
+            {
+                return S_OK;
+            }
+            uint32_t length = GetBits(16);
+            uint32_t lengthComplement = GetBits(16);
+            if (length != (~lengthComplement & 0xFFFF))
+            {
+                return E_HC_COMPRESSED_DATA_INVALID;
+            }
+            m_remaining = length;
+            m_state = state::stored_copy;
+            break;
+        }
+
+        case state::stored_copy:
+        {
+            // Bytes already pulled into the bit buffer come first, the rest is copied straight from the input
+            while (m_remaining > 0 && m_bitCount >= 8)
+            {
+                RETURN_IF_FAILED(PutByte(static_cast<uint8_t>(GetBits(8))));
+                --m_remaining;
+            }
+            while (m_remaining > 0 && m_in < m_inEnd)
+            {
+                uint32_t count = std::min({ m_remaining, WINDOW_SIZE - m_windowPos, static_cast<uint32_t>(std::min<size_t>(m_inEnd - m_in, UINT32_MAX)) });
+                std::memcpy(m_window + m_windowPos, m_in, count);
+                m_in += count;
+                m_windowPos += count;
+                m_decompressedBytes += count;
+                m_remaining -= count;
+                if (m_windowPos == WINDOW_SIZE)
+                {
+                    RETURN_IF_FAILED(FlushWindow());
+                }
+            }
+            if (m_remaining > 0)
+            {
+                return S_OK;
+            }
+            m_state = m_finalBlock ? state::trailer : state::block_header;
+            break;
+        }
+
+        case state::dynamic_counts:
+        {
+            if (!NeedBits(14))
+            {
+                return S_OK;
+            }
+            m_literalCount = GetBits(5) + 257;
+            m_distanceCount = GetBits(5) + 1;
+            m_codeLengthCount = GetBits(4) + 4;
+            if (m_literalCount > 286 || m_distanceCount > 30)
+            {
+                return E_HC_COMPRESSED_DATA_INVALID;
+            }
+            std::fill(m_lengths, m_lengths + 19, uint8_t{ 0 });
+            m_lengthIndex = 0;
+            m_state = state::code_length_lengths;
+            break;
+        }
+
+        case state::code_length_lengths:
+        {
+            for (; m_lengthIndex < m_codeLengthCount; ++m_lengthIndex)
+            {
+                if (!NeedBits(3))
+                {
+                    return S_OK;
+                }
+                m_lengths[CODE_LENGTH_ORDER[m_lengthIndex]] = static_cast<uint8_t>(GetBits(3));
+            }
+
+            // The code length code is decoded with the literal table, which is rebuilt once the lengths are known
+            if (!m_literalTable.Build(m_lengths, 19))
+            {
+                return E_HC_COMPRESSED_DATA_INVALID;
+            }
+            m_lengthIndex = 0;
+            m_symbol = NO_SYMBOL;
+            m_state = state::code_lengths;
+            break;
+        }
+
+        case state::code_lengths:
+        {
+            uint32_t const total = m_literalCount + m_distanceCount;
+            while (m_lengthIndex < total)
+            {
+                if (m_symbol == NO_SYMBOL)
+                {
+                    auto result = Decode(m_literalTable, m_symbol);
+                    if (result == decode_result::need_input)
+                    {
+                        m_symbol = NO_SYMBOL;
+                        return S_OK;
+                    }
+                    if (result == decode_result::invalid)
+                    {
+                        return E_HC_COMPRESSED_DATA_INVALID;
+                    }
+                }
+
+                if (m_symbol < 16)
+                {
+                    m_lengths[m_lengthIndex++] = static_cast<uint8_t>(m_symbol);
+                }
+                else
+                {
+                    // 16 repeats the previous length 3-6 times, 17 & 18 repeat a zero length 3-10 & 11-138 times
+                    uint32_t const extraBits = m_symbol == 16 ? 2 : m_symbol == 17 ? 3 : 7;
+                    if (!NeedBits(extraBits))
+                    {
+                        return S_OK;
+                    }
+                    uint32_t repeat = (m_symbol == 18 ? 11 : 3) + GetBits(extraBits);
+                    if (m_symbol == 16 && m_lengthIndex == 0)
+                    {
+                        return E_HC_COMPRESSED_DATA_INVALID;
+                    }
+                    uint8_t value = m_symbol == 16 ? m_lengths[m_lengthIndex - 1] : 0;
+                    if (m_lengthIndex + repeat > total)
+                    {
+                        return E_HC_COMPRESSED_DATA_INVALID;
+                    }
+                    std::fill(m_lengths + m_lengthIndex, m_lengths + m_lengthIndex + repeat, value);
+                    m_lengthIndex += repeat;
+                }
+                m_symbol = NO_SYMBOL;
+            }
+
+            if (m_lengths[256] == 0 ||
+                !m_literalTable.Build(m_lengths, m_literalCount) ||
+                !m_distanceTable.Build(m_lengths + m_literalCount, m_distanceCount))
+            {
+                return E_HC_COMPRESSED_DATA_INVALID;
+            }
+            m_state = state::literal_length;
+            break;
+        }
+
+        case state::literal_length:
+        {
+            for (;;)
+            {
+                uint32_t symbol;
+                auto result = Decode(m_literalTable, symbol);
+                if (result == decode_result::need_input)
+                {
+                    return S_OK;
+                }
+                if (result == decode_result::invalid)
+                {
+                    return E_HC_COMPRESSED_DATA_INVALID;
+                }
+
+                if (symbol < 256)
+                {
+                    RETURN_IF_FAILED(PutByte(static_cast<uint8_t>(symbol)));
+                    continue;
+                }
+
+                if (symbol == 256)
+                {
+                    m_state = m_finalBlock ? state::trailer : state::block_header;
+                }
+                else if (symbol - 257 < 29)
+                {
+                    m_symbol = symbol - 257;
+                    m_state = state::length_extra;
+                }
+                else
+                {
+                    return E_HC_COMPRESSED_DATA_INVALID;
+                }
+                break;
+            }
+            break;
+        }
+
+        case state::length_extra:
+        {
+            if (!NeedBits(LENGTH_EXTRA[m_symbol]))
+            {
+                return S_OK;
+            }
+            m_matchLength = LENGTH_BASE[m_symbol] + GetBits(LENGTH_EXTRA[m_symbol]);
+            m_state = state::distance;
+            break;
+        }
+
+        case state::distance:
+        {
+            uint32_t symbol;
+            auto result = Decode(m_distanceTable, symbol);
+            if (result == decode_result::need_input)
+            {
+                return S_OK;
+            }
+            if (result == decode_result::invalid || symbol >= 30)
+            {
+                return E_HC_COMPRESSED_DATA_INVALID;
+            }
+            m_symbol = symbol;
+            m_state = state::distance_extra;
+            break;
+        }
+
+        case state::distance_extra:
+        {
+            if (!NeedBits(DISTANCE_EXTRA[m_symbol]))
+            {
+                return S_OK;
+            }
+            uint32_t distance = DISTANCE_BASE[m_symbol] + GetBits(DISTANCE_EXTRA[m_symbol]);
+            if (distance > std::min<uint64_t>(m_decompressedBytes, WINDOW_SIZE))
+            {
+                return E_HC_COMPRESSED_DATA_INVALID;
+            }
+            RETURN_IF_FAILED(CopyMatch(m_matchLength, distance));
+            m_state = state::literal_length;
+            break;
+        }
+
+        case state::trailer:
+        {
+            GetBits(m_bitCount % 8);
+
+            // The checksums cover everything written to the sink
+            RETURN_IF_FAILED(FlushWindow());
+
+            if (m_format == http_compression_format::gzip)
+            {
+                if (!NeedBits(64))
+                {
+                    return S_OK;
+                }
+                uint32_t crc = GetBits(32);
+                uint32_t size = GetBits(32);
+                if (crc != m_crc32 || size != static_cast<uint32_t>(m_decompressedBytes))
+                {
+                    return E_HC_COMPRESSED_DATA_INVALID;
+                }
+            }
+            else if (m_zlib)
+            {
+                if (!NeedBits(32))
+                {
+                    return S_OK;
+                }
+                uint32_t adler = 0;
+                for (uint32_t i = 0; i < 4; ++i)
+                {
+                    adler = (adler << 8) | GetBits(8);
+                }
+                if (adler != m_adler32)
+                {
+                    return E_HC_COMPRESSED_DATA_INVALID;
+                }
+            }
+            m_state = state::done;
+            break;
+        }
+
+        case state::done:
+        {
+            // Anything after the end of the stream is ignored
+            m_in = m_inEnd;
+            m_bits = 0;
+            m_bitCount = 0;
+            return S_OK;
+        }
+
+        case state::failed:
+        default:
+            return m_error;
+        }
+    }
+}
+
+void http_inflater::Fill() noexcept
+{
+    while (m_bitCount <= 56 && m_in < m_inEnd)
+    {
+        m_bits |= static_cast<uint64_t>(*m_in++) << m_bitCount;
+        m_bitCount += 8;
+    }
+}
+
+bool http_inflater::NeedBits(uint32_t count) noexcept
+{
+    if (m_bitCount < count)
+    {
+        Fill();
+    }
+    return m_bitCount >= count;
+}
+
+uint32_t http_inflater::GetBits(uint32_t count) noexcept
+{
+    uint32_t value = static_cast<uint32_t>(m_bits & ((uint64_t{ 1 } << count) - 1));
+    m_bits >>= count;
+    m_bitCount -= count;
+    return value;
+}
+
+http_inflater::decode_result http_inflater::Decode(huffman_table const& table, _Out_ uint32_t& symbol) noexcept
+{
+    symbol = NO_SYMBOL;
+    if (m_bitCount < MAX_CODE_BITS)
+    {
+        Fill();
+    }
+
+    uint32_t entry = table.fast[m_bits & ((1u << FAST_BITS) - 1)];
+    uint32_t length = entry >> 12;
+    if (length != 0 && length <= m_bitCount)
+    {
+        symbol = entry & 0xFFF;
+        m_bits >>= length;
+        m_bitCount -= length;
+        return decode_result::ok;
+    }
+
+    // Longer codes are decoded a bit at a time. Deflate sends Huffman codes most significant bit first.
+    int32_t code = 0;
+    int32_t first = 0;
+    int32_t index = 0;
+    uint64_t bits = m_bits;
+    for (uint32_t len = 1; len <= MAX_CODE_BITS; ++len)
+    {
+        if (len > m_bitCount)
+        {
+            return decode_result::need_input;
+        }
+
+        code |= static_cast<int32_t>(bits & 1);
+        bits >>= 1;
+        int32_t count = table.counts[len];
+        if (code - count < first)
+        {
+            symbol = table.symbols[index + (code - first)];
+            m_bits >>= len;
+            m_bitCount -= len;
+            return decode_result::ok;
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return decode_result::invalid;
+}
+
+bool http_inflater::huffman_table::Build(_In_reads_(count) const uint8_t* lengths, uint32_t count) noexcept
+{
+    std::fill(std::begin(counts), std::end(counts), uint16_t{ 0 });
+    for (uint32_t symbol = 0; symbol < count; ++symbol)
+    {
+        ++counts[lengths[symbol]];
+    }
+    counts[0] = 0;
+
+    // Reject over-subscribed codes. Incomplete codes are allowed; their unused codes fail to decode.
+    int32_t left = 1;
+    for (uint32_t len = 1; len <= MAX_CODE_BITS; ++len)
+    {
+        left <<= 1;
+        left -= counts[len];
+        if (left < 0)
+        {
+            return false;
+        }
+    }
+
+    uint16_t offsets[MAX_CODE_BITS + 2]{};
+    for (uint32_t len = 1; len <= MAX_CODE_BITS; ++len)
+    {
+        offsets[len + 1] = offsets[len] + counts[len];
+    }
+    for (uint32_t symbol = 0; symbol < count; ++symbol)
+    {
+        if (lengths[symbol] != 0)
+        {
+            symbols[offsets[lengths[symbol]]++] = static_cast<uint16_t>(symbol);
+        }
+    }
+
+    // Canonical codes are assigned in symbol order within each length. The fast table is indexed by the
+    // next FAST_BITS bits of input, which hold the code bit reversed.
+    std::fill(std::begin(fast), std::end(fast), uint16_t{ 0 });
+    uint32_t code = 0;
+    uint32_t index = 0;
+    for (uint32_t len = 1; len <= FAST_BITS; ++len)
+    {
+        for (uint32_t i = 0; i < counts[len]; ++i, ++code)
+        {
+            uint32_t reversed = 0;
+            for (uint32_t bit = 0; bit < len; ++bit)
+            {
+                reversed |= ((code >> bit) & 1) << (len - 1 - bit);
+            }
+            uint16_t entry = static_cast<uint16_t>((len << 12) | symbols[index++]);
+            for (uint32_t slot = reversed; slot < (1u << FAST_BITS); slot += 1u << len)
+            {
+                fast[slot] = entry;
+            }
+        }
+        code <<= 1;
+    }
+    return true;
+}
+
+HRESULT http_inflater::PutByte(uint8_t value) noexcept
+{
+    m_window[m_windowPos++] = value;
+    ++m_decompressedBytes;
+    return m_windowPos == WINDOW_SIZE ? FlushWindow() : S_OK;
+}
+
+HRESULT http_inflater::CopyMatch(uint32_t length, uint32_t distance) noexcept
+{
+    uint32_t from = (m_windowPos + WINDOW_SIZE - distance) & (WINDOW_SIZE - 1);
+    while (length-- > 0)
+    {
+        uint8_t value = m_window[from];
+        from = (from + 1) & (WINDOW_SIZE - 1);
+        RETURN_IF_FAILED(PutByte(value));
+    }
+    return S_OK;
+}
+
+HRESULT http_inflater::FlushWindow() noexcept
+{
+    if (m_windowPos > m_flushPos)
+    {
+        const uint8_t* data = m_window + m_flushPos;
+        size_t size = m_windowPos - m_flushPos;
+        if (m_format == http_compression_format::gzip)
+        {
+            m_crc32 = http_crc32(m_crc32, data, size);
+        }
+        else if (m_zlib)
+        {
+            m_adler32 = http_adler32(m_adler32, data, size);
+        }
+        m_flushPos = m_windowPos;
+        RETURN_IF_FAILED(m_sink(data, size, m_sinkContext));
+    }
+
+    // The window is circular; earlier bytes stay in place as history for later matches
+    if (m_windowPos == WINDOW_SIZE)
+    {
+        m_windowPos = 0;
+        m_flushPos = 0;
+    }
+    return S_OK;
+}
+
+namespace
+{
+
+// zlib's tuning for each level: good length, max lazy, nice length, max chain
+constexpr uint16_t LEVEL_CONFIGS[10][4] = {
+    { 0, 0, 0, 0 },
+    { 4, 4, 8, 4 },
+    { 4, 5, 16, 8 },
+    { 4, 6, 32, 32 },
+    { 4, 4, 16, 16 },
+    { 8, 16, 32, 32 },
+    { 8, 16, 128, 128 },
+    { 8, 32, 128, 256 },
+    { 32, 128, 258, 1024 },
+    { 32, 258, 258, 4096 },
+};
+
+constexpr uint32_t MAX_CODE_LENGTH_LIMIT = 15;
+constexpr uint32_t TOO_FAR = 4096; // a minimum length match this far back usually costs more than its literals
+constexpr uint32_t END_OF_BLOCK = 256;
+constexpr uint32_t CODE_LENGTH_CODES = 19;
+
+struct symbol_code_tables
+{
+    symbol_code_tables() noexcept
+    {
+        for (uint32_t code = 0; code < 29; ++code)
+        {
+            for (uint32_t length = LENGTH_BASE[code]; length < LENGTH_BASE[code] + (1u << LENGTH_EXTRA[code]) && length <= 258; ++length)
+            {
+                lengthCodes[length - 3] = static_cast<uint8_t>(code);
+            }
+        }
+        lengthCodes[258 - 3] = 28;
+
+        for (uint32_t code = 0; code < 30; ++code)
+        {
+            for (uint32_t distance = DISTANCE_BASE[code]; distance < DISTANCE_BASE[code] + (1u << DISTANCE_EXTRA[code]); ++distance)
+            {
+                if (distance <= 256)
+                {
+                    nearDistanceCodes[distance - 1] = static_cast<uint8_t>(code);
+                }
+                else
+                {
+                    farDistanceCodes[(distance - 1) >> 7] = static_cast<uint8_t>(code);
+                }
+            }
+        }
+
+        for (uint32_t symbol = 0; symbol < 288; ++symbol)
+        {
+            fixedLiteralLengths[symbol] = symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+        }
+        for (uint32_t symbol = 0; symbol < 30; ++symbol)
+        {
+            fixedDistanceLengths[symbol] = 5;
+        }
+    }
+
+    uint32_t DistanceCode(uint32_t distance) const noexcept
+    {
+        return distance <= 256 ? nearDistanceCodes[distance - 1] : farDistanceCodes[(distance - 1) >> 7];
+    }
+
+    uint8_t lengthCodes[256];
+    uint8_t nearDistanceCodes[256];
+    uint8_t farDistanceCodes[256];
+    uint8_t fixedLiteralLengths[288];
+    uint8_t fixedDistanceLengths[30];
+};
+
+symbol_code_tables const& SymbolCodes() noexcept
+{
+    static symbol_code_tables const tables;
+    return tables;
+}
+
+// Computes Huffman code lengths no longer than maxBits for the given symbol frequencies. At least two symbols
+// always get a code, since some decoders reject a tree with a single code.
+void BuildCodeLengths(
+    _In_reads_(count) const uint32_t* frequencies,
+    uint32_t count,
+    uint32_t maxBits,
+    _Out_writes_(count) uint8_t* lengths
+) noexcept
+{
+    struct leaf
+    {
+        uint32_t frequency;
+        uint16_t symbol;
+    };
+
+    leaf leaves[288];
+    uint32_t used = 0;
+    for (uint32_t symbol = 0; symbol < count; ++symbol)
+    {
+        lengths[symbol] = 0;
+        if (frequencies[symbol] > 0)
+        {
+            leaves[used++] = leaf{ frequencies[symbol], static_cast<uint16_t>(symbol) };
+        }
+    }
+
+    if (used < 2)
+    {
+        uint32_t first = used == 1 ? leaves[0].symbol : 0;
+        lengths[first] = 1;
+        lengths[first == 0 ? 1 : 0] = 1;
+        return;
+    }
+
+    std::sort(leaves, leaves + used, [](leaf const& a, leaf const& b)
+    {
+        return a.frequency != b.frequency ? a.frequency < b.frequency : a.symbol < b.symbol;
+    });
+
+    // Two queue construction: leaves are already sorted and internal nodes are created in increasing weight
+    // order, so the two lightest nodes are always at the front of one queue or the other
+    uint32_t weights[2 * 288];
+    uint16_t parents[2 * 288];
+    for (uint32_t i = 0; i < used; ++i)
+    {
+        weights[i] = leaves[i].frequency;
+    }
+
+    uint32_t nextLeaf = 0;
+    uint32_t nextInternal = used;
+    for (uint32_t node = used; node < 2 * used - 1; ++node)
+    {
+        uint32_t children[2];
+        for (auto& child : children)
+        {
+            if (nextLeaf < used && (nextInternal >= node || weights[nextLeaf] <= weights[nextInternal]))
+            {
+                child = nextLeaf++;
+            }
+            else
+            {
+                child = nextInternal++;
+            }
+        }
+        weights[node] = weights[children[0]] + weights[children[1]];
+        parents[children[0]] = parents[children[1]] = static_cast<uint16_t>(node);
+    }
+
+    // Depths, reusing weights; the root is the last node created
+    uint32_t const root = 2 * used - 2;
+    weights[root] = 0;
+    for (uint32_t node = root; node-- > 0;)
+    {
+        weights[node] = weights[parents[node]] + 1;
+    }
+
+    uint32_t lengthCounts[MAX_CODE_LENGTH_LIMIT + 1]{};
+    for (uint32_t i = 0; i < used; ++i)
+    {
+        lengthCounts[std::min(weights[i], maxBits)]++;
+    }
+
+    // Clamping made the code over-subscribed; lengthen shorter codes until the Kraft sum is exactly 1 again
+    uint32_t total = 0;
+    for (uint32_t bits = 1; bits <= maxBits; ++bits)
+    {
+        total += lengthCounts[bits] << (maxBits - bits);
+    }
+    while (total != (1u << maxBits))
+    {
+        lengthCounts[maxBits]--;
+        for (uint32_t bits = maxBits - 1; bits > 0; --bits)
+        {
+            if (lengthCounts[bits] > 0)
+            {
+                lengthCounts[bits]--;
+                lengthCounts[bits + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+
+    // The least frequent symbols get the longest codes
+    uint32_t i = 0;
+    for (uint32_t bits = maxBits; bits > 0; --bits)
+    {
+        for (uint32_t n = lengthCounts[bits]; n > 0; --n)
+        {
+            lengths[leaves[i++].symbol] = static_cast<uint8_t>(bits);
+        }
+    }
+}
+
+// Assigns canonical codes for the lengths, bit reversed since deflate writes Huffman codes starting from the MSB
+void BuildCodes(_In_reads_(count) const uint8_t* lengths, uint32_t count, _Out_writes_(count) uint16_t* codes) noexcept
+{
+    uint32_t lengthCounts[MAX_CODE_LENGTH_LIMIT + 1]{};
+    for (uint32_t symbol = 0; symbol < count; ++symbol)
+    {
+        lengthCounts[lengths[symbol]]++;
+    }
+    lengthCounts[0] = 0;
+
+    uint32_t nextCode[MAX_CODE_LENGTH_LIMIT + 1]{};
+    uint32_t code = 0;
+    for (uint32_t bits = 1; bits <= MAX_CODE_LENGTH_LIMIT; ++bits)
+    {
+        code = (code + lengthCounts[bits - 1]) << 1;
+        nextCode[bits] = code;
+    }
+
+    for (uint32_t symbol = 0; symbol < count; ++symbol)
+    {
+        uint32_t length = lengths[symbol];
+        uint32_t reversed = 0;
+        if (length > 0)
+        {
+            uint32_t value = nextCode[length]++;
+            for (uint32_t bit = 0; bit < length; ++bit)
+            {
+                reversed = (reversed << 1) | ((value >> bit) & 1);
+            }
+        }
+        codes[symbol] = static_cast<uint16_t>(reversed);
+    }
+}
+
+}
+
+// std::min takes its arguments by reference, so C++14 needs this defined
+constexpr uint32_t http_deflater::MAX_MATCH;
+
+http_deflater::http_deflater(
+    http_compression_format format,
+    uint32_t level,
+    http_compression_sink sink,
+    _In_opt_ void* sinkContext
+) noexcept :
+    m_format{ format },
+    m_level{ std::min(level, 9u) },
+    m_sink{ sink },
+    m_sinkContext{ sinkContext }
+{
+    m_config = level_config{ LEVEL_CONFIGS[m_level][0], LEVEL_CONFIGS[m_level][1], LEVEL_CONFIGS[m_level][2], LEVEL_CONFIGS[m_level][3] };
+    std::fill(std::begin(m_literalFrequencies), std::end(m_literalFrequencies), 0);
+    std::fill(std::begin(m_distanceFrequencies), std::end(m_distanceFrequencies), 0);
+    std::fill(std::begin(m_head), std::end(m_head), static_cast<uint16_t>(0));
+    std::fill(std::begin(m_prev), std::end(m_prev), static_cast<uint16_t>(0));
+}
+
+HRESULT http_deflater::Write(_In_reads_bytes_(size) const uint8_t* data, _In_ size_t size) noexcept
+{
+    if (m_finished)
+    {
+        return E_UNEXPECTED;
+    }
+
+    while (size > 0 && SUCCEEDED(m_error))
+    {
+        if (m_strStart + m_lookahead == 2 * WINDOW_SIZE)
+        {
+            SlideWindow();
+        }
+
+        uint32_t count = static_cast<uint32_t>(std::min<size_t>(size, 2 * WINDOW_SIZE - (m_strStart + m_lookahead)));
+        std::memcpy(m_window + m_strStart + m_lookahead, data, count);
+        if (m_format == http_compression_format::gzip)
+        {
+            m_crc32 = http_crc32(m_crc32, data, count);
+        }
+        else
+        {
+            m_adler32 = http_adler32(m_adler32, data, count);
+        }
+        m_lookahead += count;
+        m_uncompressedBytes += count;
+        data += count;
+        size -= count;
+
+        RETURN_IF_FAILED(Compress(false));
+    }
+    return m_error;
+}
+
+HRESULT http_deflater::Finish() noexcept
+{
+    if (m_finished)
+    {
+        return m_error;
+    }
+    m_finished = true;
+
+    RETURN_IF_FAILED(Compress(true));
+    EmitBlock(true);
+    AlignToByte();
+
+    if (m_format == http_compression_format::gzip)
+    {
+        for (uint32_t value : { m_crc32, static_cast<uint32_t>(m_uncompressedBytes) })
+        {
+            for (uint32_t shift = 0; shift < 32; shift += 8)
+            {
+                PutByte(static_cast<uint8_t>(value >> shift));
+            }
+        }
+    }
+    else
+    {
+        for (uint32_t shift = 32; shift > 0; shift -= 8)
+        {
+            PutByte(static_cast<uint8_t>(m_adler32 >> (shift - 8)));
+        }
+    }
+
+    FlushOutput();
+    return m_error;
+}
+
+HRESULT http_deflater::Compress(bool flush) noexcept
+{
+    if (!m_headerWritten)
+    {
+        m_headerWritten = true;
+        if (m_format == http_compression_format::gzip)
+        {
+            // No name or modification time; extra flags advertise the fastest and best levels like gzip does
+            uint8_t const extraFlags = m_level == 9 ? 2 : m_level == 1 ? 4 : 0;
+            uint8_t const header[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, extraFlags, 0xFF };
+            for (uint8_t value : header)
+            {
+                PutByte(value);
+            }
+        }
+        else
+        {
+            uint32_t const levelFlags = m_level < 2 ? 0 : m_level < 6 ? 1 : m_level == 6 ? 2 : 3;
+            uint32_t header = (0x78 << 8) | (levelFlags << 6);
+            header += 31 - header % 31;
+            PutByte(static_cast<uint8_t>(header >> 8));
+            PutByte(static_cast<uint8_t>(header));
+        }
+    }
+
+    if (m_level == 0)
+    {
+        m_blockLength += m_lookahead;
+        m_strStart += m_lookahead;
+        m_lookahead = 0;
+    }
+    else if (m_level <= 3)
+    {
+        CompressGreedy(flush);
+    }
+    else
+    {
+        CompressLazy(flush);
+    }
+    return m_error;
+}
+
+void http_deflater::CompressGreedy(bool flush) noexcept
+{
+    while (m_lookahead >= (flush ? 1 : MIN_LOOKAHEAD) && SUCCEEDED(m_error))
+    {
+        uint32_t matchLength = 0;
+        uint32_t matchStart = 0;
+        if (m_lookahead >= MIN_MATCH)
+        {
+            uint32_t candidate = InsertString(m_strStart);
+            if (candidate != 0 && m_strStart - candidate <= MAX_DISTANCE)
+            {
+                matchLength = LongestMatch(candidate, MIN_MATCH - 1, matchStart);
+            }
+        }
+
+        if (matchLength >= MIN_MATCH)
+        {
+            TallyMatch(m_strStart - matchStart, matchLength);
+            m_lookahead -= matchLength;
+
+            // Indexing every position of a long match costs more than it finds at the fast levels
+            if (matchLength <= m_config.maxLazy && m_lookahead >= MIN_MATCH)
+            {
+                for (uint32_t i = 1; i < matchLength; ++i)
+                {
+                    InsertString(m_strStart + i);
+                }
+            }
+            m_strStart += matchLength;
+        }
+        else
+        {
+            TallyLiteral(m_window[m_strStart]);
+            m_lookahead--;
+            m_strStart++;
+        }
+
+        if (SymbolBufferFull())
+        {
+            EmitBlock(false);
+        }
+    }
+}
+
+void http_deflater::CompressLazy(bool flush) noexcept
+{
+    while (m_lookahead >= (flush ? 1 : MIN_LOOKAHEAD) && SUCCEEDED(m_error))
+    {
+        uint32_t candidate = 0;
+        if (m_lookahead >= MIN_MATCH)
+        {
+            candidate = InsertString(m_strStart);
+        }
+
+        // Look for a match here, then only use the match found at the previous position if it was at least as long
+        uint32_t const previousLength = m_matchLength;
+        uint32_t const previousDistance = m_matchDistance;
+        m_matchLength = MIN_MATCH - 1;
+
+        if (candidate != 0 && previousLength < m_config.maxLazy && m_strStart - candidate <= MAX_DISTANCE)
+        {
+            uint32_t matchStart = 0;
+            uint32_t length = LongestMatch(candidate, previousLength, matchStart);
+            if (length > previousLength && !(length == MIN_MATCH && m_strStart - matchStart > TOO_FAR))
+            {
+                m_matchLength = length;
+                m_matchDistance = m_strStart - matchStart;
+            }
+        }
+
+        if (previousLength >= MIN_MATCH && m_matchLength <= previousLength)
+        {
+            // The match started at the previous position, which is strStart - 1
+            uint32_t const maxInsert = m_strStart + m_lookahead - MIN_MATCH;
+            TallyMatch(previousDistance, previousLength);
+
+            m_lookahead -= previousLength - 1;
+            for (uint32_t i = 0; i < previousLength - 2; ++i)
+            {
+                if (++m_strStart <= maxInsert)
+                {
+                    InsertString(m_strStart);
+                }
+            }
+            m_strStart++;
+            m_matchAvailable = false;
+            m_matchLength = MIN_MATCH - 1;
+        }
+        else
+        {
+            if (m_matchAvailable)
+            {
+                TallyLiteral(m_window[m_strStart - 1]);
+            }
+            m_matchAvailable = true;
+            m_strStart++;
+            m_lookahead--;
+        }
+
+        if (SymbolBufferFull())
+        {
+            EmitBlock(false);
+        }
+    }
+
+    if (flush && m_matchAvailable)
+    {
+        TallyLiteral(m_window[m_strStart - 1]);
+        m_matchAvailable = false;
+    }
+}
+
+uint32_t http_deflater::InsertString(uint32_t position) noexcept
+{
+    uint32_t const hash = ((static_cast<uint32_t>(m_window[position]) << 10) ^ (static_cast<uint32_t>(m_window[position + 1]) << 5) ^ m_window[position + 2]) & ((1u << HASH_BITS) - 1);
+    uint32_t const previous = m_head[hash];
+    m_prev[position & (WINDOW_SIZE - 1)] = static_cast<uint16_t>(previous);
+    m_head[hash] = static_cast<uint16_t>(position);
+    return previous;
+}
+
+uint32_t http_deflater::LongestMatch(uint32_t candidate, uint32_t bestLength, _Out_ uint32_t& matchStart) const noexcept
+{
+    matchStart = 0;
+    uint32_t const maxLength = std::min(MAX_MATCH, m_lookahead);
+    if (bestLength >= maxLength)
+    {
+        return bestLength;
+    }
+
+    uint32_t chain = bestLength >= m_config.goodLength ? m_config.maxChain >> 2 : m_config.maxChain;
+    uint32_t const niceLength = std::min<uint32_t>(m_config.niceLength, maxLength);
+    uint32_t const limit = m_strStart > MAX_DISTANCE ? m_strStart - MAX_DISTANCE : 0;
+    uint8_t const* const scan = m_window + m_strStart;
+
+    // Position 0 doubles as the end of every hash chain, so it's never a candidate
+    do
+    {
+        uint8_t const* match = m_window + candidate;
+        if (match[bestLength] == scan[bestLength] && match[0] == scan[0] && match[1] == scan[1])
+        {
+            uint32_t length = 2;
+            while (length < maxLength && match[length] == scan[length])
+            {
+                ++length;
+            }
+
+            if (length > bestLength)
+            {
+                bestLength = length;
+                matchStart = candidate;
+                if (length >= niceLength)
+                {
+                    break;
+                }
+            }
+        }
+        candidate = m_prev[candidate & (WINDOW_SIZE - 1)];
+    } while (candidate > limit && --chain != 0);
+
+    return bestLength;
+}
+
+void http_deflater::SlideWindow() noexcept
+{
+    // Stored blocks copy from the window, so anything not yet written out has to be written before it moves
+    EmitBlock(false);
+
+    std::memcpy(m_window, m_window + WINDOW_SIZE, WINDOW_SIZE);
+    m_strStart -= WINDOW_SIZE;
+    m_blockStart -= WINDOW_SIZE;
+
+    for (auto& position : m_head)
+    {
+        position = static_cast<uint16_t>(position >= WINDOW_SIZE ? position - WINDOW_SIZE : 0);
+    }
+    for (auto& position : m_prev)
+    {
+        position = static_cast<uint16_t>(position >= WINDOW_SIZE ? position - WINDOW_SIZE : 0);
+    }
+}
+
+void http_deflater::TallyLiteral(uint8_t value) noexcept
+{
+    m_symbolValues[m_symbolCount] = value;
+    m_symbolDistances[m_symbolCount] = 0;
+    m_symbolCount++;
+    m_literalFrequencies[value]++;
+    m_blockLength++;
+}
+
+void http_deflater::TallyMatch(uint32_t distance, uint32_t length) noexcept
+{
+    auto const& tables = SymbolCodes();
+    m_symbolValues[m_symbolCount] = static_cast<uint16_t>(length);
+    m_symbolDistances[m_symbolCount] = static_cast<uint16_t>(distance);
+    m_symbolCount++;
+    m_literalFrequencies[257 + tables.lengthCodes[length - MIN_MATCH]]++;
+    m_distanceFrequencies[tables.DistanceCode(distance)]++;
+    m_blockLength += length;
+}
+
+void http_deflater::EmitBlock(bool final) noexcept
+{
+    if (m_symbolCount == 0 && m_blockLength == 0 && !final)
+    {
+        return;
+    }
+
+    if (m_level == 0)
+    {
+        EmitStoredBlocks(final);
+        return;
+    }
+
+    auto const& tables = SymbolCodes();
+    m_literalFrequencies[END_OF_BLOCK] = 1;
+
+    uint8_t literalLengths[LITERAL_CODES];
+    uint8_t distanceLengths[DISTANCE_CODES];
+    BuildCodeLengths(m_literalFrequencies, LITERAL_CODES, MAX_CODE_LENGTH_LIMIT, literalLengths);
+    BuildCodeLengths(m_distanceFrequencies, DISTANCE_CODES, MAX_CODE_LENGTH_LIMIT, distanceLengths);
+
+    uint32_t literalCount = LITERAL_CODES;
+    while (literalCount > 257 && literalLengths[literalCount - 1] == 0)
+    {
+        --literalCount;
+    }
+    uint32_t distanceCount = DISTANCE_CODES;
+    while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0)
+    {
+        --distanceCount;
+    }
+
+    // Run length encode the code lengths of both trees as one sequence using code length symbols 16-18
+    uint8_t allLengths[LITERAL_CODES + DISTANCE_CODES];
+    std::copy(literalLengths, literalLengths + literalCount, allLengths);
+    std::copy(distanceLengths, distanceLengths + distanceCount, allLengths + literalCount);
+    uint32_t const allCount = literalCount + distanceCount;
+
+    uint8_t runSymbols[LITERAL_CODES + DISTANCE_CODES];
+    uint8_t runExtra[LITERAL_CODES + DISTANCE_CODES];
+    uint32_t runCount = 0;
+    uint32_t codeLengthFrequencies[CODE_LENGTH_CODES]{};
+    auto addRun = [&](uint32_t symbol, uint32_t extra)
+    {
+        runSymbols[runCount] = static_cast<uint8_t>(symbol);
+        runExtra[runCount] = static_cast<uint8_t>(extra);
+        runCount++;
+        codeLengthFrequencies[symbol]++;
+    };
+
+    for (uint32_t i = 0; i < allCount;)
+    {
+        uint32_t const length = allLengths[i];
+        uint32_t run = 1;
+        while (i + run < allCount && allLengths[i + run] == length)
+        {
+            ++run;
+        }
+        i += run;
+
+        if (length == 0)
+        {
+            while (run >= 11)
+            {
+                uint32_t count = std::min(run, 138u);
+                addRun(18, count - 11);
+                run -= count;
+            }
+            if (run >= 3)
+            {
+                addRun(17, run - 3);
+                run = 0;
+            }
+        }
+        else
+        {
+            addRun(length, 0);
+            run--;
+            while (run >= 3)
+            {
+                uint32_t count = std::min(run, 6u);
+                addRun(16, count - 3);
+                run -= count;
+            }
+        }
+
+        while (run > 0)
+        {
+            addRun(length, 0);
+            run--;
+        }
+    }
+
+    uint8_t codeLengthLengths[CODE_LENGTH_CODES];
+    BuildCodeLengths(codeLengthFrequencies, CODE_LENGTH_CODES, 7, codeLengthLengths);
+    uint32_t codeLengthCount = CODE_LENGTH_CODES;
+    while (codeLengthCount > 4 && codeLengthLengths[CODE_LENGTH_ORDER[codeLengthCount - 1]] == 0)
+    {
+        --codeLengthCount;
+    }
+
+    // Pick whichever of dynamic, fixed or stored encoding is smallest for this block
+    uint64_t dynamicBits = 3 + 5 + 5 + 4 + 3 * codeLengthCount;
+    for (uint32_t i = 0; i < runCount; ++i)
+    {
+        uint32_t symbol = runSymbols[i];
+        dynamicBits += codeLengthLengths[symbol] + (symbol == 16 ? 2 : symbol == 17 ? 3 : symbol == 18 ? 7 : 0);
+    }
+    uint64_t fixedBits = 3;
+    for (uint32_t symbol = 0; symbol < LITERAL_CODES; ++symbol)
+    {
+        uint32_t extra = symbol > 256 ? LENGTH_EXTRA[symbol - 257] : 0;
+        dynamicBits += static_cast<uint64_t>(m_literalFrequencies[symbol]) * (literalLengths[symbol] + extra);
+        fixedBits += static_cast<uint64_t>(m_literalFrequencies[symbol]) * (tables.fixedLiteralLengths[symbol] + extra);
+    }
+    for (uint32_t symbol = 0; symbol < DISTANCE_CODES; ++symbol)
+    {
+        dynamicBits += static_cast<uint64_t>(m_distanceFrequencies[symbol]) * (distanceLengths[symbol] + DISTANCE_EXTRA[symbol]);
+        fixedBits += static_cast<uint64_t>(m_distanceFrequencies[symbol]) * (5 + DISTANCE_EXTRA[symbol]);
+    }
+    uint64_t const storedBits = (m_bitCount + 3 + 7) / 8 * 8 + 32 + 8ull * m_blockLength + (m_blockLength / 65535) * 40;
+
+    if (storedBits <= fixedBits && storedBits <= dynamicBits)
+    {
+        EmitStoredBlocks(final);
+        return;
+    }
+
+    if (fixedBits <= dynamicBits)
+    {
+        uint16_t literalCodes[288];
+        uint16_t distanceCodes[DISTANCE_CODES];
+        BuildCodes(tables.fixedLiteralLengths, 288, literalCodes);
+        BuildCodes(tables.fixedDistanceLengths, DISTANCE_CODES, distanceCodes);
+        PutBits(final ? 1 : 0, 1);
+        PutBits(1, 2);
+        EmitSymbols(tables.fixedLiteralLengths, literalCodes, tables.fixedDistanceLengths, distanceCodes);
+    }
+    else
+    {
+        uint16_t literalCodes[LITERAL_CODES];
+        uint16_t distanceCodes[DISTANCE_CODES];
+        uint16_t codeLengthCodes[CODE_LENGTH_CODES];
+        BuildCodes(literalLengths, LITERAL_CODES, literalCodes);
+        BuildCodes(distanceLengths, DISTANCE_CODES, distanceCodes);
+        BuildCodes(codeLengthLengths, CODE_LENGTH_CODES, codeLengthCodes);
+
+        PutBits(final ? 1 : 0, 1);
+        PutBits(2, 2);
+        PutBits(literalCount - 257, 5);
+        PutBits(distanceCount - 1, 5);
+        PutBits(codeLengthCount - 4, 4);
+        for (uint32_t i = 0; i < codeLengthCount; ++i)
+        {
+            PutBits(codeLengthLengths[CODE_LENGTH_ORDER[i]], 3);
+        }
+        for (uint32_t i = 0; i < runCount; ++i)
+        {
+            uint32_t symbol = runSymbols[i];
+            PutBits(codeLengthCodes[symbol], codeLengthLengths[symbol]);
+            if (symbol >= 16)
+            {
+                PutBits(runExtra[i], symbol == 16 ? 2 : symbol == 17 ? 3 : 7);
+            }
+        }
+        EmitSymbols(literalLengths, literalCodes, distanceLengths, distanceCodes);
+    }
+
+    m_blockStart += m_blockLength;
+    m_blockLength = 0;
+    m_symbolCount = 0;
+    std::fill(std::begin(m_literalFrequencies), std::end(m_literalFrequencies), 0);
+    std::fill(std::begin(m_distanceFrequencies), std::end(m_distanceFrequencies), 0);
+}
+
+void http_deflater::EmitStoredBlocks(bool final) noexcept
+{
+    // A stored block holds at most 65535 bytes, and a final block is needed even if there's nothing left
+    uint32_t remaining = m_blockLength;
+    uint8_t const* data = m_window + m_blockStart;
+    do
+    {
+        uint32_t const count = std::min(remaining, 65535u);
+        remaining -= count;
+
+        PutBits(final && remaining == 0 ? 1 : 0, 1);
+        PutBits(0, 2);
+        AlignToByte();
+        PutBits(count, 16);
+        PutBits(~count & 0xFFFF, 16);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            PutByte(data[i]);
+        }
+        data += count;
+    } while (remaining > 0);
+
+    m_blockStart += m_blockLength;
+    m_blockLength = 0;
+    m_symbolCount = 0;
+    std::fill(std::begin(m_literalFrequencies), std::end(m_literalFrequencies), 0);
+    std::fill(std::begin(m_distanceFrequencies), std::end(m_distanceFrequencies), 0);
+}
+
+void http_deflater::EmitSymbols(
+    _In_reads_(LITERAL_CODES) const uint8_t* literalLengths,
+    _In_reads_(LITERAL_CODES) const uint16_t* literalCodes,
+    _In_reads_(DISTANCE_CODES) const uint8_t* distanceLengths,
+    _In_reads_(DISTANCE_CODES) const uint16_t* distanceCodes
+) noexcept
+{
+    auto const& tables = SymbolCodes();
+    for (uint32_t i = 0; i < m_symbolCount; ++i)
+    {
+        uint32_t const value = m_symbolValues[i];
+        uint32_t const distance = m_symbolDistances[i];
+        if (distance == 0)
+        {
+            PutBits(literalCodes[value], literalLengths[value]);
+            continue;
+        }
+
+        uint32_t const lengthCode = tables.lengthCodes[value - MIN_MATCH];
+        PutBits(literalCodes[257 + lengthCode], literalLengths[257 + lengthCode]);
+        PutBits(value - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode]);
+
+        uint32_t const distanceCode = tables.DistanceCode(distance);
+        PutBits(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+        PutBits(distance - DISTANCE_BASE[distanceCode], DISTANCE_EXTRA[distanceCode]);
+    }
+    PutBits(literalCodes[END_OF_BLOCK], literalLengths[END_OF_BLOCK]);
+}
+
+void http_deflater::PutBits(uint32_t value, uint32_t count) noexcept
+{
+    m_bits |= static_cast<uint64_t>(value) << m_bitCount;
+    m_bitCount += count;
+    while (m_bitCount >= 8)
+    {
+        m_output[m_outputCount++] = static_cast<uint8_t>(m_bits);
+        m_bits >>= 8;
+        m_bitCount -= 8;
+        if (m_outputCount == OUTPUT_BUFFER_SIZE)
+        {
+            FlushOutput();
+        }
+    }
+}
+
+void http_deflater::AlignToByte() noexcept
+{
+    if (m_bitCount % 8 != 0)
+    {
+        PutBits(0, 8 - m_bitCount % 8);
+    }
+}
+
+void http_deflater::PutByte(uint8_t value) noexcept
+{
+    PutBits(value, 8);
+}
+
+void http_deflater::FlushOutput() noexcept
+{
+    if (m_outputCount > 0 && SUCCEEDED(m_error))
+    {
+        m_error = m_sink(m_output, m_outputCount, m_sinkContext);
+        m_compressedBytes += m_outputCount;
+    }
+    m_outputCount = 0;
+}
+
+HRESULT http_response_decompressor::Attach(_In_ HCCallHandle call) noexcept
+try
+{
+    if (!call->decompressResponse)
+    {
+        return S_OK;
+    }
+
+    auto decompressor = http_allocate_shared<http_response_decompressor>(call, call->responseBodyWriteFunction, call->responseBodyWriteFunctionContext);
+
+    // A caller that set Accept-Encoding keeps it; otherwise it's advertised for this attempt only
+    if (call->requestHeaders.get().find(ACCEPT_ENCODING_HEADER) == call->requestHeaders.get().end())
+    {
+        if (call->requestHeaders.is_shared())
+        {
+            decompressor->m_sharedHeaders = call->requestHeaders.freeze();
+        }
+        call->requestHeaders.mutate()[ACCEPT_ENCODING_HEADER] = "gzip, deflate";
+        decompressor->m_addedAcceptEncoding = true;
+    }
+
+    call->responseDecompressor = std::move(decompressor);
+    call->responseBodyWriteFunction = WriteFunction;
+    call->responseBodyWriteFunctionContext = call->responseDecompressor.get();
+    return S_OK;
+}
+CATCH_RETURN()
+
+void http_response_decompressor::Detach(_In_ HCCallHandle call) noexcept
+{
+    auto decompressor = std::move(call->responseDecompressor);
+    if (!decompressor)
+    {
+        return;
+    }
+
+    call->responseBodyWriteFunction = decompressor->m_writeFunction;
+    call->responseBodyWriteFunctionContext = decompressor->m_writeContext;
+
+    if (decompressor->m_addedAcceptEncoding)
+    {
+        call->requestHeaders.mutate().erase(ACCEPT_ENCODING_HEADER);
+        ReshareRequestHeaders(call, decompressor->m_sharedHeaders);
+    }
+
+    // A provider that sets the status only once the body is done still has its body decoded
+    HRESULT hr = decompressor->m_error;
+    if (SUCCEEDED(hr) && !decompressor->m_started && !decompressor->m_heldBody.empty())
+    {
+        hr = decompressor->Start();
+        if (SUCCEEDED(hr))
+        {
+            hr = decompressor->Decode(decompressor->m_heldBody.data(), decompressor->m_heldBody.size());
+        }
+    }
+
+    // A response without a body (e.g. HEAD or 304) never reaches the write function and has nothing to decode
+    if (SUCCEEDED(hr) && decompressor->m_inflater && call->networkErrorCode == S_OK)
+    {
+        hr = decompressor->m_inflater->Finish();
+    }
+
+    if (FAILED(hr) && call->networkErrorCode == S_OK)
+    {
+        if (call->traceCall) { HC_TRACE_ERROR(HTTPCLIENT, "HCHttpCallPerform [ID %llu]: failed to decompress the response body: %08X", TO_ULL(call->id), hr); }
+        call->networkErrorCode = hr;
+    }
+
+    if (decompressor->m_inflater)
+    {
+        call->responseCompressedBytes = decompressor->m_inflater->CompressedBytes();
+        call->responseDecompressedBytes = decompressor->m_inflater->DecompressedBytes();
+
+        // The body the caller sees is no longer encoded, so these would describe the wrong thing
+        auto& headers = call->responseHeaders.mutate();
+        headers.erase(CONTENT_ENCODING_HEADER);
+        headers.erase(CONTENT_LENGTH_HEADER);
+    }
+    else
+    {
+        call->responseCompressedBytes = decompressor->m_bytesReceived;
+        call->responseDecompressedBytes = decompressor->m_bytesReceived;
+    }
+}
+
+http_response_decompressor::http_response_decompressor(HCCallHandle call, HCHttpCallResponseBodyWriteFunction writeFunction, _In_opt_ void* writeContext) noexcept :
+    m_call{ call },
+    m_writeFunction{ writeFunction },
+    m_writeContext{ writeContext }
+{
+}
+
+HRESULT CALLBACK http_response_decompressor::WriteFunction(
+    _In_ HCCallHandle call,
+    _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context
+) noexcept
+{
+    auto decompressor = static_cast<http_response_decompressor*>(context);
+    if (FAILED(decompressor->m_error))
+    {
+        return decompressor->m_error;
+    }
+
+    if (!decompressor->m_started)
+    {
+        // Until there's a status the headers saying how the body is encoded may not all be there
+        if (call->statusCode == 0)
+        {
+            try
+            {
+                decompressor->m_heldBody.insert(decompressor->m_heldBody.end(), source, source + bytesAvailable);
+            }
+            catch (...)
+            {
+                decompressor->m_error = E_OUTOFMEMORY;
+            }
+            return decompressor->m_error;
+        }
+
+        decompressor->m_error = decompressor->Start();
+        RETURN_IF_FAILED(decompressor->m_error);
+        if (!decompressor->m_heldBody.empty())
+        {
+            http_body_bytes held{ std::move(decompressor->m_heldBody) };
+            decompressor->m_heldBody.clear();
+            RETURN_IF_FAILED(decompressor->Decode(held.data(), held.size()));
+        }
+    }
+
+    return decompressor->Decode(source, bytesAvailable);
+}
+
+HRESULT http_response_decompressor::Decode(_In_reads_bytes_(size) const uint8_t* source, _In_ size_t size) noexcept
+{
+    m_bytesReceived += size;
+    if (m_inflater)
+    {
+        m_error = m_inflater->Write(source, size);
+    }
+    else
+    {
+        m_error = Forward(source, size, this);
+    }
+    return m_error;
+}
+
+HRESULT http_response_decompressor::Forward(_In_reads_bytes_(size) const uint8_t* data, _In_ size_t size, _In_opt_ void* context) noexcept
+try
+{
+    auto decompressor = static_cast<http_response_decompressor*>(context);
+    if (decompressor->m_writeFunction != DefaultResponseBodyWriteFunction)
+    {
+        return decompressor->m_writeFunction(decompressor->m_call, data, size, decompressor->m_writeContext);
+    }
+
+    // HCHttpCallResponseAppendResponseBodyBytes refuses to append while a custom write function is installed
+    auto& responseBody = decompressor->m_call->responseBodyBytes.mutate();
+    responseBody.insert(responseBody.end(), data, data + size);
+    decompressor->m_call->responseString.clear();
+    return S_OK;
+}
+CATCH_RETURN()
+
+HRESULT http_response_decompressor::Start() noexcept
+try
+{
+    m_started = true;
+
+    // Called once the status is known, and providers set the headers before it
+    auto const& headers = m_call->responseHeaders.get();
+    auto it = headers.find(CONTENT_ENCODING_HEADER);
+    if (it == headers.end())
+    {
+        return S_OK;
+    }
+
+    http_internal_string encoding{ it->second.data(), it->second.size() };
+    encoding.erase(0, encoding.find_first_not_of(" \t"));
+    encoding.erase(encoding.find_last_not_of(" \t") + 1);
+    std::transform(encoding.begin(), encoding.end(), encoding.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+
+    if (encoding == "gzip" || encoding == "x-gzip")
+    {
+        m_inflater = http_allocate_unique<http_inflater>(http_compression_format::gzip, Forward, this);
+    }
+    else if (encoding == "deflate")
+    {
+        m_inflater = http_allocate_unique<http_inflater>(http_compression_format::deflate, Forward, this);
+    }
+    else if (!encoding.empty() && encoding != "identity")
+    {
+        // Encodings we didn't ask for (e.g. br) reach the caller untouched along with their header
+        if (m_call->traceCall) { HC_TRACE_WARNING(HTTPCLIENT, "HCHttpCallPerform [ID %llu]: unsupported Content-Encoding %s, passing the body through", TO_ULL(m_call->id), encoding.c_str()); }
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+HRESULT http_request_compressor::Attach(_In_ HCCallHandle call) noexcept
+try
+{
+    if (call->compressionLevel == HCCompressionLevel::None || call->requestBodySize == 0)
+    {
+        return S_OK;
+    }
+
+    if (call->requestHeaders.get().find(CONTENT_ENCODING_HEADER) != call->requestHeaders.get().end())
+    {
+        // The caller encoded the body itself
+        return S_OK;
+    }
+
+    auto compressor = http_allocate_shared<http_request_compressor>(call, call->requestBodyReadFunction, call->requestBodySize, call->requestBodyReadFunctionContext);
+    RETURN_IF_FAILED(compressor->Restart());
+
+    if (call->requestHeaders.is_shared())
+    {
+        compressor->m_sharedHeaders = call->requestHeaders.freeze();
+    }
+    auto& headers = call->requestHeaders.mutate();
+    headers[CONTENT_ENCODING_HEADER] = "gzip";
+    auto contentLength = headers.find(CONTENT_LENGTH_HEADER);
+    if (contentLength != headers.end())
+    {
+        compressor->m_hadContentLength = true;
+        compressor->m_contentLength = contentLength->second.c_str();
+        headers.erase(contentLength);
+    }
+
+    call->requestCompressor = std::move(compressor);
+    call->requestBodyReadFunction = ReadFunction;
+    call->requestBodyReadFunctionContext = call->requestCompressor.get();
+    call->requestBodySize = HC_UNKNOWN_REQUEST_BODY_SIZE;
+    return S_OK;
+}
+CATCH_RETURN()
+
+void http_request_compressor::Detach(_In_ HCCallHandle call) noexcept
+{
+    auto compressor = std::move(call->requestCompressor);
+    if (!compressor)
+    {
+        return;
+    }
+
+    call->requestBodyReadFunction = compressor->m_readFunction;
+    call->requestBodyReadFunctionContext = compressor->m_readContext;
+    call->requestBodySize = compressor->m_bodySize;
+
+    auto& headers = call->requestHeaders.mutate();
+    headers.erase(CONTENT_ENCODING_HEADER);
+    if (compressor->m_hadContentLength)
+    {
+        headers[CONTENT_LENGTH_HEADER] = compressor->m_contentLength.c_str();
+    }
+    ReshareRequestHeaders(call, compressor->m_sharedHeaders);
+
+    if (call->traceCall && compressor->m_finished)
+    {
+        HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallPerform [ID %llu]: compressed request body %llu -> %llu bytes",
+            TO_ULL(call->id), TO_ULL(compressor->m_deflater->UncompressedBytes()), TO_ULL(compressor->m_deflater->CompressedBytes()));
+    }
+}
+
+// Also taken by reference by std::min
+constexpr size_t http_request_compressor::SOURCE_CHUNK_SIZE;
+
+http_request_compressor::http_request_compressor(
+    HCCallHandle call,
+    HCHttpCallRequestBodyReadFunction readFunction,
+    size_t bodySize,
+    _In_opt_ void* readContext
+) noexcept :
+    m_call{ call },
+    m_readFunction{ readFunction },
+    m_bodySize{ bodySize },
+    m_readContext{ readContext }
+{
+}
+
+HRESULT CALLBACK http_request_compressor::ReadFunction(
+    _In_ HCCallHandle call,
+    _In_ size_t offset,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context,
+    _Out_writes_bytes_to_(bytesAvailable, *bytesWritten) uint8_t* destination,
+    _Out_ size_t* bytesWritten
+) noexcept
+{
+    UNREFERENCED_PARAMETER(call);
+    if (context == nullptr || destination == nullptr || bytesWritten == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    *bytesWritten = 0;
+
+    auto compressor = static_cast<http_request_compressor*>(context);
+    if (offset != compressor->m_bytesDelivered)
+    {
+        // Providers read sequentially, but may start over from the beginning to resend the body
+        if (offset != 0)
+        {
+            return E_INVALIDARG;
+        }
+        RETURN_IF_FAILED(compressor->Restart());
+    }
+
+    while (compressor->m_pending.size() - compressor->m_pendingOffset < bytesAvailable && !compressor->m_finished)
+    {
+        HRESULT hr = compressor->CompressNextChunk();
+        if (hr == E_PENDING && compressor->m_pending.size() > compressor->m_pendingOffset)
+        {
+            // Compressed bytes already in hand go out now, and the next read asks the paused body again
+            break;
+        }
+        RETURN_IF_FAILED(hr);
+    }
+
+    size_t const count = std::min(bytesAvailable, compressor->m_pending.size() - compressor->m_pendingOffset);
+    if (count > 0)
+    {
+        std::memcpy(destination, compressor->m_pending.data() + compressor->m_pendingOffset, count);
+    }
+    compressor->m_pendingOffset += count;
+    compressor->m_bytesDelivered += count;
+
+    if (compressor->m_pendingOffset == compressor->m_pending.size())
+    {
+        compressor->m_pending.clear();
+        compressor->m_pendingOffset = 0;
+    }
+
+    *bytesWritten = count;
+    return S_OK;
+}
+
+HRESULT http_request_compressor::Append(_In_reads_bytes_(size) const uint8_t* data, _In_ size_t size, _In_opt_ void* context) noexcept
+try
+{
+    auto compressor = static_cast<http_request_compressor*>(context);
+    compressor->m_pending.insert(compressor->m_pending.end(), data, data + size);
+    return S_OK;
+}
+CATCH_RETURN()
+
+HRESULT http_request_compressor::Restart() noexcept
+try
+{
+    uint32_t const level = static_cast<uint32_t>(m_call->compressionLevel);
+    m_deflater = http_allocate_unique<http_deflater>(http_compression_format::gzip, level, Append, this);
+    m_sourceOffset = 0;
+    m_bytesDelivered = 0;
+    m_finished = false;
+    m_pending.clear();
+    m_pendingOffset = 0;
+    return S_OK;
+}
+CATCH_RETURN()
+
+HRESULT http_request_compressor::CompressNextChunk() noexcept
+try
+{
+    if (m_sourceOffset == m_bodySize)
+    {
+        m_finished = true;
+        return m_deflater->Finish();
+    }
+
+    size_t const count = std::min(SOURCE_CHUNK_SIZE, m_bodySize - m_sourceOffset);
+    if (m_readFunction == DefaultRequestBodyReadFunction)
+    {
+        // The body is already in memory, so compress it in place rather than copying it out first
+        RETURN_IF_FAILED(m_deflater->Write(m_call->requestBodyBytes.data() + m_sourceOffset, count));
+        m_sourceOffset += count;
+        return S_OK;
+    }
+
+    m_sourceBuffer.resize(SOURCE_CHUNK_SIZE);
+    size_t bytesRead = 0;
+    RETURN_IF_FAILED(m_readFunction(m_call, m_sourceOffset, count, m_readContext, m_sourceBuffer.data(), &bytesRead));
+    if (bytesRead == 0 && m_bodySize == HC_UNKNOWN_REQUEST_BODY_SIZE)
+    {
+        // A body of unknown size ends when the read function has nothing more
+        m_finished = true;
+        return m_deflater->Finish();
+    }
+    if (bytesRead == 0 || bytesRead > count)
+    {
+        // The read function ran out before the body size it was registered with
+        return E_FAIL;
+    }
+
+    RETURN_IF_FAILED(m_deflater->Write(m_sourceBuffer.data(), bytesRead));
+    m_sourceOffset += bytesRead;
+    return S_OK;
+}
+CATCH_RETURN()
+
+uint32_t http_crc32(uint32_t crc, _In_reads_bytes_(size) const uint8_t* data, size_t size) noexcept
+{
+    struct crc_table
+    {
+        crc_table() noexcept
+        {
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t c = n;
+                for (uint32_t k = 0; k < 8; ++k)
+                {
+                    c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+                }
+                entries[n] = c;
+            }
+        }
+        uint32_t entries[256];
+    };
+    static const crc_table table;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t http_adler32(uint32_t adler, _In_reads_bytes_(size) const uint8_t* data, size_t size) noexcept
+{
+    constexpr uint32_t ADLER_MOD = 65521;
+    constexpr size_t ADLER_BLOCK = 5552; // the most bytes that can be summed before the sums could overflow
+
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (size > 0)
+    {
+        size_t block = std::min(size, ADLER_BLOCK);
+        size -= block;
+        for (size_t i = 0; i < block; ++i)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= ADLER_MOD;
+        b %= ADLER_MOD;
+    }
+    return (b << 16) | a;
+}
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
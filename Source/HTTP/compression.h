@@ -0,0 +1,331 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+#include "pch.h"
+#include "httpcall.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+enum class http_compression_format
+{
+    gzip,       // RFC 1952
+    zlib,       // RFC 1950
+    deflate     // Content-Encoding: deflate, which is zlib framed but sometimes sent as raw RFC 1951 data
+};
+
+// Receives decoded or encoded bytes as they become available
+typedef HRESULT(*http_compression_sink)(_In_reads_bytes_(size) const uint8_t* data, _In_ size_t size, _In_opt_ void* context);
+
+// Streaming decoder for deflate data. Input can be split at any byte, and working memory is bounded by the
+// 32KB history window plus the Huffman tables regardless of how large the stream is.
+class http_inflater
+{
+public:
+    http_inflater(http_compression_format format, http_compression_sink sink, _In_opt_ void* sinkContext) noexcept;
+
+    http_inflater(const http_inflater&) = delete;
+    http_inflater& operator=(const http_inflater&) = delete;
+
+    // Decodes the next chunk of compressed input. Fails with E_HC_COMPRESSED_DATA_INVALID if the stream is
+    // corrupt, or with the sink's error if it fails.
+    HRESULT Write(_In_reads_bytes_(size) const uint8_t* data, _In_ size_t size) noexcept;
+
+    // Fails if the stream ended before its final block and trailer
+    HRESULT Finish() noexcept;
+
+    uint64_t CompressedBytes() const noexcept { return m_compressedBytes; }
+    uint64_t DecompressedBytes() const noexcept { return m_decompressedBytes; }
+
+private:
+    static constexpr uint32_t WINDOW_SIZE = 32768;
+    static constexpr uint32_t FAST_BITS = 9;
+    static constexpr uint32_t MAX_CODE_BITS = 15;
+
+    struct huffman_table
+    {
+        uint16_t counts[MAX_CODE_BITS + 1];
+        uint16_t symbols[288];
+        uint16_t fast[1 << FAST_BITS]; // [code length:4][symbol:12] for codes up to FAST_BITS long, 0 otherwise
+
+        bool Build(_In_reads_(count) const uint8_t* lengths, uint32_t count) noexcept;
+    };
+
+    enum class decode_result
+    {
+        ok,
+        need_input,
+        invalid
+    };
+
+    enum class state
+    {
+        detect_deflate,
+        gzip_header,
+        gzip_header_tail,
+        gzip_extra_length,
+        gzip_extra,
+        gzip_name,
+        gzip_comment,
+        gzip_header_crc,
+        zlib_header,
+        block_header,
+        stored_header,
+        stored_copy,
+        dynamic_counts,
+        code_length_lengths,
+        code_lengths,
+        literal_length,
+        length_extra,
+        distance,
+        distance_extra,
+        trailer,
+        done,
+        failed
+    };
+
+    HRESULT Run() noexcept;
+
+    void Fill() noexcept;
+    bool NeedBits(uint32_t count) noexcept;
+    uint32_t GetBits(uint32_t count) noexcept;
+    decode_result Decode(huffman_table const& table, _Out_ uint32_t& symbol) noexcept;
+
+    HRESULT PutByte(uint8_t value) noexcept;
+    HRESULT CopyMatch(uint32_t length, uint32_t distance) noexcept;
+    HRESULT FlushWindow() noexcept;
+
+    http_compression_format const m_format;
+    http_compression_sink const m_sink;
+    void* const m_sinkContext;
+
+    state m_state;
+    HRESULT m_error{ S_OK };
+    bool m_zlib{ false };
+    bool m_finalBlock{ false };
+
+    const uint8_t* m_in{ nullptr };
+    const uint8_t* m_inEnd{ nullptr };
+    uint64_t m_bits{ 0 };
+    uint32_t m_bitCount{ 0 };
+
+    // Header, block & match state that has to survive running out of input
+    uint32_t m_gzipFlags{ 0 };
+    uint32_t m_remaining{ 0 };
+    uint32_t m_literalCount{ 0 };
+    uint32_t m_distanceCount{ 0 };
+    uint32_t m_codeLengthCount{ 0 };
+    uint32_t m_lengthIndex{ 0 };
+    uint32_t m_matchLength{ 0 };
+    uint32_t m_symbol{ 0 };
+    uint8_t m_lengths[288 + 32];
+
+    huffman_table m_literalTable;
+    huffman_table m_distanceTable;
+
+    uint8_t m_window[WINDOW_SIZE];
+    uint32_t m_windowPos{ 0 };
+    uint32_t m_flushPos{ 0 };
+
+    uint32_t m_crc32{ 0 };
+    uint32_t m_adler32{ 1 };
+    uint64_t m_compressedBytes{ 0 };
+    uint64_t m_decompressedBytes{ 0 };
+};
+
+// Streaming deflate encoder producing gzip or zlib framed output. Levels follow zlib: 0 stores the data
+// uncompressed, 1-3 take the first match found, 4-9 search longer hash chains and defer matches lazily.
+// Working memory is fixed at roughly 256KB regardless of how much data is written.
+class http_deflater
+{
+public:
+    http_deflater(http_compression_format format, uint32_t level, http_compression_sink sink, _In_opt_ void* sinkContext) noexcept;
+
+    http_deflater(const http_deflater&) = delete;
+    http_deflater& operator=(const http_deflater&) = delete;
+
+    // Compresses the next chunk of input. Output is passed to the sink as blocks complete, so it lags the input.
+    HRESULT Write(_In_reads_bytes_(size) const uint8_t* data, _In_ size_t size) noexcept;
+
+    // Compresses any remaining input and writes the final block and trailer
+    HRESULT Finish() noexcept;
+
+    uint64_t UncompressedBytes() const noexcept { return m_uncompressedBytes; }
+    uint64_t CompressedBytes() const noexcept { return m_compressedBytes; }
+
+private:
+    static constexpr uint32_t WINDOW_SIZE = 32768;
+    static constexpr uint32_t MIN_MATCH = 3;
+    static constexpr uint32_t MAX_MATCH = 258;
+    static constexpr uint32_t MIN_LOOKAHEAD = MAX_MATCH + MIN_MATCH + 1;
+    static constexpr uint32_t MAX_DISTANCE = WINDOW_SIZE - MIN_LOOKAHEAD;
+    static constexpr uint32_t HASH_BITS = 15;
+    static constexpr uint32_t SYMBOL_BUFFER_SIZE = 16384;
+    static constexpr uint32_t OUTPUT_BUFFER_SIZE = 16384;
+    static constexpr uint32_t LITERAL_CODES = 286;
+    static constexpr uint32_t DISTANCE_CODES = 30;
+
+    struct level_config
+    {
+        uint16_t goodLength;    // reduce the search once a match this long is found
+        uint16_t maxLazy;       // don't look for a better match once one this long is found (max insert length when greedy)
+        uint16_t niceLength;    // stop searching once a match this long is found
+        uint16_t maxChain;
+    };
+
+    HRESULT Compress(bool flush) noexcept;
+    void CompressGreedy(bool flush) noexcept;
+    void CompressLazy(bool flush) noexcept;
+    uint32_t InsertString(uint32_t position) noexcept;
+    uint32_t LongestMatch(uint32_t candidate, uint32_t bestLength, _Out_ uint32_t& matchStart) const noexcept;
+    void SlideWindow() noexcept;
+
+    void TallyLiteral(uint8_t value) noexcept;
+    void TallyMatch(uint32_t distance, uint32_t length) noexcept;
+    bool SymbolBufferFull() const noexcept { return m_symbolCount == SYMBOL_BUFFER_SIZE; }
+
+    void EmitBlock(bool final) noexcept;
+    void EmitStoredBlocks(bool final) noexcept;
+    void EmitSymbols(_In_reads_(LITERAL_CODES) const uint8_t* literalLengths, _In_reads_(LITERAL_CODES) const uint16_t* literalCodes,
+        _In_reads_(DISTANCE_CODES) const uint8_t* distanceLengths, _In_reads_(DISTANCE_CODES) const uint16_t* distanceCodes) noexcept;
+
+    void PutBits(uint32_t value, uint32_t count) noexcept;
+    void AlignToByte() noexcept;
+    void PutByte(uint8_t value) noexcept;
+    void FlushOutput() noexcept;
+
+    http_compression_format const m_format;
+    uint32_t const m_level;
+    level_config m_config;
+    http_compression_sink const m_sink;
+    void* const m_sinkContext;
+
+    HRESULT m_error{ S_OK };
+    bool m_headerWritten{ false };
+    bool m_finished{ false };
+
+    uint32_t m_strStart{ 0 };
+    uint32_t m_lookahead{ 0 };
+    uint32_t m_blockStart{ 0 };
+    uint32_t m_blockLength{ 0 };
+    uint32_t m_matchLength{ MIN_MATCH - 1 };
+    uint32_t m_matchDistance{ 0 };
+    bool m_matchAvailable{ false };
+
+    uint32_t m_symbolCount{ 0 };
+    uint16_t m_symbolValues[SYMBOL_BUFFER_SIZE];     // literal byte or match length
+    uint16_t m_symbolDistances[SYMBOL_BUFFER_SIZE];  // 0 for literals
+    uint32_t m_literalFrequencies[LITERAL_CODES];
+    uint32_t m_distanceFrequencies[DISTANCE_CODES];
+
+    uint64_t m_bits{ 0 };
+    uint32_t m_bitCount{ 0 };
+    uint32_t m_outputCount{ 0 };
+    uint8_t m_output[OUTPUT_BUFFER_SIZE];
+
+    uint32_t m_crc32{ 0 };
+    uint32_t m_adler32{ 1 };
+    uint64_t m_uncompressedBytes{ 0 };
+    uint64_t m_compressedBytes{ 0 };
+
+    uint8_t m_window[2 * WINDOW_SIZE];
+    uint16_t m_head[1 << HASH_BITS];
+    uint16_t m_prev[WINDOW_SIZE];
+};
+
+// Installed as a call's response body write function for each attempt while response decompression is enabled.
+// Decodes the body according to the response's Content-Encoding and passes it on to the write function it replaced.
+class http_response_decompressor
+{
+public:
+    static HRESULT Attach(_In_ HCCallHandle call) noexcept;
+
+    // Restores the call's write function once the attempt completes, failing the call if the body was truncated
+    static void Detach(_In_ HCCallHandle call) noexcept;
+
+    http_response_decompressor(HCCallHandle call, HCHttpCallResponseBodyWriteFunction writeFunction, _In_opt_ void* writeContext) noexcept;
+
+private:
+    static HRESULT CALLBACK WriteFunction(
+        _In_ HCCallHandle call,
+        _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+        _In_ size_t bytesAvailable,
+        _In_opt_ void* context
+    ) noexcept;
+
+    static HRESULT Forward(_In_reads_bytes_(size) const uint8_t* data, _In_ size_t size, _In_opt_ void* context) noexcept;
+
+    HRESULT Start() noexcept;
+    HRESULT Decode(_In_reads_bytes_(size) const uint8_t* source, _In_ size_t size) noexcept;
+
+    HCCallHandle const m_call;
+    HCHttpCallResponseBodyWriteFunction const m_writeFunction;
+    void* const m_writeContext;
+
+    bool m_started{ false };
+    HRESULT m_error{ S_OK };
+    HC_UNIQUE_PTR<http_inflater> m_inflater;
+    uint64_t m_bytesReceived{ 0 };
+    http_body_bytes m_heldBody;
+
+    // Accept-Encoding is only added for the attempt, to the headers that were shared before it was
+    bool m_addedAcceptEncoding{ false };
+    std::shared_ptr<http_header_map const> m_sharedHeaders;
+};
+
+// Installed as a call's request body read function for each attempt while request compression is enabled.
+// Compresses the original body as the provider reads it, so the compressed size isn't known up front and
+// providers send it with chunked transfer encoding.
+class http_request_compressor
+{
+public:
+    static HRESULT Attach(_In_ HCCallHandle call) noexcept;
+    static void Detach(_In_ HCCallHandle call) noexcept;
+
+    http_request_compressor(
+        HCCallHandle call,
+        HCHttpCallRequestBodyReadFunction readFunction,
+        size_t bodySize,
+        _In_opt_ void* readContext
+    ) noexcept;
+
+private:
+    static constexpr size_t SOURCE_CHUNK_SIZE = 16 * 1024;
+
+    static HRESULT CALLBACK ReadFunction(
+        _In_ HCCallHandle call,
+        _In_ size_t offset,
+        _In_ size_t bytesAvailable,
+        _In_opt_ void* context,
+        _Out_writes_bytes_to_(bytesAvailable, *bytesWritten) uint8_t* destination,
+        _Out_ size_t* bytesWritten
+    ) noexcept;
+
+    static HRESULT Append(_In_reads_bytes_(size) const uint8_t* data, _In_ size_t size, _In_opt_ void* context) noexcept;
+
+    HRESULT Restart() noexcept;
+    HRESULT CompressNextChunk() noexcept;
+
+    HCCallHandle const m_call;
+    HCHttpCallRequestBodyReadFunction const m_readFunction;
+    size_t const m_bodySize;
+    void* const m_readContext;
+
+    HC_UNIQUE_PTR<http_deflater> m_deflater;
+    size_t m_sourceOffset{ 0 };
+    size_t m_bytesDelivered{ 0 };
+    bool m_finished{ false };
+    http_body_bytes m_sourceBuffer;
+    http_body_bytes m_pending;
+    size_t m_pendingOffset{ 0 };
+
+    // The header changes are only for the attempt; Detach puts back what they replaced
+    bool m_hadContentLength{ false };
+    http_internal_string m_contentLength;
+    std::shared_ptr<http_header_map const> m_sharedHeaders;
+};
+
+uint32_t http_crc32(uint32_t crc, _In_reads_bytes_(size) const uint8_t* data, size_t size) noexcept;
+uint32_t http_adler32(uint32_t adler, _In_reads_bytes_(size) const uint8_t* data, size_t size) noexcept;
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
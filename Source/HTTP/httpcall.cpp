@@ -3,6 +3,10 @@
 
 #include "pch.h"
 #include "httpcall.h"
+#include "body_flow_control.h"
+#include "response_stream.h"
+#include "compression.h"
+#include "range_download.h"
 #include "../Mock/lhc_mock.h"
 
 using namespace xbox::httpclient;
@@ -42,6 +46,10 @@ try
         return E_OUTOFMEMORY;
     }
     call->retryAllowed = httpSingleton->m_retryAllowed;
+    call->decompressResponse = httpSingleton->m_decompressResponse;
+    call->compressionLevel = httpSingleton->m_compressionLevel;
+    call->httpVersion = httpSingleton->m_httpVersion;
+    call->priority = httpSingleton->m_priority;
     call->timeoutInSeconds = httpSingleton->m_timeoutInSeconds;
     call->timeoutWindowInSeconds = httpSingleton->m_timeoutWindowInSeconds;
     call->retryDelayInSeconds = httpSingleton->m_retryDelayInSeconds;
@@ -55,6 +63,66 @@ try
 }
 CATCH_RETURN()
 
+STDAPI
+HCHttpCallCreateFromPrototype(
+    _In_ HCCallHandle prototype,
+    _Out_ HCCallHandle* callHandle
+    ) noexcept
+try
+{
+    if (prototype == nullptr || callHandle == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+        return E_HC_NOT_INITIALISED;
+
+    // Freezing writes to the prototype, so calls created from it on several threads at once take turns. Once it is
+    // frozen this only copies a shared_ptr.
+    std::shared_ptr<http_header_map const> headers;
+    {
+        static std::mutex s_freezeLock;
+        std::lock_guard<std::mutex> lock{ s_freezeLock };
+        headers = prototype->requestHeaders.freeze();
+    }
+
+    HC_UNIQUE_PTR<HC_CALL> call{ Make<HC_CALL>() };
+    if (call == nullptr)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    // Copied into the new call's arena, if it has one, so they don't allocate unless they are long
+    call->method = prototype->method;
+    call->url = prototype->url;
+    call->requestHeaders.share(std::move(headers));
+    call->retryAllowed = prototype->retryAllowed;
+    call->retryAfterCacheId = prototype->retryAfterCacheId;
+    call->decompressResponse = prototype->decompressResponse;
+    call->compressionLevel = prototype->compressionLevel;
+    call->httpVersion = prototype->httpVersion;
+    call->priority = prototype->priority;
+    call->timeoutInSeconds = prototype->timeoutInSeconds;
+    call->timeoutWindowInSeconds = prototype->timeoutWindowInSeconds;
+    call->retryDelayInSeconds = prototype->retryDelayInSeconds;
+    call->parallelRangeSegmentCount = prototype->parallelRangeSegmentCount;
+    call->parallelRangeMinSegmentSize = prototype->parallelRangeMinSegmentSize;
+    call->traceCall = prototype->traceCall;
+#if HC_PLATFORM == HC_PLATFORM_WIN32 || HC_PLATFORM == HC_PLATFORM_GDK
+    call->sslValidation = prototype->sslValidation;
+#endif
+    call->retryIterationNumber = 0;
+    call->id = ++httpSingleton->m_lastId;
+
+    if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallCreateFromPrototype [ID %llu] from [ID %llu]", TO_ULL(call->id), TO_ULL(prototype->id)); }
+
+    *callHandle = call.release();
+    return S_OK;
+}
+CATCH_RETURN()
+
 STDAPI_(HCCallHandle) HCHttpCallDuplicateHandle(
     _In_ HCCallHandle call
     ) noexcept
@@ -124,15 +192,72 @@ HRESULT perform_http_call(
             case XAsyncOp::DoWork:
             {
                 bool matchedMocks = false;
+                std::chrono::milliseconds mockLatency{};
+
+                call->attemptStartTime = chrono_clock_t::now();
+
+                {
+                    std::lock_guard<std::recursive_mutex> lock{ call->cancelLock };
+                    if (call->performCanceled)
+                    {
+                        XAsyncComplete(data->async, E_ABORT, 0);
+                        return E_PENDING;
+                    }
+                }
+
+                HRESULT attachResult = http_response_stream::Attach(call);
+                if (SUCCEEDED(attachResult))
+                {
+                    attachResult = http_body_flow_control::Attach(call);
+                }
+                if (SUCCEEDED(attachResult))
+                {
+                    attachResult = http_request_compressor::Attach(call);
+                }
+                if (SUCCEEDED(attachResult))
+                {
+                    attachResult = http_response_decompressor::Attach(call);
+                }
+                if (SUCCEEDED(attachResult))
+                {
+                    attachResult = http_resumable_download::Attach(call);
+                }
+                if (FAILED(attachResult))
+                {
+                    XAsyncComplete(data->async, attachResult, 0);
+                    return E_PENDING;
+                }
+
+                // The network emulator matches mocks itself so their responses are delivered with emulated conditions
+                HttpPerformInfo const& info = httpSingleton->m_httpPerform;
+                if (info.handler != network_emulator::PerformAsync)
+                {
+                    matchedMocks = Mock_Internal_HCHttpCallPerformAsync(call, mockLatency);
+                }
 
-                matchedMocks = Mock_Internal_HCHttpCallPerformAsync(call);
                 if (matchedMocks)
                 {
-                    XAsyncComplete(data->async, S_OK, 0);
+                    if (mockLatency.count() > 0)
+                    {
+                        // Replayed captures complete after the latency originally recorded for them
+                        XAsyncBlock* async = data->async;
+                        HRESULT hr = RunAsync([async]
+                        {
+                            XAsyncComplete(async, S_OK, 0);
+                        }, async->queue, static_cast<uint64_t>(mockLatency.count()));
+
+                        if (FAILED(hr))
+                        {
+                            XAsyncComplete(data->async, S_OK, 0);
+                        }
+                    }
+                    else
+                    {
+                        XAsyncComplete(data->async, S_OK, 0);
+                    }
                 }
                 else // if there wasn't a matched mock, then real call
                 {
-                    HttpPerformInfo const& info = httpSingleton->m_httpPerform;
                     if (info.handler != nullptr)
                     {
                         try
@@ -149,29 +274,117 @@ HRESULT perform_http_call(
                 return E_PENDING;
             }
 
+            case XAsyncOp::Cancel:
+            {
+                std::lock_guard<std::recursive_mutex> lock{ call->cancelLock };
+                http_call_cancel_handler handler = call->cancelHandler;
+                call->cancelHandler = nullptr;
+                if (handler != nullptr)
+                {
+                    handler(call, call->cancelHandlerContext);
+                }
+
+                // A body callback waiting to be resumed gives up
+                if (call->bodyFlowControl != nullptr)
+                {
+                    call->bodyFlowControl->Abort();
+                }
+                return S_OK;
+            }
+
             default: return S_OK;
         }
     });
 }
 
+bool http_call_set_cancel_handler(
+    _In_ HCCallHandle call,
+    _In_ http_call_cancel_handler handler,
+    _In_opt_ void* context
+) noexcept
+{
+    std::lock_guard<std::recursive_mutex> lock{ call->cancelLock };
+    if (call->performCanceled)
+    {
+        return false;
+    }
+
+    call->cancelHandler = handler;
+    call->cancelHandlerContext = context;
+    return true;
+}
+
+void http_call_clear_cancel_handler(_In_ HCCallHandle call) noexcept
+{
+    std::lock_guard<std::recursive_mutex> lock{ call->cancelLock };
+    call->cancelHandler = nullptr;
+    call->cancelHandlerContext = nullptr;
+}
+
+void http_call_set_resume_handler(
+    _In_ HCCallHandle call,
+    _In_ http_call_resume_handler handler,
+    _In_opt_ void* context
+) noexcept
+{
+    std::lock_guard<std::recursive_mutex> lock{ call->cancelLock };
+    call->resumeHandler = handler;
+    call->resumeHandlerContext = context;
+}
+
+void http_call_clear_resume_handler(_In_ HCCallHandle call) noexcept
+{
+    std::lock_guard<std::recursive_mutex> lock{ call->cancelLock };
+    call->resumeHandler = nullptr;
+    call->resumeHandlerContext = nullptr;
+}
+
+bool http_call_take_write_pause(_In_ HCCallHandle call) noexcept
+{
+    // Only attached and detached between attempts, so the provider reads it without the lock
+    return call->bodyFlowControl != nullptr && call->bodyFlowControl->TakeWritePause();
+}
+
+Uri const& http_call_get_parsed_url(_In_ HCCallHandle call)
+{
+    // Parsed again whenever the url differs from the one parsed, so a call whose url is set directly, as a range
+    // download's segments are, never sees a stale one
+    auto parsed = call->parsedUrl.FullPath();
+    if (parsed.size() != call->url.size() || memcmp(parsed.data(), call->url.data(), parsed.size()) != 0)
+    {
+        call->parsedUrl = Uri{ call->url.data(), call->url.size() };
+    }
+    return call->parsedUrl;
+}
+
 void clear_http_call_response(_In_ HCCallHandle call)
 {
+    // A resumable download keeps the body it has so far, and the next attempt asks for the rest
+    bool resuming = http_resumable_download::ResumeOffset(call) > 0;
+
     call->responseString.clear();
-    call->responseBodyBytes.clear();
+    if (!resuming)
+    {
+        call->responseBodyBytes.clear();
+        call->responseBodyWriteAtOffset = 0;
+    }
     call->responseHeaders.clear();
     call->statusCode = 0;
     call->networkErrorCode = S_OK;
     call->platformNetworkErrorCode = 0;
     call->task.reset();
+    call->responseCompressedBytes = 0;
+    call->responseDecompressedBytes = 0;
 }
 
 std::chrono::seconds GetRetryAfterHeaderTime(_In_ HC_CALL* call)
 {
-    auto it = call->responseHeaders.find(RETRY_AFTER_HEADER);
-    if (it != call->responseHeaders.end())
+    auto const& responseHeaders = call->responseHeaders.get();
+    auto it = responseHeaders.find(RETRY_AFTER_HEADER);
+    if (it != responseHeaders.end())
     {
         int value = 0;
-        http_internal_stringstream ss(it->second);
+        http_internal_stringstream ss(it->second.c_str());
         ss >> value;
 
         if (!ss.fail())
@@ -192,7 +405,9 @@ bool http_call_should_retry(
         return false;
     }
 
-    if (call->networkErrorCode == E_HC_NO_NETWORK)
+    // None of these is fixed by asking again
+    if (call->networkErrorCode == E_HC_NO_NETWORK || call->networkErrorCode == E_HC_RANGE_MISMATCH ||
+        call->networkErrorCode == E_HC_STREAM_RECORD_TOO_LARGE)
     {
         return false;
     }
@@ -334,48 +549,41 @@ bool should_fast_fail(
 }
 
 
-class HcCallWrapper
+HcCallWrapper::HcCallWrapper(_In_ HC_CALL* call)
 {
-public:
-    HcCallWrapper(_In_ HC_CALL* call)
+    assert(call != nullptr);
+    if (call != nullptr)
     {
-        assert(call != nullptr);
-        if (call != nullptr)
-        {
-            m_call = HCHttpCallDuplicateHandle(call);
-        }
-    }
-
-    ~HcCallWrapper()
-    {
-        if (m_call)
-        {
-            HCHttpCallCloseHandle(m_call);
-        }
+        m_call = HCHttpCallDuplicateHandle(call);
     }
+}
 
-    HC_CALL* get()
+HcCallWrapper::~HcCallWrapper()
+{
+    if (m_call)
     {
-        return m_call;
+        HCHttpCallCloseHandle(m_call);
     }
+}
 
-private:
-    HC_CALL* m_call{ nullptr };
-};
-
-typedef struct retry_context
+// Context of the HCHttpCallPerformAsync provider. The retry context is handed off when work starts, so cancellation
+// reaches the call through a reference that lives until the provider is cleaned up.
+typedef struct perform_async_context
 {
-    std::shared_ptr<HcCallWrapper> call;
-    XAsyncBlock* outerAsyncBlock;
-    XTaskQueueHandle outerQueue;
-} retry_context;
+    retry_context* retryContext;
+    HCCallHandle call;
+} perform_async_context;
 
 void notify_call_routed_handlers(std::shared_ptr<http_singleton> httpSingleton, HC_CALL* call)
 {
-    std::lock_guard<std::recursive_mutex> lock(httpSingleton->m_callRoutedHandlersLock);
-    for (const auto& pair : httpSingleton->m_callRoutedHandlers)
+    if (httpSingleton->m_callRoutedHandlers.empty())
     {
-        pair.second.first(call, pair.second.second);
+        return;
+    }
+
+    if (!httpSingleton->m_routedHandlerDispatcher.QueueCallNotification(call))
+    {
+        httpSingleton->m_callRoutedHandlers.notify(static_cast<HCCallHandle>(call));
     }
 }
 
@@ -407,6 +615,15 @@ void retry_http_call_until_done(
         return;
     }
 
+    {
+        std::lock_guard<std::recursive_mutex> lock{ call->cancelLock };
+        if (call->performCanceled)
+        {
+            XAsyncComplete(retryContext->outerAsyncBlock, E_ABORT, 0);
+            return;
+        }
+    }
+
     auto nestedBlock = http_allocate_unique<XAsyncBlock>();
     if (nestedBlock == nullptr)
     {
@@ -440,10 +657,23 @@ void retry_http_call_until_done(
             auto responseReceivedTime = chrono_clock_t::now();
             uint32_t timeoutWindowInSeconds = 0;
             HC_CALL* call = retryContext->call->get();
+            bool canceled = false;
+            {
+                std::lock_guard<std::recursive_mutex> lock{ call->cancelLock };
+                call->attemptAsyncBlock = nullptr;
+                canceled = call->performCanceled;
+            }
             HCHttpCallRequestGetTimeoutWindow(call, &timeoutWindowInSeconds);
+            // In the reverse of the order they were attached, so each layer's request header changes are undone in turn
+            http_resumable_download::Detach(call);
+            http_response_decompressor::Detach(call);
+            http_request_compressor::Detach(call);
+            http_body_flow_control::Detach(call);
+            http_response_stream::Detach(call);
             notify_call_routed_handlers(httpSingleton, call);
+            Capture_Internal_RecordHttpCall(httpSingleton, call, responseReceivedTime);
 
-            if (SUCCEEDED(callStatus) && http_call_should_retry(call, responseReceivedTime))
+            if (SUCCEEDED(callStatus) && !canceled && (http_response_stream::ShouldReconnect(call) || http_call_should_retry(call, responseReceivedTime)))
             {
                 if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallPerformExecute [ID %llu] Retry after %lld ms", TO_ULL(call->id), call->delayBeforeRetry.count()); }
                 clear_http_call_response(call);
@@ -462,6 +692,13 @@ void retry_http_call_until_done(
         // Cleanup with happen when unique ptr's go out of scope
     };
 
+    // Set before the attempt starts since it may complete before perform_http_call returns. Canceling a block
+    // that hasn't begun yet is a no-op, and DoWork checks for cancellation anyway.
+    {
+        std::lock_guard<std::recursive_mutex> lock{ call->cancelLock };
+        call->attemptAsyncBlock = nestedBlock.get();
+    }
+
     HRESULT hr = perform_http_call(httpSingleton, call, nestedBlock.get());
     if (SUCCEEDED(hr))
     {
@@ -471,6 +708,10 @@ void retry_http_call_until_done(
     else
     {
         // Cleanup with happen when unique ptr's go out of scope if they weren't released
+        {
+            std::lock_guard<std::recursive_mutex> lock{ call->cancelLock };
+            call->attemptAsyncBlock = nullptr;
+        }
         XAsyncComplete(retryContext->outerAsyncBlock, hr, 0);
         return;
     }
@@ -501,24 +742,70 @@ try
     retryContext->outerAsyncBlock = asyncBlock;
     retryContext->outerQueue = asyncBlock->queue;
 
-    HRESULT hr = XAsyncBegin(asyncBlock, retryContext.get(), reinterpret_cast<void*>(HCHttpCallPerformAsync), __FUNCTION__,
-        [](_In_ XAsyncOp op, _In_ const XAsyncProviderData* data)
+    auto performContext = http_allocate_unique<perform_async_context>();
+    if (performContext == nullptr)
     {
-        auto httpSingleton = get_http_singleton();
-        if (nullptr == httpSingleton)
-        {
-            return E_HC_NOT_INITIALISED;
-        }
+        return E_OUTOFMEMORY;
+    }
+    performContext->call = HCHttpCallDuplicateHandle(call); // keeps the handle alive until Cleanup
+    performContext->retryContext = retryContext.get();
 
+    HRESULT hr = XAsyncBegin(asyncBlock, performContext.get(), reinterpret_cast<void*>(HCHttpCallPerformAsync), __FUNCTION__,
+        [](_In_ XAsyncOp op, _In_ const XAsyncProviderData* data)
+    {
+        auto performContext = static_cast<perform_async_context*>(data->context);
         switch (op)
         {
             case XAsyncOp::DoWork:
             {
-                HC_UNIQUE_PTR<retry_context> retryContext{ static_cast<retry_context*>(data->context) };
-                retry_http_call_until_done(std::move(retryContext));
+                HC_UNIQUE_PTR<retry_context> retryContext{ performContext->retryContext };
+                performContext->retryContext = nullptr;
+                if (nullptr == get_http_singleton())
+                {
+                    return E_HC_NOT_INITIALISED;
+                }
+
+                if (http_range_download::IsEnabled(performContext->call))
+                {
+                    http_range_download::Start(std::move(retryContext));
+                }
+                else
+                {
+                    retry_http_call_until_done(std::move(retryContext));
+                }
                 return E_PENDING;
             }
-                
+
+            case XAsyncOp::Cancel:
+            {
+                // The attempt in flight completes with E_ABORT if its provider supports cancellation, and no
+                // further attempts are made either way
+                HCCallHandle call = performContext->call;
+                std::lock_guard<std::recursive_mutex> lock{ call->cancelLock };
+                call->performCanceled = true;
+                if (call->attemptAsyncBlock != nullptr)
+                {
+                    XAsyncCancel(call->attemptAsyncBlock);
+                }
+                else if (call->cancelHandler != nullptr)
+                {
+                    // A parallel range download has no attempt of its own, only child calls
+                    http_call_cancel_handler handler = call->cancelHandler;
+                    call->cancelHandler = nullptr;
+                    handler(call, call->cancelHandlerContext);
+                }
+                break;
+            }
+
+            case XAsyncOp::Cleanup:
+            {
+                // The retry context is still owned here if the call was canceled before DoWork ran
+                HC_UNIQUE_PTR<perform_async_context> context{ performContext };
+                HC_UNIQUE_PTR<retry_context> retryContext{ context->retryContext };
+                HCHttpCallCloseHandle(context->call);
+                break;
+            }
+
             default:
                 break;
         }
@@ -526,16 +813,37 @@ try
         return S_OK;
     });
 
-    if (SUCCEEDED(hr))
+    if (FAILED(hr))
     {
-        hr = XAsyncSchedule(asyncBlock, 0);
-        if (SUCCEEDED(hr))
-        {
-            retryContext.release(); // at this point we know do work will be called eventually
-        }
+        HCHttpCallCloseHandle(performContext->call);
+        return hr;
     }
 
-    return hr;
+    // Cleanup owns both contexts from here on, even if scheduling fails
+    performContext.release();
+    retryContext.release();
+    return XAsyncSchedule(asyncBlock, 0);
+}
+CATCH_RETURN()
+
+STDAPI
+HCHttpCallResumeBodyTransfer(
+    _In_ HCCallHandle call
+    ) noexcept
+try
+{
+    RETURN_HR_IF(E_INVALIDARG, call == nullptr);
+
+    std::lock_guard<std::recursive_mutex> lock{ call->cancelLock };
+    if (call->resumeHandler != nullptr)
+    {
+        call->resumeHandler(call, call->resumeHandlerContext);
+    }
+    else if (call->bodyFlowControl != nullptr)
+    {
+        call->bodyFlowControl->Resume();
+    }
+    return S_OK;
 }
 CATCH_RETURN()
 
@@ -622,9 +930,9 @@ try
 }
 CATCH_RETURN()
 
-bool http_header_compare::operator()(http_internal_string const& l, http_internal_string const& r) const
+bool http_header_compare::operator()(http_arena_string const& l, http_arena_string const& r) const
 {
-    return str_icmp(l, r) < 0;
+    return str_icmp(l.c_str(), r.c_str()) < 0;
 }
 
 void PerformEnvDeleter::operator()(typename std::allocator_traits<http_stl_allocator<HC_PERFORM_ENV>>::pointer p) noexcept
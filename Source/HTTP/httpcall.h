@@ -3,13 +3,92 @@
 
 #pragma once
 #include "pch.h"
+#include "uri.h"
 
 struct http_header_compare
 {
-    bool operator()(http_internal_string const& l, http_internal_string const& r) const;
+    bool operator()(http_arena_string const& l, http_arena_string const& r) const;
 };
 
-using http_header_map = http_internal_map<http_internal_string, http_internal_string, http_header_compare>;
+// Header maps are on the heap unless constructed with an arena, as a call's are
+using http_header_map = http_arena_map<http_arena_string, http_arena_string, http_header_compare>;
+
+// Request and response bodies, which are allocated as HC_MEMORY_TYPE_HTTP_BODY rather than with the rest of a call
+using http_body_bytes = std::vector<uint8_t, http_stl_allocator<uint8_t, HC_MEMORY_TYPE_HTTP_BODY>>;
+using http_body_string = std::basic_string<char, std::char_traits<char>, http_stl_allocator<char, HC_MEMORY_TYPE_HTTP_BODY>>;
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+class http_request_compressor;
+class http_response_decompressor;
+class http_resumable_download;
+class http_body_flow_control;
+class http_response_stream;
+class http_multipart_body;
+NAMESPACE_XBOX_HTTP_CLIENT_END
+
+// A value that can alias an immutable instance shared with other owners, e.g. a mock response that is
+// served to every call it matches. Reads see the shared instance directly; the first mutation copies it
+// into the locally owned value.
+template<typename T>
+class http_cow_value
+{
+public:
+    http_cow_value() = default;
+
+    template<typename Allocator>
+    explicit http_cow_value(Allocator const& allocator) : m_owned{ allocator }
+    {
+    }
+
+    T const& get() const noexcept
+    {
+        return m_shared ? *m_shared : m_owned;
+    }
+
+    T& mutate()
+    {
+        if (m_shared)
+        {
+            m_owned = *m_shared;
+            m_shared.reset();
+        }
+        return m_owned;
+    }
+
+    // Returns an immutable instance of the current value that can be handed to other owners. After this
+    // call the local value is shared as well, so a later mutate() will copy rather than modify it in place.
+    std::shared_ptr<T const> freeze()
+    {
+        if (!m_shared)
+        {
+            // The shared instance may outlive an arena the local value is in, so it is always on the heap
+            m_shared = http_allocate_shared<T>(std::move(m_owned), typename T::allocator_type{});
+            m_owned.clear();
+        }
+        return m_shared;
+    }
+
+    void share(std::shared_ptr<T const> value) noexcept
+    {
+        m_shared = std::move(value);
+        m_owned.clear();
+    }
+
+    bool is_shared() const noexcept
+    {
+        return m_shared != nullptr;
+    }
+
+    void clear() noexcept
+    {
+        m_shared.reset();
+        m_owned.clear();
+    }
+
+private:
+    T m_owned;
+    std::shared_ptr<T const> m_shared;
+};
 
 HRESULT CALLBACK DefaultRequestBodyReadFunction(
     _In_ HCCallHandle call,
@@ -27,6 +106,20 @@ HRESULT CALLBACK DefaultResponseBodyWriteFunction(
     _In_opt_ void* context
     ) noexcept;
 
+// Passes the body to the call's HCHttpCallResponseBodyWriteAtFunction in order, when it has one
+HRESULT CALLBACK ResponseBodyWriteAtFunctionAdapter(
+    _In_ HCCallHandle call,
+    _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context
+    ) noexcept;
+
+// Aborts the attempt a provider is performing, see http_call_set_cancel_handler
+typedef void(*http_call_cancel_handler)(_In_ HCCallHandle call, _In_opt_ void* context);
+
+// Resumes the attempt a provider paused because a body callback returned E_PENDING, see http_call_set_resume_handler
+typedef void(*http_call_resume_handler)(_In_ HCCallHandle call, _In_opt_ void* context);
+
 struct HC_CALL
 {
     HC_CALL()
@@ -35,25 +128,45 @@ struct HC_CALL
     }
     virtual ~HC_CALL();
 
-    http_internal_string method;
-    http_internal_string url;
-    http_internal_vector<uint8_t> requestBodyBytes;
-    http_internal_string requestBodyString;
+#if HC_CALL_ARENA
+    // The call's strings and headers are allocated from its arena, which starts in the call's own allocation.
+    // Declared first so it is destroyed last.
+    uint8_t arenaBlock[1024];
+    xbox::httpclient::http_arena arenaStorage{ arenaBlock, sizeof(arenaBlock) };
+    xbox::httpclient::http_arena* const arena{ &arenaStorage };
+#else
+    // Without an arena the call's strings and headers are allocated on the heap
+    xbox::httpclient::http_arena* const arena{ nullptr };
+#endif
+
+    http_arena_string method{ http_arena_allocator<char>{ arena } };
+    http_arena_string url{ http_arena_allocator<char>{ arena } };
+    xbox::httpclient::Uri parsedUrl; // see http_call_get_parsed_url
+    http_body_bytes requestBodyBytes;
+    http_body_string requestBodyString;
     size_t requestBodySize = 0;
     HCHttpCallRequestBodyReadFunction requestBodyReadFunction = DefaultRequestBodyReadFunction;
     void* requestBodyReadFunctionContext = nullptr;
-    http_header_map requestHeaders;
+    std::shared_ptr<xbox::httpclient::http_multipart_body> multipartBody;
+    http_cow_value<http_header_map> requestHeaders{ http_arena_allocator<char>{ arena } }; // may be shared with a prototype, see HCHttpCallCreateFromPrototype
+    std::shared_ptr<xbox::httpclient::http_request_compressor> requestCompressor;
 
-    http_internal_string responseString;
-    http_internal_vector<uint8_t> responseBodyBytes;
+    http_body_string responseString;
+    http_cow_value<http_body_bytes> responseBodyBytes;
     HCHttpCallResponseBodyWriteFunction responseBodyWriteFunction = DefaultResponseBodyWriteFunction;
     void* responseBodyWriteFunctionContext = nullptr;
-    http_header_map responseHeaders;
+    HCHttpCallResponseBodyWriteAtFunction responseBodyWriteAtFunction = nullptr;
+    uint64_t responseBodyWriteAtOffset = 0;
+    http_cow_value<http_header_map> responseHeaders{ http_arena_allocator<char>{ arena } };
     uint32_t statusCode = 0;
     HRESULT networkErrorCode = S_OK;
     uint32_t platformNetworkErrorCode = 0;
-    http_internal_string platformNetworkErrorMessage;
+    http_arena_string platformNetworkErrorMessage{ http_arena_allocator<char>{ arena } };
     std::shared_ptr<xbox::httpclient::hc_task> task;
+    std::shared_ptr<xbox::httpclient::http_response_decompressor> responseDecompressor;
+    uint64_t responseCompressedBytes = 0;
+    uint64_t responseDecompressedBytes = 0;
+    std::shared_ptr<xbox::httpclient::http_response_stream> responseStream;
 
     uint64_t id = 0;
     bool traceCall = true;
@@ -64,16 +177,71 @@ struct HC_CALL
     std::atomic<int> refCount;
 
     chrono_clock_t::time_point firstRequestStartTime;
+    chrono_clock_t::time_point attemptStartTime;
     std::chrono::milliseconds delayBeforeRetry = std::chrono::milliseconds(0);
     uint32_t retryIterationNumber = 0;
     bool retryAllowed = false;
+    bool decompressResponse = false;
+    HCCompressionLevel compressionLevel = HCCompressionLevel::None;
+    HCHttpVersion httpVersion = HCHttpVersion::Default;
+    HCHttpCallPriority priority = HCHttpCallPriority::Normal;
     uint32_t retryAfterCacheId = 0;
     uint32_t timeoutInSeconds = 0;
     uint32_t timeoutWindowInSeconds = 0;
     uint32_t retryDelayInSeconds = 0;
+    uint32_t parallelRangeSegmentCount = 0;
+    uint64_t parallelRangeMinSegmentSize = 0;
+    std::shared_ptr<xbox::httpclient::http_resumable_download> resumableDownload;
     bool performCalled = false;
+
+    // XAsyncCancel on HCHttpCallPerformAsync reaches the attempt in flight through these. Recursive because
+    // completing an attempt can run its callback inline on the canceling thread.
+    std::recursive_mutex cancelLock;
+    bool performCanceled = false;
+    XAsyncBlock* attemptAsyncBlock = nullptr;
+    http_call_cancel_handler cancelHandler = nullptr;
+    void* cancelHandlerContext = nullptr;
+
+    // HCHttpCallResumeBodyTransfer reaches the attempt in flight through these, also under cancelLock
+    http_call_resume_handler resumeHandler = nullptr;
+    void* resumeHandlerContext = nullptr;
+    std::shared_ptr<xbox::httpclient::http_body_flow_control> bodyFlowControl;
 };
 
+template<>
+struct http_memory_type<HC_CALL>
+{
+    static constexpr HCMemoryType value = HC_MEMORY_TYPE_HTTP_CALL;
+};
+
+// Holds a reference to a call handle for as long as it is performed
+class HcCallWrapper
+{
+public:
+    HcCallWrapper(_In_ HC_CALL* call);
+    ~HcCallWrapper();
+
+    HC_CALL* get()
+    {
+        return m_call;
+    }
+
+private:
+    HC_CALL* m_call{ nullptr };
+};
+
+typedef struct retry_context
+{
+    std::shared_ptr<HcCallWrapper> call;
+    XAsyncBlock* outerAsyncBlock;
+    XTaskQueueHandle outerQueue;
+} retry_context;
+
+// Performs attempts of the call until one succeeds or it runs out of retries, then completes the outer async block
+void retry_http_call_until_done(
+    _In_ HC_UNIQUE_PTR<retry_context> retryContext
+    );
+
 struct HttpPerformInfo
 {
     HttpPerformInfo(_In_ HCCallPerformFunction h, _In_opt_ void* ctx)
@@ -99,6 +267,65 @@ HRESULT Internal_SetGlobalProxy(
     _In_ const char* proxyUri
 ) noexcept;
 
+// Only implemented by providers that resolve host names themselves
+HRESULT Internal_PrewarmDnsCache(
+    _In_ HC_PERFORM_ENV* performEnv,
+    _In_reads_(hostNameCount) const char* const* hostNames,
+    _In_ uint32_t hostNameCount
+) noexcept;
+
+HRESULT Internal_GetDnsCacheStats(
+    _In_ HC_PERFORM_ENV* performEnv,
+    _Out_ HCDnsCacheStats* stats
+) noexcept;
+
+// Completes the begun asyncBlock once the connections are open, unless it returns a failure
+HRESULT Internal_HttpPreconnect(
+    _In_ HC_PERFORM_ENV* performEnv,
+    _In_z_ const char* url,
+    _In_ uint32_t connectionCount,
+    _Inout_ XAsyncBlock* asyncBlock
+) noexcept;
+
+// Only implemented by providers that pool connections themselves
+HRESULT Internal_GetHttpConnectionStats(
+    _In_ HC_PERFORM_ENV* performEnv,
+    _Out_ HCHttpConnectionStats* stats
+) noexcept;
+
+// Lets the provider performing an attempt abort it when HCHttpCallPerformAsync is canceled. The handler runs at
+// most once, on the canceling thread, and should make the provider complete the attempt with E_ABORT. Returns
+// false if the call was already canceled, in which case the provider should complete with E_ABORT right away.
+bool http_call_set_cancel_handler(
+    _In_ HCCallHandle call,
+    _In_ http_call_cancel_handler handler,
+    _In_opt_ void* context
+) noexcept;
+
+// A provider that set a cancel handler must clear it before it completes the attempt or frees the handler's context
+void http_call_clear_cancel_handler(_In_ HCCallHandle call) noexcept;
+
+// Lets the provider performing an attempt pause it when the call's body callbacks return E_PENDING, rather than
+// having the thread that invoked them wait. When the request body read function returns E_PENDING the provider stops
+// sending, and reads from the same offset again once the handler runs. When http_call_take_write_pause returns true
+// after the response body write function returned, the provider stops receiving until the handler runs. The handler
+// runs on the thread calling HCHttpCallResumeBodyTransfer, possibly while nothing is paused, and must not block.
+void http_call_set_resume_handler(
+    _In_ HCCallHandle call,
+    _In_ http_call_resume_handler handler,
+    _In_opt_ void* context
+) noexcept;
+
+// Like the cancel handler, cleared before the provider completes the attempt or frees the handler's context
+void http_call_clear_resume_handler(_In_ HCCallHandle call) noexcept;
+
+// Whether the response body write function asked to pause since this was last called
+bool http_call_take_write_pause(_In_ HCCallHandle call) noexcept;
+
+// The call's url, parsed the first time a provider asks for it and reused by the call's later attempts. Only for the
+// provider performing an attempt, which can't overlap with another attempt or with the url being set.
+xbox::httpclient::Uri const& http_call_get_parsed_url(_In_ HCCallHandle call);
+
 void CALLBACK Internal_HCHttpCallPerformAsync(
     _In_ HCCallHandle call,
     _Inout_ XAsyncBlock* asyncBlock,
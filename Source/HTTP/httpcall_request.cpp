@@ -3,6 +3,9 @@
 
 #include "pch.h"
 #include "httpcall.h"
+#include "range_download.h"
+#include "multipart_body.h"
+#include "../Common/url_encoding.h"
 #if HC_PLATFORM == HC_PLATFORM_GDK
 #include "XSystem.h"
 #endif
@@ -69,6 +72,61 @@ try
 }
 CATCH_RETURN()
 
+STDAPI
+HCHttpCallRequestAppendQueryParameter(
+    _In_ HCCallHandle call,
+    _In_z_ const char* name,
+    _In_z_ const char* value
+    ) noexcept
+try
+{
+    if (call == nullptr || name == nullptr || value == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    RETURN_IF_PERFORM_CALLED(call);
+
+    // The parameter goes ahead of any fragment, after '?' if the url has no query yet
+    auto& url = call->url;
+    size_t fragment = url.find('#');
+    if (fragment == url.npos)
+    {
+        fragment = url.size();
+    }
+    size_t query = url.find('?');
+    char separator = '\0';
+    if (query >= fragment)
+    {
+        separator = '?';
+    }
+    else if (fragment > query + 1 && url[fragment - 1] != '&')
+    {
+        separator = '&';
+    }
+
+    // Encoded straight into the url, which grows once to fit
+    size_t nameLength = strlen(name);
+    size_t valueLength = strlen(value);
+    size_t parameterLength = (separator != '\0' ? 1 : 0) + UrlEncodedLength(name, nameLength) + 1 + UrlEncodedLength(value, valueLength);
+    size_t tailLength = url.size() - fragment;
+    url.resize(url.size() + parameterLength);
+
+    char* out = &url[fragment];
+    memmove(out + parameterLength, out, tailLength);
+    if (separator != '\0')
+    {
+        *out++ = separator;
+    }
+    out += UrlEncode(name, nameLength, out);
+    *out++ = '=';
+    UrlEncode(value, valueLength, out);
+
+    if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallRequestAppendQueryParameter [ID %llu]: url=%s", TO_ULL(call->id), url.c_str()); }
+
+    return S_OK;
+}
+CATCH_RETURN()
+
 STDAPI 
 HCHttpCallRequestGetUrl(
     _In_ HCCallHandle call,
@@ -215,7 +273,7 @@ try
 
     if (call->requestBodyString.empty())
     {
-        call->requestBodyString = http_internal_string(reinterpret_cast<char const*>(call->requestBodyBytes.data()), call->requestBodyBytes.size());
+        call->requestBodyString.assign(reinterpret_cast<char const*>(call->requestBodyBytes.data()), call->requestBodyBytes.size());
     }
     *requestBody = call->requestBodyString.c_str();
     return S_OK;
@@ -244,6 +302,118 @@ try
 }
 CATCH_RETURN()
 
+STDAPI
+HCHttpCallRequestAddMultipartBytes(
+    _In_ HCCallHandle call,
+    _In_z_ const char* name,
+    _In_opt_z_ const char* fileName,
+    _In_opt_z_ const char* contentType,
+    _In_reads_bytes_(size) const uint8_t* bytes,
+    _In_ size_t size
+) noexcept
+try
+{
+    if (call == nullptr || name == nullptr || (bytes == nullptr && size != 0))
+    {
+        return E_INVALIDARG;
+    }
+    RETURN_IF_PERFORM_CALLED(call);
+
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+        return E_HC_NOT_INITIALISED;
+
+    RETURN_IF_FAILED(http_multipart_body::AddBytes(call, name, fileName, contentType, bytes, size, true));
+
+    if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallRequestAddMultipartBytes [ID %llu]: name=%s size=%llu", TO_ULL(call->id), name, TO_ULL(size)); }
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI
+HCHttpCallRequestAddMultipartBorrowedBytes(
+    _In_ HCCallHandle call,
+    _In_z_ const char* name,
+    _In_opt_z_ const char* fileName,
+    _In_opt_z_ const char* contentType,
+    _In_reads_bytes_(size) const uint8_t* bytes,
+    _In_ size_t size
+) noexcept
+try
+{
+    if (call == nullptr || name == nullptr || (bytes == nullptr && size != 0))
+    {
+        return E_INVALIDARG;
+    }
+    RETURN_IF_PERFORM_CALLED(call);
+
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+        return E_HC_NOT_INITIALISED;
+
+    RETURN_IF_FAILED(http_multipart_body::AddBytes(call, name, fileName, contentType, bytes, size, false));
+
+    if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallRequestAddMultipartBorrowedBytes [ID %llu]: name=%s size=%llu", TO_ULL(call->id), name, TO_ULL(size)); }
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI
+HCHttpCallRequestAddMultipartFile(
+    _In_ HCCallHandle call,
+    _In_z_ const char* name,
+    _In_opt_z_ const char* fileName,
+    _In_opt_z_ const char* contentType,
+    _In_z_ const char* filePath
+) noexcept
+try
+{
+    if (call == nullptr || name == nullptr || filePath == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    RETURN_IF_PERFORM_CALLED(call);
+
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+        return E_HC_NOT_INITIALISED;
+
+    RETURN_IF_FAILED(http_multipart_body::AddFile(call, name, fileName, contentType, filePath));
+
+    if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallRequestAddMultipartFile [ID %llu]: name=%s filePath=%s", TO_ULL(call->id), name, filePath); }
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI
+HCHttpCallRequestAddMultipartReadFunction(
+    _In_ HCCallHandle call,
+    _In_z_ const char* name,
+    _In_opt_z_ const char* fileName,
+    _In_opt_z_ const char* contentType,
+    _In_ HCHttpCallRequestBodyReadFunction readFunction,
+    _In_ size_t size,
+    _In_opt_ void* context
+) noexcept
+try
+{
+    if (call == nullptr || name == nullptr || readFunction == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    RETURN_IF_PERFORM_CALLED(call);
+
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+        return E_HC_NOT_INITIALISED;
+
+    RETURN_IF_FAILED(http_multipart_body::AddReadFunction(call, name, fileName, contentType, readFunction, size, context));
+
+    if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallRequestAddMultipartReadFunction [ID %llu]: name=%s", TO_ULL(call->id), name); }
+    return S_OK;
+}
+CATCH_RETURN()
+
 STDAPI 
 HCHttpCallRequestSetHeader(
     _In_ HCCallHandle call,
@@ -259,7 +429,9 @@ try
     }
     RETURN_IF_PERFORM_CALLED(call);
 
-    call->requestHeaders[headerName] = headerValue;
+    // Built with the call's allocator, so inserting it doesn't copy it again
+    http_arena_string name{ headerName, http_arena_allocator<char>{ call->arena } };
+    call->requestHeaders.mutate()[std::move(name)] = headerValue;
 
     if (allowTracing && call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallRequestSetHeader [ID %llu]: %s=%s", TO_ULL(call->id), headerName, headerValue); }
     return S_OK;
@@ -279,8 +451,8 @@ try
         return E_INVALIDARG;
     }
 
-    auto it = call->requestHeaders.find(headerName);
-    if (it != call->requestHeaders.end())
+    auto it = call->requestHeaders.get().find(headerName);
+    if (it != call->requestHeaders.get().end())
     {
         *headerValue = it->second.c_str();
     }
@@ -304,7 +476,7 @@ try
         return E_INVALIDARG;
     }
 
-    *numHeaders = static_cast<uint32_t>(call->requestHeaders.size());
+    *numHeaders = static_cast<uint32_t>(call->requestHeaders.get().size());
     return S_OK;
 }
 CATCH_RETURN()
@@ -324,7 +496,7 @@ try
     }
 
     uint32_t index = 0;
-    for (auto it = call->requestHeaders.cbegin(); it != call->requestHeaders.cend(); ++it)
+    for (auto it = call->requestHeaders.get().cbegin(); it != call->requestHeaders.get().cend(); ++it)
     {
         if (index == headerIndex)
         {
@@ -418,6 +590,329 @@ try
 }
 CATCH_RETURN()
 
+STDAPI 
+HCHttpCallRequestSetResponseDecompression(
+    _In_opt_ HCCallHandle call,
+    _In_ bool decompress
+    ) noexcept
+try
+{
+    if (call == nullptr)
+    {
+        auto httpSingleton = get_http_singleton();
+        if (nullptr == httpSingleton)
+            return E_HC_NOT_INITIALISED;
+
+        httpSingleton->m_decompressResponse = decompress;
+    }
+    else
+    {
+        RETURN_IF_PERFORM_CALLED(call);
+        call->decompressResponse = decompress;
+
+        if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallRequestSetResponseDecompression [ID %llu]: decompress=%s", TO_ULL(call->id), decompress ? "true" : "false"); }
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI 
+HCHttpCallRequestGetResponseDecompression(
+    _In_opt_ HCCallHandle call,
+    _Out_ bool* decompress
+    ) noexcept
+try
+{
+    if (decompress == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (call == nullptr)
+    {
+        auto httpSingleton = get_http_singleton();
+        if (nullptr == httpSingleton)
+            return E_HC_NOT_INITIALISED;
+
+        *decompress = httpSingleton->m_decompressResponse;
+    }
+    else
+    {
+        *decompress = call->decompressResponse;
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI 
+HCHttpCallRequestSetCompression(
+    _In_opt_ HCCallHandle call,
+    _In_ HCCompressionLevel level
+    ) noexcept
+try
+{
+    if (static_cast<uint32_t>(level) > static_cast<uint32_t>(HCCompressionLevel::High))
+    {
+        return E_INVALIDARG;
+    }
+
+    if (call == nullptr)
+    {
+        auto httpSingleton = get_http_singleton();
+        if (nullptr == httpSingleton)
+            return E_HC_NOT_INITIALISED;
+
+        httpSingleton->m_compressionLevel = level;
+    }
+    else
+    {
+        RETURN_IF_PERFORM_CALLED(call);
+        call->compressionLevel = level;
+
+        if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallRequestSetCompression [ID %llu]: level=%u", TO_ULL(call->id), static_cast<uint32_t>(level)); }
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI 
+HCHttpCallRequestGetCompression(
+    _In_opt_ HCCallHandle call,
+    _Out_ HCCompressionLevel* level
+    ) noexcept
+try
+{
+    if (level == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (call == nullptr)
+    {
+        auto httpSingleton = get_http_singleton();
+        if (nullptr == httpSingleton)
+            return E_HC_NOT_INITIALISED;
+
+        *level = httpSingleton->m_compressionLevel;
+    }
+    else
+    {
+        *level = call->compressionLevel;
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI 
+HCHttpCallRequestSetHttpVersion(
+    _In_opt_ HCCallHandle call,
+    _In_ HCHttpVersion version
+    ) noexcept
+try
+{
+    if (static_cast<uint32_t>(version) > static_cast<uint32_t>(HCHttpVersion::Http2PriorKnowledge))
+    {
+        return E_INVALIDARG;
+    }
+
+    if (call == nullptr)
+    {
+        auto httpSingleton = get_http_singleton();
+        if (nullptr == httpSingleton)
+            return E_HC_NOT_INITIALISED;
+
+        httpSingleton->m_httpVersion = version;
+    }
+    else
+    {
+        RETURN_IF_PERFORM_CALLED(call);
+        call->httpVersion = version;
+
+        if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallRequestSetHttpVersion [ID %llu]: version=%u", TO_ULL(call->id), static_cast<uint32_t>(version)); }
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI 
+HCHttpCallRequestGetHttpVersion(
+    _In_opt_ HCCallHandle call,
+    _Out_ HCHttpVersion* version
+    ) noexcept
+try
+{
+    if (version == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (call == nullptr)
+    {
+        auto httpSingleton = get_http_singleton();
+        if (nullptr == httpSingleton)
+            return E_HC_NOT_INITIALISED;
+
+        *version = httpSingleton->m_httpVersion;
+    }
+    else
+    {
+        *version = call->httpVersion;
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI 
+HCHttpCallRequestSetPriority(
+    _In_opt_ HCCallHandle call,
+    _In_ HCHttpCallPriority priority
+    ) noexcept
+try
+{
+    if (static_cast<uint32_t>(priority) > static_cast<uint32_t>(HCHttpCallPriority::High))
+    {
+        return E_INVALIDARG;
+    }
+
+    if (call == nullptr)
+    {
+        auto httpSingleton = get_http_singleton();
+        if (nullptr == httpSingleton)
+            return E_HC_NOT_INITIALISED;
+
+        httpSingleton->m_priority = priority;
+    }
+    else
+    {
+        RETURN_IF_PERFORM_CALLED(call);
+        call->priority = priority;
+
+        if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallRequestSetPriority [ID %llu]: priority=%u", TO_ULL(call->id), static_cast<uint32_t>(priority)); }
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI 
+HCHttpCallRequestGetPriority(
+    _In_opt_ HCCallHandle call,
+    _Out_ HCHttpCallPriority* priority
+    ) noexcept
+try
+{
+    if (priority == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (call == nullptr)
+    {
+        auto httpSingleton = get_http_singleton();
+        if (nullptr == httpSingleton)
+            return E_HC_NOT_INITIALISED;
+
+        *priority = httpSingleton->m_priority;
+    }
+    else
+    {
+        *priority = call->priority;
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI 
+HCHttpCallRequestSetParallelRanges(
+    _In_ HCCallHandle call,
+    _In_ uint32_t segmentCount,
+    _In_ uint64_t minSegmentSize
+    ) noexcept
+try
+{
+    if (call == nullptr || (segmentCount > 1 && minSegmentSize == 0))
+    {
+        return E_INVALIDARG;
+    }
+    RETURN_IF_PERFORM_CALLED(call);
+
+    call->parallelRangeSegmentCount = segmentCount;
+    call->parallelRangeMinSegmentSize = minSegmentSize;
+
+    if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallRequestSetParallelRanges [ID %llu]: segmentCount=%u minSegmentSize=%llu", TO_ULL(call->id), segmentCount, TO_ULL(minSegmentSize)); }
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI
+HCHttpCallRequestSetResumable(
+    _In_ HCCallHandle call,
+    _In_ bool resumable
+    ) noexcept
+try
+{
+    if (call == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    RETURN_IF_PERFORM_CALLED(call);
+
+    if (resumable)
+    {
+        RETURN_IF_FAILED(http_resumable_download::Enable(call));
+    }
+    else
+    {
+        call->resumableDownload.reset();
+    }
+
+    if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallRequestSetResumable [ID %llu]: resumable=%d", TO_ULL(call->id), resumable); }
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI
+HCHttpCallRequestSetResumeCheckpoint(
+    _In_ HCCallHandle call,
+    _In_ const HCResumeCheckpoint* checkpoint
+    ) noexcept
+try
+{
+    if (call == nullptr || checkpoint == nullptr || checkpoint->validator == nullptr || checkpoint->validator[0] == '\0' ||
+        (checkpoint->totalLength != 0 && checkpoint->offset > checkpoint->totalLength))
+    {
+        return E_INVALIDARG;
+    }
+    RETURN_IF_PERFORM_CALLED(call);
+
+    RETURN_IF_FAILED(http_resumable_download::Enable(call));
+    call->resumableDownload->SetCheckpoint(*checkpoint);
+
+    if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallRequestSetResumeCheckpoint [ID %llu]: offset=%llu", TO_ULL(call->id), TO_ULL(checkpoint->offset)); }
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI
+HCHttpCallRequestSetResumeCheckpointFunction(
+    _In_ HCCallHandle call,
+    _In_opt_ HCHttpCallResumeCheckpointFunction checkpointFunction,
+    _In_ uint64_t intervalBytes,
+    _In_opt_ void* context
+    ) noexcept
+try
+{
+    if (call == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    RETURN_IF_PERFORM_CALLED(call);
+
+    RETURN_IF_FAILED(http_resumable_download::Enable(call));
+    call->resumableDownload->SetCheckpointFunction(checkpointFunction, intervalBytes, context);
+    return S_OK;
+}
+CATCH_RETURN()
+
 STDAPI 
 HCHttpCallRequestGetRetryCacheId(
     _In_ HCCallHandle call,
@@ -3,6 +3,7 @@
 
 #include "pch.h"
 #include "httpcall.h"
+#include "response_stream.h"
 
 using namespace xbox::httpclient;
 
@@ -16,6 +17,21 @@ HRESULT CALLBACK DefaultResponseBodyWriteFunction(
     return HCHttpCallResponseAppendResponseBodyBytes(call, source, bytesAvailable);
 }
 
+HRESULT CALLBACK ResponseBodyWriteAtFunctionAdapter(
+    _In_ HCCallHandle call,
+    _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context
+    ) noexcept
+{
+    HRESULT hr = call->responseBodyWriteAtFunction(call, call->responseBodyWriteAtOffset, source, bytesAvailable, context);
+    if (SUCCEEDED(hr))
+    {
+        call->responseBodyWriteAtOffset += bytesAvailable;
+    }
+    return hr;
+}
+
 STDAPI
 HCHttpCallResponseGetResponseBodyWriteFunction(
     _In_ HCCallHandle call,
@@ -61,6 +77,59 @@ try
 }
 CATCH_RETURN()
 
+STDAPI
+HCHttpCallResponseSetResponseBodyWriteAtFunction(
+    _In_ HCCallHandle call,
+    _In_ HCHttpCallResponseBodyWriteAtFunction writeFunction,
+    _In_opt_ void* context
+    ) noexcept
+try
+{
+    if (call == nullptr || writeFunction == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    RETURN_IF_PERFORM_CALLED(call);
+
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+        return E_HC_NOT_INITIALISED;
+
+    call->responseBodyWriteAtFunction = writeFunction;
+    call->responseBodyWriteFunction = ResponseBodyWriteAtFunctionAdapter;
+    call->responseBodyWriteFunctionContext = context;
+
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI
+HCHttpCallResponseSetStreamEventFunction(
+    _In_ HCCallHandle call,
+    _In_ HCResponseStreamFormat format,
+    _In_opt_ XTaskQueueHandle queue,
+    _In_ HCHttpCallResponseStreamEventFunction eventFunction,
+    _In_opt_ void* context
+    ) noexcept
+try
+{
+    if (call == nullptr || eventFunction == nullptr || format > HCResponseStreamFormat::LengthPrefixed)
+    {
+        return E_INVALIDARG;
+    }
+    RETURN_IF_PERFORM_CALLED(call);
+
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+        return E_HC_NOT_INITIALISED;
+
+    RETURN_IF_FAILED(http_response_stream::Enable(call, format, queue, eventFunction, context));
+
+    if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallResponseSetStreamEventFunction [ID %llu]: format=%u", TO_ULL(call->id), static_cast<uint32_t>(format)); }
+    return S_OK;
+}
+CATCH_RETURN()
+
 STDAPI 
 HCHttpCallResponseGetResponseString(
     _In_ HCCallHandle call,
@@ -83,7 +152,8 @@ try
 
     if (call->responseString.empty())
     {
-        call->responseString = http_internal_string(reinterpret_cast<char const*>(call->responseBodyBytes.data()), call->responseBodyBytes.size());
+        auto const& responseBody = call->responseBodyBytes.get();
+        call->responseString.assign(reinterpret_cast<char const*>(responseBody.data()), responseBody.size());
         if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallResponseGetResponseString [ID %llu]: responseString=%.2048s", TO_ULL(call->id), call->responseString.c_str()); }
     }
     *responseString = call->responseString.c_str();
@@ -110,7 +180,7 @@ try
         return E_FAIL;
     }
 
-    *bufferSize = call->responseBodyBytes.size();
+    *bufferSize = call->responseBodyBytes.get().size();
     return S_OK;
 }
 CATCH_RETURN()
@@ -136,15 +206,16 @@ try
         return E_FAIL;
     }
 
+    auto const& responseBody = call->responseBodyBytes.get();
 #if HC_PLATFORM_IS_MICROSOFT
-    memcpy_s(buffer, bufferSize, call->responseBodyBytes.data(), call->responseBodyBytes.size());
+    memcpy_s(buffer, bufferSize, responseBody.data(), responseBody.size());
 #else
-    memcpy(buffer, call->responseBodyBytes.data(), call->responseBodyBytes.size());
+    memcpy(buffer, responseBody.data(), responseBody.size());
 #endif
 
     if (bufferUsed != nullptr)
     {
-        *bufferUsed = call->responseBodyBytes.size();
+        *bufferUsed = responseBody.size();
     }
     return S_OK;
 }
@@ -171,7 +242,8 @@ try
         return E_FAIL;
     }
 
-    call->responseBodyBytes.assign(bodyBytes, bodyBytes + bodySize);
+    call->responseBodyBytes.clear();
+    call->responseBodyBytes.mutate().assign(bodyBytes, bodyBytes + bodySize);
     call->responseString.clear();
 
     if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallResponseSetResponseBodyBytes [ID %llu]: bodySize=%zu", TO_ULL(call->id), bodySize); }
@@ -200,10 +272,11 @@ try
         return E_FAIL;
     }
 
-    call->responseBodyBytes.insert(call->responseBodyBytes.end(), bodyBytes, bodyBytes + bodySize);
+    auto& responseBody = call->responseBodyBytes.mutate();
+    responseBody.insert(responseBody.end(), bodyBytes, bodyBytes + bodySize);
     call->responseString.clear();
 
-    if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallResponseAppendResponseBodyBytes [ID %llu]: bodySize=%zu (total=%llu)", TO_ULL(call->id), bodySize, call->responseBodyBytes.size()); }
+    if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallResponseAppendResponseBodyBytes [ID %llu]: bodySize=%zu (total=%llu)", TO_ULL(call->id), bodySize, TO_ULL(responseBody.size())); }
     return S_OK;
 }
 CATCH_RETURN()
@@ -299,6 +372,25 @@ try
 }
 CATCH_RETURN()
 
+STDAPI
+HCHttpCallResponseGetDecompressionStats(
+    _In_ HCCallHandle call,
+    _Out_ uint64_t* compressedBytes,
+    _Out_ uint64_t* decompressedBytes
+    ) noexcept
+try
+{
+    if (call == nullptr || compressedBytes == nullptr || decompressedBytes == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    *compressedBytes = call->responseCompressedBytes;
+    *decompressedBytes = call->responseDecompressedBytes;
+    return S_OK;
+}
+CATCH_RETURN()
+
 STDAPI
 HCHttpCallResponseSetPlatformNetworkErrorMessage(
     _In_ HCCallHandle call,
@@ -336,8 +428,9 @@ try
         return E_INVALIDARG;
     }
 
-    auto it = call->responseHeaders.find(headerName);
-    if (it != call->responseHeaders.end())
+    auto const& responseHeaders = call->responseHeaders.get();
+    auto it = responseHeaders.find(headerName);
+    if (it != responseHeaders.end())
     {
         *headerValue = it->second.c_str();
     }
@@ -361,7 +454,7 @@ try
         return E_INVALIDARG;
     }
 
-    *numHeaders = static_cast<uint32_t>(call->responseHeaders.size());
+    *numHeaders = static_cast<uint32_t>(call->responseHeaders.get().size());
     return S_OK;
 }
 CATCH_RETURN()
@@ -380,8 +473,9 @@ try
         return E_INVALIDARG;
     }
 
+    auto const& responseHeaders = call->responseHeaders.get();
     uint32_t index = 0;
-    for (auto it = call->responseHeaders.cbegin(); it != call->responseHeaders.cend(); ++it)
+    for (auto it = responseHeaders.cbegin(); it != responseHeaders.cend(); ++it)
     {
         if (index == headerIndex)
         {
@@ -434,13 +528,16 @@ try
         return E_INVALIDARG;
     }
 
-    http_internal_string name{ headerName, headerName + nameSize };
+    // Built with the call's allocator, so inserting them doesn't copy them again
+    http_arena_allocator<char> allocator{ call->arena };
+    http_arena_string name{ headerName, nameSize, allocator };
 
-    auto it = call->responseHeaders.find(name);
-    if (it != call->responseHeaders.end())
+    auto& responseHeaders = call->responseHeaders.mutate();
+    auto it = responseHeaders.find(name);
+    if (it != responseHeaders.end())
     {
         // Duplicated response header found. We must concatenate it with the existing headers
-        http_internal_string& newHeaderValue = it->second;
+        http_arena_string& newHeaderValue = it->second;
         newHeaderValue.append(", ");
         newHeaderValue.append(headerValue, headerValue + valueSize);
 
@@ -448,11 +545,11 @@ try
     }
     else
     {
-        http_internal_string value{ headerValue, headerValue + valueSize };
+        http_arena_string value{ headerValue, valueSize, allocator };
 
         if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallResponseSetResponseHeader [ID %llu]: %s=%s", TO_ULL(call->id), name.c_str(), value.c_str()); }
 
-        call->responseHeaders[name] = std::move(value);
+        responseHeaders.emplace(std::move(name), std::move(value));
     }
 
     return S_OK;
@@ -0,0 +1,500 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "multipart_body.h"
+#include <random>
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+namespace
+{
+
+FILE* OpenFile(_In_z_ const char* filePath) noexcept
+{
+    FILE* file{ nullptr };
+#if HC_PLATFORM_IS_MICROSOFT
+    if (fopen_s(&file, filePath, "rb") != 0)
+    {
+        file = nullptr;
+    }
+#else
+    file = fopen(filePath, "rb");
+#endif
+    return file;
+}
+
+bool SeekFile(_In_ FILE* file, _In_ uint64_t offset, _In_ int origin) noexcept
+{
+#if HC_PLATFORM_IS_MICROSOFT
+    return _fseeki64(file, static_cast<int64_t>(offset), origin) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), origin) == 0;
+#endif
+}
+
+HRESULT GetFileSize(_In_z_ const char* filePath, _Out_ size_t& size) noexcept
+{
+    FILE* file = OpenFile(filePath);
+    if (file == nullptr)
+    {
+        HC_TRACE_ERROR(HTTPCLIENT, "http_multipart_body: unable to open %s", filePath);
+        return E_FAIL;
+    }
+
+#if HC_PLATFORM_IS_MICROSOFT
+    int64_t end = SeekFile(file, 0, SEEK_END) ? _ftelli64(file) : -1;
+#else
+    int64_t end = SeekFile(file, 0, SEEK_END) ? static_cast<int64_t>(ftello(file)) : -1;
+#endif
+    fclose(file);
+
+    if (end < 0 || static_cast<uint64_t>(end) >= HC_UNKNOWN_REQUEST_BODY_SIZE)
+    {
+        return E_FAIL;
+    }
+    size = static_cast<size_t>(end);
+    return S_OK;
+}
+
+// Header values can't break the part's headers; names are escaped the way browsers escape them
+bool IsValidHeaderValue(_In_opt_z_ const char* value) noexcept
+{
+    return value == nullptr || strpbrk(value, "\r\n") == nullptr;
+}
+
+void AppendQuoted(_Inout_ http_internal_string& headers, _In_z_ const char* value)
+{
+    headers += '"';
+    for (const char* c = value; *c != '\0'; ++c)
+    {
+        switch (*c)
+        {
+        case '"': headers += "%22"; break;
+        case '\r': headers += "%0D"; break;
+        case '\n': headers += "%0A"; break;
+        default: headers += *c; break;
+        }
+    }
+    headers += '"';
+}
+
+const char* BaseName(_In_z_ const char* filePath) noexcept
+{
+    const char* baseName = filePath;
+    for (const char* c = filePath; *c != '\0'; ++c)
+    {
+        if (*c == '/' || *c == '\\')
+        {
+            baseName = c + 1;
+        }
+    }
+    return baseName;
+}
+
+}
+
+HRESULT http_multipart_body::AddBytes(
+    _In_ HCCallHandle call,
+    _In_z_ const char* name,
+    _In_opt_z_ const char* fileName,
+    _In_opt_z_ const char* contentType,
+    _In_reads_bytes_(size) const uint8_t* bytes,
+    _In_ size_t size,
+    _In_ bool copy
+)
+{
+    http_multipart_body* body{ nullptr };
+    RETURN_IF_FAILED(Get(call, body));
+
+    segment content{};
+    content.size = size;
+    if (copy)
+    {
+        content.type = segment_type::Owned;
+        content.bytes.assign(bytes, bytes + size);
+    }
+    else
+    {
+        content.type = segment_type::Borrowed;
+        content.borrowed = bytes;
+    }
+    RETURN_IF_FAILED(body->AddPart(name, fileName, contentType, std::move(content)));
+
+    return body->Install(call);
+}
+
+HRESULT http_multipart_body::AddFile(
+    _In_ HCCallHandle call,
+    _In_z_ const char* name,
+    _In_opt_z_ const char* fileName,
+    _In_opt_z_ const char* contentType,
+    _In_z_ const char* filePath
+)
+{
+    segment content{};
+    content.type = segment_type::File;
+    RETURN_IF_FAILED(GetFileSize(filePath, content.size));
+    content.filePath = filePath;
+
+    http_multipart_body* body{ nullptr };
+    RETURN_IF_FAILED(Get(call, body));
+    RETURN_IF_FAILED(body->AddPart(name, fileName != nullptr ? fileName : BaseName(filePath), contentType, std::move(content)));
+
+    return body->Install(call);
+}
+
+HRESULT http_multipart_body::AddReadFunction(
+    _In_ HCCallHandle call,
+    _In_z_ const char* name,
+    _In_opt_z_ const char* fileName,
+    _In_opt_z_ const char* contentType,
+    _In_ HCHttpCallRequestBodyReadFunction readFunction,
+    _In_ size_t size,
+    _In_opt_ void* context
+)
+{
+    http_multipart_body* body{ nullptr };
+    RETURN_IF_FAILED(Get(call, body));
+
+    segment content{};
+    content.type = segment_type::ReadFunction;
+    content.size = size;
+    content.sizeKnown = size != HC_UNKNOWN_REQUEST_BODY_SIZE;
+    content.readFunction = readFunction;
+    content.readContext = context;
+    RETURN_IF_FAILED(body->AddPart(name, fileName, contentType, std::move(content)));
+
+    return body->Install(call);
+}
+
+http_multipart_body::http_multipart_body()
+{
+    // 128 random bits, so the boundary can't turn up in the content
+    std::random_device random;
+    char hex[33]{};
+    for (int i = 0; i < 4; ++i)
+    {
+        uint32_t bits = random();
+        for (int j = 0; j < 8; ++j)
+        {
+            hex[i * 8 + j] = "0123456789abcdef"[(bits >> (j * 4)) & 0xF];
+        }
+    }
+    m_boundary = "----libHttpClientBoundary";
+    m_boundary += hex;
+}
+
+http_multipart_body::~http_multipart_body()
+{
+    CloseFile();
+}
+
+http_internal_string const& http_multipart_body::Boundary() const noexcept
+{
+    return m_boundary;
+}
+
+size_t http_multipart_body::Size() const noexcept
+{
+    size_t size = 0;
+    for (auto const& s : m_segments)
+    {
+        if (!s.sizeKnown)
+        {
+            return HC_UNKNOWN_REQUEST_BODY_SIZE;
+        }
+        size += s.size;
+    }
+    return size;
+}
+
+HRESULT http_multipart_body::Get(_In_ HCCallHandle call, _Out_ http_multipart_body*& body)
+{
+    if (call->multipartBody == nullptr ||
+        call->requestBodyReadFunction != ReadFunction ||
+        call->requestBodyReadFunctionContext != call->multipartBody.get())
+    {
+        call->multipartBody = http_allocate_shared<http_multipart_body>();
+    }
+    body = call->multipartBody.get();
+    return S_OK;
+}
+
+HRESULT http_multipart_body::Install(_In_ HCCallHandle call)
+{
+    RETURN_IF_FAILED(HCHttpCallRequestSetRequestBodyReadFunction(call, ReadFunction, Size(), this));
+
+    http_internal_string contentType{ "multipart/form-data; boundary=" };
+    contentType += m_boundary;
+    call->requestHeaders.mutate()["Content-Type"] = contentType.c_str();
+    return S_OK;
+}
+
+HRESULT http_multipart_body::AddPart(
+    _In_z_ const char* name,
+    _In_opt_z_ const char* fileName,
+    _In_opt_z_ const char* contentType,
+    _In_ segment&& content
+)
+{
+    if (!IsValidHeaderValue(contentType))
+    {
+        return E_INVALIDARG;
+    }
+
+    // The delimiter before a part starts with the CRLF that ends the part before it
+    http_internal_string headers{ m_hasParts ? "\r\n--" : "--" };
+    headers += m_boundary;
+    headers += "\r\nContent-Disposition: form-data; name=";
+    AppendQuoted(headers, name);
+    if (fileName != nullptr)
+    {
+        headers += "; filename=";
+        AppendQuoted(headers, fileName);
+    }
+    headers += "\r\n";
+    if (contentType != nullptr)
+    {
+        headers += "Content-Type: ";
+        headers += contentType;
+        headers += "\r\n";
+    }
+    headers += "\r\n";
+
+    // The headers join the owned segment before them, and copied content joins the headers
+    if (m_hasParts)
+    {
+        m_segments.pop_back();
+    }
+    if (m_segments.empty() || m_segments.back().type != segment_type::Owned)
+    {
+        segment owned{};
+        owned.type = segment_type::Owned;
+        m_segments.push_back(std::move(owned));
+    }
+    auto& owned = m_segments.back().bytes;
+    owned.insert(owned.end(), headers.begin(), headers.end());
+    if (content.type == segment_type::Owned)
+    {
+        owned.insert(owned.end(), content.bytes.begin(), content.bytes.end());
+    }
+    m_segments.back().size = owned.size();
+    if (content.type != segment_type::Owned)
+    {
+        m_segments.push_back(std::move(content));
+    }
+    m_hasParts = true;
+
+    http_internal_string closeDelimiter{ "\r\n--" };
+    closeDelimiter += m_boundary;
+    closeDelimiter += "--\r\n";
+    segment close{};
+    close.type = segment_type::Owned;
+    close.bytes.assign(closeDelimiter.begin(), closeDelimiter.end());
+    close.size = close.bytes.size();
+    m_segments.push_back(std::move(close));
+
+    // A new part means the body is read from the start again
+    CloseFile();
+    m_offset = 0;
+    m_segmentIndex = 0;
+    m_segmentOffset = 0;
+    return S_OK;
+}
+
+HRESULT http_multipart_body::Read(
+    _In_ HCCallHandle call,
+    _In_ size_t offset,
+    _In_ size_t bytesAvailable,
+    _Out_writes_bytes_to_(bytesAvailable, *bytesWritten) uint8_t* destination,
+    _Out_ size_t* bytesWritten
+)
+{
+    *bytesWritten = 0;
+    if (offset != m_offset)
+    {
+        RETURN_IF_FAILED(Seek(offset));
+    }
+
+    size_t written = 0;
+    while (written < bytesAvailable && m_segmentIndex < m_segments.size())
+    {
+        size_t segmentWritten = 0;
+        bool segmentEnded = false;
+        HRESULT hr = ReadSegment(call, destination + written, bytesAvailable - written, segmentWritten, segmentEnded);
+        written += segmentWritten;
+        m_offset += segmentWritten;
+        m_segmentOffset += segmentWritten;
+
+        // A part that isn't ready pauses the transfer only once what comes before it has been sent
+        if (hr == E_PENDING && written > 0)
+        {
+            break;
+        }
+        RETURN_IF_FAILED(hr);
+
+        if (segmentEnded)
+        {
+            ++m_segmentIndex;
+            m_segmentOffset = 0;
+        }
+    }
+
+    *bytesWritten = written;
+    return S_OK;
+}
+
+HRESULT http_multipart_body::ReadSegment(
+    _In_ HCCallHandle call,
+    _Out_writes_bytes_to_(bytesAvailable, bytesWritten) uint8_t* destination,
+    _In_ size_t bytesAvailable,
+    _Out_ size_t& bytesWritten,
+    _Out_ bool& segmentEnded
+)
+{
+    segment& s = m_segments[m_segmentIndex];
+    bytesWritten = 0;
+    segmentEnded = false;
+
+    if (s.type == segment_type::ReadFunction && !s.sizeKnown)
+    {
+        RETURN_IF_FAILED(s.readFunction(call, m_segmentOffset, bytesAvailable, s.readContext, destination, &bytesWritten));
+        if (bytesWritten > bytesAvailable)
+        {
+            return E_FAIL;
+        }
+        if (bytesWritten == 0)
+        {
+            // Remember where it ended, so the body can be sought past it
+            s.size = m_segmentOffset;
+            segmentEnded = true;
+        }
+        return S_OK;
+    }
+
+    size_t toWrite = std::min(bytesAvailable, s.size - m_segmentOffset);
+    switch (s.type)
+    {
+    case segment_type::Owned:
+        if (toWrite > 0)
+        {
+            std::memcpy(destination, s.bytes.data() + m_segmentOffset, toWrite);
+        }
+        break;
+
+    case segment_type::Borrowed:
+        if (toWrite > 0)
+        {
+            std::memcpy(destination, s.borrowed + m_segmentOffset, toWrite);
+        }
+        break;
+
+    case segment_type::File:
+        if (toWrite > 0)
+        {
+            if (m_file == nullptr)
+            {
+                m_file = OpenFile(s.filePath.c_str());
+                if (m_file == nullptr || !SeekFile(m_file, m_segmentOffset, SEEK_SET))
+                {
+                    HC_TRACE_ERROR(HTTPCLIENT, "http_multipart_body: unable to read %s", s.filePath.c_str());
+                    CloseFile();
+                    return E_FAIL;
+                }
+            }
+            if (fread(destination, 1, toWrite, m_file) != toWrite)
+            {
+                HC_TRACE_ERROR(HTTPCLIENT, "http_multipart_body: %s is shorter than when it was added", s.filePath.c_str());
+                return E_FAIL;
+            }
+        }
+        break;
+
+    case segment_type::ReadFunction:
+        if (toWrite > 0)
+        {
+            size_t requested = toWrite;
+            RETURN_IF_FAILED(s.readFunction(call, m_segmentOffset, requested, s.readContext, destination, &toWrite));
+            if (toWrite == 0 || toWrite > requested)
+            {
+                // A part of known size can't end early
+                return E_FAIL;
+            }
+        }
+        break;
+    }
+
+    bytesWritten = toWrite;
+    segmentEnded = m_segmentOffset + toWrite == s.size;
+    if (segmentEnded && s.type == segment_type::File)
+    {
+        CloseFile();
+    }
+    return S_OK;
+}
+
+HRESULT http_multipart_body::Seek(_In_ size_t offset)
+{
+    CloseFile();
+    m_offset = 0;
+    m_segmentIndex = 0;
+    m_segmentOffset = 0;
+
+    while (m_offset < offset)
+    {
+        if (m_segmentIndex == m_segments.size())
+        {
+            return E_FAIL;
+        }
+
+        segment const& s = m_segments[m_segmentIndex];
+        if (s.size == HC_UNKNOWN_REQUEST_BODY_SIZE)
+        {
+            // Can't seek past a part that hasn't been read yet
+            return E_FAIL;
+        }
+
+        if (offset - m_offset < s.size)
+        {
+            m_segmentOffset = offset - m_offset;
+            m_offset = offset;
+        }
+        else
+        {
+            m_offset += s.size;
+            ++m_segmentIndex;
+        }
+    }
+    return S_OK;
+}
+
+void http_multipart_body::CloseFile() noexcept
+{
+    if (m_file != nullptr)
+    {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+HRESULT CALLBACK http_multipart_body::ReadFunction(
+    _In_ HCCallHandle call,
+    _In_ size_t offset,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context,
+    _Out_writes_bytes_to_(bytesAvailable, *bytesWritten) uint8_t* destination,
+    _Out_ size_t* bytesWritten
+) noexcept
+try
+{
+    if (call == nullptr || context == nullptr || destination == nullptr || bytesWritten == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    return static_cast<http_multipart_body*>(context)->Read(call, offset, bytesAvailable, destination, bytesWritten);
+}
+CATCH_RETURN()
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
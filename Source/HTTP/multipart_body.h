@@ -0,0 +1,125 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+#include "pch.h"
+#include "httpcall.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+// The multipart/form-data request body built by the HCHttpCallRequestAddMultipart* APIs. It is the call's request body
+// read function, and is read as a list of segments: the delimiters and part headers, merged with any copied content
+// into as few buffers as possible, and the content that is read from where the caller left it.
+class http_multipart_body
+{
+public:
+    static HRESULT AddBytes(
+        _In_ HCCallHandle call,
+        _In_z_ const char* name,
+        _In_opt_z_ const char* fileName,
+        _In_opt_z_ const char* contentType,
+        _In_reads_bytes_(size) const uint8_t* bytes,
+        _In_ size_t size,
+        _In_ bool copy
+        );
+
+    static HRESULT AddFile(
+        _In_ HCCallHandle call,
+        _In_z_ const char* name,
+        _In_opt_z_ const char* fileName,
+        _In_opt_z_ const char* contentType,
+        _In_z_ const char* filePath
+        );
+
+    static HRESULT AddReadFunction(
+        _In_ HCCallHandle call,
+        _In_z_ const char* name,
+        _In_opt_z_ const char* fileName,
+        _In_opt_z_ const char* contentType,
+        _In_ HCHttpCallRequestBodyReadFunction readFunction,
+        _In_ size_t size,
+        _In_opt_ void* context
+        );
+
+    http_multipart_body();
+    http_multipart_body(const http_multipart_body&) = delete;
+    http_multipart_body& operator=(const http_multipart_body&) = delete;
+    ~http_multipart_body();
+
+    http_internal_string const& Boundary() const noexcept;
+
+    // The size of the whole body, or HC_UNKNOWN_REQUEST_BODY_SIZE if a part's size isn't known
+    size_t Size() const noexcept;
+
+private:
+    enum class segment_type
+    {
+        Owned,
+        Borrowed,
+        File,
+        ReadFunction
+    };
+
+    struct segment
+    {
+        segment_type type;
+        size_t size; // HC_UNKNOWN_REQUEST_BODY_SIZE until a read function part has been read to its end
+        http_body_bytes bytes;
+        const uint8_t* borrowed{ nullptr };
+        http_internal_string filePath;
+        HCHttpCallRequestBodyReadFunction readFunction{ nullptr };
+        void* readContext{ nullptr };
+        bool sizeKnown{ true }; // whether size was known when the part was added
+    };
+
+    // Returns the multipart body installed on the call, installing a new one if the call's body was set another way
+    static HRESULT Get(_In_ HCCallHandle call, _Out_ http_multipart_body*& body);
+    HRESULT Install(_In_ HCCallHandle call);
+
+    HRESULT AddPart(
+        _In_z_ const char* name,
+        _In_opt_z_ const char* fileName,
+        _In_opt_z_ const char* contentType,
+        _In_ segment&& content
+        );
+
+    HRESULT Read(
+        _In_ HCCallHandle call,
+        _In_ size_t offset,
+        _In_ size_t bytesAvailable,
+        _Out_writes_bytes_to_(bytesAvailable, *bytesWritten) uint8_t* destination,
+        _Out_ size_t* bytesWritten
+        );
+    HRESULT ReadSegment(
+        _In_ HCCallHandle call,
+        _Out_writes_bytes_to_(bytesAvailable, bytesWritten) uint8_t* destination,
+        _In_ size_t bytesAvailable,
+        _Out_ size_t& bytesWritten,
+        _Out_ bool& segmentEnded
+        );
+    HRESULT Seek(_In_ size_t offset);
+    void CloseFile() noexcept;
+
+    static HRESULT CALLBACK ReadFunction(
+        _In_ HCCallHandle call,
+        _In_ size_t offset,
+        _In_ size_t bytesAvailable,
+        _In_opt_ void* context,
+        _Out_writes_bytes_to_(bytesAvailable, *bytesWritten) uint8_t* destination,
+        _Out_ size_t* bytesWritten
+        ) noexcept;
+
+    http_internal_string m_boundary;
+
+    // Once a part has been added, always ends with the owned segment holding the close delimiter
+    http_internal_vector<segment> m_segments;
+    bool m_hasParts{ false };
+
+    // Where the next read is expected to start
+    size_t m_offset{ 0 };
+    size_t m_segmentIndex{ 0 };
+    size_t m_segmentOffset{ 0 };
+    FILE* m_file{ nullptr };
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
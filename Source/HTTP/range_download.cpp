@@ -0,0 +1,906 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "range_download.h"
+
+using namespace xbox::httpclient;
+
+#define RANGE_HEADER ("Range")
+#define IF_RANGE_HEADER ("If-Range")
+#define ACCEPT_RANGES_HEADER ("Accept-Ranges")
+#define CONTENT_LENGTH_HEADER ("Content-Length")
+#define CONTENT_RANGE_HEADER ("Content-Range")
+#define ETAG_HEADER ("ETag")
+#define LAST_MODIFIED_HEADER ("Last-Modified")
+
+static const char* FindHeader(_In_ http_header_map const& headers, _In_z_ const char* name)
+{
+    auto it = headers.find(name);
+    return it != headers.end() ? it->second.c_str() : nullptr;
+}
+
+static const char* SkipSpaces(_In_z_ const char* text)
+{
+    while (*text == ' ' || *text == '\t')
+    {
+        ++text;
+    }
+    return text;
+}
+
+// Parses the digits at text, advancing it past them
+static bool ParseDecimal(_Inout_ const char** text, _Out_ uint64_t* value)
+{
+    const char* p = *text;
+    *value = 0;
+    if (*p < '0' || *p > '9')
+    {
+        return false;
+    }
+
+    for (; *p >= '0' && *p <= '9'; ++p)
+    {
+        uint64_t digit = static_cast<uint64_t>(*p - '0');
+        if (*value > (UINT64_MAX - digit) / 10)
+        {
+            return false;
+        }
+        *value = *value * 10 + digit;
+    }
+
+    *text = p;
+    return true;
+}
+
+static bool ParseContentLength(_In_opt_z_ const char* value, _Out_ uint64_t* length)
+{
+    *length = 0;
+    if (value == nullptr)
+    {
+        return false;
+    }
+
+    const char* p = SkipSpaces(value);
+    return ParseDecimal(&p, length) && *SkipSpaces(p) == '\0';
+}
+
+// "bytes first-last/completeLength" (RFC 7233 section 4.2)
+static bool ParseContentRange(_In_opt_z_ const char* value, _Out_ uint64_t* first, _Out_ uint64_t* last, _Out_ uint64_t* completeLength)
+{
+    *first = *last = *completeLength = 0;
+    if (value == nullptr)
+    {
+        return false;
+    }
+
+    const char* p = SkipSpaces(value);
+    if (str_icmp(http_internal_string{ p, std::min<size_t>(strlen(p), 6) }, "bytes ") != 0)
+    {
+        return false;
+    }
+
+    p = SkipSpaces(p + 6);
+    if (!ParseDecimal(&p, first) || *p++ != '-' || !ParseDecimal(&p, last) || *p++ != '/' || !ParseDecimal(&p, completeLength))
+    {
+        return false;
+    }
+    return *SkipSpaces(p) == '\0' && *first <= *last && *last < *completeLength;
+}
+
+// "bytes */completeLength", sent with 416 when the range starts past the end of the body
+static bool ParseUnsatisfiedContentRange(_In_opt_z_ const char* value, _Out_ uint64_t* completeLength)
+{
+    *completeLength = 0;
+    if (value == nullptr)
+    {
+        return false;
+    }
+
+    const char* p = SkipSpaces(value);
+    if (str_icmp(http_internal_string{ p, std::min<size_t>(strlen(p), 6) }, "bytes ") != 0)
+    {
+        return false;
+    }
+
+    p = SkipSpaces(p + 6);
+    if (*p++ != '*' || *p++ != '/' || !ParseDecimal(&p, completeLength))
+    {
+        return false;
+    }
+    return *SkipSpaces(p) == '\0';
+}
+
+// The value If-Range can be guarded with. A weak ETag can't be used with If-Range, in which case the date has to do.
+static const char* FindValidator(_In_ http_header_map const& headers)
+{
+    const char* etag = FindHeader(headers, ETAG_HEADER);
+    if (etag != nullptr && strncmp(etag, "W/", 2) != 0)
+    {
+        return etag;
+    }
+    return FindHeader(headers, LAST_MODIFIED_HEADER);
+}
+
+static bool AcceptsByteRanges(_In_opt_z_ const char* value)
+{
+    if (value == nullptr)
+    {
+        return false;
+    }
+
+    http_internal_stringstream units{ http_internal_string{ value } };
+    http_internal_string unit;
+    while (std::getline(units, unit, ','))
+    {
+        size_t start = unit.find_first_not_of(" \t");
+        size_t end = unit.find_last_not_of(" \t");
+        if (start != http_internal_string::npos && str_icmp(unit.substr(start, end - start + 1), "bytes") == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+http_range_download::child_attempt::~child_attempt()
+{
+    if (call != nullptr)
+    {
+        HCHttpCallCloseHandle(call);
+    }
+    if (asyncBlock.queue != nullptr)
+    {
+        XTaskQueueCloseHandle(asyncBlock.queue);
+    }
+}
+
+http_range_download::http_range_download(_In_ HC_UNIQUE_PTR<retry_context> retryContext) noexcept :
+    m_retryContext{ std::move(retryContext) },
+    m_call{ m_retryContext->call->get() }
+{
+}
+
+http_range_download::~http_range_download()
+{
+    if (m_failedCall != nullptr)
+    {
+        HCHttpCallCloseHandle(m_failedCall);
+    }
+}
+
+bool http_range_download::IsEnabled(_In_ HCCallHandle call) noexcept
+{
+    // Decoding and sequential write functions need the body in order
+    if (call->parallelRangeSegmentCount < 2 || call->decompressResponse ||
+        (call->responseBodyWriteFunction != DefaultResponseBodyWriteFunction && call->responseBodyWriteFunction != ResponseBodyWriteAtFunctionAdapter))
+    {
+        return false;
+    }
+
+    // A download resumed from a checkpoint continues in one response
+    return call->method == "GET" && call->requestHeaders.get().find(RANGE_HEADER) == call->requestHeaders.get().end() &&
+        http_resumable_download::ResumeOffset(call) == 0;
+}
+
+void http_range_download::Start(_In_ HC_UNIQUE_PTR<retry_context> retryContext) noexcept
+{
+    std::shared_ptr<http_range_download> download;
+    try
+    {
+        download = http_allocate_shared<http_range_download>(std::move(retryContext));
+    }
+    catch (...)
+    {
+    }
+
+    if (download == nullptr)
+    {
+        retry_http_call_until_done(std::move(retryContext));
+        return;
+    }
+
+    if (!http_call_set_cancel_handler(download->m_call, OnCancel, download.get()))
+    {
+        download->m_result = E_ABORT;
+        download->Finish();
+        return;
+    }
+
+    HRESULT hr = download->StartAttempt(nullptr);
+    if (FAILED(hr))
+    {
+        bool stopping = false;
+        {
+            std::lock_guard<std::recursive_mutex> lock{ download->m_lock };
+            stopping = download->m_stopping;
+            download->m_finished = true;
+        }
+
+        if (stopping)
+        {
+            download->Finish();
+        }
+        else
+        {
+            download->PerformWhole();
+        }
+    }
+}
+
+HRESULT http_range_download::StartAttempt(_In_opt_ range_segment* segment) noexcept
+try
+{
+    auto attempt = http_allocate_unique<child_attempt>();
+    attempt->download = shared_from_this();
+    attempt->segment = segment;
+    RETURN_IF_FAILED(HCHttpCallCreate(&attempt->call));
+
+    HC_CALL* call = attempt->call;
+    call->method = segment != nullptr ? "GET" : "HEAD";
+    call->url = m_call->url;
+    call->requestHeaders.mutate() = m_call->requestHeaders.get();
+    call->traceCall = m_call->traceCall;
+    call->httpVersion = m_call->httpVersion;
+    call->priority = m_call->priority;
+    call->timeoutInSeconds = m_call->timeoutInSeconds;
+    call->timeoutWindowInSeconds = m_call->timeoutWindowInSeconds;
+    call->retryDelayInSeconds = m_call->retryDelayInSeconds;
+#if HC_PLATFORM == HC_PLATFORM_WIN32 || HC_PLATFORM == HC_PLATFORM_GDK
+    call->sslValidation = m_call->sslValidation;
+#endif
+    call->decompressResponse = false;
+    call->compressionLevel = HCCompressionLevel::None;
+
+    // Segments retry themselves, asking for the bytes they are still missing
+    call->retryAllowed = segment == nullptr && m_call->retryAllowed;
+
+    if (segment != nullptr)
+    {
+        segment->attemptStart = segment->received;
+        ++segment->attempts;
+
+        char range[64];
+        snprintf(range, sizeof(range), "bytes=%llu-%llu", TO_ULL(segment->offset + segment->received), TO_ULL(segment->offset + segment->length - 1));
+        call->requestHeaders.mutate()[RANGE_HEADER] = range;
+        if (!m_validator.empty())
+        {
+            call->requestHeaders.mutate()[IF_RANGE_HEADER] = m_validator.c_str();
+        }
+        call->responseBodyWriteFunction = WriteSegment;
+        call->responseBodyWriteFunctionContext = segment;
+    }
+
+    XTaskQueueHandle queue = nullptr;
+    if (m_retryContext->outerQueue != nullptr)
+    {
+        XTaskQueuePortHandle workPort;
+        XTaskQueueGetPort(m_retryContext->outerQueue, XTaskQueuePort::Work, &workPort);
+        XTaskQueueCreateComposite(workPort, workPort, &queue);
+    }
+    attempt->asyncBlock.queue = queue;
+    attempt->asyncBlock.context = attempt.get();
+    attempt->asyncBlock.callback = OnChildComplete;
+
+    // Started under the lock so a cancel either sees the attempt or stops it from starting
+    std::lock_guard<std::recursive_mutex> lock{ m_lock };
+    if (m_stopping)
+    {
+        return E_ABORT;
+    }
+    m_inFlight.push_back(&attempt->asyncBlock);
+
+    // Owned by OnChildComplete from here on, which may run before HCHttpCallPerformAsync returns
+    child_attempt* started = attempt.release();
+    HRESULT hr = HCHttpCallPerformAsync(started->call, &started->asyncBlock);
+    if (FAILED(hr))
+    {
+        HC_UNIQUE_PTR<child_attempt> failed{ started };
+        m_inFlight.erase(std::find(m_inFlight.begin(), m_inFlight.end(), &started->asyncBlock));
+        return hr;
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+void CALLBACK http_range_download::OnChildComplete(_In_ XAsyncBlock* asyncBlock)
+{
+    HC_UNIQUE_PTR<child_attempt> attempt{ static_cast<child_attempt*>(asyncBlock->context) };
+    HRESULT hr = XAsyncGetStatus(asyncBlock, false);
+    http_range_download& download = *attempt->download;
+
+    if (attempt->segment != nullptr)
+    {
+        download.OnSegmentComplete(*attempt->segment, attempt->call, hr);
+    }
+    else
+    {
+        download.OnProbeComplete(attempt->call, hr);
+    }
+}
+
+void http_range_download::OnProbeComplete(_In_ HCCallHandle call, _In_ HRESULT hr) noexcept
+{
+    bool finish = false;
+    bool started = false;
+    {
+        std::lock_guard<std::recursive_mutex> lock{ m_lock };
+        m_inFlight.clear();
+
+        if (!m_stopping && SUCCEEDED(hr))
+        {
+            HRESULT beginResult = BeginSegments(call, &started);
+            if (FAILED(beginResult))
+            {
+                Fail(nullptr, beginResult);
+            }
+        }
+
+        if (m_stopping)
+        {
+            finish = ShouldFinish();
+            started = true;
+        }
+    }
+
+    // Anything short of a ranged download leaves the call to be performed as usual
+    if (finish)
+    {
+        Finish();
+    }
+    else if (!started)
+    {
+        PerformWhole();
+    }
+}
+
+HRESULT http_range_download::BeginSegments(_In_ HCCallHandle probe, _Out_ bool* started) noexcept
+try
+{
+    *started = false;
+    auto const& headers = probe->responseHeaders.get();
+    uint64_t contentLength = 0;
+    if (probe->networkErrorCode != S_OK || probe->statusCode != 200 ||
+        !AcceptsByteRanges(FindHeader(headers, ACCEPT_RANGES_HEADER)) ||
+        !ParseContentLength(FindHeader(headers, CONTENT_LENGTH_HEADER), &contentLength))
+    {
+        return S_OK;
+    }
+
+    uint64_t segmentCount = std::min<uint64_t>(m_call->parallelRangeSegmentCount, contentLength / m_call->parallelRangeMinSegmentSize);
+    if (segmentCount < 2 || contentLength > SIZE_MAX)
+    {
+        return S_OK;
+    }
+
+    const char* validator = FindValidator(headers);
+    if (validator != nullptr)
+    {
+        m_validator = validator;
+    }
+
+    if (m_call->responseBodyWriteFunction == DefaultResponseBodyWriteFunction)
+    {
+        auto& body = m_call->responseBodyBytes.mutate();
+        body.resize(static_cast<size_t>(contentLength));
+        m_buffer = body.data();
+    }
+
+    m_contentLength = contentLength;
+    m_statusCode = probe->statusCode;
+    m_responseHeaders = headers;
+
+    uint64_t segmentLength = contentLength / segmentCount;
+    m_segments.reserve(static_cast<size_t>(segmentCount));
+    for (uint64_t i = 0; i < segmentCount; ++i)
+    {
+        uint64_t offset = i * segmentLength;
+        uint64_t length = i + 1 < segmentCount ? segmentLength : contentLength - offset;
+        m_segments.push_back(range_segment{ this, offset, length, 0, 0, 0 });
+    }
+
+    if (m_call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallPerform [ID %llu] downloading %llu bytes in %llu ranges", TO_ULL(m_call->id), TO_ULL(contentLength), TO_ULL(segmentCount)); }
+
+    *started = true;
+    for (auto& segment : m_segments)
+    {
+        RETURN_IF_FAILED(StartAttempt(&segment));
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+void http_range_download::OnSegmentComplete(_In_ range_segment& segment, _In_ HCCallHandle call, _In_ HRESULT hr) noexcept
+{
+    bool finish = false;
+    {
+        std::lock_guard<std::recursive_mutex> lock{ m_lock };
+        auto inFlight = std::find_if(m_inFlight.begin(), m_inFlight.end(), [call](XAsyncBlock* block)
+        {
+            return static_cast<child_attempt*>(block->context)->call == call;
+        });
+        if (inFlight != m_inFlight.end())
+        {
+            m_inFlight.erase(inFlight);
+        }
+
+        // Bytes only count once the response is known to be for the range that was asked for
+        uint64_t first = 0;
+        uint64_t last = 0;
+        uint64_t completeLength = 0;
+        bool rangeMatches = call->statusCode == 206 &&
+            ParseContentRange(FindHeader(call->responseHeaders.get(), CONTENT_RANGE_HEADER), &first, &last, &completeLength) &&
+            first == segment.offset + segment.attemptStart &&
+            last == segment.offset + segment.length - 1 &&
+            completeLength == m_contentLength;
+        if (!rangeMatches)
+        {
+            segment.received = segment.attemptStart;
+        }
+
+        bool connectionFailed = call->networkErrorCode != S_OK && call->statusCode == 0;
+        if (m_stopping)
+        {
+        }
+        else if (FAILED(hr))
+        {
+            Fail(nullptr, hr);
+        }
+        else if (rangeMatches && call->networkErrorCode == S_OK && segment.received == segment.length)
+        {
+            ++m_completedSegments;
+        }
+        else if ((rangeMatches || connectionFailed) && m_call->retryAllowed && segment.attempts < MAX_SEGMENT_ATTEMPTS)
+        {
+            if (m_call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallPerform [ID %llu] retrying range at %llu after %llu of %llu bytes", TO_ULL(m_call->id), TO_ULL(segment.offset), TO_ULL(segment.received), TO_ULL(segment.length)); }
+            HRESULT startResult = StartAttempt(&segment);
+            if (FAILED(startResult))
+            {
+                Fail(nullptr, startResult);
+            }
+        }
+        else
+        {
+            // e.g. a 200 with the whole body, because the server stopped serving ranges or the resource changed
+            if (!rangeMatches && call->networkErrorCode == S_OK && call->statusCode >= 200 && call->statusCode < 300)
+            {
+                call->networkErrorCode = E_HC_RANGE_MISMATCH;
+            }
+            Fail(call, hr);
+        }
+
+        finish = ShouldFinish();
+    }
+
+    if (finish)
+    {
+        Finish();
+    }
+}
+
+void http_range_download::Fail(_In_opt_ HCCallHandle call, _In_ HRESULT hr) noexcept
+{
+    if (!m_stopping)
+    {
+        m_stopping = true;
+        m_result = hr;
+        if (call != nullptr)
+        {
+            m_failedCall = HCHttpCallDuplicateHandle(call);
+        }
+    }
+
+    // Backwards, since a canceled child can complete inline and drop out of the list
+    for (size_t i = m_inFlight.size(); i > 0; --i)
+    {
+        if (i <= m_inFlight.size())
+        {
+            XAsyncCancel(m_inFlight[i - 1]);
+        }
+    }
+}
+
+bool http_range_download::ShouldFinish() noexcept
+{
+    if (m_finished || !m_inFlight.empty() || (!m_stopping && m_completedSegments < m_segments.size()))
+    {
+        return false;
+    }
+
+    m_finished = true;
+    return true;
+}
+
+void http_range_download::Finish() noexcept
+{
+    http_call_clear_cancel_handler(m_call);
+
+    HRESULT hr = m_result;
+    if (m_failedCall != nullptr)
+    {
+        m_call->statusCode = m_failedCall->statusCode;
+        m_call->networkErrorCode = m_failedCall->networkErrorCode;
+        m_call->platformNetworkErrorCode = m_failedCall->platformNetworkErrorCode;
+        m_call->platformNetworkErrorMessage = m_failedCall->platformNetworkErrorMessage;
+        m_call->responseHeaders.share(m_failedCall->responseHeaders.freeze());
+        m_call->responseBodyBytes.clear();
+    }
+    else if (SUCCEEDED(hr))
+    {
+        m_call->statusCode = m_statusCode;
+        m_call->responseHeaders.mutate() = std::move(m_responseHeaders);
+    }
+    else
+    {
+        m_call->responseBodyBytes.clear();
+    }
+
+    if (m_call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallPerform [ID %llu] range download done: %08X, status %u", TO_ULL(m_call->id), hr, m_call->statusCode); }
+    XAsyncComplete(m_retryContext->outerAsyncBlock, hr, 0);
+}
+
+void http_range_download::PerformWhole() noexcept
+{
+    http_call_clear_cancel_handler(m_call);
+    if (m_call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallPerform [ID %llu] ranges not available, downloading in one response", TO_ULL(m_call->id)); }
+    retry_http_call_until_done(std::move(m_retryContext));
+}
+
+void http_range_download::OnCancel(_In_ HCCallHandle /*call*/, _In_opt_ void* context)
+{
+    auto download = static_cast<http_range_download*>(context)->shared_from_this();
+    std::lock_guard<std::recursive_mutex> lock{ download->m_lock };
+    download->Fail(nullptr, E_ABORT);
+}
+
+HRESULT http_range_download::Write(_In_ uint64_t offset, _In_reads_bytes_(size) const uint8_t* source, _In_ size_t size) noexcept
+{
+    if (m_buffer != nullptr)
+    {
+        memcpy(m_buffer + offset, source, size);
+        return S_OK;
+    }
+    return m_call->responseBodyWriteAtFunction(m_call, offset, source, size, m_call->responseBodyWriteFunctionContext);
+}
+
+HRESULT CALLBACK http_range_download::WriteSegment(
+    _In_ HCCallHandle call,
+    _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context
+    ) noexcept
+{
+    // Nothing but the range asked for is written, so a response for anything else can't overwrite other ranges
+    auto& segment = *static_cast<range_segment*>(context);
+    if ((call->statusCode != 0 && call->statusCode != 206) || bytesAvailable > segment.length - segment.received)
+    {
+        return E_HC_RANGE_MISMATCH;
+    }
+
+    HRESULT hr = segment.download->Write(segment.offset + segment.received, source, bytesAvailable);
+    if (SUCCEEDED(hr))
+    {
+        segment.received += bytesAvailable;
+    }
+    return hr;
+}
+
+HRESULT http_resumable_download::Enable(_In_ HCCallHandle call) noexcept
+try
+{
+    if (call->resumableDownload == nullptr)
+    {
+        call->resumableDownload = http_allocate_shared<http_resumable_download>();
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+HRESULT http_resumable_download::Attach(_In_ HCCallHandle call) noexcept
+try
+{
+    auto download = call->resumableDownload.get();
+    if (download == nullptr)
+    {
+        return S_OK;
+    }
+
+    // A decoded body has no byte offsets to resume from
+    if (call->decompressResponse || call->method != "GET" || call->requestHeaders.get().find(RANGE_HEADER) != call->requestHeaders.get().end())
+    {
+        if (call->traceCall) { HC_TRACE_WARNING(HTTPCLIENT, "HCHttpCallPerform [ID %llu] can't be resumed, performing it as usual", TO_ULL(call->id)); }
+        return S_OK;
+    }
+
+    download->m_attemptOffset = download->Progress();
+    download->m_offset = download->m_attemptOffset;
+    if (download->m_attemptOffset > 0)
+    {
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%llu-", TO_ULL(download->m_attemptOffset));
+        call->requestHeaders.mutate()[RANGE_HEADER] = range;
+        call->requestHeaders.mutate()[IF_RANGE_HEADER] = download->m_validator.c_str();
+        download->m_addedRangeHeaders = true;
+        if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallPerform [ID %llu] resuming at byte %llu", TO_ULL(call->id), TO_ULL(download->m_attemptOffset)); }
+    }
+
+    // A positional write function continues at the resumed offset, including one saved by an earlier process
+    call->responseBodyWriteAtOffset = download->m_attemptOffset;
+
+    download->m_state = attempt_state::notStarted;
+    download->m_heldBody.clear();
+    download->m_writeFunction = call->responseBodyWriteFunction;
+    download->m_writeContext = call->responseBodyWriteFunctionContext;
+    call->responseBodyWriteFunction = WriteFunction;
+    call->responseBodyWriteFunctionContext = download;
+    download->m_attached = true;
+    return S_OK;
+}
+CATCH_RETURN()
+
+void http_resumable_download::Detach(_In_ HCCallHandle call) noexcept
+{
+    auto download = call->resumableDownload.get();
+    if (download == nullptr || !download->m_attached)
+    {
+        return;
+    }
+
+    download->m_attached = false;
+    call->responseBodyWriteFunction = download->m_writeFunction;
+    call->responseBodyWriteFunctionContext = download->m_writeContext;
+
+    try
+    {
+        // A response without a body never reached the write function, and a provider that sets the status
+        // only once the body is done has had its body held back until now
+        if (download->m_state == attempt_state::notStarted)
+        {
+            HRESULT hr = download->OnResponseStart(call);
+            if (SUCCEEDED(hr) && !download->m_heldBody.empty())
+            {
+                hr = download->Deliver(call, download->m_heldBody.data(), download->m_heldBody.size());
+            }
+            if (FAILED(hr) && call->networkErrorCode == S_OK)
+            {
+                call->networkErrorCode = hr;
+            }
+        }
+        download->m_heldBody = http_body_bytes{};
+
+        if (download->m_addedRangeHeaders)
+        {
+            call->requestHeaders.mutate().erase(RANGE_HEADER);
+            call->requestHeaders.mutate().erase(IF_RANGE_HEADER);
+            download->m_addedRangeHeaders = false;
+        }
+
+        // Pieced together, the body looks as if it had arrived in one response
+        bool finished = download->m_state == attempt_state::complete ||
+            (download->m_state == attempt_state::continuation && call->networkErrorCode == S_OK);
+        if (finished)
+        {
+            uint64_t length = download->m_totalLength != 0 ? download->m_totalLength : download->m_offset;
+            auto& headers = call->responseHeaders.mutate();
+            headers.erase(CONTENT_RANGE_HEADER);
+            headers[CONTENT_LENGTH_HEADER] = std::to_string(length).c_str();
+            call->statusCode = 200;
+        }
+
+        download->ReportCheckpoint(call);
+    }
+    catch (...)
+    {
+        if (call->networkErrorCode == S_OK)
+        {
+            call->networkErrorCode = E_OUTOFMEMORY;
+        }
+    }
+}
+
+uint64_t http_resumable_download::ResumeOffset(_In_ HCCallHandle call) noexcept
+{
+    return call->resumableDownload != nullptr ? call->resumableDownload->Progress() : 0;
+}
+
+void http_resumable_download::SetCheckpoint(_In_ const HCResumeCheckpoint& checkpoint)
+{
+    m_validator = checkpoint.validator;
+    m_offset = checkpoint.offset;
+    m_totalLength = checkpoint.totalLength;
+    m_reportedOffset = m_offset;
+    m_reportedValidator = m_validator;
+}
+
+void http_resumable_download::SetCheckpointFunction(
+    _In_opt_ HCHttpCallResumeCheckpointFunction checkpointFunction,
+    _In_ uint64_t intervalBytes,
+    _In_opt_ void* context
+    ) noexcept
+{
+    m_checkpointFunction = checkpointFunction;
+    m_checkpointInterval = intervalBytes;
+    m_checkpointContext = context;
+}
+
+HRESULT http_resumable_download::OnResponseStart(_In_ HCCallHandle call)
+{
+    auto const& headers = call->responseHeaders.get();
+    uint32_t statusCode = call->statusCode;
+
+    if (m_attemptOffset == 0)
+    {
+        if (statusCode == 200)
+        {
+            AdoptValidator(headers);
+            m_state = attempt_state::counted;
+        }
+        else
+        {
+            m_state = attempt_state::passThrough;
+        }
+        return S_OK;
+    }
+
+    if (statusCode == 206)
+    {
+        uint64_t first = 0;
+        uint64_t last = 0;
+        uint64_t completeLength = 0;
+        if (ParseContentRange(FindHeader(headers, CONTENT_RANGE_HEADER), &first, &last, &completeLength) &&
+            first == m_attemptOffset && last == completeLength - 1 && (m_totalLength == 0 || m_totalLength == completeLength))
+        {
+            m_totalLength = completeLength;
+            m_state = attempt_state::continuation;
+            return S_OK;
+        }
+    }
+    else if (statusCode == 200)
+    {
+        // The resource changed, or the server ignored the range, so the body starts over
+        if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallPerform [ID %llu] resume refused, downloading from byte 0", TO_ULL(call->id)); }
+        if (m_writeFunction == DefaultResponseBodyWriteFunction || m_writeFunction == ResponseBodyWriteAtFunctionAdapter)
+        {
+            call->responseBodyBytes.clear();
+            call->responseBodyWriteAtOffset = 0;
+            m_attemptOffset = 0;
+            m_offset = 0;
+            AdoptValidator(headers);
+            ReportCheckpoint(call);
+            m_state = attempt_state::counted;
+            return S_OK;
+        }
+    }
+    else if (statusCode == 416)
+    {
+        // A download saved just as it finished has nothing left to ask for
+        uint64_t completeLength = 0;
+        if (ParseUnsatisfiedContentRange(FindHeader(headers, CONTENT_RANGE_HEADER), &completeLength) && completeLength == m_attemptOffset)
+        {
+            m_totalLength = completeLength;
+            m_state = attempt_state::complete;
+            return S_OK;
+        }
+        m_state = attempt_state::dropped;
+        return S_OK;
+    }
+    else
+    {
+        m_state = attempt_state::dropped;
+        return S_OK;
+    }
+
+    // The bytes already delivered can't be matched up with this response, so the download has to start over
+    if (call->traceCall) { HC_TRACE_ERROR(HTTPCLIENT, "HCHttpCallPerform [ID %llu] response doesn't continue the download at byte %llu", TO_ULL(call->id), TO_ULL(m_attemptOffset)); }
+    m_offset = 0;
+    m_totalLength = 0;
+    m_validator.clear();
+    m_state = attempt_state::mismatch;
+    return E_HC_RANGE_MISMATCH;
+}
+
+void http_resumable_download::AdoptValidator(_In_ http_header_map const& headers)
+{
+    uint64_t contentLength = 0;
+    const char* validator = FindValidator(headers);
+    const char* acceptRanges = FindHeader(headers, ACCEPT_RANGES_HEADER);
+    bool refusesRanges = acceptRanges != nullptr && !AcceptsByteRanges(acceptRanges);
+
+    m_validator = validator != nullptr && !refusesRanges ? validator : "";
+    m_totalLength = ParseContentLength(FindHeader(headers, CONTENT_LENGTH_HEADER), &contentLength) ? contentLength : 0;
+}
+
+uint64_t http_resumable_download::Progress() const noexcept
+{
+    // Without a validator a retry can't tell whether the resource changed
+    return m_validator.empty() ? 0 : m_offset;
+}
+
+void http_resumable_download::ReportCheckpoint(_In_ HCCallHandle call)
+{
+    uint64_t progress = Progress();
+    if (m_checkpointFunction == nullptr || (progress == m_reportedOffset && m_validator == m_reportedValidator))
+    {
+        return;
+    }
+
+    m_reportedOffset = progress;
+    m_reportedValidator = m_validator;
+    HCResumeCheckpoint checkpoint{ progress, m_totalLength, m_validator.c_str() };
+    m_checkpointFunction(call, &checkpoint, m_checkpointContext);
+}
+
+HRESULT http_resumable_download::Forward(_In_ HCCallHandle call, _In_reads_bytes_(size) const uint8_t* source, _In_ size_t size)
+{
+    if (m_writeFunction != DefaultResponseBodyWriteFunction)
+    {
+        return m_writeFunction(call, source, size, m_writeContext);
+    }
+
+    // HCHttpCallResponseAppendResponseBodyBytes refuses to append while a custom write function is installed
+    auto& responseBody = call->responseBodyBytes.mutate();
+    responseBody.insert(responseBody.end(), source, source + size);
+    call->responseString.clear();
+    return S_OK;
+}
+
+HRESULT http_resumable_download::Deliver(_In_ HCCallHandle call, _In_reads_bytes_(size) const uint8_t* source, _In_ size_t size)
+{
+    switch (m_state)
+    {
+        case attempt_state::mismatch:
+            return E_HC_RANGE_MISMATCH;
+
+        case attempt_state::dropped:
+        case attempt_state::complete:
+            return S_OK;
+
+        case attempt_state::passThrough:
+            return Forward(call, source, size);
+
+        default:
+        {
+            RETURN_IF_FAILED(Forward(call, source, size));
+            m_offset += size;
+            if (m_checkpointInterval != 0 && Progress() >= m_reportedOffset + m_checkpointInterval)
+            {
+                ReportCheckpoint(call);
+            }
+            return S_OK;
+        }
+    }
+}
+
+HRESULT CALLBACK http_resumable_download::WriteFunction(
+    _In_ HCCallHandle call,
+    _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context
+    ) noexcept
+try
+{
+    auto download = static_cast<http_resumable_download*>(context);
+    if (download->m_state == attempt_state::notStarted)
+    {
+        // Without the status there's no telling whether the bytes continue the download, so they wait for it
+        if (call->statusCode == 0)
+        {
+            download->m_heldBody.insert(download->m_heldBody.end(), source, source + bytesAvailable);
+            return S_OK;
+        }
+        RETURN_IF_FAILED(download->OnResponseStart(call));
+        if (!download->m_heldBody.empty())
+        {
+            http_body_bytes held{ std::move(download->m_heldBody) };
+            download->m_heldBody.clear();
+            RETURN_IF_FAILED(download->Deliver(call, held.data(), held.size()));
+        }
+    }
+
+    return download->Deliver(call, source, bytesAvailable);
+}
+CATCH_RETURN()
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
@@ -0,0 +1,158 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+#include "pch.h"
+#include "httpcall.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+// Performs a GET set up with HCHttpCallRequestSetParallelRanges. A HEAD request finds out whether the server serves
+// byte ranges and how long the body is; if it is long enough, segments of it are fetched concurrently by child calls
+// that write straight into their offset of the call's preallocated body buffer, or of its positional write function.
+// Otherwise the call is performed as usual.
+class http_range_download : public std::enable_shared_from_this<http_range_download>
+{
+public:
+    // Whether the call asked for parallel ranges and nothing it was set up with rules them out
+    static bool IsEnabled(_In_ HCCallHandle call) noexcept;
+
+    // Takes over performing the call, completing the outer async block of the retry context either way
+    static void Start(_In_ HC_UNIQUE_PTR<retry_context> retryContext) noexcept;
+
+    http_range_download(_In_ HC_UNIQUE_PTR<retry_context> retryContext) noexcept;
+    http_range_download(const http_range_download&) = delete;
+    http_range_download& operator=(const http_range_download&) = delete;
+    ~http_range_download();
+
+    // Attempts per segment; each one after the first asks for the bytes the previous ones didn't deliver
+    static constexpr uint32_t MAX_SEGMENT_ATTEMPTS = 3;
+
+private:
+    struct range_segment
+    {
+        http_range_download* download;
+        uint64_t offset;
+        uint64_t length;
+        uint64_t received;      // bytes written so far, which the next attempt doesn't ask for again
+        uint64_t attemptStart;  // received when the current attempt started
+        uint32_t attempts;
+    };
+
+    // A child call in flight. The segment is null for the HEAD request.
+    struct child_attempt
+    {
+        ~child_attempt();
+
+        std::shared_ptr<http_range_download> download;
+        range_segment* segment{ nullptr };
+        HCCallHandle call{ nullptr };
+        XAsyncBlock asyncBlock{};
+    };
+
+    HRESULT StartAttempt(_In_opt_ range_segment* segment) noexcept;
+    void OnProbeComplete(_In_ HCCallHandle call, _In_ HRESULT hr) noexcept;
+    HRESULT BeginSegments(_In_ HCCallHandle probe, _Out_ bool* started) noexcept;
+    void OnSegmentComplete(_In_ range_segment& segment, _In_ HCCallHandle call, _In_ HRESULT hr) noexcept;
+    void Fail(_In_opt_ HCCallHandle call, _In_ HRESULT hr) noexcept;
+    bool ShouldFinish() noexcept;
+    void Finish() noexcept;
+    void PerformWhole() noexcept;
+    HRESULT Write(_In_ uint64_t offset, _In_reads_bytes_(size) const uint8_t* source, _In_ size_t size) noexcept;
+
+    static void CALLBACK OnChildComplete(_In_ XAsyncBlock* asyncBlock);
+    static void OnCancel(_In_ HCCallHandle call, _In_opt_ void* context);
+    static HRESULT CALLBACK WriteSegment(
+        _In_ HCCallHandle call,
+        _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+        _In_ size_t bytesAvailable,
+        _In_opt_ void* context
+        ) noexcept;
+
+    HC_UNIQUE_PTR<retry_context> m_retryContext;
+    HC_CALL* m_call;
+
+    // Recursive because canceling a child can complete it inline on the canceling thread
+    std::recursive_mutex m_lock;
+    http_internal_vector<range_segment> m_segments; // sized once, so child calls can point into it
+    http_internal_vector<XAsyncBlock*> m_inFlight;
+    size_t m_completedSegments{ 0 };
+    uint64_t m_contentLength{ 0 };
+    http_internal_string m_validator;
+    http_header_map m_responseHeaders;
+    uint32_t m_statusCode{ 0 };
+    uint8_t* m_buffer{ nullptr };
+    bool m_stopping{ false };
+    bool m_finished{ false };
+
+    // The outcome of a download that stopped early, and the child call whose response it reports
+    HRESULT m_result{ S_OK };
+    HCCallHandle m_failedCall{ nullptr };
+};
+
+// Keeps the progress of a call set up with HCHttpCallRequestSetResumable across its attempts, so that a retry only
+// asks for the part of the body the previous attempts didn't deliver. Like the compressors it is attached around each
+// attempt, where it stands between the provider and the call's response write function.
+class http_resumable_download
+{
+public:
+    // Makes the call resumable, if it isn't already
+    static HRESULT Enable(_In_ HCCallHandle call) noexcept;
+
+    static HRESULT Attach(_In_ HCCallHandle call) noexcept;
+    static void Detach(_In_ HCCallHandle call) noexcept;
+
+    // The body bytes kept for the next attempt, or 0 if it starts over
+    static uint64_t ResumeOffset(_In_ HCCallHandle call) noexcept;
+
+    void SetCheckpoint(_In_ const HCResumeCheckpoint& checkpoint);
+    void SetCheckpointFunction(_In_opt_ HCHttpCallResumeCheckpointFunction checkpointFunction, _In_ uint64_t intervalBytes, _In_opt_ void* context) noexcept;
+
+private:
+    // What the response to the current attempt means for the download
+    enum class attempt_state
+    {
+        notStarted,     // no response yet
+        passThrough,    // not a body to resume, e.g. an error response to a first attempt
+        counted,        // the body from offset 0
+        continuation,   // the rest of the body
+        complete,       // nothing left to download
+        dropped,        // an error response to a resumed attempt
+        mismatch        // a response that can't be delivered
+    };
+
+    HRESULT OnResponseStart(_In_ HCCallHandle call);
+    void AdoptValidator(_In_ http_header_map const& headers);
+    uint64_t Progress() const noexcept;
+    void ReportCheckpoint(_In_ HCCallHandle call);
+    HRESULT Forward(_In_ HCCallHandle call, _In_reads_bytes_(size) const uint8_t* source, _In_ size_t size);
+    HRESULT Deliver(_In_ HCCallHandle call, _In_reads_bytes_(size) const uint8_t* source, _In_ size_t size);
+
+    static HRESULT CALLBACK WriteFunction(
+        _In_ HCCallHandle call,
+        _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+        _In_ size_t bytesAvailable,
+        _In_opt_ void* context
+        ) noexcept;
+
+    uint64_t m_offset{ 0 };
+    uint64_t m_totalLength{ 0 };
+    http_internal_string m_validator;
+
+    HCHttpCallResumeCheckpointFunction m_checkpointFunction{ nullptr };
+    void* m_checkpointContext{ nullptr };
+    uint64_t m_checkpointInterval{ 0 };
+    uint64_t m_reportedOffset{ 0 };
+    http_internal_string m_reportedValidator;
+
+    // The attempt in flight
+    bool m_attached{ false };
+    HCHttpCallResponseBodyWriteFunction m_writeFunction{ nullptr };
+    void* m_writeContext{ nullptr };
+    uint64_t m_attemptOffset{ 0 };
+    attempt_state m_state{ attempt_state::notStarted };
+    http_body_bytes m_heldBody;
+    bool m_addedRangeHeaders{ false };
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
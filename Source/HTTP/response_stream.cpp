@@ -0,0 +1,707 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "response_stream.h"
+
+#define ACCEPT_HEADER ("Accept")
+#define CONTENT_TYPE_HEADER ("Content-Type")
+#define LAST_EVENT_ID_HEADER ("Last-Event-ID")
+#define EVENT_STREAM_MEDIA_TYPE ("text/event-stream")
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+namespace
+{
+
+const uint8_t UTF8_BYTE_ORDER_MARK[] = { 0xEF, 0xBB, 0xBF };
+
+bool FieldIs(_In_reads_(size) const char* field, _In_ size_t size, _In_z_ const char* name) noexcept
+{
+    return size == strlen(name) && memcmp(field, name, size) == 0;
+}
+
+uint32_t ReadRecordLength(_In_reads_bytes_(4) const uint8_t* header) noexcept
+{
+    return (static_cast<uint32_t>(header[0]) << 24) | (static_cast<uint32_t>(header[1]) << 16) |
+        (static_cast<uint32_t>(header[2]) << 8) | static_cast<uint32_t>(header[3]);
+}
+
+}
+
+http_stream_framer::http_stream_framer(_In_ HCResponseStreamFormat format) noexcept :
+    m_format{ format }
+{
+}
+
+HRESULT http_stream_framer::Write(
+    _In_reads_bytes_(size) const uint8_t* data,
+    _In_ size_t size,
+    _In_ record_function recordFunction,
+    _In_opt_ void* context
+    )
+{
+    // An event stream may start with a byte order mark, which isn't part of the first line
+    if (m_format == HCResponseStreamFormat::ServerSentEvents)
+    {
+        while (!m_started && size > 0)
+        {
+            if (data[0] != UTF8_BYTE_ORDER_MARK[m_byteOrderMarkMatched])
+            {
+                m_started = true;
+                break;
+            }
+            ++data;
+            --size;
+            m_started = ++m_byteOrderMarkMatched == sizeof(UTF8_BYTE_ORDER_MARK);
+        }
+    }
+
+    if (m_format == HCResponseStreamFormat::LengthPrefixed)
+    {
+        return WriteLengthPrefixed(data, size, recordFunction, context);
+    }
+    return WriteLines(data, size, recordFunction, context);
+}
+
+void http_stream_framer::Reset() noexcept
+{
+    m_partial.clear();
+    m_skipLineFeed = false;
+    m_byteOrderMarkMatched = 0;
+    m_started = false;
+    m_eventType.clear();
+    m_data.clear();
+    m_dataView = nullptr;
+    m_dataViewSize = 0;
+    m_hasData = false;
+}
+
+HCResponseStreamFormat http_stream_framer::Format() const noexcept
+{
+    return m_format;
+}
+
+http_internal_string const& http_stream_framer::LastEventId() const noexcept
+{
+    return m_lastEventId;
+}
+
+uint32_t http_stream_framer::ReconnectDelayInMs() const noexcept
+{
+    return m_reconnectDelayInMs;
+}
+
+HRESULT http_stream_framer::WriteLines(
+    _In_reads_bytes_(size) const uint8_t* data,
+    _In_ size_t size,
+    _In_ record_function recordFunction,
+    _In_opt_ void* context
+    )
+{
+    // Event streams end lines with CRLF, LF or CR alone; newline-delimited records with LF, maybe after a CR
+    bool crEndsLine = m_format == HCResponseStreamFormat::ServerSentEvents;
+    auto chars = reinterpret_cast<const char*>(data);
+    size_t position = 0;
+    if (m_skipLineFeed && size > 0)
+    {
+        m_skipLineFeed = false;
+        if (chars[0] == '\n')
+        {
+            position = 1;
+        }
+    }
+
+    while (position < size)
+    {
+        size_t end = position;
+        while (end < size && chars[end] != '\n' && (!crEndsLine || chars[end] != '\r'))
+        {
+            ++end;
+        }
+
+        if (end == size)
+        {
+            if (m_partial.size() + (size - position) > MAX_RECORD_SIZE)
+            {
+                return E_HC_STREAM_RECORD_TOO_LARGE;
+            }
+            m_partial.insert(m_partial.end(), data + position, data + size);
+            break;
+        }
+
+        const char* line = chars + position;
+        size_t lineSize = end - position;
+        bool inChunk = m_partial.empty();
+        if (!inChunk)
+        {
+            if (m_partial.size() + lineSize > MAX_RECORD_SIZE)
+            {
+                return E_HC_STREAM_RECORD_TOO_LARGE;
+            }
+            m_partial.insert(m_partial.end(), data + position, data + end);
+            line = reinterpret_cast<const char*>(m_partial.data());
+            lineSize = m_partial.size();
+        }
+
+        position = end + 1;
+        if (chars[end] == '\r')
+        {
+            if (position == size)
+            {
+                m_skipLineFeed = true;
+            }
+            else if (chars[position] == '\n')
+            {
+                ++position;
+            }
+        }
+
+        HRESULT hr = OnLine(line, lineSize, inChunk, recordFunction, context);
+        m_partial.clear();
+        RETURN_IF_FAILED(hr);
+    }
+
+    // Data left in this chunk for an event that continues in the next one has to be kept
+    KeepDataView();
+    return S_OK;
+}
+
+HRESULT http_stream_framer::WriteLengthPrefixed(
+    _In_reads_bytes_(size) const uint8_t* data,
+    _In_ size_t size,
+    _In_ record_function recordFunction,
+    _In_opt_ void* context
+    )
+{
+    constexpr size_t headerSize = 4;
+    size_t position = 0;
+    while (position < size)
+    {
+        size_t remaining = size - position;
+        if (m_partial.empty() && remaining >= headerSize)
+        {
+            uint32_t length = ReadRecordLength(data + position);
+            if (length > MAX_RECORD_SIZE)
+            {
+                return E_HC_STREAM_RECORD_TOO_LARGE;
+            }
+            if (remaining - headerSize >= length)
+            {
+                HCResponseStreamEvent record{ nullptr, nullptr, data + position + headerSize, length };
+                RETURN_IF_FAILED(recordFunction(record, context));
+                position += headerSize + length;
+                continue;
+            }
+        }
+
+        if (m_partial.size() < headerSize)
+        {
+            size_t headerBytes = std::min(headerSize - m_partial.size(), remaining);
+            m_partial.insert(m_partial.end(), data + position, data + position + headerBytes);
+            position += headerBytes;
+            if (m_partial.size() < headerSize)
+            {
+                break;
+            }
+
+            uint32_t length = ReadRecordLength(m_partial.data());
+            if (length > MAX_RECORD_SIZE)
+            {
+                return E_HC_STREAM_RECORD_TOO_LARGE;
+            }
+            m_partial.reserve(headerSize + length);
+        }
+
+        size_t recordSize = headerSize + ReadRecordLength(m_partial.data());
+        size_t bodyBytes = std::min(recordSize - m_partial.size(), size - position);
+        m_partial.insert(m_partial.end(), data + position, data + position + bodyBytes);
+        position += bodyBytes;
+        if (m_partial.size() == recordSize)
+        {
+            HCResponseStreamEvent record{ nullptr, nullptr, m_partial.data() + headerSize, recordSize - headerSize };
+            HRESULT hr = recordFunction(record, context);
+            m_partial.clear();
+            RETURN_IF_FAILED(hr);
+        }
+    }
+    return S_OK;
+}
+
+HRESULT http_stream_framer::OnLine(
+    _In_reads_(size) const char* line,
+    _In_ size_t size,
+    _In_ bool inChunk,
+    _In_ record_function recordFunction,
+    _In_opt_ void* context
+    )
+{
+    if (m_format == HCResponseStreamFormat::NewlineDelimited)
+    {
+        if (size > 0 && line[size - 1] == '\r')
+        {
+            --size;
+        }
+        if (size == 0)
+        {
+            return S_OK;
+        }
+        HCResponseStreamEvent record{ nullptr, nullptr, reinterpret_cast<const uint8_t*>(line), size };
+        return recordFunction(record, context);
+    }
+
+    // A blank line ends the event, and one starting with a colon is a comment
+    if (size == 0)
+    {
+        return DispatchEvent(recordFunction, context);
+    }
+    if (line[0] == ':')
+    {
+        return S_OK;
+    }
+    return OnEventField(line, size, inChunk);
+}
+
+HRESULT http_stream_framer::OnEventField(_In_reads_(size) const char* line, _In_ size_t size, _In_ bool inChunk)
+{
+    auto colon = static_cast<const char*>(memchr(line, ':', size));
+    size_t fieldSize = colon != nullptr ? static_cast<size_t>(colon - line) : size;
+    const char* value = line + size;
+    size_t valueSize = 0;
+    if (colon != nullptr)
+    {
+        value = colon + 1;
+        valueSize = size - fieldSize - 1;
+        if (valueSize > 0 && value[0] == ' ')
+        {
+            ++value;
+            --valueSize;
+        }
+    }
+
+    if (FieldIs(line, fieldSize, "data"))
+    {
+        if (!m_hasData && inChunk)
+        {
+            m_dataView = value;
+            m_dataViewSize = valueSize;
+        }
+        else
+        {
+            KeepDataView();
+            if (m_data.size() + valueSize + 1 > MAX_RECORD_SIZE)
+            {
+                return E_HC_STREAM_RECORD_TOO_LARGE;
+            }
+            if (m_hasData)
+            {
+                m_data.push_back('\n');
+            }
+            m_data.append(value, valueSize);
+        }
+        m_hasData = true;
+    }
+    else if (FieldIs(line, fieldSize, "event"))
+    {
+        m_eventType.assign(value, valueSize);
+    }
+    else if (FieldIs(line, fieldSize, "id"))
+    {
+        if (memchr(value, '\0', valueSize) == nullptr)
+        {
+            m_lastEventId.assign(value, valueSize);
+        }
+    }
+    else if (FieldIs(line, fieldSize, "retry"))
+    {
+        uint64_t delay = 0;
+        size_t digits = 0;
+        while (digits < valueSize && value[digits] >= '0' && value[digits] <= '9')
+        {
+            delay = std::min<uint64_t>(delay * 10 + static_cast<uint64_t>(value[digits] - '0'), UINT32_MAX);
+            ++digits;
+        }
+        if (digits > 0 && digits == valueSize)
+        {
+            m_reconnectDelayInMs = static_cast<uint32_t>(delay);
+        }
+    }
+    return S_OK;
+}
+
+HRESULT http_stream_framer::DispatchEvent(_In_ record_function recordFunction, _In_opt_ void* context)
+{
+    if (!m_hasData)
+    {
+        m_eventType.clear();
+        return S_OK;
+    }
+
+    HCResponseStreamEvent event{};
+    event.eventType = m_eventType.empty() ? "message" : m_eventType.c_str();
+    event.id = m_lastEventId.c_str();
+    event.data = reinterpret_cast<const uint8_t*>(m_dataView != nullptr ? m_dataView : m_data.data());
+    event.dataSize = m_dataView != nullptr ? m_dataViewSize : m_data.size();
+    HRESULT hr = recordFunction(event, context);
+
+    m_eventType.clear();
+    m_data.clear();
+    m_dataView = nullptr;
+    m_dataViewSize = 0;
+    m_hasData = false;
+    return hr;
+}
+
+void http_stream_framer::KeepDataView()
+{
+    if (m_dataView != nullptr)
+    {
+        m_data.assign(m_dataView, m_dataViewSize);
+        m_dataView = nullptr;
+        m_dataViewSize = 0;
+    }
+}
+
+HRESULT http_response_stream::Enable(
+    _In_ HCCallHandle call,
+    _In_ HCResponseStreamFormat format,
+    _In_opt_ XTaskQueueHandle queue,
+    _In_ HCHttpCallResponseStreamEventFunction eventFunction,
+    _In_opt_ void* context
+    ) noexcept
+try
+{
+    auto stream = http_allocate_shared<http_response_stream>(call, format, nullptr, eventFunction, context);
+    if (queue != nullptr)
+    {
+        RETURN_IF_FAILED(XTaskQueueDuplicateHandle(queue, &stream->m_queue));
+    }
+
+    call->responseStream = stream;
+    call->responseBodyWriteFunction = WriteFunction;
+    call->responseBodyWriteFunctionContext = stream.get();
+    return S_OK;
+}
+CATCH_RETURN()
+
+HRESULT http_response_stream::Attach(_In_ HCCallHandle call) noexcept
+try
+{
+    auto stream = call->responseStream.get();
+    if (stream == nullptr || !stream->IsInstalled(call))
+    {
+        return S_OK;
+    }
+
+    stream->m_framer.Reset();
+    stream->m_responseChecked = false;
+    stream->m_responseAccepted = false;
+    stream->m_heldBody.clear();
+    stream->m_deliveredEvents = false;
+    stream->m_error = S_OK;
+    stream->m_attached = true;
+
+    if (stream->m_framer.Format() == HCResponseStreamFormat::ServerSentEvents)
+    {
+        auto& headers = call->requestHeaders.mutate();
+        if (headers.find(ACCEPT_HEADER) == headers.end())
+        {
+            headers[ACCEPT_HEADER] = EVENT_STREAM_MEDIA_TYPE;
+            stream->m_addedAcceptHeader = true;
+        }
+
+        // The ID of the last event received takes over from one the call was set up with
+        auto const& lastEventId = stream->m_framer.LastEventId();
+        if (!lastEventId.empty())
+        {
+            auto it = headers.find(LAST_EVENT_ID_HEADER);
+            stream->m_replacedLastEventIdHeader = it != headers.end();
+            if (stream->m_replacedLastEventIdHeader)
+            {
+                stream->m_replacedLastEventId = it->second.c_str();
+            }
+            headers[LAST_EVENT_ID_HEADER] = lastEventId.c_str();
+            stream->m_addedLastEventIdHeader = true;
+            if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallPerform [ID %llu] resuming event stream after event %s", TO_ULL(call->id), lastEventId.c_str()); }
+        }
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+void http_response_stream::Detach(_In_ HCCallHandle call) noexcept
+{
+    auto stream = call->responseStream.get();
+    if (stream == nullptr || !stream->m_attached)
+    {
+        return;
+    }
+    stream->m_attached = false;
+
+    try
+    {
+        // A provider that sets the status only once the body is done still has its body framed
+        if (!stream->m_responseChecked && !stream->m_heldBody.empty() && call->statusCode != 0)
+        {
+            stream->CheckResponse(call);
+            if (stream->m_responseAccepted)
+            {
+                (void)stream->Frame(call, stream->m_heldBody.data(), stream->m_heldBody.size());
+            }
+        }
+        stream->m_heldBody = http_body_bytes{};
+
+        // The provider only saw the write function fail
+        if (FAILED(stream->m_error))
+        {
+            call->networkErrorCode = stream->m_error;
+        }
+
+        if (stream->m_addedAcceptHeader)
+        {
+            call->requestHeaders.mutate().erase(ACCEPT_HEADER);
+            stream->m_addedAcceptHeader = false;
+        }
+        if (stream->m_addedLastEventIdHeader)
+        {
+            if (stream->m_replacedLastEventIdHeader)
+            {
+                call->requestHeaders.mutate()[LAST_EVENT_ID_HEADER] = stream->m_replacedLastEventId.c_str();
+            }
+            else
+            {
+                call->requestHeaders.mutate().erase(LAST_EVENT_ID_HEADER);
+            }
+            stream->m_addedLastEventIdHeader = false;
+            stream->m_replacedLastEventIdHeader = false;
+        }
+    }
+    catch (...)
+    {
+        if (call->networkErrorCode == S_OK)
+        {
+            call->networkErrorCode = E_OUTOFMEMORY;
+        }
+    }
+}
+
+bool http_response_stream::ShouldReconnect(_In_ HCCallHandle call) noexcept
+try
+{
+    auto stream = call->responseStream.get();
+    if (stream == nullptr || !stream->IsInstalled(call) || stream->m_framer.Format() != HCResponseStreamFormat::ServerSentEvents ||
+        !call->retryAllowed || FAILED(stream->m_error) || call->networkErrorCode == E_HC_NO_NETWORK)
+    {
+        return false;
+    }
+
+    // A stream that ends or drops is picked up again, but any other response means the server wants it closed
+    if (call->networkErrorCode == S_OK && !(call->statusCode == 200 && stream->AcceptsResponse(call)))
+    {
+        return false;
+    }
+
+    // A server that keeps closing the stream straight away, or asks for no delay, isn't reconnected to in a tight loop
+    uint64_t const serverDelay = std::max<uint64_t>(stream->m_framer.ReconnectDelayInMs(), MIN_RECONNECT_DELAY_IN_MS);
+    uint64_t delay = serverDelay;
+    stream->m_emptyAttempts = stream->m_deliveredEvents ? 0 : stream->m_emptyAttempts + 1;
+    for (uint32_t i = 1; i < stream->m_emptyAttempts && delay < MAX_RECONNECT_BACKOFF_IN_MS; ++i)
+    {
+        delay *= 2;
+    }
+    delay = std::min(delay, std::max<uint64_t>(serverDelay, MAX_RECONNECT_BACKOFF_IN_MS));
+
+    call->delayBeforeRetry = std::chrono::milliseconds(delay);
+    if (call->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "HCHttpCallPerformExecute [ID %llu] event stream ended, reconnecting after %lld ms", TO_ULL(call->id), call->delayBeforeRetry.count()); }
+    return true;
+}
+catch (...)
+{
+    return false;
+}
+
+http_response_stream::http_response_stream(
+    _In_ HCCallHandle call,
+    _In_ HCResponseStreamFormat format,
+    _In_opt_ XTaskQueueHandle queue,
+    _In_ HCHttpCallResponseStreamEventFunction eventFunction,
+    _In_opt_ void* context
+    ) noexcept :
+    m_call{ call },
+    m_queue{ queue },
+    m_eventFunction{ eventFunction },
+    m_context{ context },
+    m_framer{ format }
+{
+}
+
+http_response_stream::~http_response_stream()
+{
+    if (m_queue != nullptr)
+    {
+        XTaskQueueCloseHandle(m_queue);
+    }
+}
+
+bool http_response_stream::IsInstalled(_In_ HCCallHandle call) const noexcept
+{
+    return call->responseBodyWriteFunction == WriteFunction && call->responseBodyWriteFunctionContext == this;
+}
+
+bool http_response_stream::AcceptsResponse(_In_ HCCallHandle call) const
+{
+    if (call->statusCode < 200 || call->statusCode >= 300)
+    {
+        return false;
+    }
+    if (m_framer.Format() != HCResponseStreamFormat::ServerSentEvents)
+    {
+        return true;
+    }
+
+    // The media type, without parameters such as the charset
+    auto const& headers = call->responseHeaders.get();
+    auto it = headers.find(CONTENT_TYPE_HEADER);
+    if (it == headers.end())
+    {
+        return false;
+    }
+    http_arena_string mediaType = it->second.substr(0, it->second.find(';'));
+    while (!mediaType.empty() && (mediaType.back() == ' ' || mediaType.back() == '\t'))
+    {
+        mediaType.pop_back();
+    }
+    return str_icmp(mediaType.c_str(), EVENT_STREAM_MEDIA_TYPE) == 0;
+}
+
+void http_response_stream::CheckResponse(_In_ HCCallHandle call)
+{
+    m_responseAccepted = AcceptsResponse(call);
+    m_responseChecked = true;
+    if (!m_responseAccepted && call->traceCall)
+    {
+        HC_TRACE_WARNING(HTTPCLIENT, "HCHttpCallPerform [ID %llu] response %u isn't a stream, dropping its body", TO_ULL(call->id), call->statusCode);
+    }
+}
+
+HRESULT http_response_stream::Frame(_In_ HCCallHandle call, _In_reads_bytes_(size) const uint8_t* source, _In_ size_t size)
+{
+    HRESULT hr = m_framer.Write(source, size, OnRecord, this);
+    if (FAILED(hr))
+    {
+        if (call->traceCall) { HC_TRACE_ERROR(HTTPCLIENT, "HCHttpCallPerform [ID %llu] response stream failed: 0x%08X", TO_ULL(call->id), hr); }
+        m_error = hr;
+    }
+    return hr;
+}
+
+HRESULT http_response_stream::Deliver(_In_ const HCResponseStreamEvent& event)
+{
+    if (m_queue == nullptr)
+    {
+        m_eventFunction(m_call, &event, m_context);
+        return S_OK;
+    }
+
+    queued_event queued;
+    queued.hasEventFields = event.eventType != nullptr;
+    if (queued.hasEventFields)
+    {
+        queued.eventType = event.eventType;
+        queued.id = event.id;
+    }
+    queued.data.assign(event.data, event.data + event.dataSize);
+
+    // One drain at a time, so the events reach the queue's callback in order
+    std::lock_guard<std::mutex> lock{ m_queueLock };
+    m_queuedEvents.push_back(std::move(queued));
+    if (m_draining)
+    {
+        return S_OK;
+    }
+
+    HCCallHandle call = HCHttpCallDuplicateHandle(m_call);
+    auto stream = shared_from_this();
+    HRESULT hr = RunAsync([stream, call]
+    {
+        stream->DrainQueue(call);
+    }, m_queue);
+    if (FAILED(hr))
+    {
+        m_queuedEvents.pop_back();
+        HCHttpCallCloseHandle(call);
+        return hr;
+    }
+    m_draining = true;
+    return S_OK;
+}
+
+void http_response_stream::DrainQueue(_In_ HCCallHandle call) noexcept
+{
+    while (true)
+    {
+        queued_event queued;
+        {
+            std::lock_guard<std::mutex> lock{ m_queueLock };
+            if (m_queuedEvents.empty())
+            {
+                m_draining = false;
+                break;
+            }
+            queued = std::move(m_queuedEvents.front());
+            m_queuedEvents.pop_front();
+        }
+
+        HCResponseStreamEvent event{};
+        event.eventType = queued.hasEventFields ? queued.eventType.c_str() : nullptr;
+        event.id = queued.hasEventFields ? queued.id.c_str() : nullptr;
+        event.data = queued.data.data();
+        event.dataSize = queued.data.size();
+        m_eventFunction(call, &event, m_context);
+    }
+
+    HCHttpCallCloseHandle(call);
+}
+
+HRESULT http_response_stream::OnRecord(_In_ const HCResponseStreamEvent& record, _In_opt_ void* context)
+{
+    auto stream = static_cast<http_response_stream*>(context);
+    stream->m_deliveredEvents = true;
+    return stream->Deliver(record);
+}
+
+HRESULT CALLBACK http_response_stream::WriteFunction(
+    _In_ HCCallHandle call,
+    _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context
+    ) noexcept
+try
+{
+    auto stream = static_cast<http_response_stream*>(context);
+    if (!stream->m_responseChecked)
+    {
+        // Body bytes that arrive before the status wait for it, since they can't be judged without it
+        if (call->statusCode == 0)
+        {
+            stream->m_heldBody.insert(stream->m_heldBody.end(), source, source + bytesAvailable);
+            return S_OK;
+        }
+        stream->CheckResponse(call);
+    }
+    if (!stream->m_responseAccepted)
+    {
+        return S_OK;
+    }
+
+    if (!stream->m_heldBody.empty())
+    {
+        http_body_bytes held{ std::move(stream->m_heldBody) };
+        stream->m_heldBody.clear();
+        RETURN_IF_FAILED(stream->Frame(call, held.data(), held.size()));
+    }
+    return stream->Frame(call, source, bytesAvailable);
+}
+CATCH_RETURN()
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
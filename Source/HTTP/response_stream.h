@@ -0,0 +1,154 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+#include "pch.h"
+#include "httpcall.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+// Divides a response body into the records of a HCResponseStreamFormat as it arrives, in chunks that may split a
+// record anywhere. A record that lies within one chunk is passed on where it is; only one that straddles chunks is
+// put together in a buffer.
+class http_stream_framer
+{
+public:
+    // The record is only valid for the duration of the callback
+    typedef HRESULT(*record_function)(_In_ const HCResponseStreamEvent& record, _In_opt_ void* context);
+
+    static constexpr size_t MAX_RECORD_SIZE = 16 * 1024 * 1024;
+    static constexpr uint32_t DEFAULT_RECONNECT_DELAY_IN_MS = 3000;
+
+    http_stream_framer(_In_ HCResponseStreamFormat format) noexcept;
+
+    HRESULT Write(
+        _In_reads_bytes_(size) const uint8_t* data,
+        _In_ size_t size,
+        _In_ record_function recordFunction,
+        _In_opt_ void* context
+        );
+
+    // Drops what is left of a body that ended. The last event ID and reconnection delay carry over to the next one.
+    void Reset() noexcept;
+
+    HCResponseStreamFormat Format() const noexcept;
+    http_internal_string const& LastEventId() const noexcept;
+    uint32_t ReconnectDelayInMs() const noexcept;
+
+private:
+    HRESULT WriteLines(_In_reads_bytes_(size) const uint8_t* data, _In_ size_t size, _In_ record_function recordFunction, _In_opt_ void* context);
+    HRESULT WriteLengthPrefixed(_In_reads_bytes_(size) const uint8_t* data, _In_ size_t size, _In_ record_function recordFunction, _In_opt_ void* context);
+
+    // inChunk is whether the line stays where it is until the end of the chunk being written
+    HRESULT OnLine(_In_reads_(size) const char* line, _In_ size_t size, _In_ bool inChunk, _In_ record_function recordFunction, _In_opt_ void* context);
+    HRESULT OnEventField(_In_reads_(size) const char* line, _In_ size_t size, _In_ bool inChunk);
+    HRESULT DispatchEvent(_In_ record_function recordFunction, _In_opt_ void* context);
+    void KeepDataView();
+
+    HCResponseStreamFormat const m_format;
+
+    // The start of a record that continues in the next chunk
+    http_body_bytes m_partial;
+    bool m_skipLineFeed{ false }; // the last chunk ended with the CR of a CRLF
+    size_t m_byteOrderMarkMatched{ 0 };
+    bool m_started{ false };
+
+    // The Server-Sent Event being put together. Its data stays in the chunk it arrived in while it has a single line
+    // there, and is copied into m_data otherwise.
+    http_internal_string m_eventType;
+    http_internal_string m_data;
+    const char* m_dataView{ nullptr };
+    size_t m_dataViewSize{ 0 };
+    bool m_hasData{ false };
+    http_internal_string m_lastEventId;
+    uint32_t m_reconnectDelayInMs{ DEFAULT_RECONNECT_DELAY_IN_MS };
+};
+
+// The response stream of a call set up with HCHttpCallResponseSetStreamEventFunction. It is the call's response write
+// function, and like the resumable download it is attached around each attempt, which is where a Server-Sent Events
+// stream sends its Last-Event-ID and, once the attempt ends, decides whether to reconnect.
+class http_response_stream : public std::enable_shared_from_this<http_response_stream>
+{
+public:
+    static HRESULT Enable(
+        _In_ HCCallHandle call,
+        _In_ HCResponseStreamFormat format,
+        _In_opt_ XTaskQueueHandle queue,
+        _In_ HCHttpCallResponseStreamEventFunction eventFunction,
+        _In_opt_ void* context
+        ) noexcept;
+
+    static HRESULT Attach(_In_ HCCallHandle call) noexcept;
+    static void Detach(_In_ HCCallHandle call) noexcept;
+
+    // Whether a Server-Sent Events call reconnects after the attempt that just ended, setting its delay if so
+    static bool ShouldReconnect(_In_ HCCallHandle call) noexcept;
+
+    // The delay before reconnecting is never less than the minimum, whatever the server's retry field says, and
+    // doubles for each attempt in a row that delivered no events, up to the maximum or the server's delay if longer
+    static constexpr uint32_t MIN_RECONNECT_DELAY_IN_MS = 100;
+    static constexpr uint32_t MAX_RECONNECT_BACKOFF_IN_MS = 60 * 1000;
+
+    http_response_stream(
+        _In_ HCCallHandle call,
+        _In_ HCResponseStreamFormat format,
+        _In_opt_ XTaskQueueHandle queue,
+        _In_ HCHttpCallResponseStreamEventFunction eventFunction,
+        _In_opt_ void* context
+        ) noexcept;
+    http_response_stream(const http_response_stream&) = delete;
+    http_response_stream& operator=(const http_response_stream&) = delete;
+    ~http_response_stream();
+
+private:
+    // An event copied to be delivered on the stream's queue
+    struct queued_event
+    {
+        http_internal_string eventType;
+        http_internal_string id;
+        bool hasEventFields;
+        http_body_bytes data;
+    };
+
+    bool IsInstalled(_In_ HCCallHandle call) const noexcept;
+    bool AcceptsResponse(_In_ HCCallHandle call) const;
+    void CheckResponse(_In_ HCCallHandle call);
+    HRESULT Frame(_In_ HCCallHandle call, _In_reads_bytes_(size) const uint8_t* source, _In_ size_t size);
+    HRESULT Deliver(_In_ const HCResponseStreamEvent& event);
+    void DrainQueue(_In_ HCCallHandle call) noexcept;
+
+    static HRESULT OnRecord(_In_ const HCResponseStreamEvent& record, _In_opt_ void* context);
+    static HRESULT CALLBACK WriteFunction(
+        _In_ HCCallHandle call,
+        _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+        _In_ size_t bytesAvailable,
+        _In_opt_ void* context
+        ) noexcept;
+
+    HCCallHandle const m_call;
+    XTaskQueueHandle m_queue{ nullptr };
+    HCHttpCallResponseStreamEventFunction const m_eventFunction;
+    void* const m_context;
+    http_stream_framer m_framer;
+
+    // The attempt in flight
+    bool m_attached{ false };
+    bool m_responseChecked{ false };
+    bool m_responseAccepted{ false };
+    http_body_bytes m_heldBody;
+    bool m_deliveredEvents{ false };
+    HRESULT m_error{ S_OK };
+    bool m_addedAcceptHeader{ false };
+    bool m_addedLastEventIdHeader{ false };
+    bool m_replacedLastEventIdHeader{ false };
+    http_internal_string m_replacedLastEventId;
+
+    // Attempts in a row that ended without delivering an event
+    uint32_t m_emptyAttempts{ 0 };
+
+    std::mutex m_queueLock;
+    http_internal_dequeue<queued_event> m_queuedEvents;
+    bool m_draining{ false };
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
@@ -0,0 +1,537 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "lhc_capture.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+// Capture log layout (all integers little endian):
+//
+//   file:    "LHCCAP01" record*
+//   record:  u32 recordSize (bytes following this field)
+//            u64 startOffsetUs (attempt start, relative to the start of the capture)
+//            u32 latencyUs
+//            u32 statusCode, i32 networkErrorCode, u32 platformNetworkErrorCode
+//            u8 flags
+//            str16 method, str32 url
+//            u64 requestBodyHash (0 if flags & REQUEST_BODY_STREAMED), u32 requestBodySize
+//            headers requestHeaders, headers responseHeaders
+//            u64 responseBodyHash, u32 responseBodySize, u8[responseBodySize] (only if flags & RESPONSE_BODY_CAPTURED)
+//   headers: u16 count, { str16 name, str32 value }*
+
+static const char CAPTURE_FILE_MAGIC[] = { 'L', 'H', 'C', 'C', 'A', 'P', '0', '1' };
+static const uint8_t CAPTURE_FLAG_RESPONSE_BODY_CAPTURED = 0x1;
+static const uint8_t CAPTURE_FLAG_REQUEST_BODY_STREAMED = 0x2;
+static const size_t CAPTURE_SEGMENT_SIZE = 1024 * 1024;
+static const size_t CAPTURE_PREALLOCATED_SEGMENTS = 4;
+
+static uint64_t HashBytes(_In_reads_bytes_(size) const uint8_t* bytes, _In_ size_t size, _In_ uint64_t hash = 14695981039346656037ULL) noexcept
+{
+    // FNV-1a
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+template<typename String>
+static uint64_t RequestKey(
+    _In_ const String& method,
+    _In_ const String& url,
+    _In_ const uint64_t* requestBodyHash
+) noexcept
+{
+    uint64_t hash = HashBytes(reinterpret_cast<const uint8_t*>(method.data()), method.size());
+    hash = HashBytes(reinterpret_cast<const uint8_t*>(" "), 1, hash);
+    hash = HashBytes(reinterpret_cast<const uint8_t*>(url.data()), url.size(), hash);
+    if (requestBodyHash != nullptr)
+    {
+        hash = HashBytes(reinterpret_cast<const uint8_t*>(requestBodyHash), sizeof(*requestBodyHash), hash);
+    }
+    return hash;
+}
+
+// Whether the request body is read from a callback rather than held by the call. Such a body isn't known until it
+// has been sent, so those requests are only matched by method and URL.
+static bool IsRequestBodyStreamed(_In_ const HC_CALL* call) noexcept
+{
+    return call->requestBodyReadFunction != DefaultRequestBodyReadFunction;
+}
+
+template<typename T>
+static void Write(_Inout_ http_internal_vector<uint8_t>& buffer, _In_ T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        buffer.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i)));
+    }
+}
+
+template<typename TLength, typename String>
+static void WriteString(_Inout_ http_internal_vector<uint8_t>& buffer, _In_ const String& s)
+{
+    size_t length = std::min<size_t>(s.size(), std::numeric_limits<TLength>::max());
+    Write<TLength>(buffer, static_cast<TLength>(length));
+    buffer.insert(buffer.end(), s.data(), s.data() + length);
+}
+
+static void WriteHeaders(_Inout_ http_internal_vector<uint8_t>& buffer, _In_ const http_header_map& headers)
+{
+    uint16_t count = static_cast<uint16_t>(std::min<size_t>(headers.size(), UINT16_MAX));
+    Write<uint16_t>(buffer, count);
+    for (auto it = headers.begin(); count > 0; ++it, --count)
+    {
+        WriteString<uint16_t>(buffer, it->first);
+        WriteString<uint32_t>(buffer, it->second);
+    }
+}
+
+class capture_reader
+{
+public:
+    capture_reader(const uint8_t* begin, const uint8_t* end) : m_pos{ begin }, m_end{ end } {}
+
+    template<typename T>
+    bool Read(T& value)
+    {
+        if (Remaining() < sizeof(T))
+        {
+            return false;
+        }
+
+        uint64_t v = 0;
+        for (size_t i = 0; i < sizeof(T); ++i)
+        {
+            v |= static_cast<uint64_t>(m_pos[i]) << (8 * i);
+        }
+        value = static_cast<T>(v);
+        m_pos += sizeof(T);
+        return true;
+    }
+
+    template<typename TLength, typename String>
+    bool ReadString(String& s)
+    {
+        TLength length{ 0 };
+        if (!Read(length) || Remaining() < length)
+        {
+            return false;
+        }
+        s.assign(reinterpret_cast<const char*>(m_pos), length);
+        m_pos += length;
+        return true;
+    }
+
+    bool ReadHeaders(http_header_map& headers)
+    {
+        uint16_t count{ 0 };
+        if (!Read(count))
+        {
+            return false;
+        }
+        for (uint16_t i = 0; i < count; ++i)
+        {
+            http_arena_string name;
+            http_arena_string value;
+            if (!ReadString<uint16_t>(name) || !ReadString<uint32_t>(value))
+            {
+                return false;
+            }
+            headers[std::move(name)] = std::move(value);
+        }
+        return true;
+    }
+
+    bool Skip(size_t size)
+    {
+        if (Remaining() < size)
+        {
+            return false;
+        }
+        m_pos += size;
+        return true;
+    }
+
+    const uint8_t* Position() const { return m_pos; }
+    size_t Remaining() const { return static_cast<size_t>(m_end - m_pos); }
+
+private:
+    const uint8_t* m_pos;
+    const uint8_t* m_end;
+};
+
+static FILE* OpenFile(_In_z_ const char* filePath, _In_z_ const char* mode) noexcept
+{
+    FILE* file{ nullptr };
+#if HC_PLATFORM_IS_MICROSOFT
+    if (fopen_s(&file, filePath, mode) != 0)
+    {
+        file = nullptr;
+    }
+#else
+    file = fopen(filePath, mode);
+#endif
+    return file;
+}
+
+HRESULT http_capture::Create(
+    _In_z_ const char* filePath,
+    _In_ bool captureResponseBodies,
+    _Out_ std::shared_ptr<http_capture>& capture
+) noexcept
+try
+{
+    FILE* file = OpenFile(filePath, "wb");
+    if (file == nullptr)
+    {
+        HC_TRACE_ERROR(HTTPCLIENT, "http_capture: unable to open capture file %s", filePath);
+        return E_FAIL;
+    }
+
+    if (fwrite(CAPTURE_FILE_MAGIC, sizeof(CAPTURE_FILE_MAGIC), 1, file) != 1)
+    {
+        fclose(file);
+        return E_FAIL;
+    }
+
+    capture = http_allocate_shared<http_capture>(file, captureResponseBodies);
+    return S_OK;
+}
+CATCH_RETURN()
+
+http_capture::http_capture(FILE* file, bool captureResponseBodies) :
+    m_file{ file },
+    m_captureResponseBodies{ captureResponseBodies },
+    m_startTime{ chrono_clock_t::now() }
+{
+    m_activeSegment.reserve(CAPTURE_SEGMENT_SIZE);
+    for (size_t i = 0; i < CAPTURE_PREALLOCATED_SEGMENTS; ++i)
+    {
+        m_freeSegments.emplace_back();
+        m_freeSegments.back().reserve(CAPTURE_SEGMENT_SIZE);
+    }
+
+    m_writerThread = std::thread([this]() { WriterThreadProc(); });
+}
+
+http_capture::~http_capture()
+{
+    Stop();
+}
+
+http_capture::Segment http_capture::AcquireSegment()
+{
+    // Caller holds m_lock
+    if (!m_freeSegments.empty())
+    {
+        Segment segment{ std::move(m_freeSegments.back()) };
+        m_freeSegments.pop_back();
+        return segment;
+    }
+
+    // The writer has fallen behind; grow rather than drop records or block the caller on I/O.
+    Segment segment;
+    segment.reserve(CAPTURE_SEGMENT_SIZE);
+    return segment;
+}
+
+void http_capture::Record(_In_ HC_CALL* call, _In_ const chrono_clock_t::time_point& completedTime) noexcept
+try
+{
+    auto const& responseBody = call->responseBodyBytes.get();
+    bool captureBody = m_captureResponseBodies && call->responseBodyWriteFunction == DefaultResponseBodyWriteFunction;
+    bool streamedBody = IsRequestBodyStreamed(call);
+
+    auto startOffset = std::chrono::duration_cast<std::chrono::microseconds>(call->attemptStartTime - m_startTime).count();
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(completedTime - call->attemptStartTime).count();
+
+    // Serialized before taking the lock, which is only held to append the record to the active segment
+    Segment record;
+    record.reserve(256 + call->url.size() + (captureBody ? responseBody.size() : 0));
+    Write<uint32_t>(record, 0);
+    Write<uint64_t>(record, static_cast<uint64_t>(std::max<int64_t>(startOffset, 0)));
+    Write<uint32_t>(record, static_cast<uint32_t>(std::min<int64_t>(std::max<int64_t>(latency, 0), UINT32_MAX)));
+    Write<uint32_t>(record, call->statusCode);
+    Write<int32_t>(record, call->networkErrorCode);
+    Write<uint32_t>(record, call->platformNetworkErrorCode);
+    Write<uint8_t>(record, (captureBody ? CAPTURE_FLAG_RESPONSE_BODY_CAPTURED : 0) | (streamedBody ? CAPTURE_FLAG_REQUEST_BODY_STREAMED : 0));
+    WriteString<uint16_t>(record, call->method);
+    WriteString<uint32_t>(record, call->url);
+    Write<uint64_t>(record, streamedBody ? 0 : HashBytes(call->requestBodyBytes.data(), call->requestBodyBytes.size()));
+    Write<uint32_t>(record, static_cast<uint32_t>(call->requestBodySize));
+    WriteHeaders(record, call->requestHeaders.get());
+    WriteHeaders(record, call->responseHeaders.get());
+    Write<uint64_t>(record, HashBytes(responseBody.data(), responseBody.size()));
+    Write<uint32_t>(record, static_cast<uint32_t>(responseBody.size()));
+    if (captureBody)
+    {
+        record.insert(record.end(), responseBody.begin(), responseBody.end());
+    }
+
+    uint32_t recordSize = static_cast<uint32_t>(record.size() - sizeof(uint32_t));
+    for (size_t i = 0; i < sizeof(uint32_t); ++i)
+    {
+        record[i] = static_cast<uint8_t>(recordSize >> (8 * i));
+    }
+
+    std::lock_guard<std::mutex> lock{ m_lock };
+    if (m_stopping)
+    {
+        return;
+    }
+
+    if (record.size() >= CAPTURE_SEGMENT_SIZE)
+    {
+        // Too big to be worth copying; queued as a segment of its own, after what is already in the active one
+        if (!m_activeSegment.empty())
+        {
+            m_fullSegments.push(std::move(m_activeSegment));
+            m_activeSegment = AcquireSegment();
+        }
+        m_fullSegments.push(std::move(record));
+        m_segmentsPending.notify_one();
+        return;
+    }
+
+    m_activeSegment.insert(m_activeSegment.end(), record.begin(), record.end());
+    if (m_activeSegment.size() >= CAPTURE_SEGMENT_SIZE)
+    {
+        m_fullSegments.push(std::move(m_activeSegment));
+        m_activeSegment = AcquireSegment();
+        m_segmentsPending.notify_one();
+    }
+}
+catch (...)
+{
+    HC_TRACE_ERROR(HTTPCLIENT, "http_capture: failed to record call [ID %llu]", TO_ULL(call->id));
+}
+
+void http_capture::Stop() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock{ m_lock };
+        if (m_stopping)
+        {
+            return;
+        }
+
+        m_stopping = true;
+        if (!m_activeSegment.empty())
+        {
+            m_fullSegments.push(std::move(m_activeSegment));
+        }
+    }
+
+    m_segmentsPending.notify_one();
+    if (m_writerThread.joinable())
+    {
+        m_writerThread.join();
+    }
+
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+void http_capture::WriterThreadProc() noexcept
+{
+    std::unique_lock<std::mutex> lock{ m_lock };
+    for (;;)
+    {
+        m_segmentsPending.wait(lock, [this] { return m_stopping || !m_fullSegments.empty(); });
+        if (m_fullSegments.empty())
+        {
+            // Stopping and fully drained
+            return;
+        }
+
+        Segment segment{ std::move(m_fullSegments.front()) };
+        m_fullSegments.pop();
+
+        lock.unlock();
+        if (fwrite(segment.data(), 1, segment.size(), m_file) != segment.size())
+        {
+            HC_TRACE_ERROR(HTTPCLIENT, "http_capture: failed writing %zu bytes to capture file", segment.size());
+        }
+        segment.clear();
+        lock.lock();
+
+        m_freeSegments.push_back(std::move(segment));
+    }
+}
+
+HRESULT http_replay_store::Load(_In_z_ const char* filePath, _In_ bool replayLatency) noexcept
+try
+{
+    FILE* file = OpenFile(filePath, "rb");
+    if (file == nullptr)
+    {
+        HC_TRACE_ERROR(HTTPCLIENT, "http_replay_store: unable to open capture file %s", filePath);
+        return E_FAIL;
+    }
+
+    http_internal_vector<uint8_t> contents;
+    uint8_t chunk[64 * 1024];
+    size_t read = 0;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        contents.insert(contents.end(), chunk, chunk + read);
+    }
+    fclose(file);
+
+    if (contents.size() < sizeof(CAPTURE_FILE_MAGIC) || memcmp(contents.data(), CAPTURE_FILE_MAGIC, sizeof(CAPTURE_FILE_MAGIC)) != 0)
+    {
+        HC_TRACE_ERROR(HTTPCLIENT, "http_replay_store: %s is not a capture file", filePath);
+        return E_FAIL;
+    }
+
+    capture_reader reader{ contents.data() + sizeof(CAPTURE_FILE_MAGIC), contents.data() + contents.size() };
+    size_t recordCount = 0;
+    while (reader.Remaining() > 0)
+    {
+        uint32_t recordSize{ 0 };
+        if (!reader.Read(recordSize) || reader.Remaining() < recordSize)
+        {
+            HC_TRACE_ERROR(HTTPCLIENT, "http_replay_store: truncated record %zu in %s", recordCount, filePath);
+            return E_FAIL;
+        }
+
+        capture_reader record{ reader.Position(), reader.Position() + recordSize };
+        reader.Skip(recordSize);
+
+        uint64_t startOffsetUs{ 0 };
+        uint32_t latencyUs{ 0 };
+        uint8_t flags{ 0 };
+        http_internal_string method;
+        http_internal_string url;
+        uint64_t requestBodyHash{ 0 };
+        uint32_t requestBodySize{ 0 };
+        http_header_map requestHeaders;
+        http_header_map responseHeaders;
+        uint64_t responseBodyHash{ 0 };
+        uint32_t responseBodySize{ 0 };
+        http_replay_response response;
+
+        bool valid =
+            record.Read(startOffsetUs) &&
+            record.Read(latencyUs) &&
+            record.Read(response.statusCode) &&
+            record.Read(response.networkErrorCode) &&
+            record.Read(response.platformNetworkErrorCode) &&
+            record.Read(flags) &&
+            record.ReadString<uint16_t>(method) &&
+            record.ReadString<uint32_t>(url) &&
+            record.Read(requestBodyHash) &&
+            record.Read(requestBodySize) &&
+            record.ReadHeaders(requestHeaders) &&
+            record.ReadHeaders(responseHeaders) &&
+            record.Read(responseBodyHash) &&
+            record.Read(responseBodySize);
+
+        if (valid && (flags & CAPTURE_FLAG_RESPONSE_BODY_CAPTURED))
+        {
+            valid = record.Remaining() >= responseBodySize;
+        }
+
+        if (!valid)
+        {
+            HC_TRACE_ERROR(HTTPCLIENT, "http_replay_store: malformed record %zu in %s", recordCount, filePath);
+            return E_FAIL;
+        }
+
+        if (flags & CAPTURE_FLAG_RESPONSE_BODY_CAPTURED)
+        {
+            response.body = http_allocate_shared<http_body_bytes>(record.Position(), record.Position() + responseBodySize);
+        }
+        else
+        {
+            // Only the body size was captured; replay a body of the same size so traffic shape is preserved
+            response.body = http_allocate_shared<http_body_bytes>(responseBodySize, static_cast<uint8_t>(0));
+        }
+        response.headers = http_allocate_shared<http_header_map>(std::move(responseHeaders));
+        if (replayLatency)
+        {
+            response.latency = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::microseconds(latencyUs));
+        }
+
+        if (!(flags & CAPTURE_FLAG_REQUEST_BODY_STREAMED))
+        {
+            m_exactIndex[RequestKey(method, url, requestBodySize > 0 ? &requestBodyHash : nullptr)].responses.push_back(response);
+        }
+        m_urlIndex[RequestKey(method, url, nullptr)].responses.push_back(std::move(response));
+        ++recordCount;
+    }
+
+    HC_TRACE_INFORMATION(HTTPCLIENT, "http_replay_store: loaded %zu records from %s", recordCount, filePath);
+    return S_OK;
+}
+CATCH_RETURN()
+
+http_replay_response const* http_replay_store::Next(replay_entry& entry) noexcept
+{
+    if (entry.responses.empty())
+    {
+        return nullptr;
+    }
+
+    size_t index = std::min(entry.nextResponse, entry.responses.size() - 1);
+    if (entry.nextResponse < entry.responses.size())
+    {
+        ++entry.nextResponse;
+    }
+    return &entry.responses[index];
+}
+
+http_replay_response const* http_replay_store::Match(_In_ const HC_CALL* call) noexcept
+{
+    if (Empty())
+    {
+        return nullptr;
+    }
+
+    if (!IsRequestBodyStreamed(call))
+    {
+        uint64_t requestBodyHash = HashBytes(call->requestBodyBytes.data(), call->requestBodyBytes.size());
+        auto exact = m_exactIndex.find(RequestKey(call->method, call->url, call->requestBodySize > 0 ? &requestBodyHash : nullptr));
+        if (exact != m_exactIndex.end())
+        {
+            return Next(exact->second);
+        }
+    }
+
+    auto byUrl = m_urlIndex.find(RequestKey(call->method, call->url, nullptr));
+    if (byUrl != m_urlIndex.end())
+    {
+        return Next(byUrl->second);
+    }
+
+    return nullptr;
+}
+
+bool http_replay_store::Empty() const noexcept
+{
+    return m_urlIndex.empty();
+}
+
+void http_replay_store::Clear() noexcept
+{
+    m_exactIndex.clear();
+    m_urlIndex.clear();
+}
+
+void Capture_Internal_RecordHttpCall(
+    _In_ std::shared_ptr<http_singleton> const& httpSingleton,
+    _In_ HC_CALL* call,
+    _In_ const chrono_clock_t::time_point& completedTime
+) noexcept
+{
+    auto capture = std::atomic_load(&httpSingleton->m_capture);
+    if (capture)
+    {
+        capture->Record(call, completedTime);
+    }
+}
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
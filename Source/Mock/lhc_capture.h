@@ -0,0 +1,94 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+#include "pch.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+struct http_singleton;
+
+// Streams every completed HTTP attempt to a compact binary log. Records are serialized into
+// preallocated segments on the completing thread and written to disk by a background writer thread,
+// so recording never blocks on file I/O.
+class http_capture
+{
+public:
+    static HRESULT Create(
+        _In_z_ const char* filePath,
+        _In_ bool captureResponseBodies,
+        _Out_ std::shared_ptr<http_capture>& capture
+    ) noexcept;
+
+    http_capture(FILE* file, bool captureResponseBodies);
+    ~http_capture();
+
+    void Record(_In_ HC_CALL* call, _In_ const chrono_clock_t::time_point& completedTime) noexcept;
+
+    // Flushes all pending segments and closes the log. Blocks until the writer thread has exited.
+    void Stop() noexcept;
+
+private:
+    using Segment = http_internal_vector<uint8_t>;
+
+    void WriterThreadProc() noexcept;
+    Segment AcquireSegment();
+
+    FILE* m_file;
+    bool const m_captureResponseBodies;
+    chrono_clock_t::time_point const m_startTime;
+
+    std::mutex m_lock;
+    std::condition_variable m_segmentsPending;
+    Segment m_activeSegment;
+    http_internal_queue<Segment> m_fullSegments;
+    http_internal_vector<Segment> m_freeSegments;
+    bool m_stopping{ false };
+    std::thread m_writerThread;
+};
+
+// A single recorded response, shared immutably with every call it is replayed to.
+struct http_replay_response
+{
+    std::shared_ptr<http_body_bytes const> body;
+    std::shared_ptr<http_header_map const> headers;
+    uint32_t statusCode{ 0 };
+    HRESULT networkErrorCode{ S_OK };
+    uint32_t platformNetworkErrorCode{ 0 };
+    std::chrono::milliseconds latency{ 0 };
+};
+
+// Recorded responses indexed by request. Responses recorded for the same request are replayed in order,
+// repeating the last one once exhausted (matching HCMockAddMock semantics).
+class http_replay_store
+{
+public:
+    HRESULT Load(_In_z_ const char* filePath, _In_ bool replayLatency) noexcept;
+
+    http_replay_response const* Match(_In_ const HC_CALL* call) noexcept;
+
+    bool Empty() const noexcept;
+    void Clear() noexcept;
+
+private:
+    struct replay_entry
+    {
+        http_internal_vector<http_replay_response> responses;
+        size_t nextResponse{ 0 };
+    };
+
+    http_replay_response const* Next(replay_entry& entry) noexcept;
+
+    // Keyed by method, URL & request body, with a fallback keyed by method & URL only. Requests whose body is read
+    // from a callback are only in the fallback, as their body isn't known until it has been sent.
+    http_internal_unordered_map<uint64_t, replay_entry> m_exactIndex;
+    http_internal_unordered_map<uint64_t, replay_entry> m_urlIndex;
+};
+
+void Capture_Internal_RecordHttpCall(
+    _In_ std::shared_ptr<http_singleton> const& httpSingleton,
+    _In_ HC_CALL* call,
+    _In_ const chrono_clock_t::time_point& completedTime
+) noexcept;
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
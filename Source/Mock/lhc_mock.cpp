@@ -34,10 +34,60 @@ bool DoesMockCallMatch(_In_ const HC_CALL* mockCall, _In_ const HC_CALL* origina
     return false;
 }
 
-bool Mock_Internal_HCHttpCallPerformAsync(
-    _In_ HCCallHandle originalCall
+void Mock_Internal_ApplyResponseHeaders(
+    _In_ HCCallHandle originalCall,
+    _In_ mock_response const& response
+    )
+{
+    originalCall->statusCode = response.statusCode;
+    originalCall->networkErrorCode = response.networkErrorCode;
+    originalCall->platformNetworkErrorCode = response.platformNetworkErrorCode;
+
+    // The matched call references the mock's headers directly rather than copying them.
+    // Either side copies its own instance if it is mutated later (see http_cow_value).
+    if (originalCall->responseHeaders.get().empty())
+    {
+        originalCall->responseHeaders.share(response.headers);
+    }
+    else
+    {
+        for (auto const& header : *response.headers)
+        {
+            HCHttpCallResponseSetHeaderWithLength(originalCall, header.first.data(), header.first.size(), header.second.data(), header.second.size());
+        }
+    }
+}
+
+void Mock_Internal_ApplyResponseBody(
+    _In_ HCCallHandle originalCall,
+    _In_ mock_response const& response
+    )
+{
+    auto const& body{ response.body };
+    if (originalCall->responseBodyWriteFunction == DefaultResponseBodyWriteFunction)
+    {
+        originalCall->responseBodyBytes.share(body);
+        originalCall->responseString.clear();
+    }
+    else if (!body->empty())
+    {
+        HRESULT hr = originalCall->responseBodyWriteFunction(originalCall, body->data(), body->size(), originalCall->responseBodyWriteFunctionContext);
+        if (FAILED(hr))
+        {
+            // Fails the call as a provider would when the body can't be delivered
+            HC_TRACE_ERROR_HR(HTTPCLIENT, hr, "Mock response body write function failed");
+            originalCall->networkErrorCode = hr;
+        }
+    }
+}
+
+bool Mock_Internal_MatchResponse(
+    _In_ HCCallHandle originalCall,
+    _Out_ mock_response& response
     )
 {
+    response = mock_response{};
+
     auto httpSingleton = get_http_singleton();
     if (nullptr == httpSingleton)
     {
@@ -46,7 +96,7 @@ bool Mock_Internal_HCHttpCallPerformAsync(
 
     std::lock_guard<std::recursive_mutex> guard(httpSingleton->m_mocksLock);
 
-    if (httpSingleton->m_mocks.size() == 0)
+    if (httpSingleton->m_mocks.size() == 0 && httpSingleton->m_replay.Empty())
     {
         return false;
     }
@@ -66,7 +116,23 @@ bool Mock_Internal_HCHttpCallPerformAsync(
 
     if (!mock)
     {
-        return false;
+        // Fall back to responses loaded with HCMockLoadCapture
+        auto replayed = httpSingleton->m_replay.Match(originalCall);
+        if (!replayed)
+        {
+            return false;
+        }
+
+        response.body = replayed->body;
+        response.headers = replayed->headers;
+        response.statusCode = replayed->statusCode;
+        response.networkErrorCode = replayed->networkErrorCode;
+        response.platformNetworkErrorCode = replayed->platformNetworkErrorCode;
+        response.latency = replayed->latency;
+
+        if (originalCall->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "Mock_Internal_MatchResponse [ID %llu]: replayed captured response statusCode=%u bodySize=%zu", TO_ULL(originalCall->id), response.statusCode, response.body->size()); }
+
+        return true;
     }
 
     if (mock->matchedCallback)
@@ -81,30 +147,32 @@ bool Mock_Internal_HCHttpCallPerformAsync(
         );
     }
 
-    size_t byteBuf;
-    HCHttpCallResponseGetResponseBodyBytesSize(mock, &byteBuf);
-    http_memory_buffer buffer(byteBuf);
-    HCHttpCallResponseGetResponseBodyBytes(mock, byteBuf, static_cast<uint8_t*>(buffer.get()), nullptr);
-    HCHttpCallResponseSetResponseBodyBytes(originalCall, static_cast<uint8_t*>(buffer.get()), byteBuf);
-
-    uint32_t code;
-    HCHttpCallResponseGetStatusCode(mock, &code);
-    HCHttpCallResponseSetStatusCode(originalCall, code);
+    response.body = mock->responseBodyBytes.freeze();
+    response.headers = mock->responseHeaders.freeze();
+    response.statusCode = mock->statusCode;
+    response.networkErrorCode = mock->networkErrorCode;
+    response.platformNetworkErrorCode = mock->platformNetworkErrorCode;
 
-    HRESULT genCode;
-    HCHttpCallResponseGetNetworkErrorCode(mock, &genCode, &code);
-    HCHttpCallResponseSetNetworkErrorCode(originalCall, genCode, code);
+    if (originalCall->traceCall) { HC_TRACE_INFORMATION(HTTPCLIENT, "Mock_Internal_MatchResponse [ID %llu]: matched mock [ID %llu] statusCode=%u bodySize=%zu", TO_ULL(originalCall->id), TO_ULL(mock->id), response.statusCode, response.body->size()); }
 
-    uint32_t numheaders;
-    HCHttpCallResponseGetNumHeaders(mock, &numheaders);
+    return true;
+}
 
-    const char* str1;
-    const char* str2;
-    for (uint32_t i = 0; i < numheaders; i++)
+bool Mock_Internal_HCHttpCallPerformAsync(
+    _In_ HCCallHandle originalCall,
+    _Out_ std::chrono::milliseconds& responseLatency
+    )
+{
+    mock_response response;
+    if (!Mock_Internal_MatchResponse(originalCall, response))
     {
-        HCHttpCallResponseGetHeaderAtIndex(mock, i, &str1, &str2);
-        HCHttpCallResponseSetHeader(originalCall, str1, str2);
+        responseLatency = std::chrono::milliseconds::zero();
+        return false;
     }
 
+    // Headers first, as a real response would, so body write functions can inspect them
+    Mock_Internal_ApplyResponseHeaders(originalCall, response);
+    Mock_Internal_ApplyResponseBody(originalCall, response);
+    responseLatency = response.latency;
     return true;
 }
@@ -10,4 +10,39 @@ struct HC_MOCK_CALL : public HC_CALL
     void* matchCallbackContext{ nullptr };
 };
 
-bool Mock_Internal_HCHttpCallPerformAsync(_In_ HCCallHandle originalCall);
+// A matched mock or replayed response. The body & headers are shared immutably with the mock.
+struct mock_response
+{
+    std::shared_ptr<http_body_bytes const> body;
+    std::shared_ptr<http_header_map const> headers;
+    uint32_t statusCode{ 0 };
+    HRESULT networkErrorCode{ S_OK };
+    uint32_t platformNetworkErrorCode{ 0 };
+    std::chrono::milliseconds latency{ 0 };
+};
+
+// Matches the call against added mocks, then against responses loaded with HCMockLoadCapture.
+// Invokes the mock's matched callback but doesn't modify the call.
+bool Mock_Internal_MatchResponse(
+    _In_ HCCallHandle originalCall,
+    _Out_ mock_response& response
+    );
+
+// Sets the call's status, network error codes & response headers from a matched response.
+void Mock_Internal_ApplyResponseHeaders(
+    _In_ HCCallHandle originalCall,
+    _In_ mock_response const& response
+    );
+
+// Delivers a matched response body to the call's response body write function in a single write.
+void Mock_Internal_ApplyResponseBody(
+    _In_ HCCallHandle originalCall,
+    _In_ mock_response const& response
+    );
+
+// Matches and applies a mock or replayed response to the call.
+// responseLatency is set to the recorded latency the matched response should be delayed by, if any.
+bool Mock_Internal_HCHttpCallPerformAsync(
+    _In_ HCCallHandle originalCall,
+    _Out_ std::chrono::milliseconds& responseLatency
+    );
@@ -0,0 +1,366 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "lhc_network_emulator.h"
+#include "lhc_mock.h"
+#include "../Global/global.h"
+#include "../Common/uri.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+namespace
+{
+
+// Emulated failures report the same platform errors as the WinHttp provider
+constexpr uint32_t EMULATED_TIMEOUT_ERROR = 12002; // ERROR_WINHTTP_TIMEOUT
+constexpr uint32_t EMULATED_CONNECTION_RESET_ERROR = 12030; // ERROR_WINHTTP_CONNECTION_ERROR
+
+http_internal_string NormalizeHost(http_internal_string host)
+{
+    std::transform(host.begin(), host.end(), host.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+    return host;
+}
+
+}
+
+// Where an emulated call is. Only a running step touches the call; a cancel that finds the call waiting on a
+// timer completes it, and one that finds a step running leaves that step to complete it.
+enum class emulated_call_stage : uint32_t
+{
+    Running,
+    Waiting,
+    Canceled,
+    Done
+};
+
+struct network_emulator::emulated_call
+{
+    HCCallHandle call{ nullptr };
+    XAsyncBlock* async{ nullptr };
+    HCPerformEnv env{ nullptr };
+    HttpPerformInfo next{ nullptr, nullptr };
+    std::atomic<emulated_call_stage> stage{ emulated_call_stage::Running };
+
+    bool matched{ false };
+    mock_response response;
+
+    HCMockNetworkProfile profile{};
+    std::chrono::milliseconds latency{ 0 };
+    bool lost{ false };
+    size_t resetOffset{ SIZE_MAX };
+
+    size_t bodyOffset{ 0 };
+    chrono_clock_t::time_point bodyStartTime;
+};
+
+HRESULT network_emulator::Install() noexcept
+{
+    // The perform function being replaced, which PerformAsync gets as its context
+    static HttpPerformInfo s_next{ nullptr, nullptr };
+
+    if (get_http_singleton() != nullptr)
+    {
+        return E_HC_ALREADY_INITIALISED;
+    }
+
+    HCCallPerformFunction handler = nullptr;
+    void* context = nullptr;
+    RETURN_IF_FAILED(HCGetHttpCallPerformFunction(&handler, &context));
+    if (handler != PerformAsync)
+    {
+        s_next = HttpPerformInfo{ handler, context };
+    }
+
+    return HCSetHttpCallPerformFunction(PerformAsync, &s_next);
+}
+
+void CALLBACK network_emulator::PerformAsync(
+    _In_ HCCallHandle call,
+    _Inout_ XAsyncBlock* asyncBlock,
+    _In_opt_ void* context,
+    _In_ HCPerformEnv env
+) noexcept
+{
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+    {
+        XAsyncComplete(asyncBlock, E_HC_NOT_INITIALISED, 0);
+        return;
+    }
+
+    try
+    {
+        auto state = http_allocate_shared<emulated_call>();
+        state->call = call;
+        state->async = asyncBlock;
+        state->env = env;
+        if (context != nullptr)
+        {
+            state->next = *static_cast<HttpPerformInfo const*>(context);
+        }
+        state->matched = Mock_Internal_MatchResponse(call, state->response);
+
+        httpSingleton->m_networkEmulator.SampleConditions(*state);
+
+        if (call->traceCall) { HC_TRACE_VERBOSE(HTTPCLIENT, "network_emulator [ID %llu]: matched=%d latency=%lld ms lost=%d reset=%d", TO_ULL(call->id), state->matched, state->latency.count(), state->lost, state->resetOffset != SIZE_MAX); }
+
+        if (!http_call_set_cancel_handler(call, OnCancel, state.get()))
+        {
+            XAsyncComplete(asyncBlock, E_ABORT, 0);
+            return;
+        }
+
+        ScheduleStep(state, state->latency, OnResponse);
+    }
+    catch (...)
+    {
+        XAsyncComplete(asyncBlock, E_FAIL, 0);
+    }
+}
+
+HRESULT network_emulator::SetProfile(
+    _In_opt_z_ const char* host,
+    _In_opt_ const HCMockNetworkProfile* profile
+) noexcept
+try
+{
+    if (profile != nullptr &&
+        (profile->lossProbability < 0 || profile->lossProbability > 1 ||
+         profile->resetProbability < 0 || profile->resetProbability > 1))
+    {
+        return E_INVALIDARG;
+    }
+
+    std::lock_guard<std::mutex> lock{ m_lock };
+    if (host == nullptr)
+    {
+        m_defaultProfile = profile ? *profile : HCMockNetworkProfile{};
+    }
+    else if (profile == nullptr)
+    {
+        m_hostProfiles.erase(NormalizeHost(host));
+    }
+    else
+    {
+        m_hostProfiles[NormalizeHost(host)] = *profile;
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+void network_emulator::SampleConditions(_Inout_ emulated_call& state) noexcept
+{
+    // Parsing lowercases the host, as NormalizeHost does
+    auto host = http_call_get_parsed_url(state.call).Host().str();
+
+    std::lock_guard<std::mutex> lock{ m_lock };
+
+    auto iter = m_hostProfiles.find(host);
+    auto const& profile = iter != m_hostProfiles.end() ? iter->second : m_defaultProfile;
+    state.profile = profile;
+
+    double latencyMs = profile.latencyMs;
+    double deviationMs = profile.latencyDeviationMs;
+    if (deviationMs > 0)
+    {
+        switch (profile.latencyDistribution)
+        {
+        case HCMockLatencyDistribution::Uniform:
+            latencyMs += std::uniform_real_distribution<double>{ 0, deviationMs }(m_random);
+            break;
+
+        case HCMockLatencyDistribution::Normal:
+            latencyMs = std::max(0.0, std::normal_distribution<double>{ latencyMs, deviationMs }(m_random));
+            break;
+
+        case HCMockLatencyDistribution::Exponential:
+            latencyMs += std::exponential_distribution<double>{ 1.0 / deviationMs }(m_random);
+            break;
+
+        default:
+            break;
+        }
+    }
+    state.latency = std::chrono::milliseconds{ static_cast<int64_t>(latencyMs) } + state.response.latency;
+
+    state.lost = std::bernoulli_distribution{ profile.lossProbability }(m_random);
+    if (state.lost)
+    {
+        // A lost response is only noticed once the call times out
+        uint32_t timeoutInSeconds = 0;
+        HCHttpCallRequestGetTimeout(state.call, &timeoutInSeconds);
+        state.latency = std::chrono::seconds{ timeoutInSeconds };
+    }
+    else if (state.matched && std::bernoulli_distribution{ profile.resetProbability }(m_random))
+    {
+        size_t bodySize = state.response.body->size();
+        state.resetOffset = bodySize > 0 ? std::uniform_int_distribution<size_t>{ 0, bodySize - 1 }(m_random) : 0;
+    }
+}
+
+void network_emulator::OnCancel(_In_ HCCallHandle /*call*/, _In_opt_ void* context)
+{
+    auto state = static_cast<emulated_call*>(context);
+
+    // Once the stage changes the timer may release the state, so read what's needed first
+    XAsyncBlock* async = state->async;
+    if (state->stage.exchange(emulated_call_stage::Canceled) == emulated_call_stage::Waiting)
+    {
+        XAsyncComplete(async, E_ABORT, 0);
+    }
+}
+
+void network_emulator::Complete(std::shared_ptr<emulated_call> const& state, HRESULT result) noexcept
+{
+    // A cancel that came while the step ran wins
+    auto expected = emulated_call_stage::Running;
+    if (!state->stage.compare_exchange_strong(expected, emulated_call_stage::Done))
+    {
+        result = E_ABORT;
+    }
+
+    http_call_clear_cancel_handler(state->call);
+    XAsyncComplete(state->async, result, 0);
+}
+
+void network_emulator::OnResponse(std::shared_ptr<emulated_call> state) noexcept
+{
+    HCCallHandle call = state->call;
+
+    if (state->lost)
+    {
+        HCHttpCallResponseSetNetworkErrorCode(call, E_FAIL, __HRESULT_FROM_WIN32(EMULATED_TIMEOUT_ERROR));
+        Complete(state, S_OK);
+        return;
+    }
+
+    if (!state->matched)
+    {
+        // The perform function the emulator replaced takes over the call, cancellation included
+        auto expected = emulated_call_stage::Running;
+        if (!state->stage.compare_exchange_strong(expected, emulated_call_stage::Done))
+        {
+            Complete(state, E_ABORT);
+            return;
+        }
+        http_call_clear_cancel_handler(call);
+
+        HttpPerformInfo next = state->next.handler != nullptr ? state->next : HttpPerformInfo{ Internal_HCHttpCallPerformAsync, nullptr };
+        next.handler(call, state->async, next.context, state->env);
+        return;
+    }
+
+    Mock_Internal_ApplyResponseHeaders(call, state->response);
+
+    auto const& profile = state->profile;
+    if (profile.bandwidthBytesPerSecond == 0 && profile.chunkSizeBytes == 0 && state->resetOffset == SIZE_MAX)
+    {
+        Mock_Internal_ApplyResponseBody(call, state->response);
+        Complete(state, S_OK);
+        return;
+    }
+
+    state->bodyStartTime = chrono_clock_t::now();
+    DeliverBody(std::move(state));
+}
+
+void network_emulator::DeliverBody(std::shared_ptr<emulated_call> state) noexcept
+{
+    HCCallHandle call = state->call;
+    auto const& body = *state->response.body;
+    auto const& profile = state->profile;
+
+    size_t bodyEnd = std::min(body.size(), state->resetOffset);
+    size_t chunkSize = profile.chunkSizeBytes > 0 ? profile.chunkSizeBytes : body.size();
+
+    while (state->bodyOffset < bodyEnd)
+    {
+        if (state->stage.load() == emulated_call_stage::Canceled)
+        {
+            Complete(state, E_ABORT);
+            return;
+        }
+
+        size_t bytesToWrite = std::min(chunkSize, bodyEnd - state->bodyOffset);
+
+        if (profile.bandwidthBytesPerSecond > 0)
+        {
+            // Each chunk arrives once all of its bytes could have been transferred at the emulated bandwidth
+            auto transferTime = std::chrono::microseconds{ static_cast<int64_t>((state->bodyOffset + bytesToWrite) * 1000000.0 / profile.bandwidthBytesPerSecond) };
+            auto remaining = state->bodyStartTime + transferTime - chrono_clock_t::now();
+            if (remaining > std::chrono::milliseconds::zero())
+            {
+                auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(remaining + std::chrono::milliseconds{ 1 } - std::chrono::nanoseconds{ 1 });
+                ScheduleStep(std::move(state), delay, DeliverBody);
+                return;
+            }
+        }
+
+        HRESULT hr = call->responseBodyWriteFunction(call, body.data() + state->bodyOffset, bytesToWrite, call->responseBodyWriteFunctionContext);
+        if (FAILED(hr))
+        {
+            HC_TRACE_ERROR_HR(HTTPCLIENT, hr, "network_emulator: response body write function failed");
+            Complete(state, hr);
+            return;
+        }
+        state->bodyOffset += bytesToWrite;
+    }
+
+    if (state->bodyOffset < body.size())
+    {
+        HCHttpCallResponseSetNetworkErrorCode(call, E_FAIL, __HRESULT_FROM_WIN32(EMULATED_CONNECTION_RESET_ERROR));
+    }
+
+    Complete(state, S_OK);
+}
+
+void network_emulator::ScheduleStep(
+    std::shared_ptr<emulated_call> state,
+    std::chrono::milliseconds delay,
+    void(*step)(std::shared_ptr<emulated_call>)
+) noexcept
+{
+    if (delay.count() <= 0)
+    {
+        step(std::move(state));
+        return;
+    }
+
+    // The timer can't be canceled, so a cancel while waiting completes the call and the step is skipped when it fires
+    auto expected = emulated_call_stage::Running;
+    if (!state->stage.compare_exchange_strong(expected, emulated_call_stage::Waiting))
+    {
+        Complete(state, E_ABORT);
+        return;
+    }
+
+    XAsyncBlock* async = state->async;
+    HRESULT hr = S_OK;
+    try
+    {
+        hr = RunAsync([state, step]
+        {
+            auto waiting = emulated_call_stage::Waiting;
+            if (state->stage.compare_exchange_strong(waiting, emulated_call_stage::Running))
+            {
+                step(state);
+            }
+        }, async->queue, static_cast<uint64_t>(delay.count()));
+    }
+    catch (...)
+    {
+        hr = E_OUTOFMEMORY;
+    }
+
+    if (FAILED(hr))
+    {
+        expected = emulated_call_stage::Waiting;
+        if (state->stage.compare_exchange_strong(expected, emulated_call_stage::Running))
+        {
+            Complete(state, hr);
+        }
+    }
+}
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
@@ -0,0 +1,49 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+#include "pch.h"
+#include <random>
+
+NAMESPACE_XBOX_HTTP_CLIENT_BEGIN
+
+// HTTP perform function that delivers mock & replayed responses with emulated latency, bandwidth and failures.
+// Every delay is a task queue timer on the call's queue, so pending emulated calls don't consume threads.
+class network_emulator
+{
+public:
+    // Registers PerformAsync as the perform function. Calls that don't match a mock are forwarded to the perform
+    // function it replaces.
+    static HRESULT Install() noexcept;
+
+    static void CALLBACK PerformAsync(
+        _In_ HCCallHandle call,
+        _Inout_ XAsyncBlock* asyncBlock,
+        _In_opt_ void* context,
+        _In_ HCPerformEnv env
+    ) noexcept;
+
+    HRESULT SetProfile(_In_opt_z_ const char* host, _In_opt_ const HCMockNetworkProfile* profile) noexcept;
+
+private:
+    struct emulated_call;
+
+    void SampleConditions(_Inout_ emulated_call& state) noexcept;
+
+    static void OnCancel(_In_ HCCallHandle call, _In_opt_ void* context);
+    static void Complete(std::shared_ptr<emulated_call> const& state, HRESULT result) noexcept;
+    static void OnResponse(std::shared_ptr<emulated_call> state) noexcept;
+    static void DeliverBody(std::shared_ptr<emulated_call> state) noexcept;
+    static void ScheduleStep(
+        std::shared_ptr<emulated_call> state,
+        std::chrono::milliseconds delay,
+        void(*step)(std::shared_ptr<emulated_call>)
+    ) noexcept;
+
+    std::mutex m_lock;
+    HCMockNetworkProfile m_defaultProfile{};
+    http_internal_map<http_internal_string, HCMockNetworkProfile> m_hostProfiles;
+    std::minstd_rand m_random;
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_END
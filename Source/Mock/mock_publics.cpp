@@ -139,10 +139,85 @@ try
     }
 
     httpSingleton->m_mocks.clear();
+    httpSingleton->m_replay.Clear();
     return S_OK;
 }
 CATCH_RETURN()
 
+STDAPI
+HCMockStartCapture(
+    _In_z_ const char* filePath,
+    _In_ bool captureResponseBodies
+    ) noexcept
+try
+{
+    if (filePath == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+        return E_HC_NOT_INITIALISED;
+
+    if (std::atomic_load(&httpSingleton->m_capture))
+    {
+        return E_HC_ALREADY_INITIALISED;
+    }
+
+    std::shared_ptr<http_capture> capture;
+    RETURN_IF_FAILED(http_capture::Create(filePath, captureResponseBodies, capture));
+
+    std::shared_ptr<http_capture> expected;
+    if (!std::atomic_compare_exchange_strong(&httpSingleton->m_capture, &expected, capture))
+    {
+        capture->Stop();
+        return E_HC_ALREADY_INITIALISED;
+    }
+
+    HC_TRACE_INFORMATION(HTTPCLIENT, "HCMockStartCapture: capturing to %s", filePath);
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI
+HCMockStopCapture() noexcept
+try
+{
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+        return E_HC_NOT_INITIALISED;
+
+    auto capture = std::atomic_exchange(&httpSingleton->m_capture, std::shared_ptr<http_capture>{});
+    if (capture)
+    {
+        capture->Stop();
+    }
+    return S_OK;
+}
+CATCH_RETURN()
+
+STDAPI
+HCMockLoadCapture(
+    _In_z_ const char* filePath,
+    _In_ bool replayLatency
+    ) noexcept
+try
+{
+    if (filePath == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+        return E_HC_NOT_INITIALISED;
+
+    std::lock_guard<std::recursive_mutex> guard(httpSingleton->m_mocksLock);
+    return httpSingleton->m_replay.Load(filePath, replayLatency);
+}
+CATCH_RETURN()
+
 STDAPI 
 HCMockResponseSetResponseBodyBytes(
     _In_ HCMockCallHandle call,
@@ -182,3 +257,23 @@ HCMockResponseSetHeader(
     return HCHttpCallResponseSetHeader(call, headerName, headerValue);
 }
 
+STDAPI
+HCMockEnableNetworkEmulation() noexcept
+{
+    return network_emulator::Install();
+}
+
+STDAPI
+HCMockSetNetworkProfile(
+    _In_opt_z_ const char* host,
+    _In_opt_ const HCMockNetworkProfile* profile
+    ) noexcept
+try
+{
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+        return E_HC_NOT_INITIALISED;
+
+    return httpSingleton->m_networkEmulator.SetProfile(host, profile);
+}
+CATCH_RETURN()
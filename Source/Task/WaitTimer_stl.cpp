@@ -159,6 +159,13 @@ namespace OS
                 lock.lock();
             }
 
+            // The destructor may have asked us to exit while a callback ran
+            // without the lock, in which case its notify has already happened
+            if (m_exitThread)
+            {
+                break;
+            }
+
             if (!m_queue.empty())
             {
                 Deadline next = Peek().When;
@@ -3,7 +3,7 @@
 
 #include "pch.h"
 #if HC_UNITTEST_API
-#include "websocket.h"
+#include "../hcwebsocket.h"
 
 using namespace xbox::httpclient;
 
@@ -11,8 +11,8 @@ using namespace xbox::httpclient;
 
 
 HRESULT CALLBACK Internal_HCWebSocketConnectAsync(
-    _In_z_ PCSTR uri,
-    _In_z_ PCSTR subProtocol,
+    _In_z_ const char* uri,
+    _In_z_ const char* subProtocol,
     _In_ HCWebsocketHandle websocket,
     _Inout_ XAsyncBlock* asyncBlock,
     _In_opt_ void* context,
@@ -30,7 +30,7 @@ HRESULT CALLBACK Internal_HCWebSocketConnectAsync(
 
 HRESULT CALLBACK Internal_HCWebSocketSendMessageAsync(
     _In_ HCWebsocketHandle websocket,
-    _In_z_ PCSTR message,
+    _In_z_ const char* message,
     _Inout_ XAsyncBlock* asyncBlock,
     _In_opt_ void* context
     )
@@ -6,9 +6,14 @@
 #if !HC_NOWEBSOCKETS && !HC_WINHTTP_WEBSOCKETS
 
 #include "../hcwebsocket.h"
+#include "tls_session_cache.h"
 #include "uri.h"
 #include "x509_cert_utilities.hpp"
 
+#if !HC_TLS_SESSION_CACHE
+#error websocketpp websockets share the TLS session cache; build with HC_TLS_SESSION_CACHE and tls_session_cache.cpp
+#endif
+
 // Force websocketpp to use C++ std::error_code instead of Boost.
 #define _WEBSOCKETPP_CPP11_SYSTEM_ERROR_
 
@@ -51,8 +56,8 @@ using namespace xbox::httpclient;
 struct websocket_outgoing_message
 {
     XAsyncBlock* async{ nullptr };
-    http_internal_string payload;
-    http_internal_vector<uint8_t> payloadBinary;
+    http_websocket_string payload;
+    http_websocket_bytes payloadBinary;
     websocketpp::lib::error_code error;
     uint64_t id{ 0 };
 };
@@ -96,6 +101,7 @@ public:
         if (m_uri.Scheme() == "wss")
         {
             m_client = std::unique_ptr<websocketpp_client_base>(new websocketpp_tls_client());
+            RETURN_IF_FAILED(tls_session_cache::Acquire(&m_tlsSessionCache));
 
             auto sharedThis{ shared_from_this() };
 
@@ -103,35 +109,15 @@ public:
             auto &client = m_client->client<websocketpp::config::asio_tls_client>();
             client.set_tls_init_handler([sharedThis](websocketpp::connection_hdl)
             {
-                auto sslContext = websocketpp::lib::shared_ptr<asio::ssl::context>(new asio::ssl::context(asio::ssl::context::sslv23));
-                sslContext->set_default_verify_paths();
-                sslContext->set_options(asio::ssl::context::default_workarounds);
-                sslContext->set_verify_mode(asio::ssl::context::verify_peer);
-
-                sharedThis->m_opensslFailed = false;
-                sslContext->set_verify_callback([sharedThis](bool preverified, asio::ssl::verify_context &verifyCtx)
+                // Every connection shares the process wide client context, which verifies the peer and caches the
+                // sessions that let a reconnect skip the full handshake. A null context fails the connection.
+                websocketpp::lib::shared_ptr<asio::ssl::context> sslContext;
+                ssl_ctx_st* sharedContext = nullptr;
+                if (SUCCEEDED(sharedThis->m_tlsSessionCache->GetClientContext(tls_verification::peer, &sharedContext)))
                 {
-                    // allow to use proxies that decrypt https for debugging
-                    if (sharedThis->m_hcWebsocketHandle->ProxyDecryptsHttps())
-                    {
-                        return true;
-                    }
-
-                    // On OS X, iOS, and Android, OpenSSL doesn't have access to where the OS
-                    // stores keychains. If OpenSSL fails we will doing verification at the
-                    // end using the whole certificate chain so wait until the 'leaf' cert.
-                    // For now return true so OpenSSL continues down the certificate chain.
-                    if (!preverified)
-                    {
-                        sharedThis->m_opensslFailed = true;
-                    }
-                    if (sharedThis->m_opensslFailed)
-                    {
-                        return xbox::httpclient::verify_cert_chain_platform_specific(verifyCtx, sharedThis->m_uri.Host());
-                    }
-                    asio::ssl::rfc2818_verification rfc2818(sharedThis->m_uri.Host().data());
-                    return rfc2818(preverified, verifyCtx);
-                });
+                    // Takes over the reference
+                    sslContext = websocketpp::lib::make_shared<asio::ssl::context>(sharedContext);
+                }
 
                 // OpenSSL stores some per thread state that never will be cleaned up until
                 // the dll is unloaded. If static linking, like we do, the state isn't cleaned up
@@ -156,6 +142,37 @@ public:
             {
                 // If user specified server name is empty default to use URI host name.
                 SSL_set_tlsext_host_name(ssl_stream.native_handle(), sharedThis->m_uri.Host().data());
+
+                // Offers the session of an earlier connection to the same server. Without it the handshake is simply a full one.
+                uint16_t port = sharedThis->m_uri.IsPortDefault() ? 443 : sharedThis->m_uri.Port();
+                (void)sharedThis->m_tlsSessionCache->PrepareConnection(ssl_stream.native_handle(), sharedThis->m_uri.Host().data(), port);
+
+                // The context is shared, so the callback checking this connection's host goes on the stream
+                sharedThis->m_opensslFailed = false;
+                ssl_stream.set_verify_mode(asio::ssl::verify_peer);
+                ssl_stream.set_verify_callback([sharedThis](bool preverified, asio::ssl::verify_context &verifyCtx)
+                {
+                    // allow to use proxies that decrypt https for debugging
+                    if (sharedThis->m_hcWebsocketHandle->ProxyDecryptsHttps())
+                    {
+                        return true;
+                    }
+
+                    // On OS X, iOS, and Android, OpenSSL doesn't have access to where the OS
+                    // stores keychains. If OpenSSL fails we will doing verification at the
+                    // end using the whole certificate chain so wait until the 'leaf' cert.
+                    // For now return true so OpenSSL continues down the certificate chain.
+                    if (!preverified)
+                    {
+                        sharedThis->m_opensslFailed = true;
+                    }
+                    if (sharedThis->m_opensslFailed)
+                    {
+                        return xbox::httpclient::verify_cert_chain_platform_specific(verifyCtx, sharedThis->m_uri.Host().str());
+                    }
+                    asio::ssl::rfc2818_verification rfc2818(sharedThis->m_uri.Host().data());
+                    return rfc2818(preverified, verifyCtx);
+                });
             });
 
             return connect_impl<websocketpp::config::asio_tls_client>(async);
@@ -186,7 +203,7 @@ public:
             return E_HC_NOT_INITIALISED;
         }
 
-        http_internal_string payload(payloadPtr);
+        http_websocket_string payload(payloadPtr);
         if (payload.length() == 0)
         {
             return E_INVALIDARG;
@@ -397,7 +414,7 @@ private:
         for (const auto & header : headers)
         {
             // Subprotocols are handled separately below
-            if (str_icmp(header.first, SUB_PROTOCOL_HEADER) != 0)
+            if (str_icmp(header.first.c_str(), SUB_PROTOCOL_HEADER) != 0)
             {
                 con->append_header(header.first.data(), header.second.data());
             }
@@ -859,6 +876,7 @@ private:
     // failed. This can safely be tracked at the client level since connections
     // only happen once for each client.
     bool m_opensslFailed{ false };
+    std::shared_ptr<tls_session_cache> m_tlsSessionCache;
 
     HCWebsocketHandle m_hcWebsocketHandle{ nullptr };
 
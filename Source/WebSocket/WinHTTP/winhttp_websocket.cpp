@@ -26,7 +26,10 @@ public:
         {
             HCHttpCallCloseHandle(m_call);
         }
-        shared_ptr_cache::remove(m_httpTask.get());
+        if (m_httpTask != nullptr)
+        {
+            shared_ptr_cache::remove(m_httpTask->m_cacheHandle);
+        }
     }
 
     HRESULT connect_websocket(
@@ -56,7 +59,7 @@ public:
             }
             else
             {
-                shared_ptr_cache::remove(m_httpTask.get());
+                shared_ptr_cache::remove(m_httpTask->m_cacheHandle);
             }
         }
 
@@ -74,9 +77,9 @@ public:
             }
         };
 
-        auto context = shared_ptr_cache::store<winhttp_http_task>(m_httpTask);
+        m_httpTask->m_cacheHandle = shared_ptr_cache::store<winhttp_http_task>(m_httpTask);
 
-        hr = XAsyncBegin(asyncBlock, context, HCWebSocketConnectAsync, __FUNCTION__,
+        hr = XAsyncBegin(asyncBlock, m_httpTask->m_cacheHandle, HCWebSocketConnectAsync, __FUNCTION__,
             [](XAsyncOp op, const XAsyncProviderData* data)
         {
             auto httpTask = shared_ptr_cache::fetch<winhttp_http_task>(data->context);
@@ -128,7 +131,7 @@ public:
             return E_HC_NOT_INITIALISED;
         }
 
-        http_internal_string payload(payloadPtr);
+        http_websocket_string payload(payloadPtr);
         if (payload.length() == 0)
         {
             return E_INVALIDARG;
@@ -184,8 +187,8 @@ private:
     struct send_msg_context
     {
         XAsyncBlock* asyncBlock{};
-        http_internal_string payload;
-        http_internal_vector<uint8_t> binaryPayload;
+        http_websocket_string payload;
+        http_websocket_bytes binaryPayload;
         HRESULT hr{ S_OK };
         uint64_t id;
         std::shared_ptr<winhttp_websocket_impl> pThis;
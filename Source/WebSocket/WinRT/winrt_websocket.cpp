@@ -15,8 +15,8 @@ using namespace ::Windows::Networking::Sockets;
 class websocket_outgoing_message
 {
 public: 
-    http_internal_string m_message;
-    http_internal_vector<uint8_t> m_messageBinary;
+    http_websocket_string m_message;
+    http_websocket_bytes m_messageBinary;
     XAsyncBlock* m_asyncBlock;
     DataWriterStoreOperation^ m_storeAsyncOp;
     AsyncStatus m_storeAsyncOpStatus;
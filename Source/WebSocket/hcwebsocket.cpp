@@ -6,6 +6,7 @@
 #if !HC_NOWEBSOCKETS
 
 #include "hcwebsocket.h"
+#include "uri.h"
 
 using namespace xbox::httpclient;
 
@@ -136,16 +137,23 @@ HRESULT HC_WEBSOCKET::Connect(
                 }
             );
 
+            // The provider may complete the connect before returning, so be Connecting (and hold its ref) first
+            {
+                std::lock_guard<std::recursive_mutex> lock{ m_mutex };
+                m_state = State::Connecting;
+            }
+            // Add a ref for the provider. This guarantees the HC_WEBSOCKET is alive until disconnect.
+            AddRef();
+
             HRESULT hr = connectFunc(uri, subProtocol, this, &m_connectAsyncBlock, info.context, httpSingleton->m_performEnv.get());
 
-            if (SUCCEEDED(hr))
+            if (FAILED(hr))
             {
                 {
                     std::lock_guard<std::recursive_mutex> lock{ m_mutex };
-                    m_state = State::Connecting;
+                    m_state = State::Initial;
                 }
-                // Add a ref for the provider. This guarantees the HC_WEBSOCKET is alive until disconnect.
-                AddRef();
+                DecRef();
             }
             return hr;
         }
@@ -176,16 +184,14 @@ void notify_websocket_routed_handlers(
         return;
     }
 
-    std::lock_guard<std::recursive_mutex> lock(httpSingleton->m_callRoutedHandlersLock);
-    for (const auto& pair : httpSingleton->m_webSocketRoutedHandlers)
+    if (httpSingleton->m_webSocketRoutedHandlers.empty())
     {
-        pair.second.first(
-            websocket,
-            receiving,
-            message,
-            payloadBytes,
-            payloadSize,
-            pair.second.second);
+        return;
+    }
+
+    if (!httpSingleton->m_routedHandlerDispatcher.QueueWebSocketNotification(websocket, receiving, message, payloadBytes, payloadSize))
+    {
+        httpSingleton->m_webSocketRoutedHandlers.notify(websocket, receiving, message, payloadBytes, payloadSize);
     }
 }
 
@@ -369,7 +375,7 @@ HRESULT HC_WEBSOCKET::SetHeader(
     {
         return E_HC_CONNECT_ALREADY_CALLED;
     }
-    m_connectHeaders[headerName] = headerValue;
+    m_connectHeaders[http_arena_string{ headerName.data(), headerName.size() }].assign(headerValue.data(), headerValue.size());
     return S_OK;
 }
 
@@ -636,6 +642,87 @@ try
 }
 CATCH_RETURN()
 
+#if HC_TLS_SESSION_CACHE && (HC_PLATFORM == HC_PLATFORM_WIN32 || HC_PLATFORM == HC_PLATFORM_ANDROID || HC_PLATFORM_IS_APPLE)
+namespace
+{
+
+// websocketpp connections resume the sessions of the TLS session cache, so warming it is all a preconnect does
+struct websocket_preconnect_context
+{
+    std::shared_ptr<tls_session_cache> cache;
+    http_internal_string hostName;
+    uint16_t port{ 0 };
+};
+
+}
+#endif
+
+STDAPI
+HCWebSocketPreconnectAsync(
+    _In_z_ const char* uri,
+    _Inout_ XAsyncBlock* asyncBlock
+    ) noexcept
+try
+{
+    if (uri == nullptr || asyncBlock == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    auto httpSingleton = get_http_singleton();
+    if (nullptr == httpSingleton)
+    {
+        return E_HC_NOT_INITIALISED;
+    }
+
+#if HC_TLS_SESSION_CACHE && (HC_PLATFORM == HC_PLATFORM_WIN32 || HC_PLATFORM == HC_PLATFORM_ANDROID || HC_PLATFORM_IS_APPLE)
+    Uri parsedUri{ uri };
+    RETURN_HR_IF(E_INVALIDARG, !parsedUri.IsValid() || parsedUri.IsEmpty());
+    bool secure = parsedUri.Scheme() == "wss";
+    RETURN_HR_IF(E_INVALIDARG, !secure && parsedUri.Scheme() != "ws");
+
+    auto context = http_allocate_unique<websocket_preconnect_context>();
+    context->cache = httpSingleton->m_tlsSessionCache;
+    context->hostName = parsedUri.Host().str();
+    context->port = parsedUri.IsPortDefault() ? 443 : parsedUri.Port();
+
+    RETURN_IF_FAILED(XAsyncBegin(asyncBlock, context.get(), (void*)HCWebSocketPreconnectAsync, __FUNCTION__,
+        [](XAsyncOp op, const XAsyncProviderData* data)
+        {
+            auto context{ static_cast<websocket_preconnect_context*>(data->context) };
+
+            switch (op)
+            {
+            case XAsyncOp::DoWork:
+            {
+                HRESULT hr = context->cache->Warm(context->hostName.c_str(), context->port, tls_verification::peer);
+                XAsyncComplete(data->async, hr, 0);
+                return S_OK;
+            }
+            case XAsyncOp::Cleanup:
+            {
+                HC_UNIQUE_PTR<websocket_preconnect_context> owned{ context };
+                return S_OK;
+            }
+            default: return S_OK;
+            }
+        }
+    ));
+
+    // Cleanup owns the context from here on, even if scheduling fails
+    context.release();
+    if (!secure)
+    {
+        XAsyncComplete(asyncBlock, S_OK, 0);
+        return S_OK;
+    }
+    return XAsyncSchedule(asyncBlock, 0);
+#else
+    return E_NOTIMPL;
+#endif
+}
+CATCH_RETURN()
+
 STDAPI
 HCWebSocketSendMessageAsync(
     _In_ HCWebsocketHandle websocket,
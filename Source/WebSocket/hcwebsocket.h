@@ -98,6 +98,16 @@ private:
 
 } HC_WEBSOCKET;
 
+template<>
+struct http_memory_type<HC_WEBSOCKET>
+{
+    static constexpr HCMemoryType value = HC_MEMORY_TYPE_WEBSOCKET;
+};
+
+// The messages providers send, which are allocated as HC_MEMORY_TYPE_WEBSOCKET
+using http_websocket_string = std::basic_string<char, std::char_traits<char>, http_stl_allocator<char, HC_MEMORY_TYPE_WEBSOCKET>>;
+using http_websocket_bytes = std::vector<uint8_t, http_stl_allocator<uint8_t, HC_MEMORY_TYPE_WEBSOCKET>>;
+
 HRESULT CALLBACK Internal_HCWebSocketConnectAsync(
     _In_z_ const char* uri,
     _In_z_ const char* subProtocol,
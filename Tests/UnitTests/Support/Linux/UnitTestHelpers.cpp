@@ -0,0 +1,117 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "UnitTestIncludes.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cwchar>
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
+
+std::vector<test_case_info>& RegisteredTestCases()
+{
+    static std::vector<test_case_info> testCases;
+    return testCases;
+}
+
+void FailTest(std::string const& message, const char* file, int line)
+{
+    throw test_failure{ std::string{ file } + ":" + std::to_string(line) + ": " + message };
+}
+
+void Logger::WriteMessage(const char* message)
+{
+    printf("%s\n", message);
+}
+
+void Logger::WriteMessage(const wchar_t* message)
+{
+    printf("%ls\n", message);
+}
+
+void LogComment(const wchar_t* format, ...)
+{
+    // The tests use the Microsoft spelling of a wide string argument, %ws, which is %ls here
+    std::wstring portableFormat{ format };
+    for (size_t i = portableFormat.find(L"%ws"); i != std::wstring::npos; i = portableFormat.find(L"%ws", i + 3))
+    {
+        portableFormat[i + 1] = L'l';
+    }
+
+    // vswprintf fails rather than truncating, so grow the buffer until the message fits
+    std::vector<wchar_t> message(256);
+    for (;;)
+    {
+        va_list args;
+        va_start(args, format);
+        int written = vswprintf(message.data(), message.size(), portableFormat.c_str(), args);
+        va_end(args);
+        if (written >= 0)
+        {
+            break;
+        }
+        if (message.size() >= 64 * 1024)
+        {
+            wcscpy(message.data(), L"(comment too long to log)");
+            break;
+        }
+        message.resize(message.size() * 2);
+    }
+
+    Logger::WriteMessage(message.data());
+}
+
+// A filter is a test class name, or a class and method name separated by a dot
+static bool MatchesFilter(test_case_info const& testCase, std::string const& filter)
+{
+    std::string className{ testCase.className };
+    return filter == className || filter == className + "." + testCase.methodName;
+}
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
+
+using namespace xbox::httpclienttest;
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> filters{ argv + 1, argv + argc };
+
+    uint32_t passed = 0;
+    std::vector<std::string> failed;
+    for (auto const& testCase : RegisteredTestCases())
+    {
+        if (!filters.empty() && std::none_of(filters.begin(), filters.end(), [&](std::string const& filter) { return MatchesFilter(testCase, filter); }))
+        {
+            continue;
+        }
+
+        std::string name = std::string{ testCase.className } + "." + testCase.methodName;
+        printf("[ RUN      ] %s\n", name.c_str());
+        fflush(stdout);
+        try
+        {
+            testCase.run();
+            printf("[       OK ] %s\n", name.c_str());
+            ++passed;
+        }
+        catch (std::exception const& e)
+        {
+            printf("%s\n[  FAILED  ] %s\n", e.what(), name.c_str());
+            failed.push_back(name);
+        }
+        fflush(stdout);
+    }
+
+    printf("%u passed, %zu failed\n", passed, failed.size());
+    for (auto const& name : failed)
+    {
+        printf("  FAILED: %s\n", name.c_str());
+    }
+    if (passed == 0 && failed.empty())
+    {
+        printf("No test matched\n");
+        return 1;
+    }
+    return failed.empty() ? 0 : 1;
+}
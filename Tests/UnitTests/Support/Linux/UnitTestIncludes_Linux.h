@@ -0,0 +1,234 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+// A minimal stand-in for the subset of the Visual Studio C++ unit test framework the tests use, so the same test
+// sources build into a console runner on Linux. A failed VERIFY throws, which fails the test case it's in.
+
+#include <cstring>
+#include <cwchar>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#define TEST_CLASS_AREA L"libHttpClient"
+
+// Win32 string types the shared tests use
+typedef char CHAR;
+typedef const char* PCSTR;
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
+
+struct test_case_info
+{
+    const char* className;
+    const char* methodName;
+    void (*run)();
+};
+
+std::vector<test_case_info>& RegisteredTestCases();
+
+struct test_case_registration
+{
+    test_case_registration(const char* className, const char* methodName, void (*run)())
+    {
+        RegisteredTestCases().push_back({ className, methodName, run });
+    }
+};
+
+// Instantiated for each test method, the first time the method's body refers to it
+template<typename TestClass, typename TestMethod>
+struct test_case_registrar
+{
+    static test_case_registration registration;
+};
+
+template<typename TestClass, typename TestMethod>
+test_case_registration test_case_registrar<TestClass, TestMethod>::registration{
+    TestClass::TestClassName(), TestMethod::Name(), &TestMethod::template Run<TestClass>
+};
+
+template<typename TestClass, typename TestClassNameTag>
+class test_class_base
+{
+public:
+    typedef TestClass test_class_type;
+    static const char* TestClassName() { return TestClassNameTag::Get(); }
+};
+
+class test_failure : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+template<typename T, typename = void>
+struct is_streamable : std::false_type {};
+
+template<typename T>
+struct is_streamable<T, decltype(void(std::declval<std::ostream&>() << std::declval<T const&>()))> : std::true_type {};
+
+template<typename T>
+typename std::enable_if<std::is_enum<T>::value, std::string>::type FormatValue(T const& value)
+{
+    return std::to_string(static_cast<int64_t>(value));
+}
+
+template<typename T>
+typename std::enable_if<!std::is_enum<T>::value && is_streamable<T>::value, std::string>::type FormatValue(T const& value)
+{
+    std::ostringstream stream;
+    stream << value;
+    return stream.str();
+}
+
+template<typename T>
+typename std::enable_if<!std::is_enum<T>::value && !is_streamable<T>::value, std::string>::type FormatValue(T const&)
+{
+    return "<value>";
+}
+
+[[noreturn]] void FailTest(std::string const& message, const char* file, int line);
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#endif
+template<typename E, typename A>
+void VerifyAreEqual(E const& expected, A const& actual, const char* expression, const char* file, int line)
+{
+    if (!(expected == actual))
+    {
+        FailTest(std::string{ "VERIFY_ARE_EQUAL(" } + expression + "): expected " + FormatValue(expected) + ", actual " + FormatValue(actual), file, line);
+    }
+}
+
+template<typename E, typename A>
+void VerifyAreNotEqual(E const& expected, A const& actual, const char* expression, const char* file, int line)
+{
+    if (expected == actual)
+    {
+        FailTest(std::string{ "VERIFY_ARE_NOT_EQUAL(" } + expression + "): both are " + FormatValue(actual), file, line);
+    }
+}
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+inline void VerifyAreEqualStr(const char* expected, const char* actual, const char* expression, const char* file, int line)
+{
+    if (expected == nullptr || actual == nullptr ? expected != actual : strcmp(expected, actual) != 0)
+    {
+        FailTest(std::string{ "VERIFY_ARE_EQUAL_STR(" } + expression + "): expected \"" + (expected ? expected : "(null)") +
+            "\", actual \"" + (actual ? actual : "(null)") + "\"", file, line);
+    }
+}
+
+inline void VerifyAreEqualStr(std::string const& expected, std::string const& actual, const char* expression, const char* file, int line)
+{
+    VerifyAreEqualStr(expected.c_str(), actual.c_str(), expression, file, line);
+}
+
+inline void VerifyAreEqualStr(const wchar_t* expected, const wchar_t* actual, const char* expression, const char* file, int line)
+{
+    if (expected == nullptr || actual == nullptr ? expected != actual : wcscmp(expected, actual) != 0)
+    {
+        FailTest(std::string{ "VERIFY_ARE_EQUAL_STR(" } + expression + ")", file, line);
+    }
+}
+
+inline void VerifyIsTrue(bool condition, const char* macro, const char* expression, const char* file, int line)
+{
+    if (!condition)
+    {
+        FailTest(std::string{ macro } + "(" + expression + ")", file, line);
+    }
+}
+
+class Logger
+{
+public:
+    static void WriteMessage(const char* message);
+    static void WriteMessage(const wchar_t* message);
+};
+
+// Formats a comment printf style, with the format string and %ws arguments wide as on Windows, and writes it out
+void LogComment(const wchar_t* format, ...);
+
+class Assert
+{
+public:
+    template<typename E, typename A>
+    static void AreNotEqual(E const& expected, A const& actual)
+    {
+        VerifyAreNotEqual(expected, actual, "", __FILE__, __LINE__);
+    }
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
+
+using xbox::httpclienttest::Assert;
+using xbox::httpclienttest::Logger;
+
+#define TEST_CLASS(className) \
+    struct className##_TestClassName { static const char* Get() { return #className; } }; \
+    class className : public ::xbox::httpclienttest::test_class_base<className, className##_TestClassName>
+
+#define TEST_METHOD(methodName) \
+    struct methodName##_TestMethod \
+    { \
+        static const char* Name() { return #methodName; } \
+        template<typename TestClass> static void Run() { TestClass test; test.methodName(); } \
+    }; \
+    static void methodName##_Register() \
+    { \
+        (void)&::xbox::httpclienttest::test_case_registrar<test_class_type, methodName##_TestMethod>::registration; \
+    } \
+    void methodName()
+
+#define DEFINE_TEST_CASE(TestCaseMethodName) TEST_METHOD(TestCaseMethodName)
+#define DEFINE_TEST_CASE_PROPERTIES_TE() ;
+
+#define VERIFY_SUCCEEDED(x) \
+    ::xbox::httpclienttest::VerifyAreEqual(S_OK, static_cast<HRESULT>(x), #x, __FILE__, __LINE__)
+
+#define VERIFY_FAIL() \
+    ::xbox::httpclienttest::FailTest("VERIFY_FAIL()", __FILE__, __LINE__)
+
+#define VERIFY_ARE_EQUAL_UINT(expected, actual) \
+    ::xbox::httpclienttest::VerifyAreEqual(static_cast<uint64_t>(expected), static_cast<uint64_t>(actual), #expected ", " #actual, __FILE__, __LINE__)
+
+#define VERIFY_ARE_EQUAL_INT(expected, actual) \
+    ::xbox::httpclienttest::VerifyAreEqual(static_cast<int64_t>(expected), static_cast<int64_t>(actual), #expected ", " #actual, __FILE__, __LINE__)
+
+#define VERIFY_ARE_EQUAL(expected, actual) \
+    ::xbox::httpclienttest::VerifyAreEqual((expected), (actual), #expected ", " #actual, __FILE__, __LINE__)
+
+#define VERIFY_ARE_EQUAL_STR(expected, actual) \
+    ::xbox::httpclienttest::VerifyAreEqualStr((expected), (actual), #expected ", " #actual, __FILE__, __LINE__)
+
+#define VERIFY_IS_TRUE(x) \
+    ::xbox::httpclienttest::VerifyIsTrue(static_cast<bool>(x), "VERIFY_IS_TRUE", #x, __FILE__, __LINE__)
+
+#define VERIFY_IS_FALSE(x) \
+    ::xbox::httpclienttest::VerifyIsTrue(!(x), "VERIFY_IS_FALSE", #x, __FILE__, __LINE__)
+
+#define VERIFY_IS_NULL(x) \
+    ::xbox::httpclienttest::VerifyIsTrue((x) == nullptr, "VERIFY_IS_NULL", #x, __FILE__, __LINE__)
+
+#define VERIFY_IS_NOT_NULL(x) \
+    ::xbox::httpclienttest::VerifyIsTrue((x) != nullptr, "VERIFY_IS_NOT_NULL", #x, __FILE__, __LINE__)
+
+#define VERIFY_IS_LESS_THAN(expectedLess, expectedGreater) \
+    ::xbox::httpclienttest::VerifyIsTrue((expectedLess) < (expectedGreater), "VERIFY_IS_LESS_THAN", #expectedLess ", " #expectedGreater, __FILE__, __LINE__)
+
+#define VERIFY_IS_GREATER_THAN(expectedGreater, expectedLess) \
+    ::xbox::httpclienttest::VerifyIsTrue((expectedGreater) > (expectedLess), "VERIFY_IS_GREATER_THAN", #expectedGreater ", " #expectedLess, __FILE__, __LINE__)
+
+#define VERIFY_IS_GREATER_THAN_OR_EQUAL(expectedGreater, expectedLess) \
+    ::xbox::httpclienttest::VerifyIsTrue((expectedGreater) >= (expectedLess), "VERIFY_IS_GREATER_THAN_OR_EQUAL", #expectedGreater ", " #expectedLess, __FILE__, __LINE__)
+
+#define LOG_COMMENT(x, ...) ::xbox::httpclienttest::LogComment(x, ##__VA_ARGS__)
@@ -4,6 +4,9 @@
 #pragma once
 #ifdef USING_TAEF
 #include "TAEF/UnitTestIncludes_TAEF.h"
+#elif defined(UNITTEST_LINUX)
+#include "Linux/UnitTestIncludes_Linux.h"
+#include "DefineTestMacros.h"
 #else
 #include "TE/UnitTestIncludes_TE.h"
 #include "DefineTestMacros.h"
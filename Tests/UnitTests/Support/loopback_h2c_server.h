@@ -0,0 +1,371 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal cleartext HTTP/2 server on 127.0.0.1 for clients that upgrade from HTTP/1.1 or use prior knowledge. It
+// doesn't decode request header blocks: every stream gets a 200 response with an x-stream-id header and the request
+// body echoed back, unless the server is told to hold responses. Frames the tests care about (streams, priorities,
+// resets) are recorded.
+class loopback_h2c_server
+{
+public:
+    struct stream_info
+    {
+        uint32_t connection{ 0 };
+        uint32_t streamId{ 0 };
+        uint32_t weight{ 16 }; // as sent, 1-256
+        bool reset{ false };
+    };
+
+    explicit loopback_h2c_server(bool holdResponses = false) :
+        m_holdResponses{ holdResponses }
+    {
+        m_listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(m_listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        listen(m_listenSocket, SOMAXCONN);
+
+        socklen_t length = sizeof(address);
+        getsockname(m_listenSocket, reinterpret_cast<sockaddr*>(&address), &length);
+        m_port = ntohs(address.sin_port);
+
+        m_acceptThread = std::thread([this] { AcceptConnections(); });
+    }
+
+    ~loopback_h2c_server()
+    {
+        shutdown(m_listenSocket, SHUT_RDWR);
+        close(m_listenSocket);
+        m_acceptThread.join();
+
+        std::vector<std::thread> connectionThreads;
+        {
+            std::lock_guard<std::mutex> lock{ m_lock };
+            for (int s : m_connectionSockets)
+            {
+                shutdown(s, SHUT_RDWR);
+            }
+            connectionThreads.swap(m_connectionThreads);
+        }
+        for (auto& thread : connectionThreads)
+        {
+            thread.join();
+        }
+    }
+
+    std::string Url(std::string const& path) const
+    {
+        return "http://127.0.0.1:" + std::to_string(m_port) + path;
+    }
+
+    uint32_t ConnectionCount() const { return m_connectionCount; }
+
+    std::vector<stream_info> Streams()
+    {
+        std::lock_guard<std::mutex> lock{ m_lock };
+        return m_streams;
+    }
+
+private:
+    enum frame_type : uint8_t
+    {
+        DATA = 0x0,
+        HEADERS = 0x1,
+        PRIORITY = 0x2,
+        RST_STREAM = 0x3,
+        SETTINGS = 0x4,
+        PING = 0x6,
+        GOAWAY = 0x7,
+        WINDOW_UPDATE = 0x8,
+        CONTINUATION = 0x9
+    };
+
+    static constexpr uint8_t END_STREAM = 0x1;
+    static constexpr uint8_t ACK = 0x1;
+    static constexpr uint8_t END_HEADERS = 0x4;
+    static constexpr uint8_t PADDED = 0x8;
+    static constexpr uint8_t PRIORITY_FLAG = 0x20;
+
+    void AcceptConnections()
+    {
+        while (true)
+        {
+            int s = accept(m_listenSocket, nullptr, nullptr);
+            if (s < 0)
+            {
+                return;
+            }
+
+            int noDelay = 1;
+            setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+            std::lock_guard<std::mutex> lock{ m_lock };
+            uint32_t connection = ++m_connectionCount;
+            m_connectionSockets.push_back(s);
+            m_connectionThreads.emplace_back([this, s, connection] { ServeConnection(s, connection); });
+        }
+    }
+
+    static bool ReadExactly(int s, uint8_t* data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t result = recv(s, data, size, 0);
+            if (result <= 0)
+            {
+                return false;
+            }
+            data += result;
+            size -= static_cast<size_t>(result);
+        }
+        return true;
+    }
+
+    static bool SendFrame(int s, uint8_t type, uint8_t flags, uint32_t streamId, std::string const& payload)
+    {
+        std::string frame;
+        frame += static_cast<char>((payload.size() >> 16) & 0xFF);
+        frame += static_cast<char>((payload.size() >> 8) & 0xFF);
+        frame += static_cast<char>(payload.size() & 0xFF);
+        frame += static_cast<char>(type);
+        frame += static_cast<char>(flags);
+        frame += static_cast<char>((streamId >> 24) & 0x7F);
+        frame += static_cast<char>((streamId >> 16) & 0xFF);
+        frame += static_cast<char>((streamId >> 8) & 0xFF);
+        frame += static_cast<char>(streamId & 0xFF);
+        frame += payload;
+        return send(s, frame.data(), frame.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(frame.size());
+    }
+
+    // HPACK literal header field without indexing, new name, no Huffman coding
+    static void AppendLiteralHeader(std::string& block, std::string const& name, std::string const& value)
+    {
+        block += '\0';
+        block += static_cast<char>(name.size());
+        block += name;
+        block += static_cast<char>(value.size());
+        block += value;
+    }
+
+    static bool Respond(int s, uint32_t streamId, std::string const& body)
+    {
+        std::string headers;
+        headers += static_cast<char>(0x88); // :status 200 from the static table
+        AppendLiteralHeader(headers, "x-stream-id", std::to_string(streamId));
+        AppendLiteralHeader(headers, "content-length", std::to_string(body.size()));
+        if (body.empty())
+        {
+            return SendFrame(s, HEADERS, END_HEADERS | END_STREAM, streamId, headers);
+        }
+        if (!SendFrame(s, HEADERS, END_HEADERS, streamId, headers))
+        {
+            return false;
+        }
+
+        // Bodies are small enough to fit the client's initial flow control window, but not one frame
+        constexpr size_t maxFrameSize = 16384;
+        for (size_t offset = 0; offset < body.size(); offset += maxFrameSize)
+        {
+            bool last = offset + maxFrameSize >= body.size();
+            if (!SendFrame(s, DATA, last ? END_STREAM : 0, streamId, body.substr(offset, maxFrameSize)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void RecordStream(uint32_t connection, uint32_t streamId, uint32_t weight)
+    {
+        stream_info stream;
+        stream.connection = connection;
+        stream.streamId = streamId;
+        stream.weight = weight;
+        std::lock_guard<std::mutex> lock{ m_lock };
+        m_streams.push_back(stream);
+    }
+
+    // Reads the HTTP/1.1 request carrying "Upgrade: h2c", or the start of the connection preface, up to its blank line
+    static bool ReadHead(int s, std::string& head)
+    {
+        char c = 0;
+        while (head.size() < 4 || head.compare(head.size() - 4, 4, "\r\n\r\n") != 0)
+        {
+            if (head.size() > 65536 || recv(s, &c, 1, 0) != 1)
+            {
+                return false;
+            }
+            head += c;
+        }
+        return true;
+    }
+
+    // Answers an upgrade request: its response goes out on stream 1 once the connection has switched to HTTP/2
+    bool Upgrade(int s, uint32_t connection, std::string const& head)
+    {
+        std::string lowerHead = head;
+        std::transform(lowerHead.begin(), lowerHead.end(), lowerHead.begin(), [](char c) { return static_cast<char>(::tolower(c)); });
+        size_t contentLength = 0;
+        size_t position = lowerHead.find("\r\ncontent-length:");
+        if (position != std::string::npos)
+        {
+            contentLength = std::stoul(lowerHead.substr(position + 17));
+        }
+        std::string body(contentLength, '\0');
+        if (contentLength > 0 && !ReadExactly(s, reinterpret_cast<uint8_t*>(&body[0]), contentLength))
+        {
+            return false;
+        }
+
+        static const char switching[] = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+        if (send(s, switching, sizeof(switching) - 1, MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(switching) - 1) ||
+            !SendFrame(s, SETTINGS, 0, 0, ""))
+        {
+            return false;
+        }
+        RecordStream(connection, 1, 16);
+        return m_holdResponses || Respond(s, 1, body);
+    }
+
+    void ServeConnection(int s, uint32_t connection)
+    {
+        static const char preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+        static const size_t prefaceHeadSize = 18; // up to the blank line
+        uint8_t prefaceBuffer[sizeof(preface) - 1 - prefaceHeadSize];
+        std::map<uint32_t, std::string> bodies;
+
+        // An upgraded connection gets the client's preface after the 101 response
+        std::string head;
+        bool started = ReadHead(s, head);
+        if (started && head.compare(0, std::string::npos, preface, prefaceHeadSize) != 0)
+        {
+            started = Upgrade(s, connection, head);
+            head.clear();
+            started = started && ReadHead(s, head);
+        }
+        else if (started)
+        {
+            started = SendFrame(s, SETTINGS, 0, 0, "");
+        }
+
+        if (started &&
+            head.compare(0, std::string::npos, preface, prefaceHeadSize) == 0 &&
+            ReadExactly(s, prefaceBuffer, sizeof(prefaceBuffer)) &&
+            std::equal(prefaceBuffer, prefaceBuffer + sizeof(prefaceBuffer), preface + prefaceHeadSize))
+        {
+            while (true)
+            {
+                uint8_t header[9];
+                if (!ReadExactly(s, header, sizeof(header)))
+                {
+                    break;
+                }
+                size_t length = (static_cast<size_t>(header[0]) << 16) | (static_cast<size_t>(header[1]) << 8) | header[2];
+                uint8_t type = header[3];
+                uint8_t flags = header[4];
+                uint32_t streamId = ((static_cast<uint32_t>(header[5]) & 0x7F) << 24) | (static_cast<uint32_t>(header[6]) << 16) | (static_cast<uint32_t>(header[7]) << 8) | header[8];
+                std::string payload(length, '\0');
+                if (length > 0 && !ReadExactly(s, reinterpret_cast<uint8_t*>(&payload[0]), length))
+                {
+                    break;
+                }
+
+                bool ok = true;
+                if (type == SETTINGS && (flags & ACK) == 0)
+                {
+                    ok = SendFrame(s, SETTINGS, ACK, 0, "");
+                }
+                else if (type == PING && (flags & ACK) == 0)
+                {
+                    ok = SendFrame(s, PING, ACK, 0, payload);
+                }
+                else if (type == HEADERS)
+                {
+                    uint32_t weight = 16;
+                    size_t offset = (flags & PADDED) ? 1 : 0;
+                    if ((flags & PRIORITY_FLAG) && payload.size() >= offset + 5)
+                    {
+                        weight = static_cast<uint8_t>(payload[offset + 4]) + 1u;
+                    }
+                    RecordStream(connection, streamId, weight);
+                    bodies[streamId];
+                    if (flags & END_STREAM)
+                    {
+                        ok = m_holdResponses || Respond(s, streamId, "");
+                    }
+                }
+                else if (type == DATA)
+                {
+                    // Give the flow control window straight back so uploads never stall
+                    if (length > 0)
+                    {
+                        std::string increment{ static_cast<char>((length >> 24) & 0x7F), static_cast<char>((length >> 16) & 0xFF), static_cast<char>((length >> 8) & 0xFF), static_cast<char>(length & 0xFF) };
+                        ok = SendFrame(s, WINDOW_UPDATE, 0, 0, increment) && SendFrame(s, WINDOW_UPDATE, 0, streamId, increment);
+                    }
+                    size_t padding = (flags & PADDED) && !payload.empty() ? static_cast<uint8_t>(payload[0]) : 0;
+                    size_t offset = (flags & PADDED) ? 1 : 0;
+                    bodies[streamId].append(payload, offset, payload.size() - offset - padding);
+                    if (ok && (flags & END_STREAM))
+                    {
+                        ok = m_holdResponses || Respond(s, streamId, bodies[streamId]);
+                    }
+                }
+                else if (type == RST_STREAM)
+                {
+                    std::lock_guard<std::mutex> lock{ m_lock };
+                    for (auto& stream : m_streams)
+                    {
+                        if (stream.connection == connection && stream.streamId == streamId)
+                        {
+                            stream.reset = true;
+                        }
+                    }
+                }
+                else if (type == GOAWAY)
+                {
+                    break;
+                }
+
+                if (!ok)
+                {
+                    break;
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock{ m_lock };
+        m_connectionSockets.erase(std::find(m_connectionSockets.begin(), m_connectionSockets.end(), s));
+        close(s);
+    }
+
+    bool m_holdResponses;
+    int m_listenSocket{ -1 };
+    uint16_t m_port{ 0 };
+    std::thread m_acceptThread;
+    std::atomic<uint32_t> m_connectionCount{ 0 };
+
+    std::mutex m_lock;
+    std::vector<int> m_connectionSockets;
+    std::vector<std::thread> m_connectionThreads;
+    std::vector<stream_info> m_streams;
+};
@@ -0,0 +1,287 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal HTTP/1.1 server on 127.0.0.1 for exercising real network providers. Each connection is served by its own
+// thread and kept alive until the client closes it. Bodies may be sent with Content-Length or chunked encoding.
+class loopback_http_server
+{
+public:
+    struct request
+    {
+        std::string method;
+        std::string path;
+        std::map<std::string, std::string> headers; // names are lower case
+        std::string body;
+    };
+
+    struct response
+    {
+        uint32_t statusCode{ 200 };
+        std::vector<std::pair<std::string, std::string>> headers;
+        std::string body;
+        std::chrono::milliseconds delay{ 0 }; // stalls before responding; cut short when the server stops
+        bool closeConnection{ false }; // closes the connection after responding, without saying so in a header
+    };
+
+    using handler = std::function<response(request const&)>;
+
+    explicit loopback_http_server(handler requestHandler) :
+        m_handler{ std::move(requestHandler) }
+    {
+        m_listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(m_listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        listen(m_listenSocket, SOMAXCONN);
+
+        socklen_t length = sizeof(address);
+        getsockname(m_listenSocket, reinterpret_cast<sockaddr*>(&address), &length);
+        m_port = ntohs(address.sin_port);
+
+        m_acceptThread = std::thread([this] { AcceptConnections(); });
+    }
+
+    ~loopback_http_server()
+    {
+        {
+            std::lock_guard<std::mutex> lock{ m_lock };
+            m_stopping = true;
+        }
+        m_stopped.notify_all();
+        shutdown(m_listenSocket, SHUT_RDWR);
+        close(m_listenSocket);
+        m_acceptThread.join();
+
+        std::vector<std::thread> connectionThreads;
+        {
+            std::lock_guard<std::mutex> lock{ m_lock };
+            for (int s : m_connectionSockets)
+            {
+                shutdown(s, SHUT_RDWR);
+            }
+            connectionThreads.swap(m_connectionThreads);
+        }
+        for (auto& thread : connectionThreads)
+        {
+            thread.join();
+        }
+    }
+
+    std::string Url(std::string const& path) const
+    {
+        return "http://127.0.0.1:" + std::to_string(m_port) + path;
+    }
+
+    uint32_t ConnectionCount() const { return m_connectionCount; }
+    uint32_t RequestCount() const { return m_requestCount; }
+
+private:
+    void AcceptConnections()
+    {
+        while (true)
+        {
+            int s = accept(m_listenSocket, nullptr, nullptr);
+            if (s < 0)
+            {
+                return;
+            }
+
+            int noDelay = 1;
+            setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+            std::lock_guard<std::mutex> lock{ m_lock };
+            if (m_stopping)
+            {
+                close(s);
+                return;
+            }
+            ++m_connectionCount;
+            m_connectionSockets.push_back(s);
+            m_connectionThreads.emplace_back([this, s] { ServeConnection(s); });
+        }
+    }
+
+    void ServeConnection(int s)
+    {
+        std::string buffer;
+        request r;
+        while (ReadRequest(s, buffer, r))
+        {
+            ++m_requestCount;
+            response rsp = m_handler(r);
+            if (rsp.delay.count() > 0)
+            {
+                std::unique_lock<std::mutex> lock{ m_lock };
+                if (m_stopped.wait_for(lock, rsp.delay, [this] { return m_stopping; }))
+                {
+                    break;
+                }
+            }
+
+            std::string out = "HTTP/1.1 " + std::to_string(rsp.statusCode) + " Status\r\n";
+            for (auto const& header : rsp.headers)
+            {
+                out += header.first + ": " + header.second + "\r\n";
+            }
+            out += "Content-Length: " + std::to_string(rsp.body.size()) + "\r\n\r\n";
+            if (r.method != "HEAD")
+            {
+                out += rsp.body;
+            }
+            if (!SendAll(s, out) || rsp.closeConnection)
+            {
+                break;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock{ m_lock };
+        m_connectionSockets.erase(std::find(m_connectionSockets.begin(), m_connectionSockets.end(), s));
+        close(s);
+    }
+
+    static bool SendAll(int s, std::string const& data)
+    {
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t result = send(s, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (result <= 0)
+            {
+                return false;
+            }
+            sent += static_cast<size_t>(result);
+        }
+        return true;
+    }
+
+    static bool ReadMore(int s, std::string& buffer)
+    {
+        char chunk[16384];
+        ssize_t result = recv(s, chunk, sizeof(chunk), 0);
+        if (result <= 0)
+        {
+            return false;
+        }
+        buffer.append(chunk, static_cast<size_t>(result));
+        return true;
+    }
+
+    // Reads up to and including the next CRLF
+    static bool ReadLine(int s, std::string& buffer, std::string& line)
+    {
+        size_t end;
+        while ((end = buffer.find("\r\n")) == std::string::npos)
+        {
+            if (!ReadMore(s, buffer))
+            {
+                return false;
+            }
+        }
+        line = buffer.substr(0, end);
+        buffer.erase(0, end + 2);
+        return true;
+    }
+
+    static bool ReadBytes(int s, std::string& buffer, size_t count, std::string& out)
+    {
+        while (buffer.size() < count)
+        {
+            if (!ReadMore(s, buffer))
+            {
+                return false;
+            }
+        }
+        out.append(buffer, 0, count);
+        buffer.erase(0, count);
+        return true;
+    }
+
+    static bool ReadRequest(int s, std::string& buffer, request& r)
+    {
+        r = request{};
+        std::string line;
+        if (!ReadLine(s, buffer, line))
+        {
+            return false;
+        }
+        size_t methodEnd = line.find(' ');
+        size_t pathEnd = line.find(' ', methodEnd + 1);
+        r.method = line.substr(0, methodEnd);
+        r.path = line.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+
+        while (ReadLine(s, buffer, line) && !line.empty())
+        {
+            size_t colon = line.find(':');
+            std::string name = line.substr(0, colon);
+            for (auto& c : name)
+            {
+                c = static_cast<char>(tolower(c));
+            }
+            size_t valueBegin = line.find_first_not_of(' ', colon + 1);
+            r.headers[name] = valueBegin == std::string::npos ? std::string{} : line.substr(valueBegin);
+        }
+
+        auto transferEncoding = r.headers.find("transfer-encoding");
+        if (transferEncoding != r.headers.end() && transferEncoding->second == "chunked")
+        {
+            while (true)
+            {
+                if (!ReadLine(s, buffer, line))
+                {
+                    return false;
+                }
+                size_t chunkSize = std::stoul(line, nullptr, 16);
+                if (chunkSize == 0)
+                {
+                    return ReadLine(s, buffer, line);
+                }
+                if (!ReadBytes(s, buffer, chunkSize, r.body) || !ReadLine(s, buffer, line))
+                {
+                    return false;
+                }
+            }
+        }
+
+        auto contentLength = r.headers.find("content-length");
+        if (contentLength != r.headers.end())
+        {
+            return ReadBytes(s, buffer, std::stoul(contentLength->second), r.body);
+        }
+        return true;
+    }
+
+    handler m_handler;
+    int m_listenSocket{ -1 };
+    uint16_t m_port{ 0 };
+    std::thread m_acceptThread;
+    std::atomic<uint32_t> m_connectionCount{ 0 };
+    std::atomic<uint32_t> m_requestCount{ 0 };
+
+    std::mutex m_lock;
+    std::condition_variable m_stopped;
+    bool m_stopping{ false };
+    std::vector<int> m_connectionSockets;
+    std::vector<std::thread> m_connectionThreads;
+};
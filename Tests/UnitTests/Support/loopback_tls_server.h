@@ -0,0 +1,136 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+// Minimal TLS server on 127.0.0.1 for exercising session resumption. It presents a self-signed certificate made at
+// startup, so clients must not verify the peer. Connections are served one at a time: each reads a line and answers
+// it with "ok\n". Resumed and full handshakes are counted on the server side too.
+class loopback_tls_server
+{
+public:
+    enum class resumption
+    {
+        tickets,   // TLS 1.3 with session tickets
+        sessionIds // TLS 1.2 without tickets, so the server's session cache is looked up by ID
+    };
+
+    explicit loopback_tls_server(resumption mode = resumption::tickets)
+    {
+        m_context = SSL_CTX_new(TLS_server_method());
+        EVP_PKEY* key = EVP_EC_gen("P-256");
+        X509* certificate = X509_new();
+        ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+        X509_gmtime_adj(X509_getm_notBefore(certificate), 0);
+        X509_gmtime_adj(X509_getm_notAfter(certificate), 60 * 60);
+        X509_set_pubkey(certificate, key);
+        X509_NAME* name = X509_get_subject_name(certificate);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+        X509_set_issuer_name(certificate, name);
+        X509_sign(certificate, key, EVP_sha256());
+        SSL_CTX_use_certificate(m_context, certificate);
+        SSL_CTX_use_PrivateKey(m_context, key);
+        X509_free(certificate);
+        EVP_PKEY_free(key);
+
+        static const unsigned char sessionIdContext[] = "loopback_tls_server";
+        SSL_CTX_set_session_id_context(m_context, sessionIdContext, sizeof(sessionIdContext) - 1);
+        SSL_CTX_set_session_cache_mode(m_context, SSL_SESS_CACHE_SERVER);
+        if (mode == resumption::sessionIds)
+        {
+            SSL_CTX_set_max_proto_version(m_context, TLS1_2_VERSION);
+            SSL_CTX_set_options(m_context, SSL_OP_NO_TICKET);
+        }
+        else
+        {
+            SSL_CTX_set_min_proto_version(m_context, TLS1_3_VERSION);
+        }
+
+        m_listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(m_listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        listen(m_listenSocket, SOMAXCONN);
+
+        socklen_t length = sizeof(address);
+        getsockname(m_listenSocket, reinterpret_cast<sockaddr*>(&address), &length);
+        m_port = ntohs(address.sin_port);
+
+        m_acceptThread = std::thread([this] { AcceptConnections(); });
+    }
+
+    ~loopback_tls_server()
+    {
+        shutdown(m_listenSocket, SHUT_RDWR);
+        close(m_listenSocket);
+        m_acceptThread.join();
+        SSL_CTX_free(m_context);
+    }
+
+    uint16_t Port() const { return m_port; }
+    uint32_t ResumedHandshakes() const { return m_resumedHandshakes; }
+    uint32_t FullHandshakes() const { return m_fullHandshakes; }
+
+private:
+    void AcceptConnections()
+    {
+        // Clients like tls_session_cache::Warm hang up without sending a line, so the answer can hit a closed socket.
+        // The SIGPIPE that raises stays pending on this thread rather than ending the test run.
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+        for (;;)
+        {
+            int s = accept(m_listenSocket, nullptr, nullptr);
+            if (s < 0)
+            {
+                return;
+            }
+
+            SSL* connection = SSL_new(m_context);
+            SSL_set_fd(connection, s);
+            if (SSL_accept(connection) == 1)
+            {
+                ++(SSL_session_reused(connection) ? m_resumedHandshakes : m_fullHandshakes);
+
+                std::string line;
+                char c = 0;
+                while (SSL_read(connection, &c, 1) == 1 && c != '\n')
+                {
+                    line += c;
+                }
+                SSL_write(connection, "ok\n", 3);
+                SSL_shutdown(connection);
+            }
+            SSL_free(connection);
+            close(s);
+        }
+    }
+
+    SSL_CTX* m_context{ nullptr };
+    int m_listenSocket{ -1 };
+    uint16_t m_port{ 0 };
+    std::thread m_acceptThread;
+    std::atomic<uint32_t> m_resumedHandshakes{ 0 };
+    std::atomic<uint32_t> m_fullHandshakes{ 0 };
+};
@@ -0,0 +1,191 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "UnitTestIncludes.h"
+#define TEST_CLASS_OWNER L"jasonsa"
+#include "DefineTestMacros.h"
+#include "utils.h"
+#include "../HTTP/httpcall.h"
+
+using namespace xbox::httpclient;
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
+
+static std::atomic<uint32_t> g_arenaTestAllocations{ 0 };
+
+static _Ret_maybenull_ _Post_writable_byte_size_(size) void* STDAPIVCALLTYPE CountingMemAlloc(
+    _In_ size_t size,
+    _In_ HCMemoryType /*memoryType*/
+    )
+{
+    ++g_arenaTestAllocations;
+    return malloc(size);
+}
+
+static void STDAPIVCALLTYPE CountingMemFree(
+    _In_ _Post_invalid_ void* pointer,
+    _In_ HCMemoryType /*memoryType*/
+    )
+{
+    free(pointer);
+}
+
+static void CALLBACK ArenaPerformCallback(
+    _In_ HCCallHandle call,
+    _Inout_ XAsyncBlock* asyncBlock,
+    _In_opt_ void* /*ctx*/,
+    _In_opt_ HCPerformEnv /*env*/
+    )
+{
+    HCHttpCallResponseSetStatusCode(call, 200);
+    HCHttpCallResponseSetHeader(call, "Content-Type", "application/json; charset=utf-8");
+    HCHttpCallResponseSetHeader(call, "Cache-Control", "no-store, no-cache, must-revalidate");
+    HCHttpCallResponseSetHeader(call, "X-Request-Id", "0f1e2d3c-4b5a-6978-8796-a5b4c3d2e1f0");
+    HCHttpCallResponseSetHeader(call, "Date", "Fri, 16 Oct 2026 12:00:00 GMT");
+    HCHttpCallResponseSetPlatformNetworkErrorMessage(call, "no error reported by the platform stack");
+    XAsyncComplete(asyncBlock, S_OK, 0);
+}
+
+// Counts the allocations made by one call with typical metadata, from creating it to closing its handle
+static uint32_t CountCallAllocations()
+{
+    uint32_t before = g_arenaTestAllocations;
+
+    HCCallHandle call = nullptr;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "POST", "https://title.example.com/users/xuid(2814000000000000)/profile/settings"));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(call, "Authorization", "XBL3.0 x=1234567890;eyJhbGciOiJSUzI1NiIsInR5cCI6IkpXVCJ9", false));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(call, "Content-Type", "application/json; charset=utf-8", true));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(call, "x-xbl-contract-version", "2", true));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(call, "Accept-Language", "en-US, en", true));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyString(call, "{\"settings\":[\"GameDisplayName\",\"Gamerscore\"]}"));
+
+    XAsyncBlock asyncBlock{};
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+    VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+
+    uint32_t statusCode = 0;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetStatusCode(call, &statusCode));
+    VERIFY_ARE_EQUAL(200u, statusCode);
+    const char* value = nullptr;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetHeader(call, "x-request-id", &value));
+    VERIFY_ARE_EQUAL_STR("0f1e2d3c-4b5a-6978-8796-a5b4c3d2e1f0", value);
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetPlatformNetworkErrorMessage(call, &value));
+    VERIFY_ARE_EQUAL_STR("no error reported by the platform stack", value);
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+    return g_arenaTestAllocations - before;
+}
+
+DEFINE_TEST_CLASS(CallArenaTests)
+{
+public:
+    DEFINE_TEST_CLASS_PROPS(CallArenaTests);
+
+    DEFINE_TEST_CASE(VerifyArena)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyArena);
+
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(&CountingMemAlloc, &CountingMemFree));
+        {
+            uint8_t initialBlock[256];
+            http_arena arena{ initialBlock + 1, sizeof(initialBlock) - 1 };
+            uint32_t before = g_arenaTestAllocations;
+
+            // Allocations are aligned and start in the initial block
+            void* a = arena.allocate(10);
+            void* b = arena.allocate(100);
+            VERIFY_ARE_EQUAL(0u, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(a) % http_arena::ALIGNMENT));
+            VERIFY_ARE_EQUAL(0u, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(b) % http_arena::ALIGNMENT));
+            VERIFY_IS_TRUE(a >= initialBlock && b < initialBlock + sizeof(initialBlock));
+            VERIFY_ARE_EQUAL(before, g_arenaTestAllocations.load());
+
+            // Freed allocations are reused by the next one of the same size
+            arena.deallocate(b, 100);
+            VERIFY_IS_TRUE(arena.allocate(98) == b);
+
+            // Then blocks are allocated as they are needed
+            for (int i = 0; i < 100; i++)
+            {
+                VERIFY_IS_NOT_NULL(arena.allocate(64));
+            }
+            VERIFY_ARE_EQUAL(4u, static_cast<uint32_t>(arena.BlockCount()));
+            VERIFY_ARE_EQUAL(before + 4, g_arenaTestAllocations.load());
+
+            // And large allocations are made on the heap
+            void* large = arena.allocate(http_arena::LARGE_ALLOCATION_SIZE);
+            VERIFY_ARE_EQUAL(before + 5, g_arenaTestAllocations.load());
+            arena.deallocate(large, http_arena::LARGE_ALLOCATION_SIZE);
+
+            // Containers in the arena copy what is assigned to them into it, and their copies go to the heap
+            http_arena_allocator<char> allocator{ &arena };
+            http_header_map headers{ allocator };
+            headers[http_arena_string{ "X-Arena-Header-Name", allocator }] = "a value long enough to be allocated";
+            VERIFY_IS_TRUE(headers.begin()->first.get_allocator() == allocator);
+            VERIFY_IS_TRUE(headers.begin()->second.get_allocator() == allocator);
+            VERIFY_ARE_EQUAL(before + 5, g_arenaTestAllocations.load());
+
+            http_header_map copy{ headers };
+            VERIFY_IS_TRUE(copy.begin()->second.get_allocator() == http_arena_allocator<char>{});
+            VERIFY_ARE_EQUAL_STR("a value long enough to be allocated", copy.begin()->second.c_str());
+        }
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(nullptr, nullptr));
+    }
+
+    DEFINE_TEST_CASE(VerifyCallArena)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyCallArena);
+
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&ArenaPerformCallback, nullptr));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "https://example.com/a/path/long/enough/to/be/allocated"));
+        XAsyncBlock asyncBlock{};
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+        VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+#if HC_CALL_ARENA
+        VERIFY_IS_NOT_NULL(call->arena);
+#else
+        VERIFY_IS_NULL(call->arena);
+#endif
+        VERIFY_IS_TRUE(call->url.get_allocator().arena() == call->arena);
+        VERIFY_IS_TRUE(call->responseHeaders.get().begin()->second.get_allocator().arena() == call->arena);
+
+        // Response headers handed to other owners are moved out of the arena, so they outlive the call
+        auto shared = call->responseHeaders.freeze();
+        VERIFY_IS_TRUE(shared->begin()->second.get_allocator().arena() == nullptr);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        auto it = shared->find("X-Request-Id");
+        VERIFY_IS_TRUE(it != shared->end());
+        VERIFY_ARE_EQUAL_STR("0f1e2d3c-4b5a-6978-8796-a5b4c3d2e1f0", it->second.c_str());
+        shared.reset();
+
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(MeasureCallAllocations)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(MeasureCallAllocations);
+
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(&CountingMemAlloc, &CountingMemFree));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&ArenaPerformCallback, nullptr));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        CountCallAllocations(); // warm up the singleton's lazily created state
+        uint32_t allocations = CountCallAllocations();
+        LOG_COMMENT(L"allocations per call: %u", allocations);
+
+#if HC_CALL_ARENA
+        // The call, one arena block, the request body and what the perform itself needs; 23 without the arena
+        VERIFY_IS_TRUE(allocations <= 8);
+#endif
+
+        HCCleanup();
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(nullptr, nullptr));
+    }
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
@@ -0,0 +1,232 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "UnitTestIncludes.h"
+#define TEST_CLASS_OWNER L"jasonsa"
+#include "DefineTestMacros.h"
+#include "utils.h"
+#include "../HTTP/httpcall.h"
+#include <thread>
+
+using namespace xbox::httpclient;
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
+
+static std::atomic<uint32_t> g_prototypeTestAllocations{ 0 };
+static std::atomic<uint32_t> g_prototypePerformedHeaders{ 0 };
+
+static _Ret_maybenull_ _Post_writable_byte_size_(size) void* STDAPIVCALLTYPE PrototypeMemAlloc(
+    _In_ size_t size,
+    _In_ HCMemoryType /*memoryType*/
+    )
+{
+    ++g_prototypeTestAllocations;
+    return malloc(size);
+}
+
+static void STDAPIVCALLTYPE PrototypeMemFree(
+    _In_ _Post_invalid_ void* pointer,
+    _In_ HCMemoryType /*memoryType*/
+    )
+{
+    free(pointer);
+}
+
+static void CALLBACK PrototypePerformCallback(
+    _In_ HCCallHandle call,
+    _Inout_ XAsyncBlock* asyncBlock,
+    _In_opt_ void* /*ctx*/,
+    _In_opt_ HCPerformEnv /*env*/
+    )
+{
+    uint32_t numHeaders = 0;
+    HCHttpCallRequestGetNumHeaders(call, &numHeaders);
+    g_prototypePerformedHeaders = numHeaders;
+    HCHttpCallResponseSetStatusCode(call, 200);
+    XAsyncComplete(asyncBlock, S_OK, 0);
+}
+
+static HCCallHandle CreatePrototype()
+{
+    HCCallHandle prototype = nullptr;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&prototype));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(prototype, "POST", "https://title.example.com/users/xuid(2814000000000000)/profile/settings"));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(prototype, "Authorization", "XBL3.0 x=1234567890;eyJhbGciOiJSUzI1NiIsInR5cCI6IkpXVCJ9", false));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(prototype, "Content-Type", "application/json; charset=utf-8", true));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(prototype, "x-xbl-contract-version", "2", true));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(prototype, "Accept-Language", "en-US, en", true));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetTimeout(prototype, 45));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(prototype, false));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetPriority(prototype, HCHttpCallPriority::High));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyString(prototype, "{\"settings\":[\"GameDisplayName\"]}"));
+    return prototype;
+}
+
+DEFINE_TEST_CLASS(CallPrototypeTests)
+{
+public:
+    DEFINE_TEST_CLASS_PROPS(CallPrototypeTests);
+
+    DEFINE_TEST_CASE(VerifyCallPrototype)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyCallPrototype);
+
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&PrototypePerformCallback, nullptr));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        HCCallHandle prototype = CreatePrototype();
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCHttpCallCreateFromPrototype(nullptr, &call));
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCHttpCallCreateFromPrototype(prototype, nullptr));
+
+        // The new call is set up like the prototype, apart from its body
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreateFromPrototype(prototype, &call));
+        VERIFY_IS_TRUE(HCHttpCallGetId(call) != HCHttpCallGetId(prototype));
+        const char* method = nullptr;
+        const char* url = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetUrl(call, &method, &url));
+        VERIFY_ARE_EQUAL_STR("POST", method);
+        VERIFY_ARE_EQUAL_STR("https://title.example.com/users/xuid(2814000000000000)/profile/settings", url);
+        uint32_t timeout = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetTimeout(call, &timeout));
+        VERIFY_ARE_EQUAL(45u, timeout);
+        bool retryAllowed = true;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetRetryAllowed(call, &retryAllowed));
+        VERIFY_IS_FALSE(retryAllowed);
+        HCHttpCallPriority priority = HCHttpCallPriority::Normal;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetPriority(call, &priority));
+        VERIFY_IS_TRUE(priority == HCHttpCallPriority::High);
+        const uint8_t* body = nullptr;
+        uint32_t bodySize = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetRequestBodyBytes(call, &body, &bodySize));
+        VERIFY_ARE_EQUAL(0u, bodySize);
+
+        // Both calls share one copy of the headers
+        const char* value = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetHeader(call, "content-type", &value));
+        VERIFY_ARE_EQUAL_STR("application/json; charset=utf-8", value);
+        VERIFY_IS_TRUE(prototype->requestHeaders.is_shared());
+        VERIFY_IS_TRUE(&call->requestHeaders.get() == &prototype->requestHeaders.get());
+
+        // Setting a header on the new call copies them for it only
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(call, "If-Match", "\"3\"", true));
+        VERIFY_IS_FALSE(call->requestHeaders.is_shared());
+        VERIFY_IS_TRUE(call->requestHeaders.get().begin()->second.get_allocator().arena() == call->arena);
+        uint32_t numHeaders = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetNumHeaders(call, &numHeaders));
+        VERIFY_ARE_EQUAL(5u, numHeaders);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetNumHeaders(prototype, &numHeaders));
+        VERIFY_ARE_EQUAL(4u, numHeaders);
+
+        // And setting one on the prototype leaves the calls already created from it as they were
+        HCCallHandle second = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreateFromPrototype(prototype, &second));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(prototype, "Accept-Language", "fr-FR", true));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetHeader(second, "Accept-Language", &value));
+        VERIFY_ARE_EQUAL_STR("en-US, en", value);
+
+        // The prototype and the shared headers outlive each other in either order
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(prototype));
+        XAsyncBlock asyncBlock{};
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(second, &asyncBlock));
+        VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+        VERIFY_ARE_EQUAL(4u, g_prototypePerformedHeaders.load());
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(second));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyCallPrototypeOnManyThreads)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyCallPrototypeOnManyThreads);
+
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&PrototypePerformCallback, nullptr));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        HCCallHandle prototype = CreatePrototype();
+        std::atomic<uint32_t> failures{ 0 };
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+        {
+            threads.emplace_back([&]()
+            {
+                for (int i = 0; i < 200; i++)
+                {
+                    HCCallHandle call = nullptr;
+                    const char* value = nullptr;
+                    if (FAILED(HCHttpCallCreateFromPrototype(prototype, &call)) ||
+                        FAILED(HCHttpCallRequestGetHeader(call, "x-xbl-contract-version", &value)) ||
+                        value == nullptr || strcmp(value, "2") != 0)
+                    {
+                        ++failures;
+                    }
+                    HCHttpCallCloseHandle(call);
+                }
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        VERIFY_ARE_EQUAL(0u, failures.load());
+
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(prototype));
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(MeasurePrototypeAllocations)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(MeasurePrototypeAllocations);
+
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(&PrototypeMemAlloc, &PrototypeMemFree));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        HCCallHandle prototype = CreatePrototype();
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreateFromPrototype(prototype, &call)); // freezes the prototype's headers
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        uint32_t before = g_prototypeTestAllocations;
+        HCCallHandle built = CreatePrototype();
+        uint32_t builtAllocations = g_prototypeTestAllocations - before;
+
+        before = g_prototypeTestAllocations;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreateFromPrototype(prototype, &call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyString(call, "{\"settings\":[\"Gamerscore\"]}"));
+        uint32_t clonedAllocations = g_prototypeTestAllocations - before;
+        LOG_COMMENT(L"allocations to set up a call: %u built, %u from a prototype", builtAllocations, clonedAllocations);
+
+        // The call itself and the body that differs, and the URL when there's no call arena to copy it into
+        VERIFY_ARE_EQUAL(HC_CALL_ARENA ? 2u : 3u, clonedAllocations);
+        VERIFY_IS_TRUE(clonedAllocations <= builtAllocations);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(built));
+
+        // Neither rebuilds the headers
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 1000; i++)
+        {
+            HCHttpCallCloseHandle(CreatePrototype());
+        }
+        auto builtTime = std::chrono::steady_clock::now() - start;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 1000; i++)
+        {
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreateFromPrototype(prototype, &call));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyString(call, "{\"settings\":[\"Gamerscore\"]}"));
+            HCHttpCallCloseHandle(call);
+        }
+        auto clonedTime = std::chrono::steady_clock::now() - start;
+        LOG_COMMENT(L"1000 calls set up in %lld us built, %lld us from a prototype",
+            static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(builtTime).count()),
+            static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(clonedTime).count()));
+
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(prototype));
+        HCCleanup();
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(nullptr, nullptr));
+    }
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
@@ -0,0 +1,408 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "UnitTestIncludes.h"
+#define TEST_CLASS_OWNER L"jasonsa"
+#include "DefineTestMacros.h"
+#include "utils.h"
+#include "../HTTP/httpcall.h"
+#include "../HTTP/compression.h"
+
+using namespace xbox::httpclient;
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
+
+static HRESULT AppendToVector(_In_reads_bytes_(size) const uint8_t* data, _In_ size_t size, _In_opt_ void* context)
+{
+    auto output = static_cast<std::vector<uint8_t>*>(context);
+    output->insert(output->end(), data, data + size);
+    return S_OK;
+}
+
+// Synthetic telemetry upload: repetitive JSON with enough varying fields to keep the matcher honest
+static std::vector<uint8_t> MakeTelemetryBody(size_t eventCount)
+{
+    std::string body = "{\"events\":[";
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < eventCount; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        char event[256];
+        snprintf(event, sizeof(event),
+            "%s{\"name\":\"Microsoft.Xbox.Telemetry.Event%u\",\"time\":\"2024-01-01T00:%02u:%02u.%03uZ\",\"seq\":%zu,\"data\":{\"value\":%u,\"flag\":%s}}",
+            i > 0 ? "," : "", (seed >> 8) % 16, (seed >> 12) % 60, (seed >> 4) % 60, seed % 1000, i, seed >> 16, (seed & 1) ? "true" : "false");
+        body += event;
+    }
+    body += "]}";
+    return std::vector<uint8_t>(body.begin(), body.end());
+}
+
+static std::vector<uint8_t> Inflate(http_compression_format format, std::vector<uint8_t> const& compressed, _Out_ HRESULT& hr)
+{
+    std::vector<uint8_t> output;
+    http_inflater inflater{ format, AppendToVector, &output };
+    hr = inflater.Write(compressed.data(), compressed.size());
+    if (SUCCEEDED(hr))
+    {
+        hr = inflater.Finish();
+    }
+    return output;
+}
+
+struct compression_perform_context
+{
+    size_t readSize{ 0 };
+    size_t reportedBodySize{ 0 };
+    std::string contentEncoding;
+    std::string acceptEncoding;
+    bool hasContentLength{ false };
+    std::vector<uint8_t> sentBody;
+    HRESULT readResult{ S_OK };
+    std::vector<uint8_t> gzipResponseBody; // written before the status and headers are set, as NSURLSession reports them
+};
+
+// The perform function stays registered after the test, so its context has to outlive it
+static compression_perform_context g_compressionPerformContext;
+
+// Stands in for a provider that streams the body with chunked transfer encoding
+static void CALLBACK CompressionPerformCallback(
+    _In_ HCCallHandle call,
+    _Inout_ XAsyncBlock* asyncBlock,
+    _In_opt_ void* ctx,
+    _In_opt_ HCPerformEnv /*env*/
+    )
+{
+    auto performContext = static_cast<compression_perform_context*>(ctx);
+
+    const char* headerValue = nullptr;
+    HCHttpCallRequestGetHeader(call, "Content-Encoding", &headerValue);
+    performContext->contentEncoding = headerValue != nullptr ? headerValue : "";
+    headerValue = nullptr;
+    HCHttpCallRequestGetHeader(call, "Accept-Encoding", &headerValue);
+    performContext->acceptEncoding = headerValue != nullptr ? headerValue : "";
+    headerValue = nullptr;
+    HCHttpCallRequestGetHeader(call, "Content-Length", &headerValue);
+    performContext->hasContentLength = headerValue != nullptr;
+
+    HCHttpCallRequestBodyReadFunction readFunction = nullptr;
+    void* context = nullptr;
+    performContext->readResult = HCHttpCallRequestGetRequestBodyReadFunction(call, &readFunction, &performContext->reportedBodySize, &context);
+
+    std::vector<uint8_t> buffer(performContext->readSize);
+    while (SUCCEEDED(performContext->readResult))
+    {
+        size_t bytesWritten = 0;
+        performContext->readResult = readFunction(call, performContext->sentBody.size(), buffer.size(), context, buffer.data(), &bytesWritten);
+        if (bytesWritten == 0)
+        {
+            break;
+        }
+        performContext->sentBody.insert(performContext->sentBody.end(), buffer.begin(), buffer.begin() + bytesWritten);
+    }
+
+    if (!performContext->gzipResponseBody.empty())
+    {
+        HCHttpCallResponseBodyWriteFunction writeFunction = nullptr;
+        void* writeContext = nullptr;
+        HCHttpCallResponseGetResponseBodyWriteFunction(call, &writeFunction, &writeContext);
+        auto const& body = performContext->gzipResponseBody;
+        for (size_t offset = 0; offset < body.size(); offset += 1000)
+        {
+            writeFunction(call, body.data() + offset, std::min<size_t>(1000, body.size() - offset), writeContext);
+        }
+        HCHttpCallResponseSetHeader(call, "Content-Encoding", "gzip");
+    }
+
+    HCHttpCallResponseSetStatusCode(call, 200);
+    XAsyncComplete(asyncBlock, S_OK, 0);
+}
+
+struct custom_body
+{
+    std::vector<uint8_t> const* bytes;
+};
+
+static HRESULT CALLBACK CustomBodyReadFunction(
+    _In_ HCCallHandle /*call*/,
+    _In_ size_t offset,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context,
+    _Out_writes_bytes_to_(bytesAvailable, *bytesWritten) uint8_t* destination,
+    _Out_ size_t* bytesWritten
+    )
+{
+    auto body = static_cast<custom_body*>(context)->bytes;
+    *bytesWritten = std::min(bytesAvailable, body->size() - std::min(offset, body->size()));
+    if (*bytesWritten > 0)
+    {
+        memcpy(destination, body->data() + offset, *bytesWritten);
+    }
+    return S_OK;
+}
+
+DEFINE_TEST_CLASS(CompressionTests)
+{
+public:
+    DEFINE_TEST_CLASS_PROPS(CompressionTests);
+
+    DEFINE_TEST_CASE(VerifyDeflaterRoundTrip)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyDeflaterRoundTrip);
+
+        // Mix of highly compressible JSON, incompressible noise and long runs to exercise every block type
+        std::vector<uint8_t> input = MakeTelemetryBody(2000);
+        uint32_t seed = 7;
+        for (size_t i = 0; i < 70000; i++)
+        {
+            seed = seed * 1664525 + 1013904223;
+            input.push_back(static_cast<uint8_t>(seed >> 24));
+        }
+        input.insert(input.end(), 100000, 'a');
+
+        const http_compression_format formats[] = { http_compression_format::gzip, http_compression_format::zlib };
+        const size_t writeSizes[] = { 1, 4093, SIZE_MAX };
+        for (auto format : formats)
+        {
+            for (uint32_t level = 0; level <= 9; level++)
+            {
+                for (size_t writeSize : writeSizes)
+                {
+                    // Byte at a time writes are slow, so only feed them a prefix
+                    size_t inputSize = writeSize == 1 ? 20000 : input.size();
+
+                    std::vector<uint8_t> compressed;
+                    http_deflater deflater{ format, level, AppendToVector, &compressed };
+                    for (size_t offset = 0; offset < inputSize; offset += std::min(writeSize, inputSize - offset))
+                    {
+                        VERIFY_ARE_EQUAL(S_OK, deflater.Write(input.data() + offset, std::min(writeSize, inputSize - offset)));
+                    }
+                    VERIFY_ARE_EQUAL(S_OK, deflater.Finish());
+                    VERIFY_ARE_EQUAL(static_cast<uint64_t>(inputSize), deflater.UncompressedBytes());
+                    VERIFY_ARE_EQUAL(static_cast<uint64_t>(compressed.size()), deflater.CompressedBytes());
+
+                    HRESULT hr = S_OK;
+                    std::vector<uint8_t> output = Inflate(format, compressed, hr);
+                    VERIFY_ARE_EQUAL(S_OK, hr);
+                    VERIFY_IS_TRUE(output.size() == inputSize && std::equal(output.begin(), output.end(), input.begin()));
+                }
+            }
+        }
+
+        // An empty stream is still a valid stream
+        std::vector<uint8_t> compressed;
+        http_deflater deflater{ http_compression_format::gzip, 6, AppendToVector, &compressed };
+        VERIFY_ARE_EQUAL(S_OK, deflater.Finish());
+        HRESULT hr = S_OK;
+        VERIFY_IS_TRUE(Inflate(http_compression_format::gzip, compressed, hr).empty());
+        VERIFY_ARE_EQUAL(S_OK, hr);
+    }
+
+    DEFINE_TEST_CASE(VerifyRequestCompression)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyRequestCompression);
+
+        std::vector<uint8_t> body = MakeTelemetryBody(500);
+        custom_body customBody{ &body };
+
+        for (bool useReadFunction : { false, true })
+        {
+            auto& performContext = g_compressionPerformContext;
+            performContext = compression_perform_context{};
+            performContext.readSize = 1000;
+            VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&CompressionPerformCallback, &performContext));
+            VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+            VERIFY_ARE_EQUAL(E_INVALIDARG, HCHttpCallRequestSetCompression(nullptr, static_cast<HCCompressionLevel>(10)));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetCompression(nullptr, HCCompressionLevel::Medium));
+
+            HCCallHandle call = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+            HCCompressionLevel level = HCCompressionLevel::None;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetCompression(call, &level));
+            VERIFY_ARE_EQUAL(HCCompressionLevel::Medium, level);
+
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "POST", "https://www.example.com/telemetry"));
+            if (useReadFunction)
+            {
+                VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyReadFunction(call, CustomBodyReadFunction, body.size(), &customBody));
+            }
+            else
+            {
+                VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyBytes(call, body.data(), static_cast<uint32_t>(body.size())));
+            }
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(call, "Content-Length", std::to_string(body.size()).c_str(), false));
+
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_SUCCEEDED(XAsyncGetStatus(&asyncBlock, true));
+
+            VERIFY_ARE_EQUAL(S_OK, performContext.readResult);
+            VERIFY_IS_TRUE(performContext.reportedBodySize == HC_UNKNOWN_REQUEST_BODY_SIZE);
+            VERIFY_ARE_EQUAL_STR("gzip", performContext.contentEncoding.c_str());
+            VERIFY_IS_FALSE(performContext.hasContentLength);
+            VERIFY_IS_TRUE(performContext.sentBody.size() < body.size() / 4);
+
+            HRESULT hr = S_OK;
+            std::vector<uint8_t> received = Inflate(http_compression_format::gzip, performContext.sentBody, hr);
+            VERIFY_ARE_EQUAL(S_OK, hr);
+            VERIFY_IS_TRUE(received == body);
+
+            // The call's own body is left as the caller set it
+            HCHttpCallRequestBodyReadFunction readFunction = nullptr;
+            size_t bodySize = 0;
+            void* context = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetRequestBodyReadFunction(call, &readFunction, &bodySize, &context));
+            VERIFY_ARE_EQUAL(body.size(), bodySize);
+            const char* headerValue = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetHeader(call, "Content-Encoding", &headerValue));
+            VERIFY_IS_NULL(headerValue);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetHeader(call, "Content-Length", &headerValue));
+            VERIFY_ARE_EQUAL_STR(std::to_string(body.size()).c_str(), headerValue);
+
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+            HCCleanup();
+        }
+    }
+
+    DEFINE_TEST_CASE(VerifyUnknownSizeRequestCompression)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyUnknownSizeRequestCompression);
+
+        std::vector<uint8_t> body = MakeTelemetryBody(500);
+        custom_body customBody{ &body };
+
+        auto& performContext = g_compressionPerformContext;
+        performContext = compression_perform_context{};
+        performContext.readSize = 1000;
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&CompressionPerformCallback, &performContext));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        // With no size to stop at, the compressor reads until the read function returns 0 bytes
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "POST", "https://www.example.com/telemetry"));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetCompression(call, HCCompressionLevel::Medium));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyReadFunction(call, CustomBodyReadFunction, HC_UNKNOWN_REQUEST_BODY_SIZE, &customBody));
+
+        XAsyncBlock asyncBlock{};
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+        VERIFY_SUCCEEDED(XAsyncGetStatus(&asyncBlock, true));
+
+        VERIFY_ARE_EQUAL(S_OK, performContext.readResult);
+        VERIFY_ARE_EQUAL_STR("gzip", performContext.contentEncoding.c_str());
+
+        HRESULT hr = S_OK;
+        std::vector<uint8_t> received = Inflate(http_compression_format::gzip, performContext.sentBody, hr);
+        VERIFY_ARE_EQUAL(S_OK, hr);
+        VERIFY_IS_TRUE(received == body);
+
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyBodyBeforeStatusDecompression)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyBodyBeforeStatusDecompression);
+
+        std::vector<uint8_t> body = MakeTelemetryBody(500);
+        auto& performContext = g_compressionPerformContext;
+        performContext = compression_perform_context{};
+        http_deflater deflater{ http_compression_format::gzip, 6, AppendToVector, &performContext.gzipResponseBody };
+        VERIFY_ARE_EQUAL(S_OK, deflater.Write(body.data(), body.size()));
+        VERIFY_ARE_EQUAL(S_OK, deflater.Finish());
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&CompressionPerformCallback, &performContext));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        // The body waits for the Content-Encoding header rather than passing through still encoded
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "https://www.example.com/telemetry"));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetResponseDecompression(call, true));
+
+        XAsyncBlock asyncBlock{};
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+        VERIFY_SUCCEEDED(XAsyncGetStatus(&asyncBlock, true));
+
+        size_t receivedSize = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseBodyBytesSize(call, &receivedSize));
+        VERIFY_ARE_EQUAL(body.size(), receivedSize);
+        std::vector<uint8_t> receivedBody(receivedSize);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseBodyBytes(call, receivedBody.size(), receivedBody.data(), &receivedSize));
+        VERIFY_IS_TRUE(receivedBody == body);
+
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyCompressionHeadersLastOneAttempt)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyCompressionHeadersLastOneAttempt);
+
+        std::vector<uint8_t> body = MakeTelemetryBody(100);
+        auto& performContext = g_compressionPerformContext;
+        performContext = compression_perform_context{};
+        performContext.readSize = 1000;
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&CompressionPerformCallback, &performContext));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        HCCallHandle prototype = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&prototype));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(prototype, "POST", "https://www.example.com/telemetry"));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(prototype, "Content-Length", std::to_string(body.size()).c_str(), false));
+
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreateFromPrototype(prototype, &call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyBytes(call, body.data(), static_cast<uint32_t>(body.size())));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetCompression(call, HCCompressionLevel::Medium));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetResponseDecompression(call, true));
+        VERIFY_IS_TRUE(call->requestHeaders.is_shared());
+
+        XAsyncBlock asyncBlock{};
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+        VERIFY_SUCCEEDED(XAsyncGetStatus(&asyncBlock, true));
+
+        // The attempt was sent compressed and advertising the encodings it can decode
+        VERIFY_ARE_EQUAL_STR("gzip", performContext.contentEncoding.c_str());
+        VERIFY_ARE_EQUAL_STR("gzip, deflate", performContext.acceptEncoding.c_str());
+        VERIFY_IS_FALSE(performContext.hasContentLength);
+
+        // Afterwards the call has the prototype's headers again, still shared with it
+        const char* headerValue = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetHeader(call, "Accept-Encoding", &headerValue));
+        VERIFY_IS_NULL(headerValue);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetHeader(call, "Content-Encoding", &headerValue));
+        VERIFY_IS_NULL(headerValue);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetHeader(call, "Content-Length", &headerValue));
+        VERIFY_ARE_EQUAL_STR(std::to_string(body.size()).c_str(), headerValue);
+        VERIFY_IS_TRUE(call->requestHeaders.is_shared());
+        VERIFY_IS_TRUE(&call->requestHeaders.get() == &prototype->requestHeaders.get());
+
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(prototype));
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(MeasureCompressionLevels)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(MeasureCompressionLevels);
+
+        // Timings are only logged; this never fails on a slow machine
+        std::vector<uint8_t> input = MakeTelemetryBody(20000);
+        for (uint32_t level : { 0u, 1u, 3u, 6u, 9u })
+        {
+            std::vector<uint8_t> compressed;
+            compressed.reserve(input.size());
+
+            auto start = std::chrono::steady_clock::now();
+            http_deflater deflater{ http_compression_format::gzip, level, AppendToVector, &compressed };
+            VERIFY_ARE_EQUAL(S_OK, deflater.Write(input.data(), input.size()));
+            VERIFY_ARE_EQUAL(S_OK, deflater.Finish());
+            auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            LOG_COMMENT(L"level %u: %zu -> %zu bytes (%.1f%%), %.1f MB/s", level, input.size(), compressed.size(),
+                100.0 * compressed.size() / input.size(), input.size() / elapsed / (1024 * 1024));
+        }
+    }
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
@@ -0,0 +1,490 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "UnitTestIncludes.h"
+#define TEST_CLASS_OWNER L"jasonsa"
+#include "DefineTestMacros.h"
+#include "utils.h"
+
+#if HC_CURL_HTTP
+#include "../HTTP/Curl/curl_http_task.h"
+#include "loopback_http_server.h"
+#include "loopback_h2c_server.h"
+#include <set>
+
+using namespace xbox::httpclient;
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
+
+// Echoes the request back: the method and X-Test header as response headers and the request body as the response body
+static loopback_http_server::response EchoHandler(loopback_http_server::request const& request)
+{
+    loopback_http_server::response response;
+    if (request.path == "/slow")
+    {
+        response.delay = std::chrono::seconds(30);
+    }
+    else if (request.path == "/missing")
+    {
+        response.statusCode = 404;
+    }
+
+    auto test = request.headers.find("x-test");
+    auto transferEncoding = request.headers.find("transfer-encoding");
+    response.headers.push_back({ "X-Method", request.method });
+    response.headers.push_back({ "X-Test", test != request.headers.end() ? test->second : "" });
+    response.headers.push_back({ "X-Chunked", transferEncoding != request.headers.end() ? "true" : "false" });
+    response.body = request.body;
+    return response;
+}
+
+// Request body served in uneven slices so the body crosses several curl read callbacks
+static HRESULT CALLBACK SlicedBodyReadFunction(
+    _In_ HCCallHandle /*call*/,
+    _In_ size_t offset,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context,
+    _Out_writes_bytes_to_(bytesAvailable, *bytesWritten) uint8_t* destination,
+    _Out_ size_t* bytesWritten
+)
+{
+    auto body = static_cast<std::string*>(context);
+    *bytesWritten = std::min({ bytesAvailable, body->size() - offset, static_cast<size_t>(777) });
+    memcpy(destination, body->data() + offset, *bytesWritten);
+    return S_OK;
+}
+
+// Request and response body callbacks that pause the call at the given body offsets, leaving it to PerformPausing to
+// resume it
+struct pausing_body
+{
+    explicit pausing_body(std::vector<size_t> offsets) : pauseOffsets{ std::move(offsets) } {}
+
+    static HRESULT CALLBACK Read(
+        _In_ HCCallHandle /*call*/,
+        _In_ size_t offset,
+        _In_ size_t bytesAvailable,
+        _In_opt_ void* context,
+        _Out_writes_bytes_to_(bytesAvailable, *bytesWritten) uint8_t* destination,
+        _Out_ size_t* bytesWritten
+    )
+    {
+        auto body = static_cast<pausing_body*>(context);
+        ++body->calls;
+        if (body->nextPause < body->pauseOffsets.size() && offset >= body->pauseOffsets[body->nextPause])
+        {
+            ++body->nextPause;
+            body->paused = true;
+            return E_PENDING;
+        }
+        *bytesWritten = std::min({ bytesAvailable, body->source.size() - offset, static_cast<size_t>(777) });
+        memcpy(destination, body->source.data() + offset, *bytesWritten);
+        return S_OK;
+    }
+
+    static HRESULT CALLBACK Write(
+        _In_ HCCallHandle /*call*/,
+        _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+        _In_ size_t bytesAvailable,
+        _In_opt_ void* context
+    )
+    {
+        auto body = static_cast<pausing_body*>(context);
+        ++body->calls;
+        body->received.append(reinterpret_cast<const char*>(source), bytesAvailable);
+        if (body->nextPause < body->pauseOffsets.size() && body->received.size() >= body->pauseOffsets[body->nextPause])
+        {
+            ++body->nextPause;
+            body->paused = true;
+            return E_PENDING;
+        }
+        return S_OK;
+    }
+
+    std::string source;
+    std::string received;
+    std::vector<size_t> pauseOffsets;
+    size_t nextPause{ 0 };
+    std::atomic<uint32_t> calls{ 0 };
+    std::atomic<bool> paused{ false };
+};
+
+// Performs the call, checking that its body callbacks aren't invoked while it is paused before resuming it
+static void PerformPausing(HCCallHandle call, pausing_body& body)
+{
+    XAsyncBlock asyncBlock{};
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+    uint32_t pauses = 0;
+    while (XAsyncGetStatus(&asyncBlock, false) == E_PENDING)
+    {
+        if (body.paused)
+        {
+            uint32_t calls = body.calls;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            VERIFY_ARE_EQUAL(calls, static_cast<uint32_t>(body.calls));
+            ++pauses;
+            body.paused = false;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResumeBodyTransfer(call));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+    VERIFY_ARE_EQUAL(body.pauseOffsets.size(), static_cast<size_t>(pauses));
+}
+
+static HCCallHandle CreateCall(const char* method, std::string const& url)
+{
+    HCCallHandle call = nullptr;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, method, url.c_str()));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, false));
+    return call;
+}
+
+static std::string GetResponseHeader(HCCallHandle call, const char* name)
+{
+    const char* value = nullptr;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetHeader(call, name, &value));
+    return value != nullptr ? value : "";
+}
+
+DEFINE_TEST_CLASS(CurlHttpTests)
+{
+public:
+    DEFINE_TEST_CLASS_PROPS(CurlHttpTests);
+
+    DEFINE_TEST_CASE(VerifyCurlRequests)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyCurlRequests);
+
+        loopback_http_server server{ EchoHandler };
+        curl_http_engine engine;
+        VERIFY_ARE_EQUAL(S_OK, engine.Initialize(1));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&curl_http_engine::PerformAsync, &engine));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        // GET with a request header
+        {
+            HCCallHandle call = CreateCall("GET", server.Url("/get"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(call, "X-Test", "header value", false));
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+
+            uint32_t statusCode = 0;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetStatusCode(call, &statusCode));
+            VERIFY_ARE_EQUAL(200u, statusCode);
+            VERIFY_ARE_EQUAL_STR("GET", GetResponseHeader(call, "X-Method").c_str());
+            VERIFY_ARE_EQUAL_STR("header value", GetResponseHeader(call, "X-Test").c_str());
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // POST bodies of known and unknown size, the latter going out chunked
+        std::string body;
+        for (uint32_t i = 0; body.size() < 100000; i++)
+        {
+            body += std::to_string(i) + ",";
+        }
+        for (bool knownSize : { true, false })
+        {
+            HCCallHandle call = CreateCall("POST", server.Url("/post"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyReadFunction(call, SlicedBodyReadFunction, knownSize ? body.size() : HC_UNKNOWN_REQUEST_BODY_SIZE, &body));
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+
+            const char* response = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseString(call, &response));
+            VERIFY_IS_TRUE(body == response);
+            VERIFY_ARE_EQUAL_STR("POST", GetResponseHeader(call, "X-Method").c_str());
+            VERIFY_ARE_EQUAL_STR(knownSize ? "false" : "true", GetResponseHeader(call, "X-Chunked").c_str());
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // Other methods and status codes
+        {
+            HCCallHandle call = CreateCall("DELETE", server.Url("/missing"));
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+
+            uint32_t statusCode = 0;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetStatusCode(call, &statusCode));
+            VERIFY_ARE_EQUAL(404u, statusCode);
+            VERIFY_ARE_EQUAL_STR("DELETE", GetResponseHeader(call, "X-Method").c_str());
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // Sequential calls share one kept-alive connection
+        VERIFY_ARE_EQUAL(1u, server.ConnectionCount());
+
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyCurlConcurrentCalls)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyCurlConcurrentCalls);
+
+        loopback_http_server server{ EchoHandler };
+        curl_http_engine engine;
+        VERIFY_ARE_EQUAL(S_OK, engine.Initialize(2));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&curl_http_engine::PerformAsync, &engine));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        constexpr size_t callCount = 200;
+        std::vector<HCCallHandle> calls(callCount);
+        std::vector<XAsyncBlock> asyncBlocks(callCount);
+        for (size_t i = 0; i < callCount; i++)
+        {
+            calls[i] = CreateCall("GET", server.Url("/concurrent"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(calls[i], "X-Test", std::to_string(i).c_str(), false));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(calls[i], &asyncBlocks[i]));
+        }
+
+        for (size_t i = 0; i < callCount; i++)
+        {
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlocks[i], true));
+            VERIFY_ARE_EQUAL_STR(std::to_string(i).c_str(), GetResponseHeader(calls[i], "X-Test").c_str());
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(calls[i]));
+        }
+        VERIFY_ARE_EQUAL(static_cast<uint32_t>(callCount), server.RequestCount());
+
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyCurlCancelAndTimeout)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyCurlCancelAndTimeout);
+
+        loopback_http_server server{ EchoHandler };
+        curl_http_engine engine;
+        VERIFY_ARE_EQUAL(S_OK, engine.Initialize(1));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&curl_http_engine::PerformAsync, &engine));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        // Canceling the outer async block aborts the transfer in flight
+        {
+            HCCallHandle call = CreateCall("GET", server.Url("/slow"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, true));
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            while (server.RequestCount() == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            XAsyncCancel(&asyncBlock);
+            VERIFY_ARE_EQUAL(E_ABORT, XAsyncGetStatus(&asyncBlock, true));
+            VERIFY_IS_TRUE(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+            VERIFY_ARE_EQUAL(1u, server.RequestCount());
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // A transfer that outlives the call's timeout fails with a network error
+        {
+            HCCallHandle call = CreateCall("GET", server.Url("/slow"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetTimeout(call, 1));
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+
+            HRESULT networkError = S_OK;
+            uint32_t platformError = 0;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &networkError, &platformError));
+            VERIFY_ARE_EQUAL(E_FAIL, networkError);
+            VERIFY_ARE_EQUAL(static_cast<uint32_t>(CURLE_OPERATION_TIMEDOUT), platformError);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyCurlBodyBackPressure)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyCurlBodyBackPressure);
+
+        // Larger than the socket buffers on both ends, so the server is held back while the call is paused
+        std::string largeBody;
+        for (uint32_t i = 0; largeBody.size() < 16 * 1024 * 1024; i++)
+        {
+            largeBody += std::to_string(i) + ",";
+        }
+        loopback_http_server server{ [&largeBody](loopback_http_server::request const& request)
+        {
+            if (request.path == "/large")
+            {
+                loopback_http_server::response response;
+                response.body = largeBody;
+                return response;
+            }
+            return EchoHandler(request);
+        } };
+
+        curl_http_engine engine;
+        VERIFY_ARE_EQUAL(S_OK, engine.Initialize(1));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&curl_http_engine::PerformAsync, &engine));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        {
+            pausing_body body{ { 1, 4 * 1024 * 1024, 12 * 1024 * 1024 } };
+            HCCallHandle call = CreateCall("GET", server.Url("/large"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseSetResponseBodyWriteFunction(call, pausing_body::Write, &body));
+            PerformPausing(call, body);
+            VERIFY_IS_TRUE(largeBody == body.received);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // Request bodies of known and unknown size, paused before the first byte and partway through
+        for (bool knownSize : { true, false })
+        {
+            pausing_body body{ { 0, 50000 } };
+            body.source = largeBody.substr(0, 100000);
+            HCCallHandle call = CreateCall("POST", server.Url("/post"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyReadFunction(call, pausing_body::Read, knownSize ? body.source.size() : HC_UNKNOWN_REQUEST_BODY_SIZE, &body));
+            PerformPausing(call, body);
+
+            const char* response = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseString(call, &response));
+            VERIFY_IS_TRUE(body.source == response);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // Paused calls are still canceled
+        {
+            pausing_body body{ { 1 } };
+            HCCallHandle call = CreateCall("GET", server.Url("/large"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseSetResponseBodyWriteFunction(call, pausing_body::Write, &body));
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            while (!body.paused)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            XAsyncCancel(&asyncBlock);
+            VERIFY_ARE_EQUAL(E_ABORT, XAsyncGetStatus(&asyncBlock, true));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyCurlHttp2Multiplexing)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyCurlHttp2Multiplexing);
+
+        loopback_h2c_server server;
+        curl_http_engine engine;
+        VERIFY_ARE_EQUAL(S_OK, engine.Initialize(1));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&curl_http_engine::PerformAsync, &engine));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        // Defaults for future calls. Calls upgrade from HTTP/1.1 rather than use prior knowledge, which libcurl 7.88
+        // can't reuse connections for.
+        HCHttpVersion version = HCHttpVersion::Default;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHttpVersion(nullptr, HCHttpVersion::Http2));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetHttpVersion(nullptr, &version));
+        VERIFY_IS_TRUE(version == HCHttpVersion::Http2);
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCHttpCallRequestSetPriority(nullptr, static_cast<HCHttpCallPriority>(3)));
+
+        // Concurrent calls become streams of one connection, each weighted by its priority
+        constexpr size_t callCount = 30;
+        const HCHttpCallPriority priorities[] = { HCHttpCallPriority::Low, HCHttpCallPriority::Normal, HCHttpCallPriority::High };
+        std::string body(50000, 'x');
+        std::vector<HCCallHandle> calls(callCount);
+        std::vector<XAsyncBlock> asyncBlocks(callCount);
+        for (size_t i = 0; i < callCount; i++)
+        {
+            calls[i] = CreateCall(i % 2 ? "POST" : "GET", server.Url("/h2"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetPriority(calls[i], priorities[i % 3]));
+            if (i % 2)
+            {
+                VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyReadFunction(calls[i], SlicedBodyReadFunction, body.size(), &body));
+            }
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(calls[i], &asyncBlocks[i]));
+        }
+
+        std::set<std::string> streamIds;
+        for (size_t i = 0; i < callCount; i++)
+        {
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlocks[i], true));
+            uint32_t statusCode = 0;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetStatusCode(calls[i], &statusCode));
+            VERIFY_ARE_EQUAL(200u, statusCode);
+            const char* response = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseString(calls[i], &response));
+            VERIFY_IS_TRUE((i % 2 ? body : std::string{}) == response);
+            streamIds.insert(GetResponseHeader(calls[i], "x-stream-id"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(calls[i]));
+        }
+        VERIFY_ARE_EQUAL(callCount, streamIds.size());
+        VERIFY_ARE_EQUAL(1u, server.ConnectionCount());
+
+        std::set<uint32_t> weights;
+        for (auto const& stream : server.Streams())
+        {
+            weights.insert(stream.weight);
+        }
+        VERIFY_IS_TRUE(weights == std::set<uint32_t>({ 8u, 16u, 128u }));
+
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyCurlHttp2Cancel)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyCurlHttp2Cancel);
+
+        loopback_h2c_server server{ true };
+        curl_http_engine engine;
+        VERIFY_ARE_EQUAL(S_OK, engine.Initialize(1));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&curl_http_engine::PerformAsync, &engine));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        // The first call upgrades the connection and the others are multiplexed onto it as streams 3 and 5
+        constexpr size_t callCount = 3;
+        std::vector<HCCallHandle> calls(callCount);
+        std::vector<XAsyncBlock> asyncBlocks(callCount);
+        auto perform = [&](size_t i)
+        {
+            calls[i] = CreateCall("GET", server.Url("/held"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHttpVersion(calls[i], HCHttpVersion::Http2));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(calls[i], &asyncBlocks[i]));
+            while (server.Streams().size() <= i)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        };
+        perform(0);
+        perform(1);
+
+        // Canceling a call resets its stream without tearing down the shared connection. libcurl queues the
+        // RST_STREAM until it next writes to the connection, which the third call makes it do.
+        XAsyncCancel(&asyncBlocks[1]);
+        VERIFY_ARE_EQUAL(E_ABORT, XAsyncGetStatus(&asyncBlocks[1], true));
+        perform(2);
+
+        auto streams = server.Streams();
+        VERIFY_ARE_EQUAL(3u, streams[1].streamId);
+        VERIFY_IS_TRUE(streams[1].reset);
+        VERIFY_IS_FALSE(streams[0].reset);
+        VERIFY_ARE_EQUAL(5u, streams[2].streamId);
+        VERIFY_ARE_EQUAL(1u, server.ConnectionCount());
+        VERIFY_ARE_EQUAL(E_PENDING, XAsyncGetStatus(&asyncBlocks[0], false));
+
+        for (size_t i : { 0, 2 })
+        {
+            XAsyncCancel(&asyncBlocks[i]);
+            VERIFY_ARE_EQUAL(E_ABORT, XAsyncGetStatus(&asyncBlocks[i], true));
+        }
+        for (HCCallHandle call : calls)
+        {
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        HCCleanup();
+    }
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
+#endif
@@ -0,0 +1,340 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "UnitTestIncludes.h"
+#define TEST_CLASS_OWNER L"jasonsa"
+#include "DefineTestMacros.h"
+#include "utils.h"
+
+#if HC_EPOLL_HTTP
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <condition_variable>
+#include <set>
+#include "../HTTP/Epoll/epoll_http_engine.h"
+#include "loopback_http_server.h"
+
+using namespace xbox::httpclient;
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
+
+// Stands in for DNS: IPv4 addresses by host name, each answer cached for ttl. Lookups of hosts in blockedHosts wait
+// until they are unblocked.
+struct hosts_table
+{
+    std::map<std::string, std::string> addresses;
+    std::chrono::milliseconds ttl{ std::chrono::seconds(60) };
+
+    std::mutex lock;
+    std::condition_variable unblocked;
+    std::set<std::string> blockedHosts;
+    std::map<std::string, uint32_t> lookupCounts;
+
+    void Block(std::string const& hostName)
+    {
+        std::lock_guard<std::mutex> guard{ lock };
+        blockedHosts.insert(hostName);
+    }
+
+    void Unblock(std::string const& hostName)
+    {
+        {
+            std::lock_guard<std::mutex> guard{ lock };
+            blockedHosts.erase(hostName);
+        }
+        unblocked.notify_all();
+    }
+
+    uint32_t LookupCount(std::string const& hostName)
+    {
+        std::lock_guard<std::mutex> guard{ lock };
+        return lookupCounts[hostName];
+    }
+
+    void WaitForLookups(std::string const& hostName, uint32_t count)
+    {
+        for (uint32_t i = 0; i < 500 && LookupCount(hostName) < count; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    static void Lookup(_In_z_ const char* hostName, _In_opt_ void* context, _Inout_ dns_result& result, _Inout_ std::chrono::milliseconds& ttl)
+    {
+        auto table = static_cast<hosts_table*>(context);
+        std::unique_lock<std::mutex> guard{ table->lock };
+        table->unblocked.wait(guard, [&] { return table->blockedHosts.count(hostName) == 0; });
+
+        auto entry = table->addresses.find(hostName);
+        if (entry == table->addresses.end())
+        {
+            result.hr = E_FAIL;
+            result.platformError = EAI_NONAME;
+        }
+        else
+        {
+            dns_address address;
+            auto ipv4 = reinterpret_cast<sockaddr_in*>(&address.address);
+            ipv4->sin_family = AF_INET;
+            inet_pton(AF_INET, entry->second.c_str(), &ipv4->sin_addr);
+            address.size = sizeof(sockaddr_in);
+            result.addresses.push_back(address);
+            ttl = table->ttl;
+        }
+
+        // Counted once the answer is complete, so a waiting test sees the result cached right after
+        ++table->lookupCounts[hostName];
+    }
+};
+
+// Records the results delivered to dns_resolve_callback
+struct resolve_results
+{
+    std::mutex lock;
+    std::condition_variable delivered;
+    std::map<uint64_t, dns_result_ptr> results;
+
+    static void Callback(_In_opt_ void* context, _In_ uint64_t cookie, _In_ dns_result_ptr const& result)
+    {
+        auto self = static_cast<resolve_results*>(context);
+        {
+            std::lock_guard<std::mutex> guard{ self->lock };
+            self->results[cookie] = result;
+        }
+        self->delivered.notify_all();
+    }
+
+    dns_result_ptr Wait(uint64_t cookie)
+    {
+        std::unique_lock<std::mutex> guard{ lock };
+        delivered.wait_for(guard, std::chrono::seconds(5), [&] { return results.count(cookie) > 0; });
+        return results.count(cookie) > 0 ? results[cookie] : nullptr;
+    }
+};
+
+static std::string AddressString(dns_address const& address)
+{
+    char buffer[INET6_ADDRSTRLEN] = {};
+    if (address.address.ss_family == AF_INET)
+    {
+        inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in*>(&address.address)->sin_addr, buffer, sizeof(buffer));
+    }
+    else
+    {
+        inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6*>(&address.address)->sin6_addr, buffer, sizeof(buffer));
+    }
+    return buffer;
+}
+
+DEFINE_TEST_CLASS(DnsResolverTests)
+{
+public:
+    DEFINE_TEST_CLASS_PROPS(DnsResolverTests);
+
+    DEFINE_TEST_CASE(VerifyDnsCache)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyDnsCache);
+
+        hosts_table table;
+        table.addresses = { { "example.test", "10.0.0.1" }, { "slow.test", "10.0.0.2" }, { "short.test", "10.0.0.3" } };
+
+        dns_resolver_settings settings;
+        settings.negativeTtl = std::chrono::milliseconds(200);
+        settings.prefetchMinHits = 1000; // prefetching is covered separately
+        settings.lookup = hosts_table::Lookup;
+        settings.lookupContext = &table;
+        dns_resolver resolver;
+        VERIFY_ARE_EQUAL(S_OK, resolver.Initialize(settings));
+        resolve_results results;
+        uint64_t cookie = 0;
+
+        // A miss is looked up in the background, then answered from the cache regardless of case
+        dns_result_ptr result;
+        VERIFY_ARE_EQUAL(E_PENDING, resolver.Resolve("example.test", resolve_results::Callback, &results, ++cookie, &result));
+        result = results.Wait(cookie);
+        VERIFY_IS_TRUE(result != nullptr && SUCCEEDED(result->hr) && result->addresses.size() == 1);
+        VERIFY_ARE_EQUAL_STR("10.0.0.1", AddressString(result->addresses[0]).c_str());
+        VERIFY_ARE_EQUAL(S_OK, resolver.Resolve("EXAMPLE.test", resolve_results::Callback, &results, ++cookie, &result));
+        VERIFY_ARE_EQUAL_STR("10.0.0.1", AddressString(result->addresses[0]).c_str());
+        VERIFY_ARE_EQUAL(1u, table.LookupCount("example.test"));
+
+        // IP literals never reach the lookup or the counters
+        VERIFY_ARE_EQUAL(S_OK, resolver.Resolve("127.0.0.1", resolve_results::Callback, &results, ++cookie, &result));
+        VERIFY_ARE_EQUAL_STR("127.0.0.1", AddressString(result->addresses[0]).c_str());
+        VERIFY_ARE_EQUAL(S_OK, resolver.Resolve("[::1]", resolve_results::Callback, &results, ++cookie, &result));
+        VERIFY_ARE_EQUAL_STR("::1", AddressString(result->addresses[0]).c_str());
+
+        // Concurrent resolutions of one host share a lookup
+        table.Block("slow.test");
+        uint64_t firstSlowCookie = cookie + 1;
+        for (uint32_t i = 0; i < 10; i++)
+        {
+            VERIFY_ARE_EQUAL(E_PENDING, resolver.Resolve("slow.test", resolve_results::Callback, &results, ++cookie, &result));
+        }
+        table.Unblock("slow.test");
+        for (uint64_t slowCookie = firstSlowCookie; slowCookie <= cookie; slowCookie++)
+        {
+            result = results.Wait(slowCookie);
+            VERIFY_IS_TRUE(result != nullptr && result->addresses.size() == 1);
+        }
+        VERIFY_ARE_EQUAL(1u, table.LookupCount("slow.test"));
+
+        // Failures are cached for the negative TTL
+        VERIFY_ARE_EQUAL(E_PENDING, resolver.Resolve("missing.test", resolve_results::Callback, &results, ++cookie, &result));
+        result = results.Wait(cookie);
+        VERIFY_IS_TRUE(result != nullptr && FAILED(result->hr));
+        VERIFY_ARE_EQUAL(EAI_NONAME, result->platformError);
+        VERIFY_ARE_EQUAL(S_OK, resolver.Resolve("missing.test", resolve_results::Callback, &results, ++cookie, &result));
+        VERIFY_IS_TRUE(FAILED(result->hr));
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        VERIFY_ARE_EQUAL(E_PENDING, resolver.Resolve("missing.test", resolve_results::Callback, &results, ++cookie, &result));
+        results.Wait(cookie);
+        VERIFY_ARE_EQUAL(2u, table.LookupCount("missing.test"));
+
+        // Answers expire with their TTL
+        table.ttl = std::chrono::milliseconds(200);
+        VERIFY_ARE_EQUAL(E_PENDING, resolver.Resolve("short.test", resolve_results::Callback, &results, ++cookie, &result));
+        results.Wait(cookie);
+        VERIFY_ARE_EQUAL(S_OK, resolver.Resolve("short.test", resolve_results::Callback, &results, ++cookie, &result));
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        VERIFY_ARE_EQUAL(E_PENDING, resolver.Resolve("short.test", resolve_results::Callback, &results, ++cookie, &result));
+        results.Wait(cookie);
+        VERIFY_ARE_EQUAL(2u, table.LookupCount("short.test"));
+
+        // Canceled callbacks are never made
+        resolve_results canceledResults;
+        table.Block("example2.test");
+        VERIFY_ARE_EQUAL(E_PENDING, resolver.Resolve("example2.test", resolve_results::Callback, &canceledResults, 1, &result));
+        resolver.CancelCallbacks(&canceledResults);
+        table.Unblock("example2.test");
+        table.WaitForLookups("example2.test", 1);
+        VERIFY_IS_TRUE(canceledResults.results.empty());
+
+        // example: 1 miss 1 hit, slow: 1 miss 9 coalesced, missing: 2 misses 1 hit, short: 2 misses 1 hit, example2: 1 miss
+        HCDnsCacheStats stats = resolver.GetStats();
+        VERIFY_ARE_EQUAL(3ull, stats.hits);
+        VERIFY_ARE_EQUAL(7ull, stats.misses);
+        VERIFY_ARE_EQUAL(9ull, stats.coalesced);
+        VERIFY_ARE_EQUAL(0ull, stats.prefetches);
+        VERIFY_IS_TRUE(std::abs(stats.hitRate - 3.0 / 19.0) < 1e-9);
+    }
+
+    DEFINE_TEST_CASE(VerifyDnsPrefetch)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyDnsPrefetch);
+
+        hosts_table table;
+        table.addresses = { { "hot.test", "10.0.0.1" }, { "cold.test", "10.0.0.2" }, { "warm.test", "10.0.0.3" } };
+        table.ttl = std::chrono::milliseconds(600);
+
+        dns_resolver_settings settings;
+        settings.prefetchWindow = std::chrono::milliseconds(400);
+        settings.prefetchMinHits = 2;
+        settings.lookup = hosts_table::Lookup;
+        settings.lookupContext = &table;
+        dns_resolver resolver;
+        VERIFY_ARE_EQUAL(S_OK, resolver.Initialize(settings));
+        resolve_results results;
+        dns_result_ptr result;
+
+        // Hot hosts are refreshed before they expire, cold ones aren't
+        VERIFY_ARE_EQUAL(E_PENDING, resolver.Resolve("hot.test", resolve_results::Callback, &results, 1, &result));
+        VERIFY_ARE_EQUAL(E_PENDING, resolver.Resolve("cold.test", resolve_results::Callback, &results, 2, &result));
+        results.Wait(1);
+        results.Wait(2);
+        VERIFY_ARE_EQUAL(S_OK, resolver.Resolve("hot.test", resolve_results::Callback, &results, 3, &result));
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        VERIFY_ARE_EQUAL(S_OK, resolver.Resolve("hot.test", resolve_results::Callback, &results, 4, &result));
+        VERIFY_ARE_EQUAL(S_OK, resolver.Resolve("cold.test", resolve_results::Callback, &results, 5, &result));
+        table.WaitForLookups("hot.test", 2);
+        VERIFY_ARE_EQUAL(2u, table.LookupCount("hot.test"));
+
+        // Past the original expiry the refreshed answer is still cached
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        VERIFY_ARE_EQUAL(S_OK, resolver.Resolve("hot.test", resolve_results::Callback, &results, 6, &result));
+        VERIFY_ARE_EQUAL(E_PENDING, resolver.Resolve("cold.test", resolve_results::Callback, &results, 7, &result));
+        results.Wait(7);
+        VERIFY_ARE_EQUAL(2u, table.LookupCount("cold.test"));
+
+        // Pre-warming looks hosts up ahead of the first resolution
+        const char* hostNames[] = { "warm.test", "hot.test", "127.0.0.1" };
+        VERIFY_ARE_EQUAL(S_OK, resolver.Prewarm(hostNames, 3));
+        table.WaitForLookups("warm.test", 1);
+        VERIFY_ARE_EQUAL(S_OK, resolver.Resolve("warm.test", resolve_results::Callback, &results, 8, &result));
+        VERIFY_ARE_EQUAL(2u, table.LookupCount("hot.test"));
+        VERIFY_ARE_EQUAL(E_INVALIDARG, resolver.Prewarm(nullptr, 1));
+
+        HCDnsCacheStats stats = resolver.GetStats();
+        VERIFY_ARE_EQUAL(2ull, stats.prefetches);
+    }
+
+    DEFINE_TEST_CASE(VerifyEpollAsyncResolution)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyEpollAsyncResolution);
+
+        loopback_http_server server{ [](loopback_http_server::request const&) { return loopback_http_server::response{}; } };
+        std::string url = server.Url("/");
+        url.replace(url.find("127.0.0.1"), 9, "loopback.test");
+
+        hosts_table table;
+        table.addresses = { { "loopback.test", "127.0.0.1" } };
+        dns_resolver_settings resolverSettings;
+        resolverSettings.lookup = hosts_table::Lookup;
+        resolverSettings.lookupContext = &table;
+        dns_resolver resolver;
+        VERIFY_ARE_EQUAL(S_OK, resolver.Initialize(resolverSettings));
+
+        epoll_http_engine_settings settings;
+        settings.resolver = &resolver;
+        epoll_http_engine engine;
+        VERIFY_ARE_EQUAL(S_OK, engine.Initialize(settings));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&epoll_http_engine::PerformAsync, &engine));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        // The call is performed without waiting on the lookup, and connects once it finishes
+        table.Block("loopback.test");
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", url.c_str()));
+        XAsyncBlock asyncBlock{};
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        VERIFY_ARE_EQUAL(E_PENDING, XAsyncGetStatus(&asyncBlock, false));
+        table.Unblock("loopback.test");
+        VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+        uint32_t statusCode = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetStatusCode(call, &statusCode));
+        VERIFY_ARE_EQUAL(200u, statusCode);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        // Unknown hosts fail with the resolver's error
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "http://nowhere.test/"));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, false));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+        VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+        HRESULT networkError = S_OK;
+        uint32_t platformError = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &networkError, &platformError));
+        VERIFY_ARE_EQUAL(E_FAIL, networkError);
+        VERIFY_ARE_EQUAL(static_cast<uint32_t>(EAI_NONAME), platformError);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        // A call canceled while its host is being resolved completes right away
+        table.Block("blocked.test");
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "http://blocked.test/"));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        XAsyncCancel(&asyncBlock);
+        VERIFY_ARE_EQUAL(E_ABORT, XAsyncGetStatus(&asyncBlock, true));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        HCCleanup();
+        table.Unblock("blocked.test");
+    }
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
+#endif
@@ -0,0 +1,802 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "UnitTestIncludes.h"
+#define TEST_CLASS_OWNER L"jasonsa"
+#include "DefineTestMacros.h"
+#include "utils.h"
+
+#if HC_EPOLL_HTTP
+#include <arpa/inet.h>
+#include "../HTTP/Epoll/epoll_http_engine.h"
+#include "loopback_http_server.h"
+
+using namespace xbox::httpclient;
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
+
+struct parsed_response : public http_response_parser_callbacks
+{
+    HRESULT OnResponseHeader(_In_reads_(nameSize) const char* name, _In_ size_t nameSize, _In_reads_(valueSize) const char* value, _In_ size_t valueSize) noexcept override
+    {
+        headers += std::string(name, nameSize) + "=" + std::string(value, valueSize) + ";";
+        return S_OK;
+    }
+
+    HRESULT OnResponseBody(_In_reads_bytes_(size) const uint8_t* data, _In_ size_t size) noexcept override
+    {
+        body.append(reinterpret_cast<const char*>(data), size);
+        return S_OK;
+    }
+
+    std::string headers;
+    std::string body;
+};
+
+// Feeds the response in slices of sliceSize bytes the way a connection would, keeping whatever the parser leaves
+static HRESULT ParseInSlices(std::string const& response, size_t sliceSize, bool headRequest, bool endOfStream, http_response_parser& parser, parsed_response& parsed)
+{
+    parser.Reset(headRequest);
+    std::string unconsumed;
+    for (size_t offset = 0; offset < response.size() && !parser.IsComplete(); offset += sliceSize)
+    {
+        unconsumed.append(response, offset, sliceSize);
+        size_t consumed = 0;
+        HRESULT hr = parser.Parse(reinterpret_cast<const uint8_t*>(unconsumed.data()), unconsumed.size(), parsed, &consumed);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+        unconsumed.erase(0, consumed);
+    }
+    if (endOfStream && !parser.IsComplete())
+    {
+        return parser.OnEndOfStream();
+    }
+    return parser.IsComplete() ? S_OK : E_PENDING;
+}
+
+static loopback_http_server::response EchoHandler(loopback_http_server::request const& request)
+{
+    loopback_http_server::response response;
+    if (request.path == "/slow")
+    {
+        response.delay = std::chrono::seconds(30);
+    }
+    else if (request.path == "/missing")
+    {
+        response.statusCode = 404;
+    }
+    else if (request.path == "/close")
+    {
+        response.closeConnection = true;
+    }
+
+    auto test = request.headers.find("x-test");
+    auto transferEncoding = request.headers.find("transfer-encoding");
+    response.headers.push_back({ "X-Method", request.method });
+    response.headers.push_back({ "X-Test", test != request.headers.end() ? test->second : "" });
+    response.headers.push_back({ "X-Chunked", transferEncoding != request.headers.end() ? "true" : "false" });
+    response.body = request.body;
+    return response;
+}
+
+static HRESULT CALLBACK SlicedBodyReadFunction(
+    _In_ HCCallHandle /*call*/,
+    _In_ size_t offset,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context,
+    _Out_writes_bytes_to_(bytesAvailable, *bytesWritten) uint8_t* destination,
+    _Out_ size_t* bytesWritten
+)
+{
+    auto body = static_cast<std::string*>(context);
+    *bytesWritten = std::min({ bytesAvailable, body->size() - offset, static_cast<size_t>(777) });
+    memcpy(destination, body->data() + offset, *bytesWritten);
+    return S_OK;
+}
+
+// Request and response body callbacks that pause the call at the given body offsets, leaving it to PerformPausing to
+// resume it
+struct pausing_body
+{
+    explicit pausing_body(std::vector<size_t> offsets) : pauseOffsets{ std::move(offsets) } {}
+
+    static HRESULT CALLBACK Read(
+        _In_ HCCallHandle /*call*/,
+        _In_ size_t offset,
+        _In_ size_t bytesAvailable,
+        _In_opt_ void* context,
+        _Out_writes_bytes_to_(bytesAvailable, *bytesWritten) uint8_t* destination,
+        _Out_ size_t* bytesWritten
+    )
+    {
+        auto body = static_cast<pausing_body*>(context);
+        ++body->calls;
+        if (body->nextPause < body->pauseOffsets.size() && offset >= body->pauseOffsets[body->nextPause])
+        {
+            ++body->nextPause;
+            body->paused = true;
+            return E_PENDING;
+        }
+        *bytesWritten = std::min({ bytesAvailable, body->source.size() - offset, static_cast<size_t>(777) });
+        memcpy(destination, body->source.data() + offset, *bytesWritten);
+        return S_OK;
+    }
+
+    static HRESULT CALLBACK Write(
+        _In_ HCCallHandle /*call*/,
+        _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+        _In_ size_t bytesAvailable,
+        _In_opt_ void* context
+    )
+    {
+        auto body = static_cast<pausing_body*>(context);
+        ++body->calls;
+        body->received.append(reinterpret_cast<const char*>(source), bytesAvailable);
+        if (body->nextPause < body->pauseOffsets.size() && body->received.size() >= body->pauseOffsets[body->nextPause])
+        {
+            ++body->nextPause;
+            body->paused = true;
+            return E_PENDING;
+        }
+        return S_OK;
+    }
+
+    std::string source;
+    std::string received;
+    std::vector<size_t> pauseOffsets;
+    size_t nextPause{ 0 };
+    std::atomic<uint32_t> calls{ 0 };
+    std::atomic<bool> paused{ false };
+};
+
+// Performs the call, checking that its body callbacks aren't invoked while it is paused before resuming it
+static void PerformPausing(HCCallHandle call, pausing_body& body)
+{
+    XAsyncBlock asyncBlock{};
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+    uint32_t pauses = 0;
+    while (XAsyncGetStatus(&asyncBlock, false) == E_PENDING)
+    {
+        if (body.paused)
+        {
+            uint32_t calls = body.calls;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            VERIFY_ARE_EQUAL(calls, static_cast<uint32_t>(body.calls));
+            ++pauses;
+            body.paused = false;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResumeBodyTransfer(call));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+    VERIFY_ARE_EQUAL(body.pauseOffsets.size(), static_cast<size_t>(pauses));
+}
+
+static HCCallHandle CreateCall(const char* method, std::string const& url)
+{
+    HCCallHandle call = nullptr;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, method, url.c_str()));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, false));
+    return call;
+}
+
+static std::string GetResponseHeader(HCCallHandle call, const char* name)
+{
+    const char* value = nullptr;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetHeader(call, name, &value));
+    return value != nullptr ? value : "";
+}
+
+static uint32_t Perform(HCCallHandle call)
+{
+    XAsyncBlock asyncBlock{};
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+    VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+    uint32_t statusCode = 0;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetStatusCode(call, &statusCode));
+    return statusCode;
+}
+
+// Preconnects the way HCHttpPreconnectAsync does and waits for it
+static HRESULT Preconnect(epoll_http_engine& engine, std::string const& url, uint32_t connectionCount)
+{
+    XAsyncBlock asyncBlock{};
+    VERIFY_ARE_EQUAL(S_OK, XAsyncBegin(&asyncBlock, nullptr, nullptr, __FUNCTION__, [](XAsyncOp op, const XAsyncProviderData*)
+    {
+        return op == XAsyncOp::DoWork ? E_PENDING : S_OK;
+    }));
+
+    HRESULT hr = engine.Preconnect(url.c_str(), connectionCount, &asyncBlock);
+    if (FAILED(hr))
+    {
+        XAsyncComplete(&asyncBlock, hr, 0);
+    }
+    return XAsyncGetStatus(&asyncBlock, true);
+}
+
+// Resolves every host to ::1 and 127.0.0.1, IPv6 first the way getaddrinfo sorts them
+static void DualStackLookup(_In_z_ const char* /*hostName*/, _In_opt_ void* /*context*/, _Inout_ dns_result& result, _Inout_ std::chrono::milliseconds& /*ttl*/)
+{
+    dns_address ipv6;
+    auto ipv6Address = reinterpret_cast<sockaddr_in6*>(&ipv6.address);
+    ipv6Address->sin6_family = AF_INET6;
+    ipv6Address->sin6_addr = in6addr_loopback;
+    ipv6.size = sizeof(sockaddr_in6);
+    result.addresses.push_back(ipv6);
+
+    dns_address ipv4;
+    auto ipv4Address = reinterpret_cast<sockaddr_in*>(&ipv4.address);
+    ipv4Address->sin_family = AF_INET;
+    ipv4Address->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ipv4.size = sizeof(sockaddr_in);
+    result.addresses.push_back(ipv4);
+}
+
+DEFINE_TEST_CLASS(EpollHttpTests)
+{
+public:
+    DEFINE_TEST_CLASS_PROPS(EpollHttpTests);
+
+    DEFINE_TEST_CASE(VerifyResponseParser)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyResponseParser);
+
+        struct test_response
+        {
+            std::string response;
+            bool headRequest;
+            bool endOfStream;
+            uint32_t statusCode;
+            std::string headers;
+            std::string body;
+            bool keepAlive;
+        };
+
+        const test_response responses[] =
+        {
+            { "HTTP/1.1 200 OK\r\nContent-Length: 5\r\nX-A:  spaced value \r\n\r\nhello", false, false, 200, "Content-Length=5;X-A=spaced value;", "hello", true },
+            { "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5;ext=1\r\nhello\r\nA\r\n0123456789\r\n0\r\nX-Trailer: t\r\n\r\n", false, false, 200, "Transfer-Encoding=chunked;", "hello0123456789", true },
+            { "HTTP/1.1 100 Continue\r\nX-Interim: 1\r\n\r\nHTTP/1.1 201 Created\r\nContent-Length: 2\r\n\r\nok", false, false, 201, "Content-Length=2;", "ok", true },
+            { "HTTP/1.1 200 OK\nConnection: close\n\nuntil close", false, true, 200, "Connection=close;", "until close", false },
+            { "HTTP/1.0 200 OK\r\nContent-Length: 0\r\n\r\n", false, false, 200, "Content-Length=0;", "", false },
+            { "HTTP/1.0 200 OK\r\nConnection: Keep-Alive\r\nContent-Length: 1\r\n\r\nx", false, false, 200, "Connection=Keep-Alive;Content-Length=1;", "x", true },
+            { "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\n", true, false, 200, "Content-Length=10;", "", true },
+            { "HTTP/1.1 204 No Content\r\n\r\n", false, false, 204, "", "", true },
+        };
+
+        for (auto const& expected : responses)
+        {
+            for (size_t sliceSize : { static_cast<size_t>(1), static_cast<size_t>(3), expected.response.size() })
+            {
+                http_response_parser parser;
+                parsed_response parsed;
+                VERIFY_ARE_EQUAL(S_OK, ParseInSlices(expected.response, sliceSize, expected.headRequest, expected.endOfStream, parser, parsed));
+                VERIFY_ARE_EQUAL(expected.statusCode, parser.StatusCode());
+                VERIFY_ARE_EQUAL_STR(expected.headers.c_str(), parsed.headers.c_str());
+                VERIFY_ARE_EQUAL_STR(expected.body.c_str(), parsed.body.c_str());
+                VERIFY_ARE_EQUAL(expected.keepAlive, parser.KeepAlive());
+            }
+        }
+
+        const char* malformed[] =
+        {
+            "HTTP/2 200 OK\r\n\r\n",
+            "HTTP/1.1 2x0 OK\r\n\r\n",
+            "HTTP/1.1 200 OK\r\nNoColon\r\n\r\n",
+            "HTTP/1.1 200 OK\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n",
+            "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n",
+            "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n1\r\nab\r\n",
+            "HTTP/1.1 101 Switching Protocols\r\n\r\n",
+        };
+        for (const char* response : malformed)
+        {
+            http_response_parser parser;
+            parsed_response parsed;
+            VERIFY_ARE_EQUAL(E_FAIL, ParseInSlices(response, 1, false, false, parser, parsed));
+        }
+
+        // A truncated body is an error once the connection closes
+        http_response_parser parser;
+        parsed_response parsed;
+        VERIFY_ARE_EQUAL(E_FAIL, ParseInSlices("HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nshort", 4, false, true, parser, parsed));
+
+        // Lines can't grow without bound
+        std::string longHeader = "HTTP/1.1 200 OK\r\nX-Long: " + std::string(http_response_parser::MAX_LINE_SIZE + 1, 'a');
+        VERIFY_ARE_EQUAL(E_FAIL, ParseInSlices(longHeader, 4096, false, false, parser, parsed));
+
+        // A body callback returning E_PENDING stops the parser after the bytes it took
+        struct pausing_response : public parsed_response
+        {
+            HRESULT OnResponseBody(_In_reads_bytes_(size) const uint8_t* data, _In_ size_t size) noexcept override
+            {
+                parsed_response::OnResponseBody(data, size);
+                return E_PENDING;
+            }
+        };
+        std::string chunked = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n3\r\nabc\r\n0\r\n\r\n";
+        pausing_response paused;
+        parser.Reset(false);
+        size_t consumed = 0;
+        VERIFY_ARE_EQUAL(E_PENDING, parser.Parse(reinterpret_cast<const uint8_t*>(chunked.data()), chunked.size(), paused, &consumed));
+        VERIFY_ARE_EQUAL(chunked.find("hello") + 5, consumed);
+        VERIFY_ARE_EQUAL_STR("hello", paused.body.c_str());
+        chunked.erase(0, consumed);
+        VERIFY_ARE_EQUAL(E_PENDING, parser.Parse(reinterpret_cast<const uint8_t*>(chunked.data()), chunked.size(), paused, &consumed));
+        VERIFY_ARE_EQUAL_STR("helloabc", paused.body.c_str());
+        chunked.erase(0, consumed);
+        VERIFY_ARE_EQUAL(S_OK, parser.Parse(reinterpret_cast<const uint8_t*>(chunked.data()), chunked.size(), paused, &consumed));
+        VERIFY_ARE_EQUAL(chunked.size(), consumed);
+        VERIFY_IS_TRUE(parser.IsComplete());
+    }
+
+    DEFINE_TEST_CASE(VerifyEpollRequests)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyEpollRequests);
+
+        loopback_http_server server{ EchoHandler };
+        epoll_http_engine engine;
+        VERIFY_ARE_EQUAL(S_OK, engine.Initialize(epoll_http_engine_settings{}));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&epoll_http_engine::PerformAsync, &engine));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        {
+            HCCallHandle call = CreateCall("GET", server.Url("/get?a=b"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(call, "X-Test", "header value", false));
+            VERIFY_ARE_EQUAL(200u, Perform(call));
+            VERIFY_ARE_EQUAL_STR("GET", GetResponseHeader(call, "X-Method").c_str());
+            VERIFY_ARE_EQUAL_STR("header value", GetResponseHeader(call, "X-Test").c_str());
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // Bodies of known and unknown size, larger than the engine's body buffer
+        std::string body;
+        for (uint32_t i = 0; body.size() < 100000; i++)
+        {
+            body += std::to_string(i) + ",";
+        }
+        for (bool knownSize : { true, false })
+        {
+            HCCallHandle call = CreateCall("POST", server.Url("/post"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyReadFunction(call, SlicedBodyReadFunction, knownSize ? body.size() : HC_UNKNOWN_REQUEST_BODY_SIZE, &body));
+            VERIFY_ARE_EQUAL(200u, Perform(call));
+
+            const char* response = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseString(call, &response));
+            VERIFY_IS_TRUE(body == response);
+            VERIFY_ARE_EQUAL_STR(knownSize ? "false" : "true", GetResponseHeader(call, "X-Chunked").c_str());
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        {
+            HCCallHandle call = CreateCall("DELETE", server.Url("/missing"));
+            VERIFY_ARE_EQUAL(404u, Perform(call));
+            VERIFY_ARE_EQUAL_STR("DELETE", GetResponseHeader(call, "X-Method").c_str());
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // Every call so far went over the same kept-alive connection
+        VERIFY_ARE_EQUAL(1u, server.ConnectionCount());
+
+        // The server closes this connection after responding. The next call goes out on a new one, whether or not
+        // the engine noticed the close before sending.
+        for (const char* path : { "/close", "/get" })
+        {
+            HCCallHandle call = CreateCall("GET", server.Url(path));
+            VERIFY_ARE_EQUAL(200u, Perform(call));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+        VERIFY_ARE_EQUAL(2u, server.ConnectionCount());
+
+        // Only http:// is supported
+        {
+            HCCallHandle call = CreateCall("GET", "https://127.0.0.1/");
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+            HRESULT networkError = S_OK;
+            uint32_t platformError = 0;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &networkError, &platformError));
+            VERIFY_ARE_EQUAL(E_NOTIMPL, networkError);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyEpollConnectionLimit)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyEpollConnectionLimit);
+
+        loopback_http_server server{ EchoHandler };
+        epoll_http_engine_settings settings;
+        settings.maxConnectionsPerHost = 4;
+        epoll_http_engine engine;
+        VERIFY_ARE_EQUAL(S_OK, engine.Initialize(settings));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&epoll_http_engine::PerformAsync, &engine));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        constexpr size_t callCount = 200;
+        std::vector<HCCallHandle> calls(callCount);
+        std::vector<XAsyncBlock> asyncBlocks(callCount);
+        for (size_t i = 0; i < callCount; i++)
+        {
+            calls[i] = CreateCall("GET", server.Url("/concurrent"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(calls[i], "X-Test", std::to_string(i).c_str(), false));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(calls[i], &asyncBlocks[i]));
+        }
+
+        for (size_t i = 0; i < callCount; i++)
+        {
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlocks[i], true));
+            VERIFY_ARE_EQUAL_STR(std::to_string(i).c_str(), GetResponseHeader(calls[i], "X-Test").c_str());
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(calls[i]));
+        }
+        VERIFY_ARE_EQUAL(static_cast<uint32_t>(callCount), server.RequestCount());
+        VERIFY_IS_TRUE(server.ConnectionCount() <= settings.maxConnectionsPerHost);
+
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyEpollCancelAndTimeout)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyEpollCancelAndTimeout);
+
+        loopback_http_server server{ EchoHandler };
+        epoll_http_engine engine;
+        VERIFY_ARE_EQUAL(S_OK, engine.Initialize(epoll_http_engine_settings{}));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&epoll_http_engine::PerformAsync, &engine));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        {
+            HCCallHandle call = CreateCall("GET", server.Url("/slow"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, true));
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            while (server.RequestCount() == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            XAsyncCancel(&asyncBlock);
+            VERIFY_ARE_EQUAL(E_ABORT, XAsyncGetStatus(&asyncBlock, true));
+            VERIFY_IS_TRUE(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+            VERIFY_ARE_EQUAL(1u, server.RequestCount());
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        {
+            HCCallHandle call = CreateCall("GET", server.Url("/slow"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetTimeout(call, 1));
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+
+            HRESULT networkError = S_OK;
+            uint32_t platformError = 0;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &networkError, &platformError));
+            VERIFY_ARE_EQUAL(E_FAIL, networkError);
+            VERIFY_ARE_EQUAL(static_cast<uint32_t>(ETIMEDOUT), platformError);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // Nothing listens on the server's port once it's gone
+        std::string url;
+        {
+            loopback_http_server closedServer{ EchoHandler };
+            url = closedServer.Url("/");
+        }
+        {
+            HCCallHandle call = CreateCall("GET", url);
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+
+            HRESULT networkError = S_OK;
+            uint32_t platformError = 0;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &networkError, &platformError));
+            VERIFY_ARE_EQUAL(E_FAIL, networkError);
+            VERIFY_ARE_EQUAL(static_cast<uint32_t>(ECONNREFUSED), platformError);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyEpollHappyEyeballs)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyEpollHappyEyeballs);
+
+        loopback_http_server server{ EchoHandler };
+        std::string url = server.Url("/close");
+        uint16_t port = static_cast<uint16_t>(std::stoul(url.substr(url.rfind(':') + 1)));
+        url.replace(url.find("127.0.0.1"), 9, "dualstack.test");
+
+        // IPv6 is blackholed: [::1] on the server's port only ever accepts one connection, which is never accepted,
+        // and drops the SYNs of every connection after it
+        int blackhole = socket(AF_INET6, SOCK_STREAM, 0);
+        int v6Only = 1;
+        setsockopt(blackhole, IPPROTO_IPV6, IPV6_V6ONLY, &v6Only, sizeof(v6Only));
+        sockaddr_in6 blackholeAddress{};
+        blackholeAddress.sin6_family = AF_INET6;
+        blackholeAddress.sin6_addr = in6addr_loopback;
+        blackholeAddress.sin6_port = htons(port);
+        VERIFY_ARE_EQUAL(0, bind(blackhole, reinterpret_cast<sockaddr*>(&blackholeAddress), sizeof(blackholeAddress)));
+        VERIFY_ARE_EQUAL(0, listen(blackhole, 0));
+        int backlog = socket(AF_INET6, SOCK_STREAM, 0);
+        VERIFY_ARE_EQUAL(0, connect(backlog, reinterpret_cast<sockaddr*>(&blackholeAddress), sizeof(blackholeAddress)));
+
+        dns_resolver_settings resolverSettings;
+        resolverSettings.lookup = DualStackLookup;
+        dns_resolver resolver;
+        VERIFY_ARE_EQUAL(S_OK, resolver.Initialize(resolverSettings));
+
+        constexpr auto attemptDelay = std::chrono::milliseconds(300);
+        epoll_http_engine_settings settings;
+        settings.resolver = &resolver;
+        settings.connectionAttemptDelay = attemptDelay;
+        epoll_http_engine engine;
+        VERIFY_ARE_EQUAL(S_OK, engine.Initialize(settings));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&epoll_http_engine::PerformAsync, &engine));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        // The first connection leads with IPv6 and falls back to IPv4 after the attempt delay rather than the OS
+        // connect timeout
+        HCCallHandle call = CreateCall("GET", url);
+        auto start = std::chrono::steady_clock::now();
+        VERIFY_ARE_EQUAL(200u, Perform(call));
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        VERIFY_IS_TRUE(elapsed >= attemptDelay);
+        VERIFY_IS_TRUE(elapsed < std::chrono::seconds(5));
+        HCHttpCallCloseHandle(call);
+
+        // IPv4 won the race to this host, so the next connection leads with it and doesn't wait
+        call = CreateCall("GET", url);
+        start = std::chrono::steady_clock::now();
+        VERIFY_ARE_EQUAL(200u, Perform(call));
+        VERIFY_IS_TRUE(std::chrono::steady_clock::now() - start < attemptDelay);
+        HCHttpCallCloseHandle(call);
+        VERIFY_ARE_EQUAL(2u, server.ConnectionCount());
+
+        // Refused attempts move on to the next address straight away, and the call fails once every address has
+        int closedPort = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in closedAddress{};
+        closedAddress.sin_family = AF_INET;
+        closedAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t closedAddressSize = sizeof(closedAddress);
+        VERIFY_ARE_EQUAL(0, bind(closedPort, reinterpret_cast<sockaddr*>(&closedAddress), sizeof(closedAddress)));
+        VERIFY_ARE_EQUAL(0, getsockname(closedPort, reinterpret_cast<sockaddr*>(&closedAddress), &closedAddressSize));
+        close(closedPort);
+
+        call = CreateCall("GET", "http://refused.test:" + std::to_string(ntohs(closedAddress.sin_port)) + "/");
+        start = std::chrono::steady_clock::now();
+        XAsyncBlock asyncBlock{};
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+        VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+        VERIFY_IS_TRUE(std::chrono::steady_clock::now() - start < attemptDelay);
+        HRESULT networkError = S_OK;
+        uint32_t platformError = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &networkError, &platformError));
+        VERIFY_ARE_EQUAL(E_FAIL, networkError);
+        VERIFY_ARE_EQUAL(static_cast<uint32_t>(ECONNREFUSED), platformError);
+        HCHttpCallCloseHandle(call);
+
+        HCCleanup();
+        close(backlog);
+        close(blackhole);
+    }
+
+    DEFINE_TEST_CASE(VerifyEpollPreconnect)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyEpollPreconnect);
+
+        loopback_http_server server{ EchoHandler };
+        epoll_http_engine_settings settings;
+        settings.maxConnectionsPerHost = 4;
+        settings.idleTimeout = std::chrono::milliseconds(500);
+        epoll_http_engine engine;
+        VERIFY_ARE_EQUAL(S_OK, engine.Initialize(settings));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&epoll_http_engine::PerformAsync, &engine));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        // Completes once the connections are open and pooled
+        VERIFY_ARE_EQUAL(S_OK, Preconnect(engine, server.Url("/"), 3));
+        HCHttpConnectionStats stats = engine.GetConnectionStats();
+        VERIFY_ARE_EQUAL(3ull, stats.openConnections);
+        VERIFY_ARE_EQUAL(3ull, stats.idleConnections);
+        VERIFY_ARE_EQUAL(3ull, stats.preconnectedConnections);
+
+        // Open connections count towards the ones asked for, and never more than the per host limit are opened
+        VERIFY_ARE_EQUAL(S_OK, Preconnect(engine, server.Url("/other"), 2));
+        VERIFY_ARE_EQUAL(S_OK, Preconnect(engine, server.Url("/"), 10));
+        stats = engine.GetConnectionStats();
+        VERIFY_ARE_EQUAL(4ull, stats.openConnections);
+        VERIFY_ARE_EQUAL(4ull, stats.preconnectedConnections);
+
+        // Calls pick up the pooled connections instead of opening their own
+        HCCallHandle call = CreateCall("GET", server.Url("/"));
+        VERIFY_ARE_EQUAL(200u, Perform(call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        VERIFY_ARE_EQUAL(1u, server.RequestCount());
+        stats = engine.GetConnectionStats();
+        VERIFY_ARE_EQUAL(4ull, stats.openConnections);
+        VERIFY_ARE_EQUAL(1ull, stats.preconnectedConnectionsUsed);
+
+        // Unused ones are closed at the idle timeout like any other idle connection
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (engine.GetConnectionStats().openConnections > 0 && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        stats = engine.GetConnectionStats();
+        VERIFY_ARE_EQUAL(0ull, stats.openConnections);
+        VERIFY_ARE_EQUAL(0ull, stats.idleConnections);
+        VERIFY_ARE_EQUAL(3ull, stats.preconnectedConnectionsExpired);
+        VERIFY_ARE_EQUAL(4u, server.ConnectionCount());
+
+        // Failures are reported
+        std::string url;
+        {
+            loopback_http_server closedServer{ EchoHandler };
+            url = closedServer.Url("/");
+        }
+        VERIFY_ARE_EQUAL(E_FAIL, Preconnect(engine, url, 1));
+        VERIFY_ARE_EQUAL(E_NOTIMPL, Preconnect(engine, "https://127.0.0.1/", 1));
+        VERIFY_ARE_EQUAL(0ull, engine.GetConnectionStats().openConnections);
+
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyEpollBodyBackPressure)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyEpollBodyBackPressure);
+
+        // Larger than the socket buffers on both ends, so the server is held back while the call is paused
+        std::string largeBody;
+        for (uint32_t i = 0; largeBody.size() < 16 * 1024 * 1024; i++)
+        {
+            largeBody += std::to_string(i) + ",";
+        }
+        loopback_http_server server{ [&largeBody](loopback_http_server::request const& request)
+        {
+            if (request.path == "/large")
+            {
+                loopback_http_server::response response;
+                response.body = largeBody;
+                return response;
+            }
+            return EchoHandler(request);
+        } };
+
+        epoll_http_engine engine;
+        VERIFY_ARE_EQUAL(S_OK, engine.Initialize(epoll_http_engine_settings{}));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&epoll_http_engine::PerformAsync, &engine));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        {
+            pausing_body body{ { 1, 4 * 1024 * 1024, 12 * 1024 * 1024 } };
+            HCCallHandle call = CreateCall("GET", server.Url("/large"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseSetResponseBodyWriteFunction(call, pausing_body::Write, &body));
+            PerformPausing(call, body);
+            VERIFY_IS_TRUE(largeBody == body.received);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // Request bodies of known and unknown size, paused before the first byte and partway through
+        for (bool knownSize : { true, false })
+        {
+            pausing_body body{ { 0, 50000 } };
+            body.source = largeBody.substr(0, 100000);
+            HCCallHandle call = CreateCall("POST", server.Url("/post"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyReadFunction(call, pausing_body::Read, knownSize ? body.source.size() : HC_UNKNOWN_REQUEST_BODY_SIZE, &body));
+            PerformPausing(call, body);
+
+            const char* response = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseString(call, &response));
+            VERIFY_IS_TRUE(body.source == response);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // Paused calls are still canceled
+        {
+            pausing_body body{ { 1 } };
+            HCCallHandle call = CreateCall("GET", server.Url("/large"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseSetResponseBodyWriteFunction(call, pausing_body::Write, &body));
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            while (!body.paused)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            XAsyncCancel(&asyncBlock);
+            VERIFY_ARE_EQUAL(E_ABORT, XAsyncGetStatus(&asyncBlock, true));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(MeasureEpollThroughput)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(MeasureEpollThroughput);
+
+        // 10k calls in flight at once against a loopback server. Results are only logged; this never fails on a
+        // slow machine.
+        constexpr size_t callCount = 10000;
+        loopback_http_server server{ [](loopback_http_server::request const&)
+        {
+            loopback_http_server::response response;
+            response.body = "{\"status\":\"ok\"}";
+            return response;
+        } };
+
+        epoll_http_engine engine;
+        VERIFY_ARE_EQUAL(S_OK, engine.Initialize(epoll_http_engine_settings{}));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&epoll_http_engine::PerformAsync, &engine));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(nullptr, false));
+
+        struct timed_call
+        {
+            XAsyncBlock asyncBlock{};
+            HCCallHandle call{ nullptr };
+            std::chrono::steady_clock::time_point start;
+            std::chrono::steady_clock::time_point end;
+            std::atomic<size_t>* remaining{ nullptr };
+        };
+
+        std::atomic<size_t> remaining{ callCount };
+        std::vector<timed_call> calls(callCount);
+        std::string url = server.Url("/bench");
+        for (auto& timedCall : calls)
+        {
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&timedCall.call));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(timedCall.call, "GET", url.c_str()));
+            timedCall.remaining = &remaining;
+            timedCall.asyncBlock.context = &timedCall;
+            timedCall.asyncBlock.callback = [](XAsyncBlock* asyncBlock)
+            {
+                auto timedCall = static_cast<timed_call*>(asyncBlock->context);
+                timedCall->end = std::chrono::steady_clock::now();
+                --*timedCall->remaining;
+            };
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (auto& timedCall : calls)
+        {
+            timedCall.start = std::chrono::steady_clock::now();
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(timedCall.call, &timedCall.asyncBlock));
+        }
+        while (remaining > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<double> latencies;
+        size_t succeeded = 0;
+        for (auto& timedCall : calls)
+        {
+            uint32_t statusCode = 0;
+            HCHttpCallResponseGetStatusCode(timedCall.call, &statusCode);
+            succeeded += statusCode == 200 ? 1 : 0;
+            latencies.push_back(std::chrono::duration<double, std::milli>(timedCall.end - timedCall.start).count());
+            HCHttpCallCloseHandle(timedCall.call);
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        LOG_COMMENT(L"%zu/%zu calls succeeded over %u connections: %.0f req/s, p50 %.1f ms, p99 %.1f ms", succeeded, callCount,
+            server.ConnectionCount(), callCount / elapsed, latencies[callCount / 2], latencies[callCount * 99 / 100]);
+        VERIFY_ARE_EQUAL(callCount, succeeded);
+
+        HCCleanup();
+    }
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
+#endif
@@ -5,12 +5,34 @@
 #include "UnitTestIncludes.h"
 #define TEST_CLASS_OWNER L"jasonsa"
 #include "DefineTestMacros.h"
-#include "Utils.h"
+#include "utils.h"
 #include "../Common/Win/utils_win.h"
+#include "../Global/routed_handlers.h"
 
 using namespace xbox::httpclient;
 static bool g_gotCall = false;
 
+struct blocking_handler_state
+{
+    std::atomic<bool> running{ false };
+    std::atomic<bool> release{ false };
+};
+
+static void BlockingHandler(int /*value*/, void* context)
+{
+    auto state = static_cast<blocking_handler_state*>(context);
+    state->running = true;
+    while (!state->release)
+    {
+        std::this_thread::yield();
+    }
+    state->running = false;
+}
+
+static void IgnoringHandler(int /*value*/, void* /*context*/)
+{
+}
+
 NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
 
 DEFINE_TEST_CLASS(GlobalTests)
@@ -26,11 +48,42 @@ public:
         HCGetLibVersion(&ver);
         VERIFY_ARE_EQUAL_STR("1.0.0.0", ver);
 
+#if HC_PLATFORM_IS_MICROSOFT
 #pragma warning(disable: 4800)
         http_internal_wstring utf16 = utf16_from_utf8("test");
         VERIFY_ARE_EQUAL_STR(L"test", utf16.c_str());
         http_internal_string utf8 = utf8_from_utf16(L"test");
         VERIFY_ARE_EQUAL_STR("test", utf8.c_str());
+#endif
+    }
+
+    DEFINE_TEST_CASE(TestRoutedHandlerRemoveWaits)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(TestRoutedHandlerRemoveWaits);
+
+        routed_handler_list<void(*)(int, void*)> handlers;
+        blocking_handler_state state;
+        VERIFY_IS_TRUE(handlers.add(1, BlockingHandler, &state));
+
+        std::thread notifier{ [&] { handlers.notify(7); } };
+        while (!state.running)
+        {
+            std::this_thread::yield();
+        }
+
+        // The running notification holds a snapshot older than the one remove replaces
+        VERIFY_IS_TRUE(handlers.add(2, IgnoringHandler, nullptr));
+        std::atomic<bool> removed{ false };
+        std::thread remover{ [&] { handlers.remove(1); removed = true; } };
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        bool removedWhileRunning = removed;
+
+        state.release = true;
+        remover.join();
+        bool runningAfterRemove = state.running;
+        notifier.join();
+        VERIFY_IS_FALSE(removedWhileRunning);
+        VERIFY_IS_FALSE(runningAfterRemove);
     }
 
 };
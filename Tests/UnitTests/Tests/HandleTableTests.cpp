@@ -0,0 +1,359 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "UnitTestIncludes.h"
+#define TEST_CLASS_OWNER L"jasonsa"
+#include "DefineTestMacros.h"
+#include "utils.h"
+#include "../Global/global.h"
+
+using namespace xbox::httpclient;
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
+
+static std::atomic<uint32_t> g_handleTableLiveAllocations{ 0 };
+
+static _Ret_maybenull_ _Post_writable_byte_size_(size) void* STDAPIVCALLTYPE HandleTableMemAlloc(
+    _In_ size_t size,
+    _In_ HCMemoryType /*memoryType*/
+    )
+{
+    ++g_handleTableLiveAllocations;
+    return malloc(size);
+}
+
+static void STDAPIVCALLTYPE HandleTableMemFree(
+    _In_ _Post_invalid_ void* pointer,
+    _In_ HCMemoryType /*memoryType*/
+    )
+{
+    --g_handleTableLiveAllocations;
+    free(pointer);
+}
+
+DEFINE_TEST_CLASS(HandleTableTests)
+{
+public:
+    DEFINE_TEST_CLASS_PROPS(HandleTableTests);
+
+    struct tracked_object
+    {
+        tracked_object(std::atomic<uint32_t>& destroyed, uint32_t value) : m_destroyed{ destroyed }, m_value{ value } {}
+        ~tracked_object() { ++m_destroyed; }
+
+        std::atomic<uint32_t>& m_destroyed;
+        uint32_t m_value;
+    };
+
+    DEFINE_TEST_CASE(VerifyBasicOps)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyBasicOps);
+
+        std::atomic<uint32_t> destroyed{ 0 };
+        handle_table table;
+
+        VERIFY_IS_NULL(table.fetch(nullptr));
+        VERIFY_IS_FALSE(table.remove(nullptr));
+
+        void* handle = table.store(std::make_shared<tracked_object>(destroyed, 7));
+        VERIFY_IS_NOT_NULL(handle);
+
+        auto fetched = std::static_pointer_cast<tracked_object>(table.fetch(handle));
+        VERIFY_IS_NOT_NULL(fetched);
+        VERIFY_ARE_EQUAL(7u, fetched->m_value);
+
+        VERIFY_IS_TRUE(table.remove(handle));
+        VERIFY_IS_FALSE(table.remove(handle));
+        VERIFY_IS_NULL(table.fetch(handle));
+
+        // The object outlives removal while a fetched reference is held
+        VERIFY_ARE_EQUAL(0u, destroyed.load());
+        fetched.reset();
+        VERIFY_ARE_EQUAL(1u, destroyed.load());
+
+        // A stale handle never resolves to an object later stored in the same slot
+        void* reused = table.store(std::make_shared<tracked_object>(destroyed, 8));
+        VERIFY_IS_NOT_NULL(reused);
+        VERIFY_ARE_NOT_EQUAL(handle, reused);
+        VERIFY_IS_NULL(table.fetch(handle));
+        VERIFY_IS_FALSE(table.remove(handle));
+        VERIFY_ARE_EQUAL(8u, std::static_pointer_cast<tracked_object>(table.fetch(reused))->m_value);
+
+        void* other = table.store(std::make_shared<tracked_object>(destroyed, 9));
+        table.clear();
+        VERIFY_IS_NULL(table.fetch(reused));
+        VERIFY_IS_NULL(table.fetch(other));
+        VERIFY_ARE_EQUAL(3u, destroyed.load());
+    }
+
+    DEFINE_TEST_CASE(VerifyReleaseKeepsGenerations)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyReleaseKeepsGenerations);
+
+        std::atomic<uint32_t> destroyed{ 0 };
+        handle_table table;
+
+        // A handle from before a release never resolves to an object stored after it, even in the same slot
+        void* handle = table.store(std::make_shared<tracked_object>(destroyed, 1));
+        VERIFY_IS_NOT_NULL(handle);
+        table.release();
+        VERIFY_ARE_EQUAL(1u, destroyed.load());
+
+        void* reused = table.store(std::make_shared<tracked_object>(destroyed, 2));
+        VERIFY_IS_NOT_NULL(reused);
+        VERIFY_ARE_NOT_EQUAL(handle, reused);
+        VERIFY_IS_NULL(table.fetch(handle));
+        VERIFY_IS_FALSE(table.remove(handle));
+        VERIFY_ARE_EQUAL(2u, std::static_pointer_cast<tracked_object>(table.fetch(reused))->m_value);
+
+        // Fetches and removes that race a release see the object or nothing
+        std::atomic<bool> stop{ false };
+        std::atomic<uint32_t> unexpected{ 0 };
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            threads.emplace_back([&]
+            {
+                while (!stop)
+                {
+                    auto fetched = std::static_pointer_cast<tracked_object>(table.fetch(reused));
+                    if (fetched && fetched->m_value != 2)
+                    {
+                        ++unexpected;
+                    }
+                    table.remove(handle);
+                }
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        table.release();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        stop = true;
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        VERIFY_ARE_EQUAL(0u, unexpected.load());
+        VERIFY_IS_NULL(table.fetch(reused));
+        VERIFY_ARE_EQUAL(2u, destroyed.load());
+    }
+
+    DEFINE_TEST_CASE(VerifyGenerationLimitRetiresSlots)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyGenerationLimitRetiresSlots);
+
+        std::atomic<uint32_t> destroyed{ 0 };
+        handle_table table{ 3 };
+
+        // Each slot serves generations 1 to 3, then is retired rather than wrapping back to generation 1
+        std::vector<void*> handles;
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            void* handle = table.store(std::make_shared<tracked_object>(destroyed, i));
+            VERIFY_IS_NOT_NULL(handle);
+            for (void* previous : handles)
+            {
+                VERIFY_ARE_NOT_EQUAL(previous, handle);
+            }
+            handles.push_back(handle);
+            VERIFY_IS_TRUE(table.remove(handle));
+        }
+        VERIFY_ARE_EQUAL(4u, destroyed.load());
+
+        // None of the stale handles resolve to the object stored after them
+        void* current = table.store(std::make_shared<tracked_object>(destroyed, 9));
+        VERIFY_IS_NOT_NULL(current);
+        for (void* handle : handles)
+        {
+            VERIFY_IS_NULL(table.fetch(handle));
+            VERIFY_IS_FALSE(table.remove(handle));
+        }
+        VERIFY_ARE_EQUAL(9u, std::static_pointer_cast<tracked_object>(table.fetch(current))->m_value);
+        table.clear();
+    }
+
+    DEFINE_TEST_CASE(VerifySharedPtrCache)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifySharedPtrCache);
+
+        auto value = std::make_shared<int>(42);
+        void* handle = shared_ptr_cache::store(value);
+        VERIFY_IS_NOT_NULL(handle);
+        VERIFY_ARE_NOT_EQUAL(static_cast<void*>(value.get()), handle);
+
+        auto fetched = shared_ptr_cache::fetch<int>(handle);
+        VERIFY_IS_NOT_NULL(fetched);
+        VERIFY_ARE_EQUAL(42, *fetched);
+
+        shared_ptr_cache::remove(handle);
+        VERIFY_IS_NULL(shared_ptr_cache::fetch<int>(handle));
+    }
+
+    DEFINE_TEST_CASE(VerifySharedPtrCacheCleanup)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifySharedPtrCacheCleanup);
+
+        // Start from an empty table so every segment comes from the hooks below
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+        HCCleanup();
+
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(&HandleTableMemAlloc, &HandleTableMemFree));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        void* handle = shared_ptr_cache::store(http_allocate_shared<int>(42));
+        VERIFY_IS_NOT_NULL(handle);
+        VERIFY_IS_TRUE(g_handleTableLiveAllocations.load() > 0);
+
+        // Cleanup frees everything the table took from the hooks, stored values included
+        HCCleanup();
+        VERIFY_ARE_EQUAL(0u, g_handleTableLiveAllocations.load());
+        VERIFY_IS_NULL(shared_ptr_cache::fetch<int>(handle));
+
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(nullptr, nullptr));
+    }
+
+    DEFINE_TEST_CASE(VerifySeveralThreads)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifySeveralThreads);
+
+        const uint32_t totalThreads = 16;
+        const uint32_t callsPerThread = 20000;
+
+        std::atomic<uint32_t> destroyed{ 0 };
+        std::atomic<uint32_t> failures{ 0 };
+        handle_table table;
+
+        // Every thread stores objects, fetches its own and its neighbour's most recent handle,
+        // and removes its own. Fetching a neighbour's handle races with the neighbour's remove.
+        std::unique_ptr<std::atomic<void*>[]> lastHandles(new std::atomic<void*>[totalThreads]);
+        for (uint32_t idx = 0; idx < totalThreads; idx++)
+        {
+            lastHandles[idx] = nullptr;
+        }
+
+        std::thread threads[totalThreads];
+        for (uint32_t threadIndex = 0; threadIndex < totalThreads; threadIndex++)
+        {
+            threads[threadIndex] = std::thread([&, threadIndex]
+            {
+                for (uint32_t call = 0; call < callsPerThread; call++)
+                {
+                    uint32_t value = threadIndex * callsPerThread + call;
+                    void* handle = table.store(std::make_shared<tracked_object>(destroyed, value));
+                    if (handle == nullptr)
+                    {
+                        ++failures;
+                        continue;
+                    }
+                    lastHandles[threadIndex] = handle;
+
+                    auto mine = std::static_pointer_cast<tracked_object>(table.fetch(handle));
+                    if (mine == nullptr || mine->m_value != value)
+                    {
+                        ++failures;
+                    }
+
+                    auto theirs = std::static_pointer_cast<tracked_object>(table.fetch(lastHandles[(threadIndex + 1) % totalThreads]));
+                    if (theirs != nullptr && theirs->m_value / callsPerThread != (threadIndex + 1) % totalThreads)
+                    {
+                        ++failures;
+                    }
+
+                    if (!table.remove(handle) || table.fetch(handle) != nullptr)
+                    {
+                        ++failures;
+                    }
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        VERIFY_ARE_EQUAL(0u, failures.load());
+        VERIFY_ARE_EQUAL(totalThreads * callsPerThread, destroyed.load());
+    }
+
+    DEFINE_TEST_CASE(MeasureContendedThroughput)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(MeasureContendedThroughput);
+
+        // Compares the handle table against the mutex guarded map shared_ptr_cache used to be built on.
+        // Timings are only logged; this never fails on a slow machine.
+        struct locked_map
+        {
+            void* store(std::shared_ptr<void> value)
+            {
+                std::lock_guard<std::mutex> lock{ m_lock };
+                void* handle = value.get();
+                m_map[handle] = std::move(value);
+                return handle;
+            }
+
+            std::shared_ptr<void> fetch(void* handle)
+            {
+                std::lock_guard<std::mutex> lock{ m_lock };
+                auto iter = m_map.find(handle);
+                return iter != m_map.end() ? iter->second : nullptr;
+            }
+
+            bool remove(void* handle)
+            {
+                std::lock_guard<std::mutex> lock{ m_lock };
+                return m_map.erase(handle) > 0;
+            }
+
+            std::mutex m_lock;
+            std::unordered_map<void*, std::shared_ptr<void>> m_map;
+        };
+
+        const uint32_t totalThreads = 8;
+        const uint32_t callsPerThread = 50000;
+        const uint32_t fetchesPerCall = 8;
+
+        auto measure = [&](auto& table)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            std::thread threads[totalThreads];
+            for (auto& thread : threads)
+            {
+                thread = std::thread([&]
+                {
+                    auto value = std::make_shared<int>(0);
+                    for (uint32_t call = 0; call < callsPerThread; call++)
+                    {
+                        void* handle = table.store(value);
+                        for (uint32_t fetch = 0; fetch < fetchesPerCall; fetch++)
+                        {
+                            table.fetch(handle);
+                        }
+                        table.remove(handle);
+                    }
+                });
+            }
+
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+
+            auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return totalThreads * callsPerThread * (fetchesPerCall + 2) / elapsed;
+        };
+
+        handle_table table;
+        locked_map baseline;
+        double tableOpsPerSecond = measure(table);
+        double baselineOpsPerSecond = measure(baseline);
+
+        LOG_COMMENT(L"handle_table: %.0f ops/sec", tableOpsPerSecond);
+        LOG_COMMENT(L"mutex + unordered_map: %.0f ops/sec", baselineOpsPerSecond);
+        VERIFY_IS_GREATER_THAN(tableOpsPerSecond, 0.0);
+    }
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
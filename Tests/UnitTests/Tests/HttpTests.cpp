@@ -5,8 +5,8 @@
 #include "UnitTestIncludes.h"
 #define TEST_CLASS_OWNER L"jasonsa"
 #include "DefineTestMacros.h"
-#include "Utils.h"
-#include "../global/global.h"
+#include "utils.h"
+#include "../Global/global.h"
 
 #pragma warning(disable:4389)
 
@@ -66,6 +66,43 @@ static void CALLBACK PerformCallback(
 }
 
 
+// Writes the response body in 1000 byte slices on the perform thread, the way a provider that can't pause does
+static void CALLBACK SlicedBodyPerformCallback(
+    _In_ HCCallHandle call,
+    _Inout_ XAsyncBlock* asyncBlock,
+    _In_opt_ void* /*ctx*/,
+    _In_opt_ HCPerformEnv /*env*/
+    )
+{
+    HCHttpCallResponseBodyWriteFunction writeFunction = nullptr;
+    void* context = nullptr;
+    HRESULT hr = HCHttpCallResponseGetResponseBodyWriteFunction(call, &writeFunction, &context);
+    uint8_t slice[1000]{};
+    for (uint32_t i = 0; i < 4 && SUCCEEDED(hr); i++)
+    {
+        hr = writeFunction(call, slice, sizeof(slice), context);
+    }
+    HCHttpCallResponseSetStatusCode(call, 200);
+    XAsyncComplete(asyncBlock, hr, 0);
+}
+
+struct pausing_sink
+{
+    std::atomic<uint32_t> writes{ 0 };
+    uint32_t pauseAt{ 0 };
+};
+
+static HRESULT CALLBACK PausingWriteFunction(
+    _In_ HCCallHandle /*call*/,
+    _In_reads_bytes_(bytesAvailable) const uint8_t* /*source*/,
+    _In_ size_t /*bytesAvailable*/,
+    _In_opt_ void* context
+    )
+{
+    auto sink = static_cast<pausing_sink*>(context);
+    return ++sink->writes == sink->pauseAt ? E_PENDING : S_OK;
+}
+
 DEFINE_TEST_CLASS(HttpTests)
 {
 public:
@@ -402,6 +439,63 @@ public:
         VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
         HCCleanup();
     }
+
+    DEFINE_TEST_CASE(TestBodyTransferPause)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(TestBodyTransferPause);
+
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&SlicedBodyPerformCallback, nullptr));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        // The perform thread is held in the paused write until the call is resumed
+        {
+            pausing_sink sink;
+            sink.pauseAt = 2;
+            HCCallHandle call = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "https://www.example.com"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseSetResponseBodyWriteFunction(call, PausingWriteFunction, &sink));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResumeBodyTransfer(call));
+
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            while (sink.writes < 2)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            VERIFY_ARE_EQUAL(2u, static_cast<uint32_t>(sink.writes));
+            VERIFY_ARE_EQUAL(E_PENDING, XAsyncGetStatus(&asyncBlock, false));
+
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResumeBodyTransfer(call));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+            VERIFY_ARE_EQUAL(4u, static_cast<uint32_t>(sink.writes));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // Canceling the call releases it with E_ABORT
+        {
+            pausing_sink sink;
+            sink.pauseAt = 1;
+            HCCallHandle call = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "https://www.example.com"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseSetResponseBodyWriteFunction(call, PausingWriteFunction, &sink));
+
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            while (sink.writes < 1)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            XAsyncCancel(&asyncBlock);
+            VERIFY_ARE_EQUAL(E_ABORT, XAsyncGetStatus(&asyncBlock, true));
+            VERIFY_ARE_EQUAL(1u, static_cast<uint32_t>(sink.writes));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        HCCleanup();
+    }
 };
 
 NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
@@ -0,0 +1,231 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "UnitTestIncludes.h"
+#define TEST_CLASS_OWNER L"jasonsa"
+#include "DefineTestMacros.h"
+#include "utils.h"
+#include "../HTTP/httpcall.h"
+#include <map>
+
+using namespace xbox::httpclient;
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
+
+// The type each live allocation was made as, and the allocations and mismatched frees seen for each type
+static std::mutex g_typedAllocationsLock;
+static std::map<void*, HCMemoryType> g_typedAllocations;
+static uint32_t g_typeAllocationCounts[HC_MEMORY_TYPE_COUNT]{};
+static uint32_t g_mismatchedFrees{ 0 };
+
+static _Ret_maybenull_ _Post_writable_byte_size_(size) void* STDAPIVCALLTYPE TypedMemAlloc(
+    _In_ size_t size,
+    _In_ HCMemoryType memoryType
+    )
+{
+    void* p = malloc(size);
+    std::lock_guard<std::mutex> lock{ g_typedAllocationsLock };
+    g_typedAllocations[p] = memoryType;
+    if (memoryType < HC_MEMORY_TYPE_COUNT)
+    {
+        ++g_typeAllocationCounts[memoryType];
+    }
+    return p;
+}
+
+static void STDAPIVCALLTYPE TypedMemFree(
+    _In_ _Post_invalid_ void* pointer,
+    _In_ HCMemoryType memoryType
+    )
+{
+    {
+        std::lock_guard<std::mutex> lock{ g_typedAllocationsLock };
+        auto it = g_typedAllocations.find(pointer);
+        if (it != g_typedAllocations.end())
+        {
+            if (it->second != memoryType)
+            {
+                ++g_mismatchedFrees;
+            }
+            g_typedAllocations.erase(it);
+        }
+    }
+    free(pointer);
+}
+
+static void CALLBACK AccountingPerformCallback(
+    _In_ HCCallHandle call,
+    _Inout_ XAsyncBlock* asyncBlock,
+    _In_opt_ void* /*ctx*/,
+    _In_opt_ HCPerformEnv /*env*/
+    )
+{
+    std::vector<uint8_t> body(16 * 1024, 'b');
+    HCHttpCallResponseSetStatusCode(call, 200);
+    HCHttpCallResponseSetHeader(call, "Content-Type", "application/octet-stream");
+    HCHttpCallResponseSetResponseBodyBytes(call, body.data(), body.size());
+    XAsyncComplete(asyncBlock, S_OK, 0);
+}
+
+static void PerformCall()
+{
+    std::string requestBody(8 * 1024, 'a');
+
+    HCCallHandle call = nullptr;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "PUT", "https://title.example.com/users/xuid(2814000000000000)/storage/save.bin"));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(call, "Authorization", "XBL3.0 x=1234567890;eyJhbGciOiJSUzI1NiIsInR5cCI6IkpXVCJ9", false));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyString(call, requestBody.c_str()));
+
+    XAsyncBlock asyncBlock{};
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+    VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+
+    const char* responseString = nullptr;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseString(call, &responseString));
+    VERIFY_ARE_EQUAL(16u * 1024, static_cast<uint32_t>(strlen(responseString)));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+}
+
+static HCMemoryUsage GetUsage(HCMemoryType memoryType)
+{
+    HCMemoryUsage usage{};
+    VERIFY_ARE_EQUAL(S_OK, HCMemGetUsage(memoryType, &usage));
+    return usage;
+}
+
+DEFINE_TEST_CLASS(MemoryAccountingTests)
+{
+public:
+    DEFINE_TEST_CLASS_PROPS(MemoryAccountingTests);
+
+    DEFINE_TEST_CASE(VerifyMemoryTypes)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyMemoryTypes);
+
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(&TypedMemAlloc, &TypedMemFree));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&AccountingPerformCallback, nullptr));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        uint32_t callAllocations = g_typeAllocationCounts[HC_MEMORY_TYPE_HTTP_CALL];
+        uint32_t bodyAllocations = g_typeAllocationCounts[HC_MEMORY_TYPE_HTTP_BODY];
+        PerformCall();
+
+        // The call and its bodies are allocated as their own types, and freed as the types they were allocated as
+        VERIFY_IS_TRUE(g_typeAllocationCounts[HC_MEMORY_TYPE_HTTP_CALL] > callAllocations);
+        VERIFY_IS_TRUE(g_typeAllocationCounts[HC_MEMORY_TYPE_HTTP_BODY] >= bodyAllocations + 3);
+        VERIFY_ARE_EQUAL(0u, g_mismatchedFrees);
+
+        HCCleanup();
+        VERIFY_ARE_EQUAL(0u, g_mismatchedFrees);
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(nullptr, nullptr));
+    }
+
+    DEFINE_TEST_CASE(VerifyMemoryAccounting)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyMemoryAccounting);
+
+        HCMemoryUsage usage{};
+        VERIFY_ARE_EQUAL(E_NOT_SUPPORTED, HCMemGetUsage(HC_MEMORY_TYPE_GENERAL, &usage));
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetAccountingEnabled(true));
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCMemGetUsage(HC_MEMORY_TYPE_COUNT, &usage));
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCMemGetUsage(HC_MEMORY_TYPE_GENERAL, nullptr));
+
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&AccountingPerformCallback, nullptr));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+        VERIFY_ARE_EQUAL(E_HC_ALREADY_INITIALISED, HCMemSetAccountingEnabled(false));
+
+        HCMemoryUsage callBefore = GetUsage(HC_MEMORY_TYPE_HTTP_CALL);
+        HCMemoryUsage bodyBefore = GetUsage(HC_MEMORY_TYPE_HTTP_BODY);
+        PerformCall();
+        HCMemoryUsage callAfter = GetUsage(HC_MEMORY_TYPE_HTTP_CALL);
+        HCMemoryUsage bodyAfter = GetUsage(HC_MEMORY_TYPE_HTTP_BODY);
+
+        // The request body, response body and response string were all live at once, and all freed with the call
+        VERIFY_IS_TRUE(bodyAfter.peakBytes >= 40u * 1024);
+        VERIFY_IS_TRUE(bodyAfter.totalBytes - bodyBefore.totalBytes >= 40u * 1024);
+        VERIFY_IS_TRUE(bodyAfter.totalAllocations > bodyBefore.totalAllocations);
+        VERIFY_ARE_EQUAL(bodyBefore.currentBytes, bodyAfter.currentBytes);
+
+        VERIFY_IS_TRUE(callAfter.totalBytes - callBefore.totalBytes >= sizeof(HC_CALL));
+        VERIFY_IS_TRUE(callAfter.peakBytes >= callAfter.currentBytes);
+        VERIFY_ARE_EQUAL(callBefore.currentBytes, callAfter.currentBytes);
+        LOG_COMMENT(L"call bytes: %llu, body bytes: %llu",
+            static_cast<unsigned long long>(callAfter.totalBytes - callBefore.totalBytes),
+            static_cast<unsigned long long>(bodyAfter.totalBytes - bodyBefore.totalBytes));
+
+        HCCleanup();
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetAccountingEnabled(false));
+    }
+
+    DEFINE_TEST_CASE(VerifyMemoryAccountingModeChange)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyMemoryAccountingModeChange);
+
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(&TypedMemAlloc, &TypedMemFree));
+
+        // An accounted allocation is freed through the header that records its size, so accounting can't be
+        // disabled while one is in use, even across HCCleanup()
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetAccountingEnabled(true));
+        void* live = http_memory::mem_alloc(100, HC_MEMORY_TYPE_GENERAL);
+        VERIFY_IS_NOT_NULL(live);
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+        HCCleanup();
+        VERIFY_ARE_EQUAL(E_HC_INTERNAL_STILLINUSE, HCMemSetAccountingEnabled(false));
+        VERIFY_ARE_EQUAL(100u, static_cast<uint32_t>(GetUsage(HC_MEMORY_TYPE_GENERAL).currentBytes));
+        http_memory::mem_free(live, HC_MEMORY_TYPE_GENERAL);
+        VERIFY_ARE_EQUAL(0u, static_cast<uint32_t>(GetUsage(HC_MEMORY_TYPE_GENERAL).currentBytes));
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetAccountingEnabled(false));
+
+        // Allocations without the header aren't tracked, so accounting is enabled once they have been freed
+        live = http_memory::mem_alloc(100, HC_MEMORY_TYPE_GENERAL);
+        VERIFY_IS_NOT_NULL(live);
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+        HCCleanup();
+        http_memory::mem_free(live, HC_MEMORY_TYPE_GENERAL);
+
+        // Slabs counted before accounting was last enabled aren't uncounted when they're freed
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetThreadCachingEnabled(true));
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetAccountingEnabled(true));
+        http_memory::mem_free(http_memory::mem_alloc(100, HC_MEMORY_TYPE_GENERAL), HC_MEMORY_TYPE_GENERAL);
+        VERIFY_IS_TRUE(GetUsage(HC_MEMORY_TYPE_THREAD_CACHE).currentBytes > 0);
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetAccountingEnabled(false));
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetAccountingEnabled(true));
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetThreadCachingEnabled(false));
+        VERIFY_ARE_EQUAL(0u, static_cast<uint32_t>(GetUsage(HC_MEMORY_TYPE_THREAD_CACHE).currentBytes));
+
+        VERIFY_ARE_EQUAL(0u, g_mismatchedFrees);
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetAccountingEnabled(false));
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(nullptr, nullptr));
+    }
+
+    DEFINE_TEST_CASE(VerifyMemoryAccountingWithThreadCaching)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyMemoryAccountingWithThreadCaching);
+
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(&TypedMemAlloc, &TypedMemFree));
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetThreadCachingEnabled(true));
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetAccountingEnabled(true));
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&AccountingPerformCallback, nullptr));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        HCMemoryUsage bodyBefore = GetUsage(HC_MEMORY_TYPE_HTTP_BODY);
+        PerformCall();
+        HCMemoryUsage bodyAfter = GetUsage(HC_MEMORY_TYPE_HTTP_BODY);
+
+        // Usage is still counted by type, while the slabs small allocations come from are counted apart
+        VERIFY_IS_TRUE(bodyAfter.totalBytes - bodyBefore.totalBytes >= 40u * 1024);
+        VERIFY_ARE_EQUAL(bodyBefore.currentBytes, bodyAfter.currentBytes);
+        VERIFY_IS_TRUE(GetUsage(HC_MEMORY_TYPE_THREAD_CACHE).currentBytes >= 16u * 1024);
+        VERIFY_IS_TRUE(g_typeAllocationCounts[HC_MEMORY_TYPE_THREAD_CACHE] > 0);
+
+        HCCleanup();
+        VERIFY_ARE_EQUAL(0u, g_mismatchedFrees);
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetAccountingEnabled(false));
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetThreadCachingEnabled(false));
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(nullptr, nullptr));
+    }
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
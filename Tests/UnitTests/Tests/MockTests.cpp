@@ -5,8 +5,9 @@
 #include "UnitTestIncludes.h"
 #define TEST_CLASS_OWNER L"jasonsa"
 #include "DefineTestMacros.h"
-#include "Utils.h"
-#include "../global/global.h"
+#include "utils.h"
+#include "../Global/global.h"
+#include "../Mock/lhc_mock.h"
 
 #pragma warning(disable:4389)
 
@@ -207,6 +208,7 @@ public:
             VERIFY_ARE_EQUAL(0, errCode);
             VERIFY_ARE_EQUAL(0, statusCode);
             VERIFY_ARE_EQUAL_STR("", responseStr);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
         }
 
         HCCleanup();
@@ -302,6 +304,579 @@ public:
         HCCleanup();
     }
 
+    DEFINE_TEST_CASE(ExampleSharedMockResponse)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(ExampleSharedMockResponse);
+
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        HCMockCallHandle mockCall = CreateMockCall("Mock1", false, false);
+        VERIFY_ARE_EQUAL(S_OK, HCMockAddMock(mockCall, nullptr, nullptr, nullptr, 0));
+
+        HCCallHandle call1 = nullptr;
+        HCCallHandle call2 = nullptr;
+        for (HCCallHandle* call : { &call1, &call2 })
+        {
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(call));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(*call, false));
+
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(*call, &asyncBlock));
+            VERIFY_SUCCEEDED(XAsyncGetStatus(&asyncBlock, true));
+        }
+
+        // Both calls reference the mock's body and headers rather than owning copies
+        VERIFY_IS_TRUE(call1->responseBodyBytes.is_shared());
+        VERIFY_IS_TRUE(call1->responseBodyBytes.get().data() == call2->responseBodyBytes.get().data());
+        VERIFY_IS_TRUE(&call1->responseHeaders.get() == &call2->responseHeaders.get());
+
+        // Mutating one call copies its response and leaves the mock and other calls untouched
+        uint8_t extra[] = { 'X' };
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseAppendResponseBodyBytes(call1, extra, sizeof(extra)));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseSetHeader(call1, "mockHeader", "callValue"));
+        VERIFY_IS_FALSE(call1->responseBodyBytes.is_shared());
+
+        PCSTR responseStr;
+        PCSTR headerValue;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseString(call1, &responseStr));
+        VERIFY_ARE_EQUAL_STR("Mock1X", responseStr);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetHeader(call1, "mockHeader", &headerValue));
+        VERIFY_ARE_EQUAL_STR("mockValue, callValue", headerValue);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseString(call2, &responseStr));
+        VERIFY_ARE_EQUAL_STR("Mock1", responseStr);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetHeader(call2, "mockHeader", &headerValue));
+        VERIFY_ARE_EQUAL_STR("mockValue", headerValue);
+
+        // Removing the mock doesn't invalidate responses still referencing it
+        VERIFY_ARE_EQUAL(S_OK, HCMockRemoveMock(mockCall));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseString(call2, &responseStr));
+        VERIFY_ARE_EQUAL_STR("Mock1", responseStr);
+
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call1));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call2));
+
+        HCCleanup();
+    }
+
+    static HRESULT CALLBACK FailingWriteFunction(
+        _In_ HCCallHandle /*call*/,
+        _In_reads_bytes_(bytesAvailable) const uint8_t* /*source*/,
+        _In_ size_t bytesAvailable,
+        _In_opt_ void* /*context*/
+    )
+    {
+        UNREFERENCED_PARAMETER(bytesAvailable);
+        return E_ABORT;
+    }
+
+    DEFINE_TEST_CASE(ExampleMockWriteFunctionFailure)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(ExampleMockWriteFunctionFailure);
+
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        HCMockCallHandle mockCall = CreateMockCall("Mock1", false, false);
+        VERIFY_ARE_EQUAL(S_OK, HCMockResponseSetNetworkErrorCode(mockCall, S_OK, 0));
+        VERIFY_ARE_EQUAL(S_OK, HCMockResponseSetStatusCode(mockCall, 200));
+        VERIFY_ARE_EQUAL(S_OK, HCMockAddMock(mockCall, nullptr, nullptr, nullptr, 0));
+
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, false));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseSetResponseBodyWriteFunction(call, FailingWriteFunction, nullptr));
+
+        XAsyncBlock asyncBlock{};
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+        VERIFY_SUCCEEDED(XAsyncGetStatus(&asyncBlock, true));
+
+        // The body that couldn't be written fails the call
+        HRESULT networkErrorCode = S_OK;
+        uint32_t platformNetworkErrorCode = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &networkErrorCode, &platformNetworkErrorCode));
+        VERIFY_ARE_EQUAL(E_ABORT, networkErrorCode);
+
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(ExampleResponseDecompression)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(ExampleResponseDecompression);
+
+        const char* expected = R"({"items":[{"id":0,"name":"item"},{"id":1,"name":"item"},{"id":2,"name":"item"},{"id":3,"name":"item"},{"id":4,"name":"item"},{"id":5,"name":"item"},{"id":6,"name":"item"},{"id":7,"name":"item"}]})";
+        const uint8_t gzipBody[] = {
+            0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xab, 0x56, 0xca, 0x2c, 0x49, 0xcd,
+            0x2d, 0x56, 0xb2, 0x8a, 0xae, 0x56, 0xca, 0x4c, 0x51, 0xb2, 0x32, 0xd0, 0x51, 0xca, 0x4b, 0xcc,
+            0x4d, 0x55, 0xb2, 0x02, 0x8b, 0x2b, 0xd5, 0xea, 0x40, 0x84, 0x0d, 0xb1, 0x0b, 0x1b, 0x61, 0x17,
+            0x36, 0xc6, 0x2e, 0x6c, 0x82, 0x5d, 0xd8, 0x14, 0xbb, 0xb0, 0x19, 0x76, 0x61, 0x73, 0x34, 0xe1,
+            0xd8, 0x5a, 0x00, 0xa1, 0x70, 0xfc, 0x06, 0xc3, 0x00, 0x00, 0x00,
+        };
+        const uint8_t deflateBody[] = {
+            0x78, 0xda, 0xab, 0x56, 0xca, 0x2c, 0x49, 0xcd, 0x2d, 0x56, 0xb2, 0x8a, 0xae, 0x56, 0xca, 0x4c,
+            0x51, 0xb2, 0x32, 0xd0, 0x51, 0xca, 0x4b, 0xcc, 0x4d, 0x55, 0xb2, 0x02, 0x8b, 0x2b, 0xd5, 0xea,
+            0x40, 0x84, 0x0d, 0xb1, 0x0b, 0x1b, 0x61, 0x17, 0x36, 0xc6, 0x2e, 0x6c, 0x82, 0x5d, 0xd8, 0x14,
+            0xbb, 0xb0, 0x19, 0x76, 0x61, 0x73, 0x34, 0xe1, 0xd8, 0x5a, 0x00, 0x9d, 0x82, 0x3b, 0x29,
+        };
+
+        struct response_case
+        {
+            const char* encoding;
+            const uint8_t* body;
+            uint32_t bodySize;
+            bool decompress;
+            HRESULT expectedError;
+        };
+
+        const response_case cases[] = {
+            { "gzip", gzipBody, sizeof(gzipBody), true, S_OK },
+            { " Deflate ", deflateBody, sizeof(deflateBody), true, S_OK },
+            { "gzip", gzipBody, sizeof(gzipBody), false, S_OK },
+            { "gzip", gzipBody, 40, true, E_HC_COMPRESSED_DATA_INVALID },
+        };
+
+        for (auto const& c : cases)
+        {
+            VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetResponseDecompression(nullptr, c.decompress));
+
+            HCMockCallHandle mockCall = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCMockCallCreate(&mockCall));
+            VERIFY_ARE_EQUAL(S_OK, HCMockResponseSetStatusCode(mockCall, 200));
+            VERIFY_ARE_EQUAL(S_OK, HCMockResponseSetResponseBodyBytes(mockCall, c.body, c.bodySize));
+            VERIFY_ARE_EQUAL(S_OK, HCMockResponseSetHeader(mockCall, "Content-Encoding", c.encoding));
+            VERIFY_ARE_EQUAL(S_OK, HCMockAddMock(mockCall, nullptr, nullptr, nullptr, 0));
+
+            HCCallHandle call = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, false));
+
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_SUCCEEDED(XAsyncGetStatus(&asyncBlock, true));
+
+            HRESULT errCode = S_OK;
+            uint32_t platErrCode = 0;
+            uint64_t compressedBytes = 0;
+            uint64_t decompressedBytes = 0;
+            PCSTR headerValue = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &errCode, &platErrCode));
+            VERIFY_ARE_EQUAL(c.expectedError, errCode);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetDecompressionStats(call, &compressedBytes, &decompressedBytes));
+            // Accept-Encoding is only added for the attempt
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetHeader(call, "Accept-Encoding", &headerValue));
+            VERIFY_IS_NULL(headerValue);
+
+            if (!c.decompress)
+            {
+                // The body and headers are left exactly as they were received
+                size_t bodySize = 0;
+                VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseBodyBytesSize(call, &bodySize));
+                VERIFY_ARE_EQUAL(c.bodySize, bodySize);
+                VERIFY_ARE_EQUAL(0u, compressedBytes);
+                VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetHeader(call, "Content-Encoding", &headerValue));
+                VERIFY_IS_NOT_NULL(headerValue);
+            }
+            else if (SUCCEEDED(c.expectedError))
+            {
+                PCSTR responseStr = nullptr;
+                VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseString(call, &responseStr));
+                VERIFY_ARE_EQUAL_STR(expected, responseStr);
+                VERIFY_ARE_EQUAL(c.bodySize, compressedBytes);
+                VERIFY_ARE_EQUAL(strlen(expected), decompressedBytes);
+                VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetHeader(call, "Content-Encoding", &headerValue));
+                VERIFY_IS_NULL(headerValue);
+            }
+
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+            HCCleanup();
+        }
+    }
+
+    DEFINE_TEST_CASE(ExampleCaptureReplay)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(ExampleCaptureReplay);
+
+        const char* captureFile = "MockTests_ExampleCaptureReplay.lhccap";
+        const char* urls[] = { "http://example.com/1", "http://example.com/2" };
+
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+        VERIFY_ARE_EQUAL(S_OK, HCMockStartCapture(captureFile, true));
+
+        HCMockCallHandle mockCall1 = CreateMockCall("Mock1", false, false);
+        HCMockCallHandle mockCall2 = CreateMockCall("Mock2", false, false);
+        VERIFY_ARE_EQUAL(S_OK, HCMockAddMock(mockCall1, "GET", urls[0], nullptr, 0));
+        VERIFY_ARE_EQUAL(S_OK, HCMockAddMock(mockCall2, "GET", urls[1], nullptr, 0));
+
+        for (const char* url : urls)
+        {
+            HCCallHandle call = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", url));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, false));
+
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_SUCCEEDED(XAsyncGetStatus(&asyncBlock, true));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        VERIFY_ARE_EQUAL(S_OK, HCMockStopCapture());
+        VERIFY_ARE_EQUAL(S_OK, HCMockClearMocks());
+
+        // Replay the captured responses in reverse order
+        VERIFY_ARE_EQUAL(S_OK, HCMockLoadCapture(captureFile, false));
+        for (int i = 1; i >= 0; --i)
+        {
+            HCCallHandle call = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", urls[i]));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, false));
+
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_SUCCEEDED(XAsyncGetStatus(&asyncBlock, true));
+
+            HRESULT errCode = S_OK;
+            uint32_t platErrCode = 0;
+            uint32_t statusCode = 0;
+            PCSTR responseStr;
+            PCSTR headerValue;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &errCode, &platErrCode));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetStatusCode(call, &statusCode));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseString(call, &responseStr));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetHeader(call, "mockHeader", &headerValue));
+            VERIFY_ARE_EQUAL(E_OUTOFMEMORY, errCode);
+            VERIFY_ARE_EQUAL(300, platErrCode);
+            VERIFY_ARE_EQUAL(400, statusCode);
+            VERIFY_ARE_EQUAL_STR(i == 0 ? "Mock1" : "Mock2", responseStr);
+            VERIFY_ARE_EQUAL_STR("mockValue", headerValue);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // Requests that weren't captured aren't matched
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "POST", urls[0]));
+        std::chrono::milliseconds latency{};
+        VERIFY_IS_FALSE(Mock_Internal_HCHttpCallPerformAsync(call, latency));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        HCCleanup();
+        std::remove(captureFile);
+    }
+
+    static HRESULT CALLBACK StringReadFunction(
+        _In_ HCCallHandle /*call*/,
+        _In_ size_t offset,
+        _In_ size_t bytesAvailable,
+        _In_opt_ void* context,
+        _Out_writes_bytes_to_(bytesAvailable, *bytesWritten) uint8_t* destination,
+        _Out_ size_t* bytesWritten
+    )
+    {
+        auto body = static_cast<const char*>(context);
+        size_t length = strlen(body);
+        *bytesWritten = offset < length ? std::min(bytesAvailable, length - offset) : 0;
+        memcpy(destination, body + offset, *bytesWritten);
+        return S_OK;
+    }
+
+    static std::string PerformCapturedUpload(const char* url, const char* body, bool streamed)
+    {
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "POST", url));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, false));
+        if (streamed)
+        {
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyReadFunction(call, StringReadFunction, strlen(body), const_cast<char*>(body)));
+        }
+        else
+        {
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyString(call, body));
+        }
+
+        XAsyncBlock asyncBlock{};
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+        VERIFY_SUCCEEDED(XAsyncGetStatus(&asyncBlock, true));
+        PCSTR responseStr = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseString(call, &responseStr));
+        std::string response{ responseStr };
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        return response;
+    }
+
+    DEFINE_TEST_CASE(ExampleCaptureStreamedRequestBody)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(ExampleCaptureStreamedRequestBody);
+
+        const char* captureFile = "MockTests_ExampleCaptureStreamedRequestBody.lhccap";
+        const char* url = "http://example.com/upload";
+
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+        VERIFY_ARE_EQUAL(S_OK, HCMockStartCapture(captureFile, true));
+
+        // The most recently added mock wins, so each upload gets its own response
+        HCMockCallHandle mockCall1 = CreateMockCall("Mock1", false, false);
+        VERIFY_ARE_EQUAL(S_OK, HCMockAddMock(mockCall1, "POST", url, nullptr, 0));
+        VERIFY_ARE_EQUAL_STR("Mock1", PerformCapturedUpload(url, "streamed upload", true).c_str());
+        HCMockCallHandle mockCall2 = CreateMockCall("Mock2", false, false);
+        VERIFY_ARE_EQUAL(S_OK, HCMockAddMock(mockCall2, "POST", url, nullptr, 0));
+        VERIFY_ARE_EQUAL_STR("Mock2", PerformCapturedUpload(url, "payload", false).c_str());
+
+        VERIFY_ARE_EQUAL(S_OK, HCMockStopCapture());
+        VERIFY_ARE_EQUAL(S_OK, HCMockClearMocks());
+        VERIFY_ARE_EQUAL(S_OK, HCMockLoadCapture(captureFile, false));
+
+        // A body the call holds is matched exactly, while a streamed one, whose content was never seen, falls back to
+        // the responses recorded for its URL
+        VERIFY_ARE_EQUAL_STR("Mock2", PerformCapturedUpload(url, "payload", false).c_str());
+        VERIFY_ARE_EQUAL_STR("Mock1", PerformCapturedUpload(url, "payload", true).c_str());
+
+        HCCleanup();
+        std::remove(captureFile);
+    }
+
+    static HRESULT CALLBACK CountingWriteFunction(
+        _In_ HCCallHandle call,
+        _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+        _In_ size_t bytesAvailable,
+        _In_opt_ void* context
+    )
+    {
+        UNREFERENCED_PARAMETER(call);
+        UNREFERENCED_PARAMETER(source);
+        auto writes = static_cast<std::vector<size_t>*>(context);
+        writes->push_back(bytesAvailable);
+        return S_OK;
+    }
+
+    DEFINE_TEST_CASE(ExampleNetworkEmulation)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(ExampleNetworkEmulation);
+
+        HCCallPerformFunction defaultPerform = nullptr;
+        void* defaultPerformContext = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCGetHttpCallPerformFunction(&defaultPerform, &defaultPerformContext));
+        VERIFY_ARE_EQUAL(S_OK, HCMockEnableNetworkEmulation());
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+        VERIFY_ARE_EQUAL(E_HC_ALREADY_INITIALISED, HCMockEnableNetworkEmulation());
+
+        std::string body(1000, 'x');
+        HCMockCallHandle mockCall;
+        VERIFY_ARE_EQUAL(S_OK, HCMockCallCreate(&mockCall));
+        VERIFY_ARE_EQUAL(S_OK, HCMockResponseSetStatusCode(mockCall, 200));
+        VERIFY_ARE_EQUAL(S_OK, HCMockResponseSetResponseBodyBytes(mockCall, (uint8_t*)&body[0], (uint32_t)body.length()));
+        VERIFY_ARE_EQUAL(S_OK, HCMockAddMock(mockCall, nullptr, nullptr, nullptr, 0));
+
+        // 50ms latency followed by 1000 bytes delivered in 250 byte chunks at 10000 bytes/sec
+        HCMockNetworkProfile profile{};
+        profile.latencyDistribution = HCMockLatencyDistribution::Constant;
+        profile.latencyMs = 50;
+        profile.bandwidthBytesPerSecond = 10000;
+        profile.chunkSizeBytes = 250;
+        VERIFY_ARE_EQUAL(S_OK, HCMockSetNetworkProfile("Example.com", &profile));
+
+        auto performCall = [](const char* url, std::vector<size_t>& writes, uint32_t timeoutInSeconds)
+        {
+            HCCallHandle call = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", url));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, false));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetTimeout(call, timeoutInSeconds));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseSetResponseBodyWriteFunction(call, CountingWriteFunction, &writes));
+
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_SUCCEEDED(XAsyncGetStatus(&asyncBlock, true));
+            return call;
+        };
+
+        std::vector<size_t> writes;
+        auto start = std::chrono::steady_clock::now();
+        HCCallHandle call = performCall("http://example.com/emulated", writes, 30);
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+        uint32_t statusCode = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetStatusCode(call, &statusCode));
+        VERIFY_ARE_EQUAL(200, statusCode);
+        VERIFY_ARE_EQUAL(4u, writes.size());
+        VERIFY_ARE_EQUAL(250u, writes[0]);
+        VERIFY_IS_TRUE(elapsed.count() >= 150);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        // Hosts without a profile use the default profile, which emulates nothing
+        writes.clear();
+        call = performCall("http://other.example.com/", writes, 30);
+        VERIFY_ARE_EQUAL(1u, writes.size());
+        VERIFY_ARE_EQUAL(1000u, writes[0]);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        // A reset connection delivers part of the body and fails the call
+        profile = HCMockNetworkProfile{};
+        profile.chunkSizeBytes = 1;
+        profile.resetProbability = 1;
+        VERIFY_ARE_EQUAL(S_OK, HCMockSetNetworkProfile("example.com", &profile));
+
+        HRESULT errCode = S_OK;
+        uint32_t platErrCode = 0;
+        writes.clear();
+        call = performCall("http://example.com/reset", writes, 30);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &errCode, &platErrCode));
+        VERIFY_ARE_EQUAL(E_FAIL, errCode);
+        VERIFY_IS_TRUE(writes.size() < body.size());
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        // A lost response times out
+        profile = HCMockNetworkProfile{};
+        profile.lossProbability = 1;
+        VERIFY_ARE_EQUAL(S_OK, HCMockSetNetworkProfile("example.com", &profile));
+
+        writes.clear();
+        call = performCall("http://example.com/lost", writes, 1);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &errCode, &platErrCode));
+        VERIFY_ARE_EQUAL(E_FAIL, errCode);
+        VERIFY_IS_TRUE(writes.empty());
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        profile.lossProbability = 2;
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCMockSetNetworkProfile(nullptr, &profile));
+
+        HCCleanup();
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(defaultPerform, defaultPerformContext));
+    }
+
+    static void CALLBACK ForwardedPerform(
+        _In_ HCCallHandle call,
+        _Inout_ XAsyncBlock* asyncBlock,
+        _In_opt_ void* context,
+        _In_ HCPerformEnv /*env*/
+    )
+    {
+        ++*static_cast<std::atomic<uint32_t>*>(context);
+        HCHttpCallResponseSetStatusCode(call, 204);
+        XAsyncComplete(asyncBlock, S_OK, 0);
+    }
+
+    DEFINE_TEST_CASE(VerifyNetworkEmulationForwardsAndCancels)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyNetworkEmulationForwardsAndCancels);
+
+        HCCallPerformFunction defaultPerform = nullptr;
+        void* defaultPerformContext = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCGetHttpCallPerformFunction(&defaultPerform, &defaultPerformContext));
+
+        std::atomic<uint32_t> forwarded{ 0 };
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(ForwardedPerform, &forwarded));
+        VERIFY_ARE_EQUAL(S_OK, HCMockEnableNetworkEmulation());
+        VERIFY_ARE_EQUAL(S_OK, HCMockEnableNetworkEmulation());
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        HCMockNetworkProfile profile{};
+        profile.latencyDistribution = HCMockLatencyDistribution::Constant;
+        profile.latencyMs = 20;
+        VERIFY_ARE_EQUAL(S_OK, HCMockSetNetworkProfile(nullptr, &profile));
+
+        // Calls no mock matches go to the perform function the emulator replaced, with its context
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "http://example.com/unmatched"));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, false));
+        XAsyncBlock asyncBlock{};
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+        VERIFY_SUCCEEDED(XAsyncGetStatus(&asyncBlock, true));
+        uint32_t statusCode = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetStatusCode(call, &statusCode));
+        VERIFY_ARE_EQUAL(204u, statusCode);
+        VERIFY_ARE_EQUAL(1u, forwarded.load());
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        // Canceling a call waiting out its emulated latency completes it right away
+        profile.latencyMs = 60 * 1000;
+        VERIFY_ARE_EQUAL(S_OK, HCMockSetNetworkProfile(nullptr, &profile));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "http://example.com/slow"));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, false));
+        asyncBlock = XAsyncBlock{};
+        auto start = std::chrono::steady_clock::now();
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        XAsyncCancel(&asyncBlock);
+        VERIFY_ARE_EQUAL(E_ABORT, XAsyncGetStatus(&asyncBlock, true));
+        VERIFY_IS_TRUE(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+        VERIFY_ARE_EQUAL(1u, forwarded.load());
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        HCCleanup();
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(defaultPerform, defaultPerformContext));
+    }
+
+    static void STDAPIVCALLTYPE CountingRoutedHandler(
+        _In_ HCCallHandle call,
+        _In_opt_ void* context
+        )
+    {
+        VERIFY_IS_NOT_NULL(call);
+        ++*static_cast<std::atomic<uint32_t>*>(context);
+    }
+
+    DEFINE_TEST_CASE(ExampleRoutedHandlers)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(ExampleRoutedHandlers);
+
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+        HCMockCallHandle mockCall = CreateMockCall("Mock", false, false);
+        VERIFY_ARE_EQUAL(S_OK, HCMockAddMock(mockCall, nullptr, nullptr, nullptr, 0));
+
+        auto performCall = []
+        {
+            HCCallHandle call = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "http://example.com"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, false));
+
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_SUCCEEDED(XAsyncGetStatus(&asyncBlock, true));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        };
+
+        // Handlers are invoked synchronously by default
+        std::atomic<uint32_t> routedCount{ 0 };
+        int32_t handlerId = HCAddCallRoutedHandler(CountingRoutedHandler, &routedCount);
+        VERIFY_IS_TRUE(handlerId >= 0);
+        performCall();
+        VERIFY_ARE_EQUAL(1u, routedCount.load());
+
+        // With a queue set, notifications are delivered there in a batch
+        XTaskQueueHandle queue = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, XTaskQueueCreate(XTaskQueueDispatchMode::Manual, XTaskQueueDispatchMode::Manual, &queue));
+        VERIFY_ARE_EQUAL(S_OK, HCSetRoutedHandlerQueue(queue));
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            performCall();
+        }
+        VERIFY_ARE_EQUAL(1u, routedCount.load());
+        VERIFY_IS_TRUE(XTaskQueueDispatch(queue, XTaskQueuePort::Work, 0));
+        VERIFY_ARE_EQUAL(4u, routedCount.load());
+        while (XTaskQueueDispatch(queue, XTaskQueuePort::Completion, 0)) {}
+
+        // Notifications still pending when the queue is cleared are delivered right away
+        performCall();
+        VERIFY_ARE_EQUAL(4u, routedCount.load());
+        VERIFY_ARE_EQUAL(S_OK, HCSetRoutedHandlerQueue(nullptr));
+        VERIFY_ARE_EQUAL(5u, routedCount.load());
+
+        // A removed handler isn't invoked
+        HCRemoveCallRoutedHandler(handlerId);
+        performCall();
+        VERIFY_ARE_EQUAL(5u, routedCount.load());
+
+        while (XTaskQueueDispatch(queue, XTaskQueuePort::Work, 0) || XTaskQueueDispatch(queue, XTaskQueuePort::Completion, 0)) {}
+        XTaskQueueCloseHandle(queue);
+        HCCleanup();
+    }
+
 };
 
 NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
@@ -0,0 +1,329 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "UnitTestIncludes.h"
+#define TEST_CLASS_OWNER L"jasonsa"
+#include "DefineTestMacros.h"
+#include "utils.h"
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
+
+static const char* MULTIPART_TEST_FILE = "multipart_body_test.txt";
+
+static void WriteTestFile(_In_ const std::string& content)
+{
+    FILE* file = nullptr;
+#if HC_PLATFORM_IS_MICROSOFT
+    fopen_s(&file, MULTIPART_TEST_FILE, "wb");
+#else
+    file = fopen(MULTIPART_TEST_FILE, "wb");
+#endif
+    VERIFY_IS_NOT_NULL(file);
+    fwrite(content.data(), 1, content.size(), file);
+    fclose(file);
+}
+
+// Reads the call's whole request body bytesPerRead bytes at a time, the way a provider does
+static HRESULT ReadRequestBody(_In_ HCCallHandle call, _In_ size_t bytesPerRead, _Out_ std::string& body)
+{
+    HCHttpCallRequestBodyReadFunction readFunction = nullptr;
+    size_t bodySize = 0;
+    void* context = nullptr;
+    RETURN_IF_FAILED(HCHttpCallRequestGetRequestBodyReadFunction(call, &readFunction, &bodySize, &context));
+
+    body.clear();
+    std::vector<uint8_t> buffer(bytesPerRead);
+    while (body.size() < bodySize)
+    {
+        size_t bytesWritten = 0;
+        HRESULT hr = readFunction(call, body.size(), std::min(bytesPerRead, bodySize - body.size()), context, buffer.data(), &bytesWritten);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+        if (bytesWritten == 0)
+        {
+            break;
+        }
+        body.append(reinterpret_cast<const char*>(buffer.data()), bytesWritten);
+    }
+    return bodySize == HC_UNKNOWN_REQUEST_BODY_SIZE || body.size() == bodySize ? S_OK : E_FAIL;
+}
+
+static std::string Boundary(_In_ HCCallHandle call)
+{
+    const char* contentType = nullptr;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetHeader(call, "Content-Type", &contentType));
+    VERIFY_IS_NOT_NULL(contentType);
+    std::string value{ contentType };
+    std::string prefix{ "multipart/form-data; boundary=" };
+    VERIFY_ARE_EQUAL(0u, static_cast<uint32_t>(value.find(prefix)));
+    return value.substr(prefix.size());
+}
+
+// A part that counts up through its bytes, a few at a time, after asking to be called back a number of times
+struct counting_part
+{
+    size_t size;
+    uint32_t pends;
+};
+
+static HRESULT CALLBACK CountingReadFunction(
+    _In_ HCCallHandle /*call*/,
+    _In_ size_t offset,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context,
+    _Out_writes_bytes_to_(bytesAvailable, *bytesWritten) uint8_t* destination,
+    _Out_ size_t* bytesWritten
+    ) noexcept
+{
+    auto part = static_cast<counting_part*>(context);
+    *bytesWritten = 0;
+    if (part->pends > 0)
+    {
+        part->pends--;
+        return E_PENDING;
+    }
+
+    size_t count = std::min<size_t>({ bytesAvailable, part->size - offset, 3 });
+    for (size_t i = 0; i < count; i++)
+    {
+        destination[i] = static_cast<uint8_t>('a' + (offset + i) % 26);
+    }
+    *bytesWritten = count;
+    return S_OK;
+}
+
+static std::string Counting(_In_ size_t size)
+{
+    std::string s;
+    for (size_t i = 0; i < size; i++)
+    {
+        s += static_cast<char>('a' + i % 26);
+    }
+    return s;
+}
+
+struct upload_server
+{
+    std::string contentType;
+    std::string body;
+};
+static upload_server g_uploadServer;
+
+static void CALLBACK UploadPerformCallback(
+    _In_ HCCallHandle call,
+    _Inout_ XAsyncBlock* asyncBlock,
+    _In_opt_ void* ctx,
+    _In_opt_ HCPerformEnv /*env*/
+    )
+{
+    auto& server = *static_cast<upload_server*>(ctx);
+    const char* contentType = nullptr;
+    HCHttpCallRequestGetHeader(call, "Content-Type", &contentType);
+    server.contentType = contentType != nullptr ? contentType : "";
+
+    HRESULT hr = ReadRequestBody(call, 100, server.body);
+    HCHttpCallResponseSetStatusCode(call, 200);
+    HCHttpCallResponseSetNetworkErrorCode(call, hr, 0);
+    XAsyncComplete(asyncBlock, S_OK, 0);
+}
+
+DEFINE_TEST_CLASS(MultipartBodyTests)
+{
+public:
+    DEFINE_TEST_CLASS_PROPS(MultipartBodyTests);
+
+    DEFINE_TEST_CASE(VerifyMultipartBody)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyMultipartBody);
+
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+        WriteTestFile("file contents\r\n");
+
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "POST", "https://example.com/upload"));
+
+        std::string value{ "value" };
+        std::string blob{ "\x01\x02\0\x03", 4 };
+        counting_part part{ 30, 0 };
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAddMultipartBytes(call, "field", nullptr, nullptr, reinterpret_cast<const uint8_t*>(value.data()), value.size()));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAddMultipartBorrowedBytes(call, "blob", "a.bin", "application/octet-stream", reinterpret_cast<const uint8_t*>(blob.data()), blob.size()));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAddMultipartFile(call, "upload", nullptr, "text/plain", MULTIPART_TEST_FILE));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAddMultipartReadFunction(call, "quote\"d\r\n", "x\".txt", nullptr, CountingReadFunction, part.size, &part));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAddMultipartBytes(call, "empty", nullptr, nullptr, nullptr, 0));
+
+        std::string boundary = Boundary(call);
+        VERIFY_ARE_EQUAL(57u, static_cast<uint32_t>(boundary.size()));
+        std::string expected =
+            "--" + boundary + "\r\n"
+            "Content-Disposition: form-data; name=\"field\"\r\n"
+            "\r\n"
+            "value\r\n"
+            "--" + boundary + "\r\n"
+            "Content-Disposition: form-data; name=\"blob\"; filename=\"a.bin\"\r\n"
+            "Content-Type: application/octet-stream\r\n"
+            "\r\n" + blob + "\r\n"
+            "--" + boundary + "\r\n"
+            "Content-Disposition: form-data; name=\"upload\"; filename=\"" + MULTIPART_TEST_FILE + "\"\r\n"
+            "Content-Type: text/plain\r\n"
+            "\r\n"
+            "file contents\r\n\r\n"
+            "--" + boundary + "\r\n"
+            "Content-Disposition: form-data; name=\"quote%22d%0D%0A\"; filename=\"x%22.txt\"\r\n"
+            "\r\n" + Counting(part.size) + "\r\n"
+            "--" + boundary + "\r\n"
+            "Content-Disposition: form-data; name=\"empty\"\r\n"
+            "\r\n"
+            "\r\n"
+            "--" + boundary + "--\r\n";
+
+        // Every part's size is known, so the body is sent with a Content-Length
+        HCHttpCallRequestBodyReadFunction readFunction = nullptr;
+        size_t bodySize = 0;
+        void* context = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetRequestBodyReadFunction(call, &readFunction, &bodySize, &context));
+        VERIFY_ARE_EQUAL(expected.size(), bodySize);
+
+        for (size_t bytesPerRead = 1; bytesPerRead <= expected.size(); bytesPerRead += (bytesPerRead < 64 ? 1 : 97))
+        {
+            std::string body;
+            VERIFY_ARE_EQUAL(S_OK, ReadRequestBody(call, bytesPerRead, body));
+            VERIFY_IS_TRUE(body == expected);
+        }
+
+        // A read may go back, e.g. when a request is sent again
+        uint8_t buffer[40]{};
+        size_t bytesWritten = 0;
+        size_t offset = expected.find("file contents") + 5;
+        VERIFY_ARE_EQUAL(S_OK, readFunction(call, offset, sizeof(buffer), context, buffer, &bytesWritten));
+        VERIFY_ARE_EQUAL(sizeof(buffer), bytesWritten);
+        VERIFY_IS_TRUE(expected.compare(offset, sizeof(buffer), reinterpret_cast<const char*>(buffer), sizeof(buffer)) == 0);
+        VERIFY_ARE_EQUAL(S_OK, readFunction(call, 3, sizeof(buffer), context, buffer, &bytesWritten));
+        VERIFY_IS_TRUE(expected.compare(3, sizeof(buffer), reinterpret_cast<const char*>(buffer), sizeof(buffer)) == 0);
+
+        // A file that shrank since it was added fails the read
+        WriteTestFile("file");
+        std::string body;
+        VERIFY_ARE_EQUAL(E_FAIL, ReadRequestBody(call, 64, body));
+
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCHttpCallRequestAddMultipartBytes(call, "bad", nullptr, "text/plain\r\nX-Injected: 1", reinterpret_cast<const uint8_t*>(value.data()), value.size()));
+        VERIFY_ARE_EQUAL(E_FAIL, HCHttpCallRequestAddMultipartFile(call, "missing", nullptr, nullptr, "no_such_multipart_file.txt"));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        // Setting the body another way replaces the multipart body, and adding a part after that starts a new one
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAddMultipartBytes(call, "first", nullptr, nullptr, reinterpret_cast<const uint8_t*>(value.data()), value.size()));
+        std::string firstBoundary = Boundary(call);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyString(call, "plain"));
+        VERIFY_ARE_EQUAL(S_OK, ReadRequestBody(call, 64, body));
+        VERIFY_ARE_EQUAL_STR("plain", body.c_str());
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAddMultipartBytes(call, "second", nullptr, nullptr, reinterpret_cast<const uint8_t*>(value.data()), value.size()));
+        boundary = Boundary(call);
+        VERIFY_IS_TRUE(boundary != firstBoundary);
+        VERIFY_ARE_EQUAL(S_OK, ReadRequestBody(call, 64, body));
+        VERIFY_IS_TRUE(body == "--" + boundary + "\r\nContent-Disposition: form-data; name=\"second\"\r\n\r\nvalue\r\n--" + boundary + "--\r\n");
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        remove(MULTIPART_TEST_FILE);
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyMultipartBodyOfUnknownSize)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyMultipartBodyOfUnknownSize);
+
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        std::string value{ "value" };
+        counting_part part{ 50, 0 };
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAddMultipartReadFunction(call, "stream", nullptr, nullptr, CountingReadFunction, HC_UNKNOWN_REQUEST_BODY_SIZE, &part));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAddMultipartBytes(call, "after", nullptr, nullptr, reinterpret_cast<const uint8_t*>(value.data()), value.size()));
+
+        // One part of unknown size makes the body chunked
+        HCHttpCallRequestBodyReadFunction readFunction = nullptr;
+        size_t bodySize = 0;
+        void* context = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetRequestBodyReadFunction(call, &readFunction, &bodySize, &context));
+        VERIFY_ARE_EQUAL(HC_UNKNOWN_REQUEST_BODY_SIZE, bodySize);
+
+        std::string boundary = Boundary(call);
+        std::string expected =
+            "--" + boundary + "\r\n"
+            "Content-Disposition: form-data; name=\"stream\"\r\n"
+            "\r\n" + Counting(part.size) + "\r\n"
+            "--" + boundary + "\r\n"
+            "Content-Disposition: form-data; name=\"after\"\r\n"
+            "\r\n"
+            "value\r\n"
+            "--" + boundary + "--\r\n";
+
+        for (size_t bytesPerRead : { 1, 7, 64, 4096 })
+        {
+            std::string body;
+            VERIFY_ARE_EQUAL(S_OK, ReadRequestBody(call, bytesPerRead, body));
+            VERIFY_IS_TRUE(body == expected);
+        }
+
+        // A part that isn't ready pauses the body only once what comes before it has been read
+        part = counting_part{ 50, 2 };
+        uint8_t buffer[4096]{};
+        size_t bytesWritten = 0;
+        size_t partStart = expected.find(Counting(part.size));
+        VERIFY_ARE_EQUAL(S_OK, readFunction(call, 0, sizeof(buffer), context, buffer, &bytesWritten));
+        VERIFY_ARE_EQUAL(partStart, bytesWritten);
+        VERIFY_ARE_EQUAL(E_PENDING, readFunction(call, bytesWritten, sizeof(buffer), context, buffer, &bytesWritten));
+        VERIFY_ARE_EQUAL(0u, static_cast<uint32_t>(bytesWritten));
+        VERIFY_ARE_EQUAL(S_OK, readFunction(call, partStart, sizeof(buffer), context, buffer, &bytesWritten));
+        VERIFY_IS_TRUE(expected.compare(partStart, bytesWritten, reinterpret_cast<const char*>(buffer), bytesWritten) == 0);
+
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyMultipartUpload)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyMultipartUpload);
+
+        g_uploadServer = upload_server{};
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&UploadPerformCallback, &g_uploadServer));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "POST", "https://example.com/upload"));
+        std::string large = Counting(10000);
+        counting_part part{ 500, 0 };
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAddMultipartBorrowedBytes(call, "large", "large.txt", "text/plain", reinterpret_cast<const uint8_t*>(large.data()), large.size()));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAddMultipartReadFunction(call, "stream", nullptr, nullptr, CountingReadFunction, HC_UNKNOWN_REQUEST_BODY_SIZE, &part));
+        std::string boundary = Boundary(call);
+
+        XAsyncBlock asyncBlock{};
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+        VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+
+        HRESULT networkError = E_FAIL;
+        uint32_t platformError = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &networkError, &platformError));
+        VERIFY_ARE_EQUAL(S_OK, networkError);
+        VERIFY_IS_TRUE(g_uploadServer.contentType == "multipart/form-data; boundary=" + boundary);
+        VERIFY_IS_TRUE(g_uploadServer.body ==
+            "--" + boundary + "\r\n"
+            "Content-Disposition: form-data; name=\"large\"; filename=\"large.txt\"\r\n"
+            "Content-Type: text/plain\r\n"
+            "\r\n" + large + "\r\n"
+            "--" + boundary + "\r\n"
+            "Content-Disposition: form-data; name=\"stream\"\r\n"
+            "\r\n" + Counting(part.size) + "\r\n"
+            "--" + boundary + "--\r\n");
+
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        HCCleanup();
+    }
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
@@ -0,0 +1,617 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "UnitTestIncludes.h"
+#define TEST_CLASS_OWNER L"jasonsa"
+#include "DefineTestMacros.h"
+#include "utils.h"
+
+using namespace xbox::httpclient;
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
+
+struct range_server
+{
+    std::vector<uint8_t> content;
+    bool acceptRanges{ true };
+    bool ignoreRanges{ false };     // answers GETs with the whole body, as if the resource had changed
+    uint64_t failRangeAt{ UINT64_MAX }; // the first request for a range starting here drops its connection halfway
+    std::vector<uint64_t> dropAt;       // each GET that reaches one of these offsets drops its connection there, once
+    uint32_t changeEtagAfter{ UINT32_MAX }; // the ETag changes to "v2" once this many GETs were served
+    uint32_t errorOnGet{ UINT32_MAX };  // the GET with this index fails with 503
+    bool lateStatus{ false };           // GETs only get their status once the body is written, as NSURLSession reports it
+
+    std::mutex lock;
+    uint32_t headRequests{ 0 };
+    std::vector<std::string> getRanges;
+    std::vector<std::string> ifRanges;
+};
+
+// The perform function stays registered after the test, so its context has to outlive it
+static range_server g_rangeServer;
+
+// Serves g_rangeServer's content in 4KB writes, honoring single byte ranges
+static void CALLBACK RangePerformCallback(
+    _In_ HCCallHandle call,
+    _Inout_ XAsyncBlock* asyncBlock,
+    _In_opt_ void* ctx,
+    _In_opt_ HCPerformEnv /*env*/
+    )
+{
+    auto& server = *static_cast<range_server*>(ctx);
+    const char* method = nullptr;
+    const char* url = nullptr;
+    HCHttpCallRequestGetUrl(call, &method, &url);
+    const char* range = nullptr;
+    HCHttpCallRequestGetHeader(call, "Range", &range);
+    const char* ifRange = nullptr;
+    HCHttpCallRequestGetHeader(call, "If-Range", &ifRange);
+
+    std::string etag;
+    {
+        std::lock_guard<std::mutex> lock{ server.lock };
+        etag = server.getRanges.size() >= server.changeEtagAfter ? "\"v2\"" : "\"v1\"";
+    }
+    HCHttpCallResponseSetHeader(call, "ETag", etag.c_str());
+    HCHttpCallResponseSetHeader(call, "Accept-Ranges", server.acceptRanges ? "bytes" : "none");
+
+    if (strcmp(method, "HEAD") == 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock{ server.lock };
+            ++server.headRequests;
+        }
+        HCHttpCallResponseSetStatusCode(call, 200);
+        HCHttpCallResponseSetHeader(call, "Content-Length", std::to_string(server.content.size()).c_str());
+        XAsyncComplete(asyncBlock, S_OK, 0);
+        return;
+    }
+
+    unsigned long long first = 0;
+    unsigned long long last = server.content.size() - 1;
+    bool dropConnection = false;
+    uint64_t dropOffset = UINT64_MAX;
+    uint32_t statusCode = 200;
+    {
+        std::lock_guard<std::mutex> lock{ server.lock };
+        if (server.getRanges.size() == server.errorOnGet)
+        {
+            statusCode = 503;
+        }
+        server.getRanges.push_back(range != nullptr ? range : "");
+        server.ifRanges.push_back(ifRange != nullptr ? ifRange : "");
+
+        // If-Range asks for the whole body if the resource changed
+        bool rangeApplies = range != nullptr && server.acceptRanges && !server.ignoreRanges && (ifRange == nullptr || etag == ifRange);
+        int rangeFields = rangeApplies ? sscanf(range, "bytes=%llu-%llu", &first, &last) : 0;
+        if (statusCode == 200 && rangeFields >= 1)
+        {
+            statusCode = first < server.content.size() ? 206 : 416;
+            if (rangeFields == 1)
+            {
+                last = server.content.size() - 1;
+            }
+            dropConnection = first == server.failRangeAt;
+            if (dropConnection)
+            {
+                server.failRangeAt = UINT64_MAX;
+            }
+        }
+        else
+        {
+            first = 0;
+            last = server.content.size() - 1;
+        }
+
+        for (auto it = server.dropAt.begin(); statusCode != 503 && it != server.dropAt.end(); ++it)
+        {
+            if (*it > first && *it <= last)
+            {
+                dropOffset = *it;
+                server.dropAt.erase(it);
+                break;
+            }
+        }
+    }
+
+    if (!server.lateStatus)
+    {
+        HCHttpCallResponseSetStatusCode(call, statusCode);
+    }
+    if (statusCode == 503 || statusCode == 416)
+    {
+        if (statusCode == 416)
+        {
+            std::string contentRange = "bytes */" + std::to_string(server.content.size());
+            HCHttpCallResponseSetHeader(call, "Content-Range", contentRange.c_str());
+        }
+        HCHttpCallResponseBodyWriteFunction writeFunction = nullptr;
+        void* writeContext = nullptr;
+        HCHttpCallResponseGetResponseBodyWriteFunction(call, &writeFunction, &writeContext);
+        writeFunction(call, reinterpret_cast<const uint8_t*>("error"), 5, writeContext);
+        HCHttpCallResponseSetStatusCode(call, statusCode);
+        XAsyncComplete(asyncBlock, S_OK, 0);
+        return;
+    }
+    if (statusCode == 206)
+    {
+        std::string contentRange = "bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(server.content.size());
+        HCHttpCallResponseSetHeader(call, "Content-Range", contentRange.c_str());
+    }
+    HCHttpCallResponseSetHeader(call, "Content-Length", std::to_string(last - first + 1).c_str());
+
+    HCHttpCallResponseBodyWriteFunction writeFunction = nullptr;
+    void* writeContext = nullptr;
+    HCHttpCallResponseGetResponseBodyWriteFunction(call, &writeFunction, &writeContext);
+
+    size_t end = dropConnection ? static_cast<size_t>(first + (last - first + 1) / 2) : static_cast<size_t>(std::min<uint64_t>(last + 1, dropOffset));
+    for (size_t offset = static_cast<size_t>(first); offset < end; offset += 4096)
+    {
+        HRESULT hr = writeFunction(call, server.content.data() + offset, std::min<size_t>(4096, end - offset), writeContext);
+        if (FAILED(hr))
+        {
+            HCHttpCallResponseSetNetworkErrorCode(call, hr, 0);
+            break;
+        }
+    }
+    if (dropConnection || dropOffset != UINT64_MAX)
+    {
+        HCHttpCallResponseSetNetworkErrorCode(call, E_FAIL, 104);
+    }
+    HCHttpCallResponseSetStatusCode(call, statusCode);
+    XAsyncComplete(asyncBlock, S_OK, 0);
+}
+
+static void ResetServer(size_t contentSize)
+{
+    auto& server = g_rangeServer;
+    server.content.resize(contentSize);
+    uint32_t seed = 99;
+    for (auto& b : server.content)
+    {
+        seed = seed * 1664525 + 1013904223;
+        b = static_cast<uint8_t>(seed >> 24);
+    }
+    server.acceptRanges = true;
+    server.ignoreRanges = false;
+    server.failRangeAt = UINT64_MAX;
+    server.dropAt.clear();
+    server.changeEtagAfter = UINT32_MAX;
+    server.errorOnGet = UINT32_MAX;
+    server.lateStatus = false;
+    server.headRequests = 0;
+    server.getRanges.clear();
+    server.ifRanges.clear();
+}
+
+static HCCallHandle CreateRangeCall(uint32_t segmentCount, uint64_t minSegmentSize)
+{
+    HCCallHandle call = nullptr;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "https://www.example.com/pack.bin"));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetParallelRanges(call, segmentCount, minSegmentSize));
+    return call;
+}
+
+static void PerformCall(HCCallHandle call)
+{
+    XAsyncBlock asyncBlock{};
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+    VERIFY_SUCCEEDED(XAsyncGetStatus(&asyncBlock, true));
+}
+
+static std::vector<uint8_t> GetBody(HCCallHandle call)
+{
+    size_t size = 0;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseBodyBytesSize(call, &size));
+    std::vector<uint8_t> body(size);
+    if (body.empty())
+    {
+        return body;
+    }
+    size_t used = 0;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetResponseBodyBytes(call, body.size(), body.data(), &used));
+    return body;
+}
+
+struct write_at_sink
+{
+    std::mutex lock;
+    std::vector<uint8_t> bytes;
+    std::vector<uint64_t> offsets;
+};
+
+static HRESULT CALLBACK WriteAt(
+    _In_ HCCallHandle /*call*/,
+    _In_ uint64_t offset,
+    _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context
+    )
+{
+    auto sink = static_cast<write_at_sink*>(context);
+    std::lock_guard<std::mutex> lock{ sink->lock };
+    if (offset + bytesAvailable > sink->bytes.size())
+    {
+        return E_FAIL;
+    }
+    memcpy(sink->bytes.data() + offset, source, bytesAvailable);
+    sink->offsets.push_back(offset);
+    return S_OK;
+}
+
+static HCCallHandle CreateResumableCall()
+{
+    HCCallHandle call = nullptr;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "https://www.example.com/pack.bin"));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryDelay(call, 0));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetResumable(call, true));
+    return call;
+}
+
+struct checkpoint_log
+{
+    std::vector<uint64_t> offsets;
+    std::vector<std::string> validators;
+    uint64_t totalLength{ 0 };
+};
+
+static void CALLBACK RecordCheckpoint(
+    _In_ HCCallHandle /*call*/,
+    _In_ const HCResumeCheckpoint* checkpoint,
+    _In_opt_ void* context
+    )
+{
+    auto log = static_cast<checkpoint_log*>(context);
+    log->offsets.push_back(checkpoint->offset);
+    log->validators.push_back(checkpoint->validator);
+    log->totalLength = checkpoint->totalLength;
+}
+
+static HRESULT CALLBACK Append(
+    _In_ HCCallHandle /*call*/,
+    _In_reads_bytes_(bytesAvailable) const uint8_t* source,
+    _In_ size_t bytesAvailable,
+    _In_opt_ void* context
+    )
+{
+    auto bytes = static_cast<std::vector<uint8_t>*>(context);
+    bytes->insert(bytes->end(), source, source + bytesAvailable);
+    return S_OK;
+}
+
+DEFINE_TEST_CLASS(RangeDownloadTests)
+{
+public:
+    DEFINE_TEST_CLASS_PROPS(RangeDownloadTests);
+
+    DEFINE_TEST_CASE(VerifyParallelRanges)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyParallelRanges);
+
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&RangePerformCallback, &g_rangeServer));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+        ResetServer(100000);
+        HCCallHandle call = CreateRangeCall(4, 10000);
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCHttpCallRequestSetParallelRanges(call, 4, 0));
+        PerformCall(call);
+
+        uint32_t statusCode = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetStatusCode(call, &statusCode));
+        VERIFY_ARE_EQUAL(200u, statusCode);
+        const char* contentLength = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetHeader(call, "Content-Length", &contentLength));
+        VERIFY_ARE_EQUAL_STR("100000", contentLength);
+        VERIFY_IS_TRUE(GetBody(call) == g_rangeServer.content);
+
+        // One HEAD, then the body in even ranges, each sent only if the resource is unchanged
+        VERIFY_ARE_EQUAL(1u, g_rangeServer.headRequests);
+        std::sort(g_rangeServer.getRanges.begin(), g_rangeServer.getRanges.end());
+        std::vector<std::string> expected{ "bytes=0-24999", "bytes=25000-49999", "bytes=50000-74999", "bytes=75000-99999" };
+        VERIFY_IS_TRUE(g_rangeServer.getRanges == expected);
+        for (auto const& ifRange : g_rangeServer.ifRanges)
+        {
+            VERIFY_ARE_EQUAL_STR("\"v1\"", ifRange.c_str());
+        }
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        // Ranges are never smaller than the minimum, so fewer are used
+        ResetServer(100000);
+        call = CreateRangeCall(8, 40000);
+        PerformCall(call);
+        VERIFY_IS_TRUE(GetBody(call) == g_rangeServer.content);
+        VERIFY_ARE_EQUAL(2u, static_cast<uint32_t>(g_rangeServer.getRanges.size()));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyParallelRangeRetry)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyParallelRangeRetry);
+
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&RangePerformCallback, &g_rangeServer));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+        // The dropped range asks again for the half it didn't get
+        ResetServer(100000);
+        g_rangeServer.failRangeAt = 50000;
+        HCCallHandle call = CreateRangeCall(4, 10000);
+        PerformCall(call);
+
+        uint32_t statusCode = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetStatusCode(call, &statusCode));
+        VERIFY_ARE_EQUAL(200u, statusCode);
+        HRESULT networkErrorCode = E_FAIL;
+        uint32_t platformNetworkErrorCode = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &networkErrorCode, &platformNetworkErrorCode));
+        VERIFY_ARE_EQUAL(S_OK, networkErrorCode);
+        VERIFY_IS_TRUE(GetBody(call) == g_rangeServer.content);
+        VERIFY_ARE_EQUAL(5u, static_cast<uint32_t>(g_rangeServer.getRanges.size()));
+        VERIFY_IS_TRUE(std::find(g_rangeServer.getRanges.begin(), g_rangeServer.getRanges.end(), "bytes=62500-74999") != g_rangeServer.getRanges.end());
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        // Without retries the call reports the range's failure
+        ResetServer(100000);
+        g_rangeServer.failRangeAt = 50000;
+        call = CreateRangeCall(4, 10000);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, false));
+        PerformCall(call);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &networkErrorCode, &platformNetworkErrorCode));
+        VERIFY_ARE_EQUAL(E_FAIL, networkErrorCode);
+        VERIFY_ARE_EQUAL(104u, platformNetworkErrorCode);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyParallelRangesFallback)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyParallelRangesFallback);
+
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&RangePerformCallback, &g_rangeServer));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+        // A server without ranges, and a body too small to split, are downloaded in one response
+        for (bool acceptRanges : { false, true })
+        {
+            ResetServer(acceptRanges ? 15000 : 100000);
+            g_rangeServer.acceptRanges = acceptRanges;
+            HCCallHandle call = CreateRangeCall(4, 10000);
+            PerformCall(call);
+            VERIFY_IS_TRUE(GetBody(call) == g_rangeServer.content);
+            VERIFY_ARE_EQUAL(1u, g_rangeServer.headRequests);
+            VERIFY_ARE_EQUAL(1u, static_cast<uint32_t>(g_rangeServer.getRanges.size()));
+            VERIFY_ARE_EQUAL_STR("", g_rangeServer.getRanges[0].c_str());
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // A resource that changes between the HEAD and the ranges fails rather than mixing versions
+        ResetServer(100000);
+        g_rangeServer.ignoreRanges = true;
+        HCCallHandle call = CreateRangeCall(4, 10000);
+        PerformCall(call);
+        HRESULT networkErrorCode = S_OK;
+        uint32_t platformNetworkErrorCode = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &networkErrorCode, &platformNetworkErrorCode));
+        VERIFY_ARE_EQUAL(E_HC_RANGE_MISMATCH, networkErrorCode);
+        VERIFY_IS_TRUE(GetBody(call).empty());
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyResponseBodyWriteAt)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyResponseBodyWriteAt);
+
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&RangePerformCallback, &g_rangeServer));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+        for (bool acceptRanges : { true, false })
+        {
+            ResetServer(100000);
+            g_rangeServer.acceptRanges = acceptRanges;
+            write_at_sink sink;
+            sink.bytes.resize(g_rangeServer.content.size());
+
+            HCCallHandle call = CreateRangeCall(4, 10000);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseSetResponseBodyWriteAtFunction(call, WriteAt, &sink));
+            PerformCall(call);
+            VERIFY_IS_TRUE(sink.bytes == g_rangeServer.content);
+            VERIFY_ARE_EQUAL(acceptRanges ? 4u : 1u, static_cast<uint32_t>(g_rangeServer.getRanges.size()));
+
+            // Written in order when downloaded in one response
+            VERIFY_IS_TRUE(std::is_sorted(sink.offsets.begin(), sink.offsets.end()) || acceptRanges);
+
+            size_t size = 0;
+            VERIFY_ARE_EQUAL(E_FAIL, HCHttpCallResponseGetResponseBodyBytesSize(call, &size));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyResumableDownload)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyResumableDownload);
+
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&RangePerformCallback, &g_rangeServer));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        // Each retry asks for the bytes the dropped connections didn't deliver
+        ResetServer(100000);
+        g_rangeServer.dropAt = { 40000, 70000 };
+        checkpoint_log log;
+        HCCallHandle call = CreateResumableCall();
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetResumeCheckpointFunction(call, RecordCheckpoint, 0, &log));
+        PerformCall(call);
+
+        std::vector<std::string> expected{ "", "bytes=40000-", "bytes=70000-" };
+        VERIFY_IS_TRUE(g_rangeServer.getRanges == expected);
+        VERIFY_ARE_EQUAL_STR("\"v1\"", g_rangeServer.ifRanges[1].c_str());
+        VERIFY_ARE_EQUAL_STR("\"v1\"", g_rangeServer.ifRanges[2].c_str());
+        VERIFY_IS_TRUE(GetBody(call) == g_rangeServer.content);
+
+        // As if the body had arrived in one response
+        uint32_t statusCode = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetStatusCode(call, &statusCode));
+        VERIFY_ARE_EQUAL(200u, statusCode);
+        const char* header = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetHeader(call, "Content-Length", &header));
+        VERIFY_ARE_EQUAL_STR("100000", header);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetHeader(call, "Content-Range", &header));
+        VERIFY_IS_NULL(header);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetHeader(call, "Range", &header));
+        VERIFY_IS_NULL(header);
+
+        std::vector<uint64_t> expectedOffsets{ 40000, 70000, 100000 };
+        VERIFY_IS_TRUE(log.offsets == expectedOffsets);
+        VERIFY_ARE_EQUAL_STR("\"v1\"", log.validators.back().c_str());
+        VERIFY_ARE_EQUAL(100000ull, log.totalLength);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        // Checkpoints are also reported while an attempt is downloading
+        ResetServer(100000);
+        g_rangeServer.dropAt = { 40000 };
+        log = checkpoint_log{};
+        call = CreateResumableCall();
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetResumeCheckpointFunction(call, RecordCheckpoint, 16384, &log));
+        PerformCall(call);
+        VERIFY_IS_TRUE(GetBody(call) == g_rangeServer.content);
+        VERIFY_IS_TRUE(log.offsets.size() > 3);
+        VERIFY_IS_TRUE(std::is_sorted(log.offsets.begin(), log.offsets.end()));
+        VERIFY_ARE_EQUAL(100000ull, log.offsets.back());
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        // Without it every attempt starts over
+        ResetServer(100000);
+        g_rangeServer.dropAt = { 40000, 70000 };
+        call = CreateResumableCall();
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetResumable(call, false));
+        PerformCall(call);
+        expected = { "", "", "" };
+        VERIFY_IS_TRUE(g_rangeServer.getRanges == expected);
+        VERIFY_IS_TRUE(GetBody(call) == g_rangeServer.content);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        // A body written before its status waits for it, so it's still counted, and an error body still kept out
+        ResetServer(100000);
+        g_rangeServer.lateStatus = true;
+        g_rangeServer.dropAt = { 40000 };
+        g_rangeServer.errorOnGet = 1;
+        call = CreateResumableCall();
+        PerformCall(call);
+        expected = { "", "bytes=40000-", "bytes=40000-" };
+        VERIFY_IS_TRUE(g_rangeServer.getRanges == expected);
+        VERIFY_IS_TRUE(GetBody(call) == g_rangeServer.content);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyResumeRefused)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyResumeRefused);
+
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&RangePerformCallback, &g_rangeServer));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        // A resource that changed is downloaded again from the start
+        ResetServer(100000);
+        g_rangeServer.dropAt = { 40000 };
+        g_rangeServer.changeEtagAfter = 1;
+        checkpoint_log log;
+        HCCallHandle call = CreateResumableCall();
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetResumeCheckpointFunction(call, RecordCheckpoint, 0, &log));
+        PerformCall(call);
+        VERIFY_ARE_EQUAL(2u, static_cast<uint32_t>(g_rangeServer.getRanges.size()));
+        VERIFY_IS_TRUE(GetBody(call) == g_rangeServer.content);
+        VERIFY_ARE_EQUAL(100000ull, log.offsets.back());
+        VERIFY_ARE_EQUAL_STR("\"v2\"", log.validators.back().c_str());
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        // A write function can't take back the old bytes, so the call fails and the progress is dropped
+        ResetServer(100000);
+        g_rangeServer.dropAt = { 40000 };
+        g_rangeServer.changeEtagAfter = 1;
+        log = checkpoint_log{};
+        std::vector<uint8_t> appended;
+        call = CreateResumableCall();
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseSetResponseBodyWriteFunction(call, Append, &appended));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetResumeCheckpointFunction(call, RecordCheckpoint, 0, &log));
+        PerformCall(call);
+        HRESULT networkErrorCode = S_OK;
+        uint32_t platformNetworkErrorCode = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &networkErrorCode, &platformNetworkErrorCode));
+        VERIFY_ARE_EQUAL(E_HC_RANGE_MISMATCH, networkErrorCode);
+        VERIFY_ARE_EQUAL(2u, static_cast<uint32_t>(g_rangeServer.getRanges.size()));
+        VERIFY_ARE_EQUAL(40000u, static_cast<uint32_t>(appended.size()));
+        VERIFY_ARE_EQUAL(0ull, log.offsets.back());
+        VERIFY_ARE_EQUAL_STR("", log.validators.back().c_str());
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        // The body of an error response doesn't end up in the middle of the download
+        ResetServer(100000);
+        g_rangeServer.dropAt = { 40000 };
+        g_rangeServer.errorOnGet = 1;
+        call = CreateResumableCall();
+        PerformCall(call);
+        std::vector<std::string> expected{ "", "bytes=40000-", "bytes=40000-" };
+        VERIFY_IS_TRUE(g_rangeServer.getRanges == expected);
+        VERIFY_IS_TRUE(GetBody(call) == g_rangeServer.content);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        // Nor is a download from a server that doesn't serve ranges
+        ResetServer(100000);
+        g_rangeServer.acceptRanges = false;
+        g_rangeServer.dropAt = { 40000 };
+        call = CreateResumableCall();
+        PerformCall(call);
+        expected = { "", "" };
+        VERIFY_IS_TRUE(g_rangeServer.getRanges == expected);
+        VERIFY_IS_TRUE(GetBody(call) == g_rangeServer.content);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyResumeFromCheckpoint)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyResumeFromCheckpoint);
+
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&RangePerformCallback, &g_rangeServer));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        // A download saved by an earlier process continues where it was
+        ResetServer(100000);
+        write_at_sink sink;
+        sink.bytes.assign(g_rangeServer.content.begin(), g_rangeServer.content.begin() + 60000);
+        sink.bytes.resize(g_rangeServer.content.size());
+        HCResumeCheckpoint checkpoint{ 60000, 100000, "\"v1\"" };
+        HCCallHandle call = CreateResumableCall();
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseSetResponseBodyWriteAtFunction(call, WriteAt, &sink));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetResumeCheckpoint(call, &checkpoint));
+        PerformCall(call);
+        std::vector<std::string> expected{ "bytes=60000-" };
+        VERIFY_IS_TRUE(g_rangeServer.getRanges == expected);
+        VERIFY_ARE_EQUAL(60000ull, sink.offsets.front());
+        VERIFY_IS_TRUE(sink.bytes == g_rangeServer.content);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+        // One saved as it finished has nothing left to download
+        ResetServer(100000);
+        checkpoint.offset = 100000;
+        std::vector<uint8_t> appended;
+        call = CreateResumableCall();
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseSetResponseBodyWriteFunction(call, Append, &appended));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetResumeCheckpoint(call, &checkpoint));
+        PerformCall(call);
+        uint32_t statusCode = 0;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetStatusCode(call, &statusCode));
+        VERIFY_ARE_EQUAL(200u, statusCode);
+        VERIFY_IS_TRUE(appended.empty());
+        VERIFY_ARE_EQUAL(1u, static_cast<uint32_t>(g_rangeServer.getRanges.size()));
+
+        checkpoint.validator = "";
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCHttpCallRequestSetResumeCheckpoint(call, &checkpoint));
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCHttpCallRequestSetResumeCheckpoint(call, nullptr));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        HCCleanup();
+    }
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
@@ -0,0 +1,522 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "UnitTestIncludes.h"
+#define TEST_CLASS_OWNER L"jasonsa"
+#include "DefineTestMacros.h"
+#include "utils.h"
+#include "../HTTP/response_stream.h"
+
+using namespace xbox::httpclient;
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
+
+struct stream_record
+{
+    std::string eventType;
+    std::string id;
+    std::string data;
+    bool inChunk; // the data pointed into the chunk written rather than a copy
+};
+
+struct record_log
+{
+    std::vector<stream_record> records;
+    const uint8_t* chunk{ nullptr };
+    size_t chunkSize{ 0 };
+};
+
+static HRESULT RecordRecord(_In_ const HCResponseStreamEvent& record, _In_opt_ void* context)
+{
+    auto log = static_cast<record_log*>(context);
+    stream_record r;
+    r.eventType = record.eventType != nullptr ? record.eventType : "<none>";
+    r.id = record.id != nullptr ? record.id : "<none>";
+    r.data.assign(reinterpret_cast<const char*>(record.data), record.dataSize);
+    r.inChunk = record.data >= log->chunk && record.data + record.dataSize <= log->chunk + log->chunkSize;
+    log->records.push_back(std::move(r));
+    return S_OK;
+}
+
+// Writes the body to a new framer in chunks of the given size, the last one taking what is left
+static std::vector<stream_record> Frame(HCResponseStreamFormat format, std::string const& body, size_t chunkSize, HRESULT expected = S_OK)
+{
+    http_stream_framer framer{ format };
+    record_log log;
+    HRESULT hr = S_OK;
+    for (size_t offset = 0; offset < body.size() && SUCCEEDED(hr); offset += chunkSize)
+    {
+        log.chunk = reinterpret_cast<const uint8_t*>(body.data()) + offset;
+        log.chunkSize = std::min(chunkSize, body.size() - offset);
+        hr = framer.Write(log.chunk, log.chunkSize, RecordRecord, &log);
+    }
+    VERIFY_ARE_EQUAL(expected, hr);
+    return log.records;
+}
+
+static std::string LengthPrefixed(std::string const& record)
+{
+    uint32_t size = static_cast<uint32_t>(record.size());
+    std::string prefixed{ static_cast<char>(size >> 24), static_cast<char>(size >> 16), static_cast<char>(size >> 8), static_cast<char>(size) };
+    return prefixed + record;
+}
+
+// Serves each attempt from a script, recording the requests it gets
+struct stream_server
+{
+    struct response
+    {
+        uint32_t statusCode;
+        std::string contentType;
+        std::vector<std::string> chunks;
+        bool drop; // the connection fails after the chunks
+        bool lateStatus; // the status and headers are only set after the body, as NSURLSession reports them
+    };
+
+    std::vector<response> responses;
+    std::vector<std::string> lastEventIds;
+    std::vector<std::string> accepts;
+    std::vector<std::chrono::steady_clock::time_point> requestTimes;
+};
+
+// The perform function stays registered after the test, so its context has to outlive it
+static stream_server g_streamServer;
+
+static void CALLBACK StreamPerformCallback(
+    _In_ HCCallHandle call,
+    _Inout_ XAsyncBlock* asyncBlock,
+    _In_opt_ void* ctx,
+    _In_opt_ HCPerformEnv /*env*/
+    )
+{
+    auto& server = *static_cast<stream_server*>(ctx);
+    const char* lastEventId = nullptr;
+    HCHttpCallRequestGetHeader(call, "Last-Event-ID", &lastEventId);
+    server.lastEventIds.push_back(lastEventId != nullptr ? lastEventId : "<none>");
+    const char* accept = nullptr;
+    HCHttpCallRequestGetHeader(call, "Accept", &accept);
+    server.accepts.push_back(accept != nullptr ? accept : "<none>");
+    server.requestTimes.push_back(std::chrono::steady_clock::now());
+
+    size_t index = server.lastEventIds.size() - 1;
+    if (index >= server.responses.size())
+    {
+        HCHttpCallResponseSetStatusCode(call, 204);
+        XAsyncComplete(asyncBlock, S_OK, 0);
+        return;
+    }
+
+    auto const& response = server.responses[index];
+    if (!response.lateStatus)
+    {
+        HCHttpCallResponseSetStatusCode(call, response.statusCode);
+        HCHttpCallResponseSetHeader(call, "Content-Type", response.contentType.c_str());
+    }
+
+    HCHttpCallResponseBodyWriteFunction writeFunction = nullptr;
+    void* writeContext = nullptr;
+    HCHttpCallResponseGetResponseBodyWriteFunction(call, &writeFunction, &writeContext);
+    for (auto const& chunk : response.chunks)
+    {
+        HRESULT hr = writeFunction(call, reinterpret_cast<const uint8_t*>(chunk.data()), chunk.size(), writeContext);
+        if (FAILED(hr))
+        {
+            HCHttpCallResponseSetNetworkErrorCode(call, E_FAIL, 23);
+            break;
+        }
+    }
+    if (response.drop)
+    {
+        HCHttpCallResponseSetNetworkErrorCode(call, E_FAIL, 104);
+    }
+    if (response.lateStatus)
+    {
+        HCHttpCallResponseSetHeader(call, "Content-Type", response.contentType.c_str());
+        HCHttpCallResponseSetStatusCode(call, response.statusCode);
+    }
+    XAsyncComplete(asyncBlock, S_OK, 0);
+}
+
+struct event_sink
+{
+    std::mutex lock;
+    std::vector<stream_record> events;
+    std::thread::id thread;
+};
+
+static void CALLBACK RecordEvent(
+    _In_ HCCallHandle /*call*/,
+    _In_ const HCResponseStreamEvent* event,
+    _In_opt_ void* context
+    )
+{
+    auto sink = static_cast<event_sink*>(context);
+    std::lock_guard<std::mutex> lock{ sink->lock };
+    stream_record r;
+    r.eventType = event->eventType != nullptr ? event->eventType : "<none>";
+    r.id = event->id != nullptr ? event->id : "<none>";
+    r.data.assign(reinterpret_cast<const char*>(event->data), event->dataSize);
+    r.inChunk = false;
+    sink->events.push_back(std::move(r));
+    sink->thread = std::this_thread::get_id();
+}
+
+static HCCallHandle CreateStreamCall(HCResponseStreamFormat format, XTaskQueueHandle queue, event_sink& sink)
+{
+    HCCallHandle call = nullptr;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "https://www.example.com/events"));
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseSetStreamEventFunction(call, format, queue, RecordEvent, &sink));
+    return call;
+}
+
+DEFINE_TEST_CLASS(ResponseStreamTests)
+{
+public:
+    DEFINE_TEST_CLASS_PROPS(ResponseStreamTests);
+
+    DEFINE_TEST_CASE(VerifyEventStreamFraming)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyEventStreamFraming);
+
+        std::string body =
+            "\xEF\xBB\xBF" ": a comment\n"
+            "data: one\n"
+            "\n"
+            "event: update\r\n"
+            "id: 7\r\n"
+            "data:two\r\n"
+            "data:  lines\r\n"
+            "\r\n"
+            "retry: 2500\r"
+            "data\r"
+            "\r"
+            "field without meaning: ignored\n"
+            "event: ignored without data\n"
+            "\n"
+            "id\n"
+            "data: {\"last\":true}\n"
+            "\n"
+            "data: incomplete\n";
+
+        // Split everywhere, including inside the CRLFs and the byte order mark
+        for (size_t chunkSize = 1; chunkSize <= body.size(); chunkSize++)
+        {
+            auto records = Frame(HCResponseStreamFormat::ServerSentEvents, body, chunkSize);
+            VERIFY_ARE_EQUAL(4u, static_cast<uint32_t>(records.size()));
+            VERIFY_ARE_EQUAL_STR("message", records[0].eventType.c_str());
+            VERIFY_ARE_EQUAL_STR("", records[0].id.c_str());
+            VERIFY_ARE_EQUAL_STR("one", records[0].data.c_str());
+            VERIFY_ARE_EQUAL_STR("update", records[1].eventType.c_str());
+            VERIFY_ARE_EQUAL_STR("7", records[1].id.c_str());
+            VERIFY_ARE_EQUAL_STR("two\n lines", records[1].data.c_str());
+            VERIFY_ARE_EQUAL_STR("message", records[2].eventType.c_str());
+            VERIFY_ARE_EQUAL_STR("7", records[2].id.c_str());
+            VERIFY_ARE_EQUAL_STR("", records[2].data.c_str());
+            VERIFY_ARE_EQUAL_STR("", records[3].id.c_str());
+            VERIFY_ARE_EQUAL_STR("{\"last\":true}", records[3].data.c_str());
+        }
+
+        // Single-line events written whole are passed on where they are
+        auto records = Frame(HCResponseStreamFormat::ServerSentEvents, body, body.size());
+        VERIFY_IS_TRUE(records[0].inChunk);
+        VERIFY_IS_FALSE(records[1].inChunk);
+        VERIFY_IS_TRUE(records[3].inChunk);
+
+        http_stream_framer framer{ HCResponseStreamFormat::ServerSentEvents };
+        record_log log;
+        std::string retry = "retry: 2500\nretry: soon\nid: 12\n\n";
+        VERIFY_ARE_EQUAL(S_OK, framer.Write(reinterpret_cast<const uint8_t*>(retry.data()), retry.size(), RecordRecord, &log));
+        VERIFY_ARE_EQUAL(2500u, framer.ReconnectDelayInMs());
+        VERIFY_ARE_EQUAL_STR("12", framer.LastEventId().c_str());
+        VERIFY_ARE_EQUAL(0u, static_cast<uint32_t>(log.records.size()));
+
+        // An event cut off by the end of a response is dropped, but the last event ID carries over
+        std::string cut = "data: half";
+        VERIFY_ARE_EQUAL(S_OK, framer.Write(reinterpret_cast<const uint8_t*>(cut.data()), cut.size(), RecordRecord, &log));
+        framer.Reset();
+        std::string next = "data: whole\n\n";
+        VERIFY_ARE_EQUAL(S_OK, framer.Write(reinterpret_cast<const uint8_t*>(next.data()), next.size(), RecordRecord, &log));
+        VERIFY_ARE_EQUAL(1u, static_cast<uint32_t>(log.records.size()));
+        VERIFY_ARE_EQUAL_STR("whole", log.records[0].data.c_str());
+        VERIFY_ARE_EQUAL_STR("12", log.records[0].id.c_str());
+    }
+
+    DEFINE_TEST_CASE(VerifyRecordFraming)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyRecordFraming);
+
+        std::string lines = "{\"a\":1}\n\n{\"b\":\"x\\ny\"}\r\n   \n{\"c\":3}\n{\"partial\":";
+        for (size_t chunkSize = 1; chunkSize <= lines.size(); chunkSize++)
+        {
+            auto records = Frame(HCResponseStreamFormat::NewlineDelimited, lines, chunkSize);
+            VERIFY_ARE_EQUAL(4u, static_cast<uint32_t>(records.size()));
+            VERIFY_ARE_EQUAL_STR("<none>", records[0].eventType.c_str());
+            VERIFY_ARE_EQUAL_STR("{\"a\":1}", records[0].data.c_str());
+            VERIFY_ARE_EQUAL_STR("{\"b\":\"x\\ny\"}", records[1].data.c_str());
+            VERIFY_ARE_EQUAL_STR("   ", records[2].data.c_str());
+            VERIFY_ARE_EQUAL_STR("{\"c\":3}", records[3].data.c_str());
+        }
+        for (auto const& record : Frame(HCResponseStreamFormat::NewlineDelimited, lines, lines.size()))
+        {
+            VERIFY_IS_TRUE(record.inChunk);
+        }
+
+        std::string binary = LengthPrefixed("first") + LengthPrefixed("") + LengthPrefixed(std::string(1000, '\0')) + LengthPrefixed("last");
+        for (size_t chunkSize = 1; chunkSize <= binary.size(); chunkSize++)
+        {
+            auto records = Frame(HCResponseStreamFormat::LengthPrefixed, binary + std::string(2, '\0'), chunkSize);
+            VERIFY_ARE_EQUAL(4u, static_cast<uint32_t>(records.size()));
+            VERIFY_ARE_EQUAL_STR("first", records[0].data.c_str());
+            VERIFY_ARE_EQUAL(0u, static_cast<uint32_t>(records[1].data.size()));
+            VERIFY_IS_TRUE(records[2].data == std::string(1000, '\0'));
+            VERIFY_ARE_EQUAL_STR("last", records[3].data.c_str());
+        }
+        for (auto const& record : Frame(HCResponseStreamFormat::LengthPrefixed, binary, binary.size()))
+        {
+            VERIFY_IS_TRUE(record.inChunk);
+        }
+
+        // Records that can't fit are refused before they are buffered
+        std::string tooLarge{ '\x01', '\0', '\0', '\x01' };
+        Frame(HCResponseStreamFormat::LengthPrefixed, tooLarge + "x", 1, E_HC_STREAM_RECORD_TOO_LARGE);
+        std::string longLine(http_stream_framer::MAX_RECORD_SIZE + 1, 'x');
+        Frame(HCResponseStreamFormat::NewlineDelimited, longLine, 64 * 1024, E_HC_STREAM_RECORD_TOO_LARGE);
+    }
+
+    DEFINE_TEST_CASE(VerifyStreamEventDelivery)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyStreamEventDelivery);
+
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&StreamPerformCallback, &g_streamServer));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        // Without a queue events arrive on the thread the body does, and the body isn't kept
+        {
+            g_streamServer = stream_server{};
+            g_streamServer.responses.push_back({ 200, "application/x-ndjson", { "{\"a\":1}\n{\"b\"", ":2}\n" }, false });
+            event_sink sink;
+            HCCallHandle call = CreateStreamCall(HCResponseStreamFormat::NewlineDelimited, nullptr, sink);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, true));
+
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+            VERIFY_ARE_EQUAL(2u, static_cast<uint32_t>(sink.events.size()));
+            VERIFY_ARE_EQUAL_STR("{\"a\":1}", sink.events[0].data.c_str());
+            VERIFY_ARE_EQUAL_STR("{\"b\":2}", sink.events[1].data.c_str());
+
+            // Only event streams reconnect
+            VERIFY_ARE_EQUAL(1u, static_cast<uint32_t>(g_streamServer.lastEventIds.size()));
+            VERIFY_ARE_EQUAL_STR("<none>", g_streamServer.accepts[0].c_str());
+            size_t size = 0;
+            VERIFY_ARE_EQUAL(E_FAIL, HCHttpCallResponseGetResponseBodyBytesSize(call, &size));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // With a queue they are delivered in order when it is dispatched
+        {
+            g_streamServer = stream_server{};
+            g_streamServer.responses.push_back({ 200, "application/octet-stream", { LengthPrefixed("1") + LengthPrefixed("2"), LengthPrefixed("3") }, false });
+            XTaskQueueHandle queue = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, XTaskQueueCreate(XTaskQueueDispatchMode::Manual, XTaskQueueDispatchMode::Manual, &queue));
+            event_sink sink;
+            HCCallHandle call = CreateStreamCall(HCResponseStreamFormat::LengthPrefixed, queue, sink);
+
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+            VERIFY_ARE_EQUAL(0u, static_cast<uint32_t>(sink.events.size()));
+
+            while (XTaskQueueDispatch(queue, XTaskQueuePort::Work, 100) || XTaskQueueDispatch(queue, XTaskQueuePort::Completion, 0))
+            {
+            }
+            VERIFY_ARE_EQUAL(3u, static_cast<uint32_t>(sink.events.size()));
+            VERIFY_ARE_EQUAL_STR("1", sink.events[0].data.c_str());
+            VERIFY_ARE_EQUAL_STR("2", sink.events[1].data.c_str());
+            VERIFY_ARE_EQUAL_STR("3", sink.events[2].data.c_str());
+            VERIFY_IS_TRUE(sink.thread == std::this_thread::get_id());
+            XTaskQueueCloseHandle(queue);
+        }
+
+        // Error responses aren't events, and a record that is too large fails the call
+        {
+            g_streamServer = stream_server{};
+            g_streamServer.responses.push_back({ 404, "application/x-ndjson", { "{\"error\":1}\n" }, false });
+            event_sink sink;
+            HCCallHandle call = CreateStreamCall(HCResponseStreamFormat::NewlineDelimited, nullptr, sink);
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+            VERIFY_ARE_EQUAL(0u, static_cast<uint32_t>(sink.events.size()));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+            g_streamServer = stream_server{};
+            g_streamServer.responses.push_back({ 200, "application/octet-stream", { std::string{ '\x7F', '\0', '\0', '\0' } }, false });
+            call = CreateStreamCall(HCResponseStreamFormat::LengthPrefixed, nullptr, sink);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, true));
+            XAsyncBlock tooLargeAsyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &tooLargeAsyncBlock));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&tooLargeAsyncBlock, true));
+            VERIFY_ARE_EQUAL(1u, static_cast<uint32_t>(g_streamServer.lastEventIds.size()));
+            HRESULT networkError = S_OK;
+            uint32_t platformError = 0;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetNetworkErrorCode(call, &networkError, &platformError));
+            VERIFY_ARE_EQUAL(E_HC_STREAM_RECORD_TOO_LARGE, networkError);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // A body written before the status waits for it, and is judged by the status it turns out to have
+        {
+            g_streamServer = stream_server{};
+            g_streamServer.responses.push_back({ 200, "application/x-ndjson", { "{\"a\":1}\n{\"b\"", ":2}\n" }, false, true });
+            event_sink sink;
+            HCCallHandle call = CreateStreamCall(HCResponseStreamFormat::NewlineDelimited, nullptr, sink);
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+            VERIFY_ARE_EQUAL(2u, static_cast<uint32_t>(sink.events.size()));
+            VERIFY_ARE_EQUAL_STR("{\"a\":1}", sink.events[0].data.c_str());
+            VERIFY_ARE_EQUAL_STR("{\"b\":2}", sink.events[1].data.c_str());
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+            g_streamServer = stream_server{};
+            g_streamServer.responses.push_back({ 404, "application/x-ndjson", { "{\"error\":1}\n" }, false, true });
+            sink.events.clear();
+            call = CreateStreamCall(HCResponseStreamFormat::NewlineDelimited, nullptr, sink);
+            XAsyncBlock errorAsyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &errorAsyncBlock));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&errorAsyncBlock, true));
+            VERIFY_ARE_EQUAL(0u, static_cast<uint32_t>(sink.events.size()));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyEventStreamReconnect)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyEventStreamReconnect);
+
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&StreamPerformCallback, &g_streamServer));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        // Reconnects after the stream ends and after it drops, picking up from the last event, until the server
+        // answers with 204
+        {
+            g_streamServer = stream_server{};
+            g_streamServer.responses.push_back({ 200, "text/event-stream; charset=utf-8", { "retry: 10\nid: 1\ndata: a\n\nid: 2\nda", "ta: b\n\ndata: cut" }, false });
+            g_streamServer.responses.push_back({ 200, "text/event-stream", { "data: c\n\nid: 3\ndata: d\n\n" }, true });
+            g_streamServer.responses.push_back({ 200, "text/event-stream", { "data: e\n\n" }, false });
+            event_sink sink;
+            HCCallHandle call = CreateStreamCall(HCResponseStreamFormat::ServerSentEvents, nullptr, sink);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, true));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetTimeoutWindow(call, 0));
+
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+
+            VERIFY_ARE_EQUAL(4u, static_cast<uint32_t>(g_streamServer.lastEventIds.size()));
+            VERIFY_ARE_EQUAL_STR("<none>", g_streamServer.lastEventIds[0].c_str());
+            VERIFY_ARE_EQUAL_STR("2", g_streamServer.lastEventIds[1].c_str());
+            VERIFY_ARE_EQUAL_STR("3", g_streamServer.lastEventIds[2].c_str());
+            VERIFY_ARE_EQUAL_STR("3", g_streamServer.lastEventIds[3].c_str());
+            VERIFY_ARE_EQUAL_STR("text/event-stream", g_streamServer.accepts[0].c_str());
+
+            std::string events;
+            for (auto const& event : sink.events)
+            {
+                events += event.id + ":" + event.data + " ";
+            }
+            VERIFY_ARE_EQUAL_STR("1:a 2:b 2:c 3:d 3:e ", events.c_str());
+
+            uint32_t statusCode = 0;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallResponseGetStatusCode(call, &statusCode));
+            VERIFY_ARE_EQUAL(204u, statusCode);
+
+            // The headers added for the stream are gone once it completes
+            const char* header = nullptr;
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetHeader(call, "Last-Event-ID", &header));
+            VERIFY_IS_NULL(header);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        // A response that isn't an event stream isn't reconnected, nor is a call that doesn't retry
+        {
+            g_streamServer = stream_server{};
+            g_streamServer.responses.push_back({ 200, "text/plain", { "data: a\n\n" }, false });
+            event_sink sink;
+            HCCallHandle call = CreateStreamCall(HCResponseStreamFormat::ServerSentEvents, nullptr, sink);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, true));
+            XAsyncBlock asyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+            VERIFY_ARE_EQUAL(1u, static_cast<uint32_t>(g_streamServer.lastEventIds.size()));
+            VERIFY_ARE_EQUAL(0u, static_cast<uint32_t>(sink.events.size()));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+
+            g_streamServer = stream_server{};
+            g_streamServer.responses.push_back({ 200, "text/event-stream", { "data: a\n\n" }, true });
+            call = CreateStreamCall(HCResponseStreamFormat::ServerSentEvents, nullptr, sink);
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, false));
+            XAsyncBlock droppedAsyncBlock{};
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &droppedAsyncBlock));
+            VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&droppedAsyncBlock, true));
+            VERIFY_ARE_EQUAL(1u, static_cast<uint32_t>(g_streamServer.lastEventIds.size()));
+            VERIFY_ARE_EQUAL(1u, static_cast<uint32_t>(sink.events.size()));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        }
+
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(VerifyEventStreamReconnectBackoff)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyEventStreamReconnectBackoff);
+
+        VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&StreamPerformCallback, &g_streamServer));
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        // A server asking for no delay is still reconnected to after the minimum, and each attempt in a row without
+        // an event doubles the delay, until one delivers an event
+        g_streamServer = stream_server{};
+        g_streamServer.responses.push_back({ 200, "text/event-stream", { "retry: 0\n\n" }, false });
+        g_streamServer.responses.push_back({ 200, "text/event-stream", { ": keep-alive\n\n" }, false });
+        g_streamServer.responses.push_back({ 200, "text/event-stream", {}, true });
+        g_streamServer.responses.push_back({ 200, "text/event-stream", { "data: a\n\n" }, false });
+        g_streamServer.responses.push_back({ 200, "text/event-stream", {}, false });
+        event_sink sink;
+        HCCallHandle call = CreateStreamCall(HCResponseStreamFormat::ServerSentEvents, nullptr, sink);
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRetryAllowed(call, true));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetTimeoutWindow(call, 0));
+
+        XAsyncBlock asyncBlock{};
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+        VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+        VERIFY_ARE_EQUAL(1u, static_cast<uint32_t>(sink.events.size()));
+
+        auto const& times = g_streamServer.requestTimes;
+        VERIFY_ARE_EQUAL(6u, static_cast<uint32_t>(times.size()));
+        std::vector<long long> gaps;
+        for (size_t i = 1; i < times.size(); i++)
+        {
+            gaps.push_back(static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(times[i] - times[i - 1]).count()));
+        }
+        LOG_COMMENT(L"reconnect delays: %lld %lld %lld %lld %lld ms", gaps[0], gaps[1], gaps[2], gaps[3], gaps[4]);
+
+        long long const expected[]{ 100, 200, 400, 100, 100 };
+        for (size_t i = 0; i < gaps.size(); i++)
+        {
+            VERIFY_IS_TRUE(gaps[i] >= expected[i] - 5);
+        }
+        VERIFY_IS_TRUE(gaps[3] < gaps[2]);
+
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        HCCleanup();
+    }
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
@@ -0,0 +1,223 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "UnitTestIncludes.h"
+#define TEST_CLASS_OWNER L"jasonsa"
+#include "DefineTestMacros.h"
+#include "utils.h"
+#include <condition_variable>
+#include <thread>
+
+using namespace xbox::httpclient;
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
+
+static std::atomic<uint32_t> g_cachingTestAllocs{ 0 };
+static std::atomic<uint32_t> g_cachingTestFrees{ 0 };
+
+static _Ret_maybenull_ _Post_writable_byte_size_(size) void* STDAPIVCALLTYPE CachingTestMemAlloc(
+    _In_ size_t size,
+    _In_ HCMemoryType /*memoryType*/
+    )
+{
+    ++g_cachingTestAllocs;
+    return malloc(size);
+}
+
+static void STDAPIVCALLTYPE CachingTestMemFree(
+    _In_ _Post_invalid_ void* pointer,
+    _In_ HCMemoryType /*memoryType*/
+    )
+{
+    ++g_cachingTestFrees;
+    free(pointer);
+}
+
+static void CALLBACK CachingPerformCallback(
+    _In_ HCCallHandle call,
+    _Inout_ XAsyncBlock* asyncBlock,
+    _In_opt_ void* /*ctx*/,
+    _In_opt_ HCPerformEnv /*env*/
+    )
+{
+    HCHttpCallResponseSetStatusCode(call, 200);
+    HCHttpCallResponseSetHeader(call, "Content-Type", "application/json; charset=utf-8");
+    HCHttpCallResponseSetHeader(call, "X-Request-Id", "0f1e2d3c-4b5a-6978-8796-a5b4c3d2e1f0");
+    XAsyncComplete(asyncBlock, S_OK, 0);
+}
+
+// Counts the calls made to the memory hooks while performing a number of calls
+static uint32_t CountHookCalls(bool threadCaching)
+{
+    VERIFY_ARE_EQUAL(S_OK, HCMemSetThreadCachingEnabled(threadCaching));
+    VERIFY_ARE_EQUAL(S_OK, HCSetHttpCallPerformFunction(&CachingPerformCallback, nullptr));
+    VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+    uint32_t before = g_cachingTestAllocs + g_cachingTestFrees;
+    for (int i = 0; i < 50; i++)
+    {
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "POST", "https://title.example.com/users/xuid(2814000000000000)/profile/settings"));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetHeader(call, "Authorization", "XBL3.0 x=1234567890;eyJhbGciOiJSUzI1NiIsInR5cCI6IkpXVCJ9", false));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetRequestBodyString(call, "{\"settings\":[\"GameDisplayName\",\"Gamerscore\"]}"));
+
+        XAsyncBlock asyncBlock{};
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallPerformAsync(call, &asyncBlock));
+        VERIFY_ARE_EQUAL(S_OK, XAsyncGetStatus(&asyncBlock, true));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+    }
+    uint32_t hookCalls = g_cachingTestAllocs + g_cachingTestFrees - before;
+
+    HCCleanup();
+    VERIFY_ARE_EQUAL(S_OK, HCMemSetThreadCachingEnabled(false));
+    return hookCalls;
+}
+
+DEFINE_TEST_CLASS(ThreadCachingTests)
+{
+public:
+    DEFINE_TEST_CLASS_PROPS(ThreadCachingTests);
+
+    DEFINE_TEST_CASE(VerifyThreadCaching)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyThreadCaching);
+
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(&CachingTestMemAlloc, &CachingTestMemFree));
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetThreadCachingEnabled(true));
+        uint32_t allocs = g_cachingTestAllocs;
+        uint32_t frees = g_cachingTestFrees;
+
+        // Small allocations are carved out of a slab allocated with the hooks
+        std::vector<void*> blocks;
+        for (int i = 0; i < 100; i++)
+        {
+            void* p = http_memory::mem_alloc(40, HC_MEMORY_TYPE_GENERAL);
+            VERIFY_IS_NOT_NULL(p);
+            VERIFY_ARE_EQUAL(0u, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(p) % 16));
+            memset(p, 0xcd, 40);
+            blocks.push_back(p);
+        }
+        VERIFY_ARE_EQUAL(allocs + 1, g_cachingTestAllocs.load());
+
+        // And freed blocks are reused without calling them again
+        for (void* p : blocks)
+        {
+            http_memory::mem_free(p, HC_MEMORY_TYPE_GENERAL);
+        }
+        for (void*& p : blocks)
+        {
+            p = http_memory::mem_alloc(33, HC_MEMORY_TYPE_GENERAL);
+        }
+        for (void* p : blocks)
+        {
+            http_memory::mem_free(p, HC_MEMORY_TYPE_GENERAL);
+        }
+        VERIFY_ARE_EQUAL(allocs + 1, g_cachingTestAllocs.load());
+        VERIFY_ARE_EQUAL(frees, g_cachingTestFrees.load());
+
+        // Large allocations go to the hooks directly
+        void* large = http_memory::mem_alloc(8192, HC_MEMORY_TYPE_GENERAL);
+        VERIFY_IS_NOT_NULL(large);
+        VERIFY_ARE_EQUAL(allocs + 2, g_cachingTestAllocs.load());
+        http_memory::mem_free(large, HC_MEMORY_TYPE_GENERAL);
+        VERIFY_ARE_EQUAL(frees + 1, g_cachingTestFrees.load());
+
+        // Blocks freed on another thread are cached there, and returned when it exits
+        std::vector<void*> moved;
+        std::thread worker{ [&]()
+        {
+            for (int i = 0; i < 20; i++)
+            {
+                http_memory::mem_free(http_memory::mem_alloc(200, HC_MEMORY_TYPE_GENERAL), HC_MEMORY_TYPE_GENERAL);
+            }
+            moved.push_back(http_memory::mem_alloc(200, HC_MEMORY_TYPE_GENERAL));
+        } };
+        worker.join();
+        VERIFY_ARE_EQUAL(allocs + 3, g_cachingTestAllocs.load());
+        http_memory::mem_free(moved[0], HC_MEMORY_TYPE_GENERAL);
+
+        // Once every block of a slab is free, trimming returns it to the hooks
+        http_memory::trim();
+        VERIFY_ARE_EQUAL(frees + 3, g_cachingTestFrees.load());
+
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetThreadCachingEnabled(false));
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(nullptr, nullptr));
+    }
+
+    DEFINE_TEST_CASE(VerifyThreadCachingModeChange)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyThreadCachingModeChange);
+
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(&CachingTestMemAlloc, &CachingTestMemFree));
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetThreadCachingEnabled(true));
+
+        // A cached block can't be freed without caching, so the mode can't change while one is in use, even across
+        // HCCleanup()
+        void* live = http_memory::mem_alloc(40, HC_MEMORY_TYPE_GENERAL);
+        VERIFY_IS_NOT_NULL(live);
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+        HCCleanup();
+        VERIFY_ARE_EQUAL(E_HC_INTERNAL_STILLINUSE, HCMemSetThreadCachingEnabled(false));
+        http_memory::mem_free(live, HC_MEMORY_TYPE_GENERAL);
+        http_memory::trim();
+
+        // Blocks another thread still caches when caching is disabled are freed, with their slabs, when it exits
+        uint32_t allocs = g_cachingTestAllocs;
+        uint32_t frees = g_cachingTestFrees;
+        std::mutex lock;
+        std::condition_variable changed;
+        bool cached = false;
+        bool disabled = false;
+        std::thread worker{ [&]()
+        {
+            http_memory::mem_free(http_memory::mem_alloc(300, HC_MEMORY_TYPE_GENERAL), HC_MEMORY_TYPE_GENERAL);
+
+            std::unique_lock<std::mutex> guard{ lock };
+            cached = true;
+            changed.notify_all();
+            changed.wait(guard, [&] { return disabled; });
+        } };
+
+        {
+            std::unique_lock<std::mutex> guard{ lock };
+            changed.wait(guard, [&] { return cached; });
+        }
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetThreadCachingEnabled(false));
+        VERIFY_ARE_EQUAL(allocs + 1, g_cachingTestAllocs.load());
+        VERIFY_ARE_EQUAL(frees, g_cachingTestFrees.load());
+        {
+            std::lock_guard<std::mutex> guard{ lock };
+            disabled = true;
+            changed.notify_all();
+        }
+        worker.join();
+        VERIFY_ARE_EQUAL(frees + 1, g_cachingTestFrees.load());
+
+        // Uncached allocations aren't tracked, so the default mode costs nothing, and caching is only enabled once
+        // they have been freed
+        live = http_memory::mem_alloc(40, HC_MEMORY_TYPE_GENERAL);
+        http_memory::mem_free(live, HC_MEMORY_TYPE_GENERAL);
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetThreadCachingEnabled(true));
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetThreadCachingEnabled(false));
+
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(nullptr, nullptr));
+    }
+
+    DEFINE_TEST_CASE(MeasureThreadCachingHookCalls)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(MeasureThreadCachingHookCalls);
+
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(&CachingTestMemAlloc, &CachingTestMemFree));
+
+        uint32_t uncached = CountHookCalls(false);
+        uint32_t cached = CountHookCalls(true);
+        LOG_COMMENT(L"memory hook calls for 50 calls: %u without thread caching, %u with it", uncached, cached);
+        VERIFY_IS_TRUE(cached * 10 < uncached);
+
+        VERIFY_ARE_EQUAL(S_OK, HCMemSetFunctions(nullptr, nullptr));
+    }
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
@@ -0,0 +1,149 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "UnitTestIncludes.h"
+#define TEST_CLASS_OWNER L"jasonsa"
+#include "DefineTestMacros.h"
+#include "utils.h"
+
+#if HC_TLS_SESSION_CACHE
+#include <openssl/crypto.h>
+#include "tls_session_cache.h"
+#include "loopback_tls_server.h"
+
+using namespace xbox::httpclient;
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
+
+// Connects to 127.0.0.1:port with a context from the cache, filing its sessions under hostName:port, and exchanges a
+// line so the server's tickets arrive before the connection is closed. Returns whether the session was resumed.
+static bool ExchangeLine(tls_session_cache& cache, const char* hostName, uint16_t port)
+{
+    ssl_ctx_st* context = nullptr;
+    VERIFY_ARE_EQUAL(S_OK, cache.GetClientContext(tls_verification::none, &context));
+
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    VERIFY_ARE_EQUAL(0, connect(s, reinterpret_cast<sockaddr*>(&address), sizeof(address)));
+
+    SSL* connection = SSL_new(context);
+    SSL_set_fd(connection, s);
+    VERIFY_ARE_EQUAL(S_OK, cache.PrepareConnection(connection, hostName, port));
+    VERIFY_ARE_EQUAL(1, SSL_connect(connection));
+    VERIFY_ARE_EQUAL(6, SSL_write(connection, "hello\n", 6));
+
+    char reply[3]{};
+    VERIFY_ARE_EQUAL(3, SSL_read(connection, reply, sizeof(reply)));
+    bool resumed = SSL_session_reused(connection) == 1;
+
+    SSL_shutdown(connection);
+    SSL_free(connection);
+    close(s);
+    SSL_CTX_free(context);
+    return resumed;
+}
+
+DEFINE_TEST_CLASS(TlsSessionCacheTests)
+{
+public:
+    DEFINE_TEST_CLASS_PROPS(TlsSessionCacheTests);
+
+    DEFINE_TEST_CASE(VerifyTicketResumption)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyTicketResumption);
+
+        std::shared_ptr<tls_session_cache> cache;
+        VERIFY_ARE_EQUAL(S_OK, tls_session_cache::Acquire(&cache));
+        HCTlsSessionStats before = cache->GetStats();
+
+        loopback_tls_server server;
+        VERIFY_IS_FALSE(ExchangeLine(*cache, "Localhost", server.Port()));
+
+        // Each reconnect uses the newest ticket, since TLS 1.3 tickets are single use
+        VERIFY_IS_TRUE(ExchangeLine(*cache, "localhost", server.Port()));
+        VERIFY_IS_TRUE(ExchangeLine(*cache, "LOCALHOST", server.Port()));
+        VERIFY_ARE_EQUAL(2u, server.ResumedHandshakes());
+        VERIFY_ARE_EQUAL(1u, server.FullHandshakes());
+
+        HCTlsSessionStats after = cache->GetStats();
+        VERIFY_ARE_EQUAL(2ull, after.resumedHandshakes - before.resumedHandshakes);
+        VERIFY_ARE_EQUAL(1ull, after.fullHandshakes - before.fullHandshakes);
+
+        // Sessions are kept per host:port
+        loopback_tls_server otherServer;
+        VERIFY_IS_FALSE(ExchangeLine(*cache, "localhost", otherServer.Port()));
+        VERIFY_IS_FALSE(ExchangeLine(*cache, "127.0.0.1", server.Port()));
+    }
+
+    DEFINE_TEST_CASE(VerifySessionIdResumption)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifySessionIdResumption);
+
+        std::shared_ptr<tls_session_cache> cache;
+        VERIFY_ARE_EQUAL(S_OK, tls_session_cache::Acquire(&cache));
+
+        loopback_tls_server server{ loopback_tls_server::resumption::sessionIds };
+        VERIFY_IS_FALSE(ExchangeLine(*cache, "localhost", server.Port()));
+
+        // TLS 1.2 sessions stay cached after use
+        VERIFY_IS_TRUE(ExchangeLine(*cache, "localhost", server.Port()));
+        VERIFY_IS_TRUE(ExchangeLine(*cache, "localhost", server.Port()));
+        VERIFY_ARE_EQUAL(2u, server.ResumedHandshakes());
+    }
+
+    DEFINE_TEST_CASE(VerifyWarm)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyWarm);
+
+        std::shared_ptr<tls_session_cache> cache;
+        VERIFY_ARE_EQUAL(S_OK, tls_session_cache::Acquire(&cache));
+
+        // The session negotiated ahead of time is resumed by the first real connection, whichever way it is cached
+        for (auto mode : { loopback_tls_server::resumption::tickets, loopback_tls_server::resumption::sessionIds })
+        {
+            loopback_tls_server server{ mode };
+            VERIFY_ARE_EQUAL(S_OK, cache->Warm("127.0.0.1", server.Port(), tls_verification::none));
+            VERIFY_IS_TRUE(ExchangeLine(*cache, "127.0.0.1", server.Port()));
+            VERIFY_ARE_EQUAL(1u, server.FullHandshakes());
+            VERIFY_ARE_EQUAL(1u, server.ResumedHandshakes());
+        }
+
+        // The self-signed certificate fails verification, so nothing is cached
+        loopback_tls_server server;
+        VERIFY_ARE_EQUAL(E_FAIL, cache->Warm("127.0.0.1", server.Port(), tls_verification::peer));
+        VERIFY_IS_FALSE(ExchangeLine(*cache, "127.0.0.1", server.Port()));
+    }
+
+    DEFINE_TEST_CASE(VerifySharedInstance)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifySharedInstance);
+
+        std::shared_ptr<tls_session_cache> first;
+        std::shared_ptr<tls_session_cache> second;
+        VERIFY_ARE_EQUAL(S_OK, tls_session_cache::Acquire(&first));
+        VERIFY_ARE_EQUAL(S_OK, tls_session_cache::Acquire(&second));
+        VERIFY_IS_TRUE(first.get() == second.get());
+
+        // Contexts are shared too
+        ssl_ctx_st* firstContext = nullptr;
+        ssl_ctx_st* secondContext = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, first->GetClientContext(tls_verification::peer, &firstContext));
+        VERIFY_ARE_EQUAL(S_OK, second->GetClientContext(tls_verification::peer, &secondContext));
+        VERIFY_IS_TRUE(firstContext == secondContext);
+        SSL_CTX_free(firstContext);
+        SSL_CTX_free(secondContext);
+
+        std::string linked = std::string{ "OpenSSL/" } + OpenSSL_version(OPENSSL_VERSION_STRING);
+        VERIFY_IS_TRUE(tls_session_cache::IsLinkedOpenSsl(linked.c_str()));
+        VERIFY_IS_FALSE(tls_session_cache::IsLinkedOpenSsl("OpenSSL/0.9.8"));
+        VERIFY_IS_FALSE(tls_session_cache::IsLinkedOpenSsl("GnuTLS/3.7.9"));
+        VERIFY_IS_FALSE(tls_session_cache::IsLinkedOpenSsl(nullptr));
+    }
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
+#endif
@@ -0,0 +1,247 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "UnitTestIncludes.h"
+#define TEST_CLASS_OWNER L"jasonsa"
+#include "DefineTestMacros.h"
+#include "utils.h"
+#include "../Common/uri.h"
+#include "../Common/url_encoding.h"
+#include <random>
+
+using namespace xbox::httpclient;
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_BEGIN
+
+static std::string Encode(std::string const& input)
+{
+    size_t size = 0;
+    VERIFY_ARE_EQUAL(S_OK, HCUrlEncode(input.data(), input.size(), 0, nullptr, &size));
+    std::string output(size, '\0');
+    VERIFY_ARE_EQUAL(S_OK, HCUrlEncode(input.data(), input.size(), output.size(), &output[0], &size));
+    VERIFY_ARE_EQUAL(output.size(), size);
+    return output;
+}
+
+static std::string Decode(std::string const& input)
+{
+    size_t size = 0;
+    VERIFY_ARE_EQUAL(S_OK, HCUrlDecode(input.data(), input.size(), 0, nullptr, &size));
+    std::string output(size, '\0');
+    VERIFY_ARE_EQUAL(S_OK, HCUrlDecode(input.data(), input.size(), output.size(), &output[0], &size));
+    VERIFY_ARE_EQUAL(output.size(), size);
+    return output;
+}
+
+// Random input of the given length, drawn from a handful of characters so escapes are common but not everywhere
+static void FillRandom(std::mt19937& random, char* output, size_t length, char const* alphabet)
+{
+    size_t alphabetLength = strlen(alphabet);
+    for (size_t i = 0; i < length; ++i)
+    {
+        output[i] = alphabetLength == 0 ? static_cast<char>(random() & 0xFF) : alphabet[random() % alphabetLength];
+    }
+}
+
+static std::string GetUrl(HCCallHandle call)
+{
+    const char* method = nullptr;
+    const char* url = nullptr;
+    VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestGetUrl(call, &method, &url));
+    return url;
+}
+
+DEFINE_TEST_CLASS(UrlEncodingTests)
+{
+public:
+    DEFINE_TEST_CLASS_PROPS(UrlEncodingTests);
+
+    DEFINE_TEST_CASE(VerifyUrlEncoding)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyUrlEncoding);
+
+        VERIFY_ARE_EQUAL_STR("", Encode("").c_str());
+        VERIFY_ARE_EQUAL_STR("AZaz09-._~", Encode("AZaz09-._~").c_str());
+        VERIFY_ARE_EQUAL_STR("a%20b%2Bc%26d%3De%2Ff%3Fg%23h%25", Encode("a b+c&d=e/f?g#h%").c_str());
+        VERIFY_ARE_EQUAL_STR("%40%5B%60%7B%7F%00%FF", Encode(std::string{ "@[`{\x7f", 5 } + std::string{ "\0\xff", 2 }).c_str());
+        VERIFY_ARE_EQUAL_STR("caf%C3%A9%20%E2%82%AC", Encode("caf\xc3\xa9 \xe2\x82\xac").c_str());
+
+        // Long enough to take the vector path, with escapes at the edges of its blocks
+        std::string longInput = "0123456789abcdef0123456789abcde/0123456789abcdef 123456789abcdef0123456789abcdef";
+        std::string longExpected = "0123456789abcdef0123456789abcde%2F0123456789abcdef%20123456789abcdef0123456789abcdef";
+        VERIFY_ARE_EQUAL_STR(longExpected.c_str(), Encode(longInput).c_str());
+        VERIFY_ARE_EQUAL_STR(longInput.c_str(), Decode(longExpected).c_str());
+
+        VERIFY_ARE_EQUAL_STR("a b+c&d", Decode("a%20b+c%26d").c_str());
+        VERIFY_ARE_EQUAL_STR("\xc3\xa9\xc3\xa9", Decode("%c3%A9%C3%a9").c_str());
+
+        // A '%' must start an escape
+        size_t size = 0;
+        char buffer[64]{};
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCUrlDecode("%", 1, sizeof(buffer), buffer, &size));
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCUrlDecode("ab%2", 4, sizeof(buffer), buffer, &size));
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCUrlDecode("ab%g0", 5, sizeof(buffer), buffer, &size));
+        std::string longInvalid = std::string(40, 'a') + "%%41";
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCUrlDecode(longInvalid.data(), longInvalid.size(), sizeof(buffer), buffer, &size));
+
+        // Buffers too small are reported with the size needed
+        VERIFY_ARE_EQUAL(E_NOT_SUFFICIENT_BUFFER, HCUrlEncode("a b", 3, 4, buffer, &size));
+        VERIFY_ARE_EQUAL(5u, static_cast<uint32_t>(size));
+        VERIFY_ARE_EQUAL(E_NOT_SUFFICIENT_BUFFER, HCUrlDecode("a%20b", 5, 2, buffer, &size));
+        VERIFY_ARE_EQUAL(3u, static_cast<uint32_t>(size));
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCUrlEncode(nullptr, 1, sizeof(buffer), buffer, &size));
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCUrlEncode("a", 1, sizeof(buffer), buffer, nullptr));
+    }
+
+    DEFINE_TEST_CASE(VerifyUrlEncodingMatchesScalar)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyUrlEncodingMatchesScalar);
+
+        // Inputs of every length around the block sizes, at every alignment, mostly unreserved, mostly not, and any byte
+        char const* alphabets[] = { "abcXYZ019-._~", "ab /%&=+", "%0123456789abcdefABCDEFxyz", "" };
+        std::mt19937 random{ 2024 };
+        std::vector<char> input(256 + 32);
+        std::vector<char> vectorOutput(input.size() * 3);
+        std::vector<char> scalarOutput(input.size() * 3);
+        uint32_t cases = 0;
+        uint32_t validDecodes = 0;
+        for (int round = 0; round < 40; round++)
+        {
+            for (char const* alphabet : alphabets)
+            {
+                for (size_t length = 0; length <= 256; length += (length < 80 ? 1 : 13))
+                {
+                    size_t offset = random() % 32;
+                    char* data = input.data() + offset;
+                    FillRandom(random, data, length, alphabet);
+
+                    size_t encodedLength = UrlEncodedLength(data, length);
+                    VERIFY_ARE_EQUAL(UrlEncodedLengthScalar(data, length), encodedLength);
+                    VERIFY_ARE_EQUAL(encodedLength, UrlEncode(data, length, vectorOutput.data()));
+                    VERIFY_ARE_EQUAL(encodedLength, UrlEncodeScalar(data, length, scalarOutput.data()));
+                    VERIFY_IS_TRUE(memcmp(vectorOutput.data(), scalarOutput.data(), encodedLength) == 0);
+
+                    // What was encoded decodes back to the input
+                    size_t decodedLength = 0;
+                    VERIFY_IS_TRUE(UrlDecodedLength(vectorOutput.data(), encodedLength, decodedLength));
+                    VERIFY_ARE_EQUAL(length, decodedLength);
+                    VERIFY_ARE_EQUAL(length, UrlDecode(vectorOutput.data(), encodedLength, scalarOutput.data()));
+                    VERIFY_IS_TRUE(memcmp(data, scalarOutput.data(), length) == 0);
+
+                    // And raw input is accepted or rejected alike, and decoded alike when accepted
+                    size_t scalarDecodedLength = 0;
+                    bool valid = UrlDecodedLength(data, length, decodedLength);
+                    VERIFY_ARE_EQUAL(UrlDecodedLengthScalar(data, length, scalarDecodedLength), valid);
+                    if (valid)
+                    {
+                        VERIFY_ARE_EQUAL(scalarDecodedLength, decodedLength);
+                        VERIFY_ARE_EQUAL(decodedLength, UrlDecode(data, length, vectorOutput.data()));
+                        VERIFY_ARE_EQUAL(decodedLength, UrlDecodeScalar(data, length, scalarOutput.data()));
+                        VERIFY_IS_TRUE(memcmp(vectorOutput.data(), scalarOutput.data(), decodedLength) == 0);
+                        ++validDecodes;
+                    }
+                    ++cases;
+                }
+            }
+        }
+        LOG_COMMENT(L"%u inputs compared, %u of them valid to decode", cases, validDecodes);
+        VERIFY_IS_TRUE(validDecodes > cases / 4);
+    }
+
+    DEFINE_TEST_CASE(VerifyAppendQueryParameter)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(VerifyAppendQueryParameter);
+
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCHttpCallRequestAppendQueryParameter(call, nullptr, "v"));
+        VERIFY_ARE_EQUAL(E_INVALIDARG, HCHttpCallRequestAppendQueryParameter(call, "n", nullptr));
+
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "https://title.example.com/search"));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAppendQueryParameter(call, "q", "gears of war"));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAppendQueryParameter(call, "filter", "type=game&platform=pc"));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAppendQueryParameter(call, "empty", ""));
+        VERIFY_ARE_EQUAL_STR("https://title.example.com/search?q=gears%20of%20war&filter=type%3Dgame%26platform%3Dpc&empty=", GetUrl(call).c_str());
+
+        // Added to an existing query, ahead of the fragment
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "https://title.example.com/search?page=2#results"));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAppendQueryParameter(call, "sort", "name asc"));
+        VERIFY_ARE_EQUAL_STR("https://title.example.com/search?page=2&sort=name%20asc#results", GetUrl(call).c_str());
+
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "https://title.example.com/search#results"));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAppendQueryParameter(call, "a", "1"));
+        VERIFY_ARE_EQUAL_STR("https://title.example.com/search?a=1#results", GetUrl(call).c_str());
+
+        // A query that is empty or already ends in '&' gets no extra separator
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "https://title.example.com/search?"));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAppendQueryParameter(call, "a", "1"));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", GetUrl(call).append("&").c_str()));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAppendQueryParameter(call, "b", "2"));
+        VERIFY_ARE_EQUAL_STR("https://title.example.com/search?a=1&b=2", GetUrl(call).c_str());
+
+        // The result parses back into the same parameters
+        Uri uri{ GetUrl(call).c_str() };
+        VERIFY_IS_TRUE(uri.IsValid());
+        VERIFY_IS_TRUE(uri.Query() == "a=1&b=2");
+
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        HCCleanup();
+    }
+
+    DEFINE_TEST_CASE(MeasureUrlEncoding)
+    {
+        DEFINE_TEST_CASE_PROPERTIES(MeasureUrlEncoding);
+
+        // Query values as titles send them: mostly unreserved, with the odd space, separator or non-ASCII character
+        std::mt19937 random{ 7 };
+        std::vector<char> input(1024 * 1024);
+        FillRandom(random, input.data(), input.size(), "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_.abcdefghijklmnopqrstuvwxyz0123456789 ,:/\xc3\xa9");
+        std::vector<char> encoded(UrlEncodedLength(input.data(), input.size()));
+        std::vector<char> decoded(input.size());
+
+        const int iterations = 20;
+        auto measure = [&](size_t(*function)(char const*, size_t, char*), char const* from, size_t length, char* to)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; i++)
+            {
+                VERIFY_IS_TRUE(function(from, length, to) > 0);
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+            return static_cast<double>(length) * iterations / (elapsed > 0 ? elapsed : 1);
+        };
+
+        double encodeScalar = measure(&UrlEncodeScalar, input.data(), input.size(), encoded.data());
+        double encodeVector = measure(&UrlEncode, input.data(), input.size(), encoded.data());
+        double decodeScalar = measure(&UrlDecodeScalar, encoded.data(), encoded.size(), decoded.data());
+        double decodeVector = measure(&UrlDecode, encoded.data(), encoded.size(), decoded.data());
+        VERIFY_IS_TRUE(memcmp(input.data(), decoded.data(), input.size()) == 0);
+        LOG_COMMENT(L"encode: %.0f MB/s scalar, %.0f MB/s vectorized; decode: %.0f MB/s scalar, %.0f MB/s vectorized (%u%% of bytes escaped)",
+            encodeScalar, encodeVector, decodeScalar, decodeVector,
+            static_cast<uint32_t>((encoded.size() - input.size()) / 2 * 100 / input.size()));
+
+        // Building a query string parameter by parameter
+        VERIFY_ARE_EQUAL(S_OK, HCInitialize(nullptr));
+        HCCallHandle call = nullptr;
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCreate(&call));
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 1000; i++)
+        {
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestSetUrl(call, "GET", "https://title.example.com/users/xuid(2814000000000000)/achievements"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAppendQueryParameter(call, "titleId", "1717113201"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAppendQueryParameter(call, "unlockedOnly", "true"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAppendQueryParameter(call, "orderBy", "unlockTime desc"));
+            VERIFY_ARE_EQUAL(S_OK, HCHttpCallRequestAppendQueryParameter(call, "continuationToken", "eyJza2lwIjoxMDAsInRha2UiOjUwfQ=="));
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        LOG_COMMENT(L"1000 urls with 4 query parameters built in %lld us",
+            static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+        VERIFY_ARE_EQUAL(S_OK, HCHttpCallCloseHandle(call));
+        HCCleanup();
+    }
+};
+
+NAMESPACE_XBOX_HTTP_CLIENT_TEST_END
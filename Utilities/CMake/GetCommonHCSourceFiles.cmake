@@ -13,16 +13,16 @@ function(GET_COMMON_HC_SOURCE_FILES
          )
 
     set(${OUT_PUBLIC_SOURCE_FILES}
-        "${PATH_TO_ROOT}/include/httpClient/config.h"
-        "${PATH_TO_ROOT}/include/httpClient/httpClient.h"
-        "${PATH_TO_ROOT}/include/httpClient/httpProvider.h"
-        "${PATH_TO_ROOT}/include/httpClient/mock.h"
-        "${PATH_TO_ROOT}/include/xasync.h"
-        "${PATH_TO_ROOT}/include/xasyncProvider.h"
-        "${PATH_TO_ROOT}/include/xtaskQueue.h"
-        "${PATH_TO_ROOT}/include/httpClient/trace.h"
-        "${PATH_TO_ROOT}/include/httpClient/pal.h"
-        "${PATH_TO_ROOT}/include/httpClient/async.h"
+        "${PATH_TO_ROOT}/Include/httpClient/config.h"
+        "${PATH_TO_ROOT}/Include/httpClient/httpClient.h"
+        "${PATH_TO_ROOT}/Include/httpClient/httpProvider.h"
+        "${PATH_TO_ROOT}/Include/httpClient/mock.h"
+        "${PATH_TO_ROOT}/Include/XAsync.h"
+        "${PATH_TO_ROOT}/Include/XAsyncProvider.h"
+        "${PATH_TO_ROOT}/Include/XTaskQueue.h"
+        "${PATH_TO_ROOT}/Include/httpClient/trace.h"
+        "${PATH_TO_ROOT}/Include/httpClient/pal.h"
+        "${PATH_TO_ROOT}/Include/httpClient/async.h"
         PARENT_SCOPE
         )
 
@@ -34,8 +34,12 @@ function(GET_COMMON_HC_SOURCE_FILES
         "${PATH_TO_ROOT}/Source/Common/pch_common.h"
         "${PATH_TO_ROOT}/Source/Common/pal_internal.h"
         "${PATH_TO_ROOT}/Source/Common/ResultMacros.h"
+        "${PATH_TO_ROOT}/Source/Common/tls_session_cache.cpp"
+        "${PATH_TO_ROOT}/Source/Common/tls_session_cache.h"
         "${PATH_TO_ROOT}/Source/Common/uri.cpp"
         "${PATH_TO_ROOT}/Source/Common/uri.h"
+        "${PATH_TO_ROOT}/Source/Common/url_encoding.cpp"
+        "${PATH_TO_ROOT}/Source/Common/url_encoding.h"
         "${PATH_TO_ROOT}/Source/Common/utils.cpp"
         "${PATH_TO_ROOT}/Source/Common/utils.h"
         PARENT_SCOPE
@@ -44,6 +48,10 @@ function(GET_COMMON_HC_SOURCE_FILES
     set(${OUT_GLOBAL_SOURCE_FILES}
         "${PATH_TO_ROOT}/Source/Global/mem.cpp"
         "${PATH_TO_ROOT}/Source/Global/mem.h"
+        "${PATH_TO_ROOT}/Source/Global/handle_table.cpp"
+        "${PATH_TO_ROOT}/Source/Global/handle_table.h"
+        "${PATH_TO_ROOT}/Source/Global/routed_handlers.cpp"
+        "${PATH_TO_ROOT}/Source/Global/routed_handlers.h"
         "${PATH_TO_ROOT}/Source/Global/global_publics.cpp"
         "${PATH_TO_ROOT}/Source/Global/global.cpp"
         "${PATH_TO_ROOT}/Source/Global/global.h"
@@ -73,17 +81,31 @@ function(GET_COMMON_HC_SOURCE_FILES
         )
 
     set(${OUT_MOCK_SOURCE_FILES}
+        "${PATH_TO_ROOT}/Source/Mock/lhc_capture.cpp"
+        "${PATH_TO_ROOT}/Source/Mock/lhc_capture.h"
         "${PATH_TO_ROOT}/Source/Mock/lhc_mock.cpp"
         "${PATH_TO_ROOT}/Source/Mock/lhc_mock.h"
+        "${PATH_TO_ROOT}/Source/Mock/lhc_network_emulator.cpp"
+        "${PATH_TO_ROOT}/Source/Mock/lhc_network_emulator.h"
         "${PATH_TO_ROOT}/Source/Mock/mock_publics.cpp"
         PARENT_SCOPE
         )
 
     set(${OUT_HTTP_SOURCE_FILES}
+        "${PATH_TO_ROOT}/Source/HTTP/body_flow_control.cpp"
+        "${PATH_TO_ROOT}/Source/HTTP/body_flow_control.h"
+        "${PATH_TO_ROOT}/Source/HTTP/compression.cpp"
+        "${PATH_TO_ROOT}/Source/HTTP/compression.h"
         "${PATH_TO_ROOT}/Source/HTTP/httpcall.cpp"
         "${PATH_TO_ROOT}/Source/HTTP/httpcall.h"
         "${PATH_TO_ROOT}/Source/HTTP/httpcall_request.cpp"
         "${PATH_TO_ROOT}/Source/HTTP/httpcall_response.cpp"
+        "${PATH_TO_ROOT}/Source/HTTP/multipart_body.cpp"
+        "${PATH_TO_ROOT}/Source/HTTP/multipart_body.h"
+        "${PATH_TO_ROOT}/Source/HTTP/range_download.cpp"
+        "${PATH_TO_ROOT}/Source/HTTP/range_download.h"
+        "${PATH_TO_ROOT}/Source/HTTP/response_stream.cpp"
+        "${PATH_TO_ROOT}/Source/HTTP/response_stream.h"
         PARENT_SCOPE
         )
 